@@ -0,0 +1,115 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2019, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * fs_logdecode.c -- Decode a binary log (log-binary-file) to text
+ *
+ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <switch.h>
+
+/* Picky compiler */
+#ifdef __ICC
+#pragma warning (disable:167)
+#endif
+
+int main(int argc, char *argv[])
+{
+	int r = 0;
+	int i;
+	int cmd_fail = 0;
+	switch_log_level_t level = SWITCH_LOG_DEBUG;
+	const char *uuid = NULL;
+
+	for (i = 1; i < argc; i++) {
+		if (argv[i][0] == '-' && argv[i][1]) {
+			switch(argv[i][1]) {
+				case 'l':
+					if (++i < argc) {
+						level = switch_log_str2level(argv[i]);
+					}
+					break;
+				case 'u':
+					if (++i < argc) {
+						uuid = argv[i];
+					}
+					break;
+				default:
+					printf("Command line option not recognized: %s\n", argv[i]);
+					cmd_fail = 1;
+			}
+		} else {
+			break;
+		}
+	}
+
+	if (argc - i < 1 || cmd_fail || level == SWITCH_LOG_INVALID) {
+		goto usage;
+	}
+
+	for (; i < argc; i++) {
+		FILE *in = strcmp(argv[i], "-") ? fopen(argv[i], "rb") : stdin;
+		switch_status_t status;
+
+		if (!in) {
+			fprintf(stderr, "Cannot open %s\n", argv[i]);
+			r = 1;
+			continue;
+		}
+
+		if ((status = switch_log_binary_decode(in, stdout, level, uuid)) != SWITCH_STATUS_SUCCESS) {
+			fprintf(stderr, "%s: %s\n", argv[i], status == SWITCH_STATUS_NOT_INITALIZED ? "not a binary log" : "truncated or corrupt record");
+			r = 1;
+		}
+
+		if (in != stdin) {
+			fclose(in);
+		}
+	}
+
+	return r;
+
+usage:
+	printf("Usage: %s [options] file [file ...]\n\n", argv[0]);
+	printf("Decodes binary logs written with the log-binary-file switch.conf param, - reads stdin.\n\n");
+	printf("\t-l level        Only show lines at or above this log level (default debug)\n");
+	printf("\t-u uuid         Only show lines logged for this uuid\n");
+	return 1;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -108,6 +108,7 @@ struct switch_core_session {
 
 	switch_audio_resampler_t *read_resampler;
 	switch_audio_resampler_t *write_resampler;
+	switch_xcode_t write_xcode;
 
 	switch_mutex_t *mutex;
 	switch_mutex_t *stack_count_mutex;
@@ -116,6 +117,12 @@ struct switch_core_session {
 	switch_mutex_t *codec_read_mutex;
 	switch_mutex_t *codec_write_mutex;
 	switch_thread_cond_t *cond;
+	/* task_suspended: the state machine task gave its worker back at a sleep point
+	   task_wake_pending: a wake came in while the task was running, it checks this before giving its worker back
+	   both guarded by task_mutex */
+	switch_mutex_t *task_mutex;
+	int task_suspended;
+	int task_wake_pending;
 	switch_mutex_t *frame_read_mutex;
 	switch_mutex_t *fork_read_frame_mutex;
 
@@ -296,6 +303,8 @@ struct switch_runtime {
 	uint32_t log_truncate;
 	switch_call_cause_t shutdown_cause;
 	switch_bool_t add_media_bug_last;
+	switch_bool_t core_memory_tables;
+	switch_bool_t core_memory_tables_mirror;
 };
 
 extern struct switch_runtime runtime;
@@ -313,6 +322,21 @@ struct switch_session_manager {
 	int running;
 	int busy;
 	switch_bool_t drop_udp_invites;
+	switch_bool_t work_stealing;
+	switch_size_t pool_stack_size;
+	uint32_t pool_shards;
+	uint32_t pool_max_threads;
+	struct switch_thread_pool_shard_s *shards;
+	switch_mutex_t *idle_mutex;
+	switch_thread_cond_t *idle_cond;
+	switch_atomic_t pending;
+	uint32_t next_shard;
+	uint32_t next_home;
+	uint32_t pool_running;
+	uint32_t pool_idle;
+	int pool_shutdown;
+	uint64_t steals;
+	switch_atomic_t tasks;
 };
 
 extern struct switch_session_manager session_manager;
@@ -325,6 +349,20 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 void switch_core_sqldb_stop(void);
 void switch_core_session_init(switch_memory_pool_t *pool);
 void switch_core_session_uninit(void);
+void switch_core_file_init(switch_memory_pool_t *pool);
+void switch_core_file_uninit(void);
+void switch_core_video_init(switch_memory_pool_t *pool);
+void switch_core_video_uninit(void);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
+
+typedef enum {
+	SWITCH_SESSION_RUN_THREAD,
+	SWITCH_SESSION_RUN_POOL,
+	SWITCH_SESSION_RUN_MEDIA
+} switch_session_run_mode_t;
+
+switch_status_t switch_core_session_run_task(switch_core_session_t *session, switch_session_run_mode_t mode);
+switch_session_run_mode_t switch_core_session_task_mode(switch_core_session_t *session);
+void switch_core_session_task_schedule(switch_core_session_t *session);
 switch_memory_pool_t *switch_core_memory_init(void);
 void switch_core_memory_stop(void);
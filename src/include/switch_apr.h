@@ -424,6 +424,26 @@ SWITCH_DECLARE(void) switch_atomic_inc(volatile switch_atomic_t *mem);
  */
 SWITCH_DECLARE(int)  switch_atomic_dec(volatile switch_atomic_t *mem);
 
+/**
+ * Compare the pointer's value with cmp.
+ * If they are the same swap the value with 'with'
+ * @param mem pointer to the pointer
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @return the old value of the pointer
+ */
+SWITCH_DECLARE(void *) switch_atomic_casptr(volatile void **mem, void *with, const void *cmp);
+
+/**
+ * Compare an uint32's value with cmp.
+ * If they are the same swap the value with 'with'
+ * @param mem pointer to the value
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @return the old value of *mem
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_cas(volatile switch_atomic_t *mem, uint32_t with, uint32_t cmp);
+
 /** @} */
 
 /**
@@ -878,6 +898,13 @@ SWITCH_DECLARE(switch_status_t) switch_file_mktemp(switch_file_t ** thefile, cha
 
 SWITCH_DECLARE(switch_size_t) switch_file_get_size(switch_file_t *thefile);
 
+/**
+ * Get the native OS file handle (a descriptor on unix) behind a switch_file_t
+ * @param thefile where to store the native handle
+ * @param file the file
+ */
+SWITCH_DECLARE(switch_status_t) switch_os_file_get(switch_os_file_t *thefile, switch_file_t *file);
+
 SWITCH_DECLARE(switch_status_t) switch_file_exists(const char *filename, switch_memory_pool_t *pool);
 
 SWITCH_DECLARE(switch_status_t) switch_directory_exists(const char *dirname, switch_memory_pool_t *pool);
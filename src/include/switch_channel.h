@@ -374,6 +374,15 @@ static inline int switch_channel_var_true(switch_channel_t *channel, const char
  */
 SWITCH_DECLARE(switch_event_header_t *) switch_channel_variable_first(switch_channel_t *channel);
 
+/*!
+  \brief Get a shared read-only snapshot of the channel variables as variable_ prefixed headers
+  \param channel channel to snapshot
+  \return the snapshot, release it with switch_event_shared_release
+  \note the snapshot is copied once and shared by every caller and every event from switch_channel_event_set_data
+  until the channel variables change
+*/
+SWITCH_DECLARE(switch_event_shared_t *) switch_channel_var_snapshot_get(switch_channel_t *channel);
+
 /*!
  * \brief Stop iterating over channel variables.
  * \remark Unlocks the profile mutex initially locked in switch_channel_variable_first
@@ -665,6 +674,34 @@ SWITCH_DECLARE(void) switch_channel_event_set_extended_data(_In_ switch_channel_
 SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *channel, const char *in, switch_event_t *var_list, switch_event_t *api_list, uint32_t recur);
 #define switch_channel_expand_variables(_channel, _in) switch_channel_expand_variables_check(_channel, _in, NULL, NULL, 0)
 
+/*!
+  \brief Expand variables in a string using a cached, pre-tokenized template of the string
+  \param channel channel to expand the variables from
+  \param in the original string
+  \return the original string if no expansion takes place otherwise a new string that must be freed
+  \note produces the same output as switch_channel_expand_variables_check, the parsing of the string is only done once
+*/
+SWITCH_DECLARE(char *) switch_channel_expand_variables_cached_check(switch_channel_t *channel, const char *in, switch_event_t *var_list, switch_event_t *api_list);
+#define switch_channel_expand_variables_cached(_channel, _in) switch_channel_expand_variables_cached_check(_channel, _in, NULL, NULL)
+
+/*!
+  \brief Compile a string into a reusable expansion template
+  \param in the original string
+  \param tplP [out] the template, destroy with switch_channel_expand_template_destroy
+  \return SWITCH_STATUS_SUCCESS
+*/
+SWITCH_DECLARE(switch_status_t) switch_channel_expand_template_compile(const char *in, switch_expand_template_t **tplP);
+SWITCH_DECLARE(void) switch_channel_expand_template_destroy(switch_expand_template_t **tplP);
+
+/*!
+  \brief Render a compiled template against the variables of a channel
+  \return a new string that must be freed
+*/
+SWITCH_DECLARE(char *) switch_channel_expand_template_render(switch_channel_t *channel, switch_expand_template_t *tpl,
+															 switch_event_t *var_list, switch_event_t *api_list);
+SWITCH_DECLARE(void) switch_channel_set_expand_template_cache_size(uint32_t size);
+SWITCH_DECLARE(void) switch_channel_expand_template_cache_stats(uint32_t *count, uint64_t *hits, uint64_t *misses);
+
 #define switch_channel_inbound_display(_channel) ((switch_channel_direction(_channel) == SWITCH_CALL_DIRECTION_INBOUND && !switch_channel_test_flag(_channel, CF_BLEG)) || (switch_channel_direction(_channel) == SWITCH_CALL_DIRECTION_OUTBOUND && switch_channel_test_flag(_channel, CF_DIALPLAN)))
 
 #define switch_channel_outbound_display(_channel) ((switch_channel_direction(_channel) == SWITCH_CALL_DIRECTION_INBOUND && switch_channel_test_flag(_channel, CF_BLEG)) || (switch_channel_direction(_channel) == SWITCH_CALL_DIRECTION_OUTBOUND && !switch_channel_test_flag(_channel, CF_DIALPLAN)))
@@ -884,6 +884,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_thread_launch(_In_ switch_co
 
 
 SWITCH_DECLARE(switch_status_t) switch_thread_pool_launch_thread(switch_thread_data_t **tdp);
+/*!
+  \brief Run a short job that never blocks for long on the bounded work stealing pool
+  \note falls back to switch_thread_pool_launch_thread() when work stealing is off
+*/
+SWITCH_DECLARE(switch_status_t) switch_thread_pool_launch_task(switch_thread_data_t **tdp);
 SWITCH_DECLARE(switch_status_t) switch_core_session_thread_pool_launch(switch_core_session_t *session);
 SWITCH_DECLARE(switch_status_t) switch_thread_pool_wait(switch_thread_data_t *td, int ms);
 																
@@ -2102,6 +2107,48 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_command(switch_file_handle_t *f
 SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *fh, int64_t offset);
 SWITCH_DECLARE(switch_bool_t) switch_core_file_has_video(switch_file_handle_t *fh, switch_bool_t CHECK_OPEN);
 
+typedef struct {
+	/*! bytes of decoded audio held by the cache */
+	switch_size_t bytes;
+	/*! cache size limit in bytes, 0 when the cache is disabled */
+	switch_size_t max_bytes;
+	/*! largest decoded file the cache will hold, in bytes */
+	switch_size_t max_entry_bytes;
+	/*! number of cached files */
+	uint32_t entries;
+	/*! opens served from the cache */
+	uint64_t hits;
+	/*! cacheable opens that had to decode the file */
+	uint64_t misses;
+	/*! files added to the cache */
+	uint64_t inserts;
+	/*! files dropped to stay under max_bytes */
+	uint64_t evictions;
+	/*! files dropped because they changed on disk */
+	uint64_t invalidations;
+	/*! captures abandoned (seek, early close, too large) */
+	uint64_t aborts;
+} switch_prompt_cache_stats_t;
+
+/*!
+  \brief Size the prompt cache of decoded audio shared by read-only file handles
+  \param max_bytes total bytes of decoded audio to keep, 0 disables the cache and empties it
+  \param max_entry_bytes largest decoded file to keep, 0 for max_bytes / 8
+  \note files are cached per (path, rate, channels) the first time they are read to the end
+*/
+SWITCH_DECLARE(void) switch_core_prompt_cache_set_limits(switch_size_t max_bytes, switch_size_t max_entry_bytes);
+
+/*!
+  \brief Fill in the prompt cache statistics
+  \param stats the statistics to fill in
+*/
+SWITCH_DECLARE(void) switch_core_prompt_cache_get_stats(switch_prompt_cache_stats_t *stats);
+
+/*!
+  \brief Drop every file from the prompt cache (handles playing from it keep their copy)
+*/
+SWITCH_DECLARE(void) switch_core_prompt_cache_flush(void);
+
 
 ///\}
 
@@ -2867,6 +2914,47 @@ SWITCH_DECLARE(switch_status_t) switch_core_del_registration(const char *user, c
 */
 SWITCH_DECLARE(switch_status_t) switch_core_expire_registration(int force);
 
+typedef enum {
+	SWITCH_CORE_TABLE_CHANNELS,
+	SWITCH_CORE_TABLE_CALLS,
+	SWITCH_CORE_TABLE_DETAILED_CALLS,
+	SWITCH_CORE_TABLE_REGISTRATIONS
+} switch_core_table_t;
+
+typedef struct {
+	/*! which table or view to read */
+	switch_core_table_t table;
+	/*! channels: SQL LIKE pattern matched against uuid, name, cid_name, cid_num, presence_data and accountcode */
+	const char *like;
+	/*! return only this column */
+	const char *column;
+	/*! registrations: only this user */
+	const char *reg_user;
+	/*! registrations: only this realm */
+	const char *realm;
+	/*! only rows whose hostname column (the a leg's for calls) matches, like the SQL "where hostname=" */
+	const char *hostname;
+	/*! calls: only rows with a b leg */
+	switch_bool_t bridged;
+	/*! return a single row holding the row count */
+	switch_bool_t count;
+} switch_core_table_query_t;
+
+/*!
+ \brief Check if the in-memory core channels, calls and registrations tables are enabled
+*/
+SWITCH_DECLARE(switch_bool_t) switch_core_memory_tables_enabled(void);
+/*!
+ \brief Query the in-memory core tables
+ \note rows come in the order the SQL the show commands run sorts them: channels by created_epoch,
+ calls by call_created_epoch with the unbridged channels first
+ \param [in] query what to read
+ \param [in] callback called per row with the same columns the matching SQL table or view returns
+ \param [in] pdata user data for the callback
+ \return SWITCH_STATUS_FALSE if the in-memory tables are not enabled
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_memory_table_query(switch_core_table_query_t *query, switch_core_db_callback_func_t callback, void *pdata);
+
 /*!
  \brief Get RTP port range start value
  \param[in] void
@@ -2912,6 +3000,38 @@ SWITCH_DECLARE(void) switch_sql_queue_manager_resume(switch_sql_queue_manager_t
 SWITCH_DECLARE(int) switch_sql_queue_manager_size(switch_sql_queue_manager_t *qm, uint32_t index);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_confirm(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup);
+/*!
+  \brief Queue a parameterized statement on a SQL queue manager
+  \param qm the queue manager
+  \param sql the statement template, each ? is bound to the next parameter
+  \param pos the queue index
+  \param argc the number of parameters
+  \param argv the parameters (copied), a NULL entry binds SQL NULL
+  \return SWITCH_STATUS_SUCCESS if the statement was queued
+  \note core db handles execute the template as a cached prepared statement, other backends get the
+  parameters escaped into the text.  The template must not contain a literal ? outside of placeholders.
+*/
+SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_params(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos,
+																	 int argc, const char * const *argv);
+
+typedef struct {
+	uint32_t depth;
+	uint32_t last_batch;
+	uint32_t max_batch;
+	uint64_t batches;
+	uint64_t statements;
+	uint64_t errors;
+	uint64_t prepared_hits;
+	uint64_t prepared_misses;
+	switch_time_t last_flush_us;
+	switch_time_t max_flush_us;
+	switch_time_t avg_flush_us;
+} switch_sql_queue_manager_stats_t;
+
+/*!
+  \brief Read the queue depth, batch size and flush latency counters of a SQL queue manager
+*/
+SWITCH_DECLARE(void) switch_sql_queue_manager_stats(switch_sql_queue_manager_t *qm, switch_sql_queue_manager_stats_t *stats);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_destroy(switch_sql_queue_manager_t **qmp);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_init_name(const char *name,
 																   switch_sql_queue_manager_t **qmp,
@@ -2963,6 +3083,16 @@ SWITCH_DECLARE(int) switch_spawn(const char *cmd, switch_bool_t wait);
 SWITCH_DECLARE(int) switch_stream_spawn(const char *cmd, switch_bool_t shell, switch_bool_t wait, switch_stream_handle_t *stream);
 
 SWITCH_DECLARE(void) switch_core_session_debug_pool(switch_stream_handle_t *stream);
+/*!
+  \brief Configure the session thread pool
+  \param work_stealing run the session state machine as tasks on a bounded work stealing pool, only media states keep a worker of their own
+  \param stack_size stack size of new work stealing workers in bytes, at least SWITCH_THREAD_STACKSIZE, 0 to leave unchanged
+  \param max_threads maximum number of work stealing workers, 0 to leave unchanged
+  \return SWITCH_STATUS_FALSE if the stack size is too small
+
+  Tasks already queued are moved over to the workers of the new mode.
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_session_thread_pool_config(switch_bool_t work_stealing, switch_size_t stack_size, uint32_t max_threads);
 
 SWITCH_DECLARE(switch_status_t) switch_core_session_override_io_routines(switch_core_session_t *session, switch_io_routines_t *ior);
 
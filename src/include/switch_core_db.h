@@ -304,6 +304,13 @@ SWITCH_DECLARE(int) switch_core_db_step(switch_core_db_stmt_t *stmt);
  */
 SWITCH_DECLARE(int) switch_core_db_reset(switch_core_db_stmt_t *pStmt);
 
+/**
+ * The switch_core_db_clear_bindings() function sets every parameter of a
+ * compiled SQL statement back to NULL.  Call it after switch_core_db_reset()
+ * when the bound values do not outlive the statement.
+ */
+SWITCH_DECLARE(int) switch_core_db_clear_bindings(switch_core_db_stmt_t *pStmt);
+
 /**
  * In the SQL strings input to switch_core_db_prepare(),
  * one or more literals can be replace by parameters "?" or ":AAA" or
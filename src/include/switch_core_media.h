@@ -229,6 +229,28 @@ typedef struct switch_fork_state_s {
 	uint8_t			start_event_fired;
 } switch_fork_state_t;
 
+typedef enum {
+	SWITCH_XCODE_NONE,
+	SWITCH_XCODE_ULAW_ALAW,
+	SWITCH_XCODE_ALAW_ULAW,
+	SWITCH_XCODE_G711_WIDE,
+	SWITCH_XCODE_WIDE_G711
+} switch_xcode_path_t;
+
+#define SWITCH_XCODE_HIST 10
+
+/*! \brief direct transcoding between G.711, G.722 and 16kHz L16 without the generic decode, resample, encode chain */
+typedef struct switch_xcode_s {
+	const switch_codec_implementation_t *from;
+	const switch_codec_implementation_t *to;
+	switch_xcode_path_t path;
+	/* 'u' PCMU, 'a' PCMA, 'g' G722, 'l' 16kHz L16 */
+	char from_kind;
+	char to_kind;
+	/* 2:1 half band filter history */
+	int16_t hist[SWITCH_XCODE_HIST];
+} switch_xcode_t;
+
 
 SWITCH_DECLARE(switch_status_t) switch_media_handle_create(switch_media_handle_t **smhp, switch_core_session_t *session, switch_core_media_params_t *params);
 SWITCH_DECLARE(void) switch_media_handle_destroy(switch_core_session_t *session);
@@ -455,6 +477,29 @@ typedef struct switch_rtp_engine_s switch_rtp_engine_t;
 SWITCH_DECLARE(switch_rtp_engine_t *) switch_core_media_get_engine(switch_core_session_t *session, int media_type);
 SWITCH_DECLARE(switch_codec_t*) switch_core_media_get_codec(switch_core_session_t *session, switch_media_type_t type);
 
+/*!
+  \brief Pick a direct transcoding path between two implementations and reset its state
+  \param xc the transcoder state
+  \param from the implementation of the incoming frames
+  \param to the implementation to write
+  \return SWITCH_XCODE_NONE when the pair has to go through the generic path
+*/
+SWITCH_DECLARE(switch_xcode_path_t) switch_core_media_xcode_select(switch_xcode_t *xc, const switch_codec_implementation_t *from, const switch_codec_implementation_t *to);
+
+/*!
+  \brief Transcode one packet over the path picked by switch_core_media_xcode_select
+  \param xc the transcoder state
+  \param from_codec the codec of the incoming frame, used to decode G.722
+  \param to_codec the codec to write, used to encode G.722
+  \param in the encoded input
+  \param in_len the input length in bytes
+  \param out the encoded output
+  \param out_len the size of out, set to the output length
+  \return SWITCH_STATUS_SUCCESS or SWITCH_STATUS_FALSE if the packet does not fit the path
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_media_xcode(switch_xcode_t *xc, switch_codec_t *from_codec, switch_codec_t *to_codec,
+														const void *in, uint32_t in_len, void *out, uint32_t *out_len);
+
 SWITCH_END_EXTERN_C
 #endif
 /* For Emacs:
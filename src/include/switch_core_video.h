@@ -296,6 +296,43 @@ SWITCH_DECLARE(void) switch_img_rotate(switch_image_t **img, switch_image_rotati
 */
 SWITCH_DECLARE(void) switch_img_free(switch_image_t **img);
 
+/*!\brief Take another reference on an image
+*
+* Images from switch_img_alloc carry a reference count, each switch_img_free
+* drops one and the last one returns the image to the image pool.
+* Anything else (wrapped or codec owned images) is copied instead.
+*
+* \param[in]    img       Image descriptor
+*
+* \return img itself, or a copy the caller has to free
+*/
+SWITCH_DECLARE(switch_image_t *) switch_img_ref(switch_image_t *img);
+
+typedef struct {
+	/*! bytes of released images the pool may keep, 0 disables the pool */
+	switch_size_t max_bytes;
+	/*! bytes of released images kept */
+	switch_size_t bytes;
+	/*! number of released images kept */
+	uint32_t images;
+	/*! allocations served from the pool */
+	uint64_t hits;
+	/*! allocations that had to allocate a new image */
+	uint64_t misses;
+	/*! released images freed to stay under max_bytes */
+	uint64_t evictions;
+} switch_img_pool_stats_t;
+
+/*!\brief Size the pool of released images reused by switch_img_alloc
+*
+* Released images are kept per (format, width, height, alignment).
+*
+* \param[in]    max_bytes bytes of images to keep, 0 disables the pool and empties it
+*/
+SWITCH_DECLARE(void) switch_img_pool_set_limits(switch_size_t max_bytes);
+SWITCH_DECLARE(void) switch_img_pool_get_stats(switch_img_pool_stats_t *stats);
+SWITCH_DECLARE(void) switch_img_pool_flush(void);
+
 SWITCH_DECLARE(void) switch_img_draw_text(switch_image_t *IMG, int x, int y, switch_rgb_color_t color, uint16_t font_size, char *text);
 
 SWITCH_DECLARE(void) switch_img_add_text(void *buffer, int w, int x, int y, char *s);
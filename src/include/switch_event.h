@@ -100,6 +100,14 @@ struct switch_event {
 	unsigned long key;
 	struct switch_event *next;
 	int flags;
+	/*! optional header name index, see switch_event_index_headers */
+	switch_hash_t *header_index;
+	/*! read-only headers shared with other events, linked after last_header, see switch_event_link_shared */
+	switch_event_shared_t *shared;
+	/*! the last shared set copied by switch_event_unshare, kept until destroy for callers still walking its headers */
+	switch_event_shared_t *shared_held;
+	/*! the private header the shared set was linked after, NULL when it came first; serializers put the set back there */
+	switch_event_header_t *shared_after;
 };
 
 typedef struct switch_serial_event_s {
@@ -169,6 +177,41 @@ SWITCH_DECLARE(switch_status_t) switch_event_set_priority(switch_event_t *event,
 */
 
 SWITCH_DECLARE(switch_event_header_t *) switch_event_get_header_ptr(switch_event_t *event, const char *header_name);
+
+/*!
+  \brief Maintain a hash index of the header names of an event so header lookups don't walk the list
+  \param event the event to index
+  \return SWITCH_STATUS_SUCCESS if the event is indexed
+  \note meant for long lived events with many headers like channel variables, the index is not carried over by switch_event_dup
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_index_headers(switch_event_t *event);
+
+/*!
+  \brief Turn an event into an immutable, reference counted set of headers other events can link to
+  \param event the event to share, it belongs to the shared set afterwards and is set to NULL
+  \return the shared set holding one reference, release it with switch_event_shared_release
+*/
+SWITCH_DECLARE(switch_event_shared_t *) switch_event_share(switch_event_t **event);
+SWITCH_DECLARE(switch_event_shared_t *) switch_event_shared_ref(switch_event_shared_t *shared);
+SWITCH_DECLARE(void) switch_event_shared_release(switch_event_shared_t **sharedP);
+/*! \brief the first header of a shared set, the list must not be modified */
+SWITCH_DECLARE(switch_event_header_t *) switch_event_shared_headers(switch_event_shared_t *shared);
+SWITCH_DECLARE(const char *) switch_event_shared_get_header(switch_event_shared_t *shared, const char *header_name);
+
+/*!
+  \brief Append the headers of a shared set to an event without copying them
+  \param event the event
+  \param shared the shared set, the event takes its own reference
+  \note the headers show up in event->headers after the event's own ones, changing or deleting one of them
+  copies the set into the event first (see switch_event_unshare)
+*/
+SWITCH_DECLARE(void) switch_event_link_shared(switch_event_t *event, switch_event_shared_t *shared);
+
+/*!
+  \brief Replace the shared headers of an event with private copies
+  \param event the event
+*/
+SWITCH_DECLARE(void) switch_event_unshare(switch_event_t *event);
 _Ret_opt_z_ SWITCH_DECLARE(char *) switch_event_get_header_idx(switch_event_t *event, const char *header_name, int idx);
 #define switch_event_get_header(_e, _h) switch_event_get_header_idx(_e, _h, -1)
 
@@ -303,6 +303,62 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_record_session(switch_core_session_t
 SWITCH_DECLARE(switch_status_t) switch_ivr_record_session_event(switch_core_session_t *session, const char *file, uint32_t limit, switch_file_handle_t *fh, switch_event_t *variables);
 SWITCH_DECLARE(switch_status_t) switch_ivr_transfer_recordings(switch_core_session_t *orig_session, switch_core_session_t *new_session);
 
+typedef enum {
+	/*! drop the newest audio when a recording queue is full */
+	SWITCH_RECORD_BACKPRESSURE_DROP,
+	/*! let the media thread wait up to one packet for room, then drop */
+	SWITCH_RECORD_BACKPRESSURE_WAIT
+} switch_record_backpressure_t;
+
+typedef struct {
+	/*! writer threads */
+	uint32_t threads;
+	/*! recordings currently using the pool */
+	uint32_t recordings;
+	/*! recordings waiting for a writer */
+	uint32_t ready;
+	/*! blocks handed to the format modules */
+	uint64_t blocks;
+	/*! bytes of audio written */
+	uint64_t bytes;
+	/*! frames dropped because a queue was full */
+	uint64_t drops;
+	/*! bytes of audio dropped */
+	uint64_t dropped_bytes;
+	/*! failed block writes */
+	uint64_t write_errors;
+	/*! time the last block waited for a writer, in ms */
+	uint32_t lag_ms;
+	/*! longest time a block waited for a writer, in ms */
+	uint32_t max_lag_ms;
+	/*! most audio queued for one recording when a writer picked it up, in ms */
+	uint32_t max_backlog_ms;
+} switch_record_writer_stats_t;
+
+/*!
+  \brief Write recordings through a shared pool of writer threads instead of one thread per recording
+  \param threads number of writer threads (encoding happens on these threads, in the format module)
+  \param queue_ms per recording queue bound, in ms of audio
+  \param block_bytes write granularity, audio is handed to the format module in blocks of this size
+  \param flush_ms hand a partial block to a writer once its oldest audio is this old
+  \param policy what the media thread does when a recording queue is full
+  \return SWITCH_STATUS_SUCCESS if the pool is running (an already running pool takes the new limits)
+*/
+SWITCH_DECLARE(switch_status_t) switch_ivr_record_writers_start(uint32_t threads, uint32_t queue_ms, switch_size_t block_bytes, uint32_t flush_ms,
+																 switch_record_backpressure_t policy);
+
+/*!
+  \brief Stop the recording writer pool once every queued block is written
+*/
+SWITCH_DECLARE(void) switch_ivr_record_writers_stop(void);
+
+/*!
+  \brief Fill in the recording writer pool statistics
+  \param stats the statistics to fill in
+  \return SWITCH_STATUS_SUCCESS if the pool is running
+*/
+SWITCH_DECLARE(switch_status_t) switch_ivr_record_writer_stats(switch_record_writer_stats_t *stats);
+
 
 SWITCH_DECLARE(switch_status_t) switch_ivr_eavesdrop_pop_eavesdropper(switch_core_session_t *session, switch_core_session_t **sessionp);
 SWITCH_DECLARE(switch_status_t) switch_ivr_eavesdrop_exec_all(switch_core_session_t *session, const char *app, const char *arg);
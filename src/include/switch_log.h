@@ -226,6 +226,65 @@ SWITCH_DECLARE(uint32_t) switch_log_str2mask(_In_z_ const char *str);
 SWITCH_DECLARE(switch_log_node_t *) switch_log_node_dup(const switch_log_node_t *node);
 SWITCH_DECLARE(void) switch_log_node_free(switch_log_node_t **pnode);
 
+/*! \brief Log ring statistics
+ */
+typedef struct {
+	/*! Number of producer rings */
+	uint32_t rings;
+	/*! Slots per ring */
+	uint32_t slots;
+	/*! Number of sink threads draining the rings */
+	uint32_t sinks;
+	/*! Records currently waiting in the rings */
+	uint32_t depth;
+	/*! Records accepted into a ring */
+	uint32_t queued;
+	/*! Records dropped because their ring was full */
+	uint32_t dropped;
+	/*! Records formatted by a sink thread */
+	uint32_t deferred;
+	/*! Records formatted by the producer because the format could not be deferred */
+	uint32_t preformatted;
+	/*! Records written to the binary log */
+	uint32_t binary_records;
+	/*! Binary log write failures */
+	uint32_t binary_errors;
+} switch_log_ring_stats_t;
+
+/*!
+  \brief Switch the logger to per-thread rings drained by a pool of sink threads
+  \param rings number of producer rings (threads are spread over them by thread id)
+  \param slots records per ring, rounded up to a power of two
+  \param sinks number of sink threads formatting and dispatching records
+  \return SWITCH_STATUS_SUCCESS if the rings were started
+  \note producers capture the format string and its arguments and never block; a full ring drops the record
+*/
+SWITCH_DECLARE(switch_status_t) switch_log_rings_start(uint32_t rings, uint32_t slots, uint32_t sinks);
+
+/*!
+  \brief Fill in the log ring statistics
+  \param stats the statistics to fill in
+  \return SWITCH_STATUS_SUCCESS if the rings are running
+*/
+SWITCH_DECLARE(switch_status_t) switch_log_ring_stats(switch_log_ring_stats_t *stats);
+
+/*!
+  \brief Write every ring record to a compact binary log (format string + arguments, unformatted)
+  \param path the file to append to, NULL or empty to close the current one
+  \return SWITCH_STATUS_SUCCESS on success
+*/
+SWITCH_DECLARE(switch_status_t) switch_log_binary_open(const char *path);
+
+/*!
+  \brief Decode a binary log back to text lines as the console would show them
+  \param in the binary log
+  \param out where to write the text
+  \param level only output records at or below this level
+  \param uuid only output records for this uuid (NULL for all)
+  \return SWITCH_STATUS_SUCCESS if the whole file was decoded
+*/
+SWITCH_DECLARE(switch_status_t) switch_log_binary_decode(FILE *in, FILE *out, switch_log_level_t level, const char *uuid);
+
 ///\}
 SWITCH_END_EXTERN_C
 #endif
@@ -385,6 +385,12 @@ struct switch_file_handle {
 	int64_t vpos;
 	void *muxbuf;
 	switch_size_t muxlen;
+	/*! decoded audio served from the core prompt cache instead of the format module */
+	struct switch_prompt_cache_entry *prompt_entry;
+	/*! decoded audio being captured for the core prompt cache */
+	struct switch_prompt_cache_fill *prompt_fill;
+	/*! read position in prompt_entry, in samples */
+	switch_size_t prompt_pos;
 };
 
 /*! \brief Abstract interface to an asr module */
@@ -609,6 +609,7 @@ SWITCH_DECLARE_DATA extern switch_filenames SWITCH_GLOBAL_filenames;
 #define SWITCH_MAX_STATE_HANDLERS 30
 #define SWITCH_CORE_QUEUE_LEN 100000
 #define SWITCH_MAX_MANAGEMENT_BUFFER_LEN 1024 * 8
+#define SWITCH_EXPAND_TEMPLATE_CACHE_SIZE 1024
 
 #define SWITCH_ACCEPTABLE_INTERVAL(_i) (_i && _i <= SWITCH_MAX_INTERVAL && (_i % 10) == 0)
 
@@ -776,6 +777,7 @@ typedef struct {
 	uint32_t last_recv_lsr_peer;  /* RTT calculation, When receiving an SR we extract the middle 32bits of the remote NTP timestamp to include it in the next SR LSR */
 	double rtt_avg;               /* RTT average */
 	uint32_t init;
+	uint32_t peer_max_bitrate;    /* Bitrate (bps) the peer last asked for with TMMBR or estimated with REMB, 0 if it never did */
 } switch_rtcp_numbers_t;
 
 typedef struct {
@@ -2395,6 +2397,12 @@ typedef int switch_os_socket_t;
 #define SWITCH_SOCK_INVALID -1
 #endif
 
+#ifdef WIN32
+typedef HANDLE switch_os_file_t;
+#else
+typedef int switch_os_file_t;
+#endif
+
 typedef struct fspr_pool_t switch_memory_pool_t;
 typedef void* switch_plc_state_t;
 typedef uint16_t switch_port_t;
@@ -2411,6 +2419,8 @@ typedef struct switch_loadable_module switch_loadable_module_t;
 typedef struct switch_frame switch_frame_t;
 typedef struct switch_rtcp_frame switch_rtcp_frame_t;
 typedef struct switch_channel switch_channel_t;
+typedef struct switch_expand_template_s switch_expand_template_t;
+typedef struct switch_event_shared_s switch_event_shared_t;
 typedef struct switch_sql_queue_manager switch_sql_queue_manager_t;
 typedef struct switch_file_handle switch_file_handle_t;
 typedef struct switch_caller_profile switch_caller_profile_t;
@@ -47,8 +47,24 @@ SWITCH_DECLARE(switch_vad_t *) switch_vad_init(int sample_rate, int channels);
 */
 
 SWITCH_DECLARE(int) switch_vad_set_mode(switch_vad_t *vad, int mode);
+/*
+ * Params are silence_ms, voice_ms, thresh, debug and gmm.  gmm 0-3 replaces the energy threshold with the
+ * GMM speech/noise classifier at that aggressiveness, -1 turns it off again.  fvad, when enabled, takes precedence.
+*/
 SWITCH_DECLARE(void) switch_vad_set_param(switch_vad_t *vad, const char *key, int val);
 SWITCH_DECLARE(switch_vad_state_t) switch_vad_process(switch_vad_t *vad, int16_t *data, unsigned int samples);
+
+/*
+ * Process one frame for each of count streams in one call, states[i] gets the result of vads[i].
+ * Gives the same results as calling switch_vad_process() for each stream.
+*/
+SWITCH_DECLARE(void) switch_vad_process_batch(switch_vad_t **vads, int16_t **data, const unsigned int *samples, switch_vad_state_t *states, int count);
+
+/*
+ * The energy kernels are picked at runtime ("avx2", "sse2" or "scalar"), "auto" or NULL picks the best one the CPU supports.
+*/
+SWITCH_DECLARE(switch_status_t) switch_vad_set_kernel(const char *name);
+SWITCH_DECLARE(const char *) switch_vad_get_kernel(void);
 SWITCH_DECLARE(switch_vad_state_t) switch_vad_get_state(switch_vad_t *vad);
 SWITCH_DECLARE(void) switch_vad_reset(switch_vad_t *vad);
 SWITCH_DECLARE(void) switch_vad_destroy(switch_vad_t **vad);
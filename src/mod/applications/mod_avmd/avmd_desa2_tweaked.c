@@ -18,6 +18,10 @@
 #endif
 
 #include "avmd_buffer.h"
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
 #include "avmd_options.h"
 
 #ifndef AVMD_FAST_MATH
@@ -69,3 +73,40 @@ avmd_desa2_tweaked(circ_buffer_t *b, size_t i, double *amplitude) {
 	*amplitude = 2.0 * PSI_Xn / sqrt(PSI_Yn);
 	return result;
 }
+
+void
+avmd_desa2_tweaked_block(const double *x, size_t n, double *omega, double *amplitude) {
+	size_t k = 0;
+
+#if defined(__SSE2__)
+	const __m128d two = _mm_set1_pd(2.0);
+
+	for (; k + 2 <= n; k += 2) {
+		__m128d x0 = _mm_loadu_pd(x + k);
+		__m128d x1 = _mm_loadu_pd(x + k + 1);
+		__m128d x2 = _mm_loadu_pd(x + k + 2);
+		__m128d x3 = _mm_loadu_pd(x + k + 3);
+		__m128d x4 = _mm_loadu_pd(x + k + 4);
+		__m128d x2sq = _mm_mul_pd(x2, x2);
+		__m128d d = _mm_mul_pd(two, _mm_sub_pd(x2sq, _mm_mul_pd(x1, x3)));
+		__m128d psi_x = _mm_sub_pd(x2sq, _mm_mul_pd(x0, x4));
+		__m128d needed = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(x1, x1), _mm_mul_pd(x0, x2)), _mm_sub_pd(_mm_mul_pd(x3, x3), _mm_mul_pd(x2, x4)));
+		__m128d psi_y = _mm_add_pd(needed, psi_x);
+
+		_mm_storeu_pd(omega + k, _mm_div_pd(_mm_sub_pd(psi_x, needed), d));
+		_mm_storeu_pd(amplitude + k, _mm_div_pd(_mm_mul_pd(two, psi_x), _mm_sqrt_pd(psi_y)));
+	}
+#endif
+
+	/* same operation order as avmd_desa2_tweaked so both give identical results */
+	for (; k < n; k++) {
+		double x0 = x[k], x1 = x[k + 1], x2 = x[k + 2], x3 = x[k + 3], x4 = x[k + 4];
+		double x2sq = x2 * x2;
+		double d = 2.0 * ((x2sq) - (x1 * x3));
+		double psi_x = ((x2sq) - (x0 * x4));
+		double needed = ((x1 * x1) - (x0 * x2)) + ((x3 * x3) - (x2 * x4));
+
+		omega[k] = (psi_x - needed) / d;
+		amplitude[k] = 2.0 * psi_x / sqrt(needed + psi_x);
+	}
+}
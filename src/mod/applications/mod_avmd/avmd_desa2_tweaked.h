@@ -47,5 +47,13 @@
  */
 double avmd_desa2_tweaked(circ_buffer_t *b, size_t i, double *amplitude) __attribute__ ((nonnull(1,3)));
 
+/* Block version of avmd_desa2_tweaked for n consecutive positions.
+ * x holds n + 4 contiguous samples, omega[k] and amplitude[k]
+ * receive the results for the window starting at x[k], exactly
+ * as avmd_desa2_tweaked would compute them. Uses SSE2 when
+ * the compiler targets it.
+ */
+void avmd_desa2_tweaked_block(const double *x, size_t n, double *omega, double *amplitude) __attribute__ ((nonnull(1,3,4)));
+
 
 #endif  /* __AVMD_DESA2_TWEAKED_H__ */
@@ -105,7 +105,7 @@
 #define AVMD_AMPLITUDE_RSD_THRESHOLD (0.0148)
 
 /*! Syntax of the API call. */
-#define AVMD_SYNTAX "<uuid> < start | stop | set [inbound|outbound|default] | get [sessions|detectors] | load [inbound|outbound] | reload | show >"
+#define AVMD_SYNTAX "<uuid> < start | stop | set [inbound|outbound|default] | get [sessions|detectors|workers] | load [inbound|outbound] | reload | show >"
 
 /*! Number of expected parameters in api call. */
 #define AVMD_PARAMS_API_MIN 1u
@@ -114,6 +114,9 @@
 #define AVMD_PARAMS_APP_START_MIN 0u
 #define AVMD_PARAMS_APP_START_MAX 20u
 
+/*! Frames waiting for a worker, when full the media thread runs its detectors itself. */
+#define AVMD_WORK_QUEUE_LEN 16384
+
 #define AVMD_READ_REPLACE	0
 #define AVMD_WRITE_REPLACE	1
 
@@ -176,6 +179,8 @@ struct avmd_settings {
     uint8_t     detectors_n;
     uint8_t     detectors_lagged_n;
     uint16_t    detectors_idle_time;
+    uint16_t    workers_n;      /* global only, read at module load */
+    uint8_t     workers_pin;    /* global only, read at module load */
 };
 
 /*! Status of the beep detection */
@@ -209,16 +214,12 @@ struct avmd_buffer {
     size_t samples_streak, samples_streak_amp; /* number of DESA samples in single streak without reset needed to validate SMA estimator */
 };
 
+/*! A detector is not a thread, its state is advanced by a worker of the shared pool once per frame. */
 struct avmd_detector {
-    switch_thread_t *thread;
-    switch_mutex_t  *mutex;
-    uint8_t                     flag_processing_done;
-    uint8_t                     flag_should_exit;
     enum avmd_detection_mode    result;
-    switch_thread_cond_t        *cond_start_processing;
     struct avmd_buffer          buffer;
     avmd_session_t              *s;
-    size_t                      samples;
+    size_t                      pos;
     uint8_t                     idx;
     uint8_t                     lagged, lag;
 };
@@ -242,6 +243,31 @@ struct avmd_session {
     switch_thread_cond_t    *cond_detectors_done;
     struct avmd_detector    *detectors;
     uint8_t closed;
+
+    /* frame handed to the worker pool, the next one waits until it is done */
+    uint8_t         task_pending;
+    size_t          task_samples;
+    size_t          task_pos;
+
+    /* DESA-2 results of the current frame, shared by all detectors reading at task_pos */
+    size_t          block_len;
+    double          *block_x;
+    double          *block_omega;
+    double          *block_amplitude;
+
+    /* per frame processing cost [us] */
+    size_t          cost_frames;
+    uint64_t        cost_total;
+    uint32_t        cost_max;
+};
+
+/*! Worker of the shared detection pool. */
+struct avmd_worker {
+    switch_thread_t *thread;
+    int             cpu;
+    uint64_t        frames;
+    uint64_t        cost_total;
+    uint32_t        cost_max;
 };
 
 static struct avmd_globals
@@ -251,6 +277,11 @@ static struct avmd_globals
     switch_memory_pool_t    *pool;
     size_t                  session_n;
     size_t                  detectors_n;
+
+    struct avmd_worker      *workers;
+    uint16_t                workers_n;
+    switch_queue_t          *work_queue;
+    uint64_t                work_inline;
 } avmd_globals;
 
 static void avmd_process(avmd_session_t *session, switch_frame_t *frame, uint8_t direction);
@@ -265,7 +296,7 @@ static void avmd_fire_event(enum avmd_event type, switch_core_session_t *fs_s, d
 
 static void avmd_fire_failed_event(switch_core_session_t *fs_s);
 
-static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buffer_t *b, size_t sample_n, size_t pos, struct avmd_detector *d);
+static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, double omega, double amplitude, struct avmd_detector *d);
 
 /* API [set default], reset to factory settings */
 static void avmd_set_xml_default_configuration(switch_mutex_t *mutex);
@@ -286,9 +317,13 @@ static void avmd_reloadxml_event_handler(switch_event_t *event);
 
 /* API command */
 static void avmd_show(switch_stream_handle_t *stream, switch_mutex_t *mutex);
+static void avmd_show_workers(switch_stream_handle_t *stream);
 
 static void* SWITCH_THREAD_FUNC
-avmd_detector_func(switch_thread_t *thread, void *arg);
+avmd_worker_func(switch_thread_t *thread, void *arg);
+
+static void
+avmd_detectors_run(avmd_session_t *s);
 
 static uint8_t
 avmd_detection_in_progress(avmd_session_t *s);
@@ -296,53 +331,138 @@ avmd_detection_in_progress(avmd_session_t *s);
 static switch_status_t avmd_launch_threads(avmd_session_t *s, switch_core_session_t *session) {
     uint8_t                 idx;
     struct avmd_detector    *d;
-    switch_threadattr_t     *thd_attr = NULL;
+
+    if (avmd_globals.work_queue == NULL) {
+        return SWITCH_STATUS_FALSE;
+    }
 
     idx = 0;
-    while (idx < s->settings.detectors_n) {
+    while (idx < s->settings.detectors_n + s->settings.detectors_lagged_n) {
         d = &s->detectors[idx];
-        d->flag_processing_done = 1;
-        d->flag_should_exit = 0;
         d->result = AVMD_DETECT_NONE;
-        d->lagged = 0;
-        d->lag = 0;
-        switch_threadattr_create(&thd_attr, switch_core_session_get_pool(session));
-        switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-        if (switch_thread_create(&d->thread, thd_attr, avmd_detector_func, d, switch_core_session_get_pool(session)) != SWITCH_STATUS_SUCCESS) {
-            return SWITCH_STATUS_FALSE;
+        d->pos = s->pos;
+        if (idx < s->settings.detectors_n) {
+            d->lagged = 0;
+            d->lag = 0;
+        } else {
+            d->lagged = 1;
+            d->lag = idx - s->settings.detectors_n + 1;
         }
+        ++idx;
+    }
+
+    if (s->settings.debug) {
+        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: %u detectors (%u lagged) queued on %u workers\n",
+                s->settings.detectors_n + s->settings.detectors_lagged_n, s->settings.detectors_lagged_n, avmd_globals.workers_n);
+    }
+
+    return SWITCH_STATUS_SUCCESS;
+}
 
-        if (s->settings.debug) {
-            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: started thread idx=%u\n", idx);
+/*! \brief Run one queued frame of a session through all of its detectors.
+ * @details Called by a pool worker, or by the media thread itself when the queue is full.
+ */
+static void avmd_task_run(avmd_session_t *s, struct avmd_worker *w) {
+    switch_time_t   start = switch_time_ref();
+    uint32_t        cost;
+
+    avmd_detectors_run(s);
+
+    cost = (uint32_t) (switch_time_ref() - start);
+
+    if (w != NULL) {
+        w->frames++;
+        w->cost_total += cost;
+        if (cost > w->cost_max) {
+            w->cost_max = cost;
         }
+    }
 
-        ++idx;
+    switch_mutex_lock(s->mutex_detectors_done);
+    s->cost_frames++;
+    s->cost_total += cost;
+    if (cost > s->cost_max) {
+        s->cost_max = cost;
     }
+    s->task_pending = 0;
+    switch_thread_cond_signal(s->cond_detectors_done);
+    switch_mutex_unlock(s->mutex_detectors_done);
+}
 
-    idx = 0;
-    while (idx < s->settings.detectors_lagged_n) {
-        d = &s->detectors[s->settings.detectors_n + idx];
-        d->flag_processing_done = 1;
-        d->flag_should_exit = 0;
-        d->result = AVMD_DETECT_NONE;
-        d->lagged = 1;
-        d->lag = idx + 1;
-        switch_threadattr_create(&thd_attr, switch_core_session_get_pool(session));
-        switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-        if (switch_thread_create(&d->thread, thd_attr, avmd_detector_func, d, switch_core_session_get_pool(session)) != SWITCH_STATUS_SUCCESS) {
-            return SWITCH_STATUS_FALSE;
-        }
+static void* SWITCH_THREAD_FUNC
+avmd_worker_func(switch_thread_t *thread, void *arg) {
+    struct avmd_worker  *w = (struct avmd_worker *) arg;
+    void                *pop = NULL;
+
+    if (w->cpu > -1) {
+        switch_core_thread_set_cpu_affinity(w->cpu);
+    }
 
-        if (s->settings.debug) {
-            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: started lagged thread idx=%u\n", s->settings.detectors_n + idx);
+    while (switch_queue_pop(avmd_globals.work_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+        if (pop == NULL) {
+            break;
         }
+        avmd_task_run((avmd_session_t *) pop, w);
+    }
 
-        ++idx;
+    return NULL;
+}
+
+static switch_status_t avmd_workers_start(switch_memory_pool_t *pool) {
+    switch_threadattr_t *thd_attr = NULL;
+    uint32_t            cpu_n = switch_core_cpu_count();
+    uint16_t            idx;
+
+    avmd_globals.workers_n = avmd_globals.settings.workers_n;
+    if (avmd_globals.workers_n == 0) {
+        avmd_globals.workers_n = cpu_n > 0 ? cpu_n : 1;
+    }
+
+    if (switch_queue_create(&avmd_globals.work_queue, AVMD_WORK_QUEUE_LEN, pool) != SWITCH_STATUS_SUCCESS) {
+        return SWITCH_STATUS_FALSE;
     }
 
+    avmd_globals.workers = switch_core_alloc(pool, avmd_globals.workers_n * sizeof(struct avmd_worker));
+    for (idx = 0; idx < avmd_globals.workers_n; ++idx) {
+        struct avmd_worker *w = &avmd_globals.workers[idx];
+
+        w->cpu = (avmd_globals.settings.workers_pin && cpu_n > 0) ? (int) (idx % cpu_n) : -1;
+        switch_threadattr_create(&thd_attr, pool);
+        switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+        if (switch_thread_create(&w->thread, thd_attr, avmd_worker_func, w, pool) != SWITCH_STATUS_SUCCESS) {
+            w->thread = NULL;
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't start avmd worker [%u]\n", idx);
+        }
+    }
+
+    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Avmd detection pool started with %u workers%s\n",
+            avmd_globals.workers_n, avmd_globals.settings.workers_pin ? " pinned to cores" : "");
+
     return SWITCH_STATUS_SUCCESS;
 }
 
+static void avmd_workers_stop(void) {
+    switch_status_t st;
+    uint16_t        idx;
+
+    if (avmd_globals.work_queue == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < avmd_globals.workers_n; ++idx) {
+        switch_queue_push(avmd_globals.work_queue, NULL);
+    }
+
+    for (idx = 0; idx < avmd_globals.workers_n; ++idx) {
+        if (avmd_globals.workers[idx].thread != NULL) {
+            switch_thread_join(&st, avmd_globals.workers[idx].thread);
+            avmd_globals.workers[idx].thread = NULL;
+        }
+    }
+
+    avmd_globals.work_queue = NULL;
+}
+
 static switch_status_t avmd_init_buffer(struct avmd_buffer *b, size_t buf_sz, uint8_t resolution, uint8_t offset, switch_core_session_t *fs_session) {
     INIT_SMA_BUFFER(&b->sma_b, buf_sz, fs_session);
     if (b->sma_b.data == NULL) {
@@ -448,12 +568,8 @@ static switch_status_t init_avmd_session_data(avmd_session_t *avmd_session, swit
                 goto end;
             }
             d->s = avmd_session;
-            d->flag_processing_done = 1;
-            d->flag_should_exit = 1;
+            d->result = AVMD_DETECT_NONE;
             d->idx = idx;
-            d->thread = NULL;
-            switch_mutex_init(&d->mutex, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
-            switch_thread_cond_create(&d->cond_start_processing, switch_core_session_get_pool(fs_session));
             ++offset;
             ++idx;
         }
@@ -468,14 +584,19 @@ static switch_status_t init_avmd_session_data(avmd_session_t *avmd_session, swit
                 goto end;
             }
             d->s = avmd_session;
-            d->flag_processing_done = 1;
-            d->flag_should_exit = 1;
+            d->result = AVMD_DETECT_NONE;
             d->idx = avmd_session->settings.detectors_n + idx;
-            d->thread = NULL;
-            switch_mutex_init(&d->mutex, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
-            switch_thread_cond_create(&d->cond_start_processing, switch_core_session_get_pool(fs_session));
             ++idx;
     }
+    avmd_session->block_len = avmd_session->b.buf_len;
+    avmd_session->block_x = (double *) switch_core_session_alloc(fs_session, (avmd_session->block_len + AVMD_P) * sizeof(double));
+    avmd_session->block_omega = (double *) switch_core_session_alloc(fs_session, avmd_session->block_len * sizeof(double));
+    avmd_session->block_amplitude = (double *) switch_core_session_alloc(fs_session, avmd_session->block_len * sizeof(double));
+    if (avmd_session->block_x == NULL || avmd_session->block_omega == NULL || avmd_session->block_amplitude == NULL) {
+        status = SWITCH_STATUS_MEMERR;
+        goto end;
+    }
+    avmd_session->task_pending = 0;
     switch_mutex_init(&avmd_session->mutex_detectors_done, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
     switch_thread_cond_create(&avmd_session->cond_detectors_done, switch_core_session_get_pool(fs_session));
 
@@ -488,10 +609,6 @@ end:
 }
 
 static void avmd_session_close(avmd_session_t *s) {
-    uint8_t                 idx;
-    struct avmd_detector    *d;
-    switch_status_t         status;
-
     switch_mutex_lock(avmd_globals.mutex);
     if (!s || s->closed) {
         switch_mutex_unlock(avmd_globals.mutex);
@@ -503,32 +620,13 @@ static void avmd_session_close(avmd_session_t *s) {
 
     switch_mutex_lock(s->mutex);
 
+    /* a worker may still be running the last frame, it must be done before the session pool goes away */
     switch_mutex_lock(s->mutex_detectors_done);
     while (avmd_detection_in_progress(s) == 1) {
         switch_thread_cond_wait(s->cond_detectors_done, s->mutex_detectors_done);
     }
     switch_mutex_unlock(s->mutex_detectors_done);
 
-    idx = 0;
-    while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
-        d = &s->detectors[idx];
-        switch_mutex_lock(d->mutex);
-        if (d->thread != NULL) {
-            d->flag_processing_done = 0;
-            d->flag_should_exit = 1;
-            d->samples = 0;
-            switch_thread_cond_signal(d->cond_start_processing);
-            switch_mutex_unlock(d->mutex);
-
-            switch_thread_join(&status, d->thread);
-            d->thread = NULL;
-        } else {
-            switch_mutex_unlock(d->mutex);
-        }
-        switch_mutex_destroy(d->mutex);
-        switch_thread_cond_destroy(d->cond_start_processing);
-        ++idx;
-    }
     switch_mutex_unlock(s->mutex);
     switch_mutex_destroy(s->mutex_detectors_done);
     switch_thread_cond_destroy(s->cond_detectors_done);
@@ -867,6 +965,8 @@ static void avmd_set_xml_default_configuration(switch_mutex_t *mutex) {
     avmd_globals.settings.detectors_n = 36;
     avmd_globals.settings.detectors_lagged_n = 1;
     avmd_globals.settings.detectors_idle_time = 60;
+    avmd_globals.settings.workers_n = 0;
+    avmd_globals.settings.workers_pin = 0;
 
     if (mutex != NULL) {
         switch_mutex_unlock(avmd_globals.mutex);
@@ -908,7 +1008,7 @@ static switch_status_t avmd_load_xml_configuration(switch_mutex_t *mutex) {
     uint8_t bad_debug = 1, bad_report = 1, bad_fast = 1, bad_req_cont = 1, bad_sample_n_cont = 1,
             bad_sample_n_to_skip = 1, bad_req_cont_amp = 1, bad_sample_n_cont_amp = 1, bad_simpl = 1,
             bad_inbound = 1, bad_outbound = 1, bad_mode = 1, bad_detectors = 1, bad_lagged = 1, bad = 0,
-            bad_idle_time = 1;
+            bad_idle_time = 1, bad_workers = 1, bad_workers_pin = 1;
 
     if (mutex != NULL) {
         switch_mutex_lock(mutex);
@@ -980,6 +1080,13 @@ static switch_status_t avmd_load_xml_configuration(switch_mutex_t *mutex) {
                     if(!avmd_parse_u16_user_input(value, &avmd_globals.settings.detectors_idle_time, 0, UINT16_MAX)) {
                         bad_idle_time = 0;
                     }
+                } else if (!strcmp(name, "workers_n")) {
+                    if(!avmd_parse_u16_user_input(value, &avmd_globals.settings.workers_n, 0, 1024)) {
+                        bad_workers = 0;
+                    }
+                } else if (!strcmp(name, "workers_pin")) {
+                    avmd_globals.settings.workers_pin = switch_true(value) ? 1 : 0;
+                    bad_workers_pin = 0;
                 }
             } // for
         } // if list
@@ -1077,6 +1184,15 @@ static switch_status_t avmd_load_xml_configuration(switch_mutex_t *mutex) {
         avmd_globals.settings.detectors_idle_time = 60;
     }
 
+    /* optional, 0 means one worker per core */
+    if (bad_workers) {
+        avmd_globals.settings.workers_n = 0;
+    }
+
+    if (bad_workers_pin) {
+        avmd_globals.settings.workers_pin = 0;
+    }
+
     /**
      * Hint.
      */
@@ -1156,12 +1272,41 @@ static void avmd_show(switch_stream_handle_t *stream, switch_mutex_t *mutex) {
     stream->write_function(stream, "detectors n                    \t%u\n", avmd_globals.settings.detectors_n);
     stream->write_function(stream, "detectors lagged n             \t%u\n", avmd_globals.settings.detectors_lagged_n);
     stream->write_function(stream, "\n\n");
+    avmd_show_workers(stream);
 
     if (mutex != NULL) {
         switch_mutex_unlock(mutex);
     }
 }
 
+/*! \brief Print the detection pool: frames run per worker and their processing cost. */
+static void avmd_show_workers(switch_stream_handle_t *stream) {
+    uint64_t    frames = 0, cost_total = 0;
+    uint32_t    cost_max = 0;
+    uint16_t    idx;
+
+    stream->write_function(stream, "%s\n", "Avmd detection pool\n\n");
+    stream->write_function(stream, "workers                        \t%u%s\n", avmd_globals.workers_n, avmd_globals.settings.workers_pin ? " (pinned)" : "");
+    stream->write_function(stream, "queued frames                  \t%u\n", avmd_globals.work_queue ? switch_queue_size(avmd_globals.work_queue) : 0);
+    stream->write_function(stream, "frames run by media threads    \t%"PRIu64"\n", avmd_globals.work_inline);
+
+    for (idx = 0; idx < avmd_globals.workers_n; ++idx) {
+        const struct avmd_worker *w = &avmd_globals.workers[idx];
+
+        stream->write_function(stream, "worker %-3u cpu %-3d            \tframes %"PRIu64" avg %"PRIu64" us max %u us\n",
+                idx, w->cpu, w->frames, w->frames ? w->cost_total / w->frames : 0, w->cost_max);
+        frames += w->frames;
+        cost_total += w->cost_total;
+        if (w->cost_max > cost_max) {
+            cost_max = w->cost_max;
+        }
+    }
+
+    stream->write_function(stream, "frame cost                     \tframes %"PRIu64" avg %"PRIu64" us max %u us\n",
+            frames, frames ? cost_total / frames : 0, cost_max);
+    stream->write_function(stream, "\n\n");
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_avmd_load) {
 #ifndef WIN32
     char    err[150];
@@ -1228,6 +1373,11 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_avmd_load) {
     }
 #endif
 
+    if (avmd_workers_start(pool) != SWITCH_STATUS_SUCCESS) {
+        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't create avmd work queue!\n");
+        return SWITCH_STATUS_TERM;
+    }
+
     SWITCH_ADD_APP(app_interface, "avmd_start","Start avmd detection", "Start avmd detection", avmd_start_app, "", SAF_NONE);
     SWITCH_ADD_APP(app_interface, "avmd_stop","Stop avmd detection", "Stop avmd detection", avmd_stop_app, "", SAF_NONE);
     SWITCH_ADD_APP(app_interface, "avmd","Beep detection", "Advanced detection of voicemail beeps", avmd_start_function, AVMD_SYNTAX, SAF_NONE);
@@ -1242,6 +1392,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_avmd_load) {
     switch_console_set_complete("add avmd set default");    /* restore to factory settings */
     switch_console_set_complete("add avmd get sessions");    /* set inbound = 1, outbound = 0 */
     switch_console_set_complete("add avmd get detectors");   /* set inbound = 0, outbound = 1 */
+    switch_console_set_complete("add avmd get workers");
     switch_console_set_complete("add avmd load inbound");   /* reload + set inbound */
     switch_console_set_complete("add avmd load outbound");  /* reload + set outbound */
     switch_console_set_complete("add avmd reload");         /* reload XML (it loads from FS installation
@@ -1639,6 +1790,10 @@ SWITCH_STANDARD_APP(avmd_stop_app) {
         stop_time = avmd_session->stop_time;
         total_time = stop_time - start_time;
         switch_mutex_unlock(avmd_session->mutex);
+        if (avmd_session->cost_frames > 0) {
+            switch_channel_set_variable_printf(channel, "avmd_frame_cost_avg", "%"PRIu64, avmd_session->cost_total / avmd_session->cost_frames);
+            switch_channel_set_variable_printf(channel, "avmd_frame_cost_max", "%u", avmd_session->cost_max);
+        }
         avmd_fire_event(AVMD_EVENT_SESSION_STOP, session, 0, 0, 0, 0, beep_status, 1, 0, 0, start_time, stop_time, 0, 0, 0, 0);
         if (report_status == 1) {
             switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Avmd on channel [%s] stopped, beep status: [%s], total running time [%" PRId64 "] [us]\n", switch_channel_get_name(channel), beep_status == BEEP_DETECTED ? "DETECTED" : "NOTDETECTED", total_time);
@@ -1691,6 +1846,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_avmd_shutdown) {
     }
 
     avmd_unregister_all_events();
+    avmd_workers_stop();
 
 #ifndef WIN32
     if (avmd_globals.settings.fast_math == 1) {
@@ -1836,6 +1992,8 @@ SWITCH_STANDARD_API(avmd_api_main) {
             stream->write_function(stream, "%d", avmd_globals.session_n);
         } else if (strcasecmp(command, "detectors") == 0) {
             stream->write_function(stream, "%d", avmd_globals.detectors_n);
+        } else if (strcasecmp(command, "workers") == 0) {
+            avmd_show_workers(stream);
         } else {
             stream->write_function(stream, "-ERR, set command: bad syntax!\n-USAGE: %s\n\n", AVMD_SYNTAX);
         }
@@ -2098,19 +2256,12 @@ static void avmd_report_detection(avmd_session_t *s, enum avmd_detection_mode mo
     s->state.beep_state = BEEP_DETECTED;
 }
 
+/*! \brief Check if a worker is still processing a frame of the session.
+ * @details s->mutex_detectors_done must be locked.
+ */
 static uint8_t
 avmd_detection_in_progress(avmd_session_t *s) {
-    uint8_t idx = 0;
-    while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
-        switch_mutex_lock(s->detectors[idx].mutex);
-        if (s->detectors[idx].flag_processing_done == 0) {
-            switch_mutex_unlock(s->detectors[idx].mutex);
-            return 1;
-        }
-        switch_mutex_unlock(s->detectors[idx].mutex);
-        ++idx;
-    }
-    return 0;
+    return s->task_pending;
 }
 
 static enum avmd_detection_mode
@@ -2134,16 +2285,17 @@ avmd_detection_result(avmd_session_t *s) {
  */
 static void avmd_process(avmd_session_t *s, switch_frame_t *frame, uint8_t direction) {
     circ_buffer_t           *b;
-    uint8_t                 idx;
-    struct avmd_detector    *d;
-
 
     b = &s->b;
 
+    /* the previous frame must be through all detectors before the buffer moves on */
     switch_mutex_lock(s->mutex_detectors_done);
     while (avmd_detection_in_progress(s) == 1) {
         switch_thread_cond_wait(s->cond_detectors_done, s->mutex_detectors_done);
     }
+    if (s->state.beep_state != BEEP_DETECTED) {
+        avmd_detection_result(s);
+    }
     switch_mutex_unlock(s->mutex_detectors_done);
 
     if (s->state.beep_state == BEEP_DETECTED) {                         /* If beep has already been detected skip the CPU heavy stuff */
@@ -2165,26 +2317,14 @@ static void avmd_process(avmd_session_t *s, switch_frame_t *frame, uint8_t direc
 
     INSERT_INT16_FRAME(b, (int16_t *)(frame->data), frame->samples);    /* Insert frame of 16 bit samples into buffer */
 
-    idx = 0;
-    while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
-        d = &s->detectors[idx];
-        switch_mutex_lock(d->mutex);
-        d = &s->detectors[idx];
-        if (d->result == AVMD_DETECT_NONE) {
-            d->flag_processing_done = 0;
-            d->samples = (s->frame_n == 0 ? frame->samples - AVMD_P : frame->samples);
-            switch_thread_cond_signal(d->cond_start_processing);
-        }
-        switch_mutex_unlock(d->mutex);
-        ++idx;
-    }
+    s->task_samples = (s->frame_n == 0 ? frame->samples - AVMD_P : frame->samples);
+    s->task_pending = 1;
 
-    switch_mutex_lock(s->mutex_detectors_done);
-    while (avmd_detection_in_progress(s) == 1) {
-        switch_thread_cond_wait(s->cond_detectors_done, s->mutex_detectors_done);
+    /* the result is collected at the start of the next frame, the media thread does not wait for the detectors */
+    if (avmd_globals.work_queue == NULL || switch_queue_trypush(avmd_globals.work_queue, s) != SWITCH_STATUS_SUCCESS) {
+        avmd_globals.work_inline++;
+        avmd_task_run(s, NULL);
     }
-    avmd_detection_result(s);
-    switch_mutex_unlock(s->mutex_detectors_done);
 
     ++s->frame_n;
     if (s->frame_n == 1) {
@@ -2197,16 +2337,87 @@ static void avmd_process(avmd_session_t *s, switch_frame_t *frame, uint8_t direc
     return;
 }
 
+/*! \brief Compute DESA-2 once for every position of the frame as seen from pos.
+ * @details All detectors that are not lagged read the frame from the same position,
+ *          so they share these results instead of each calling avmd_desa2_tweaked.
+ */
+static void avmd_block_compute(avmd_session_t *s, size_t pos, size_t samples) {
+    circ_buffer_t   *b = &s->b;
+    size_t          k;
+
+    for (k = 0; k < samples + AVMD_P - 1; ++k) {
+        s->block_x[k] = GET_SAMPLE(b, pos + 1 + k);
+    }
+    avmd_desa2_tweaked_block(s->block_x, samples, s->block_omega, s->block_amplitude);
+    s->task_pos = pos;
+}
+
+/*! \brief Advance every detector of the session still looking for a beep by one frame.
+ * @details This is what each detector thread used to do on its own, per frame.
+ */
+static void avmd_detectors_run(avmd_session_t *s) {
+    size_t                      samples = s->task_samples;
+    size_t                      sample_n;
+    uint8_t                     idx, block = 0;
+    struct avmd_detector        *d;
+    enum avmd_detection_mode    res;
+    double                      omega, amplitude;
+
+    if (samples == 0) {
+        return;
+    }
+
+    for (idx = 0; idx < (s->settings.detectors_n + s->settings.detectors_lagged_n); ++idx) {
+        d = &s->detectors[idx];
+        if (d->result != AVMD_DETECT_NONE) {
+            continue;
+        }
+
+        if (d->lagged == 1) {
+            if (d->lag > 0) {
+                --d->lag;
+                continue;
+            }
+            d->pos += AVMD_P;
+        }
+
+        if (s->settings.sample_n_to_skip > 0) {
+            continue;
+        }
+
+        if (!block && samples <= s->block_len && d->lagged == 0) {
+            avmd_block_compute(s, d->pos, samples);
+            block = 1;
+        }
+
+        res = AVMD_DETECT_NONE;
+        for (sample_n = 1; sample_n <= samples; ++sample_n) {
+            if (((sample_n + d->buffer.offset) % d->buffer.resolution) != 0) {
+                continue;
+            }
+            if (block && d->pos == s->task_pos) {
+                omega = s->block_omega[sample_n - 1];
+                amplitude = s->block_amplitude[sample_n - 1];
+            } else {
+                omega = avmd_desa2_tweaked(&s->b, d->pos + sample_n, &amplitude);
+            }
+            res = avmd_process_sample(s, omega, amplitude, d);
+            if (res != AVMD_DETECT_NONE) {
+                break;
+            }
+        }
+        d->result = res;
+    }
+}
+
 static void avmd_reloadxml_event_handler(switch_event_t *event) {
     avmd_load_xml_configuration(avmd_globals.mutex);
 }
 
-static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buffer_t *b, size_t sample_n, size_t pos, struct avmd_detector *d) {
+static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, double omega, double amplitude, struct avmd_detector *d) {
     struct avmd_buffer          *buffer = &d->buffer;
-    uint16_t                    sample_to_skip_n = s->settings.sample_n_to_skip;
     enum avmd_detection_mode    mode = s->settings.mode;
     uint8_t     valid_amplitude = 1, valid_omega = 1;
-    double      omega = 0.0, amplitude = 0.0;
     double      f = 0.0, f_fir = 0.0;
     double      v_amp = 9999.9, v_fir = 9999.9;
 
@@ -2219,13 +2430,6 @@ static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buff
     sma_buffer_t    *sma_amp_b = &buffer->sma_amp_b;
     sma_buffer_t    *sqa_amp_b = &buffer->sqa_amp_b;
 
-	if (sample_to_skip_n > 0) {
-
-		return AVMD_DETECT_NONE;
-	}
-
-    omega = avmd_desa2_tweaked(b, pos + sample_n, &amplitude);
-
 
 	if (mode == AVMD_DETECT_AMP || mode == AVMD_DETECT_BOTH) {
 		if (ISNAN(amplitude) || ISINF(amplitude)) {
@@ -2326,79 +2530,6 @@ static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buff
 	return AVMD_DETECT_NONE;
 }
 
-static void* SWITCH_THREAD_FUNC
-avmd_detector_func(switch_thread_t *thread, void *arg) {
-    size_t      sample_n = 0, samples = AVMD_P;
-    size_t      pos;
-    uint8_t     resolution, offset;
-    avmd_session_t  *s;
-    enum avmd_detection_mode res = AVMD_DETECT_NONE;
-    struct avmd_detector *d;
-
-
-    d = (struct avmd_detector*) arg;
-    s = d->s;
-    pos = s->pos;
-    while (1) {
-        switch_mutex_lock(d->mutex);
-        while ((d->flag_processing_done == 1) && (d->flag_should_exit == 0)) {
-            if (s->settings.detectors_idle_time > 0) {
-                if (switch_thread_cond_timedwait(d->cond_start_processing, d->mutex, (s->settings.detectors_idle_time * 1000 * 1000)) == SWITCH_STATUS_TIMEOUT) {
-                    switch_log_printf(SWITCH_CHANNEL_UUID_LOG(s->session_uuid), SWITCH_LOG_WARNING, "Avmd detector idle timeout! [idx:%d]!\n", d->idx);
-                }
-            } else {
-                switch_thread_cond_wait(d->cond_start_processing, d->mutex);
-            }
-        }
-        /* master set processing_done flag to 0 or thread should exit */
-        if (d->flag_should_exit == 1) {
-            d->flag_processing_done = 1;
-            goto end;
-        }
-        resolution = d->buffer.resolution;
-        offset = d->buffer.offset;
-        samples = d->samples;
-
-        if (samples) {
-            if (d->lagged == 1) {
-                if (d->lag > 0) {
-                    --d->lag;
-                    goto done;
-                }
-                pos += AVMD_P;
-            }
-
-            switch_mutex_unlock(d->mutex);
-            sample_n = 1;
-            while (sample_n <= samples) {
-                if (((sample_n + offset) % resolution) == 0) {
-                    res = avmd_process_sample(d->s, &s->b, sample_n, pos, d);
-                    if (res != AVMD_DETECT_NONE) {
-                        break;
-                    }
-                }
-                ++sample_n;
-            }
-        } else {
-            switch_mutex_unlock(d->mutex);
-        }
-        switch_mutex_lock(d->mutex);
-done:
-        d->flag_processing_done = 1;
-        d->result = res;
-        switch_mutex_unlock(d->mutex);
-
-        switch_mutex_lock(s->mutex_detectors_done);
-        switch_thread_cond_signal(s->cond_detectors_done);
-        switch_mutex_unlock(s->mutex_detectors_done);
-    }
-    return NULL;
-
-end:
-    switch_mutex_unlock(d->mutex);
-    return NULL;
-}
-
 
 /* For Emacs:
  * Local Variables:
@@ -77,6 +77,27 @@ static int url_callback(void *pArg, int argc, char **argv, char **columnNames)
 	return 0;
 }
 
+struct url_mem_helper {
+	struct cb_helper *cb;
+	const char *concat;
+	const char *exclude_contact;
+};
+
+static int url_mem_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	struct url_mem_helper *h = (struct url_mem_helper *) pArg;
+	char *row[2];
+
+	if (h->exclude_contact && switch_stristr(h->exclude_contact, argv[0])) {
+		return 0;
+	}
+
+	row[0] = argv[0];
+	row[1] = (char *) h->concat;
+
+	return url_callback(h->cb, 2, row, columnNames);
+}
+
 static switch_status_t select_url(const char *user,
 					   const char *domain,
 					   const char *concat,
@@ -88,6 +109,26 @@ static switch_status_t select_url(const char *user,
 	switch_core_flag_t cflags = switch_core_flags();
 	switch_cache_db_handle_t *db = NULL;
 
+	if (switch_core_memory_tables_enabled()) {
+		switch_core_table_query_t query = { 0 };
+		struct url_mem_helper h = { 0 };
+
+		cb.row_process = 0;
+		cb.stream = stream;
+		h.cb = &cb;
+		h.concat = concat ? concat : "";
+		h.exclude_contact = exclude_contact;
+
+		query.table = SWITCH_CORE_TABLE_REGISTRATIONS;
+		query.reg_user = user;
+		query.realm = domain;
+		query.column = "url";
+
+		switch_core_memory_table_query(&query, url_mem_callback, &h);
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	if (!(cflags & SCF_USE_SQL)) {
 		stream->write_function(stream, "-ERR SQL disabled, no data available!\n");
 		return SWITCH_STATUS_SUCCESS;
@@ -692,6 +733,66 @@ SWITCH_STANDARD_API(pool_stats_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define PROMPT_CACHE_SYNTAX "status|flush"
+SWITCH_STANDARD_API(prompt_cache_function)
+{
+	switch_prompt_cache_stats_t stats;
+
+	if (!zstr(cmd) && !strcasecmp(cmd, "flush")) {
+		switch_core_prompt_cache_flush();
+		stream->write_function(stream, "+OK\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!zstr(cmd) && strcasecmp(cmd, "status")) {
+		stream->write_function(stream, "-USAGE: %s\n", PROMPT_CACHE_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_core_prompt_cache_get_stats(&stats);
+
+	stream->write_function(stream, "entries: %u\n", stats.entries);
+	stream->write_function(stream, "bytes: %" SWITCH_SIZE_T_FMT "/%" SWITCH_SIZE_T_FMT "\n", stats.bytes, stats.max_bytes);
+	stream->write_function(stream, "max-file-bytes: %" SWITCH_SIZE_T_FMT "\n", stats.max_entry_bytes);
+	stream->write_function(stream, "hits: %" SWITCH_UINT64_T_FMT "\n", stats.hits);
+	stream->write_function(stream, "misses: %" SWITCH_UINT64_T_FMT "\n", stats.misses);
+	stream->write_function(stream, "hit-rate: %0.2f%%\n", stats.hits + stats.misses ? 100.0 * stats.hits / (stats.hits + stats.misses) : 0.0);
+	stream->write_function(stream, "inserts: %" SWITCH_UINT64_T_FMT "\n", stats.inserts);
+	stream->write_function(stream, "evictions: %" SWITCH_UINT64_T_FMT "\n", stats.evictions);
+	stream->write_function(stream, "invalidations: %" SWITCH_UINT64_T_FMT "\n", stats.invalidations);
+	stream->write_function(stream, "aborts: %" SWITCH_UINT64_T_FMT "\n", stats.aborts);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define IMAGE_POOL_SYNTAX "status|flush"
+SWITCH_STANDARD_API(image_pool_function)
+{
+	switch_img_pool_stats_t stats;
+
+	if (!zstr(cmd) && !strcasecmp(cmd, "flush")) {
+		switch_img_pool_flush();
+		stream->write_function(stream, "+OK\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!zstr(cmd) && strcasecmp(cmd, "status")) {
+		stream->write_function(stream, "-USAGE: %s\n", IMAGE_POOL_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_img_pool_get_stats(&stats);
+
+	stream->write_function(stream, "images: %u\n", stats.images);
+	stream->write_function(stream, "bytes: %" SWITCH_SIZE_T_FMT "/%" SWITCH_SIZE_T_FMT "\n", stats.bytes, stats.max_bytes);
+	stream->write_function(stream, "hits: %" SWITCH_UINT64_T_FMT "\n", stats.hits);
+	stream->write_function(stream, "misses: %" SWITCH_UINT64_T_FMT "\n", stats.misses);
+	stream->write_function(stream, "hit-rate: %0.2f%%\n", stats.hits + stats.misses ? 100.0 * stats.hits / (stats.hits + stats.misses) : 0.0);
+	stream->write_function(stream, "evictions: %" SWITCH_UINT64_T_FMT "\n", stats.evictions);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(db_cache_function)
 {
 	int argc;
@@ -2321,6 +2422,8 @@ SWITCH_STANDARD_API(lan_addr_function)
 SWITCH_STANDARD_API(status_function)
 {
 	switch_core_time_duration_t duration = { 0 };
+	switch_log_ring_stats_t log_stats;
+	switch_record_writer_stats_t record_stats;
 	int sps = 0, last_sps = 0, max_sps = 0, max_sps_fivemin = 0;
 	int sessions_peak = 0, sessions_peak_fivemin = 0; /* Max Concurrent Sessions buffers */
 	switch_bool_t html = SWITCH_FALSE;	/* shortcut to format.html	*/
@@ -2380,6 +2483,17 @@ SWITCH_STANDARD_API(status_function)
 	if (switch_core_get_stacksizes(&cur, &max) == SWITCH_STATUS_SUCCESS) {		stream->write_function(stream, "Current Stack Size/Max %ldK/%ldK\n", cur / 1024, max / 1024);
 	}
 
+	if (switch_log_ring_stats(&log_stats) == SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "log rings %u x %u, %u queued, %u waiting, %u dropped, %u preformatted%s",
+							   log_stats.rings, log_stats.slots, log_stats.queued, log_stats.depth, log_stats.dropped, log_stats.preformatted, nl);
+	}
+
+	if (switch_ivr_record_writer_stats(&record_stats) == SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "record writers %u, %u recording(s), %u waiting, lag %u/%ums, %" SWITCH_UINT64_T_FMT " dropped frame(s)%s",
+							   record_stats.threads, record_stats.recordings, record_stats.ready, record_stats.lag_ms, record_stats.max_lag_ms,
+							   record_stats.drops, nl);
+	}
+
 	switch_telnyx_on_populate_api_plain_status(stream);
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -5726,12 +5840,41 @@ SWITCH_STANDARD_API(coalesce_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void show_execute(switch_cache_db_handle_t *db, const char *sql, switch_core_table_query_t *query,
+						 switch_core_db_callback_func_t callback, struct holder *holder, char **errmsg)
+{
+	if (query) {
+		switch_core_memory_table_query(query, callback, holder);
+	} else if (db) {
+		switch_cache_db_execute_sql_callback(db, sql, callback, holder, errmsg);
+	} else {
+		*errmsg = strdup("SQL disabled, no data available!");
+	}
+}
+
+/* the in-memory tables only ever get the same hostname filter the SQL for the command uses */
+static switch_core_table_query_t *show_memory_query(switch_bool_t memory_tables, switch_core_table_query_t *query, switch_core_table_t table)
+{
+	if (!memory_tables) {
+		return NULL;
+	}
+
+	query->table = table;
+	query->hostname = switch_core_get_switchname();
+
+	return query;
+}
+
 #define SHOW_SYNTAX "codec|endpoint|application|api|dialplan|file|timer|calls [count]|channels [count|like <match string>]|uuid_calls|uuid_channels|calls|detailed_calls|bridged_calls|detailed_bridged_calls|aliases|complete|chat|management|modules|nat_map|say|interfaces|interface_types|tasks|limits|status"
 SWITCH_STANDARD_API(show_function)
 {
 	char sql[1024];
-	char *errmsg;
-	switch_cache_db_handle_t *db;
+	char *errmsg = NULL;
+	switch_cache_db_handle_t *db = NULL;
+	switch_core_table_query_t mem_query = { 0 };
+	switch_core_table_query_t *query = NULL;
+	switch_bool_t memory_tables = switch_core_memory_tables_enabled();
+	char *like = NULL;
 	struct holder holder = { 0 };
 	int help = 0;
 	char *mydata = NULL, *argv[6] = { 0 };
@@ -5746,12 +5889,12 @@ SWITCH_STANDARD_API(show_function)
 	set_format(holder.format, stream);
 	html = holder.format->html; /* html is just a shortcut */
 
-	if (!(cflags & SCF_USE_SQL)) {
+	if (!(cflags & SCF_USE_SQL) && !memory_tables) {
 		stream->write_function(stream, "-ERR SQL disabled, no data available!\n");
 		return SWITCH_STATUS_SUCCESS;
 	}
 
-	if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
+	if ((cflags & SCF_USE_SQL) && switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
 		stream->write_function(stream, "%s", "-ERR Database error!\n");
 		return SWITCH_STATUS_SUCCESS;
 	}
@@ -5855,24 +5998,29 @@ SWITCH_STANDARD_API(show_function)
 		}
 
 		if (!strcasecmp(command, "calls")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_CALLS);
 			switch_snprintfv(sql, sizeof(sql), "select * from basic_calls where hostname='%q' order by call_created_epoch", switch_core_get_switchname());
 			if (argv[1] && !strcasecmp(argv[1], "count")) {
 				switch_snprintfv(sql, sizeof(sql), "select count(*) from basic_calls where hostname='%q'", switch_core_get_switchname());
 				holder.justcount = 1;
+				mem_query.count = SWITCH_TRUE;
 				if (argv[2] && argv[3] && !strcasecmp(argv[2], "as")) {
 					as = argv[3];
 				}
 			}
 		} else if (!strcasecmp(command, "registrations")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_REGISTRATIONS);
 			switch_snprintfv(sql, sizeof(sql), "select * from registrations where hostname='%q'", switch_core_get_switchname());
 			if (argv[1] && !strcasecmp(argv[1], "count")) {
 				switch_snprintfv(sql, sizeof(sql), "select count(*) from registrations where hostname='%q'", switch_core_get_switchname());
 				holder.justcount = 1;
+				mem_query.count = SWITCH_TRUE;
 				if (argv[2] && argv[3] && !strcasecmp(argv[2], "as")) {
 					as = argv[3];
 				}
 			}
 		} else if (!strcasecmp(command, "channels") && argv[1] && !strcasecmp(argv[1], "like")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_CHANNELS);
 			if (argv[2]) {
 				char *p;
 				for (p = argv[2]; p && *p; p++) {
@@ -5880,6 +6028,8 @@ SWITCH_STANDARD_API(show_function)
 						*p = ' ';
 					}
 				}
+				like = strchr(argv[2], '%') ? strdup(argv[2]) : switch_mprintf("%%%s%%", argv[2]);
+				mem_query.like = like;
 				if (strchr(argv[2], '%')) {
 					switch_snprintfv(sql, sizeof(sql),
 						"select * from channels where hostname='%q' and uuid like '%q' or name like '%q' or cid_name like '%q' or cid_num like '%q' or presence_data like '%q' or accountcode like '%q' order by created_epoch",
@@ -5896,35 +6046,46 @@ SWITCH_STANDARD_API(show_function)
 				switch_snprintfv(sql, sizeof(sql), "select * from channels where hostname='%q' order by created_epoch", switch_core_get_switchname());
 			}
 		} else if (!strcasecmp(command, "channels")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_CHANNELS);
 			switch_snprintfv(sql, sizeof(sql), "select * from channels where hostname='%q' order by created_epoch", switch_core_get_switchname());
 			if (argv[1] && !strcasecmp(argv[1], "count")) {
 				switch_snprintfv(sql, sizeof(sql), "select count(*) from channels where hostname='%q'", switch_core_get_switchname());
 				holder.justcount = 1;
+				mem_query.count = SWITCH_TRUE;
 				if (argv[2] && argv[3] && !strcasecmp(argv[2], "as")) {
 					as = argv[3];
 				}
 			}
 		} else if (!strcasecmp(command, "uuid_calls")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_CALLS);
+			mem_query.column = "uuid";
 			switch_snprintfv(sql, sizeof(sql), "select uuid from basic_calls where hostname='%q' order by call_created_epoch", switch_core_get_switchname());
 			if (argv[1] && argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
 			}
 		} else if (!strcasecmp(command, "uuid_channels")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_CHANNELS);
+			mem_query.column = "uuid";
 			switch_snprintfv(sql, sizeof(sql), "select uuid from channels where hostname='%q' order by created_epoch", switch_core_get_switchname());
 			if (argv[1] && argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
 			}
 		} else if (!strcasecmp(command, "detailed_calls")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_DETAILED_CALLS);
 			switch_snprintfv(sql, sizeof(sql), "select * from detailed_calls where hostname='%q' order by created_epoch", switch_core_get_switchname());
 			if (argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
 			}
 		} else if (!strcasecmp(command, "bridged_calls")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_CALLS);
+			mem_query.bridged = SWITCH_TRUE;
 			switch_snprintfv(sql, sizeof(sql), "select * from basic_calls where b_uuid is not null and hostname='%q' order by created_epoch", switch_core_get_switchname());
 			if (argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
 			}
 		} else if (!strcasecmp(command, "detailed_bridged_calls")) {
+			query = show_memory_query(memory_tables, &mem_query, SWITCH_CORE_TABLE_DETAILED_CALLS);
+			mem_query.bridged = SWITCH_TRUE;
 			switch_snprintfv(sql, sizeof(sql), "select * from detailed_calls where b_uuid is not null and hostname='%q' order by created_epoch", switch_core_get_switchname());
 			if (argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
@@ -5962,7 +6123,7 @@ SWITCH_STANDARD_API(show_function)
 				holder.delim = ",";
 			}
 		}
-		switch_cache_db_execute_sql_callback(db, sql, show_callback, &holder, &errmsg);
+		show_execute(db, sql, query, show_callback, &holder, &errmsg);
 		if (html) {
 			holder.stream->write_function(holder.stream, "</table>");
 		}
@@ -5978,7 +6139,7 @@ SWITCH_STANDARD_API(show_function)
 			stream->write_function(stream, "%s%u total.%s", nl, holder.count, nl);
 		}
 	} else if (!strcasecmp(as, "xml")) {
-		switch_cache_db_execute_sql_callback(db, sql, show_as_xml_callback, &holder, &errmsg);
+		show_execute(db, sql, query, show_as_xml_callback, &holder, &errmsg);
 
 		if (errmsg) {
 			stream->write_function(stream, "-ERR SQL error [%s]\n", errmsg);
@@ -6006,7 +6167,7 @@ SWITCH_STANDARD_API(show_function)
 		}
 	} else if (!strcasecmp(as, "json")) {
 
-		switch_cache_db_execute_sql_callback(db, sql, show_as_json_callback, &holder, &errmsg);
+		show_execute(db, sql, query, show_as_json_callback, &holder, &errmsg);
 
 		if (errmsg) {
 			stream->write_function(stream, "-ERR SQL Error [%s]\n", errmsg);
@@ -6050,6 +6211,7 @@ SWITCH_STANDARD_API(show_function)
 
   end:
 
+	switch_safe_free(like);
 	switch_safe_free(mydata);
 	switch_cache_db_release_db_handle(&db);
 
@@ -7744,6 +7906,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "originate", "Originate a call", originate_function, ORIGINATE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "pause", "Pause media on a channel", pause_function, PAUSE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "pool_stats", "Core pool memory usage", pool_stats_function, "Core pool memory usage.");
+	SWITCH_ADD_API(commands_api_interface, "prompt_cache", "Decoded prompt cache", prompt_cache_function, PROMPT_CACHE_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "image_pool", "Pool of released video images", image_pool_function, IMAGE_POOL_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "quote_shell_arg", "Quote/escape a string for use on shell command line", quote_shell_arg_function, "<data>");
 	SWITCH_ADD_API(commands_api_interface, "regex", "Evaluate a regex", regex_function, "<data>|<pattern>[|<subst string>][n|b]");
 	SWITCH_ADD_API(commands_api_interface, "reloadacl", "Reload XML", reload_acl_function, "");
@@ -7857,6 +8021,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_console_set_complete("add complete add");
 	switch_console_set_complete("add complete del");
 	switch_console_set_complete("add db_cache status");
+	switch_console_set_complete("add prompt_cache status");
+	switch_console_set_complete("add prompt_cache flush");
+	switch_console_set_complete("add image_pool status");
+	switch_console_set_complete("add image_pool flush");
 	switch_console_set_complete("add fsctl api_expansion on");
 	switch_console_set_complete("add fsctl api_expansion off");
 	switch_console_set_complete("add fsctl debug_level");
@@ -122,6 +122,9 @@ api_command_t conference_api_sub_commands[] = {
 	{"vid-layout", (void_fn_t) & conference_api_sub_vid_layout, CONF_API_SUB_ARGS_SPLIT, "vid-layout", "<layout name>|group <group name> [<canvas id>]"},
 	{"vid-write-png", (void_fn_t) & conference_api_sub_write_png, CONF_API_SUB_ARGS_SPLIT, "vid-write-png", "<path>"},
 	{"vid-fps", (void_fn_t) & conference_api_sub_vid_fps, CONF_API_SUB_ARGS_SPLIT, "vid-fps", "<fps>"},
+	{"vid-compose", (void_fn_t) & conference_api_sub_vid_compose, CONF_API_SUB_ARGS_SPLIT, "vid-compose", "[reset]"},
+	{"vid-ladder", (void_fn_t) & conference_api_sub_vid_ladder, CONF_API_SUB_ARGS_SPLIT, "vid-ladder", "[reset]"},
+	{"vid-sfu", (void_fn_t) & conference_api_sub_vid_sfu, CONF_API_SUB_ARGS_SPLIT, "vid-sfu", "[reset]"},
 	{"vid-res", (void_fn_t) & conference_api_sub_vid_res, CONF_API_SUB_ARGS_SPLIT, "vid-res", "<WxH>"},
 	{"vid-fgimg", (void_fn_t) & conference_api_sub_canvas_fgimg, CONF_API_SUB_ARGS_SPLIT, "vid-fgimg", "<file> | clear [<canvas-id>]"},
 	{"vid-bgimg", (void_fn_t) & conference_api_sub_canvas_bgimg, CONF_API_SUB_ARGS_SPLIT, "vid-bgimg", "<file> | clear [<canvas-id>]"},
@@ -1752,6 +1755,7 @@ switch_status_t conference_api_sub_vid_bandwidth(conference_obj_t *conference, s
 
 					if (w && h) {
 						switch_img_free(&canvas->write_codecs[j]->scaled_img);
+						switch_img_free(&canvas->write_codecs[j]->fit_img);
 						if (w != canvas->img->d_w || h != canvas->img->d_h) {
 							canvas->write_codecs[j]->scaled_img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, w, h, 16);
 						}
@@ -1960,6 +1964,111 @@ switch_status_t conference_api_sub_vid_fps(conference_obj_t *conference, switch_
 
 }
 
+switch_status_t conference_api_sub_vid_compose(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
+{
+	int i;
+
+	if (!conference->canvas_count) {
+		stream->write_function(stream, "-ERR Conference is not in mixing mode\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_mutex_lock(conference->canvas_mutex);
+	for (i = 0; i <= conference->canvas_count; i++) {
+		mcu_canvas_t *canvas = conference->canvases[i];
+
+		if (!canvas) {
+			continue;
+		}
+
+		if (argv[2] && !strcasecmp(argv[2], "reset")) {
+			canvas->compose_max = 0;
+			canvas->compose_frames = 0;
+			canvas->compose_layers = 0;
+			switch_atomic_set(&canvas->compose_scales, 0);
+			switch_atomic_set(&canvas->compose_cached, 0);
+		} else {
+			conference_video_compose_status(canvas, stream);
+		}
+	}
+	switch_mutex_unlock(conference->canvas_mutex);
+
+	if (argv[2] && !strcasecmp(argv[2], "reset")) {
+		stream->write_function(stream, "+OK compose stats reset\n");
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+switch_status_t conference_api_sub_vid_ladder(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
+{
+	int i, j;
+
+	if (!conference->canvas_count) {
+		stream->write_function(stream, "-ERR Conference is not in mixing mode\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	for (j = 0; !argv[2] && j < conference->video_ladder_count; j++) {
+		stream->write_function(stream, "rung %d %ux%u@%dkbps\n", j, conference->video_ladder[j].width,
+							   conference->video_ladder[j].height, conference->video_ladder[j].kbps);
+	}
+
+	switch_mutex_lock(conference->canvas_mutex);
+	for (i = 0; i <= conference->canvas_count; i++) {
+		mcu_canvas_t *canvas = conference->canvases[i];
+
+		if (!canvas) {
+			continue;
+		}
+
+		if (argv[2] && !strcasecmp(argv[2], "reset")) {
+			for (j = 0; j < canvas->write_codecs_count; j++) {
+				if (canvas->write_codecs[j]) {
+					canvas->write_codecs[j]->encode_max = 0;
+					canvas->write_codecs[j]->encode_frames = 0;
+				}
+			}
+		} else {
+			conference_video_ladder_status(canvas, stream);
+		}
+	}
+	switch_mutex_unlock(conference->canvas_mutex);
+
+	if (argv[2] && !strcasecmp(argv[2], "reset")) {
+		stream->write_function(stream, "+OK encode stats reset\n");
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+switch_status_t conference_api_sub_vid_sfu(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
+{
+	conference_member_t *imember;
+
+	if (conference->conference_video_mode != CONF_VIDEO_MODE_SFU) {
+		stream->write_function(stream, "-ERR Conference is not in sfu mode\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (argv[2] && !strcasecmp(argv[2], "reset")) {
+		switch_mutex_lock(conference->member_mutex);
+		conference->sfu_packets = conference->sfu_bytes = conference->sfu_dropped = 0;
+		conference->sfu_switches = conference->sfu_key_requests = 0;
+		for (imember = conference->members; imember; imember = imember->next) {
+			imember->sfu.packets = imember->sfu.bytes = 0;
+			imember->sfu.switches = 0;
+		}
+		switch_mutex_unlock(conference->member_mutex);
+
+		stream->write_function(stream, "+OK sfu stats reset\n");
+	} else {
+		conference_video_sfu_status(conference, stream);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 switch_status_t conference_api_sub_write_png(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
@@ -62,6 +62,53 @@ int conference_video_set_fps(conference_obj_t *conference, float fps)
 
 static int COMPLETE_INIT = 0;
 
+/* <WxH>@<bandwidth>[,<WxH>@<bandwidth>...] e.g. 1920x1080@3mb,1280x720@1500,640x360@500 */
+void conference_video_parse_ladder(conference_obj_t *conference, const char *ladder)
+{
+	char *dup, *rungs[MAX_LADDER_RUNGS * 2] = { 0 };
+	int argc, i, j;
+
+	conference->video_ladder_count = 0;
+
+	if (zstr(ladder)) {
+		return;
+	}
+
+	dup = switch_core_strdup(conference->pool, ladder);
+	argc = switch_separate_string(dup, ',', rungs, (sizeof(rungs) / sizeof(rungs[0])));
+
+	for (i = 0; i < argc && conference->video_ladder_count < MAX_LADDER_RUNGS; i++) {
+		video_rung_t rung = { 0 };
+		char *p;
+
+		rung.width = atoi(rungs[i]);
+
+		if ((p = strchr(rungs[i], 'x'))) {
+			rung.height = atoi(p + 1);
+		}
+
+		if ((p = strchr(rungs[i], '@'))) {
+			rung.kbps = switch_parse_bandwidth_string(p + 1);
+		}
+
+		if (rung.width < 16 || rung.height < 16 || rung.kbps <= 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid video-encode-ladder rung [%s], expected <WxH>@<bandwidth>\n", rungs[i]);
+			continue;
+		}
+
+		rung.width &= ~1;
+		rung.height &= ~1;
+
+		/* rung 0 is the one with the most bandwidth */
+		for (j = conference->video_ladder_count; j > 0 && conference->video_ladder[j - 1].kbps < rung.kbps; j--) {
+			conference->video_ladder[j] = conference->video_ladder[j - 1];
+		}
+
+		conference->video_ladder[j] = rung;
+		conference->video_ladder_count++;
+	}
+}
+
 void conference_video_parse_layouts(conference_obj_t *conference, int WIDTH, int HEIGHT)
 {
 	switch_event_t *params;
@@ -407,13 +454,14 @@ void conference_video_reset_layer(mcu_layer_t *layer)
 {
 	switch_img_free(&layer->banner_img);
 	switch_img_free(&layer->logo_img);
+	layer->logo_seq++;
 
 	layer->bugged = 0;
 	layer->mute_patched = 0;
 	layer->banner_patched = 0;
 	layer->is_avatar = 0;
-	layer->need_patch = 0;
 	layer->manual_border = 0;
+	layer->scaled_seq = 0;
 	
 	conference_video_reset_layer_cam(layer);
 
@@ -503,12 +551,12 @@ static void set_bounds(int *x, int *y, int img_w, int img_h, int crop_w, int cro
 
 }
 
-void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg, switch_bool_t freeze)
+/* caller holds layer->canvas->mutex, or is a compose thread working for the muxing thread that does */
+static void scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg, switch_bool_t freeze)
 {
 	switch_image_t *IMG, *img;
 	int img_changed = 0, want_w = 0, want_h = 0, border = 0;
-
-	switch_mutex_lock(layer->canvas->mutex);
+	int cacheable;
 
 	IMG = layer->canvas->img;
 	img = ximg ? ximg : layer->cur_img;
@@ -516,9 +564,10 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 	switch_assert(IMG);
 
 	if (!img) {
-		switch_mutex_unlock(layer->canvas->mutex);
 		return;
 	}
+
+	cacheable = !ximg && !freeze && !layer->bugged;
 	//printf("RAW %dx%d\n", img->d_w, img->d_h);
 
 	if (layer->img_count++ == 0 || layer->last_w != img->d_w || layer->last_h != img->d_h) {
@@ -638,6 +687,8 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 			int can_zoom = 0;
 			int did_zoom = 0;
 
+			cacheable = 0;
+
 			if (screen_aspect <= img_aspect) {
 				if (img->d_h != layer->screen_h) {
 					scale = (double)layer->screen_h / img->d_h;
@@ -837,6 +888,7 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 				
 			if (layer->img->d_w != img_w || layer->img->d_h != img_h) {
 				switch_img_free(&layer->img);
+				layer->scaled_seq = 0;
 				conference_video_clear_layer(layer);
 			}
 		}
@@ -858,19 +910,28 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 
 		//printf("SCALE %d,%d %dx%d\n", x_pos, y_pos, img_w, img_h);
 
-		switch_img_scale(img, &layer->img, img_w, img_h);
-		
-		if (layer->logo_img) {
-			//int ew = layer->screen_w - (border * 2), eh = layer->screen_h - (layer->banner_img ? layer->banner_img->d_h : 0) - (border * 2);
-			int ew = layer->img->d_w - (border * 2), eh = layer->img->d_h - (border * 2);
-			int ex = 0, ey = 0;
+		if (cacheable && layer->scaled_seq && layer->scaled_seq == layer->cur_img_seq && layer->scaled_logo_seq == layer->logo_seq) {
+			/* same picture as last time, layer->img still has it scaled with the logo on top */
+			switch_atomic_inc(&layer->canvas->compose_cached);
+		} else {
+			switch_img_scale(img, &layer->img, img_w, img_h);
+			switch_atomic_inc(&layer->canvas->compose_scales);
 
-			switch_img_fit(&layer->logo_img, ew, eh, layer->logo_fit);
+			if (layer->logo_img) {
+				//int ew = layer->screen_w - (border * 2), eh = layer->screen_h - (layer->banner_img ? layer->banner_img->d_h : 0) - (border * 2);
+				int ew = layer->img->d_w - (border * 2), eh = layer->img->d_h - (border * 2);
+				int ex = 0, ey = 0;
 
-			switch_img_find_position(layer->logo_pos, ew, eh, layer->logo_img->d_w, layer->logo_img->d_h, &ex, &ey);
-			
-			switch_img_patch(layer->img, layer->logo_img, ex + border, ey + border);
-			//switch_img_patch(IMG, layer->logo_img, layer->x_pos + ex + border, layer->y_pos + ey + border);
+				switch_img_fit(&layer->logo_img, ew, eh, layer->logo_fit);
+
+				switch_img_find_position(layer->logo_pos, ew, eh, layer->logo_img->d_w, layer->logo_img->d_h, &ex, &ey);
+
+				switch_img_patch(layer->img, layer->logo_img, ex + border, ey + border);
+				//switch_img_patch(IMG, layer->logo_img, layer->x_pos + ex + border, layer->y_pos + ey + border);
+			}
+
+			layer->scaled_seq = cacheable ? layer->cur_img_seq : 0;
+			layer->scaled_logo_seq = layer->logo_seq;
 		}
 
 
@@ -911,7 +972,9 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 				}
 
 				switch_img_patch(layer->img, layer->overlay_img, 0, 0);
-						 
+
+				/* the overlay is blended into layer->img, scale it again next time */
+				layer->scaled_seq = 0;
 			}
 			switch_mutex_unlock(layer->overlay_mutex);
 			
@@ -923,9 +986,13 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "insert at %d,%d\n", 0, 0);
 		switch_img_patch(IMG, img, 0, 0);
 	}
+}
 
+void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg, switch_bool_t freeze)
+{
+	switch_mutex_lock(layer->canvas->mutex);
+	scale_and_patch(layer, ximg, freeze);
 	switch_mutex_unlock(layer->canvas->mutex);
-
 }
 
 void conference_video_set_canvas_bgcolor(mcu_canvas_t *canvas, char *color)
@@ -1104,6 +1171,7 @@ void conference_video_layer_set_logo(conference_member_t *member, mcu_layer_t *l
 	switch_mutex_lock(layer->canvas->mutex);
 
 	switch_img_free(&layer->logo_img);
+	layer->logo_seq++;
 
 	switch_mutex_lock(member->flag_mutex);
 
@@ -1866,6 +1934,7 @@ void conference_video_write_canvas_image_to_codec_group(conference_obj_t *confer
 	switch_frame_t write_frame = { 0 }, *frame = NULL;
 	switch_status_t encode_status = SWITCH_STATUS_FALSE;
 	switch_image_t *scaled_img = codec_set->scaled_img;
+	switch_time_t encode_start, encode_took = 0;
 
 	write_frame = codec_set->frame;
 	frame = &write_frame;
@@ -1893,7 +1962,27 @@ void conference_video_write_canvas_image_to_codec_group(conference_obj_t *confer
 			return;
 		}
 
-		switch_img_scale(frame->img, &scaled_img, scaled_img->d_w, scaled_img->d_h);
+		encode_start = switch_time_now();
+		if (conference->video_ladder_count) {
+			/* letterbox the canvas into the rung, the bars are filled once when the fit is set up */
+			if (!codec_set->fit_img) {
+				int fit_w, fit_h;
+
+				switch_img_calc_fit(frame->img, scaled_img->d_w, scaled_img->d_h, &fit_w, &fit_h);
+				fit_w &= ~1;
+				fit_h &= ~1;
+				codec_set->fit_x = ((scaled_img->d_w - fit_w) / 2) & ~1;
+				codec_set->fit_y = ((scaled_img->d_h - fit_h) / 2) & ~1;
+				switch_img_fill(scaled_img, 0, 0, scaled_img->d_w, scaled_img->d_h, &canvas->letterbox_bgcolor);
+				codec_set->fit_img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, fit_w, fit_h, 16);
+			}
+
+			switch_img_scale(frame->img, &codec_set->fit_img, codec_set->fit_img->d_w, codec_set->fit_img->d_h);
+			switch_img_patch(scaled_img, codec_set->fit_img, codec_set->fit_x, codec_set->fit_y);
+		} else {
+			switch_img_scale(frame->img, &scaled_img, scaled_img->d_w, scaled_img->d_h);
+		}
+		encode_took += switch_time_now() - encode_start;
 		frame->img = scaled_img;
 	}
 
@@ -1902,7 +1991,9 @@ void conference_video_write_canvas_image_to_codec_group(conference_obj_t *confer
 		frame->data = ((unsigned char *)frame->packet) + 12;
 		frame->datalen = SWITCH_DEFAULT_VIDEO_SIZE;
 
+		encode_start = switch_time_now();
 		encode_status = switch_core_codec_encode_video(&codec_set->codec, frame);
+		encode_took += switch_time_now() - encode_start;
 
 		if (encode_status == SWITCH_STATUS_SUCCESS || encode_status == SWITCH_STATUS_MORE_DATA) {
 
@@ -1979,6 +2070,116 @@ void conference_video_write_canvas_image_to_codec_group(conference_obj_t *confer
 		}
 
 	} while(encode_status == SWITCH_STATUS_MORE_DATA);
+
+	codec_set->encode_last = encode_took;
+	codec_set->encode_avg = codec_set->encode_frames ? (codec_set->encode_avg * 15 + encode_took) / 16 : encode_took;
+
+	if (encode_took > codec_set->encode_max) {
+		codec_set->encode_max = encode_took;
+	}
+
+	codec_set->encode_frames++;
+}
+
+/* move the member to the ladder rung that fits the bandwidth its receiver reported with REMB or TMMBR */
+static void conference_video_check_rung(conference_obj_t *conference, conference_member_t *member, switch_time_t now)
+{
+	switch_rtp_stats_t *stats;
+	uint32_t bps = 0;
+	int rung, i;
+
+	if (!conference->video_ladder_count || now - member->video_rung_checked < 1000000) {
+		return;
+	}
+
+	member->video_rung_checked = now;
+
+	if ((stats = switch_core_media_get_stats(member->session, SWITCH_MEDIA_TYPE_VIDEO, NULL))) {
+		bps = stats->rtcp.peer_max_bitrate;
+	}
+
+	if (!(member->video_rung_bps = bps)) {
+		return;
+	}
+
+	rung = conference->video_ladder_count - 1;
+
+	for (i = 0; i < conference->video_ladder_count; i++) {
+		if ((uint64_t)conference->video_ladder[i].kbps * 1000 <= bps) {
+			rung = i;
+			break;
+		}
+	}
+
+	/* going up needs 10% to spare and 5 seconds on the current rung so a noisy estimate does not bounce */
+	if (rung < member->video_rung &&
+		((uint64_t)conference->video_ladder[rung].kbps * 1100 > bps || now - member->video_rung_changed < 5000000)) {
+		return;
+	}
+
+	if (rung != member->video_rung) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_DEBUG, "%s receives %ukbps, moving from %dx%d to %dx%d\n",
+						  switch_channel_get_name(member->channel), bps / 1000,
+						  conference->video_ladder[member->video_rung].width, conference->video_ladder[member->video_rung].height,
+						  conference->video_ladder[rung].width, conference->video_ladder[rung].height);
+		member->video_rung = rung;
+		member->video_rung_changed = now;
+		member->video_codec_index = -1;
+	}
+}
+
+void conference_video_ladder_status(mcu_canvas_t *canvas, switch_stream_handle_t *stream)
+{
+	conference_obj_t *conference = canvas->conference;
+	conference_member_t *imember;
+	int frame_us = conference->video_fps.ms * 1000;
+	int i;
+
+	stream->write_function(stream, "canvas %d: %d encoders\n", canvas->canvas_id + 1, canvas->write_codecs_count);
+
+	for (i = 0; i < canvas->write_codecs_count; i++) {
+		codec_set_t *codec_set = canvas->write_codecs[i];
+		int members = 0;
+
+		if (!codec_set || !switch_core_codec_ready(&codec_set->codec)) {
+			continue;
+		}
+
+		switch_mutex_lock(conference->member_mutex);
+		for (imember = conference->members; imember; imember = imember->next) {
+			if (imember->watching_canvas_id == canvas->canvas_id && imember->video_codec_index == i) {
+				members++;
+			}
+		}
+		switch_mutex_unlock(conference->member_mutex);
+
+		stream->write_function(stream, "  slot %d %s group %s", i, codec_set->codec.implementation->iananame, switch_str_nil(codec_set->video_codec_group));
+
+		if (conference->video_ladder_count) {
+			video_rung_t *rung = &conference->video_ladder[codec_set->rung];
+
+			stream->write_function(stream, " rung %d %ux%u@%dkbps", codec_set->rung, rung->width, rung->height, rung->kbps);
+		}
+
+		stream->write_function(stream, " members %d frames %"SWITCH_UINT64_T_FMT" encode last %0.2fms avg %0.2fms max %0.2fms cpu %d%%\n",
+							   members, codec_set->encode_frames, (double)codec_set->encode_last / 1000,
+							   (double)codec_set->encode_avg / 1000, (double)codec_set->encode_max / 1000,
+							   frame_us ? (int)(codec_set->encode_avg * 100 / frame_us) : 0);
+	}
+
+	if (!conference->video_ladder_count) {
+		return;
+	}
+
+	switch_mutex_lock(conference->member_mutex);
+	for (imember = conference->members; imember; imember = imember->next) {
+		if (imember->watching_canvas_id != canvas->canvas_id || !imember->session) {
+			continue;
+		}
+
+		stream->write_function(stream, "  member %u rung %d receives %ukbps\n", imember->id, imember->video_rung, imember->video_rung_bps / 1000);
+	}
+	switch_mutex_unlock(conference->member_mutex);
 }
 
 video_layout_t *conference_video_find_best_layout(conference_obj_t *conference, layout_group_t *lg, uint32_t count, uint32_t file_count)
@@ -2189,89 +2390,152 @@ void conference_video_launch_muxing_thread(conference_obj_t *conference, mcu_can
 	switch_mutex_unlock(conference_globals.hash_mutex);
 }
 
-void *SWITCH_THREAD_FUNC conference_video_layer_thread_run(switch_thread_t *thread, void *obj)
+static void *SWITCH_THREAD_FUNC conference_video_compose_thread_run(switch_thread_t *thread, void *obj)
 {
-	conference_member_t *member = (conference_member_t *) obj;
+	mcu_canvas_t *canvas = (mcu_canvas_t *) obj;
+	void *pop;
 
-	if (switch_thread_rwlock_tryrdlock(member->rwlock) != SWITCH_STATUS_SUCCESS) {
-		return NULL;
+	while (switch_queue_pop(canvas->compose_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		mcu_layer_t *layer = (mcu_layer_t *) pop;
+
+		scale_and_patch(layer, NULL, SWITCH_FALSE);
+
+		switch_mutex_lock(canvas->compose_mutex);
+		if (--canvas->compose_pending == 0) {
+			switch_thread_cond_signal(canvas->compose_cond);
+		}
+		switch_mutex_unlock(canvas->compose_mutex);
 	}
 
-	//switch_core_autobind_cpu();
-	member->layer_thread_running = 1;
+	return NULL;
+}
 
-	switch_mutex_lock(member->layer_cond_mutex);
-	
-	while(conference_utils_member_test_flag(member, MFLAG_RUNNING) && member->layer_thread_running) {
-		mcu_layer_t *layer = NULL;
-		mcu_canvas_t *canvas = NULL;
-		
+static void conference_video_launch_compose_threads(mcu_canvas_t *canvas)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	int threads = canvas->conference->video_compose_threads;
+	int cpus = switch_core_cpu_count();
 
-		switch_thread_cond_wait(member->layer_cond, member->layer_cond_mutex);
+	if (threads < 0) {
+		threads = cpus > 2 ? cpus - 1 : 0;
 
-		if (!conference_utils_member_test_flag(member, MFLAG_RUNNING)) {
-			break;
+		if (threads > 4) {
+			threads = 4;
 		}
+	}
 
+	if (threads > MAX_COMPOSE_THREADS) {
+		threads = MAX_COMPOSE_THREADS;
+	}
 
-		if (member->video_layer_id > -1 && member->canvas_id > -1) {
-			canvas = member->conference->canvases[member->canvas_id];
-			layer = &canvas->layers[member->video_layer_id];
-		}
+	if (!threads) {
+		return;
+	}
 
-		if (layer) {
-			if (layer->need_patch) {
-				conference_video_scale_and_patch(layer, NULL, SWITCH_FALSE);
-				layer->need_patch = 0;
-			}
+	if (!canvas->compose_queue) {
+		switch_queue_create(&canvas->compose_queue, MCU_MAX_LAYERS + MAX_COMPOSE_THREADS, canvas->pool);
+		switch_mutex_init(&canvas->compose_mutex, SWITCH_MUTEX_NESTED, canvas->pool);
+		switch_thread_cond_create(&canvas->compose_cond, canvas->pool);
+	}
+
+	switch_threadattr_create(&thd_attr, canvas->pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	for (canvas->compose_thread_count = 0; canvas->compose_thread_count < threads; canvas->compose_thread_count++) {
+		if (switch_thread_create(&canvas->compose_threads[canvas->compose_thread_count], thd_attr,
+								 conference_video_compose_thread_run, canvas, canvas->pool) != SWITCH_STATUS_SUCCESS) {
+			break;
 		}
 	}
 
-	switch_mutex_unlock(member->layer_cond_mutex);
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s canvas %d composing with %d threads\n",
+					  canvas->conference->name, canvas->canvas_id + 1, canvas->compose_thread_count);
+}
+
+static void conference_video_stop_compose_threads(mcu_canvas_t *canvas)
+{
+	switch_status_t st;
+	int i;
 
-	member->layer_thread_running = 0;
+	for (i = 0; i < canvas->compose_thread_count; i++) {
+		switch_queue_push(canvas->compose_queue, NULL);
+	}
 
-	switch_thread_rwlock_unlock(member->rwlock);
+	for (i = 0; i < canvas->compose_thread_count; i++) {
+		switch_thread_join(&st, canvas->compose_threads[i]);
+		canvas->compose_threads[i] = NULL;
+	}
 
-	return NULL;
+	canvas->compose_thread_count = 0;
 }
 
-void conference_video_wake_layer_thread(conference_member_t *member)
+/* scale and patch layers that do not overlap each other, the caller holds canvas->mutex for all of them */
+static void conference_video_compose_layers(mcu_canvas_t *canvas, mcu_layer_t **layers, int count)
 {
-	if (member->layer_cond) {
-		if (switch_mutex_trylock(member->layer_cond_mutex) == SWITCH_STATUS_SUCCESS) {
-			switch_thread_cond_signal(member->layer_cond);
-			switch_mutex_unlock(member->layer_cond_mutex);
+	int i;
+
+	if (count < 2 || !canvas->compose_thread_count) {
+		for (i = 0; i < count; i++) {
+			scale_and_patch(layers[i], NULL, SWITCH_FALSE);
 		}
-		
+
+		return;
+	}
+
+	switch_mutex_lock(canvas->compose_mutex);
+	canvas->compose_pending = count - 1;
+	switch_mutex_unlock(canvas->compose_mutex);
+
+	for (i = 1; i < count; i++) {
+		switch_queue_push(canvas->compose_queue, layers[i]);
+	}
+
+	scale_and_patch(layers[0], NULL, SWITCH_FALSE);
+
+	switch_mutex_lock(canvas->compose_mutex);
+	while (canvas->compose_pending) {
+		switch_thread_cond_wait(canvas->compose_cond, canvas->compose_mutex);
 	}
+	switch_mutex_unlock(canvas->compose_mutex);
 }
-	
 
-void conference_video_launch_layer_thread(conference_member_t *member)
+static void conference_video_compose_done(mcu_canvas_t *canvas, switch_time_t start, int layers)
 {
-	switch_threadattr_t *thd_attr = NULL;
+	switch_time_t took;
 
-	if (switch_core_cpu_count() < 3) {
+	if (!layers) {
 		return;
 	}
 
-	if (!member->layer_cond) {
-		switch_thread_cond_create(&member->layer_cond, member->pool);
-		switch_mutex_init(&member->layer_cond_mutex, SWITCH_MUTEX_NESTED, member->pool);
-	}
+	took = switch_time_now() - start;
 
-	switch_mutex_lock(conference_globals.hash_mutex);
-	if (!member->video_layer_thread) {
-		switch_threadattr_create(&thd_attr, member->pool);
-		//switch_threadattr_priority_set(thd_attr, SWITCH_PRI_REALTIME);
-		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-		switch_thread_create(&member->video_layer_thread, thd_attr, conference_video_layer_thread_run, member, member->pool);
+	canvas->compose_last = took;
+	canvas->compose_avg = canvas->compose_frames ? (canvas->compose_avg * 15 + took) / 16 : took;
+
+	if (took > canvas->compose_max) {
+		canvas->compose_max = took;
 	}
-	switch_mutex_unlock(conference_globals.hash_mutex);
+
+	canvas->compose_frames++;
+	canvas->compose_layers += layers;
 }
 
+void conference_video_compose_status(mcu_canvas_t *canvas, switch_stream_handle_t *stream)
+{
+	int frame_us = canvas->conference->video_fps.ms * 1000;
+	int headroom = 0;
+
+	if (frame_us && canvas->compose_frames) {
+		headroom = (int)((frame_us - canvas->compose_avg) * 100 / frame_us);
+	}
 
+	stream->write_function(stream, "canvas %d: threads %d frames %"SWITCH_UINT64_T_FMT" layers %"SWITCH_UINT64_T_FMT
+						   " scaled %u cached %u compose last %0.2fms avg %0.2fms max %0.2fms frame %dms headroom %d%%\n",
+						   canvas->canvas_id + 1, canvas->compose_thread_count, canvas->compose_frames, canvas->compose_layers,
+						   switch_atomic_read(&canvas->compose_scales), switch_atomic_read(&canvas->compose_cached),
+						   (double)canvas->compose_last / 1000, (double)canvas->compose_avg / 1000, (double)canvas->compose_max / 1000,
+						   canvas->conference->video_fps.ms, headroom);
+}
 
 
 void *SWITCH_THREAD_FUNC conference_video_muxing_write_thread_run(switch_thread_t *thread, void *obj)
@@ -2578,6 +2842,7 @@ void conference_video_patch_fnode(mcu_canvas_t *canvas, conference_file_node_t *
 					file_frame.img = tmp;
 				}
 				layer->cur_img = file_frame.img;
+				layer->cur_img_seq++;
 			}
 
 			layer->tagged = 1;
@@ -3045,33 +3310,6 @@ void conference_video_check_auto_bitrate(conference_member_t *member, mcu_layer_
 	}
 }
 
-static void wait_for_canvas(mcu_canvas_t *canvas)
-{
-	switch_mutex_lock(canvas->write_mutex);
-	for (;;) {
-		int x = 0;
-		int i = 0;
-
-		for (i = 0; i < canvas->total_layers; i++) {
-			mcu_layer_t *layer = &canvas->layers[i];
-
-			if (layer->need_patch) {
-				if (layer->member_id && layer->member && conference_utils_member_test_flag(layer->member, MFLAG_RUNNING) && layer->member->fb) {
-					conference_video_wake_layer_thread(layer->member);
-					x++;
-				} else {
-					layer->need_patch = 0;
-				}
-			}
-		}
-
-		if (!x) break;
-
-		switch_cond_next();
-	}
-	switch_mutex_unlock(canvas->write_mutex);
-}
-
 static void personal_attach(mcu_layer_t *layer, conference_member_t *member)
 {
 	layer->tagged = 1;
@@ -3083,6 +3321,7 @@ static void personal_attach(mcu_layer_t *layer, conference_member_t *member)
 		layer->avatar_patched = 0;
 		switch_img_free(&layer->banner_img);
 		switch_img_free(&layer->logo_img);
+		layer->logo_seq++;
 
 		if (layer->geometry.audio_position) {
 			conference_api_sub_position(member, NULL, layer->geometry.audio_position);
@@ -3151,6 +3390,8 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 
 	packet = switch_core_alloc(conference->pool, SWITCH_RTP_MAX_BUF_LEN);
 
+	conference_video_launch_compose_threads(canvas);
+
 	while (conference_globals.running && !conference_utils_test_flag(conference, CFLAG_DESTRUCT) && conference_utils_test_flag(conference, CFLAG_VIDEO_MUXING)) {
 		switch_bool_t need_refresh = SWITCH_FALSE, send_keyframe = SWITCH_FALSE, need_reset = SWITCH_FALSE;
 		switch_time_t now;
@@ -3354,9 +3595,12 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 				min_members++;
 
 				if (switch_channel_test_flag(imember->channel, CF_VIDEO_READY)) {
+					conference_video_check_rung(conference, imember, now);
+
 					if (imember->video_codec_index < 0 && (check_codec = switch_core_session_get_video_write_codec(imember->session))) {
 						for (i = 0; canvas->write_codecs[i] && switch_core_codec_ready(&canvas->write_codecs[i]->codec) && i < MAX_MUX_CODECS; i++) {
-							if (check_codec->implementation->codec_id == canvas->write_codecs[i]->codec.implementation->codec_id) {
+							if (check_codec->implementation->codec_id == canvas->write_codecs[i]->codec.implementation->codec_id &&
+								canvas->write_codecs[i]->rung == imember->video_rung) {
 								if ((zstr(imember->video_codec_group) && zstr(canvas->write_codecs[i]->video_codec_group)) || 
 									(!strcmp(switch_str_nil(imember->video_codec_group), switch_str_nil(canvas->write_codecs[i]->video_codec_group)))) {
 								
@@ -3414,7 +3658,18 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 								canvas->write_codecs[i]->frame.data = ((uint8_t *)canvas->write_codecs[i]->frame.packet) + 12;
 								canvas->write_codecs[i]->frame.packetlen = buflen;
 								canvas->write_codecs[i]->frame.buflen = buflen - 12;
-								if (conference->scale_h264_canvas_width > 0 && conference->scale_h264_canvas_height > 0 && !strcmp(check_codec->implementation->iananame, "H264")) {
+								if (conference->video_ladder_count) {
+									video_rung_t *rung = &conference->video_ladder[imember->video_rung];
+									int32_t bw = rung->kbps;
+
+									canvas->write_codecs[i]->rung = imember->video_rung;
+
+									if (rung->width != (uint32_t)canvas->width || rung->height != (uint32_t)canvas->height) {
+										canvas->write_codecs[i]->scaled_img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, rung->width, rung->height, 16);
+									}
+
+									switch_core_codec_control(&canvas->write_codecs[i]->codec, SCC_VIDEO_BANDWIDTH, SCCT_INT, &bw, SCCT_NONE, NULL, NULL, NULL);
+								} else if (conference->scale_h264_canvas_width > 0 && conference->scale_h264_canvas_height > 0 && !strcmp(check_codec->implementation->iananame, "H264")) {
 									int32_t bw = -1;
 
 									canvas->write_codecs[i]->fps_divisor = conference->scale_h264_canvas_fps_divisor;
@@ -3538,6 +3793,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 						switch_img_free(&layer->cur_img);
 						switch_img_letterbox(imember->avatar_png_img,
 											 &layer->cur_img, layer->screen_w, layer->screen_h, conference->video_letterbox_bgcolor);
+						layer->cur_img_seq++;
 						imember->avatar_patched = 1;
 					}
 				}
@@ -3617,6 +3873,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 						switch_img_free(&layer->cur_img);
 						layer->cur_img = img;
 					}
+					layer->cur_img_seq++;
 
 
 					img = NULL;
@@ -3853,6 +4110,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 								if (omember->avatar_png_img) {
 									switch_img_letterbox(omember->avatar_png_img,
 														 &layer->cur_img, layer->screen_w, layer->screen_h, conference->video_letterbox_bgcolor);
+									layer->cur_img_seq++;
 								}
 								layer->avatar_patched = 1;
 							}
@@ -3875,6 +4133,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 										//conference_video_member_video_mute_banner(imember->canvas, layer, imember);
 										conference_video_member_video_mute_banner(tmp, omember);
 										switch_img_copy(tmp, &layer->cur_img);
+										layer->cur_img_seq++;
 									}
 									
 									layer->mute_patched = 1;
@@ -3908,6 +4167,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 					if (layer) {
 						switch_img_free(&layer->banner_img);
 						switch_img_free(&layer->logo_img);
+						layer->logo_seq++;
 						layer->member_id = -1;
 						//switch_img_copy(img, &layer->cur_img);
 						conference_video_scale_and_patch(layer, img, SWITCH_FALSE);
@@ -4000,6 +4260,12 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 			switch_mutex_unlock(conference->file_mutex);
 
 			if (!canvas->playing_video_file) {
+				mcu_layer_t *compose[MCU_MAX_LAYERS];
+				int compose_count = 0;
+				switch_time_t compose_start = switch_time_now();
+
+				switch_mutex_lock(canvas->mutex);
+
 				for (i = 0; i < canvas->total_layers; i++) {
 					mcu_layer_t *layer = &canvas->layers[i];
 
@@ -4009,20 +4275,14 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 							canvas->refresh++;
 						}
 
-						if (layer->member && switch_core_cpu_count() > 2) {
-							layer->need_patch = 1;
-							conference_video_wake_layer_thread(layer->member);
-						} else {
-							conference_video_scale_and_patch(layer, NULL, SWITCH_FALSE);
-						}
-
+						compose[compose_count++] = layer;
 						layer->tagged = 0;
 					}
 				}
 
-				switch_core_timer_next(&canvas->timer);
-				wait_for_canvas(canvas);
-				
+				conference_video_compose_layers(canvas, compose, compose_count);
+
+				/* overlapping layers go on in order so the later ones stay on top */
 				for (i = 0; i < canvas->total_layers; i++) {
 					mcu_layer_t *layer = &canvas->layers[i];
 					
@@ -4036,14 +4296,16 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 							canvas->refresh++;
 						}
 
-						if (layer->member && switch_core_cpu_count() > 2) {
-							layer->need_patch = 1;
-							conference_video_wake_layer_thread(layer->member);
-						} else {
-							conference_video_scale_and_patch(layer, NULL, SWITCH_FALSE);
-						}
+						scale_and_patch(layer, NULL, SWITCH_FALSE);
+						compose_count++;
 					}
 				}
+
+				switch_mutex_unlock(canvas->mutex);
+
+				conference_video_compose_done(canvas, compose_start, compose_count);
+
+				switch_core_timer_next(&canvas->timer);
 			}
 
 			if (canvas->refresh > 1) {
@@ -4141,10 +4403,6 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 
 			write_frame.img = write_img;
 
-			if (!canvas->playing_video_file && !canvas->overlay_video_file) {
-				wait_for_canvas(canvas);
-			}
-
 			if (canvas->fgimg) {
 				conference_video_set_canvas_fgimg(canvas, NULL);
 			}
@@ -4235,6 +4493,8 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 		} // NOT PERSONAL
 	}
 
+	conference_video_stop_compose_threads(canvas);
+
 	switch_img_free(&file_img);
 
 	for (i = 0; i < MCU_MAX_LAYERS; i++) {
@@ -4248,6 +4508,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 		layer->banner_patched = 0;
 		switch_img_free(&layer->banner_img);
 		switch_img_free(&layer->logo_img);
+		layer->logo_seq++;
 		switch_img_free(&layer->mute_img);
 		switch_mutex_unlock(layer->overlay_mutex);
 		switch_mutex_unlock(canvas->mutex);
@@ -4261,6 +4522,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 		if (canvas->write_codecs[i] && switch_core_codec_ready(&canvas->write_codecs[i]->codec)) {
 			switch_core_codec_destroy(&canvas->write_codecs[i]->codec);
 			switch_img_free(&(canvas->write_codecs[i]->scaled_img));
+			switch_img_free(&(canvas->write_codecs[i]->fit_img));
 		}
 	}
 
@@ -4524,6 +4786,7 @@ void *SWITCH_THREAD_FUNC conference_video_super_muxing_thread_run(switch_thread_
 
 					switch_img_free(&layer->cur_img);
 					layer->cur_img = img;
+					layer->cur_img_seq++;
 					img = NULL;
 				}
 
@@ -4623,6 +4886,7 @@ void *SWITCH_THREAD_FUNC conference_video_super_muxing_thread_run(switch_thread_
 		layer->banner_patched = 0;
 		switch_img_free(&layer->banner_img);
 		switch_img_free(&layer->logo_img);
+		layer->logo_seq++;
 		switch_img_free(&layer->mute_img);
 		switch_mutex_unlock(layer->overlay_mutex);
 		switch_mutex_unlock(canvas->mutex);
@@ -4710,6 +4974,255 @@ void conference_video_reset_member_codec_index(conference_member_t *member)
 	member->video_codec_index = -1;
 }
 
+/* 1 when the payload starts a keyframe, 0 when it does not, -1 when the codec can't be told without decoding */
+static int conference_video_sfu_keyframe(const char *iananame, const uint8_t *data, uint32_t datalen)
+{
+	if (!iananame || !data || datalen < 2) {
+		return -1;
+	}
+
+	if (!strcasecmp(iananame, "VP8")) {
+		const uint8_t *end = data + datalen;
+		uint8_t des = *data++;
+
+		if (!(des & 0x10) || (des & 0x07)) {
+			return 0;
+		}
+
+		if ((des & 0x80) && data < end) { // X
+			uint8_t x = *data++;
+
+			if ((x & 0x80) && data < end) { // I
+				if (*data++ & 0x80) data++;
+			}
+			if (x & 0x40) data++; // L
+			if (x & 0x30) data++; // T/K
+		}
+
+		return data < end ? !(*data & 0x01) : 0;
+	}
+
+	if (!strcasecmp(iananame, "VP9")) {
+		return ((*data & 0x40) == 0 && (*data & 0x08)) ? 1 : 0;
+	}
+
+	if (!strcasecmp(iananame, "H264")) {
+		uint8_t nalu_type = data[0] & 0x1f;
+
+		if (nalu_type == 24 && datalen > 3) { // STAP-A, look at the first unit
+			nalu_type = data[3] & 0x1f;
+		} else if (nalu_type == 28) { // FU-A, only the start fragment
+			if (!(data[1] & 0x80)) {
+				return 0;
+			}
+			nalu_type = data[1] & 0x1f;
+		}
+
+		return (nalu_type == 5 || nalu_type == 7) ? 1 : 0;
+	}
+
+	return -1;
+}
+
+/* ask a sender for a keyframe, at most once per SFU_KEY_REQ_MIN_FREQ however many receivers want one */
+static void conference_video_sfu_request_key(conference_member_t *member)
+{
+	switch_time_t now = switch_time_now();
+	switch_rtp_t *rtp_session;
+
+	if (!member->session || (member->sfu_key_req && now - member->sfu_key_req < SFU_KEY_REQ_MIN_FREQ)) {
+		return;
+	}
+
+	member->sfu_key_req = now;
+	member->conference->sfu_key_requests++;
+
+	if ((rtp_session = switch_core_media_get_rtp_session(member->session, SWITCH_MEDIA_TYPE_VIDEO))) {
+		switch_rtp_video_refresh(rtp_session);
+	} else {
+		switch_core_session_request_video_refresh(member->session);
+	}
+}
+
+/* the sender a receiver should see: the video floor, or the previous floor holder for the floor holder itself */
+static uint32_t conference_video_sfu_source(conference_obj_t *conference, conference_member_t *imember)
+{
+	if (imember->id == conference->video_floor_holder) {
+		return conference->last_video_floor_holder;
+	}
+
+	return conference->video_floor_holder;
+}
+
+/* forward one packet of a sender to everyone watching it, without decoding it.
+   Every receiver gets a single continuous stream: when its sender changes the new packets are held back until
+   a keyframe and then renumbered to follow the old ones, so the ssrc stays put and sequence numbers and
+   timestamps don't jump. The outgoing RTP session still stamps its own ssrc, and with SWITCH_RTP_FLAG_PASSTHRU
+   set on it carries the gaps in the sequence over, so receivers only see real loss.
+   The packets are queued on the receiver's frame buffer and written by its muxing write thread, as in mux mode.
+   Receivers that negotiated another video codec than the sender can't use its packets and are skipped, the others
+   get the payload type they negotiated for it. */
+static void conference_video_sfu_forward(conference_member_t *member, switch_frame_t *frame)
+{
+	conference_obj_t *conference = member->conference;
+	conference_member_t *imember;
+	switch_codec_t *codec;
+	const char *iananame = NULL;
+	int is_key = -1, want_key = 0;
+	switch_time_t now = switch_time_now();
+	unsigned char buf[sizeof(switch_rtp_packet_t)] = "";
+	switch_frame_t tmp_frame = { 0 }, *dupframe;
+	switch_size_t data_off;
+
+	if (!frame->packet || frame->packetlen < 12 || frame->packetlen > SWITCH_RTP_MAX_BUF_LEN) {
+		return;
+	}
+
+	if ((codec = switch_core_session_get_video_read_codec(member->session)) && codec->implementation) {
+		iananame = codec->implementation->iananame;
+	}
+
+	data_off = (uint8_t *)frame->data - (uint8_t *)frame->packet;
+
+	switch_mutex_lock(conference->member_mutex);
+	for (imember = conference->members; imember; imember = imember->next) {
+		conference_sfu_stream_t *sfu = &imember->sfu;
+		switch_codec_t *write_codec;
+		switch_rtp_hdr_t *hdr;
+
+		if (imember == member || !imember->session || !imember->channel || !imember->fb ||
+			conference_video_sfu_source(conference, imember) != member->id ||
+			!conference_utils_member_test_flag(imember, MFLAG_CAN_SEE) ||
+			conference_utils_member_test_flag(imember, MFLAG_RECEIVING_VIDEO) ||
+			!switch_channel_test_flag(imember->channel, CF_VIDEO_READY)) {
+			continue;
+		}
+
+		if (!iananame || !(write_codec = switch_core_session_get_video_write_codec(imember->session)) ||
+			!write_codec->implementation || strcasecmp(write_codec->implementation->iananame, iananame)) {
+			if (!sfu->codec_mismatch) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(imember->session), SWITCH_LOG_WARNING,
+								  "Member %u can't be forwarded %s video from member %u\n", imember->id, iananame ? iananame : "unknown", member->id);
+			}
+			sfu->codec_mismatch = member->id;
+			continue;
+		}
+
+		sfu->codec_mismatch = 0;
+
+		if (switch_channel_test_flag(imember->channel, CF_VIDEO_REFRESH_REQ)) {
+			switch_channel_clear_flag(imember->channel, CF_VIDEO_REFRESH_REQ);
+			want_key++;
+		}
+
+		if (sfu->src_id != member->id) {
+			sfu->src_id = member->id;
+			sfu->waiting_key = 1;
+			sfu->wait_start = now;
+			sfu->switches++;
+			conference->sfu_switches++;
+			want_key++;
+		}
+
+		if (sfu->waiting_key) {
+			if (is_key == -1 && iananame) {
+				is_key = conference_video_sfu_keyframe(iananame, frame->data, frame->datalen);
+			}
+
+			if (!is_key && now - sfu->wait_start < SFU_KEY_WAIT_MAX) {
+				conference->sfu_dropped++;
+				want_key++;
+				continue;
+			}
+
+			sfu->waiting_key = 0;
+
+			if (sfu->ssrc) {
+				sfu->seq_offset = (uint16_t)(sfu->last_seq + 1 - frame->seq);
+				sfu->ts_offset = sfu->last_ts + SFU_TS_GAP - frame->timestamp;
+			} else {
+				sfu->ssrc = frame->ssrc;
+				sfu->seq_offset = 0;
+				sfu->ts_offset = 0;
+			}
+		}
+
+		/* without it the RTP layer numbers every packet it sends in turn and the gaps kept below are lost */
+		if (!sfu->passthru) {
+			switch_rtp_t *rtp_session;
+
+			if ((rtp_session = switch_core_media_get_rtp_session(imember->session, SWITCH_MEDIA_TYPE_VIDEO))) {
+				switch_rtp_set_flag(rtp_session, SWITCH_RTP_FLAG_PASSTHRU);
+				sfu->passthru = 1;
+			}
+		}
+
+		tmp_frame = *frame;
+		tmp_frame.packet = buf;
+		tmp_frame.data = buf + data_off;
+		tmp_frame.img = NULL;
+		memcpy(buf, frame->packet, frame->packetlen);
+
+		tmp_frame.seq = sfu->last_seq = (uint16_t)(frame->seq + sfu->seq_offset);
+		tmp_frame.timestamp = sfu->last_ts = frame->timestamp + sfu->ts_offset;
+		tmp_frame.ssrc = sfu->ssrc;
+		/* the sender's payload map belongs to its session, the receiver sends with its own payload type */
+		tmp_frame.pmap = NULL;
+		tmp_frame.payload = write_codec->agreed_pt;
+
+		hdr = (switch_rtp_hdr_t *)buf;
+		hdr->pt = write_codec->agreed_pt;
+		hdr->seq = htons(tmp_frame.seq);
+		hdr->ts = htonl(tmp_frame.timestamp);
+		hdr->ssrc = htonl(tmp_frame.ssrc);
+
+		if (switch_frame_buffer_dup(imember->fb, &tmp_frame, &dupframe) == SWITCH_STATUS_SUCCESS) {
+			/* the buffer assumes a bare 12 byte header, keep any csrcs or extensions in front of the payload */
+			dupframe->data = (uint8_t *)dupframe->packet + data_off;
+
+			if (switch_frame_buffer_trypush(imember->fb, dupframe) != SWITCH_STATUS_SUCCESS) {
+				switch_frame_buffer_free(imember->fb, &dupframe);
+				conference->sfu_dropped++;
+				continue;
+			}
+			dupframe = NULL;
+		}
+
+		sfu->packets++;
+		sfu->bytes += frame->packetlen;
+		conference->sfu_packets++;
+		conference->sfu_bytes += frame->packetlen;
+	}
+
+	if (want_key) {
+		conference_video_sfu_request_key(member);
+	}
+	switch_mutex_unlock(conference->member_mutex);
+}
+
+void conference_video_sfu_status(conference_obj_t *conference, switch_stream_handle_t *stream)
+{
+	conference_member_t *imember;
+
+	stream->write_function(stream, "sfu floor %u last %u packets %" SWITCH_UINT64_T_FMT " bytes %" SWITCH_UINT64_T_FMT
+						   " dropped %" SWITCH_UINT64_T_FMT " switches %u key-requests %u\n",
+						   conference->video_floor_holder, conference->last_video_floor_holder, conference->sfu_packets,
+						   conference->sfu_bytes, conference->sfu_dropped, conference->sfu_switches, conference->sfu_key_requests);
+
+	switch_mutex_lock(conference->member_mutex);
+	for (imember = conference->members; imember; imember = imember->next) {
+		if (!imember->session) {
+			continue;
+		}
+
+		stream->write_function(stream, "member %u watching %u packets %" SWITCH_UINT64_T_FMT " bytes %" SWITCH_UINT64_T_FMT
+							   " switches %u%s%s\n", imember->id, imember->sfu.src_id, imember->sfu.packets,
+							   imember->sfu.bytes, imember->sfu.switches, imember->sfu.waiting_key ? " waiting-key" : "",
+							   imember->sfu.codec_mismatch ? " codec-mismatch" : "");
+	}
+	switch_mutex_unlock(conference->member_mutex);
+}
+
 void conference_video_set_floor_holder(conference_obj_t *conference, conference_member_t *member, switch_bool_t force)
 {
 	switch_event_t *event;
@@ -4779,7 +5292,11 @@ void conference_video_set_floor_holder(conference_obj_t *conference, conference_
 						  switch_channel_get_name(member->channel));
 
 		conference_video_check_flush(member, SWITCH_FALSE);
-		switch_core_session_video_reinit(member->session);
+		if (conference->conference_video_mode == CONF_VIDEO_MODE_SFU) {
+			conference_video_sfu_request_key(member);
+		} else {
+			switch_core_session_video_reinit(member->session);
+		}
 		conference->video_floor_holder = member->id;
 		conference_member_update_status_field(member);
 		conference_video_clear_managed_kps(member);
@@ -4798,17 +5315,20 @@ void conference_video_set_floor_holder(conference_obj_t *conference, conference_
 		}
 	}
 
-	switch_mutex_lock(conference->member_mutex);
-	for (imember = conference->members; imember; imember = imember->next) {
-		if (!imember->channel || !switch_channel_test_flag(imember->channel, CF_VIDEO_READY)) {
-			continue;
-		}
+	/* in sfu mode the receivers keep their decoders, only the senders they now watch are asked for a keyframe */
+	if (conference->conference_video_mode != CONF_VIDEO_MODE_SFU) {
+		switch_mutex_lock(conference->member_mutex);
+		for (imember = conference->members; imember; imember = imember->next) {
+			if (!imember->channel || !switch_channel_test_flag(imember->channel, CF_VIDEO_READY)) {
+				continue;
+			}
 
-		switch_channel_set_flag(imember->channel, CF_VIDEO_BREAK);
-		switch_core_session_kill_channel(imember->session, SWITCH_SIG_BREAK);
-		switch_core_session_video_reinit(imember->session);
+			switch_channel_set_flag(imember->channel, CF_VIDEO_BREAK);
+			switch_core_session_kill_channel(imember->session, SWITCH_SIG_BREAK);
+			switch_core_session_video_reinit(imember->session);
+		}
+		switch_mutex_unlock(conference->member_mutex);
 	}
-	switch_mutex_unlock(conference->member_mutex);
 
 	conference_utils_set_flag(conference, CFLAG_FLOOR_CHANGE);
 
@@ -5069,7 +5589,15 @@ switch_status_t conference_video_thread_callback(switch_core_session_t *session,
 	}
 
 
-	if (member->id == member->conference->video_floor_holder) {
+	if (member->conference->conference_video_mode == CONF_VIDEO_MODE_SFU) {
+		if (member->id == member->conference->video_floor_holder || member->id == member->conference->last_video_floor_holder) {
+			conference_video_sfu_forward(member, frame);
+		}
+
+		if (member->id == member->conference->video_floor_holder) {
+			conference_video_check_recording(member->conference, NULL, frame);
+		}
+	} else if (member->id == member->conference->video_floor_holder) {
 		conference_video_write_frame(member->conference, member, frame);
 		conference_video_check_recording(member->conference, NULL, frame);
 	} else if (!conference_utils_test_flag(member->conference, CFLAG_VID_FLOOR_LOCK) && member->id == member->conference->last_video_floor_holder) {
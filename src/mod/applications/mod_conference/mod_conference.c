@@ -2491,6 +2491,8 @@ SWITCH_STANDARD_APP(conference_function)
 	if (conference->conference_video_mode == CONF_VIDEO_MODE_MUX) {
 		switch_queue_create(&member.video_queue, 200, member.pool);
 		switch_frame_buffer_create(&member.fb, 500);
+	} else if (conference->conference_video_mode == CONF_VIDEO_MODE_SFU) {
+		switch_frame_buffer_create(&member.fb, 500);
 	}
 
 	/* Add the caller to the conference */
@@ -2499,9 +2501,8 @@ SWITCH_STANDARD_APP(conference_function)
 		goto done;
 	}
 
-	if (conference->conference_video_mode == CONF_VIDEO_MODE_MUX) {
+	if (conference->conference_video_mode == CONF_VIDEO_MODE_MUX || conference->conference_video_mode == CONF_VIDEO_MODE_SFU) {
 		conference_video_launch_muxing_write_thread(&member);
-		conference_video_launch_layer_thread(&member);
 	}
 
 	msg.from = __FILE__;
@@ -2570,21 +2571,18 @@ SWITCH_STANDARD_APP(conference_function)
 		member.video_muxing_write_thread = NULL;
 	}
 
-	if (member.video_layer_thread) {
-		switch_status_t st = SWITCH_STATUS_SUCCESS;
+	/* Remove the caller from the conference */
+	conference_member_del(member.conference, &member);
+
+	/* give the session back its own video sequence numbering */
+	if (member.sfu.passthru) {
+		switch_rtp_t *rtp_session;
 
-		while(member.layer_thread_running) {
-			conference_video_wake_layer_thread(&member);
-			switch_yield(10000);
+		if ((rtp_session = switch_core_media_get_rtp_session(member.session, SWITCH_MEDIA_TYPE_VIDEO))) {
+			switch_rtp_clear_flag(rtp_session, SWITCH_RTP_FLAG_PASSTHRU);
 		}
-		
-		switch_thread_join(&st, member.video_layer_thread);
-		member.video_layer_thread = NULL;
 	}
 
-	/* Remove the caller from the conference */
-	conference_member_del(member.conference, &member);
-
 	/* Put the original codec back */
 	switch_core_session_set_read_codec(member.session, NULL);
 
@@ -2823,6 +2821,7 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 	conference_video_mode_t conference_video_mode = CONF_VIDEO_MODE_PASSTHROUGH;
 	int conference_video_quality = 1;
 	int auto_kps_debounce = 5000;
+	int video_compose_threads = -1;
 	float fps = 30.0f;
 	uint32_t max_members = 0;
 	uint32_t announce_count = 0;
@@ -2859,6 +2858,7 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 	int scale_h264_canvas_height = 0;
 	int scale_h264_canvas_fps_divisor = 0;
 	char *scale_h264_canvas_bandwidth = NULL;
+	char *video_encode_ladder = NULL;
 	char *video_codec_config_profile_name = NULL;
 	int tmp;
 	int heartbeat_period_sec = 0;
@@ -3191,6 +3191,14 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 				} else {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Video quality must be between 0 and 4\n");
 				}
+			} else if (!strcasecmp(var, "video-compose-threads") && !zstr(val)) {
+				int tmp = atoi(val);
+
+				if (tmp >= 0 && tmp <= MAX_COMPOSE_THREADS) {
+					video_compose_threads = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "video-compose-threads must be between 0 and %d\n", MAX_COMPOSE_THREADS);
+				}
 			} else if (!strcasecmp(var, "video-kps-debounce") && !zstr(val)) {
 				int tmp = atoi(val);
 
@@ -3207,8 +3215,10 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 					conference_video_mode = CONF_VIDEO_MODE_TRANSCODE;
 				} else if (!strcasecmp(val, "mux")) {
 					conference_video_mode = CONF_VIDEO_MODE_MUX;
+				} else if (!strcasecmp(val, "sfu")) {
+					conference_video_mode = CONF_VIDEO_MODE_SFU;
 				} else {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "video-mode invalid, valid settings are 'passthrough', 'transcode' and 'mux'\n");
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "video-mode invalid, valid settings are 'passthrough', 'transcode', 'mux' and 'sfu'\n");
 				}
 			} else if (!strcasecmp(var, "scale-h264-canvas-size") && !zstr(val)) {
 				char *p;
@@ -3232,6 +3242,8 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 				if (scale_h264_canvas_fps_divisor < 0) scale_h264_canvas_fps_divisor = 0;
 			} else if (!strcasecmp(var, "scale-h264-canvas-bandwidth") && !zstr(val)) {
 				scale_h264_canvas_bandwidth = val;
+			} else if (!strcasecmp(var, "video-encode-ladder") && !zstr(val)) {
+				video_encode_ladder = val;
 			} else if (!strcasecmp(var, "video-codec-config-profile-name") && !zstr(val)) {
 				video_codec_config_profile_name = val;
 			} else if (!strcasecmp(var, "heartbeat-period-sec") && !zstr(val)) {
@@ -3301,6 +3313,7 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 	conference->broadcast_chat_messages = broadcast_chat_messages;
 	conference->video_quality = conference_video_quality;
 	conference->auto_kps_debounce = auto_kps_debounce;
+	conference->video_compose_threads = video_compose_threads;
 	switch_event_create_plain(&conference->variables, SWITCH_EVENT_CHANNEL_DATA);
 	conference->conference_video_mode = conference_video_mode;
 	conference->video_codec_config_profile_name = switch_core_strdup(conference->pool, video_codec_config_profile_name);
@@ -3309,10 +3322,11 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 	conference->scale_h264_canvas_height = scale_h264_canvas_height;
 	conference->scale_h264_canvas_fps_divisor = scale_h264_canvas_fps_divisor;
 	conference->scale_h264_canvas_bandwidth = switch_core_strdup(conference->pool, scale_h264_canvas_bandwidth);
+	conference_video_parse_ladder(conference, video_encode_ladder);
 
 	if (!switch_core_has_video() && (conference->conference_video_mode == CONF_VIDEO_MODE_MUX || conference->conference_video_mode == CONF_VIDEO_MODE_TRANSCODE)) {
 		conference->conference_video_mode = CONF_VIDEO_MODE_PASSTHROUGH;
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "video-mode invalid, only valid setting is 'passthrough' due to no video capabilities\n");
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "video-mode invalid, only valid settings are 'passthrough' and 'sfu' due to no video capabilities\n");
 	}
 
 	if (conference->conference_video_mode == CONF_VIDEO_MODE_MUX) {
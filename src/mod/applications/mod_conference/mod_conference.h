@@ -106,6 +106,14 @@
 #define CONFFUNCAPISIZE (sizeof(conference_api_sub_commands)/sizeof(conference_api_sub_commands[0]))
 
 #define MAX_MUX_CODECS 50
+#define MAX_COMPOSE_THREADS 16
+#define MAX_LADDER_RUNGS 8
+/* least time between two keyframe requests the sfu sends one sender */
+#define SFU_KEY_REQ_MIN_FREQ 500000
+/* how long a receiver waits for a keyframe after switching sender before it forwards anyway */
+#define SFU_KEY_WAIT_MAX 2000000
+/* timestamp gap put between the last packet of the old sender and the first of the new one (1/30s at 90khz) */
+#define SFU_TS_GAP 3000
 
 #define ALC_HRTF_SOFT  0x1992
 
@@ -493,7 +501,6 @@ typedef struct mcu_layer_s {
 	switch_img_position_t logo_pos;
 	switch_img_fit_t logo_fit;
 	struct mcu_canvas_s *canvas;
-	int need_patch;
 	conference_member_t *member;
 	switch_frame_t bug_frame;
 	switch_frame_geometry_t last_geometry;
@@ -505,6 +512,12 @@ typedef struct mcu_layer_s {
 	switch_mutex_t *overlay_mutex;
 	switch_core_video_filter_t overlay_filters;
 	int manual_border;
+	/* bumped whenever cur_img gets a new picture, layer->img holds the scale of scaled_seq */
+	uint32_t cur_img_seq;
+	uint32_t scaled_seq;
+	/* bumped whenever logo_img is freed or replaced, a pointer compare can't tell a new logo at the old address */
+	uint32_t logo_seq;
+	uint32_t scaled_logo_seq;
 } mcu_layer_t;
 
 typedef struct video_layout_s {
@@ -527,14 +540,31 @@ typedef struct layout_group_s {
 	video_layout_node_t *layouts;
 } layout_group_t;
 
+/* one encode of the canvas, members are put on the rung their receive bandwidth allows */
+typedef struct video_rung_s {
+	uint32_t width;
+	uint32_t height;
+	int32_t kbps;
+} video_rung_t;
+
 typedef struct codec_set_s {
 	switch_codec_t codec;
 	switch_frame_t frame;
 	uint8_t *packet;
 	switch_image_t *scaled_img;
+	/* ladder rungs scale into fit_img and patch it into scaled_img at fit_x/fit_y, keeping the aspect ratio */
+	switch_image_t *fit_img;
+	int fit_x;
+	int fit_y;
 	uint8_t fps_divisor;
 	uint32_t frame_count;
 	char *video_codec_group;
+	int rung;
+	/* scale and encode time in usec, see vid-ladder */
+	switch_time_t encode_last;
+	switch_time_t encode_avg;
+	switch_time_t encode_max;
+	uint64_t encode_frames;
 } codec_set_t;
 
 
@@ -575,6 +605,21 @@ typedef struct mcu_canvas_s {
 	codec_set_t *write_codecs[MAX_MUX_CODECS];
 	int write_codecs_count;
 	switch_bool_t disable_auto_clear;
+	/* layers are scaled and patched by compose_threads workers, each on its own part of img */
+	switch_thread_t *compose_threads[MAX_COMPOSE_THREADS];
+	int compose_thread_count;
+	switch_queue_t *compose_queue;
+	switch_mutex_t *compose_mutex;
+	switch_thread_cond_t *compose_cond;
+	int compose_pending;
+	/* compose timing in usec, see vid-compose */
+	switch_time_t compose_last;
+	switch_time_t compose_avg;
+	switch_time_t compose_max;
+	uint64_t compose_frames;
+	uint64_t compose_layers;
+	switch_atomic_t compose_scales;
+	switch_atomic_t compose_cached;
 } mcu_canvas_t;
 
 /* Record Node */
@@ -591,9 +636,29 @@ typedef struct conference_record {
 typedef enum {
 	CONF_VIDEO_MODE_PASSTHROUGH,
 	CONF_VIDEO_MODE_TRANSCODE,
-	CONF_VIDEO_MODE_MUX
+	CONF_VIDEO_MODE_MUX,
+	CONF_VIDEO_MODE_SFU
 } conference_video_mode_t;
 
+/* what one receiver is being forwarded in sfu mode, the sender's packets are renumbered onto this stream */
+typedef struct conference_sfu_stream_s {
+	uint32_t src_id;
+	uint32_t ssrc;
+	uint16_t seq_offset;
+	uint16_t last_seq;
+	uint32_t ts_offset;
+	uint32_t last_ts;
+	int waiting_key;
+	switch_time_t wait_start;
+	uint64_t packets;
+	uint64_t bytes;
+	uint32_t switches;
+	/* SWITCH_RTP_FLAG_PASSTHRU was set on the receiver's video RTP session */
+	int passthru;
+	/* id of the sender last skipped because the receiver negotiated another codec, 0 when none */
+	uint32_t codec_mismatch;
+} conference_sfu_stream_t;
+
 /* Conference Object */
 typedef struct conference_obj {
 	char *name;
@@ -653,6 +718,12 @@ typedef struct conference_obj {
 	int members_seeing_video;
 	int members_with_avatar;
 	uint32_t auto_kps_debounce;
+	int video_compose_threads;
+	uint64_t sfu_packets;
+	uint64_t sfu_bytes;
+	uint64_t sfu_dropped;
+	uint32_t sfu_key_requests;
+	uint32_t sfu_switches;
 	switch_codec_settings_t video_codec_settings;
 	uint32_t canvas_width;
 	uint32_t canvas_height;
@@ -764,6 +835,8 @@ typedef struct conference_obj {
 	int scale_h264_canvas_height;
 	int scale_h264_canvas_fps_divisor;
 	char *scale_h264_canvas_bandwidth;
+	video_rung_t video_ladder[MAX_LADDER_RUNGS];
+	int video_ladder_count;
 	uint32_t moh_wait;
 	uint32_t floor_holder_score_iir;
 	char *default_layout_name;
@@ -858,11 +931,7 @@ struct conference_member {
 	switch_queue_t *dtmf_queue;
 	switch_queue_t *video_queue;
 	switch_thread_t *video_muxing_write_thread;
-	switch_thread_t *video_layer_thread;
-	int layer_thread_running;
 	switch_thread_t *input_thread;
-	switch_thread_cond_t *layer_cond;
-	switch_mutex_t *layer_cond_mutex;
 	cJSON *json;
 	cJSON *status_field;
 	uint8_t loop_loop;
@@ -874,6 +943,10 @@ struct conference_member {
 	int layer_timeout;
 	int video_codec_index;
 	int video_codec_id;
+	int video_rung;
+	uint32_t video_rung_bps;
+	switch_time_t video_rung_changed;
+	switch_time_t video_rung_checked;
 	char *video_banner_text;
 	switch_image_t *video_logo;
 	switch_img_position_t logo_pos;
@@ -892,6 +965,8 @@ struct conference_member {
 	int blanks;
 	int managed_kps;
 	int managed_kps_set;
+	conference_sfu_stream_t sfu;
+	switch_time_t sfu_key_req;
 	int blackouts;
 	int good_img;
 	int auto_avatar;
@@ -1077,11 +1152,15 @@ void conference_video_check_flush(conference_member_t *member, switch_bool_t for
 void conference_video_set_canvas_letterbox_bgcolor(mcu_canvas_t *canvas, char *color);
 void conference_video_set_canvas_bgcolor(mcu_canvas_t *canvas, char *color);
 void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg, switch_bool_t freeze);
+void conference_video_compose_status(mcu_canvas_t *canvas, switch_stream_handle_t *stream);
+void conference_video_ladder_status(mcu_canvas_t *canvas, switch_stream_handle_t *stream);
+void conference_video_sfu_status(conference_obj_t *conference, switch_stream_handle_t *stream);
 void conference_video_reset_layer(mcu_layer_t *layer);
 void conference_video_reset_layer_cam(mcu_layer_t *layer);
 void conference_video_clear_layer(mcu_layer_t *layer);
 void conference_video_reset_image(switch_image_t *img, switch_rgb_color_t *color);
 void conference_video_parse_layouts(conference_obj_t *conference, int WIDTH, int HEIGHT);
+void conference_video_parse_ladder(conference_obj_t *conference, const char *ladder);
 int conference_video_set_fps(conference_obj_t *conference, float fps);
 video_layout_t *conference_video_get_layout(conference_obj_t *conference, const char *video_layout_name, const char *video_layout_group);
 void conference_video_check_avatar(conference_member_t *member, switch_bool_t force);
@@ -1094,8 +1173,6 @@ switch_status_t conference_al_parse_position(al_handle_t *al, const char *data);
 switch_status_t conference_video_thread_callback(switch_core_session_t *session, switch_frame_t *frame, void *user_data);
 switch_status_t conference_text_thread_callback(switch_core_session_t *session, switch_frame_t *frame, void *user_data);
 void *SWITCH_THREAD_FUNC conference_video_muxing_write_thread_run(switch_thread_t *thread, void *obj);
-void conference_video_launch_layer_thread(conference_member_t *member);
-void conference_video_wake_layer_thread(conference_member_t *member);
 
 int conference_member_noise_gate_check(conference_member_t *member);
 void conference_member_check_channels(switch_frame_t *frame, conference_member_t *member, switch_bool_t in);
@@ -1247,6 +1324,9 @@ switch_status_t conference_api_sub_vid_mute_img(conference_member_t *member, swi
 switch_status_t conference_api_sub_vid_codec_group(conference_member_t *member, switch_stream_handle_t *stream, void *data);
 switch_status_t conference_api_sub_vid_logo_img(conference_member_t *member, switch_stream_handle_t *stream, void *data);
 switch_status_t conference_api_sub_vid_fps(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
+switch_status_t conference_api_sub_vid_compose(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
+switch_status_t conference_api_sub_vid_ladder(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
+switch_status_t conference_api_sub_vid_sfu(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
 switch_status_t conference_api_sub_vid_res(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
 switch_status_t conference_api_sub_canvas_fgimg(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
 switch_status_t conference_api_sub_canvas_bgimg(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
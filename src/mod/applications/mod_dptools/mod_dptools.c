@@ -6404,6 +6404,10 @@ SWITCH_STANDARD_APP(vad_test_function)
 		if (tmp > 0) switch_vad_set_param(vad, "voice_ms", tmp);
 	}
 
+	if ((var = switch_channel_get_variable(channel, "vad_gmm"))) {
+		switch_vad_set_param(vad, "gmm", atoi(var));
+	}
+
 	while (switch_channel_ready(channel)) {
 		switch_status_t status = switch_core_session_read_frame(session, &frame, SWITCH_IO_FLAG_NONE, 0);
 
@@ -37,30 +37,101 @@
 #include "esl.h"
 
 #define LIMIT_HASH_CLEANUP_INTERVAL 900
+#define LIMIT_HASH_SHARDS 64
+
+/* UDP sync between nodes, see limit_sync_thread() */
+#define LIMIT_SYNC_MAGIC 0x46534c48
+#define LIMIT_SYNC_VERSION 1
+#define LIMIT_SYNC_MTU 1400
+#define LIMIT_SYNC_MAX_KEY 1024
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown);
 SWITCH_MODULE_DEFINITION(mod_hash, mod_hash_load, mod_hash_shutdown, NULL);
 
+typedef struct {
+	uint32_t total_usage;	/* < Total */
+	uint32_t rate_usage;	/* < Current rate usage */
+	time_t last_check;		/* < Last rate check */
+	uint32_t interval;		/* < Interval used on last rate check */
+	switch_time_t last_update;	/* < Last updated timestamp (rate or total) */
+	switch_bool_t dirty;	/* < Queued for the next sync tick */
+} limit_hash_item_t;
+
+/* a key changed since the last sync tick, values are filled in when it is sent */
+typedef struct limit_sync_dirty_s {
+	char *key;
+	uint32_t total_usage;
+	uint32_t rate_usage;
+	uint32_t interval;
+	uint32_t last_check;
+	struct limit_sync_dirty_s *next;
+} limit_sync_dirty_t;
+
+/* the limit counters are split over shards so calls on different keys never share a lock */
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	limit_sync_dirty_t *dirty;
+} limit_hash_shard_t;
+
+typedef enum {
+	LIMIT_SYNC_DELTA = 1,	/* < Changed keys, broadcast every tick, empty ones are heartbeats */
+	LIMIT_SYNC_FULL,		/* < Part of a snapshot of all keys */
+	LIMIT_SYNC_FULL_END,	/* < Snapshot done, keys it did not mention are gone */
+	LIMIT_SYNC_RESYNC		/* < Please send me a snapshot */
+} limit_sync_type_t;
+
+typedef struct {
+	switch_memory_pool_t *pool;
+	char *node;
+	char *listen_ip;
+	switch_port_t listen_port;
+	int family;
+	switch_socket_t *sock;
+	switch_thread_t *thread;
+	int running;
+
+	uint32_t interval;		/* < ms between ticks */
+	uint32_t heartbeat;		/* < ms between packets when nothing changes */
+	uint32_t timeout;		/* < ms of silence before a peer is considered down */
+	uint32_t full_interval;	/* < s between unsolicited snapshots */
+	uint32_t tick_packets;	/* < datagrams per tick, the rest waits for the next one (whole shards at a time) */
+
+	uint64_t tick_start;	/* < packets_sent when the tick began */
+	int delta_shard;		/* < shard the next delta flush starts at */
+
+	/* snapshot in progress, sent a few shards per tick */
+	switch_bool_t full_active;
+	char full_to[256];		/* < peer it goes to, all of them when empty */
+	int full_shard;
+	uint32_t full_keys;
+
+	uint32_t boot;
+	uint32_t seq;
+	uint32_t gen;
+
+	uint64_t packets_sent;
+	uint64_t packets_received;
+	uint64_t keys_sent;
+	uint64_t keys_received;
+	uint64_t snapshots_sent;
+	uint64_t resyncs_sent;
+	uint64_t bad_packets;
+} limit_sync_t;
+
 /* CORE STUFF */
 static struct {
 	switch_memory_pool_t *pool;
-	switch_thread_rwlock_t *limit_hash_rwlock;
-	switch_hash_t *limit_hash;
+	limit_hash_shard_t limit_shards[LIMIT_HASH_SHARDS];
+	switch_mutex_t *pvt_mutex;
 	switch_thread_rwlock_t *db_hash_rwlock;
 	switch_hash_t *db_hash;
 	switch_thread_rwlock_t *remote_hash_rwlock;
 	switch_hash_t *remote_hash;
+	limit_sync_t *sync;
 } globals;
 
-typedef struct {
-	uint32_t total_usage;	/* < Total */
-	uint32_t rate_usage;	/* < Current rate usage */
-	time_t last_check;		/* < Last rate check */
-	uint32_t interval;		/* < Interval used on last rate check */
-	switch_time_t last_update;	/* < Last updated timestamp (rate or total) */
-} limit_hash_item_t;
-
 struct callback {
 	char *buf;
 	size_t len;
@@ -72,6 +143,7 @@ typedef struct callback callback_t;
 /* HASH STUFF */
 typedef struct {
 	switch_hash_t *hash;
+	switch_mutex_t *mutex;
 } limit_hash_private_t;
 
 typedef enum {
@@ -111,12 +183,70 @@ typedef struct {
 	switch_thread_t *thread;
 
 	limit_remote_state_t state;
+
+	/* sync peers push their usage over UDP instead of being polled, only the sync thread touches these */
+	switch_bool_t sync;
+	switch_sockaddr_t *sync_addr;
+	uint32_t sync_boot;
+	uint32_t sync_seq;
+	uint32_t sync_gen;
+	switch_time_t sync_mark;
+	switch_time_t sync_updates;
+	switch_time_t sync_last_rx;
+	switch_time_t sync_resync_sent;
+	switch_time_t sync_full_rx;
+	switch_bool_t sync_want_resync;
+	switch_bool_t sync_want_full;
+	uint32_t sync_full_keys;
+	uint32_t sync_gaps;
 } limit_remote_t;
 
 static limit_hash_item_t get_remote_usage(const char *key);
 void limit_remote_destroy(limit_remote_t **r);
 static void do_config(switch_bool_t reload);
 
+static inline limit_hash_shard_t *limit_shard(const char *key)
+{
+	switch_ssize_t klen = -1;
+
+	return &globals.limit_shards[switch_hashfunc_default(key, &klen) % LIMIT_HASH_SHARDS];
+}
+
+/* queue a changed key for the next sync tick, the shard must be locked */
+static void limit_sync_mark(limit_hash_shard_t *shard, const char *key, limit_hash_item_t *item)
+{
+	limit_sync_dirty_t *dirty;
+
+	if (!globals.sync || (item && item->dirty)) {
+		return;
+	}
+
+	switch_zmalloc(dirty, sizeof(*dirty));
+	dirty->key = strdup(key);
+	dirty->next = shard->dirty;
+	shard->dirty = dirty;
+
+	if (item) {
+		item->dirty = SWITCH_TRUE;
+	}
+}
+
+static limit_hash_private_t *limit_hash_private(switch_core_session_t *session)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	limit_hash_private_t *pvt;
+
+	switch_mutex_lock(globals.pvt_mutex);
+	if (!(pvt = switch_channel_get_private(channel, "limit_hash"))) {
+		pvt = (limit_hash_private_t *) switch_core_session_alloc(session, sizeof(limit_hash_private_t));
+		switch_mutex_init(&pvt->mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
+		switch_channel_set_private(channel, "limit_hash", pvt);
+	}
+	switch_mutex_unlock(globals.pvt_mutex);
+
+	return pvt;
+}
+
 
 /* \brief Enforces limit_hash restrictions
  * \param session current session
@@ -134,32 +264,33 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 	limit_hash_item_t *item = NULL;
 	time_t now = switch_epoch_time_now(NULL);
 	limit_hash_private_t *pvt = NULL;
+	limit_hash_shard_t *shard;
 	uint8_t increment = 1;
+	switch_bool_t changed = SWITCH_FALSE;
 	limit_hash_item_t remote_usage;
 
 	hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
+	shard = limit_shard(hashkey);
+	pvt = limit_hash_private(session);
+ 	remote_usage = get_remote_usage(hashkey);
 
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
+	switch_mutex_lock(shard->mutex);
 	/* Check if that realm+resource has ever been checked */
-	if (!(item = (limit_hash_item_t *) switch_core_hash_find(globals.limit_hash, hashkey))) {
+	if (!(item = (limit_hash_item_t *) switch_core_hash_find(shard->hash, hashkey))) {
 		/* No, create an empty structure and add it, then continue like as if it existed */
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Creating new limit structure: key: %s\n", hashkey);
-		item = (limit_hash_item_t *)switch_core_hash_insert_alloc(globals.limit_hash, hashkey, sizeof(limit_hash_item_t));
+		item = (limit_hash_item_t *)switch_core_hash_insert_alloc(shard->hash, hashkey, sizeof(limit_hash_item_t));
 	}
 
-	if (!(pvt = switch_channel_get_private(channel, "limit_hash"))) {
-		pvt = (limit_hash_private_t *) switch_core_session_alloc(session, sizeof(limit_hash_private_t));
-		memset(pvt, 0, sizeof(limit_hash_private_t));
-		switch_channel_set_private(channel, "limit_hash", pvt);
-	}
+	switch_mutex_lock(pvt->mutex);
 	if (!(pvt->hash)) {
 		switch_core_hash_init(&pvt->hash);
 	}
 	increment = !switch_core_hash_find(pvt->hash, hashkey);
- 	remote_usage = get_remote_usage(hashkey);
 
 	if (interval > 0) {
 		item->interval = interval;
+		changed = SWITCH_TRUE;
 		if (item->last_check <= (now - interval)) {
 			item->rate_usage = 1;
 			item->last_check = now;
@@ -184,6 +315,7 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 
 	if (increment) {
 		item->total_usage++;
+		changed = SWITCH_TRUE;
 
 		switch_core_hash_insert(pvt->hash, hashkey, item);
 
@@ -212,18 +344,24 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 	}
 
   end:
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
+	switch_mutex_unlock(pvt->mutex);
+	if (changed) {
+		limit_sync_mark(shard, hashkey, item);
+	}
+	switch_mutex_unlock(shard->mutex);
 	return status;
 }
 
 /* !\brief Determines whether a given entry is ready to be removed. */
 SWITCH_HASH_DELETE_FUNC(limit_hash_cleanup_delete_callback) {
 	limit_hash_item_t *item = (limit_hash_item_t *) val;
+	limit_hash_shard_t *shard = (limit_hash_shard_t *) pData;
 	time_t now = switch_epoch_time_now(NULL);
 
 	/* reset to 0 if window has passed so we can clean it up */
 	if (item->rate_usage > 0 && (item->last_check <= (now - item->interval))) {
 		item->rate_usage = 0;
+		limit_sync_mark(shard, (const char *) key, item);
 	}
 
 	if (item->total_usage == 0 && item->rate_usage == 0) {
@@ -252,15 +390,42 @@ SWITCH_HASH_DELETE_FUNC(limit_hash_remote_cleanup_callback)
 /* !\brief Periodically checks for unused limit entries and frees them */
 SWITCH_STANDARD_SCHED_FUNC(limit_hash_cleanup_callback)
 {
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
-	if (globals.limit_hash) {
-		switch_core_hash_delete_multi(globals.limit_hash, limit_hash_cleanup_delete_callback, NULL);
+	int i;
+
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[i];
+
+		switch_mutex_lock(shard->mutex);
+		if (shard->hash) {
+			switch_core_hash_delete_multi(shard->hash, limit_hash_cleanup_delete_callback, shard);
+		}
+		switch_mutex_unlock(shard->mutex);
 	}
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 
-	if (globals.limit_hash) {
-		task->runtime = switch_epoch_time_now(NULL) + LIMIT_HASH_CLEANUP_INTERVAL;
+	task->runtime = switch_epoch_time_now(NULL) + LIMIT_HASH_CLEANUP_INTERVAL;
+}
+
+/* drop one usage of hashkey, the item goes away with its last user */
+static void limit_hash_release_key(switch_core_session_t *session, const char *hashkey)
+{
+	limit_hash_shard_t *shard = limit_shard(hashkey);
+	limit_hash_item_t *item = NULL;
+
+	switch_mutex_lock(shard->mutex);
+	if ((item = (limit_hash_item_t *) switch_core_hash_find(shard->hash, hashkey))) {
+		if (item->total_usage) {
+			item->total_usage--;
+		}
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Usage for %s is now %d\n", hashkey, item->total_usage);
+
+		limit_sync_mark(shard, hashkey, item);
+		if (item->total_usage == 0 && item->rate_usage == 0) {
+			/* Noone is using this item anymore */
+			switch_core_hash_delete(shard->hash, hashkey);
+			free(item);
+		}
 	}
+	switch_mutex_unlock(shard->mutex);
 }
 
 /* !\brief Releases usage of a limit_hash-controlled resource  */
@@ -268,58 +433,48 @@ SWITCH_LIMIT_RELEASE(limit_release_hash)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	limit_hash_private_t *pvt = switch_channel_get_private(channel, "limit_hash");
-	limit_hash_item_t *item = NULL;
 
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
+	if (!pvt) {
+		return SWITCH_STATUS_SUCCESS;
+	}
 
-	if (!pvt || !pvt->hash) {
-		switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
+	switch_mutex_lock(pvt->mutex);
+	if (!pvt->hash) {
+		switch_mutex_unlock(pvt->mutex);
 		return SWITCH_STATUS_SUCCESS;
 	}
 
 	/* clear for uuid */
 	if (realm == NULL && resource == NULL) {
 		switch_hash_index_t *hi = NULL;
-		/* Loop through the channel's hashtable which contains mapping to all the limit_hash_item_t referenced by that channel */
-		while ((hi = switch_core_hash_first_iter(pvt->hash, hi))) {
+		switch_hash_t *hash = pvt->hash;
+
+		pvt->hash = NULL;
+		switch_mutex_unlock(pvt->mutex);
+
+		/* Loop through the channel's hashtable which contains all the keys referenced by that channel */
+		while ((hi = switch_core_hash_first_iter(hash, hi))) {
 			void *val = NULL;
 			const void *key;
 			switch_ssize_t keylen;
 
 			switch_core_hash_this(hi, &key, &keylen, &val);
-
-			item = (limit_hash_item_t *) val;
-			item->total_usage--;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Usage for %s is now %d\n", (const char *) key, item->total_usage);
-
-			if (item->total_usage == 0 && item->rate_usage == 0) {
-				/* Noone is using this item anymore */
-				switch_core_hash_delete(globals.limit_hash, (const char *) key);
-				free(item);
-			}
-
-			switch_core_hash_delete(pvt->hash, (const char *) key);
+			limit_hash_release_key(session, (const char *) key);
+			switch_core_hash_delete(hash, (const char *) key);
 		}
-		switch_core_hash_destroy(&pvt->hash);
+		switch_core_hash_destroy(&hash);
 	} else {
 		char *hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
 
-		if ((item = (limit_hash_item_t *) switch_core_hash_find(pvt->hash, hashkey))) {
-			item->total_usage--;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Usage for %s is now %d\n", (const char *) hashkey, item->total_usage);
-
+		if (switch_core_hash_find(pvt->hash, hashkey)) {
 			switch_core_hash_delete(pvt->hash, hashkey);
-
-			if (item->total_usage == 0 && item->rate_usage == 0) {
-				/* Noone is using this item anymore */
-				switch_core_hash_delete(globals.limit_hash, (const char *) hashkey);
-				free(item);
-			}
+			switch_mutex_unlock(pvt->mutex);
+			limit_hash_release_key(session, hashkey);
+		} else {
+			switch_mutex_unlock(pvt->mutex);
 		}
 	}
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
-
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -327,24 +482,25 @@ SWITCH_LIMIT_USAGE(limit_usage_hash)
 {
 	char *hash_key = NULL;
 	limit_hash_item_t *item = NULL;
+	limit_hash_shard_t *shard;
 	int count = 0;
 	limit_hash_item_t remote_usage;
 
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
-
 	hash_key = switch_mprintf("%s_%s", realm, resource);
 	remote_usage = get_remote_usage(hash_key);
 
 	count = remote_usage.total_usage;
 	*rcount = remote_usage.rate_usage;
 
-	if ((item = switch_core_hash_find(globals.limit_hash, hash_key))) {
+	shard = limit_shard(hash_key);
+	switch_mutex_lock(shard->mutex);
+	if ((item = switch_core_hash_find(shard->hash, hash_key))) {
 		count += item->total_usage;
 		*rcount += item->rate_usage;
 	}
+	switch_mutex_unlock(shard->mutex);
 
  	switch_safe_free(hash_key);
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 
 	return count;
 }
@@ -358,39 +514,37 @@ SWITCH_LIMIT_INTERVAL_RESET(limit_interval_reset_hash)
 {
 	char *hash_key = NULL;
 	limit_hash_item_t *item = NULL;
-
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
+	limit_hash_shard_t *shard;
 
 	hash_key = switch_mprintf("%s_%s", realm, resource);
-	if ((item = switch_core_hash_find(globals.limit_hash, hash_key))) {
+	shard = limit_shard(hash_key);
+
+	switch_mutex_lock(shard->mutex);
+	if ((item = switch_core_hash_find(shard->hash, hash_key))) {
 		item->rate_usage = 0;
 		item->last_check = switch_epoch_time_now(NULL);
+		limit_sync_mark(shard, hash_key, item);
 	}
+	switch_mutex_unlock(shard->mutex);
 
  	switch_safe_free(hash_key);
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_LIMIT_STATUS(limit_status_hash)
 {
-	/*
 	switch_hash_index_t *hi = NULL;
-	int count = 0;
-	char *ret = NULL;
-
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
+	int i, count = 0;
 
-	for (hi = switch_core_hash_first(globals.limit_hash); hi; switch_core_hash_next(hi)) {
-		count++;
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		switch_mutex_lock(globals.limit_shards[i].mutex);
+		for (hi = switch_core_hash_first(globals.limit_shards[i].hash); hi; hi = switch_core_hash_next(&hi)) {
+			count++;
+		}
+		switch_mutex_unlock(globals.limit_shards[i].mutex);
 	}
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
-
-	ret = switch_mprintf("There are %d elements being tracked.", count);
-	return ret;
-	*/
-	return strdup("-ERR not supported yet (locking problems).");
+	return switch_mprintf("There are %d elements being tracked.", count);
 }
 
 /* APP/API STUFF */
@@ -602,19 +756,23 @@ SWITCH_STANDARD_API(hash_dump_function)
 	}
 
 	if (mode & 1) {
-		switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
-		for (hi = switch_core_hash_first(globals.limit_hash); hi; hi = switch_core_hash_next(&hi)) {
-			void *val = NULL;
-			const void *key;
-			switch_ssize_t keylen;
-			limit_hash_item_t *item;
-			switch_core_hash_this(hi, &key, &keylen, &val);
+		int i;
 
-			item = (limit_hash_item_t *)val;
+		for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+			switch_mutex_lock(globals.limit_shards[i].mutex);
+			for (hi = switch_core_hash_first(globals.limit_shards[i].hash); hi; hi = switch_core_hash_next(&hi)) {
+				void *val = NULL;
+				const void *key;
+				switch_ssize_t keylen;
+				limit_hash_item_t *item;
+				switch_core_hash_this(hi, &key, &keylen, &val);
+
+				item = (limit_hash_item_t *)val;
 
-			stream->write_function(stream, "L/%s/%d/%d/%d/%d\n", key, item->total_usage, item->rate_usage, item->interval, item->last_check);
+				stream->write_function(stream, "L/%s/%d/%d/%d/%d\n", key, item->total_usage, item->rate_usage, item->interval, item->last_check);
+			}
+			switch_mutex_unlock(globals.limit_shards[i].mutex);
 		}
-		switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 	}
 
 	if (mode & 2) {
@@ -642,7 +800,9 @@ SWITCH_STANDARD_API(hash_dump_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-#define HASH_REMOTE_SYNTAX "list|kill [name]|rescan"
+#define HASH_REMOTE_SYNTAX "list|kill [name]|rescan|sync"
+static void limit_sync_status(switch_stream_handle_t *stream);
+
 SWITCH_STANDARD_API(hash_remote_function)
 {
 	//int argc;
@@ -670,7 +830,7 @@ SWITCH_STANDARD_API(hash_remote_function)
 			switch_core_hash_this(hi, &key, &keylen, &val);
 
 			item = (limit_remote_t *)val;
-			stream->write_function(stream, "%s\t\t\t%s\n", item->name, state_str(item->state));
+			stream->write_function(stream, "%s\t\t\t%s%s\n", item->name, state_str(item->state), item->sync ? " (sync)" : "");
 		}
 		switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
 		stream->write_function(stream, "+OK\n");
@@ -682,17 +842,16 @@ SWITCH_STANDARD_API(hash_remote_function)
 			stream->write_function(stream, "-ERR Usage: "HASH_REMOTE_SYNTAX"\n");
 			goto done;
 		}
-		switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
-		remote = switch_core_hash_find(globals.remote_hash, name);
+
+		/* unlink it first, nobody can reach it once the write lock is released */
+		switch_thread_rwlock_wrlock(globals.remote_hash_rwlock);
+		if ((remote = switch_core_hash_find(globals.remote_hash, name))) {
+			switch_core_hash_delete(globals.remote_hash, name);
+		}
 		switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
 
 		if (remote) {
 			limit_remote_destroy(&remote);
-
-			switch_thread_rwlock_wrlock(globals.remote_hash_rwlock);
-			switch_core_hash_delete(globals.remote_hash, name);
-			switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
-
 			stream->write_function(stream, "+OK\n");
 		} else {
 			stream->write_function(stream, "-ERR No such remote instance %s\n", name);
@@ -700,6 +859,8 @@ SWITCH_STANDARD_API(hash_remote_function)
 	} else if (argv[0] && !strcmp(argv[0], "rescan")) {
 		do_config(SWITCH_TRUE);
 		stream->write_function(stream, "+OK\n");
+	} else if (argv[0] && !strcmp(argv[0], "sync")) {
+		limit_sync_status(stream);
 	} else {
 		stream->write_function(stream, "-ERR Usage: "HASH_REMOTE_SYNTAX"\n");
 
@@ -741,7 +902,7 @@ limit_remote_t *limit_remote_create(const char *name, const char *host, uint16_t
 	switch_thread_rwlock_create(&r->rwlock, pool);
 	switch_core_hash_init(&r->index);
 
-	switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+	switch_thread_rwlock_wrlock(globals.remote_hash_rwlock);
 	switch_core_hash_insert(globals.remote_hash, name, r);
 	switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
 
@@ -890,6 +1051,877 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 	return NULL;
 }
 
+/* SYNC STUFF
+ *
+ * Every node broadcasts the limit keys that changed since the previous tick to its peers:
+ *
+ *   header:  magic u32, version u8, type u8, node length u8, node, boot u32, seq u32, gen u32, count u16
+ *   entries: key length u16, key, total u32, rate u32, interval u32, last check u32
+ *
+ * All values are absolute so applying a packet twice is harmless, a zero usage removes the key.
+ * Each delta with entries takes the next seq, heartbeats repeat the current one so a receiver
+ * notices lost deltas and asks for a snapshot (RESYNC). A snapshot is a run of FULL packets
+ * sharing a gen followed by FULL_END, which carries the number of keys sent; keys the snapshot
+ * did not mention are dropped once all of them arrived. A new boot value means the peer restarted.
+ */
+
+#define LIMIT_SYNC_HEADER_LEN(_node_len) ((switch_size_t)(21 + (_node_len)))
+#define LIMIT_SYNC_ENTRY_LEN(_key_len) ((switch_size_t)(18 + (_key_len)))
+#define LIMIT_SYNC_RESYNC_MS 500
+
+typedef struct {
+	limit_sync_t *sync;
+	limit_remote_t *to;
+	limit_sync_type_t type;
+	uint8_t data[LIMIT_SYNC_MTU];
+	switch_size_t len;
+	uint16_t count;
+	uint32_t keys;
+} limit_sync_packet_t;
+
+typedef struct {
+	const uint8_t *data;
+	switch_size_t len;
+	switch_size_t pos;
+} limit_sync_reader_t;
+
+static void limit_sync_put8(limit_sync_packet_t *pkt, uint8_t v)
+{
+	pkt->data[pkt->len++] = v;
+}
+
+static void limit_sync_put16(limit_sync_packet_t *pkt, uint16_t v)
+{
+	pkt->data[pkt->len++] = (uint8_t)(v >> 8);
+	pkt->data[pkt->len++] = (uint8_t)v;
+}
+
+static void limit_sync_put32(limit_sync_packet_t *pkt, uint32_t v)
+{
+	pkt->data[pkt->len++] = (uint8_t)(v >> 24);
+	pkt->data[pkt->len++] = (uint8_t)(v >> 16);
+	pkt->data[pkt->len++] = (uint8_t)(v >> 8);
+	pkt->data[pkt->len++] = (uint8_t)v;
+}
+
+static void limit_sync_set32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static switch_bool_t limit_sync_get16(limit_sync_reader_t *r, uint16_t *v)
+{
+	if (r->pos + 2 > r->len) {
+		return SWITCH_FALSE;
+	}
+	*v = (uint16_t)((r->data[r->pos] << 8) | r->data[r->pos + 1]);
+	r->pos += 2;
+	return SWITCH_TRUE;
+}
+
+static switch_bool_t limit_sync_get32(limit_sync_reader_t *r, uint32_t *v)
+{
+	if (r->pos + 4 > r->len) {
+		return SWITCH_FALSE;
+	}
+	*v = ((uint32_t)r->data[r->pos] << 24) | ((uint32_t)r->data[r->pos + 1] << 16) | ((uint32_t)r->data[r->pos + 2] << 8) | r->data[r->pos + 3];
+	r->pos += 4;
+	return SWITCH_TRUE;
+}
+
+static void limit_sync_packet_init(limit_sync_packet_t *pkt, limit_sync_t *sync, limit_sync_type_t type, limit_remote_t *to)
+{
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->sync = sync;
+	pkt->type = type;
+	pkt->to = to;
+}
+
+static void limit_sync_packet_begin(limit_sync_packet_t *pkt)
+{
+	limit_sync_t *sync = pkt->sync;
+	uint8_t node_len = (uint8_t)strlen(sync->node);
+
+	pkt->len = 0;
+	pkt->count = 0;
+	limit_sync_put32(pkt, LIMIT_SYNC_MAGIC);
+	limit_sync_put8(pkt, LIMIT_SYNC_VERSION);
+	limit_sync_put8(pkt, (uint8_t)pkt->type);
+	limit_sync_put8(pkt, node_len);
+	memcpy(pkt->data + pkt->len, sync->node, node_len);
+	pkt->len += node_len;
+	limit_sync_put32(pkt, sync->boot);
+	limit_sync_put32(pkt, 0);	/* seq, set when sent */
+	limit_sync_put32(pkt, sync->gen);
+	limit_sync_put16(pkt, 0);	/* count, set when sent */
+}
+
+static void limit_sync_sendto(limit_sync_t *sync, limit_remote_t *remote, limit_sync_packet_t *pkt)
+{
+	switch_size_t len = pkt->len;
+
+	if (switch_socket_sendto(sync->sock, remote->sync_addr, 0, (const char *) pkt->data, &len) == SWITCH_STATUS_SUCCESS) {
+		sync->packets_sent++;
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Error sending limit sync packet to %s\n", remote->name);
+	}
+}
+
+/* patch seq and count into the header and send the packet to its peer, or to all of them */
+static void limit_sync_packet_send(limit_sync_packet_t *pkt)
+{
+	limit_sync_t *sync = pkt->sync;
+	uint8_t *p;
+	uint32_t seq;
+
+	if (!pkt->len) {
+		limit_sync_packet_begin(pkt);
+	}
+
+	if (pkt->type == LIMIT_SYNC_DELTA && pkt->count) {
+		seq = ++sync->seq;
+	} else {
+		seq = sync->seq;
+	}
+
+	p = pkt->data + LIMIT_SYNC_HEADER_LEN(pkt->data[6]) - 10;
+	limit_sync_set32(p, seq);
+	p[8] = (uint8_t)(pkt->count >> 8);
+	p[9] = (uint8_t)pkt->count;
+
+	if (pkt->to) {
+		limit_sync_sendto(sync, pkt->to, pkt);
+	} else {
+		switch_hash_index_t *hi;
+
+		switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+		for (hi = switch_core_hash_first(globals.remote_hash); hi; hi = switch_core_hash_next(&hi)) {
+			void *val;
+			const void *key;
+			switch_ssize_t keylen;
+			limit_remote_t *remote;
+			switch_core_hash_this(hi, &key, &keylen, &val);
+
+			remote = (limit_remote_t *)val;
+			if (remote->sync) {
+				limit_sync_sendto(sync, remote, pkt);
+			}
+		}
+		switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
+	}
+
+	sync->keys_sent += pkt->count;
+	pkt->len = 0;
+	pkt->count = 0;
+}
+
+static void limit_sync_packet_add(limit_sync_packet_t *pkt, const char *key, uint32_t total_usage, uint32_t rate_usage, uint32_t interval, uint32_t last_check)
+{
+	switch_size_t key_len = strlen(key);
+
+	if (key_len > LIMIT_SYNC_MAX_KEY) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Limit key too long to sync: %.64s...\n", key);
+		return;
+	}
+
+	if (pkt->len && pkt->len + LIMIT_SYNC_ENTRY_LEN(key_len) > LIMIT_SYNC_MTU) {
+		limit_sync_packet_send(pkt);
+	}
+
+	if (!pkt->len) {
+		limit_sync_packet_begin(pkt);
+	}
+
+	limit_sync_put16(pkt, (uint16_t)key_len);
+	memcpy(pkt->data + pkt->len, key, key_len);
+	pkt->len += key_len;
+	limit_sync_put32(pkt, total_usage);
+	limit_sync_put32(pkt, rate_usage);
+	limit_sync_put32(pkt, interval);
+	limit_sync_put32(pkt, last_check);
+	pkt->count++;
+	pkt->keys++;
+}
+
+/* has this tick used up its datagrams */
+static switch_bool_t limit_sync_tick_full(limit_sync_t *sync)
+{
+	return sync->packets_sent - sync->tick_start >= sync->tick_packets ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/*
+ * send the keys that changed since the last tick, or a heartbeat when it is time for one.
+ * Once the tick is out of datagrams the other shards keep their keys for the next tick.
+ */
+static switch_bool_t limit_sync_flush(limit_sync_t *sync, switch_bool_t heartbeat)
+{
+	limit_sync_packet_t pkt;
+	int n;
+
+	limit_sync_packet_init(&pkt, sync, LIMIT_SYNC_DELTA, NULL);
+
+	for (n = 0; n < LIMIT_HASH_SHARDS; n++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[sync->delta_shard];
+		limit_sync_dirty_t *dirty, *next;
+
+		if (!shard->dirty) {
+			sync->delta_shard = (sync->delta_shard + 1) % LIMIT_HASH_SHARDS;
+			continue;
+		}
+
+		if (n && limit_sync_tick_full(sync)) {
+			break;
+		}
+		sync->delta_shard = (sync->delta_shard + 1) % LIMIT_HASH_SHARDS;
+
+		switch_mutex_lock(shard->mutex);
+		dirty = shard->dirty;
+		shard->dirty = NULL;
+		for (next = dirty; next; next = next->next) {
+			limit_hash_item_t *item;
+
+			if ((item = switch_core_hash_find(shard->hash, next->key))) {
+				next->total_usage = item->total_usage;
+				next->rate_usage = item->rate_usage;
+				next->interval = item->interval;
+				next->last_check = (uint32_t)item->last_check;
+				item->dirty = SWITCH_FALSE;
+			}
+		}
+		switch_mutex_unlock(shard->mutex);
+
+		while (dirty) {
+			next = dirty->next;
+			limit_sync_packet_add(&pkt, dirty->key, dirty->total_usage, dirty->rate_usage, dirty->interval, dirty->last_check);
+			free(dirty->key);
+			free(dirty);
+			dirty = next;
+		}
+	}
+
+	if (pkt.count || heartbeat) {
+		limit_sync_packet_send(&pkt);
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* start sending every key in use to one peer, or to all of them; limit_sync_snapshot_step() does the sending */
+static void limit_sync_snapshot(limit_sync_t *sync, limit_remote_t *to)
+{
+	sync->gen++;
+	sync->full_active = SWITCH_TRUE;
+	sync->full_shard = 0;
+	sync->full_keys = 0;
+	switch_set_string(sync->full_to, to ? to->name : "");
+}
+
+/*
+ * send the next shards of the snapshot in progress with what is left of the tick, at least one.
+ * A shard is read and sent in the same tick, so later deltas always carry newer values than it.
+ * The remote hash must be read locked.
+ */
+static void limit_sync_snapshot_step(limit_sync_t *sync)
+{
+	limit_sync_packet_t pkt;
+	limit_remote_t *to = NULL;
+	int n = 0;
+
+	if (!sync->full_active) {
+		return;
+	}
+
+	if (!zstr(sync->full_to) && !(to = switch_core_hash_find(globals.remote_hash, sync->full_to))) {
+		/* the peer is gone */
+		sync->full_active = SWITCH_FALSE;
+		return;
+	}
+
+	limit_sync_packet_init(&pkt, sync, LIMIT_SYNC_FULL, to);
+
+	while (sync->full_shard < LIMIT_HASH_SHARDS && (!n++ || !limit_sync_tick_full(sync))) {
+		limit_hash_shard_t *shard = &globals.limit_shards[sync->full_shard++];
+		switch_hash_index_t *hi;
+
+		switch_mutex_lock(shard->mutex);
+		for (hi = switch_core_hash_first(shard->hash); hi; hi = switch_core_hash_next(&hi)) {
+			void *val;
+			const void *key;
+			switch_ssize_t keylen;
+			limit_hash_item_t *item;
+			switch_core_hash_this(hi, &key, &keylen, &val);
+
+			item = (limit_hash_item_t *)val;
+			if (item->total_usage || item->rate_usage) {
+				limit_sync_packet_add(&pkt, (const char *)key, item->total_usage, item->rate_usage, item->interval, (uint32_t)item->last_check);
+			}
+		}
+		switch_mutex_unlock(shard->mutex);
+	}
+
+	if (pkt.count) {
+		limit_sync_packet_send(&pkt);
+	}
+
+	sync->full_keys += pkt.keys;
+
+	if (sync->full_shard < LIMIT_HASH_SHARDS) {
+		return;
+	}
+
+	pkt.type = LIMIT_SYNC_FULL_END;
+	limit_sync_packet_begin(&pkt);
+	limit_sync_put32(&pkt, sync->full_keys);
+	limit_sync_packet_send(&pkt);
+
+	sync->full_active = SWITCH_FALSE;
+	sync->snapshots_sent++;
+}
+
+static void limit_sync_request(limit_sync_t *sync, limit_remote_t *remote)
+{
+	limit_sync_packet_t pkt;
+
+	limit_sync_packet_init(&pkt, sync, LIMIT_SYNC_RESYNC, remote);
+	limit_sync_packet_send(&pkt);
+
+	remote->sync_resync_sent = switch_micro_time_now();
+	sync->resyncs_sent++;
+}
+
+SWITCH_HASH_DELETE_FUNC(limit_sync_stale_callback)
+{
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+	switch_time_t mark = *(switch_time_t *)pData;
+
+	return item->last_update < mark ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/* forget whatever we knew about a peer, the remote's write lock must be held */
+static void limit_sync_peer_reset(limit_remote_t *remote, uint32_t boot)
+{
+	switch_core_hash_delete_multi(remote->index, limit_hash_remote_cleanup_callback, NULL);
+	remote->sync_boot = boot;
+	remote->sync_seq = 0;
+	remote->sync_gen = 0;
+	remote->sync_mark = 0;
+	remote->sync_full_keys = 0;
+	remote->sync_want_resync = SWITCH_TRUE;
+}
+
+static switch_bool_t limit_sync_apply(limit_sync_t *sync, limit_remote_t *remote, limit_sync_reader_t *r, uint16_t count, switch_bool_t full)
+{
+	char key[LIMIT_SYNC_MAX_KEY + 1];
+	uint16_t i;
+
+	for (i = 0; i < count; i++) {
+		uint16_t key_len;
+		uint32_t total_usage, rate_usage, interval, last_check;
+		limit_hash_item_t *item;
+
+		if (!limit_sync_get16(r, &key_len) || key_len > LIMIT_SYNC_MAX_KEY || r->pos + key_len > r->len) {
+			return SWITCH_FALSE;
+		}
+		memcpy(key, r->data + r->pos, key_len);
+		key[key_len] = '\0';
+		r->pos += key_len;
+
+		if (!limit_sync_get32(r, &total_usage) || !limit_sync_get32(r, &rate_usage) ||
+			!limit_sync_get32(r, &interval) || !limit_sync_get32(r, &last_check)) {
+			return SWITCH_FALSE;
+		}
+
+		sync->keys_received++;
+
+		if (full) {
+			remote->sync_full_keys++;
+		}
+
+		if (!total_usage && !rate_usage) {
+			switch_core_hash_delete(remote->index, key);
+			continue;
+		}
+
+		if (!(item = switch_core_hash_find(remote->index, key))) {
+			switch_zmalloc(item, sizeof(*item));
+			switch_core_hash_insert_auto_free(remote->index, key, item);
+		}
+		item->total_usage = total_usage;
+		item->rate_usage = rate_usage;
+		item->interval = interval;
+		item->last_check = (time_t)last_check;
+		item->last_update = ++remote->sync_updates;
+	}
+
+	return SWITCH_TRUE;
+}
+
+static void limit_sync_receive(limit_sync_t *sync, switch_sockaddr_t *from, const uint8_t *data, switch_size_t len)
+{
+	limit_sync_reader_t r = { data, len, 0 };
+	char node[256];
+	uint32_t magic, boot, seq, gen;
+	uint16_t count;
+	uint8_t type, node_len;
+	limit_remote_t *remote;
+
+	if (len < LIMIT_SYNC_HEADER_LEN(0) || !limit_sync_get32(&r, &magic) || magic != LIMIT_SYNC_MAGIC || data[4] != LIMIT_SYNC_VERSION) {
+		sync->bad_packets++;
+		return;
+	}
+
+	type = data[5];
+	node_len = data[6];
+	r.pos = 7;
+
+	if (len < LIMIT_SYNC_HEADER_LEN(node_len)) {
+		sync->bad_packets++;
+		return;
+	}
+
+	memcpy(node, data + r.pos, node_len);
+	node[node_len] = '\0';
+	r.pos += node_len;
+	limit_sync_get32(&r, &boot);
+	limit_sync_get32(&r, &seq);
+	limit_sync_get32(&r, &gen);
+	limit_sync_get16(&r, &count);
+
+	if (!strcmp(node, sync->node)) {
+		return;
+	}
+
+	sync->packets_received++;
+
+	switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+
+	if (!(remote = switch_core_hash_find(globals.remote_hash, node)) || !remote->sync || !switch_cmp_addr(from, remote->sync_addr, SWITCH_FALSE)) {
+		char ipbuf[48];
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Ignoring limit sync packet from unknown peer %s (%s:%d)\n",
+						  node, switch_get_addr(ipbuf, sizeof(ipbuf), from), switch_sockaddr_get_port(from));
+		sync->bad_packets++;
+		goto end;
+	}
+
+	remote->sync_last_rx = switch_micro_time_now();
+
+	switch_thread_rwlock_wrlock(remote->rwlock);
+
+	if (remote->sync_boot != boot) {
+		if (remote->sync_boot) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Limit sync peer %s restarted\n", remote->name);
+		}
+		limit_sync_peer_reset(remote, boot);
+	}
+
+	if (remote->state != REMOTE_UP) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Limit sync peer %s is up\n", remote->name);
+		remote->state = REMOTE_UP;
+	}
+
+	switch (type) {
+	case LIMIT_SYNC_DELTA:
+		if (!count) {
+			/* heartbeat, a newer seq means we lost a delta */
+			if ((int32_t)(seq - remote->sync_seq) > 0 && !remote->sync_want_resync) {
+				remote->sync_gaps++;
+				remote->sync_want_resync = SWITCH_TRUE;
+			}
+			break;
+		}
+
+		if (remote->sync_seq && (int32_t)(seq - remote->sync_seq) <= 0) {
+			break;
+		}
+
+		if (seq != remote->sync_seq + 1 && !remote->sync_want_resync) {
+			remote->sync_gaps++;
+			remote->sync_want_resync = SWITCH_TRUE;
+		}
+
+		remote->sync_seq = seq;
+
+		if (!limit_sync_apply(sync, remote, &r, count, SWITCH_FALSE)) {
+			sync->bad_packets++;
+		}
+		break;
+	case LIMIT_SYNC_FULL:
+		remote->sync_full_rx = remote->sync_last_rx;
+		if (gen != remote->sync_gen || !remote->sync_mark) {
+			remote->sync_gen = gen;
+			remote->sync_mark = remote->sync_updates + 1;
+			remote->sync_full_keys = 0;
+		}
+
+		if (!limit_sync_apply(sync, remote, &r, count, SWITCH_TRUE)) {
+			sync->bad_packets++;
+		}
+		break;
+	case LIMIT_SYNC_FULL_END:
+		{
+			uint32_t keys = 0;
+
+			if (!limit_sync_get32(&r, &keys)) {
+				sync->bad_packets++;
+				break;
+			}
+
+			if (keys && (gen != remote->sync_gen || remote->sync_full_keys != keys)) {
+				/* lost part of the snapshot, ask again */
+				remote->sync_want_resync = SWITCH_TRUE;
+			} else {
+				switch_time_t mark = keys ? remote->sync_mark : remote->sync_updates + 1;
+
+				switch_core_hash_delete_multi(remote->index, limit_sync_stale_callback, &mark);
+				if (!remote->sync_seq || (int32_t)(seq - remote->sync_seq) > 0) {
+					remote->sync_seq = seq;
+				}
+				remote->sync_want_resync = SWITCH_FALSE;
+			}
+
+			remote->sync_mark = 0;
+			remote->sync_full_keys = 0;
+		}
+		break;
+	case LIMIT_SYNC_RESYNC:
+		remote->sync_want_full = SWITCH_TRUE;
+		break;
+	default:
+		sync->bad_packets++;
+		break;
+	}
+
+	switch_thread_rwlock_unlock(remote->rwlock);
+
+end:
+	switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
+}
+
+/* time out silent peers, ask for the snapshots we miss and serve the ones asked of us, one at a time */
+static void limit_sync_peers(limit_sync_t *sync, switch_time_t now)
+{
+	switch_hash_index_t *hi;
+
+	switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+	for (hi = switch_core_hash_first(globals.remote_hash); hi; hi = switch_core_hash_next(&hi)) {
+		void *val;
+		const void *key;
+		switch_ssize_t keylen;
+		limit_remote_t *remote;
+		switch_core_hash_this(hi, &key, &keylen, &val);
+
+		remote = (limit_remote_t *)val;
+		if (!remote->sync) {
+			continue;
+		}
+
+		if (remote->state == REMOTE_UP && now - remote->sync_last_rx > (switch_time_t)sync->timeout * 1000) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Limit sync peer %s timed out\n", remote->name);
+			switch_thread_rwlock_wrlock(remote->rwlock);
+			remote->state = REMOTE_DOWN;
+			limit_sync_peer_reset(remote, 0);
+			switch_thread_rwlock_unlock(remote->rwlock);
+			continue;
+		}
+
+		/* a paced snapshot takes a while, don't ask again while it is still coming in */
+		if (remote->state == REMOTE_UP && remote->sync_want_resync && now - remote->sync_resync_sent >= LIMIT_SYNC_RESYNC_MS * 1000 &&
+			now - remote->sync_full_rx >= LIMIT_SYNC_RESYNC_MS * 1000) {
+			limit_sync_request(sync, remote);
+		}
+
+		if (remote->sync_want_full && !sync->full_active) {
+			remote->sync_want_full = SWITCH_FALSE;
+			limit_sync_snapshot(sync, remote);
+		}
+	}
+
+	limit_sync_snapshot_step(sync);
+	switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
+}
+
+static void *SWITCH_THREAD_FUNC limit_sync_thread(switch_thread_t *thread, void *obj)
+{
+	limit_sync_t *sync = (limit_sync_t *) obj;
+	switch_sockaddr_t *from = NULL;
+	char buf[LIMIT_SYNC_MTU + 1];
+	switch_time_t next_tick = 0, last_sent = 0, last_full = switch_micro_time_now();
+
+	switch_sockaddr_create(&from, sync->pool);
+	switch_socket_timeout_set(sync->sock, (switch_interval_time_t)sync->interval * 1000);
+
+	while (sync->running) {
+		switch_size_t len = sizeof(buf);
+		switch_time_t now;
+
+		if (switch_socket_recvfrom(from, sync->sock, 0, buf, &len) == SWITCH_STATUS_SUCCESS && len > 0) {
+			limit_sync_receive(sync, from, (const uint8_t *) buf, len);
+		}
+
+		if ((now = switch_micro_time_now()) < next_tick) {
+			continue;
+		}
+		next_tick = now + (switch_time_t)sync->interval * 1000;
+		sync->tick_start = sync->packets_sent;
+
+		if (limit_sync_flush(sync, now - last_sent >= (switch_time_t)sync->heartbeat * 1000)) {
+			last_sent = now;
+		}
+
+		if (sync->full_interval && !sync->full_active && now - last_full >= (switch_time_t)sync->full_interval * 1000000) {
+			limit_sync_snapshot(sync, NULL);
+			last_full = now;
+		}
+
+		limit_sync_peers(sync, now);
+	}
+
+	return NULL;
+}
+
+static switch_status_t limit_sync_start(limit_sync_t *sync)
+{
+	switch_sockaddr_t *sa = NULL;
+	switch_threadattr_t *thd_attr = NULL;
+
+	if (switch_sockaddr_info_get(&sa, sync->listen_ip, SWITCH_UNSPEC, sync->listen_port, 0, sync->pool) != SWITCH_STATUS_SUCCESS || !sa) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot resolve limit sync address %s\n", sync->listen_ip);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	sync->family = switch_sockaddr_get_family(sa);
+
+	if (switch_socket_create(&sync->sock, sync->family, SOCK_DGRAM, 0, sync->pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create limit sync socket\n");
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_socket_opt_set(sync->sock, SWITCH_SO_REUSEADDR, 1);
+
+	if (switch_socket_bind(sync->sock, sa) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot bind limit sync socket to %s:%d\n", sync->listen_ip, sync->listen_port);
+		switch_socket_close(sync->sock);
+		sync->sock = NULL;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* any value but 0 will do, it only has to differ from the previous run */
+	sync->boot = (uint32_t)(switch_micro_time_now() / 1000);
+	if (!sync->boot) {
+		sync->boot = 1;
+	}
+
+	sync->running = 1;
+	switch_threadattr_create(&thd_attr, sync->pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&sync->thread, thd_attr, limit_sync_thread, sync, sync->pool);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Limit sync node %s listening on %s:%d\n", sync->node, sync->listen_ip, sync->listen_port);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void limit_sync_stop(void)
+{
+	limit_sync_t *sync = globals.sync;
+	switch_status_t st;
+	int i;
+
+	if (!sync) {
+		return;
+	}
+
+	sync->running = 0;
+	if (sync->thread) {
+		switch_thread_join(&st, sync->thread);
+	}
+	if (sync->sock) {
+		switch_socket_close(sync->sock);
+	}
+
+	globals.sync = NULL;
+
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[i];
+		limit_sync_dirty_t *dirty, *next;
+
+		switch_mutex_lock(shard->mutex);
+		for (dirty = shard->dirty; dirty; dirty = next) {
+			next = dirty->next;
+			free(dirty->key);
+			free(dirty);
+		}
+		shard->dirty = NULL;
+		switch_mutex_unlock(shard->mutex);
+	}
+
+	switch_core_destroy_memory_pool(&sync->pool);
+}
+
+static void limit_sync_status(switch_stream_handle_t *stream)
+{
+	limit_sync_t *sync = globals.sync;
+	switch_hash_index_t *hi;
+
+	if (!sync) {
+		stream->write_function(stream, "-ERR limit sync is not enabled\n");
+		return;
+	}
+
+	stream->write_function(stream, "Node: %s\nListen: %s:%d\nBoot: %u\nSeq: %u\n", sync->node, sync->listen_ip, sync->listen_port, sync->boot, sync->seq);
+	stream->write_function(stream, "Packets sent: %" SWITCH_UINT64_T_FMT "\nPackets received: %" SWITCH_UINT64_T_FMT "\n", sync->packets_sent, sync->packets_received);
+	stream->write_function(stream, "Keys sent: %" SWITCH_UINT64_T_FMT "\nKeys received: %" SWITCH_UINT64_T_FMT "\n", sync->keys_sent, sync->keys_received);
+	stream->write_function(stream, "Snapshots sent: %" SWITCH_UINT64_T_FMT "\nResyncs sent: %" SWITCH_UINT64_T_FMT "\nBad packets: %" SWITCH_UINT64_T_FMT "\n",
+						   sync->snapshots_sent, sync->resyncs_sent, sync->bad_packets);
+	if (sync->full_active) {
+		stream->write_function(stream, "Snapshot: %s, shard %d of %d\n", zstr(sync->full_to) ? "all peers" : sync->full_to, sync->full_shard, LIMIT_HASH_SHARDS);
+	}
+
+	stream->write_function(stream, "\nPeer\t\t\tState\tKeys\tSeq\tGaps\tLast rx (ms ago)\n");
+	switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+	for (hi = switch_core_hash_first(globals.remote_hash); hi; hi = switch_core_hash_next(&hi)) {
+		void *val;
+		const void *key;
+		switch_ssize_t keylen;
+		limit_remote_t *remote;
+		switch_hash_index_t *ki;
+		int keys = 0;
+		switch_core_hash_this(hi, &key, &keylen, &val);
+
+		remote = (limit_remote_t *)val;
+		if (!remote->sync) {
+			continue;
+		}
+
+		switch_thread_rwlock_rdlock(remote->rwlock);
+		for (ki = switch_core_hash_first(remote->index); ki; ki = switch_core_hash_next(&ki)) {
+			keys++;
+		}
+		switch_thread_rwlock_unlock(remote->rwlock);
+
+		stream->write_function(stream, "%s\t\t\t%s\t%d\t%u\t%u\t%" SWITCH_TIME_T_FMT "\n", remote->name, state_str(remote->state), keys,
+							   remote->sync_seq, remote->sync_gaps, remote->sync_last_rx ? (switch_micro_time_now() - remote->sync_last_rx) / 1000 : -1);
+	}
+	switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
+	stream->write_function(stream, "+OK\n");
+}
+
+static void do_config_sync(switch_xml_t x_sync, switch_bool_t reload)
+{
+	switch_xml_t x_param, x_peers, x_peer;
+	limit_sync_t *sync = globals.sync;
+
+	if (!sync) {
+		switch_memory_pool_t *pool;
+
+		if (reload) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Limit sync can only be enabled at load time\n");
+			return;
+		}
+
+		if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+			return;
+		}
+
+		sync = switch_core_alloc(pool, sizeof(*sync));
+		sync->pool = pool;
+		sync->node = switch_core_strdup(pool, switch_core_get_switchname());
+		sync->listen_ip = "0.0.0.0";
+		sync->listen_port = 8029;
+		sync->interval = 20;
+		sync->heartbeat = 1000;
+		sync->timeout = 3000;
+		sync->full_interval = 60;
+		sync->tick_packets = 32;
+
+		for (x_param = switch_xml_child(x_sync, "param"); x_param; x_param = x_param->next) {
+			const char *var = switch_xml_attr_soft(x_param, "name");
+			const char *val = switch_xml_attr_soft(x_param, "value");
+
+			if (zstr(val)) {
+				continue;
+			}
+
+			if (!strcasecmp(var, "node-id")) {
+				sync->node = switch_core_strdup(pool, val);
+			} else if (!strcasecmp(var, "listen-ip")) {
+				sync->listen_ip = switch_core_strdup(pool, val);
+			} else if (!strcasecmp(var, "listen-port")) {
+				sync->listen_port = (switch_port_t)atoi(val);
+			} else if (!strcasecmp(var, "interval")) {
+				sync->interval = atoi(val) > 0 ? atoi(val) : 20;
+			} else if (!strcasecmp(var, "heartbeat")) {
+				sync->heartbeat = atoi(val) > 0 ? atoi(val) : 1000;
+			} else if (!strcasecmp(var, "timeout")) {
+				sync->timeout = atoi(val) > 0 ? atoi(val) : 3000;
+			} else if (!strcasecmp(var, "full-interval")) {
+				sync->full_interval = atoi(val) > 0 ? atoi(val) : 0;
+			} else if (!strcasecmp(var, "tick-packets")) {
+				sync->tick_packets = atoi(val) > 0 ? atoi(val) : 32;
+			}
+		}
+
+		if (strlen(sync->node) > 64) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Limit sync node-id %s is too long\n", sync->node);
+			switch_core_destroy_memory_pool(&pool);
+			return;
+		}
+
+		if (sync->timeout < sync->heartbeat * 2) {
+			sync->timeout = sync->heartbeat * 2;
+		}
+
+		if (limit_sync_start(sync) != SWITCH_STATUS_SUCCESS) {
+			switch_core_destroy_memory_pool(&pool);
+			return;
+		}
+
+		globals.sync = sync;
+	}
+
+	if ((x_peers = switch_xml_child(x_sync, "peers"))) {
+		for (x_peer = switch_xml_child(x_peers, "peer"); x_peer; x_peer = x_peer->next) {
+			const char *name = switch_xml_attr(x_peer, "name");
+			const char *host = switch_xml_attr(x_peer, "host");
+			const char *szport = switch_xml_attr(x_peer, "port");
+			switch_port_t port = zstr(szport) ? sync->listen_port : (switch_port_t)atoi(szport);
+			switch_sockaddr_t *sa = NULL;
+			limit_remote_t *remote;
+
+			if (zstr(name) || zstr(host)) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Limit sync peers need a name and a host\n");
+				continue;
+			}
+
+			switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+			remote = switch_core_hash_find(globals.remote_hash, name);
+			switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
+			if (remote) {
+				continue;
+			}
+
+			if (!(remote = limit_remote_create(name, host, port, "", "", 0))) {
+				continue;
+			}
+
+			/* the sync thread only looks at remotes flagged sync, so fill it in before the flag */
+			if (switch_sockaddr_info_get(&sa, host, sync->family, port, 0, remote->pool) != SWITCH_STATUS_SUCCESS || !sa) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot resolve limit sync peer %s (%s)\n", name, host);
+				continue;
+			}
+
+			remote->sync_addr = sa;
+			remote->sync_want_resync = SWITCH_TRUE;
+			remote->state = REMOTE_DOWN;
+			remote->sync = SWITCH_TRUE;
+		}
+	}
+}
+
 static void do_config(switch_bool_t reload)
 {
 	switch_xml_t xml = NULL, x_lists = NULL, x_list = NULL, cfg = NULL;
@@ -924,7 +1956,9 @@ static void do_config(switch_bool_t reload)
 					interval = atoi(szinterval);
 				}
 
-				remote = limit_remote_create(name, host, port, username, password, interval);
+				if (!(remote = limit_remote_create(name, host, port, username, password, interval))) {
+					continue;
+				}
 
 				remote->state = REMOTE_DOWN;
 
@@ -933,6 +1967,11 @@ static void do_config(switch_bool_t reload)
 				switch_thread_create(&remote->thread, thd_attr, limit_remote_thread, remote, remote->pool);
 			}
 		}
+
+		if ((x_lists = switch_xml_child(cfg, "sync"))) {
+			do_config_sync(x_lists, reload);
+		}
+
 		switch_xml_free(xml);
 	}
 }
@@ -944,6 +1983,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 	switch_api_interface_t *commands_api_interface;
 	switch_limit_interface_t *limit_interface;
 	switch_status_t status;
+	int i;
 
 	memset(&globals, 0, sizeof(globals));
 	globals.pool = pool;
@@ -954,10 +1994,13 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 		return SWITCH_STATUS_FALSE;
 	}
 
-	switch_thread_rwlock_create(&globals.limit_hash_rwlock, globals.pool);
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		switch_mutex_init(&globals.limit_shards[i].mutex, SWITCH_MUTEX_NESTED, globals.pool);
+		switch_core_hash_init(&globals.limit_shards[i].hash);
+	}
+	switch_mutex_init(&globals.pvt_mutex, SWITCH_MUTEX_NESTED, globals.pool);
 	switch_thread_rwlock_create(&globals.db_hash_rwlock, globals.pool);
 	switch_thread_rwlock_create(&globals.remote_hash_rwlock, globals.pool);
-	switch_core_hash_init(&globals.limit_hash);
 	switch_core_hash_init(&globals.db_hash);
 	switch_core_hash_init(&globals.remote_hash);
 
@@ -982,6 +2025,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 	switch_console_set_complete("add hash_remote list");
 	switch_console_set_complete("add hash_remote kill");
 	switch_console_set_complete("add hash_remote rescan");
+	switch_console_set_complete("add hash_remote sync");
 
 	do_config(SWITCH_FALSE);
 
@@ -994,20 +2038,25 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 {
 	switch_hash_index_t *hi = NULL;
 	switch_bool_t remote_clean = SWITCH_TRUE;
+	int i;
 
 	switch_scheduler_del_task_group("mod_hash");
 
-	/* Kill remote connections, destroy needs a wrlock so we unlock after finding a pointer */
+	limit_sync_stop();
+
+	/* Kill remote connections, unlink each one before destroying it */
 	while(remote_clean) {
 		void *val;
 		const void *key = NULL;
 		switch_ssize_t keylen;
 		limit_remote_t *item = NULL;
 
-		switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+		switch_thread_rwlock_wrlock(globals.remote_hash_rwlock);
 		if ((hi = switch_core_hash_first(globals.remote_hash))) {
 			switch_core_hash_this(hi, &key, &keylen, &val);
 			item = (limit_remote_t *)val;
+			switch_core_hash_delete(globals.remote_hash, key);
+			switch_safe_free(hi);
 		}
 		switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
 
@@ -1015,22 +2064,25 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 			remote_clean = SWITCH_FALSE;
 		} else {
 			limit_remote_destroy(&item);
-			switch_thread_rwlock_wrlock(globals.remote_hash_rwlock);
-			switch_core_hash_delete(globals.remote_hash, key);
-			switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
 		}
 	}
 
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
 	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
 
-	while ((hi = switch_core_hash_first_iter( globals.limit_hash, hi))) {
-		void *val = NULL;
-		const void *key;
-		switch_ssize_t keylen;
-		switch_core_hash_this(hi, &key, &keylen, &val);
-		free(val);
-		switch_core_hash_delete(globals.limit_hash, key);
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[i];
+
+		switch_mutex_lock(shard->mutex);
+		while ((hi = switch_core_hash_first_iter(shard->hash, hi))) {
+			void *val = NULL;
+			const void *key;
+			switch_ssize_t keylen;
+			switch_core_hash_this(hi, &key, &keylen, &val);
+			free(val);
+			switch_core_hash_delete(shard->hash, key);
+		}
+		switch_core_hash_destroy(&shard->hash);
+		switch_mutex_unlock(shard->mutex);
 	}
 
 	while ((hi = switch_core_hash_first_iter( globals.db_hash, hi))) {
@@ -1042,15 +2094,12 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 		switch_core_hash_delete(globals.db_hash, key);
 	}
 
-	switch_core_hash_destroy(&globals.limit_hash);
 	switch_core_hash_destroy(&globals.db_hash);
 	switch_core_hash_destroy(&globals.remote_hash);
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 	switch_thread_rwlock_unlock(globals.db_hash_rwlock);
 
 	switch_thread_rwlock_destroy(globals.db_hash_rwlock);
-	switch_thread_rwlock_destroy(globals.limit_hash_rwlock);
 	switch_thread_rwlock_destroy(globals.remote_hash_rwlock);
 
 
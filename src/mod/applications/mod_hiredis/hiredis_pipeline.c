@@ -146,8 +146,10 @@ static switch_status_t hiredis_profile_execute_pipeline_request(hiredis_profile_
 			status = SWITCH_STATUS_SUCCESS;
 		}
 	} else {
-		/* failed... do sync request instead */
-		status = hiredis_profile_execute_sync(profile, session, request->response, request->request);
+		/* failed... do sync request instead, this also handles eval requests */
+		request->next = NULL;
+		hiredis_profile_execute_requests(profile, session, request);
+		status = request->status;
 		if ( !request->response ) {
 			switch_safe_free(request->request);
 			switch_safe_free(request->keys);
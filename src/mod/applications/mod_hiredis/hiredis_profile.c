@@ -115,7 +115,8 @@ static hiredis_context_t *hiredis_connection_get_context(hiredis_connection_t *c
 	return NULL;
 }
 
-switch_status_t hiredis_profile_create(hiredis_profile_t **new_profile, char *name, uint8_t ignore_connect_fail, uint8_t ignore_error, int max_pipelined_requests, int delete_when_zero)
+switch_status_t hiredis_profile_create(hiredis_profile_t **new_profile, char *name, uint8_t ignore_connect_fail, uint8_t ignore_error, int max_pipelined_requests, int delete_when_zero,
+									   int limit_lease_size, int limit_async_release)
 {
 	hiredis_profile_t *profile = NULL;
 	switch_memory_pool_t *pool = NULL;
@@ -130,6 +131,10 @@ switch_status_t hiredis_profile_create(hiredis_profile_t **new_profile, char *na
 	profile->ignore_connect_fail = ignore_connect_fail;
 	profile->ignore_error = ignore_error;
 	profile->delete_when_zero = delete_when_zero;
+	profile->limit_lease_size = limit_lease_size;
+	profile->limit_async_release = limit_async_release;
+	switch_mutex_init(&profile->limit_lease_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&profile->limit_leases);
 
 	profile->pipeline_running = 0;
 	profile->max_pipelined_requests = max_pipelined_requests;
@@ -158,6 +163,7 @@ switch_status_t hiredis_profile_destroy(hiredis_profile_t **old_profile)
 	hiredis_pipeline_threads_stop(profile);
 
 	switch_core_hash_delete(mod_hiredis_globals.profiles, profile->name);
+	switch_core_hash_destroy(&profile->limit_leases);
 	switch_core_destroy_memory_pool(&(profile->pool));
 
 	return SWITCH_STATUS_SUCCESS;
@@ -301,8 +307,21 @@ static switch_status_t hiredis_context_execute_requests(hiredis_context_t *conte
 	for ( cur_request = requests; cur_request; cur_request = cur_request->next ) {
 		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(cur_request->session_uuid), SWITCH_LOG_DEBUG, "hiredis: %s\n", cur_request->request);
 		if ( cur_request->do_eval ) {
-			/* eval needs special formatting to work properly */
-			redisAppendCommand(context->context, "eval %s %d %s", cur_request->request, cur_request->num_keys, cur_request->keys ? cur_request->keys : "");
+			/* eval needs special formatting to work properly: the script is one argument, keys holds the space separated keys followed by any ARGV */
+			char *keys = strdup(cur_request->keys ? cur_request->keys : "");
+			char num_keys[16];
+			const char *argv[MOD_HIREDIS_MAX_ARGS];
+			int argc = 3;
+
+			switch_snprintf(num_keys, sizeof(num_keys), "%d", cur_request->num_keys);
+			argv[0] = "eval";
+			argv[1] = cur_request->request;
+			argv[2] = num_keys;
+			if ( !zstr(keys) ) {
+				argc += switch_separate_string(keys, ' ', (char **)argv + 3, MOD_HIREDIS_MAX_ARGS - 3);
+			}
+			redisAppendCommandArgv(context->context, argc, argv, NULL);
+			switch_safe_free(keys);
 		} else {
 			if (cur_request->argc == 0) {
 				cur_request->argc = switch_separate_string(cur_request->request, ' ', cur_request->argv, MOD_HIREDIS_MAX_ARGS);
@@ -49,6 +49,8 @@ switch_status_t mod_hiredis_do_config()
 			uint8_t ignore_error = 0;
 			int max_pipelined_requests = 0;
 			int delete_when_zero = 0;
+			int limit_lease_size = 0;
+			int limit_async_release = 0;
 			char *name = (char *) switch_xml_attr_soft(profile, "name");
 
 			// Load params
@@ -63,6 +65,10 @@ switch_status_t mod_hiredis_do_config()
 						max_pipelined_requests = atoi(switch_xml_attr_soft(param, "value"));
 					} else if ( !strncmp(var, "delete-when-zero", 16) ) {
 						delete_when_zero = switch_true(switch_xml_attr_soft(param, "value"));
+					} else if ( !strncmp(var, "limit-lease-size", 16) ) {
+						limit_lease_size = atoi(switch_xml_attr_soft(param, "value"));
+					} else if ( !strncmp(var, "limit-async-release", 19) ) {
+						limit_async_release = switch_true(switch_xml_attr_soft(param, "value"));
 					}
 				}
 			}
@@ -71,7 +77,12 @@ switch_status_t mod_hiredis_do_config()
 				max_pipelined_requests = 20;
 			}
 
-			if ( hiredis_profile_create(&new_profile, name, ignore_connect_fail, ignore_error, max_pipelined_requests, delete_when_zero) == SWITCH_STATUS_SUCCESS ) {
+			if (limit_lease_size < 0) {
+				limit_lease_size = 0;
+			}
+
+			if ( hiredis_profile_create(&new_profile, name, ignore_connect_fail, ignore_error, max_pipelined_requests, delete_when_zero,
+										limit_lease_size, limit_async_release) == SWITCH_STATUS_SUCCESS ) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Created profile[%s]\n", name);
 			} else {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to create profile[%s]\n", name);
@@ -39,6 +39,40 @@ SWITCH_MODULE_DEFINITION(mod_hiredis, mod_hiredis_load, mod_hiredis_shutdown, NU
 
 #define DECR_DEL_SCRIPT "local v=redis.call(\"decr\",KEYS[1]);if v <= 0 then redis.call(\"del\",KEYS[1]) end;return v;"
 
+/* KEYS[1] limit key, ARGV[1] max, ARGV[2] interval, ARGV[3] delete when zero.
+   Increments in one round trip, over the max the increment is taken back again unless the key is an interval bucket. */
+#define LIMIT_INCR_SCRIPT "local v=redis.call(\"incr\",KEYS[1]);local max=tonumber(ARGV[1]);local interval=tonumber(ARGV[2]);" \
+	"if interval>0 and v==1 then redis.call(\"expire\",KEYS[1],interval) end;" \
+	"if max>0 and v>max and interval==0 then local d=redis.call(\"decr\",KEYS[1]);if d<=0 and ARGV[3]==\"1\" then redis.call(\"del\",KEYS[1]) end end;return v;"
+
+/* KEYS[1] limit key, KEYS[2] wanted key, ARGV[1] max, ARGV[2] units wanted, ARGV[3] delete when zero, ARGV[4] units this node holds,
+   ARGV[5] wanted TTL in ms. Returns the units leased, never more than max in total. When nothing is left but other nodes hold
+   units, flags the key as wanted so they hand back their spare ones and returns -1. */
+#define LIMIT_LEASE_SCRIPT "local max=tonumber(ARGV[1]);local n=tonumber(ARGV[2]);local v=redis.call(\"incrby\",KEYS[1],n);" \
+	"if v>max then local over=v-max;if over>n then over=n end;v=redis.call(\"decrby\",KEYS[1],over);n=n-over end;" \
+	"if n==0 and v-tonumber(ARGV[4])>0 then redis.call(\"set\",KEYS[2],\"1\",\"px\",ARGV[5]);n=-1 end;" \
+	"if v<=0 and ARGV[3]==\"1\" then redis.call(\"del\",KEYS[1]) end;return n;"
+
+/* KEYS[1] limit key, KEYS[2] wanted key, ARGV[1] leased units handed back, ARGV[2] spare units handed back only if another
+   node wants them, ARGV[3] delete when zero. Returns the units handed back. */
+#define LIMIT_RETURN_SCRIPT "local n=tonumber(ARGV[1]);if tonumber(ARGV[2])>0 and redis.call(\"exists\",KEYS[2])==1 then n=n+tonumber(ARGV[2]) end;" \
+	"if n>0 then local v=redis.call(\"decrby\",KEYS[1],n);if v<=0 and ARGV[3]==\"1\" then redis.call(\"del\",KEYS[1]) end end;return n;"
+
+/* a leased limit key is flagged as wanted under this key */
+#define LIMIT_WANTED_SUFFIX "_lease_wanted"
+
+/* how often spare units are offered to other nodes and failed returns are retried */
+#define LIMIT_LEASE_INTERVAL_MS 100
+
+/* how many times an increment waits for other nodes to hand back spare units */
+#define LIMIT_BORROW_TRIES 3
+
+typedef enum {
+	LIMIT_RETURN_PENDING,
+	LIMIT_RETURN_IF_WANTED,
+	LIMIT_RETURN_ALL
+} hiredis_limit_return_t;
+
 /**
  * Get exclusive access to limit_pvt, if it exists
  */
@@ -179,6 +213,184 @@ SWITCH_STANDARD_API(raw_api)
 	return status;
 }
 
+/**
+ * Take one unit of a leased limit key, adding granted units leased from redis first
+ * @return SWITCH_TRUE if a unit was taken, count is set to the local usage
+ */
+static switch_bool_t hiredis_limit_lease_take(hiredis_profile_t *profile, const char *limit_key, int max, int granted, int64_t *count)
+{
+	hiredis_limit_lease_t *lease;
+	switch_bool_t taken = SWITCH_FALSE;
+
+	switch_mutex_lock(profile->limit_lease_mutex);
+	if ( !(lease = switch_core_hash_find(profile->limit_leases, limit_key)) ) {
+		if ( !granted ) {
+			switch_mutex_unlock(profile->limit_lease_mutex);
+			return SWITCH_FALSE;
+		}
+		switch_zmalloc(lease, sizeof(*lease));
+		switch_core_hash_insert_auto_free(profile->limit_leases, limit_key, lease);
+	}
+	lease->leased += granted;
+	if ( lease->used < lease->leased && lease->used < max ) {
+		lease->used++;
+		taken = SWITCH_TRUE;
+	}
+	*count = lease->used;
+	switch_mutex_unlock(profile->limit_lease_mutex);
+
+	return taken;
+}
+
+/**
+ * @return the units of a limit key redis counts as held by this node
+ */
+static int hiredis_limit_lease_held(hiredis_profile_t *profile, const char *limit_key)
+{
+	hiredis_limit_lease_t *lease;
+	int held = 0;
+
+	switch_mutex_lock(profile->limit_lease_mutex);
+	if ( (lease = switch_core_hash_find(profile->limit_leases, limit_key)) ) {
+		held = lease->leased + lease->returning + lease->in_flight;
+	}
+	switch_mutex_unlock(profile->limit_lease_mutex);
+
+	return held;
+}
+
+/**
+ * Give back one unit of a leased limit key, spare units above one block are queued to go back to redis
+ * @return the number of leased units queued
+ */
+static int hiredis_limit_lease_put(hiredis_profile_t *profile, const char *limit_key)
+{
+	hiredis_limit_lease_t *lease;
+	int surplus = 0;
+
+	switch_mutex_lock(profile->limit_lease_mutex);
+	if ( (lease = switch_core_hash_find(profile->limit_leases, limit_key)) ) {
+		if ( lease->used > 0 ) {
+			lease->used--;
+		}
+
+		/* keep one block of spare capacity while the key is in use */
+		if ( !lease->used ) {
+			surplus = lease->leased;
+		} else if ( lease->leased - lease->used > profile->limit_lease_size ) {
+			surplus = lease->leased - lease->used - profile->limit_lease_size;
+		}
+		lease->leased -= surplus;
+		lease->returning += surplus;
+	}
+	switch_mutex_unlock(profile->limit_lease_mutex);
+
+	return surplus;
+}
+
+/**
+ * Hand leased units of a limit key back to redis. Units that could not be handed back stay queued for the lease thread to retry.
+ * @param how LIMIT_RETURN_PENDING for the queued units only, LIMIT_RETURN_IF_WANTED to add the spare units if another node
+ *            is waiting for capacity, LIMIT_RETURN_ALL to add the spare units regardless
+ */
+static switch_status_t hiredis_limit_lease_return(hiredis_profile_t *profile, switch_core_session_t *session, const char *limit_key, hiredis_limit_return_t how)
+{
+	hiredis_limit_lease_t *lease;
+	switch_status_t status;
+	char *keys, *response = NULL;
+	int returning, spare = 0, returned = -1;
+
+	if ( how == LIMIT_RETURN_IF_WANTED ) {
+		/* only pull spare units out of the lease when another node asked for them */
+		switch_mutex_lock(profile->limit_lease_mutex);
+		spare = (lease = switch_core_hash_find(profile->limit_leases, limit_key)) ? lease->leased - lease->used : 0;
+		switch_mutex_unlock(profile->limit_lease_mutex);
+
+		if ( spare <= 0 || hiredis_profile_execute_pipeline_printf(profile, session, &response, "exists %s%s", limit_key, LIMIT_WANTED_SUFFIX) != SWITCH_STATUS_SUCCESS ||
+			 !response || atoi(response) != 1 ) {
+			how = LIMIT_RETURN_PENDING;
+		}
+		switch_safe_free(response);
+		spare = 0;
+	}
+
+	switch_mutex_lock(profile->limit_lease_mutex);
+	if ( !(lease = switch_core_hash_find(profile->limit_leases, limit_key)) ) {
+		switch_mutex_unlock(profile->limit_lease_mutex);
+		return SWITCH_STATUS_SUCCESS;
+	}
+	if ( how != LIMIT_RETURN_PENDING ) {
+		/* spare units are taken out of the lease while redis decides, local increments can't use them meanwhile */
+		spare = lease->leased - lease->used;
+		lease->leased -= spare;
+		if ( how == LIMIT_RETURN_ALL ) {
+			lease->returning += spare;
+			spare = 0;
+		}
+	}
+	returning = lease->returning;
+	lease->returning = 0;
+	lease->in_flight += returning + spare;
+	switch_mutex_unlock(profile->limit_lease_mutex);
+
+	if ( !returning && !spare ) {
+		status = SWITCH_STATUS_SUCCESS;
+		returned = 0;
+	} else {
+		keys = switch_mprintf("%s %s%s %d %d %d", limit_key, limit_key, LIMIT_WANTED_SUFFIX, returning, spare, profile->delete_when_zero);
+		status = hiredis_profile_eval_pipeline(profile, session, &response, LIMIT_RETURN_SCRIPT, 2, keys);
+		if ( status == SWITCH_STATUS_SUCCESS && switch_is_number(response ? response : "") ) {
+			returned = atoi(response);
+		} else if ( status == SWITCH_STATUS_SUCCESS ) {
+			status = SWITCH_STATUS_GENERR;
+		}
+		switch_safe_free(keys);
+	}
+
+	switch_mutex_lock(profile->limit_lease_mutex);
+	/* in_flight kept the lease from being deleted meanwhile */
+	lease = switch_core_hash_find(profile->limit_leases, limit_key);
+	lease->in_flight -= returning + spare;
+	if ( returned < 0 ) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "hiredis: profile[%s] failed to hand back %d leased units of [%s] because [%s], will retry\n",
+						  profile->name, returning, limit_key, response ? response : "");
+		lease->returning += returning;
+		lease->leased += spare;
+	} else if ( returned < returning + spare ) {
+		/* nobody wanted the spare units */
+		lease->leased += spare;
+	}
+	if ( !lease->leased && !lease->used && !lease->returning && !lease->in_flight ) {
+		switch_core_hash_delete(profile->limit_leases, limit_key);
+	}
+	switch_mutex_unlock(profile->limit_lease_mutex);
+
+	switch_safe_free(response);
+	return status;
+}
+
+/**
+ * Decrement a limit key, or hand back leased units of it
+ */
+static switch_status_t hiredis_limit_decrement(hiredis_profile_t *profile, switch_core_session_t *session, char **response, const char *limit_key, int leased)
+{
+	char **resp = profile->limit_async_release ? NULL : response;
+
+	if ( leased ) {
+		if ( !hiredis_limit_lease_put(profile, limit_key) || profile->limit_async_release ) {
+			/* the lease thread hands queued units back */
+			return SWITCH_STATUS_SUCCESS;
+		}
+		return hiredis_limit_lease_return(profile, session, limit_key, LIMIT_RETURN_PENDING);
+	}
+
+	if ( profile->delete_when_zero ) {
+		return hiredis_profile_eval_pipeline(profile, session, resp, DECR_DEL_SCRIPT, 1, limit_key);
+	}
+
+	return hiredis_profile_execute_pipeline_printf(profile, session, resp, "decr %s", limit_key);
+}
+
 /*
 SWITCH_LIMIT_INCR(name) static switch_status_t name (switch_core_session_t *session, const char *realm, const char *resource,
                                                      const int max, const int interval)
@@ -187,13 +399,14 @@ SWITCH_LIMIT_INCR(hiredis_limit_incr)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	hiredis_profile_t *profile = NULL;
-	char *response = NULL, *limit_key = NULL;
+	char *response = NULL, *limit_key = NULL, *keys = NULL;
 	int64_t count = 0; /* Redis defines the incr action as to be performed on a 64 bit signed integer */
 	time_t now = switch_epoch_time_now(NULL);
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 	hiredis_limit_pvt_t *limit_pvt = NULL;
 	hiredis_limit_pvt_node_t *limit_pvt_node = NULL;
 	switch_memory_pool_t *session_pool = switch_core_session_get_pool(session);
+	int lease = 0, tries = 0, borrows = 0;
 
 	if ( zstr(realm) ) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "hiredis: realm must be defined\n");
@@ -218,7 +431,26 @@ SWITCH_LIMIT_INCR(hiredis_limit_incr)
 		limit_key = switch_core_session_sprintf(session, "%s", resource);
 	}
 
-	if ( (status = hiredis_profile_execute_pipeline_printf(profile, session, &response, "incr %s", limit_key) ) != SWITCH_STATUS_SUCCESS ) {
+	/* concurrent limits with a maximum can be served from capacity leased earlier */
+	lease = !interval && max > 0 && profile->limit_lease_size > 0;
+
+	if ( lease ) {
+		if ( hiredis_limit_lease_take(profile, limit_key, max, 0, &count) ) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "resource = %s, leased usage = %" SWITCH_INT64_T_FMT "\n", limit_key, count);
+			switch_channel_set_variable_printf(channel, "hiredis_raw_response", "%" SWITCH_INT64_T_FMT, count);
+			goto track;
+		}
+	} else {
+		keys = switch_core_session_sprintf(session, "%s %d %d %d", limit_key, max, interval, profile->delete_when_zero);
+	}
+
+ again:
+	if ( lease ) {
+		keys = switch_core_session_sprintf(session, "%s %s%s %d %d %d %d %d", limit_key, limit_key, LIMIT_WANTED_SUFFIX, max, profile->limit_lease_size,
+										   profile->delete_when_zero, hiredis_limit_lease_held(profile, limit_key), (LIMIT_BORROW_TRIES + 1) * LIMIT_LEASE_INTERVAL_MS);
+	}
+
+	if ( (status = hiredis_profile_eval_pipeline(profile, session, &response, lease ? LIMIT_LEASE_SCRIPT : LIMIT_INCR_SCRIPT, lease ? 2 : 1, keys) ) != SWITCH_STATUS_SUCCESS ) {
 		if ( status == SWITCH_STATUS_SOCKERR && profile->ignore_connect_fail) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "hiredis: ignoring profile[%s] connection error incrementing [%s]\n", realm, limit_key);
 			switch_goto_status(SWITCH_STATUS_SUCCESS, done);
@@ -231,36 +463,57 @@ SWITCH_LIMIT_INCR(hiredis_limit_incr)
 		switch_goto_status(SWITCH_STATUS_GENERR, done);
 	}
 
-	/* set expiration for interval on first increment */
-	if ( interval && !strcmp("1", response ? response : "") ) {
-		hiredis_profile_execute_pipeline_printf(profile, session, NULL, "expire %s %d", limit_key, interval);
+	switch_channel_set_variable(channel, "hiredis_raw_response", response ? response : "");
+
+	if ( !switch_is_number(response ? response : "") ) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "hiredis: unexpected response incrementing [%s]: %s\n", limit_key, response ? response : "");
+		if ( !profile->ignore_error ) {
+			/* got response error */
+			switch_goto_status(SWITCH_STATUS_GENERR, done);
+		}
+		switch_goto_status(SWITCH_STATUS_SUCCESS, done);
 	}
 
-	switch_channel_set_variable(channel, "hiredis_raw_response", response ? response : "");
+	if ( lease ) {
+		int granted = atoi(response);
 
-	count = atoll(response ? response : "");
+		switch_safe_free(response);
+		if ( granted < 0 ) {
+			if ( ++borrows <= LIMIT_BORROW_TRIES ) {
+				/* other nodes hold units, give them time to hand back the ones they don't use */
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "resource = %s, waiting for other nodes to hand back spare units\n", limit_key);
+				switch_yield(LIMIT_LEASE_INTERVAL_MS * 1000);
+				goto again;
+			}
+			granted = 0;
+		}
+		if ( hiredis_limit_lease_take(profile, limit_key, max, granted, &count) ) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "resource = %s, leased %d, usage = %" SWITCH_INT64_T_FMT "\n", limit_key, granted, count);
+			goto track;
+		}
+		if ( granted && ++tries < 3 ) {
+			/* other calls took the units we were granted */
+			goto again;
+		}
+		switch_channel_set_variable(channel, "hiredis_limit_exceeded", "true");
+		switch_goto_status(SWITCH_STATUS_GENERR, done);
+	}
 
-	if ( switch_is_number(response ? response : "") && count <= 0 ) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "limit not positive after increment, resource = %s, val = %s\n", limit_key, response ? response : "");
+	count = atoll(response);
+
+	if ( count <= 0 ) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "limit not positive after increment, resource = %s, val = %s\n", limit_key, response);
 	} else {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "resource = %s, response = %s\n", limit_key, response ? response : "");
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "resource = %s, response = %s\n", limit_key, response);
 	}
 
-	if ( !switch_is_number(response ? response : "") && !profile->ignore_error ) {
-		/* got response error */
-		switch_goto_status(SWITCH_STATUS_GENERR, done);
-	} else if ( max > 0 && count > 0 && count > max ) {
+	if ( max > 0 && count > 0 && count > max ) {
+		/* the script already took it back for non-interval limits */
 		switch_channel_set_variable(channel, "hiredis_limit_exceeded", "true");
-		if ( !interval ) { /* don't need to decrement intervals if limit exceeded since the interval keys are named w/ timestamp */
-			if ( profile->delete_when_zero ) {
-				hiredis_profile_eval_pipeline(profile, session, NULL, DECR_DEL_SCRIPT, 1, limit_key);
-			} else {
-				hiredis_profile_execute_pipeline_printf(profile, session, NULL, "decr %s", limit_key);
-			}
-		}
 		switch_goto_status(SWITCH_STATUS_GENERR, done);
 	}
 
+ track:
 	if ( !interval && count > 0 ) {
 		/* only non-interval limits need to be released on session destroy */
 		limit_pvt_node = switch_core_alloc(session_pool, sizeof(*limit_pvt_node));
@@ -269,6 +522,7 @@ SWITCH_LIMIT_INCR(hiredis_limit_incr)
 		limit_pvt_node->limit_key = limit_key;
 		limit_pvt_node->inc = 1;
 		limit_pvt_node->interval = interval;
+		limit_pvt_node->leased = lease;
 		limit_pvt = add_limit_pvt(session);
 		limit_pvt_node->next = limit_pvt->first;
 		limit_pvt->first = limit_pvt_node;
@@ -305,12 +559,10 @@ SWITCH_LIMIT_RELEASE(hiredis_limit_release)
 			if ( !cur->interval && cur->inc ) {
 				switch_status_t result;
 				cur->inc = 0; /* mark as released */
-				profile = switch_core_hash_find(mod_hiredis_globals.profiles, cur->realm);
-				if ( profile->delete_when_zero ) {
-					result = hiredis_profile_eval_pipeline(profile, session, &response, DECR_DEL_SCRIPT, 1, cur->limit_key);
-				} else {
-					result = hiredis_profile_execute_pipeline_printf(profile, session, &response, "decr %s", cur->limit_key);
+				if ( !(profile = switch_core_hash_find(mod_hiredis_globals.profiles, cur->realm)) ) {
+					continue;
 				}
+				result = hiredis_limit_decrement(profile, session, &response, cur->limit_key, cur->leased);
 				if ( result != SWITCH_STATUS_SUCCESS ) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "hiredis: profile[%s] error decrementing [%s] because [%s]\n",
 									  cur->realm, cur->limit_key, response ? response : "");
@@ -328,11 +580,7 @@ SWITCH_LIMIT_RELEASE(hiredis_limit_release)
 				cur->inc = 0; /* mark as released */
 				profile = switch_core_hash_find(mod_hiredis_globals.profiles, cur->realm);
 				if (profile) {
-					if ( profile->delete_when_zero ) {
-						status = hiredis_profile_eval_pipeline(profile, session, &response, DECR_DEL_SCRIPT, 1, cur->limit_key);
-					} else {
-						status = hiredis_profile_execute_pipeline_printf(profile, session, &response, "decr %s", cur->limit_key);
-					}
+					status = hiredis_limit_decrement(profile, session, &response, cur->limit_key, cur->leased);
 					if ( status != SWITCH_STATUS_SUCCESS ) {
 						if ( status == SWITCH_STATUS_SOCKERR && profile->ignore_connect_fail ) {
 							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "hiredis: ignoring profile[%s] connection error decrementing [%s]\n", cur->realm, cur->limit_key);
@@ -367,6 +615,7 @@ SWITCH_LIMIT_USAGE(hiredis_limit_usage)
 	hiredis_profile_t *profile = switch_core_hash_find(mod_hiredis_globals.profiles, realm);
 	int64_t count = 0; /* Redis defines the incr action as to be performed on a 64 bit signed integer */
 	char *response = NULL;
+	hiredis_limit_lease_t *lease;
 
 	if ( zstr(realm) ) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "hiredis: realm must be defined\n");
@@ -385,6 +634,13 @@ SWITCH_LIMIT_USAGE(hiredis_limit_usage)
 
 	count = atoll(response ? response : "");
 
+	/* redis counts what every node leased, only our own spare units are known to be unused */
+	switch_mutex_lock(profile->limit_lease_mutex);
+	if ( (lease = switch_core_hash_find(profile->limit_leases, resource)) ) {
+		count -= lease->leased - lease->used + lease->returning + lease->in_flight;
+	}
+	switch_mutex_unlock(profile->limit_lease_mutex);
+
 	switch_safe_free(response);
 	return count;
 
@@ -416,7 +672,107 @@ SWITCH_LIMIT_STATUS(name) static char * name (void)
  */
 SWITCH_LIMIT_STATUS(hiredis_limit_status)
 {
-	return strdup("-ERR not supported");
+	switch_stream_handle_t stream = { 0 };
+	switch_hash_index_t *hi, *li;
+	int leases = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	for (hi = switch_core_hash_first(mod_hiredis_globals.profiles); hi; hi = switch_core_hash_next(&hi)) {
+		hiredis_profile_t *profile = NULL;
+
+		switch_core_hash_this(hi, NULL, NULL, (void **)&profile);
+		if ( !profile->limit_lease_size ) {
+			continue;
+		}
+
+		switch_mutex_lock(profile->limit_lease_mutex);
+		for (li = switch_core_hash_first(profile->limit_leases); li; li = switch_core_hash_next(&li)) {
+			const void *key;
+			void *val;
+			hiredis_limit_lease_t *lease;
+
+			switch_core_hash_this(li, &key, NULL, &val);
+			lease = (hiredis_limit_lease_t *)val;
+			stream.write_function(&stream, "%s/%s: %d in use, %d leased, %d going back\n", profile->name, (const char *)key, lease->used, lease->leased,
+								  lease->returning + lease->in_flight);
+			leases++;
+		}
+		switch_mutex_unlock(profile->limit_lease_mutex);
+	}
+
+	if ( !leases ) {
+		stream.write_function(&stream, "No leased limits.\n");
+	}
+
+	return stream.data;
+}
+
+/**
+ * Hand leased units of every limit key of a profile back to redis
+ */
+static void hiredis_limit_leases_return(hiredis_profile_t *profile, hiredis_limit_return_t how)
+{
+	switch_hash_index_t *hi;
+	char **keys = NULL;
+	int i, count = 0, size = 0;
+
+	/* returning takes the lease mutex for each key, so collect the keys first */
+	switch_mutex_lock(profile->limit_lease_mutex);
+	for (hi = switch_core_hash_first(profile->limit_leases); hi; hi = switch_core_hash_next(&hi)) {
+		const void *key;
+
+		switch_core_hash_this(hi, &key, NULL, NULL);
+		if ( count == size ) {
+			size = size ? size * 2 : 16;
+			keys = realloc(keys, size * sizeof(*keys));
+			switch_assert(keys);
+		}
+		keys[count++] = strdup((const char *)key);
+	}
+	switch_mutex_unlock(profile->limit_lease_mutex);
+
+	for (i = 0; i < count; i++) {
+		hiredis_limit_lease_return(profile, NULL, keys[i], how);
+		free(keys[i]);
+	}
+	switch_safe_free(keys);
+}
+
+/**
+ * Retries failed returns and offers spare units to other nodes waiting for them
+ */
+static void *SWITCH_THREAD_FUNC hiredis_limit_lease_thread(switch_thread_t *thread, void *obj)
+{
+	hiredis_profile_t *profile = (hiredis_profile_t *)obj;
+
+	while ( profile->limit_lease_running ) {
+		switch_yield(LIMIT_LEASE_INTERVAL_MS * 1000);
+		hiredis_limit_leases_return(profile, LIMIT_RETURN_IF_WANTED);
+	}
+
+	return NULL;
+}
+
+static void hiredis_limit_lease_thread_start(hiredis_profile_t *profile)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	profile->limit_lease_running = 1;
+	switch_threadattr_create(&thd_attr, profile->pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&profile->limit_lease_thread, thd_attr, hiredis_limit_lease_thread, profile, profile->pool);
+}
+
+static void hiredis_limit_lease_thread_stop(hiredis_profile_t *profile)
+{
+	switch_status_t st;
+
+	if ( profile->limit_lease_thread ) {
+		profile->limit_lease_running = 0;
+		switch_thread_join(&st, profile->limit_lease_thread);
+		profile->limit_lease_thread = NULL;
+	}
 }
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_hiredis_load)
@@ -424,6 +780,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hiredis_load)
 	switch_application_interface_t *app_interface;
 	switch_api_interface_t *api_interface;
 	switch_limit_interface_t *limit_interface;
+	switch_hash_index_t *hi;
 
 	memset(&mod_hiredis_globals, 0, sizeof(mod_hiredis_globals));
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
@@ -436,6 +793,15 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hiredis_load)
 		return SWITCH_STATUS_GENERR;
 	}
 
+	for (hi = switch_core_hash_first(mod_hiredis_globals.profiles); hi; hi = switch_core_hash_next(&hi)) {
+		hiredis_profile_t *profile = NULL;
+
+		switch_core_hash_this(hi, NULL, NULL, (void **)&profile);
+		if ( profile->limit_lease_size ) {
+			hiredis_limit_lease_thread_start(profile);
+		}
+	}
+
 	SWITCH_ADD_LIMIT(limit_interface, "hiredis", hiredis_limit_incr, hiredis_limit_release, hiredis_limit_usage,
 					 hiredis_limit_reset, hiredis_limit_status, hiredis_limit_interval_reset);
 	SWITCH_ADD_APP(app_interface, "hiredis_raw", "hiredis_raw", "hiredis_raw", raw_app, "", SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC | SAF_ZOMBIE_EXEC);
@@ -452,6 +818,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hiredis_shutdown)
 
 	while ((hi = switch_core_hash_first(mod_hiredis_globals.profiles))) {
 		switch_core_hash_this(hi, NULL, NULL, (void **)&profile);
+		hiredis_limit_lease_thread_stop(profile);
+		hiredis_limit_leases_return(profile, LIMIT_RETURN_ALL);
 		hiredis_profile_destroy(&profile);
 		switch_safe_free(hi);
 	}
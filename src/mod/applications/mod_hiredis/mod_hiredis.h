@@ -62,14 +62,32 @@ typedef struct hiredis_profile_s {
 	int max_pipelined_requests;
 
 	int delete_when_zero;
+
+	/* limit capacity leased from redis in blocks so most increments stay local */
+	int limit_lease_size;
+	int limit_async_release;
+	switch_mutex_t *limit_lease_mutex;
+	switch_hash_t *limit_leases;
+	switch_thread_t *limit_lease_thread;
+	int limit_lease_running;
 } hiredis_profile_t;
 
+typedef struct hiredis_limit_lease_s {
+	int leased;
+	int used;
+	/* units queued to go back to redis */
+	int returning;
+	/* units redis is being asked to take back */
+	int in_flight;
+} hiredis_limit_lease_t;
+
 typedef struct hiredis_limit_pvt_node_s {
 	char *realm;
 	char *resource;
 	char *limit_key;
 	int inc;
 	int interval;
+	int leased;
 	struct hiredis_limit_pvt_node_s *next;
 } hiredis_limit_pvt_node_t;
 
@@ -79,7 +97,8 @@ typedef struct hiredis_limit_pvt_s {
 } hiredis_limit_pvt_t;
 
 switch_status_t mod_hiredis_do_config(void);
-switch_status_t hiredis_profile_create(hiredis_profile_t **new_profile, char *name, uint8_t ignore_connect_fail, uint8_t ignore_error, int max_pipelined_requests, int delete_when_zero);
+switch_status_t hiredis_profile_create(hiredis_profile_t **new_profile, char *name, uint8_t ignore_connect_fail, uint8_t ignore_error, int max_pipelined_requests, int delete_when_zero,
+									   int limit_lease_size, int limit_async_release);
 switch_status_t hiredis_profile_destroy(hiredis_profile_t **old_profile);
 switch_status_t hiredis_profile_connection_add(hiredis_profile_t *profile, char *host, char *password, uint32_t port, uint32_t timeout_ms, uint32_t max_connections);
 switch_status_t hiredis_profile_execute_requests(hiredis_profile_t *profile, switch_core_session_t *session, hiredis_request_t *requests);
@@ -71,6 +71,32 @@ typedef struct action_binding_s {
 	struct action_binding_s *parent;
 } action_binding_t;
 
+/* upper bounds in ms of the request latency buckets, the last bucket takes everything slower */
+#define HTTAPI_LATENCY_BUCKETS 12
+static const uint32_t httapi_latency_limits[HTTAPI_LATENCY_BUCKETS - 1] = { 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define HTTAPI_HAVE_MULTI_POLL
+#endif
+
+typedef struct httapi_transfer_s {
+	switch_CURL *curl_handle;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	CURLcode result;
+	int done;
+	struct httapi_transfer_s *next;
+} httapi_transfer_t;
+
+typedef struct httapi_engine_s {
+	CURLM *multi;
+	switch_mutex_t *mutex;
+	httapi_transfer_t *pending;
+	switch_thread_t *thread;
+	int running;
+	int active;
+} httapi_engine_t;
+
 typedef struct client_profile_s {
 	char *name;
 	char *method;
@@ -92,6 +118,19 @@ typedef struct client_profile_s {
 	int connect_timeout;
 	profile_perms_t perms;
 	char *ua;
+	int use_engine;
+	uint32_t max_connections;
+	httapi_engine_t engine;
+
+	struct {
+		switch_mutex_t *mutex;
+		uint64_t requests;
+		uint64_t errors;
+		uint64_t new_connections;
+		uint64_t total_ms;
+		uint32_t max_ms;
+		uint64_t buckets[HTTAPI_LATENCY_BUCKETS];
+	} stats;
 
 	struct {
 		char *use_profile;
@@ -137,6 +176,8 @@ typedef struct client_s {
 		char *file;
 	} record;
 
+	httapi_transfer_t transfer;
+
 	int err;
 	long code;
 } client_t;
@@ -209,7 +250,9 @@ static void bind_parser(const char *tag_name, tag_parse_t handler)
 }
 
 
-#define HTTAPI_SYNTAX "[debug_on|debug_off]"
+#define HTTAPI_SYNTAX "[debug_on|debug_off|stats [<profile>]]"
+static void httapi_stats_print(client_profile_t *profile, switch_stream_handle_t *stream);
+
 SWITCH_STANDARD_API(httapi_api_function)
 {
 	if (session) {
@@ -224,6 +267,28 @@ SWITCH_STANDARD_API(httapi_api_function)
 		globals.debug = 1;
 	} else if (!strcasecmp(cmd, "debug_off")) {
 		globals.debug = 0;
+	} else if (!strncasecmp(cmd, "stats", 5) && (!cmd[5] || cmd[5] == ' ')) {
+		const char *name = cmd + 5;
+		client_profile_t *profile;
+		switch_hash_index_t *hi;
+		void *val;
+
+		while (*name == ' ') name++;
+
+		if (*name) {
+			if (!(profile = (client_profile_t *) switch_core_hash_find(globals.profile_hash, name))) {
+				stream->write_function(stream, "-ERR no such profile [%s]\n", name);
+				return SWITCH_STATUS_SUCCESS;
+			}
+			httapi_stats_print(profile, stream);
+		} else {
+			for (hi = switch_core_hash_first(globals.profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+				switch_core_hash_this(hi, NULL, NULL, &val);
+				httapi_stats_print((client_profile_t *) val, stream);
+			}
+		}
+
+		return SWITCH_STATUS_SUCCESS;
 	} else {
 		goto usage;
 	}
@@ -1368,6 +1433,9 @@ static client_t *client_create(switch_core_session_t *session, const char *profi
 
 	client->profile = profile;
 
+	switch_mutex_init(&client->transfer.mutex, SWITCH_MUTEX_NESTED, client->pool);
+	switch_thread_cond_create(&client->transfer.cond, client->pool);
+
 	client->max_bytes = HTTAPI_MAX_API_BYTES;
 
 	switch_buffer_create_dynamic(&client->buffer, 1024, 1024, 0);
@@ -1402,6 +1470,292 @@ static void cleanup_attachments(client_t *client)
 	}
 }
 
+static void httapi_transfer_done(httapi_transfer_t *transfer, CURLcode result)
+{
+	switch_mutex_lock(transfer->mutex);
+	transfer->result = result;
+	transfer->done = 1;
+	switch_thread_cond_signal(transfer->cond);
+	switch_mutex_unlock(transfer->mutex);
+}
+
+static void *SWITCH_THREAD_FUNC httapi_engine_thread(switch_thread_t *thread, void *obj)
+{
+	client_profile_t *profile = (client_profile_t *) obj;
+	httapi_engine_t *engine = &profile->engine;
+	int still_running = 0;
+
+	for (;;) {
+		httapi_transfer_t *transfer, *next;
+		CURLMsg *msg;
+		int msgs_left = 0;
+
+		switch_mutex_lock(engine->mutex);
+		transfer = engine->pending;
+		engine->pending = NULL;
+
+		if (!transfer && !engine->active && !engine->running) {
+			switch_mutex_unlock(engine->mutex);
+			break;
+		}
+		switch_mutex_unlock(engine->mutex);
+
+		for (; transfer; transfer = next) {
+			next = transfer->next;
+			transfer->next = NULL;
+
+			if (curl_multi_add_handle(engine->multi, transfer->curl_handle) == CURLM_OK) {
+				switch_mutex_lock(engine->mutex);
+				engine->active++;
+				switch_mutex_unlock(engine->mutex);
+			} else {
+				httapi_transfer_done(transfer, CURLE_FAILED_INIT);
+			}
+		}
+
+		curl_multi_perform(engine->multi, &still_running);
+
+		while ((msg = curl_multi_info_read(engine->multi, &msgs_left))) {
+			CURL *easy = msg->easy_handle;
+			CURLcode result = msg->data.result;
+			char *priv = NULL;
+
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+
+			curl_easy_getinfo(easy, CURLINFO_PRIVATE, &priv);
+			curl_multi_remove_handle(engine->multi, easy);
+			switch_mutex_lock(engine->mutex);
+			engine->active--;
+			switch_mutex_unlock(engine->mutex);
+
+			if (priv) {
+				httapi_transfer_done((httapi_transfer_t *) priv, result);
+			}
+		}
+
+#ifdef HTTAPI_HAVE_MULTI_POLL
+		curl_multi_poll(engine->multi, NULL, 0, 1000, NULL);
+#else
+		/* no curl_multi_wakeup() to interrupt the wait, keep it short so new requests are not held up */
+		curl_multi_wait(engine->multi, NULL, 0, 10, NULL);
+#endif
+	}
+
+	return NULL;
+}
+
+static switch_status_t httapi_engine_start(client_profile_t *profile)
+{
+	httapi_engine_t *engine = &profile->engine;
+	switch_threadattr_t *thd_attr = NULL;
+
+	if (!(engine->multi = curl_multi_init())) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Profile [%s] cannot create the curl multi handle\n", profile->name);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* idle connections the engine keeps open to reuse for the next request */
+	curl_multi_setopt(engine->multi, CURLMOPT_MAXCONNECTS, (long) profile->max_connections);
+
+	switch_mutex_init(&engine->mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	engine->running = 1;
+
+	switch_threadattr_create(&thd_attr, globals.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&engine->thread, thd_attr, httapi_engine_thread, profile, globals.pool);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void httapi_engine_stop(client_profile_t *profile)
+{
+	httapi_engine_t *engine = &profile->engine;
+	switch_status_t st;
+
+	if (!engine->thread) {
+		return;
+	}
+
+	switch_mutex_lock(engine->mutex);
+	engine->running = 0;
+	switch_mutex_unlock(engine->mutex);
+
+#ifdef HTTAPI_HAVE_MULTI_POLL
+	curl_multi_wakeup(engine->multi);
+#endif
+
+	switch_thread_join(&st, engine->thread);
+	engine->thread = NULL;
+
+	curl_multi_cleanup(engine->multi);
+	engine->multi = NULL;
+}
+
+/* hand the request to the profile's engine so it shares the profile's connections. The caller still waits for the
+   result, reading media meanwhile when it is on the session thread so the channel's read buffers don't back up. */
+static CURLcode httapi_engine_perform(client_t *client, switch_CURL *curl_handle)
+{
+	httapi_engine_t *engine = &client->profile->engine;
+	httapi_transfer_t *transfer = &client->transfer;
+	int read_media = client->session && switch_core_session_in_thread(client->session);
+
+	transfer->curl_handle = curl_handle;
+	transfer->result = CURLE_OK;
+	transfer->done = 0;
+	switch_curl_easy_setopt(curl_handle, CURLOPT_PRIVATE, (void *) transfer);
+
+	switch_mutex_lock(engine->mutex);
+	if (!engine->running) {
+		switch_mutex_unlock(engine->mutex);
+		return (CURLcode) switch_curl_easy_perform(curl_handle);
+	}
+	transfer->next = engine->pending;
+	engine->pending = transfer;
+	switch_mutex_unlock(engine->mutex);
+
+#ifdef HTTAPI_HAVE_MULTI_POLL
+	curl_multi_wakeup(engine->multi);
+#endif
+
+	switch_mutex_lock(transfer->mutex);
+	while (!transfer->done) {
+		if (read_media && switch_channel_ready(client->channel) && switch_channel_media_ready(client->channel)) {
+			switch_frame_t *read_frame;
+			switch_status_t status;
+
+			switch_mutex_unlock(transfer->mutex);
+			status = switch_core_session_read_frame(client->session, &read_frame, SWITCH_IO_FLAG_NONE, 0);
+			switch_mutex_lock(transfer->mutex);
+
+			if (SWITCH_READ_ACCEPTABLE(status)) {
+				continue;
+			}
+
+			read_media = 0;
+		}
+
+		switch_thread_cond_timedwait(transfer->cond, transfer->mutex, 20000);
+	}
+	switch_mutex_unlock(transfer->mutex);
+
+	return transfer->result;
+}
+
+static void httapi_stats_add(client_profile_t *profile, switch_CURL *curl_handle, CURLcode result, switch_time_t started)
+{
+	uint32_t ms = (uint32_t) ((switch_micro_time_now() - started) / 1000);
+	long connects = 0;
+	int i;
+
+	switch_curl_easy_getinfo(curl_handle, CURLINFO_NUM_CONNECTS, &connects);
+
+	for (i = 0; i < HTTAPI_LATENCY_BUCKETS - 1 && ms > httapi_latency_limits[i]; i++);
+
+	switch_mutex_lock(profile->stats.mutex);
+	profile->stats.requests++;
+	if (result != CURLE_OK) {
+		profile->stats.errors++;
+	}
+	profile->stats.new_connections += connects;
+	profile->stats.total_ms += ms;
+	if (ms > profile->stats.max_ms) {
+		profile->stats.max_ms = ms;
+	}
+	profile->stats.buckets[i]++;
+	switch_mutex_unlock(profile->stats.mutex);
+}
+
+static long httapi_perform(client_t *client, switch_CURL *curl_handle)
+{
+	switch_time_t started = switch_micro_time_now();
+	CURLcode result;
+	long code = 0;
+
+	if (client->profile->use_engine) {
+		result = httapi_engine_perform(client, curl_handle);
+	} else {
+		result = (CURLcode) switch_curl_easy_perform(curl_handle);
+	}
+
+	httapi_stats_add(client->profile, curl_handle, result, started);
+	switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &code);
+
+	return code;
+}
+
+/* latency below which the given share of the requests completed, by bucket upper bound */
+static uint32_t httapi_stats_percentile(uint64_t *buckets, uint64_t requests, int pct)
+{
+	uint64_t want = (requests * pct + 99) / 100, seen = 0;
+	int i;
+
+	for (i = 0; i < HTTAPI_LATENCY_BUCKETS - 1; i++) {
+		seen += buckets[i];
+		if (seen >= want) {
+			return httapi_latency_limits[i];
+		}
+	}
+
+	return 0;
+}
+
+static void httapi_stats_print(client_profile_t *profile, switch_stream_handle_t *stream)
+{
+	uint64_t buckets[HTTAPI_LATENCY_BUCKETS];
+	uint64_t requests, errors, new_connections, total_ms;
+	uint32_t max_ms, lower = 0;
+	int i, active = 0;
+
+	if (profile->use_engine) {
+		switch_mutex_lock(profile->engine.mutex);
+		active = profile->engine.active;
+		switch_mutex_unlock(profile->engine.mutex);
+	}
+
+	switch_mutex_lock(profile->stats.mutex);
+	memcpy(buckets, profile->stats.buckets, sizeof(buckets));
+	requests = profile->stats.requests;
+	errors = profile->stats.errors;
+	new_connections = profile->stats.new_connections;
+	total_ms = profile->stats.total_ms;
+	max_ms = profile->stats.max_ms;
+	switch_mutex_unlock(profile->stats.mutex);
+
+	stream->write_function(stream, "Profile %s (%s, max-connections %u)\n", profile->name,
+						   profile->use_engine ? "engine" : "blocking", profile->max_connections);
+	stream->write_function(stream, "  requests %" SWITCH_UINT64_T_FMT " errors %" SWITCH_UINT64_T_FMT
+						   " new connections %" SWITCH_UINT64_T_FMT " in flight %d\n",
+						   requests, errors, new_connections, active);
+
+	if (!requests) {
+		return;
+	}
+
+	stream->write_function(stream, "  latency avg %" SWITCH_UINT64_T_FMT "ms max %ums", total_ms / requests, max_ms);
+
+	if (httapi_stats_percentile(buckets, requests, 50)) {
+		stream->write_function(stream, " p50 <=%ums", httapi_stats_percentile(buckets, requests, 50));
+	}
+	if (httapi_stats_percentile(buckets, requests, 90)) {
+		stream->write_function(stream, " p90 <=%ums", httapi_stats_percentile(buckets, requests, 90));
+	}
+	if (httapi_stats_percentile(buckets, requests, 99)) {
+		stream->write_function(stream, " p99 <=%ums", httapi_stats_percentile(buckets, requests, 99));
+	}
+	stream->write_function(stream, "\n");
+
+	for (i = 0; i < HTTAPI_LATENCY_BUCKETS; i++) {
+		if (i < HTTAPI_LATENCY_BUCKETS - 1) {
+			stream->write_function(stream, "  %5u-%-5ums %" SWITCH_UINT64_T_FMT "\n", lower, httapi_latency_limits[i], buckets[i]);
+			lower = httapi_latency_limits[i];
+		} else {
+			stream->write_function(stream, "  >%-10ums %" SWITCH_UINT64_T_FMT "\n", lower, buckets[i]);
+		}
+	}
+}
+
 size_t put_file_read( void *ptr, size_t size, size_t nmemb, void *userdata)
 {
 	return fread(ptr, size, nmemb, (FILE *) userdata);
@@ -1665,8 +2019,7 @@ static switch_status_t httapi_sync(client_t *client)
 	}
 
 
-	switch_curl_easy_perform(curl_handle);
-	switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &client->code);
+	client->code = httapi_perform(client, curl_handle);
 	switch_curl_easy_cleanup(curl_handle);
 	switch_curl_slist_free_all(headers);
 
@@ -1773,6 +2126,8 @@ static switch_status_t do_config(void)
 		uint32_t enable_ssl_verifyhost = 0;
 		char *cookie_file = NULL;
 		char *ua = "mod_httapi/1.0";
+		int use_engine = 1;
+		uint32_t max_connections = 16;
 		hash_node_t *hash_node;
 		long auth_scheme = CURLAUTH_BASIC;
 		need_vars_map = 0;
@@ -1869,6 +2224,15 @@ static switch_status_t do_config(void)
 					}
 				} else if (!strcasecmp(var, "bind-local")) {
 					bind_local = val;
+				} else if (!strcasecmp(var, "use-engine")) {
+					use_engine = switch_true(val);
+				} else if (!strcasecmp(var, "max-connections")) {
+					int tmp = atoi(val);
+					if (tmp >= 0) {
+						max_connections = tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't set a negative max-connections!\n");
+					}
 				}
 			}
 		}
@@ -2172,6 +2536,12 @@ static switch_status_t do_config(void)
 						  zstr(bname) ? "N/A" : bname, profile->url);
 
 		profile->name = switch_core_strdup(globals.pool, bname);
+		profile->max_connections = max_connections;
+		switch_mutex_init(&profile->stats.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+
+		if (use_engine && httapi_engine_start(profile) == SWITCH_STATUS_SUCCESS) {
+			profile->use_engine = 1;
+		}
 
 		if (!globals.profile) globals.profile = profile;
 
@@ -2642,8 +3012,7 @@ static switch_status_t fetch_cache_data(http_file_context_t *context, const char
 	}
 
 	switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, ua);
-	switch_curl_easy_perform(curl_handle);
-	switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &code);
+	code = httapi_perform(client, curl_handle);
 	switch_curl_easy_cleanup(curl_handle);
 
 	if (client->fd > -1) {
@@ -3261,6 +3630,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_httapi_load)
 
 	switch_console_set_complete("add httapi debug_on");
 	switch_console_set_complete("add httapi debug_off");
+	switch_console_set_complete("add httapi stats");
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
@@ -3277,6 +3647,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_httapi_shutdown)
 	for (hi = switch_core_hash_first(globals.profile_hash); hi; hi = switch_core_hash_next(&hi)) {
 		switch_core_hash_this(hi, &vvar, NULL, &val);
 		profile = (client_profile_t *) val;
+		httapi_engine_stop(profile);
 		switch_event_destroy(&profile->dial_params.app_list);
 		switch_event_destroy(&profile->var_params.expand_var_list);
 		switch_event_destroy(&profile->var_params.set_var_list);
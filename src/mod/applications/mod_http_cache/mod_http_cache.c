@@ -92,11 +92,16 @@ SWITCH_STANDARD_API(http_cache_tryget);
 SWITCH_STANDARD_API(http_cache_clear);
 SWITCH_STANDARD_API(http_cache_remove);
 SWITCH_STANDARD_API(http_cache_prefetch);
+SWITCH_STANDARD_API(http_cache_status);
 
 #define DOWNLOAD_NEEDED "download"
 #define DOWNLOAD 1
 #define PREFETCH 2
 #define MAX_FILE_EXTENSION_SIZE 32
+/** number of locks shared by the cached URLs */
+#define URL_LOCK_STRIPES 64
+/** cache hit latency histogram, 8 buckets per power of two microseconds */
+#define HIT_LATENCY_BUCKETS 256
 
 typedef struct url_cache url_cache_t;
 
@@ -135,8 +140,8 @@ struct cached_url {
 	const char *content_type_params;
 	/** The size of the cached URL, in bytes */
 	size_t size;
-	/** URL use flag */
-	int used;
+	/** URL use flag, set by hits holding only the cache read lock */
+	switch_atomic_t used;
 	/** Status of this entry */
 	cached_url_status_t status;
 	/** Number of sessions waiting for this URL */
@@ -145,6 +150,10 @@ struct cached_url {
 	switch_time_t download_time;
 	/** nanoseconds until stale */
 	switch_time_t max_age;
+	/** index of the lock guarding status, size and filename while downloading */
+	int lock_idx;
+	/** True if the file is in the hot tier */
+	int hot;
 };
 typedef struct cached_url cached_url_t;
 
@@ -155,6 +164,8 @@ static void cached_url_destroy(cached_url_t *url, switch_memory_pool_t *pool);
  * Data for write_file_callback()
  */
 struct http_get_data {
+	/** The cache */
+	url_cache_t *cache;
 	/** File descriptor for the cached URL */
 	int fd;
 	/** The cached URL data */
@@ -211,8 +222,19 @@ struct url_cache {
 	switch_hash_t *map;
 	/** Cached URLs queued for replacement */
 	simple_queue_t queue;
-	/** Synchronizes access to cache */
-	switch_mutex_t *mutex;
+	/** Synchronizes access to cache, hits only need it shared */
+	switch_thread_rwlock_t *rwlock;
+	/** Per URL locks, signalled as downloads progress */
+	switch_mutex_t *url_mutex[URL_LOCK_STRIPES];
+	switch_thread_cond_t *url_cond[URL_LOCK_STRIPES];
+	/** Synchronizes the hit statistics */
+	switch_mutex_t *stats_mutex;
+	/** Cache hit latency histogram */
+	uint64_t hit_latency[HIT_LATENCY_BUCKETS];
+	/** Slowest cache hit, in microseconds */
+	switch_time_t hit_latency_max;
+	/** Number of playbacks started before their download completed */
+	int streams;
 	/** Memory pool */
 	switch_memory_pool_t *pool;
 	/** Number of cache hits */
@@ -247,6 +269,18 @@ struct url_cache {
 	long max_retry;
 	/** Maximum retries delay in ms **/
 	long retry_delay_ms;
+	/** Bytes needed before playback starts on a file still downloading, 0 waits for the whole file */
+	size_t stream_start_bytes;
+	/** Location of the hot tier, a memory backed directory */
+	char *hot_location;
+	/** Maximum size of the hot tier, in bytes.  0 disables it */
+	size_t hot_max_size;
+	/** Largest file kept in the hot tier */
+	size_t hot_max_file_size;
+	/** Current size of the hot tier, in bytes */
+	size_t hot_size;
+	/** Number of files in the hot tier */
+	int hot_files;
 };
 static url_cache_t gcache;
 
@@ -258,6 +292,7 @@ static switch_status_t url_cache_replace(url_cache_t *cache, switch_core_session
 static void url_cache_lock(url_cache_t *cache, switch_core_session_t *session);
 static void url_cache_unlock(url_cache_t *cache, switch_core_session_t *session);
 static void url_cache_clear(url_cache_t *cache, switch_core_session_t *session);
+static switch_status_t url_cache_download(url_cache_t *cache, http_profile_t *profile, switch_core_session_t *session, cached_url_t *u, int use_mime_ext, switch_event_t *event, switch_memory_pool_t *pool, char **filename);
 static http_profile_t *url_cache_http_profile_find(url_cache_t *cache, const char *name);
 static http_profile_t *url_cache_http_profile_find_by_fqdn(url_cache_t *cache, const char *url);
 
@@ -486,6 +521,35 @@ static switch_status_t http_put(url_cache_t *cache, http_profile_t *profile, swi
 	return status;
 }
 
+/**
+ * Lock the state of a cached URL
+ */
+static void url_lock(url_cache_t *cache, cached_url_t *url)
+{
+	switch_mutex_lock(cache->url_mutex[url->lock_idx]);
+}
+
+static void url_unlock(url_cache_t *cache, cached_url_t *url)
+{
+	switch_mutex_unlock(cache->url_mutex[url->lock_idx]);
+}
+
+/**
+ * Wake up everyone waiting on a cached URL.  The caller must lock the URL.
+ */
+static void url_signal(url_cache_t *cache, cached_url_t *url)
+{
+	switch_thread_cond_broadcast(cache->url_cond[url->lock_idx]);
+}
+
+/**
+ * Wait up to timeout_us for a cached URL to change.  The caller must lock the URL.
+ */
+static void url_wait(url_cache_t *cache, cached_url_t *url, switch_interval_time_t timeout_us)
+{
+	switch_thread_cond_timedwait(cache->url_cond[url->lock_idx], cache->url_mutex[url->lock_idx], timeout_us);
+}
+
 /**
  * Called by libcurl to write result of HTTP GET to a file
  * @param ptr The data to write
@@ -506,7 +570,11 @@ static size_t get_file_callback(void *ptr, size_t size, size_t nmemb, void *get)
 		if (bytes_written != realsize) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "write(): short write!\n");
 		}
+		/* let playback of this URL catch up */
+		url_lock(get_data->cache, get_data->url);
 		get_data->url->size += bytes_written;
+		url_signal(get_data->cache, get_data->url);
+		url_unlock(get_data->cache, get_data->url);
 		result = bytes_written;
 	}
 
@@ -665,7 +733,7 @@ static size_t get_header_callback(void *ptr, size_t size, size_t nmemb, void *ge
  */
 static void url_cache_lock(url_cache_t *cache, switch_core_session_t *session)
 {
-	switch_mutex_lock(cache->mutex);
+	switch_thread_rwlock_wrlock(cache->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Locked cache\n");
 }
 
@@ -676,42 +744,248 @@ static void url_cache_lock(url_cache_t *cache, switch_core_session_t *session)
  */
 static void url_cache_unlock(url_cache_t *cache, switch_core_session_t *session)
 {
-	switch_mutex_unlock(cache->mutex);
+	switch_thread_rwlock_unlock(cache->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Unlocked cache\n");
 }
 
 /**
- * Empties the cache
+ * Empties the cache.  URLs still downloading or being played stay until shutdown.
  */
 static void url_cache_clear(url_cache_t *cache, switch_core_session_t *session)
 {
 	int i;
+	size_t kept = 0;
 
 	url_cache_lock(cache, session);
 
+	cache->size = 0;
+	cache->hot_size = 0;
+	cache->hot_files = 0;
+
 	// remove each cached URL from the hash and the queue
 	for (i = 0; i < cache->queue.max_size; i++) {
 		cached_url_t *url = cache->queue.data[i];
 		if (url) {
-			switch_core_hash_delete(cache->map, url->url);
-			cached_url_destroy(url, cache->pool);
 			cache->queue.data[i] = NULL;
+			if (!cache->shutdown && (url->waiters || url->status == CACHED_URL_RX_IN_PROGRESS)) {
+				cache->queue.data[kept++] = url;
+				if (url->status == CACHED_URL_AVAILABLE) {
+					cache->size += url->size;
+				}
+				if (url->hot) {
+					cache->hot_size += url->size;
+					cache->hot_files++;
+				}
+				continue;
+			}
+			if (url->status != CACHED_URL_REMOVE) {
+				switch_core_hash_delete(cache->map, url->url);
+			}
+			cached_url_destroy(url, cache->pool);
 		}
 	}
-	cache->queue.pos = 0;
-	cache->queue.size = 0;
+	cache->queue.pos = kept % cache->queue.max_size;
+	cache->queue.size = kept;
 
 	// reset cache stats
-	cache->size = 0;
-	cache->hits = 0;
 	cache->misses = 0;
 	cache->errors = 0;
+	cache->streams = 0;
+
+	switch_mutex_lock(cache->stats_mutex);
+	cache->hits = 0;
+	memset(cache->hit_latency, 0, sizeof(cache->hit_latency));
+	cache->hit_latency_max = 0;
+	switch_mutex_unlock(cache->stats_mutex);
 
 	url_cache_unlock(cache, session);
 
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Emptied cache\n");
 }
 
+/**
+ * Map a latency to its histogram bucket
+ */
+static int hit_latency_bucket(switch_time_t us)
+{
+	int msb = 0, bucket;
+
+	if (us < 8) {
+		return us < 0 ? 0 : (int)us;
+	}
+
+	while ((us >> msb) > 1) {
+		msb++;
+	}
+
+	bucket = (msb - 2) * 8 + (int)((us >> (msb - 3)) & 7);
+
+	return bucket < HIT_LATENCY_BUCKETS ? bucket : HIT_LATENCY_BUCKETS - 1;
+}
+
+/**
+ * Smallest latency in a histogram bucket
+ */
+static switch_time_t hit_latency_bucket_floor(int bucket)
+{
+	if (bucket < 8) {
+		return bucket;
+	}
+
+	return (switch_time_t)(8 + bucket % 8) << (bucket / 8 - 1);
+}
+
+/**
+ * Latency below which percentile of the cache hits were served.  The caller must lock the stats.
+ */
+static switch_time_t hit_latency_percentile(url_cache_t *cache, double percentile)
+{
+	uint64_t total = 0, target, seen = 0;
+	int i;
+
+	for (i = 0; i < HIT_LATENCY_BUCKETS; i++) {
+		total += cache->hit_latency[i];
+	}
+
+	if (!total) {
+		return 0;
+	}
+
+	target = (uint64_t)(total * percentile / 100.0);
+	if (target < 1) {
+		target = 1;
+	}
+
+	for (i = 0; i < HIT_LATENCY_BUCKETS - 1; i++) {
+		seen += cache->hit_latency[i];
+		if (seen >= target) {
+			/* report the top of the bucket */
+			return hit_latency_bucket_floor(i + 1) - 1;
+		}
+	}
+
+	return cache->hit_latency_max;
+}
+
+/**
+ * Count a cache hit that took since start
+ */
+static void url_cache_hit(url_cache_t *cache, switch_core_session_t *session, const char *url, switch_time_t start)
+{
+	switch_time_t elapsed = switch_time_now() - start;
+	int hits;
+
+	switch_mutex_lock(cache->stats_mutex);
+	hits = ++cache->hits;
+	cache->hit_latency[hit_latency_bucket(elapsed)]++;
+	if (elapsed > cache->hit_latency_max) {
+		cache->hit_latency_max = elapsed;
+	}
+	switch_mutex_unlock(cache->stats_mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "%s: Cache HIT: size = %zu (%zu MB), hit ratio = %d/%d\n", url, cache->queue.size, cache->size / 1000000, hits, hits + cache->misses);
+}
+
+/**
+ * Move a small downloaded file to the hot tier.  Called before the URL is made available.
+ */
+static void url_cache_hot_promote(url_cache_t *cache, switch_core_session_t *session, cached_url_t *u)
+{
+	const char *name;
+	char *hot_filename, *old_filename;
+	int fits;
+
+	if (!cache->hot_max_size || !u->size || u->size > cache->hot_max_file_size) {
+		return;
+	}
+
+	/* reserve room, files already opened for playback stay where they are */
+	url_cache_lock(cache, session);
+	if ((fits = !u->waiters && cache->hot_size + u->size <= cache->hot_max_size)) {
+		cache->hot_size += u->size;
+		cache->hot_files++;
+	}
+	url_cache_unlock(cache, session);
+
+	if (!fits) {
+		return;
+	}
+
+	name = strrchr(u->filename, *SWITCH_PATH_SEPARATOR);
+	hot_filename = switch_mprintf("%s%s", cache->hot_location, name ? name : u->filename);
+
+	if (switch_file_copy(u->filename, hot_filename, SWITCH_FPROT_FILE_SOURCE_PERMS, cache->pool) == SWITCH_STATUS_SUCCESS) {
+		url_lock(cache, u);
+		old_filename = u->filename;
+		u->filename = hot_filename;
+		u->hot = 1;
+		url_unlock(cache, u);
+
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "%s: moved to hot tier as %s\n", u->url, hot_filename);
+		switch_file_remove(old_filename, cache->pool);
+		free(old_filename);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "%s: failed to copy %s to hot tier\n", u->url, u->filename);
+		free(hot_filename);
+		url_cache_lock(cache, session);
+		cache->hot_size -= u->size;
+		cache->hot_files--;
+		url_cache_unlock(cache, session);
+	}
+}
+
+/**
+ * Download a URL entry added to the cache and let its waiters know how it went
+ * @param cache the cache
+ * @param profile optional profile
+ * @param session the (optional) session
+ * @param u the URL entry, must be CACHED_URL_RX_IN_PROGRESS
+ * @param use_mime_ext If true, use extension based on content type
+ * @param event optional event to fill with the transfer details
+ * @param pool optional pool for filename
+ * @param filename if set, the cached filename on success
+ * @return SWITCH_STATUS_SUCCESS if downloaded
+ */
+static switch_status_t url_cache_download(url_cache_t *cache, http_profile_t *profile, switch_core_session_t *session, cached_url_t *u, int use_mime_ext, switch_event_t *event, switch_memory_pool_t *pool, char **filename)
+{
+	unsigned int timestamp = switch_time_now() / 1000;
+	switch_status_t status = http_get(cache, profile, u, use_mime_ext, event, session);
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		unsigned int duration = (switch_time_now() / 1000) - timestamp;
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Download duration: %u\n", duration);
+		prometheus_increment_download_duration(duration);
+
+		url_cache_hot_promote(cache, session, u);
+
+		/* Got the file, let the waiters know it is available */
+		url_cache_lock(cache, session);
+		url_lock(cache, u);
+		u->status = CACHED_URL_AVAILABLE;
+		if (filename) {
+			*filename = switch_core_strdup(pool, u->filename);
+		}
+		url_signal(cache, u);
+		url_unlock(cache, u);
+		cache->size += u->size;
+		url_cache_unlock(cache, session);
+	} else {
+		prometheus_increment_download_fail_count();
+
+		/* Did not get the file, flag for replacement */
+		url_cache_lock(cache, session);
+		url_lock(cache, u);
+		url_cache_remove_soft(cache, session, u);
+		url_signal(cache, u);
+		url_unlock(cache, u);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Failed to download URL %s\n", u->url);
+		cache->errors++;
+		url_cache_unlock(cache, session);
+	}
+
+	return status;
+}
+
 /**
  * Get a URL from the cache, add it if it does not exist
  * @param cache The cache
@@ -729,12 +1003,30 @@ static void url_cache_clear(url_cache_t *cache, switch_core_session_t *session)
 static char *url_cache_get(url_cache_t *cache, http_profile_t *profile, switch_core_session_t *session, const char *url, int download, int refresh, const char *extension, int validate_url_extension, int use_mime_ext, switch_event_t *event, switch_memory_pool_t *pool)
 {
 	switch_time_t download_timeout_ns = cache->download_timeout * 1000 * 1000;
+	switch_time_t start = switch_time_now();
 	char *filename = NULL;
 	cached_url_t *u = NULL;
 	if (zstr(url)) {
 		return NULL;
 	}
 
+	/* fast path, hits only need to share the cache */
+	if (!refresh) {
+		switch_thread_rwlock_rdlock(cache->rwlock);
+		u = switch_core_hash_find(cache->map, url);
+		if (u && u->status == CACHED_URL_AVAILABLE && start < (u->download_time + u->max_age) &&
+			switch_file_exists(u->filename, pool) == SWITCH_STATUS_SUCCESS) {
+			filename = switch_core_strdup(pool, u->filename);
+			switch_atomic_set(&u->used, 1);
+		}
+		switch_thread_rwlock_unlock(cache->rwlock);
+
+		if (filename) {
+			url_cache_hit(cache, session, url, start);
+			return filename;
+		}
+	}
+
 	url_cache_lock(cache, session);
 	u = switch_core_hash_find(cache->map, url);
 
@@ -758,8 +1050,6 @@ static char *url_cache_get(url_cache_t *cache, http_profile_t *profile, switch_c
 	}
 
 	if (!u && download) {
-		unsigned int timestamp;
-
 		/* URL is not cached, let's add it.*/
 		/* Set up URL entry and add to map to prevent simultaneous downloads */
 		cache->misses++;
@@ -775,26 +1065,8 @@ static char *url_cache_get(url_cache_t *cache, http_profile_t *profile, switch_c
 
 		/* download the file */
 		url_cache_unlock(cache, session);
-		timestamp = switch_time_now() / 1000;
-		if (http_get(cache, profile, u, use_mime_ext, event, session) == SWITCH_STATUS_SUCCESS) {
-			unsigned int duration = (switch_time_now() / 1000) - timestamp;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Download duration: %u\n", duration);
-			prometheus_increment_download_duration(duration);
-
-			/* Got the file, let the waiters know it is available */
-			url_cache_lock(cache, session);
-			u->status = CACHED_URL_AVAILABLE;
-			filename = switch_core_strdup(pool, u->filename);
-			cache->size += u->size;
-		} else {
-			prometheus_increment_download_fail_count();
-
-			/* Did not get the file, flag for replacement */
-			url_cache_lock(cache, session);
-			url_cache_remove_soft(cache, session, u);
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Failed to download URL %s\n", url);
-			cache->errors++;
-		}
+		url_cache_download(cache, profile, session, u, use_mime_ext, event, pool, &filename);
+		return filename;
 	} else if (!u || (u->status == CACHED_URL_RX_IN_PROGRESS && download != DOWNLOAD)) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Download URL %s is needed\n", url);
 		filename = DOWNLOAD_NEEDED;
@@ -804,9 +1076,11 @@ static char *url_cache_get(url_cache_t *cache, http_profile_t *profile, switch_c
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Waiting for URL %s to be available\n", url);
 			u->waiters++;
 			url_cache_unlock(cache, session);
+			url_lock(cache, u);
 			while(!gcache.shutdown && u->status == CACHED_URL_RX_IN_PROGRESS && switch_time_now() < (u->download_time + download_timeout_ns)) {
-				switch_sleep(10 * 1000); /* 10 ms */
+				url_wait(cache, u, 100 * 1000);
 			}
+			url_unlock(cache, u);
 			url_cache_lock(cache, session);
 			u->waiters--;
 		}
@@ -814,9 +1088,8 @@ static char *url_cache_get(url_cache_t *cache, http_profile_t *profile, switch_c
 		/* grab filename if everything is OK */
 		if (u->status == CACHED_URL_AVAILABLE) {
 			filename = switch_core_strdup(pool, u->filename);
-			cache->hits++;
-			u->used = 1;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "%s: Cache HIT: size = %zu (%zu MB), hit ratio = %d/%d\n", url, cache->queue.size, cache->size / 1000000, cache->hits, cache->hits + cache->misses);
+			switch_atomic_set(&u->used, 1);
+			url_cache_hit(cache, session, url, start);
 		} else {
 			cache->misses++;
 			cache->errors++;
@@ -879,7 +1152,7 @@ static switch_status_t url_cache_replace(url_cache_t *cache, switch_core_session
 		}
 
 		/* check if available for replacement */
-		if (!to_replace->used && !to_replace->waiters) {
+		if (!switch_atomic_read(&to_replace->used) && !to_replace->waiters) {
 			/* remove from cache and destroy it */
 			url_cache_remove(cache, session, to_replace);
 			cached_url_destroy(to_replace, cache->pool);
@@ -889,7 +1162,7 @@ static switch_status_t url_cache_replace(url_cache_t *cache, switch_core_session
 
 		/* not available for replacement.  Mark as not used and move to back of queue */
 		if (to_replace->status == CACHED_URL_AVAILABLE) {
-			to_replace->used = 0;
+			switch_atomic_set(&to_replace->used, 0);
 		}
 		queue->pos = (queue->pos + 1) % queue->max_size;
 	}
@@ -903,7 +1176,7 @@ static switch_status_t url_cache_replace(url_cache_t *cache, switch_core_session
 static void url_cache_remove_soft(url_cache_t *cache, switch_core_session_t *session, cached_url_t *url)
 {
 	switch_core_hash_delete(cache->map, url->url);
-	url->used = 0;
+	switch_atomic_set(&url->used, 0);
 	url->status = CACHED_URL_REMOVE;
 }
 
@@ -933,6 +1206,10 @@ static void url_cache_remove(url_cache_t *cache, switch_core_session_t *session,
 
 	/* adjust cache statistics */
 	cache->size -= url->size;
+	if (url->hot) {
+		cache->hot_size -= url->size;
+		cache->hot_files--;
+	}
 }
 
 /**
@@ -1070,7 +1347,7 @@ static char *cached_url_filename_create(url_cache_t *cache, const char *url, con
  * Rename cached URL with filename extension if one can be determined
  * @param url the cached URL
  */
-static void cached_url_set_extension_from_content_type(cached_url_t *url, switch_core_session_t *session)
+static void cached_url_set_extension_from_content_type(url_cache_t *cache, cached_url_t *url, switch_core_session_t *session)
 {
 	if (url->content_type) {
 		const char *new_extension = switch_core_mime_type2ext(url->content_type);
@@ -1078,6 +1355,8 @@ static void cached_url_set_extension_from_content_type(cached_url_t *url, switch
 			char *new_filename = switch_mprintf("%s.%s", url->filename, new_extension);
 			if (rename(url->filename, new_filename) != -1) {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "renamed cached URL to %s\n", new_filename);
+				/* playback may already be reading it */
+				url_lock(cache, url);
 				free(url->filename);
 				if (url->extension) {
 					switch_safe_free(url->extension);
@@ -1085,6 +1364,7 @@ static void cached_url_set_extension_from_content_type(cached_url_t *url, switch
 
 				url->filename = new_filename;
 				url->extension = strdup(new_extension);
+				url_unlock(cache, url);
 			} else {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "rename(%s): %s\n", new_filename, strerror(errno));
 				free(new_filename);
@@ -1105,6 +1385,7 @@ static void cached_url_set_extension_from_content_type(cached_url_t *url, switch
 static cached_url_t *cached_url_create(url_cache_t *cache, const char *url, const char *filename, const char *extension, int validate_url_extension)
 {
 	cached_url_t *u = NULL;
+	switch_ssize_t klen;
 
 	if (zstr(url)) {
 		return NULL;
@@ -1124,11 +1405,13 @@ static cached_url_t *cached_url_create(url_cache_t *cache, const char *url, cons
 	}
 	u->url = switch_safe_strdup(url);
 	u->size = 0;
-	u->used = 1;
+	switch_atomic_set(&u->used, 1);
 	u->status = CACHED_URL_RX_IN_PROGRESS;
 	u->waiters = 0;
 	u->download_time = switch_time_now();
 	u->max_age = cache->default_max_age;
+	klen = strlen(url);
+	u->lock_idx = switch_ci_hashfunc_default(url, &klen) % URL_LOCK_STRIPES;
 
 	return u;
 }
@@ -1175,6 +1458,7 @@ static switch_status_t http_get(url_cache_t *cache, http_profile_t *profile, cac
 	char errbuf[CURL_ERROR_SIZE] = { 0 };
 
 	/* set up HTTP GET */
+	get_data.cache = cache;
 	get_data.fd = 0;
 	get_data.url = url;
 
@@ -1278,7 +1562,7 @@ static switch_status_t http_get(url_cache_t *cache, http_profile_t *profile, cac
 			, !zstr(local_ip) ? local_ip : "N/A", local_port
 			, !zstr(remote_ip) ? remote_ip : "N/A", remote_port);
 		if (use_mime_extension || !url->extension) {
-			cached_url_set_extension_from_content_type(url, session);
+			cached_url_set_extension_from_content_type(cache, url, session);
 		}
 	} else {
 		url->size = 0; // nothing downloaded or download interrupted
@@ -1345,6 +1629,28 @@ static void setup_dir(url_cache_t *cache)
 		}
 		switch_safe_free(dirname);
 	}
+
+	if (cache->hot_max_size) {
+		switch_dir_t *dir = NULL;
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "setting up hot tier %s\n", cache->hot_location);
+		switch_dir_make_recursive(cache->hot_location, SWITCH_DEFAULT_DIR_PERMS, cache->pool);
+
+		if (switch_dir_open(&dir, cache->hot_location, cache->pool) == SWITCH_STATUS_SUCCESS) {
+			char filenamebuf[256] = { 0 };
+			const char *filename = NULL;
+			for(filename = switch_dir_next_file(dir, filenamebuf, sizeof(filenamebuf)); filename;
+					filename = switch_dir_next_file(dir, filenamebuf, sizeof(filenamebuf))) {
+				char *path = switch_mprintf("%s%s%s", cache->hot_location, SWITCH_PATH_SEPARATOR, filename);
+				switch_file_remove(path, cache->pool);
+				switch_safe_free(path);
+			}
+			switch_dir_close(dir);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "hot tier %s is not usable, disabling it\n", cache->hot_location);
+			cache->hot_max_size = 0;
+		}
+	}
 }
 
 #define HTTP_PREFETCH_SYNTAX "{param=val}<url>"
@@ -1629,6 +1935,35 @@ SWITCH_STANDARD_API(http_cache_clear)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define HTTP_CACHE_STATUS_SYNTAX ""
+/**
+ * Cache statistics and hit latency
+ */
+SWITCH_STANDARD_API(http_cache_status)
+{
+	url_cache_t *cache = &gcache;
+
+	if (!zstr(cmd)) {
+		stream->write_function(stream, "USAGE: %s\n", HTTP_CACHE_STATUS_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_thread_rwlock_rdlock(cache->rwlock);
+	stream->write_function(stream, "urls: %zu/%d\nsize: %zu\nmisses: %d\nerrors: %d\nstreamed: %d\nhot tier: %d files, %zu/%zu bytes\n",
+						   cache->queue.size, cache->max_url, cache->size, cache->misses, cache->errors, cache->streams,
+						   cache->hot_files, cache->hot_size, cache->hot_max_size);
+	switch_thread_rwlock_unlock(cache->rwlock);
+
+	switch_mutex_lock(cache->stats_mutex);
+	stream->write_function(stream, "hits: %d\nhit latency (us): p50 %" SWITCH_TIME_T_FMT " p90 %" SWITCH_TIME_T_FMT " p99 %" SWITCH_TIME_T_FMT
+						   " p99.9 %" SWITCH_TIME_T_FMT " max %" SWITCH_TIME_T_FMT "\n", cache->hits,
+						   hit_latency_percentile(cache, 50), hit_latency_percentile(cache, 90), hit_latency_percentile(cache, 99),
+						   hit_latency_percentile(cache, 99.9), cache->hit_latency_max);
+	switch_mutex_unlock(cache->stats_mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 #define HTTP_CACHE_REMOVE_SYNTAX "<url>"
 /**
  * Invalidate a cached URL
@@ -1786,6 +2121,10 @@ static switch_status_t do_config(url_cache_t *cache)
 	cache->download_timeout = 300;
 	cache->max_retry = 1;
 	cache->retry_delay_ms = 100;
+	cache->stream_start_bytes = 0;
+	cache->hot_location = switch_core_sprintf(cache->pool, "/dev/shm%sfreeswitch_http_cache", SWITCH_PATH_SEPARATOR);
+	cache->hot_max_size = 0;
+	cache->hot_max_file_size = 512 * 1024;
 
 	/* get params */
 	settings = switch_xml_child(cfg, "settings");
@@ -1849,6 +2188,27 @@ static switch_status_t do_config(url_cache_t *cache)
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting retry-delay-ms to %s\n", val);
 					cache->retry_delay_ms = int_val;
 				}
+			} else if (!strcasecmp(var, "stream-start-bytes")) {
+				int int_val = atoi(val);
+				if (int_val >= 0) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting stream-start-bytes to %s\n", val);
+					cache->stream_start_bytes = int_val;
+				}
+			} else if (!strcasecmp(var, "hot-tier-location")) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting hot-tier-location to %s\n", val);
+				cache->hot_location = switch_core_strdup(cache->pool, val);
+			} else if (!strcasecmp(var, "hot-tier-size")) {
+				int int_val = atoi(val);
+				if (int_val >= 0) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting hot-tier-size to %s\n", val);
+					cache->hot_max_size = int_val;
+				}
+			} else if (!strcasecmp(var, "hot-tier-max-file-size")) {
+				int int_val = atoi(val);
+				if (int_val > 0) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting hot-tier-max-file-size to %s\n", val);
+					cache->hot_max_file_size = int_val;
+				}
 			} else {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unsupported param: %s\n", var);
 			}
@@ -1941,6 +2301,11 @@ static switch_status_t do_config(url_cache_t *cache)
 		status = SWITCH_STATUS_TERM;
 		goto done;
 	}
+	if (cache->hot_max_size && zstr(cache->hot_location)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "hot-tier-location must not be empty\n");
+		status = SWITCH_STATUS_TERM;
+		goto done;
+	}
 	if (cache->prefetch_thread_count <= 0) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "prefetch-thread-count must be > 0\n");
 		status = SWITCH_STATUS_TERM;
@@ -1955,6 +2320,133 @@ done:
 	return status;
 }
 
+/**
+ * Background download of a URL for streaming playback
+ */
+struct url_download {
+	url_cache_t *cache;
+	http_profile_t *profile;
+	cached_url_t *url;
+	int use_mime_ext;
+};
+
+static void *SWITCH_THREAD_FUNC url_download_thread(switch_thread_t *thread, void *obj)
+{
+	struct url_download *dl = obj;
+
+	switch_thread_rwlock_rdlock(dl->cache->shutdown_lock);
+	if (!dl->cache->shutdown) {
+		url_cache_download(dl->cache, dl->profile, NULL, dl->url, dl->use_mime_ext, NULL, NULL, NULL);
+	}
+	switch_thread_rwlock_unlock(dl->cache->shutdown_lock);
+
+	free(dl);
+
+	return NULL;
+}
+
+/**
+ * Get a URL for playback while it downloads.
+ * @return the URL entry, pinned until url_cache_release(), or NULL if it is not downloading
+ */
+static cached_url_t *url_cache_stream(url_cache_t *cache, http_profile_t *profile, const char *url, const char *extension, int validate_url_extension, int use_mime_ext)
+{
+	cached_url_t *u = NULL;
+	int download = 0;
+
+	if (zstr(url)) {
+		return NULL;
+	}
+
+	url_cache_lock(cache, NULL);
+	if ((u = switch_core_hash_find(cache->map, url))) {
+		if (u->status != CACHED_URL_RX_IN_PROGRESS) {
+			/* cached, or expired: the regular path deals with it */
+			url_cache_unlock(cache, NULL);
+			return NULL;
+		}
+	} else {
+		cache->misses++;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "%s: Cache MISS, streaming: size = %zu (%zu MB), hit ratio = %d/%d, error count = %d\n", url, cache->queue.size, cache->size / 1000000, cache->hits, cache->hits + cache->misses, cache->errors);
+		u = cached_url_create(cache, url, NULL, extension, validate_url_extension);
+		if (url_cache_add(cache, NULL, u) != SWITCH_STATUS_SUCCESS) {
+			url_cache_unlock(cache, NULL);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "%s: Failed to add URL to cache!\n", url);
+			cached_url_destroy(u, cache->pool);
+			return NULL;
+		}
+		download = 1;
+	}
+	u->waiters++;
+	cache->streams++;
+	url_cache_unlock(cache, NULL);
+
+	if (download) {
+		struct url_download *dl;
+		switch_thread_data_t *td;
+
+		switch_zmalloc(dl, sizeof(*dl));
+		dl->cache = cache;
+		dl->profile = profile;
+		dl->url = u;
+		dl->use_mime_ext = use_mime_ext;
+
+		switch_zmalloc(td, sizeof(*td));
+		td->func = url_download_thread;
+		td->obj = dl;
+		td->alloc = 1;
+
+		if (switch_thread_pool_launch_thread(&td) != SWITCH_STATUS_SUCCESS) {
+			/* download it here instead */
+			switch_safe_free(td);
+			switch_safe_free(dl);
+			url_cache_download(cache, profile, NULL, u, use_mime_ext, NULL, NULL, NULL);
+		}
+	}
+
+	return u;
+}
+
+/**
+ * Unpin a URL returned by url_cache_stream()
+ */
+static void url_cache_release(url_cache_t *cache, cached_url_t *u)
+{
+	url_cache_lock(cache, NULL);
+	u->waiters--;
+	url_cache_unlock(cache, NULL);
+}
+
+/**
+ * Wait until a downloading URL holds min_size bytes or the download is over
+ * @param cache the cache
+ * @param u the pinned URL
+ * @param min_size bytes wanted
+ * @param size the bytes downloaded so far
+ * @param filename the file they are in
+ * @param pool for filename
+ * @return CACHED_URL_RX_IN_PROGRESS if min_size bytes are there, CACHED_URL_AVAILABLE once complete, CACHED_URL_REMOVE if the download failed
+ */
+static cached_url_status_t cached_url_wait(url_cache_t *cache, cached_url_t *u, size_t min_size, size_t *size, char **filename, switch_memory_pool_t *pool)
+{
+	switch_time_t deadline = u->download_time + cache->download_timeout * 1000 * 1000;
+	cached_url_status_t status;
+
+	url_lock(cache, u);
+	while (!cache->shutdown && u->status == CACHED_URL_RX_IN_PROGRESS && u->size < min_size && switch_time_now() < deadline) {
+		url_wait(cache, u, 100 * 1000);
+	}
+	status = u->status;
+	if (status == CACHED_URL_RX_IN_PROGRESS && u->size < min_size) {
+		status = CACHED_URL_REMOVE;
+	}
+	*size = u->size;
+	*filename = switch_core_strdup(pool, u->filename);
+	url_unlock(cache, u);
+
+	return status;
+}
+
 /**
  * HTTP file playback state
  */
@@ -1963,8 +2455,100 @@ struct http_context {
 	http_profile_t *profile;
 	char *local_path;
 	const char *write_url;
+	/** URL still downloading while it plays */
+	cached_url_t *stream_url;
+	/** bytes of it the file was opened with */
+	size_t stream_size;
+	/** how it was opened, to reopen it as it grows */
+	int file_flags;
+	int channels;
+	int samplerate;
+	/** samples played, at the handle's rate */
+	int64_t samples_read;
 };
 
+/**
+ * Stop streaming, the playback goes on with the file as it is
+ */
+static void http_stream_release(struct http_context *context)
+{
+	if (context->stream_url) {
+		url_cache_release(&gcache, context->stream_url);
+		context->stream_url = NULL;
+	}
+}
+
+/**
+ * Wait for the first bytes of a streamed URL
+ * @return the partial file to open, or NULL to wait for the complete file
+ */
+static char *http_stream_start(struct http_context *context, switch_memory_pool_t *pool)
+{
+	char *filename = NULL;
+
+	if (cached_url_wait(&gcache, context->stream_url, gcache.stream_start_bytes, &context->stream_size, &filename, pool) == CACHED_URL_RX_IN_PROGRESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s: starting playback after %zu bytes\n", context->stream_url->url, context->stream_size);
+		return filename;
+	}
+
+	http_stream_release(context);
+
+	return NULL;
+}
+
+/**
+ * Playback caught up with the download.  Wait for more and reopen the file where it was.
+ * @return SWITCH_STATUS_SUCCESS if there is more to play
+ */
+static switch_status_t http_stream_reopen(switch_file_handle_t *handle, struct http_context *context)
+{
+	cached_url_status_t status;
+	size_t size = 0;
+	char *filename = NULL;
+	unsigned int pos = 0;
+	int64_t target;
+
+	status = cached_url_wait(&gcache, context->stream_url, context->stream_size + gcache.stream_start_bytes, &size, &filename, handle->memory_pool);
+
+	if (status != CACHED_URL_AVAILABLE) {
+		if (status != CACHED_URL_RX_IN_PROGRESS || size <= context->stream_size) {
+			/* download failed or stalled, this is the end */
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s: download stopped after %zu bytes\n", context->stream_url->url, size);
+			http_stream_release(context);
+			return SWITCH_STATUS_FALSE;
+		}
+	} else {
+		http_stream_release(context);
+	}
+
+	switch_core_file_close(&context->fh);
+	memset(&context->fh, 0, sizeof(context->fh));
+	context->fh.pre_buffer_datalen = handle->pre_buffer_datalen;
+
+	if (switch_core_file_open(&context->fh, filename, context->channels, context->samplerate, context->file_flags, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to reopen HTTP cache file: %s\n", filename);
+		http_stream_release(context);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	context->local_path = filename;
+	context->stream_size = size;
+	handle->samples = context->fh.samples;
+
+	target = context->samples_read;
+	if (context->fh.native_rate && context->fh.samplerate && context->fh.native_rate != context->fh.samplerate) {
+		target = target * context->fh.native_rate / context->fh.samplerate;
+	}
+
+	if (target && switch_core_file_seek(&context->fh, &pos, target, SEEK_SET) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to resume HTTP cache file %s at %" SWITCH_INT64_T_FMT "\n", filename, target);
+		http_stream_release(context);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /**
  * Open URL
  * @param handle
@@ -2008,18 +2592,45 @@ static switch_status_t http_cache_file_open(switch_file_handle_t *handle, const
 	} else {
 		/* READ = HTTP GET */
 		file_flags |= SWITCH_FILE_FLAG_READ;
-		context->local_path = url_cache_get(&gcache, context->profile, NULL, path, 1, refresh, extension, validate_url_extension, use_mime_ext, handle->event, handle->memory_pool);
+
+		/* start playing while the file downloads if it isn't cached yet */
+		if (gcache.stream_start_bytes && !refresh && !(file_flags & SWITCH_FILE_FLAG_VIDEO) &&
+			(context->stream_url = url_cache_stream(&gcache, context->profile, path, extension, validate_url_extension, use_mime_ext))) {
+			context->local_path = http_stream_start(context, handle->memory_pool);
+		}
+
+		if (!context->local_path) {
+			context->local_path = url_cache_get(&gcache, context->profile, NULL, path, 1, refresh, extension, validate_url_extension, use_mime_ext, handle->event, handle->memory_pool);
+		}
 		if (!context->local_path) {
 			return SWITCH_STATUS_FALSE;
 		}
 	}
 
+	context->file_flags = file_flags;
+	context->channels = handle->channels;
+	context->samplerate = handle->samplerate;
+
+  open:
 	context->fh.pre_buffer_datalen = handle->pre_buffer_datalen;
 	if ((status = switch_core_file_open(&context->fh,
 			context->local_path,
 			handle->channels,
 			handle->samplerate,
-			file_flags, NULL)) != SWITCH_STATUS_SUCCESS) {
+			file_flags, NULL)) != SWITCH_STATUS_SUCCESS || (context->stream_url && !context->fh.seekable)) {
+			if (context->stream_url) {
+				/* can't be read before it's complete, play it once it is */
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Can't stream %s, waiting for the download\n", path);
+				if (status == SWITCH_STATUS_SUCCESS) {
+					switch_core_file_close(&context->fh);
+				}
+				memset(&context->fh, 0, sizeof(context->fh));
+				http_stream_release(context);
+				if ((context->local_path = url_cache_get(&gcache, context->profile, NULL, path, 1, SWITCH_FALSE, extension, validate_url_extension, use_mime_ext, handle->event, handle->memory_pool))) {
+					goto open;
+				}
+				return SWITCH_STATUS_FALSE;
+			}
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to open HTTP cache file: %s, %s\n", context->local_path, path);
 			if (switch_test_flag(handle, SWITCH_FILE_FLAG_WRITE)) {
 				switch_safe_free(context->local_path);
@@ -2086,7 +2697,23 @@ static switch_status_t https_file_open(switch_file_handle_t *handle, const char
 static switch_status_t http_file_read(switch_file_handle_t *handle, void *data, size_t *len)
 {
 	struct http_context *context = (struct http_context *)handle->private_info;
-	return switch_core_file_read(&context->fh, data, len);
+	size_t want = *len;
+	switch_status_t status = switch_core_file_read(&context->fh, data, len);
+
+	/* caught up with a download in progress */
+	while (context->stream_url && status != SWITCH_STATUS_BREAK && (status != SWITCH_STATUS_SUCCESS || !*len)) {
+		if (http_stream_reopen(handle, context) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+		*len = want;
+		status = switch_core_file_read(&context->fh, data, len);
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		context->samples_read += *len;
+	}
+
+	return status;
 }
 
 /**
@@ -2137,6 +2764,8 @@ static switch_status_t http_file_close(switch_file_handle_t *handle)
 	switch_status_t status = switch_core_file_close(&context->fh);
 	long httpRes = 0;
 
+	http_stream_release(context);
+
 	if (status == SWITCH_STATUS_SUCCESS && !zstr(context->write_url)) {
 		status = http_put(&gcache, context->profile, NULL, context->write_url, context->local_path, 1, &httpRes);
 	}
@@ -2157,6 +2786,10 @@ static switch_status_t http_cache_file_seek(switch_file_handle_t *handle, unsign
 	}
 
 	if ((status = switch_core_file_seek(&context->fh, cur_sample, samples, whence)) == SWITCH_STATUS_SUCCESS) {
+		context->samples_read = *cur_sample;
+		if (context->fh.native_rate && context->fh.samplerate && context->fh.native_rate != context->fh.samplerate) {
+			context->samples_read = context->samples_read * context->fh.samplerate / context->fh.native_rate;
+		}
 		handle->pos = context->fh.pos;
 		handle->offset_pos = context->fh.offset_pos;
 		handle->samples_in = context->fh.samples_in;
@@ -2186,6 +2819,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_http_cache_load)
 	SWITCH_ADD_API(api, "http_put", "HTTP PUT", http_cache_put, HTTP_PUT_SYNTAX);
 	SWITCH_ADD_API(api, "http_clear_cache", "Clear the cache", http_cache_clear, HTTP_CACHE_CLEAR_SYNTAX);
 	SWITCH_ADD_API(api, "http_remove_cache", "Remove URL from cache", http_cache_remove, HTTP_CACHE_REMOVE_SYNTAX);
+	SWITCH_ADD_API(api, "http_cache_status", "Cache statistics and hit latency", http_cache_status, HTTP_CACHE_STATUS_SYNTAX);
 	SWITCH_ADD_API(api, "http_prefetch", "Prefetch document in a background thread.  Use http_get to get the prefetched document", http_cache_prefetch, HTTP_PREFETCH_SYNTAX);
 
 	prometheus_init(module_interface, api, pool);
@@ -2195,7 +2829,12 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_http_cache_load)
 	switch_core_hash_init(&gcache.map);
 	switch_core_hash_init(&gcache.profiles);
 	switch_core_hash_init_nocase(&gcache.fqdn_profiles);
-	switch_mutex_init(&gcache.mutex, SWITCH_MUTEX_UNNESTED, gcache.pool);
+	switch_thread_rwlock_create(&gcache.rwlock, gcache.pool);
+	switch_mutex_init(&gcache.stats_mutex, SWITCH_MUTEX_UNNESTED, gcache.pool);
+	for (i = 0; i < URL_LOCK_STRIPES; i++) {
+		switch_mutex_init(&gcache.url_mutex[i], SWITCH_MUTEX_UNNESTED, gcache.pool);
+		switch_thread_cond_create(&gcache.url_cond[i], gcache.pool);
+	}
 	switch_thread_rwlock_create(&gcache.shutdown_lock, gcache.pool);
 
 	if (do_config(&gcache) != SWITCH_STATUS_SUCCESS) {
@@ -2278,7 +2917,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_http_cache_shutdown)
 	switch_core_hash_destroy(&gcache.map);
 	switch_core_hash_destroy(&gcache.profiles);
 	switch_core_hash_destroy(&gcache.fqdn_profiles);
-	switch_mutex_destroy(gcache.mutex);
+	switch_thread_rwlock_destroy(gcache.rwlock);
+	switch_mutex_destroy(gcache.stats_mutex);
 	prometheus_destroy();
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -0,0 +1,184 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * test_http_cache.c -- tests for the mod_http_cache hit path, replacement and hot tier
+ *
+ */
+
+#include <switch.h>
+#include <test/switch_test.h>
+
+#define TEST_SRC_DIR "/tmp/test_http_cache/src"
+#define TEST_HOT_DIR "/tmp/test_http_cache/hot"
+
+/* file:// URLs go through the same curl download path as http:// */
+static char *make_source(switch_memory_pool_t *pool, const char *name, size_t len)
+{
+	char *path = switch_core_sprintf(pool, "%s%s%s", TEST_SRC_DIR, SWITCH_PATH_SEPARATOR, name);
+	FILE *fp;
+
+	switch_dir_make_recursive(TEST_SRC_DIR, SWITCH_DEFAULT_DIR_PERMS, pool);
+	if ((fp = fopen(path, "w"))) {
+		while (len--) {
+			fputc('x', fp);
+		}
+		fclose(fp);
+	}
+
+	return switch_core_sprintf(pool, "file://%s", path);
+}
+
+static char *api(const char *cmd, const char *arg)
+{
+	switch_stream_handle_t stream = { 0 };
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute(cmd, arg, NULL, &stream);
+
+	return (char *)stream.data;
+}
+
+FST_CORE_BEGIN("./conf")
+{
+	FST_MODULE_BEGIN(mod_http_cache, test_http_cache)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_http_cache");
+			free(api("http_clear_cache", NULL));
+		}
+		FST_SETUP_END()
+
+		FST_TEST_BEGIN(hit_after_miss)
+		{
+			char *url = make_source(fst_pool, "hit.txt", 100);
+			char *first, *second, *status;
+
+			first = api("http_get", url);
+			fst_requires(first);
+			fst_check(strncmp(first, "-ERR", 4));
+
+			/* served from the cache read lock fast path */
+			second = api("http_get", url);
+			fst_requires(second);
+			fst_check_string_equals(first, second);
+
+			status = api("http_cache_status", NULL);
+			fst_requires(status);
+			fst_check(strstr(status, "urls: 1/2\n"));
+			fst_check(strstr(status, "misses: 1\n"));
+			fst_check(strstr(status, "errors: 0\n"));
+			fst_check(strstr(status, "hits: 1\n"));
+
+			free(first);
+			free(second);
+			free(status);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(tryget_needs_download)
+		{
+			char *url = make_source(fst_pool, "tryget.txt", 100);
+			char *result;
+
+			result = api("http_tryget", url);
+			fst_requires(result);
+			fst_check(!strncmp(result, "-ERR", 4));
+			free(result);
+
+			free(api("http_get", url));
+
+			result = api("http_tryget", url);
+			fst_requires(result);
+			fst_check(strncmp(result, "-ERR", 4));
+			free(result);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(replace_oldest_unused)
+		{
+			char *url1 = make_source(fst_pool, "one.txt", 100);
+			char *url2 = make_source(fst_pool, "two.txt", 100);
+			char *url3 = make_source(fst_pool, "three.txt", 100);
+			char *result, *status;
+
+			free(api("http_get", url1));
+			free(api("http_get", url2));
+
+			/* both entries were used once, the clock clears them and then evicts the oldest */
+			free(api("http_get", url3));
+
+			status = api("http_cache_status", NULL);
+			fst_requires(status);
+			fst_check(strstr(status, "urls: 2/2\n"));
+			fst_check(strstr(status, "misses: 3\n"));
+			free(status);
+
+			result = api("http_tryget", url1);
+			fst_requires(result);
+			fst_check(!strncmp(result, "-ERR", 4));
+			free(result);
+
+			result = api("http_tryget", url3);
+			fst_requires(result);
+			fst_check(strncmp(result, "-ERR", 4));
+			free(result);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(hot_tier)
+		{
+			char *small = make_source(fst_pool, "small.txt", 100);
+			char *large = make_source(fst_pool, "large.txt", 600);
+			char *result, *status;
+
+			result = api("http_get", small);
+			fst_requires(result);
+			fst_check(!strncmp(result, TEST_HOT_DIR, strlen(TEST_HOT_DIR)));
+			free(result);
+
+			/* over hot-tier-max-file-size, stays in the cache location */
+			result = api("http_get", large);
+			fst_requires(result);
+			fst_check(strncmp(result, "-ERR", 4));
+			fst_check(strncmp(result, TEST_HOT_DIR, strlen(TEST_HOT_DIR)));
+			free(result);
+
+			status = api("http_cache_status", NULL);
+			fst_requires(status);
+			fst_check(strstr(status, "hot tier: 1 files, 100/1024 bytes\n"));
+			free(status);
+		}
+		FST_TEST_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+	}
+	FST_MODULE_END()
+}
+FST_CORE_END()
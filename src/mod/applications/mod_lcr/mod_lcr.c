@@ -33,8 +33,8 @@
 
 #include <switch.h>
 
-#define LCR_SYNTAX "lcr <digits> [<lcr profile>] [caller_id] [intrastate] [as xml]"
-#define LCR_ADMIN_SYNTAX "lcr_admin show profiles"
+#define LCR_SYNTAX "lcr <digits> [<lcr profile>] [caller_id] [intrastate] [as xml] [bench <iterations>]"
+#define LCR_ADMIN_SYNTAX "lcr_admin show profiles|reload <lcr profile>"
 
 #define LCR_HEADERS_COUNT 7
 
@@ -100,6 +100,82 @@ typedef lcr_obj_t *lcr_route;
 typedef struct max_obj max_obj_t;
 typedef max_obj_t *max_len;
 
+#define LCR_MEM_MAX_ORDER 8
+
+typedef enum {
+	LCR_RATE_DEFAULT = 0,
+	LCR_RATE_INTRASTATE,
+	LCR_RATE_INTRALATA,
+	LCR_RATE_TYPES
+} lcr_rate_type_t;
+
+typedef enum {
+	LCR_LOOKUP_AUTO = 0,
+	LCR_LOOKUP_SQL,
+	LCR_LOOKUP_MEMORY
+} lcr_lookup_mode_t;
+
+/* one term of the profile's order_by, so in-memory lookups can sort like the sql */
+struct lcr_order_term {
+	char *expr;
+	switch_bool_t desc;
+	switch_bool_t is_rate;
+};
+
+struct lcr_mem_row {
+	char **values;
+	switch_bool_t lrn;
+	/* date_start and date_end in lcr_mem_parse_time() seconds, checked on every lookup */
+	switch_bool_t dated;
+	int64_t date_start;
+	int64_t date_end;
+	struct lcr_mem_row *next;
+};
+typedef struct lcr_mem_row lcr_mem_row_t;
+
+/*
+ * node of the compressed prefix trie: the edge from the parent is spelled by label,
+ * children are kept in digit order and child_map has bit d set when one starts with d.
+ */
+struct lcr_mem_node {
+	const char *label;
+	uint16_t label_len;
+	uint16_t child_map;
+	struct lcr_mem_node **children;
+	const char *digits;
+	lcr_mem_row_t *rows;
+	lcr_mem_row_t *tail;
+};
+typedef struct lcr_mem_node lcr_mem_node_t;
+
+struct lcr_mem_table {
+	switch_memory_pool_t *pool;
+	struct profile_obj *profile;
+	lcr_mem_node_t root;
+	int ncols;
+	char **columns;
+	switch_bool_t *hidden;
+	int digits_col;
+	int lrn_col;
+	int rate_col[LCR_RATE_TYPES];
+	int user_rate_col[LCR_RATE_TYPES];
+	int order_col[LCR_MEM_MAX_ORDER];
+	int date_start_col;
+	int date_end_col;
+	/* the database's CURRENT_TIMESTAMP minus our clock, so rows can be dated like the sql does */
+	switch_bool_t have_db_now;
+	int64_t db_skew;
+	switch_hash_t *strings;
+	switch_bool_t failed;
+	uint32_t rows;
+	uint32_t prefixes;
+	uint32_t nodes;
+	uint32_t skipped;
+	switch_time_t loaded;
+	switch_time_t load_time;
+};
+typedef struct lcr_mem_table lcr_mem_table_t;
+
 struct profile_obj {
 	char *name;
 	uint16_t id;
@@ -120,6 +196,22 @@ struct profile_obj {
 	switch_bool_t single_bridge;
 	switch_bool_t info_in_headers;
 	switch_bool_t enable_sip_redir;
+
+	struct lcr_order_term order_terms[LCR_MEM_MAX_ORDER];
+	int order_terms_cnt;
+
+	/* routes kept in memory, readers pin mem[mem_active] through mem_readers */
+	switch_bool_t memory_routes;
+	switch_bool_t memory_routes_random;
+	char *memory_routes_sql;
+	uint32_t memory_routes_refresh;
+	lcr_mem_table_t *mem[2];
+	switch_atomic_t mem_active;
+	switch_atomic_t mem_readers[2];
+	switch_atomic_t mem_loading;
+	switch_mutex_t *mem_mutex;
+	switch_atomic_t mem_lookups;
+	switch_atomic_t sql_lookups;
 };
 typedef struct profile_obj profile_t;
 
@@ -137,6 +229,7 @@ struct callback_obj {
 	switch_core_session_t *session;
 	switch_event_t *event;
 	float max_rate;
+	lcr_lookup_mode_t lookup_mode;
 };
 typedef struct callback_obj callback_t;
 
@@ -147,6 +240,8 @@ static struct {
 	switch_mutex_t *mutex;
 	switch_hash_t *profile_hash;
 	profile_t *default_profile;
+	switch_atomic_t loaders;
+	int shutdown;
 	void *filler1;
 } globals;
 
@@ -892,6 +987,653 @@ static switch_status_t is_intrastatelata(callback_t *cb_struct)
 
 }
 
+/* in-memory routes */
+
+static int lcr_mem_popcount(uint16_t v)
+{
+	int count = 0;
+
+	while (v) {
+		v &= (uint16_t) (v - 1);
+		count++;
+	}
+
+	return count;
+}
+
+static void lcr_mem_node_add_child(lcr_mem_node_t *node, int idx, uint16_t bit, lcr_mem_node_t *child)
+{
+	int count = lcr_mem_popcount(node->child_map);
+	lcr_mem_node_t **children = realloc(node->children, sizeof(*children) * (count + 1));
+
+	switch_assert(children);
+	memmove(children + idx + 1, children + idx, sizeof(*children) * (count - idx));
+	children[idx] = child;
+	node->children = children;
+	node->child_map |= bit;
+}
+
+/* find or create the node spelling digits, splitting an edge when digits ends or branches inside it */
+static lcr_mem_node_t *lcr_mem_node_get(lcr_mem_table_t *table, const char *digits)
+{
+	lcr_mem_node_t *node = &table->root, *child, *mid;
+	const char *p = digits;
+	uint16_t bit;
+	size_t n;
+	int idx;
+
+	while (*p) {
+		bit = (uint16_t) (1 << (*p - '0'));
+		idx = lcr_mem_popcount((uint16_t) (node->child_map & (bit - 1)));
+
+		if (!(node->child_map & bit)) {
+			child = switch_core_alloc(table->pool, sizeof(*child));
+			child->label = switch_core_strdup(table->pool, p);
+			child->label_len = (uint16_t) strlen(p);
+			lcr_mem_node_add_child(node, idx, bit, child);
+			table->nodes++;
+			return child;
+		}
+
+		child = node->children[idx];
+		for (n = 0; n < child->label_len && p[n] == child->label[n]; n++);
+
+		if (n < child->label_len) {
+			mid = switch_core_alloc(table->pool, sizeof(*mid));
+			mid->label = child->label;
+			mid->label_len = (uint16_t) n;
+			child->label += n;
+			child->label_len -= (uint16_t) n;
+			lcr_mem_node_add_child(mid, 0, (uint16_t) (1 << (*child->label - '0')), child);
+			node->children[idx] = mid;
+			table->nodes++;
+			child = mid;
+		}
+
+		node = child;
+		p += n;
+	}
+
+	return node;
+}
+
+static void lcr_mem_node_free(lcr_mem_node_t *node)
+{
+	int i, count = lcr_mem_popcount(node->child_map);
+
+	for (i = 0; i < count; i++) {
+		lcr_mem_node_free(node->children[i]);
+	}
+	switch_safe_free(node->children);
+}
+
+static void lcr_mem_table_destroy(lcr_mem_table_t **tablep)
+{
+	lcr_mem_table_t *table = *tablep;
+	switch_memory_pool_t *pool;
+
+	if (!table) {
+		return;
+	}
+
+	*tablep = NULL;
+	lcr_mem_node_free(&table->root);
+	if (table->strings) {
+		switch_core_hash_destroy(&table->strings);
+	}
+	pool = table->pool;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* carriers, gateways and rates repeat across millions of rows, keep one copy of each */
+static char *lcr_mem_intern(lcr_mem_table_t *table, const char *str)
+{
+	char *s;
+
+	if (!str) {
+		return NULL;
+	}
+
+	if (!(s = switch_core_hash_find(table->strings, str))) {
+		s = switch_core_strdup(table->pool, str);
+		switch_core_hash_insert(table->strings, s, s);
+	}
+
+	return s;
+}
+
+static switch_status_t lcr_mem_set_columns(lcr_mem_table_t *table, int argc, char **columnNames)
+{
+	int i, n;
+
+	table->ncols = argc;
+	table->columns = switch_core_alloc(table->pool, sizeof(char *) * argc);
+	table->hidden = switch_core_alloc(table->pool, sizeof(switch_bool_t) * argc);
+	table->digits_col = table->lrn_col = table->date_start_col = table->date_end_col = -1;
+	for (i = 0; i < LCR_RATE_TYPES; i++) {
+		table->rate_col[i] = table->user_rate_col[i] = -1;
+	}
+	for (i = 0; i < LCR_MEM_MAX_ORDER; i++) {
+		table->order_col[i] = -1;
+	}
+
+	for (i = 0; i < argc; i++) {
+		char *name = columnNames[i];
+
+		table->columns[i] = switch_core_strdup(table->pool, name);
+		table->hidden[i] = !strncmp(name, "lcr_mem_", 8);
+
+		if (!strcmp(name, "lcr_digits")) {
+			table->digits_col = i;
+		} else if (!strcmp(name, "lcr_rate_field")) {
+			table->rate_col[LCR_RATE_DEFAULT] = i;
+		} else if (!strcmp(name, "lcr_user_rate")) {
+			table->user_rate_col[LCR_RATE_DEFAULT] = i;
+		} else if (!strcmp(name, "lcr_mem_lrn")) {
+			table->lrn_col = i;
+		} else if (!strcmp(name, "lcr_mem_date_start")) {
+			table->date_start_col = i;
+		} else if (!strcmp(name, "lcr_mem_date_end")) {
+			table->date_end_col = i;
+		} else if (!strcmp(name, "lcr_mem_intrastate_rate")) {
+			table->rate_col[LCR_RATE_INTRASTATE] = i;
+		} else if (!strcmp(name, "lcr_mem_intralata_rate")) {
+			table->rate_col[LCR_RATE_INTRALATA] = i;
+		} else if (!strcmp(name, "lcr_mem_user_intrastate_rate")) {
+			table->user_rate_col[LCR_RATE_INTRASTATE] = i;
+		} else if (!strcmp(name, "lcr_mem_user_intralata_rate")) {
+			table->user_rate_col[LCR_RATE_INTRALATA] = i;
+		} else if (!strncmp(name, "lcr_mem_order_", 14) && switch_is_number(name + 14) && (n = atoi(name + 14)) < LCR_MEM_MAX_ORDER) {
+			table->order_col[n] = i;
+		}
+	}
+
+	if (table->digits_col < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "memory_routes_sql of profile %s returns no lcr_digits column\n", table->profile->name);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/*
+ * seconds of a "YYYY-MM-DD[ HH:MM:SS]" wall clock as the database prints it, fractions and zones are ignored.
+ * Only ever compared with values parsed the same way, so the zone cancels out like it does in the sql.
+ */
+static switch_bool_t lcr_mem_parse_time(const char *str, int64_t *secs)
+{
+	int y, mo, d, h = 0, mi = 0, sec = 0;
+	int64_t era, yoe, doy, doe;
+
+	if (zstr(str) || sscanf(str, "%d-%d-%d%*[ T]%d:%d:%d", &y, &mo, &d, &h, &mi, &sec) < 3 || mo < 1 || mo > 12 || d < 1 || d > 31) {
+		return SWITCH_FALSE;
+	}
+
+	/* days since 1970-01-01 in the proleptic gregorian calendar */
+	y -= mo <= 2;
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (mo > 2 ? mo - 3 : mo + 9) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	*secs = (era * 146097 + doe - 719468) * 86400 + h * 3600 + mi * 60 + sec;
+
+	return SWITCH_TRUE;
+}
+
+static int lcr_mem_now_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	lcr_mem_table_t *table = (lcr_mem_table_t *) pArg;
+	int64_t now;
+
+	if (argc == 1 && lcr_mem_parse_time(argv[0], &now)) {
+		table->db_skew = now - (int64_t) switch_epoch_time_now(NULL);
+		table->have_db_now = SWITCH_TRUE;
+	}
+
+	return 0;
+}
+
+static int lcr_mem_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	lcr_mem_table_t *table = (lcr_mem_table_t *) pArg;
+	lcr_mem_node_t *node;
+	lcr_mem_row_t *row;
+	const char *digits, *p;
+	int i;
+
+	if (globals.shutdown) {
+		table->failed = SWITCH_TRUE;
+		return -1;
+	}
+
+	if (!table->columns) {
+		if (lcr_mem_set_columns(table, argc, columnNames) != SWITCH_STATUS_SUCCESS) {
+			table->failed = SWITCH_TRUE;
+			return -1;
+		}
+	} else if (argc != table->ncols) {
+		table->failed = SWITCH_TRUE;
+		return -1;
+	}
+
+	/* lookups only ever walk digits, anything else could never match */
+	digits = argv[table->digits_col];
+	for (p = digits; p && switch_isdigit(*p); p++);
+	if (zstr(digits) || *p || p - digits > 64) {
+		table->skipped++;
+		return 0;
+	}
+
+	/* CURRENT_TIMESTAMP BETWEEN NULL AND ... never holds */
+	if ((table->date_start_col >= 0 && !argv[table->date_start_col]) || (table->date_end_col >= 0 && !argv[table->date_end_col])) {
+		table->skipped++;
+		return 0;
+	}
+
+	node = lcr_mem_node_get(table, digits);
+	if (!node->digits) {
+		node->digits = switch_core_strdup(table->pool, digits);
+		table->prefixes++;
+	}
+
+	row = switch_core_alloc(table->pool, sizeof(*row));
+	row->values = switch_core_alloc(table->pool, sizeof(char *) * argc);
+	for (i = 0; i < argc; i++) {
+		row->values[i] = (i == table->digits_col) ? (char *) node->digits : lcr_mem_intern(table, argv[i]);
+	}
+	row->lrn = (table->lrn_col >= 0 && switch_true(argv[table->lrn_col])) ? SWITCH_TRUE : SWITCH_FALSE;
+	if (table->have_db_now && table->date_start_col >= 0 && table->date_end_col >= 0) {
+		/* a value we can't read keeps the row, the load query already checked it once */
+		row->dated = lcr_mem_parse_time(argv[table->date_start_col], &row->date_start) &&
+			lcr_mem_parse_time(argv[table->date_end_col], &row->date_end);
+	}
+
+	if (node->tail) {
+		node->tail->next = row;
+	} else {
+		node->rows = row;
+	}
+	node->tail = row;
+	table->rows++;
+
+	return 0;
+}
+
+static lcr_mem_table_t *lcr_mem_build(profile_t *profile)
+{
+	switch_memory_pool_t *pool = NULL;
+	lcr_mem_table_t *table;
+	switch_time_t start = switch_time_now();
+
+	switch_core_new_memory_pool(&pool);
+	table = switch_core_alloc(pool, sizeof(*table));
+	table->pool = pool;
+	table->profile = profile;
+	switch_core_hash_init(&table->strings);
+
+	lcr_execute_sql_callback("SELECT CURRENT_TIMESTAMP AS lcr_mem_now", lcr_mem_now_callback, table);
+
+	if (lcr_execute_sql_callback(profile->memory_routes_sql, lcr_mem_load_callback, table) != SWITCH_STATUS_SUCCESS || table->failed) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to load the routes of profile %s into memory\n", profile->name);
+		lcr_mem_table_destroy(&table);
+		return NULL;
+	}
+
+	switch_core_hash_destroy(&table->strings);
+	table->loaded = switch_time_now();
+	table->load_time = table->loaded - start;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded %u routes for %u prefixes (%u trie nodes, %u skipped) of profile %s in %" SWITCH_TIME_T_FMT "ms\n",
+					  table->rows, table->prefixes, table->nodes, table->skipped, profile->name, table->load_time / 1000);
+
+	return table;
+}
+
+/* pin the current table, NULL when none is loaded yet; always pair with lcr_mem_release() */
+static lcr_mem_table_t *lcr_mem_acquire(profile_t *profile, uint32_t *slot)
+{
+	uint32_t i;
+
+	for (;;) {
+		i = switch_atomic_read(&profile->mem_active);
+		switch_atomic_inc(&profile->mem_readers[i]);
+		if (switch_atomic_read(&profile->mem_active) == i) {
+			break;
+		}
+		/* swapped under us, the writer may be draining this slot */
+		switch_atomic_dec(&profile->mem_readers[i]);
+	}
+
+	*slot = i;
+	return profile->mem[i];
+}
+
+static void lcr_mem_release(profile_t *profile, uint32_t slot)
+{
+	switch_atomic_dec(&profile->mem_readers[slot]);
+}
+
+static switch_bool_t lcr_mem_claim(profile_t *profile)
+{
+	return switch_atomic_cas(&profile->mem_loading, 1, 0) == 0 ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/* build a new table into the idle buffer, flip to it and free the old one once its readers left; needs lcr_mem_claim() */
+static switch_status_t lcr_mem_load_swap(profile_t *profile)
+{
+	lcr_mem_table_t *table, *old;
+	uint32_t cur, next;
+
+	if (!(table = lcr_mem_build(profile))) {
+		switch_atomic_set(&profile->mem_loading, 0);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(profile->mem_mutex);
+	cur = switch_atomic_read(&profile->mem_active);
+	next = !cur;
+
+	while (switch_atomic_read(&profile->mem_readers[next])) {
+		switch_yield(1000);
+	}
+	profile->mem[next] = table;
+	switch_atomic_set(&profile->mem_active, next);
+
+	while (switch_atomic_read(&profile->mem_readers[cur])) {
+		switch_yield(1000);
+	}
+	old = profile->mem[cur];
+	profile->mem[cur] = NULL;
+	switch_mutex_unlock(profile->mem_mutex);
+
+	lcr_mem_table_destroy(&old);
+	switch_atomic_set(&profile->mem_loading, 0);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void *SWITCH_THREAD_FUNC lcr_mem_load_thread(switch_thread_t *thread, void *obj)
+{
+	profile_t *profile = (profile_t *) obj;
+
+	lcr_mem_load_swap(profile);
+	switch_atomic_dec(&globals.loaders);
+
+	return NULL;
+}
+
+static void lcr_mem_load_background(profile_t *profile)
+{
+	switch_thread_data_t *td;
+
+	if (globals.shutdown || !lcr_mem_claim(profile)) {
+		return;
+	}
+
+	switch_atomic_inc(&globals.loaders);
+	switch_zmalloc(td, sizeof(*td));
+	td->func = lcr_mem_load_thread;
+	td->obj = profile;
+	td->alloc = 1;
+
+	if (switch_thread_pool_launch_thread(&td) != SWITCH_STATUS_SUCCESS) {
+		switch_safe_free(td);
+		switch_atomic_set(&profile->mem_loading, 0);
+		switch_atomic_dec(&globals.loaders);
+	}
+}
+
+/* compare like the database would: numerically when both are numbers, NULL first */
+static int lcr_mem_value_cmp(const char *a, const char *b)
+{
+	char *ea, *eb;
+	double da, db;
+
+	if (!a || !b) {
+		return a ? 1 : (b ? -1 : 0);
+	}
+
+	da = strtod(a, &ea);
+	db = strtod(b, &eb);
+	if (ea != a && !*ea && eb != b && !*eb) {
+		return da < db ? -1 : (da > db ? 1 : 0);
+	}
+
+	return strcmp(a, b);
+}
+
+static char *lcr_mem_rate_value(lcr_mem_row_t *row, int *cols, lcr_rate_type_t rate_type)
+{
+	if (cols[rate_type] >= 0) {
+		return row->values[cols[rate_type]];
+	}
+
+	return cols[LCR_RATE_DEFAULT] >= 0 ? row->values[cols[LCR_RATE_DEFAULT]] : NULL;
+}
+
+struct lcr_mem_match {
+	lcr_mem_table_t *table;
+	lcr_mem_row_t *row;
+	const char *digits;
+	lcr_rate_type_t rate_type;
+	int random;
+	int order;
+};
+typedef struct lcr_mem_match lcr_mem_match_t;
+
+/* ORDER BY digits DESC, <order_by>, <random> of the sql path, then load order */
+static int lcr_mem_match_cmp(const void *pa, const void *pb)
+{
+	const lcr_mem_match_t *a = (const lcr_mem_match_t *) pa;
+	const lcr_mem_match_t *b = (const lcr_mem_match_t *) pb;
+	lcr_mem_table_t *table = a->table;
+	profile_t *profile = table->profile;
+	size_t alen = strlen(a->digits), blen = strlen(b->digits);
+	const char *va, *vb;
+	int i, r;
+
+	/* digits is numeric in the stock schema, a longer prefix is the bigger number */
+	if (alen != blen) {
+		return alen > blen ? -1 : 1;
+	}
+	if ((r = strcmp(b->digits, a->digits))) {
+		return r;
+	}
+
+	for (i = 0; i < profile->order_terms_cnt; i++) {
+		if (profile->order_terms[i].is_rate) {
+			va = lcr_mem_rate_value(a->row, table->rate_col, a->rate_type);
+			vb = lcr_mem_rate_value(b->row, table->rate_col, b->rate_type);
+		} else if (table->order_col[i] >= 0) {
+			va = a->row->values[table->order_col[i]];
+			vb = b->row->values[table->order_col[i]];
+		} else {
+			continue;
+		}
+		if ((r = lcr_mem_value_cmp(va, vb))) {
+			return profile->order_terms[i].desc ? -r : r;
+		}
+	}
+
+	if (a->random != b->random) {
+		return a->random < b->random ? -1 : 1;
+	}
+
+	return a->order - b->order;
+}
+
+/* add the rows of every prefix of digits that are in date at now, the sql matches lrn rows on the lrn number only */
+static void lcr_mem_collect(lcr_mem_table_t *table, const char *digits, switch_bool_t lrn, lcr_rate_type_t rate_type, int64_t now,
+							lcr_mem_match_t **matches, int *count, int *size)
+{
+	lcr_mem_node_t *node = &table->root, *child;
+	const char *p = digits;
+	lcr_mem_row_t *row;
+	uint16_t bit;
+
+	while (p && switch_isdigit(*p)) {
+		bit = (uint16_t) (1 << (*p - '0'));
+		if (!(node->child_map & bit)) {
+			break;
+		}
+		child = node->children[lcr_mem_popcount((uint16_t) (node->child_map & (bit - 1)))];
+		if (strncmp(p, child->label, child->label_len)) {
+			break;
+		}
+		p += child->label_len;
+		node = child;
+
+		for (row = node->rows; row; row = row->next) {
+			if (row->lrn != lrn || (row->dated && (now < row->date_start || now > row->date_end))) {
+				continue;
+			}
+			if (*count == *size) {
+				lcr_mem_match_t *tmp;
+
+				*size = *size ? *size * 2 : 32;
+				tmp = realloc(*matches, sizeof(**matches) * *size);
+				switch_assert(tmp);
+				*matches = tmp;
+			}
+			(*matches)[*count].table = table;
+			(*matches)[*count].row = row;
+			(*matches)[*count].digits = node->digits;
+			(*matches)[*count].rate_type = rate_type;
+			(*matches)[*count].random = table->profile->memory_routes_random ? rand() : 0;
+			(*matches)[*count].order = *count;
+			(*count)++;
+		}
+	}
+}
+
+/* feed the matching rows to route_add_callback as if they came from the sql */
+static switch_status_t lcr_mem_lookup(lcr_mem_table_t *table, callback_t *cb_struct, const char *digits, const char *lrn_digits, lcr_rate_type_t rate_type)
+{
+	lcr_mem_match_t *matches = NULL;
+	int count = 0, size = 0, i, j, n;
+	char **argv, **names;
+	lcr_mem_row_t *row;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	int64_t now = (int64_t) switch_epoch_time_now(NULL) + table->db_skew;
+
+	if (!table->columns) {
+		/* nothing was loaded */
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	lcr_mem_collect(table, digits, SWITCH_FALSE, rate_type, now, &matches, &count, &size);
+	lcr_mem_collect(table, lrn_digits, SWITCH_TRUE, rate_type, now, &matches, &count, &size);
+
+	if (count > 1) {
+		qsort(matches, count, sizeof(*matches), lcr_mem_match_cmp);
+	}
+
+	argv = switch_core_alloc(cb_struct->pool, sizeof(char *) * table->ncols);
+	names = switch_core_alloc(cb_struct->pool, sizeof(char *) * table->ncols);
+
+	for (i = 0; i < count; i++) {
+		row = matches[i].row;
+		for (j = 0, n = 0; j < table->ncols; j++) {
+			if (table->hidden[j]) {
+				continue;
+			}
+			names[n] = table->columns[j];
+			if (j == table->rate_col[LCR_RATE_DEFAULT]) {
+				argv[n] = lcr_mem_rate_value(row, table->rate_col, rate_type);
+			} else if (j == table->user_rate_col[LCR_RATE_DEFAULT]) {
+				argv[n] = lcr_mem_rate_value(row, table->user_rate_col, rate_type);
+			} else {
+				argv[n] = row->values[j];
+			}
+			n++;
+		}
+		if (route_add_callback(cb_struct, n, argv, names)) {
+			status = SWITCH_STATUS_GENERR;
+			break;
+		}
+	}
+
+	switch_safe_free(matches);
+
+	return status;
+}
+
+/* the stock query without the digits filter, every rate column, the order_by values and the dates, which lookups check */
+static char *lcr_mem_default_sql(profile_t *profile)
+{
+	switch_stream_handle_t sql_stream = { 0 };
+	char *order_by, *sql;
+	int i;
+
+	SWITCH_STANDARD_STREAM(sql_stream);
+	sql_stream.write_function(&sql_stream,
+							  "SELECT l.digits AS lcr_digits, c.carrier_name AS lcr_carrier_name, l.rate AS lcr_rate_field, "
+							  "cg.prefix AS lcr_gw_prefix, cg.suffix AS lcr_gw_suffix, l.lead_strip AS lcr_lead_strip, "
+							  "l.trail_strip AS lcr_trail_strip, l.prefix AS lcr_prefix, l.suffix AS lcr_suffix, "
+							  "cg.codec AS lcr_codec, l.cid AS lcr_cid, l.lrn AS lcr_mem_lrn, "
+							  "l.date_start AS lcr_mem_date_start, l.date_end AS lcr_mem_date_end");
+	if (profile->profile_has_intrastate == SWITCH_TRUE) {
+		sql_stream.write_function(&sql_stream, ", l.intrastate_rate AS lcr_mem_intrastate_rate");
+	}
+	if (profile->profile_has_intralata == SWITCH_TRUE) {
+		sql_stream.write_function(&sql_stream, ", l.intralata_rate AS lcr_mem_intralata_rate");
+	}
+	for (i = 0; i < profile->order_terms_cnt; i++) {
+		if (!profile->order_terms[i].is_rate) {
+			sql_stream.write_function(&sql_stream, ", %s AS lcr_mem_order_%d", profile->order_terms[i].expr, i);
+		}
+	}
+	sql_stream.write_function(&sql_stream, " FROM lcr l JOIN carriers c ON l.carrier_id=c.id "
+							  "JOIN carrier_gateway cg ON c.id=cg.carrier_id "
+							  "WHERE c.enabled = '1' AND cg.enabled = '1' AND l.enabled = '1' "
+							  "AND date_end >= CURRENT_TIMESTAMP ");
+	if (profile->id > 0) {
+		sql_stream.write_function(&sql_stream, "AND lcr_profile=%d ", profile->id);
+	}
+	order_by = switch_string_replace(profile->order_by, "${lcr_rate_field}", "rate");
+	sql_stream.write_function(&sql_stream, "ORDER BY digits DESC%s;", order_by);
+	switch_safe_free(order_by);
+
+	sql = switch_core_strdup(globals.pool, (char *) sql_stream.data);
+	switch_safe_free(sql_stream.data);
+
+	return sql;
+}
+
+/* remember an order_by term, "quality" and "reliability" sort DESC like the sql does */
+static void lcr_add_order_term(struct lcr_order_term *terms, int *cnt, const char *arg)
+{
+	struct lcr_order_term *term;
+	char *expr, *p;
+
+	if (*cnt >= LCR_MEM_MAX_ORDER) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Too many order_by terms, in-memory routes ignore %s\n", arg);
+		return;
+	}
+
+	term = &terms[(*cnt)++];
+	memset(term, 0, sizeof(*term));
+
+	if (!strcasecmp(arg, "quality") || !strcasecmp(arg, "reliability")) {
+		term->expr = switch_core_strdup(globals.pool, arg);
+		term->desc = SWITCH_TRUE;
+	} else if (!strcasecmp(arg, "rate")) {
+		term->is_rate = SWITCH_TRUE;
+	} else {
+		expr = switch_core_strdup(globals.pool, arg);
+		if ((p = strrchr(expr, ' '))) {
+			if (!strcasecmp(p + 1, "desc")) {
+				term->desc = SWITCH_TRUE;
+				*p = '\0';
+			} else if (!strcasecmp(p + 1, "asc")) {
+				*p = '\0';
+			}
+		}
+		term->expr = expr;
+	}
+}
+
 static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 {
 	switch_stream_handle_t sql_stream = { 0 };
@@ -906,6 +1648,7 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	char *safe_sql = NULL;
 	char *rate_field = NULL;
 	char *user_rate_field = NULL;
+	lcr_rate_type_t rate_type = LCR_RATE_DEFAULT;
 
 	switch_assert(cb_struct->lookup_number != NULL);
 
@@ -936,9 +1679,11 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	if (cb_struct->intralata == SWITCH_TRUE && profile->profile_has_intralata == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intralata_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intralata_rate");
+		rate_type = LCR_RATE_INTRALATA;
 	} else if (cb_struct->intrastate == SWITCH_TRUE && profile->profile_has_intrastate == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intrastate_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intrastate_rate");
+		rate_type = LCR_RATE_INTRASTATE;
 	} else {
 		rate_field = switch_core_strdup(cb_struct->pool, "rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_rate");
@@ -980,6 +1725,30 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 		}
 	}
 
+	if (profile->memory_routes && cb_struct->lookup_mode != LCR_LOOKUP_SQL) {
+		lcr_mem_table_t *table;
+		uint32_t slot;
+
+		if ((table = lcr_mem_acquire(profile, &slot))) {
+			lookup_status = lcr_mem_lookup(table, cb_struct, digits_copy, cb_struct->lrn_number ? cb_struct->lrn_number : digits_copy, rate_type);
+			if (profile->memory_routes_refresh && switch_time_now() - table->loaded > (switch_time_t) profile->memory_routes_refresh * 1000000) {
+				lcr_mem_load_background(profile);
+			}
+			lcr_mem_release(profile, slot);
+			switch_atomic_inc(&profile->mem_lookups);
+			switch_core_hash_destroy(&cb_struct->dedup_hash);
+			return lookup_status;
+		}
+		lcr_mem_release(profile, slot);
+	}
+
+	if (cb_struct->lookup_mode == LCR_LOOKUP_MEMORY) {
+		switch_core_hash_destroy(&cb_struct->dedup_hash);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(cb_struct->session), SWITCH_LOG_ERROR, "Profile %s has no routes loaded in memory\n", profile->name);
+		return SWITCH_STATUS_GENERR;
+	}
+	switch_atomic_inc(&profile->sql_lookups);
+
 	/* set up the query to be executed */
 	/* format the custom_sql */
 	safe_sql = format_custom_sql(profile->custom_sql, cb_struct, digits_copy);
@@ -1094,6 +1863,12 @@ static switch_status_t lcr_load_config()
 			char *custom_sql = NULL;
 			char *export_fields = NULL;
 			char *limit_type = NULL;
+			char *memory_routes = NULL;
+			char *memory_routes_sql = NULL;
+			char *memory_routes_refresh = NULL;
+			struct lcr_order_term order_terms[LCR_MEM_MAX_ORDER];
+			int order_terms_cnt = 0;
+			switch_bool_t default_sql = SWITCH_FALSE;
 			int argc, x = 0;
 			char *argv[32] = { 0 };
 
@@ -1112,6 +1887,7 @@ static switch_status_t lcr_load_config()
 						for (x=0; x<argc; x++) {
 							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "arg #%d/%d is %s\n", x, argc, argv[x]);
 							if (!zstr(argv[x])) {
+								lcr_add_order_term(order_terms, &order_terms_cnt, argv[x]);
 								if (!strcasecmp(argv[x], "quality")) {
 									thisorder->write_function(thisorder, "%s quality DESC", comma);
 								} else if (!strcasecmp(argv[x], "reliability")) {
@@ -1153,6 +1929,12 @@ static switch_status_t lcr_load_config()
 					limit_type = val;
 				} else if (!strcasecmp(var, "enable_sip_redir") && !zstr(val)) {
 					enable_sip_redir = val;
+				} else if (!strcasecmp(var, "memory_routes") && !zstr(val)) {
+					memory_routes = val;
+				} else if (!strcasecmp(var, "memory_routes_sql") && !zstr(val)) {
+					memory_routes_sql = val;
+				} else if (!strcasecmp(var, "memory_routes_refresh") && !zstr(val)) {
+					memory_routes_refresh = val;
 				}
 			}
 
@@ -1168,7 +1950,10 @@ static switch_status_t lcr_load_config()
 				} else {
 					/* default to rate */
 					profile->order_by = ", ${lcr_rate_field}";
+					lcr_add_order_term(order_terms, &order_terms_cnt, "rate");
 				}
+				memcpy(profile->order_terms, order_terms, sizeof(order_terms));
+				profile->order_terms_cnt = order_terms_cnt;
 
 				if (!zstr(id_s)) {
 					profile->id = (uint16_t)atoi(id_s);
@@ -1178,6 +1963,7 @@ static switch_status_t lcr_load_config()
 				SWITCH_STANDARD_STREAM(sql_stream);
 				if (zstr(custom_sql)) {
 					/* use default sql */
+					default_sql = SWITCH_TRUE;
 
 					/* Checking for codec field, adding if needed */
 					if (db_check("SELECT codec FROM carrier_gateway LIMIT 1") == SWITCH_TRUE) {
@@ -1270,6 +2056,26 @@ static switch_status_t lcr_load_config()
 				}
 				profile->custom_sql = switch_core_strdup(globals.pool, (char *)custom_sql);
 
+				if (!zstr(memory_routes) && switch_true(memory_routes)) {
+					if (!zstr(memory_routes_sql)) {
+						profile->memory_routes_sql = switch_core_strdup(globals.pool, memory_routes_sql);
+					} else if (default_sql) {
+						profile->memory_routes_sql = lcr_mem_default_sql(profile);
+						/* the stock query breaks ties with random() */
+						profile->memory_routes_random = db_random ? SWITCH_TRUE : SWITCH_FALSE;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING,
+										  "profile %s uses custom_sql, set memory_routes_sql to keep its routes in memory\n", profile->name);
+					}
+					if (profile->memory_routes_sql) {
+						profile->memory_routes = SWITCH_TRUE;
+						switch_mutex_init(&profile->mem_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+						if (!zstr(memory_routes_refresh)) {
+							profile->memory_routes_refresh = (uint32_t) atoi(memory_routes_refresh);
+						}
+					}
+				}
+
 				if (!zstr(reorder_by_rate)) {
 					profile->reorder_by_rate = switch_true(reorder_by_rate);
 				}
@@ -1805,6 +2611,104 @@ static void write_data(switch_stream_handle_t *stream, switch_bool_t as_xml, con
 	}
 }
 
+static int lcr_bench_cmp(const void *a, const void *b)
+{
+	switch_time_t ta = *(const switch_time_t *) a, tb = *(const switch_time_t *) b;
+
+	return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+/* time the same lookup against the database and the in-memory routes */
+static void lcr_bench(callback_t *proto, int iterations, switch_stream_handle_t *stream)
+{
+	lcr_lookup_mode_t modes[2] = { LCR_LOOKUP_SQL, LCR_LOOKUP_MEMORY };
+	const char *mode_names[2] = { "sql", "memory" };
+	char *route_lists[2] = { NULL, NULL };
+	switch_time_t *usec;
+	int m, i, count, routes;
+
+	switch_zmalloc(usec, sizeof(*usec) * iterations);
+
+	for (m = 0; m < 2; m++) {
+		switch_time_t total = 0;
+		switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+		routes = 0;
+		for (count = 0; count < iterations; count++) {
+			callback_t cb_struct = { 0 };
+			switch_memory_pool_t *pool = NULL;
+			switch_event_t *event = NULL;
+			switch_time_t start;
+
+			switch_core_new_memory_pool(&pool);
+			cb_struct.pool = pool;
+			cb_struct.lookup_number = proto->lookup_number;
+			cb_struct.lrn_number = proto->lrn_number;
+			cb_struct.cid = proto->cid;
+			cb_struct.intrastate = proto->intrastate;
+			cb_struct.intralata = proto->intralata;
+			cb_struct.profile = proto->profile;
+			cb_struct.session = proto->session;
+			cb_struct.lookup_mode = modes[m];
+			if (!cb_struct.session) {
+				switch_event_create(&event, SWITCH_EVENT_MESSAGE);
+				cb_struct.event = event;
+			}
+
+			start = switch_time_now();
+			status = lcr_do_lookup(&cb_struct);
+			usec[count] = switch_time_now() - start;
+			total += usec[count];
+
+			if (status == SWITCH_STATUS_SUCCESS && count == 0) {
+				switch_stream_handle_t list = { 0 };
+				lcr_route cur;
+
+				SWITCH_STANDARD_STREAM(list);
+				for (cur = cb_struct.head; cur; cur = cur->next) {
+					list.write_function(&list, "%s\n", switch_str_nil(cur->dialstring));
+					routes++;
+				}
+				route_lists[m] = list.data;
+			}
+
+			lcr_destroy(cb_struct.head);
+			if (event) {
+				switch_event_destroy(&event);
+			}
+			switch_core_destroy_memory_pool(&pool);
+
+			if (status != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+		}
+
+		if (status != SWITCH_STATUS_SUCCESS) {
+			stream->write_function(stream, "%-6s lookup failed\n", mode_names[m]);
+			continue;
+		}
+
+		qsort(usec, count, sizeof(*usec), lcr_bench_cmp);
+		stream->write_function(stream, "%-6s %d lookups, %d routes, avg %" SWITCH_TIME_T_FMT "us, min %" SWITCH_TIME_T_FMT "us, p50 %" SWITCH_TIME_T_FMT
+							   "us, p99 %" SWITCH_TIME_T_FMT "us, max %" SWITCH_TIME_T_FMT "us\n",
+							   mode_names[m], count, routes, total / count, usec[0], usec[count / 2], usec[(count * 99) / 100], usec[count - 1]);
+	}
+
+	if (route_lists[0] && route_lists[1]) {
+		if (!strcmp(route_lists[0], route_lists[1])) {
+			stream->write_function(stream, "route lists match\n");
+		} else {
+			stream->write_function(stream, "route lists differ%s\n",
+								   proto->profile->memory_routes_random ? " (routes that tie are shuffled like random() does)" : "");
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		switch_safe_free(route_lists[i]);
+	}
+	switch_safe_free(usec);
+}
+
 SWITCH_STANDARD_API(dialplan_lcr_function)
 {
 	char *argv[32]                 = { 0 };
@@ -1821,6 +2725,7 @@ SWITCH_STANDARD_API(dialplan_lcr_function)
 	char *event_str               = NULL;
 	switch_xml_t event_xml        = NULL;
 	int rowcount                  = 0;
+	int bench                     = 0;
 	char *data                    = NULL;
 
 	if (zstr(cmd)) {
@@ -1870,6 +2775,14 @@ SWITCH_STANDARD_API(dialplan_lcr_function)
 						} else {
 							goto usage;
 						}
+				} else if (!strcasecmp(argv[i], "bench")) {
+					i++;
+					if (!argv[i] || (bench = atoi(argv[i])) <= 0) {
+						goto usage;
+					}
+					if (bench > 100000) {
+						bench = 100000;
+					}
 				} else {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Set Caller ID to [%s]\n", argv[i]);
 					/* the only other option we have right now is caller id */
@@ -1890,6 +2803,11 @@ SWITCH_STANDARD_API(dialplan_lcr_function)
 			goto end;
 		}
 
+		if (bench) {
+			lcr_bench(&cb_struct, bench, stream);
+			goto end;
+		}
+
 		lookup_status = lcr_do_lookup(&cb_struct);
 
 		if (cb_struct.head != NULL) {
@@ -2062,8 +2980,47 @@ SWITCH_STANDARD_API(dialplan_lcr_admin_function)
 				stream->write_function(stream, " Sip Redirection Mode:\t%s\n", profile->enable_sip_redir ? "enabled" : "disabled");
 				stream->write_function(stream, " Import fields:\t%s\n", profile->export_fields_str ? profile->export_fields_str : "(null)");
 				stream->write_function(stream, " Limit type:\t%s\n", profile->limit_type);
+				stream->write_function(stream, " Memory routes:\t%s\n", profile->memory_routes ? "enabled" : "disabled");
+				if (profile->memory_routes) {
+					lcr_mem_table_t *table;
+					uint32_t slot;
+
+					if ((table = lcr_mem_acquire(profile, &slot))) {
+						stream->write_function(stream, "  routes:\t%u (%u prefixes, %u trie nodes, %u skipped)\n",
+											   table->rows, table->prefixes, table->nodes, table->skipped);
+						stream->write_function(stream, "  loaded:\t%" SWITCH_TIME_T_FMT "s ago in %" SWITCH_TIME_T_FMT "ms\n",
+											   (switch_time_now() - table->loaded) / 1000000, table->load_time / 1000);
+					} else {
+						stream->write_function(stream, "  routes:\tnot loaded\n");
+					}
+					lcr_mem_release(profile, slot);
+					stream->write_function(stream, "  refresh:\t%us%s\n", profile->memory_routes_refresh,
+										   switch_atomic_read(&profile->mem_loading) ? " (loading)" : "");
+					stream->write_function(stream, "  lookups:\t%u memory, %u sql\n",
+										   switch_atomic_read(&profile->mem_lookups), switch_atomic_read(&profile->sql_lookups));
+				}
 				stream->write_function(stream, "\n");
 			}
+		} else if (!strcasecmp(argv[0], "reload")) {
+			if (!(profile = switch_core_hash_find(globals.profile_hash, argv[1]))) {
+				stream->write_function(stream, "-ERR Unknown profile: %s\n", argv[1]);
+			} else if (!profile->memory_routes) {
+				stream->write_function(stream, "-ERR Profile %s does not keep its routes in memory\n", argv[1]);
+			} else if (!lcr_mem_claim(profile)) {
+				stream->write_function(stream, "-ERR Profile %s is already loading\n", argv[1]);
+			} else if (lcr_mem_load_swap(profile) != SWITCH_STATUS_SUCCESS) {
+				stream->write_function(stream, "-ERR Unable to load the routes of profile %s\n", argv[1]);
+			} else {
+				lcr_mem_table_t *table;
+				uint32_t slot;
+
+				if ((table = lcr_mem_acquire(profile, &slot))) {
+					stream->write_function(stream, "+OK loaded %u routes in %" SWITCH_TIME_T_FMT "ms\n", table->rows, table->load_time / 1000);
+				} else {
+					stream->write_function(stream, "+OK\n");
+				}
+				lcr_mem_release(profile, slot);
+			}
 		} else {
 			goto usage;
 		}
@@ -2083,6 +3040,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 	switch_api_interface_t *dialplan_lcr_api_admin_interface;
 	switch_application_interface_t *app_interface;
 	switch_dialplan_interface_t *dp_interface;
+	switch_hash_index_t *hi;
+	void *val;
+	profile_t *profile;
 
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -2101,17 +3061,43 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 	SWITCH_ADD_APP(app_interface, "lcr", "Perform an LCR lookup", "Perform an LCR lookup",
 				   lcr_app_function, "<number>", SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC);
 	SWITCH_ADD_DIALPLAN(dp_interface, "lcr", lcr_dialplan_hunt);
+	switch_console_set_complete("add lcr_admin show profiles");
+	switch_console_set_complete("add lcr_admin reload");
 
 	lcr_endpoint_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_ENDPOINT_INTERFACE);
 	lcr_endpoint_interface->interface_name = "lcr";
 	lcr_endpoint_interface->io_routines = &lcr_io_routines;
 
+	/* the database keeps answering until the in-memory routes are there */
+	for (hi = switch_core_hash_first(globals.profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		profile = (profile_t *) val;
+		if (profile->memory_routes) {
+			lcr_mem_load_background(profile);
+		}
+	}
+
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lcr_shutdown)
 {
+	switch_hash_index_t *hi;
+	void *val;
+	profile_t *profile;
+
+	globals.shutdown = 1;
+	while (switch_atomic_read(&globals.loaders)) {
+		switch_yield(100000);
+	}
+
+	for (hi = switch_core_hash_first(globals.profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		profile = (profile_t *) val;
+		lcr_mem_table_destroy(&profile->mem[0]);
+		lcr_mem_table_destroy(&profile->mem[1]);
+	}
 
 	switch_core_hash_destroy(&globals.profile_hash);
 
@@ -0,0 +1,147 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * test_mod_lcr -- mod_lcr tests
+ *
+ */
+
+#include <test/switch_test.h>
+
+#define LCR_TEST_DSN "sqlite://lcr_test"
+
+/* the stock schema with sqlite types; d's rate runs out during the test, e's hasn't started and f's is over */
+static const char *lcr_test_sql[] = {
+	"DROP TABLE IF EXISTS lcr",
+	"DROP TABLE IF EXISTS carrier_gateway",
+	"DROP TABLE IF EXISTS carriers",
+	"CREATE TABLE carriers (id INTEGER PRIMARY KEY, carrier_name VARCHAR(255) NOT NULL, enabled INTEGER NOT NULL DEFAULT 1)",
+	"CREATE TABLE carrier_gateway (id INTEGER PRIMARY KEY, carrier_id INTEGER, prefix VARCHAR(128) NOT NULL DEFAULT '', "
+	"suffix VARCHAR(128) NOT NULL DEFAULT '', codec VARCHAR(128) NOT NULL DEFAULT '', enabled INTEGER NOT NULL DEFAULT 1)",
+	"CREATE TABLE lcr (id INTEGER PRIMARY KEY, digits NUMERIC(20, 0), rate NUMERIC(11, 5), intrastate_rate NUMERIC(11, 5), "
+	"intralata_rate NUMERIC(11, 5), carrier_id INTEGER NOT NULL, lead_strip INTEGER NOT NULL DEFAULT 0, trail_strip INTEGER NOT NULL DEFAULT 0, "
+	"prefix VARCHAR(16) NOT NULL DEFAULT '', suffix VARCHAR(16) NOT NULL DEFAULT '', lcr_profile INTEGER NOT NULL DEFAULT 0, "
+	"date_start TIMESTAMP NOT NULL DEFAULT '1970-01-01', date_end TIMESTAMP NOT NULL DEFAULT '2099-12-31', "
+	"quality NUMERIC(10, 6) NOT NULL DEFAULT 0, reliability NUMERIC(10, 6) NOT NULL DEFAULT 0, cid VARCHAR(32) NOT NULL DEFAULT '', "
+	"enabled INTEGER NOT NULL DEFAULT 1, lrn INTEGER NOT NULL DEFAULT 0)",
+	"INSERT INTO carriers (id, carrier_name, enabled) VALUES (1, 'a', 1), (2, 'b', 1), (3, 'c', 1), (4, 'd', 1), (5, 'e', 1), (6, 'f', 1), (7, 'g', 0)",
+	"INSERT INTO carrier_gateway (carrier_id, prefix) VALUES (1, 'sofia/gateway/a/'), (2, 'sofia/gateway/b/'), (3, 'sofia/gateway/c/'), "
+	"(4, 'sofia/gateway/d/'), (5, 'sofia/gateway/e/'), (6, 'sofia/gateway/f/'), (7, 'sofia/gateway/g/')",
+	"INSERT INTO lcr (digits, rate, intrastate_rate, intralata_rate, carrier_id) VALUES "
+	"(1, 0.10, 0.10, 0.10, 1), (1555, 0.05, 0.05, 0.05, 2), (15551, 0.07, 0.07, 0.07, 3), (1555, 0.01, 0.01, 0.01, 7)",
+	"INSERT INTO lcr (digits, rate, intrastate_rate, intralata_rate, carrier_id, date_end) VALUES "
+	"(15551, 0.04, 0.04, 0.04, 4, datetime('now', '+5 seconds')), (1555, 0.02, 0.02, 0.02, 6, '2000-01-01 00:00:00')",
+	"INSERT INTO lcr (digits, rate, intrastate_rate, intralata_rate, carrier_id, date_start) VALUES "
+	"(1555, 0.03, 0.03, 0.03, 5, datetime('now', '+1 day'))",
+	NULL
+};
+
+/* the same lookup through the database and the in-memory routes */
+static char *lcr_test_bench(void)
+{
+	switch_stream_handle_t stream = { 0 };
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute("lcr", "15551234567 default bench 1", NULL, &stream);
+
+	return (char *) stream.data;
+}
+
+static switch_bool_t lcr_test_routes(const char *out, const char *mode, int routes)
+{
+	char expect[64];
+
+	switch_snprintf(expect, sizeof(expect), "%-6s 1 lookups, %d routes,", mode, routes);
+
+	return out && strstr(out, expect) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+FST_CORE_BEGIN("conf")
+{
+	switch_cache_db_handle_t *dbh = NULL;
+	int i;
+
+	/* the tables have to be there when mod_lcr loads its profiles */
+	if (switch_cache_db_get_db_handle_dsn(&dbh, LCR_TEST_DSN) == SWITCH_STATUS_SUCCESS) {
+		for (i = 0; lcr_test_sql[i]; i++) {
+			switch_cache_db_execute_sql(dbh, (char *) lcr_test_sql[i], NULL);
+		}
+		switch_cache_db_release_db_handle(&dbh);
+	}
+
+	FST_MODULE_BEGIN(mod_lcr, mod_lcr_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+		}
+		FST_SETUP_END()
+
+		FST_TEST_BEGIN(memory_routes_match_sql)
+		{
+			switch_stream_handle_t stream = { 0 };
+			char *out;
+			int loaded = 0;
+
+			/* the first load runs in the background, wait for it and load again */
+			for (i = 0; i < 50 && !loaded; i++) {
+				SWITCH_STANDARD_STREAM(stream);
+				switch_api_execute("lcr_admin", "reload default", NULL, &stream);
+				loaded = stream.data && !strncmp(stream.data, "+OK", 3);
+				if (loaded) {
+					/* every enabled row that hasn't expired, e's included */
+					fst_check(strstr(stream.data, "+OK loaded 5 routes") != NULL);
+				}
+				switch_safe_free(stream.data);
+				if (!loaded) {
+					switch_yield(100000);
+				}
+			}
+			fst_requires(loaded);
+
+			/* c and d on 15551, b on 1555 and a on 1 */
+			out = lcr_test_bench();
+			fst_check(lcr_test_routes(out, "sql", 4));
+			fst_check(lcr_test_routes(out, "memory", 4));
+			fst_check(out && strstr(out, "route lists match"));
+			switch_safe_free(out);
+
+			/* d's date_end passes without a reload, both lookups drop it */
+			switch_sleep(6000000);
+			out = lcr_test_bench();
+			fst_check(lcr_test_routes(out, "sql", 3));
+			fst_check(lcr_test_routes(out, "memory", 3));
+			fst_check(out && strstr(out, "route lists match"));
+			switch_safe_free(out);
+		}
+		FST_TEST_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+	}
+	FST_MODULE_END()
+}
+FST_CORE_END()
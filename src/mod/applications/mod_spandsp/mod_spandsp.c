@@ -489,6 +489,35 @@ static void destroy_descriptor(void *ptr)
 	tone_descriptor_destroy(d);
 }
 
+#define SPANDSP_DETECT_SYNTAX "status|bench [<detectors> [<seconds>]]"
+/**
+ * Detection service status and benchmark
+ */
+SWITCH_STANDARD_API(spandsp_detect_api)
+{
+	char *mycmd = NULL, *argv[3] = { 0 };
+	int argc = 0;
+
+	if (!zstr(cmd) && (mycmd = strdup(cmd))) {
+		argc = switch_separate_string(mycmd, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (argc < 1 || !strcasecmp(argv[0], "status")) {
+		spandsp_detect_status(stream);
+	} else if (!strcasecmp(argv[0], "bench")) {
+		int detectors = argc > 1 ? atoi(argv[1]) : 100;
+		int seconds = argc > 2 ? atoi(argv[2]) : 1;
+
+		spandsp_detect_bench(detectors, seconds, stream);
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", SPANDSP_DETECT_SYNTAX);
+	}
+
+	switch_safe_free(mycmd);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 switch_status_t load_configuration(switch_bool_t reload)
 {
 	switch_xml_t xml = NULL, x_lists = NULL, x_list = NULL, cfg = NULL, callprogress = NULL, xdescriptor = NULL;
@@ -526,6 +555,10 @@ switch_status_t load_configuration(switch_bool_t reload)
 	spandsp_globals.header = "SpanDSP Fax Header";
 	spandsp_globals.timezone = "";
 	spandsp_globals.tonedebug = 0;
+	if (!reload) {
+		spandsp_globals.detect_threads = 0;
+		spandsp_globals.detect_tick_ms = 10;
+	}
 	spandsp_globals.t38_tx_reinvite_packet_count = 100;
 	spandsp_globals.t38_rx_reinvite_packet_count = 50;
 
@@ -680,6 +713,42 @@ switch_status_t load_configuration(switch_bool_t reload)
 			}
 		}
 
+		if ((x_lists = switch_xml_child(cfg, "detect-settings"))) {
+			for (x_list = switch_xml_child(x_lists, "param"); x_list; x_list = x_list->next) {
+				const char *name = switch_xml_attr(x_list, "name");
+				const char *value = switch_xml_attr(x_list, "value");
+
+				if (zstr(name) || zstr(value)) {
+					continue;
+				}
+
+				/* the workers are started once, at load */
+				if (reload) {
+					continue;
+				}
+
+				if (!strcmp(name, "threads")) {
+					int tmp = atoi(value);
+
+					if (tmp >= 0 && tmp <= 64) {
+						spandsp_globals.detect_threads = tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%d] for threads\n", tmp);
+					}
+				} else if (!strcmp(name, "tick-ms")) {
+					int tmp = atoi(value);
+
+					if (tmp >= 1 && tmp <= 100) {
+						spandsp_globals.detect_tick_ms = tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%d] for tick-ms\n", tmp);
+					}
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unknown parameter %s\n", name);
+				}
+			}
+		}
+
 		/* Configure call progress detector */
 		if ((callprogress = switch_xml_child(cfg, "descriptors"))) {
 			/* check if debugging is enabled */
@@ -870,6 +939,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_spandsp_init)
 		switch_console_set_complete("add spandsp_stop_tone_detect ::console::list_uuid");
 	}
 
+	SWITCH_ADD_API(api_interface, "spandsp_detect", "Inband detection service status and benchmark", spandsp_detect_api, SPANDSP_DETECT_SYNTAX);
+	switch_console_set_complete("add spandsp_detect status");
+	switch_console_set_complete("add spandsp_detect bench");
+
 	SWITCH_ADD_API(api_interface, "start_tdd_detect", "Start background tdd detection", start_tdd_detect_api, "<uuid>");
 	SWITCH_ADD_API(api_interface, "stop_tdd_detect", "Stop background tdd detection", stop_tdd_detect_api, "<uuid>");
 
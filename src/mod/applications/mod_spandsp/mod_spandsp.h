@@ -94,6 +94,8 @@ struct spandsp_globals {
 	char *modem_directory;
 	switch_hash_t *tones;
 	int tonedebug;
+	int detect_threads;
+	int detect_tick_ms;
     int t38_tx_reinvite_packet_count;
     int t38_rx_reinvite_packet_count;
 };
@@ -163,6 +165,9 @@ switch_status_t spandsp_inband_dtmf_session(switch_core_session_t *session);
 
 switch_status_t callprogress_detector_start(switch_core_session_t *session, const char *name);
 switch_status_t callprogress_detector_stop(switch_core_session_t *session);
+void spandsp_detect_status(switch_stream_handle_t *stream);
+void spandsp_detect_bench(int detectors, int seconds, switch_stream_handle_t *stream);
+void spandsp_detect_compare(const int16_t *amp, int samples, int twist, int reverse_twist, int threshold, char *scalar, char *batched, switch_size_t len);
 
 switch_status_t spandsp_fax_detect_session(switch_core_session_t *session,
 														   const char *flags, int timeout, int tone_type,
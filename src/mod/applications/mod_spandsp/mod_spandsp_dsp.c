@@ -34,6 +34,10 @@
  */
 
 #include "mod_spandsp.h"
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define TDD_LEAD 10
 
@@ -353,9 +357,678 @@ switch_status_t spandsp_tdd_decode_session(switch_core_session_t *session)
 
 ///XXX
 
+/*
+ * Shared detection service
+ *
+ * Instead of running a detector per media bug, sessions hand their 8kHz audio to a few
+ * worker threads.  Every tick a worker runs the DTMF Goertzel filters for up to
+ * SPANDSP_DETECT_LANES sessions at once and feeds the call progress detectors it owns.
+ * Digits are reported through the same realtime callback dtmf_rx() would use, tones are
+ * picked up by the media bug on its next frame.
+ */
+
+#define SPANDSP_DETECT_BLOCK 102
+#define SPANDSP_DETECT_LANES 4
+#define SPANDSP_DETECT_FIFO 8000
+#define SPANDSP_DETECT_MAX_BENCH 100
+#define SPANDSP_DETECT_MAX_BENCH_SECONDS 5
+
+/* the same decision constants dtmf_rx() uses in its floating point build (dtmf.c, !SPANDSP_USE_FIXED_POINT) */
+#define SPANDSP_DETECT_THRESHOLD 171032462.0f		/* -42dBm0 [((SPANDSP_DETECT_BLOCK*32768.0/1.4142)*10^((-42 - SPANDSP_DETECT_MAX_SINE_POWER)/20.0))^2] */
+#define SPANDSP_DETECT_NORMAL_TWIST 6.309f			/* 8dB [10.0^(8.0/10.0)] */
+#define SPANDSP_DETECT_REVERSE_TWIST 2.512f			/* 4dB [10.0^(4.0/10.0)] */
+#define SPANDSP_DETECT_RELATIVE_PEAK 6.309f			/* 8dB [10.0^(8.0/10.0)] */
+#define SPANDSP_DETECT_TO_TOTAL_ENERGY 83.868f		/* -0.85dB [SPANDSP_DETECT_BLOCK*10^(-0.85/10.0)] */
+#define SPANDSP_DETECT_POWER_OFFSET 110.395f		/* 10*log(32768.0*32768.0*SPANDSP_DETECT_BLOCK) */
+#define SPANDSP_DETECT_MAX_SINE_POWER 3.14f
+#define SPANDSP_DETECT_MAX_POWER (3.14f + 3.02f)
+
+typedef enum {
+	SPANDSP_DETECT_DTMF,
+	SPANDSP_DETECT_TONE
+} spandsp_detect_kind_t;
+
+/* runs a call progress detector over the samples on the worker, returns the reported tone or -1 */
+typedef int (*spandsp_detect_process_t)(void *user_data, const int16_t *amp, int samples);
+
+typedef struct spandsp_detect_worker spandsp_detect_worker_t;
+typedef struct spandsp_detect_lane spandsp_detect_lane_t;
+
+struct spandsp_detect_lane {
+	spandsp_detect_kind_t kind;
+	spandsp_detect_worker_t *worker;
+	void *user_data;
+
+	/* DTMF */
+	tone_report_func_t report;
+	float threshold;
+	float normal_twist;
+	float reverse_twist;
+	char last_hit;
+	char in_digit;
+	int duration;
+
+	/* TONE */
+	spandsp_detect_process_t process;
+	int result;
+
+	/* filled by the media bug under the worker mutex */
+	int16_t fifo[SPANDSP_DETECT_FIFO];
+	uint32_t fifo_len;
+	/* only touched by the worker */
+	int16_t work[SPANDSP_DETECT_FIFO + SPANDSP_DETECT_BLOCK];
+	uint32_t work_len;
+	uint32_t work_pos;
+
+	spandsp_detect_lane_t *next;
+};
+
+struct spandsp_detect_worker {
+	switch_thread_t *thread;
+	/* protects the fifos and lane results */
+	switch_mutex_t *mutex;
+	/* held for a whole tick, the lane list only changes with both mutexes held */
+	switch_mutex_t *run_mutex;
+	spandsp_detect_lane_t *lanes;
+	uint32_t lane_count;
+	uint64_t ticks;
+	uint64_t blocks;
+	uint64_t busy_us;
+	uint32_t max_us;
+	uint32_t dropped;
+};
+
+static struct {
+	spandsp_detect_worker_t *workers;
+	int workers_n;
+	int tick_ms;
+	volatile int running;
+	float fac[8];
+} detect_globals;
+
+static const char spandsp_detect_positions[] = "123A" "456B" "789C" "*0#D";
+static const float spandsp_detect_freqs[8] = { 697.0f, 770.0f, 852.0f, 941.0f, 1209.0f, 1336.0f, 1477.0f, 1633.0f };
+
+/* the filter coefficients exactly as make_goertzel_descriptor() computes them for dtmf_rx() */
+static void spandsp_detect_init_fac(void)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		detect_globals.fac[i] = 2.0f * cosf(2.0f * 3.14159f * (spandsp_detect_freqs[i] / 8000.0f));
+	}
+}
+
+/**
+ * Goertzel energies of the eight DTMF frequencies and the total energy of one block
+ *
+ * @param x the blocks, one per lane
+ * @param n the number of lanes, at most SPANDSP_DETECT_LANES
+ * @param out per lane, the row energies, the column energies and the block energy, scaled the
+ *            way goertzel_result() and dtmf_rx() scale them in spandsp's floating point build
+ */
+static void spandsp_detect_goertzel(const int16_t **x, int n, float out[][9])
+{
+	float in[SPANDSP_DETECT_BLOCK][SPANDSP_DETECT_LANES];
+	int i, j, k;
+
+	for (i = 0; i < SPANDSP_DETECT_BLOCK; i++) {
+		for (j = 0; j < SPANDSP_DETECT_LANES; j++) {
+			in[i][j] = j < n ? (float) x[j][i] : 0.0f;
+		}
+	}
+
+#if defined(__SSE2__)
+	{
+		__m128 v2[8], v3[8], energy = _mm_setzero_ps();
+		float r[SPANDSP_DETECT_LANES];
+
+		for (k = 0; k < 8; k++) {
+			v2[k] = v3[k] = _mm_setzero_ps();
+		}
+
+		for (i = 0; i < SPANDSP_DETECT_BLOCK; i++) {
+			__m128 s = _mm_loadu_ps(in[i]);
+
+			energy = _mm_add_ps(energy, _mm_mul_ps(s, s));
+
+			for (k = 0; k < 8; k++) {
+				__m128 v1 = v2[k];
+
+				v2[k] = v3[k];
+				v3[k] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(detect_globals.fac[k]), v2[k]), v1), s);
+			}
+		}
+
+		for (k = 0; k < 8; k++) {
+			__m128 fac = _mm_set1_ps(detect_globals.fac[k]), v1 = v2[k];
+
+			/* push a zero through the filter the way goertzel_result() finishes off */
+			v2[k] = v3[k];
+			v3[k] = _mm_sub_ps(_mm_mul_ps(fac, v2[k]), v1);
+
+			/* goertzel_result() doubles the result, the thresholds above count on that */
+			_mm_storeu_ps(r, _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(v3[k], v3[k]), _mm_mul_ps(v2[k], v2[k])),
+											   _mm_mul_ps(_mm_mul_ps(v3[k], v2[k]), fac)), _mm_set1_ps(2.0f)));
+
+			for (j = 0; j < n; j++) {
+				out[j][k] = r[j];
+			}
+		}
+
+		_mm_storeu_ps(r, energy);
+
+		for (j = 0; j < n; j++) {
+			out[j][8] = r[j];
+		}
+	}
+#else
+	for (j = 0; j < n; j++) {
+		float v2[8] = { 0 }, v3[8] = { 0 }, energy = 0.0f;
+
+		for (i = 0; i < SPANDSP_DETECT_BLOCK; i++) {
+			float s = in[i][j];
+
+			energy += s * s;
+
+			for (k = 0; k < 8; k++) {
+				float v1 = v2[k];
+
+				v2[k] = v3[k];
+				v3[k] = detect_globals.fac[k] * v2[k] - v1 + s;
+			}
+		}
+
+		for (k = 0; k < 8; k++) {
+			float v1 = v2[k];
+
+			/* push a zero through the filter the way goertzel_result() finishes off */
+			v2[k] = v3[k];
+			v3[k] = detect_globals.fac[k] * v2[k] - v1;
+
+			/* goertzel_result() doubles the result, the thresholds above count on that */
+			out[j][k] = (v3[k] * v3[k] + v2[k] * v2[k] - v3[k] * v2[k] * detect_globals.fac[k]) * 2.0f;
+		}
+
+		out[j][8] = energy;
+	}
+#endif
+}
+
+/**
+ * Decide on one block the way dtmf_rx() does and report digit changes
+ *
+ * @param lane the lane the block belongs to
+ * @param e the energies from spandsp_detect_goertzel()
+ */
+static void spandsp_detect_dtmf_decide(spandsp_detect_lane_t *lane, const float *e)
+{
+	const float *row = e, *col = e + 4;
+	int best_row = 0, best_col = 0, i;
+	char hit = 0;
+
+	for (i = 1; i < 4; i++) {
+		if (row[i] > row[best_row]) {
+			best_row = i;
+		}
+		if (col[i] > col[best_col]) {
+			best_col = i;
+		}
+	}
+
+	if (row[best_row] >= lane->threshold && col[best_col] >= lane->threshold &&
+		col[best_col] < row[best_row] * lane->reverse_twist && col[best_col] * lane->normal_twist > row[best_row]) {
+		for (i = 0; i < 4; i++) {
+			if ((i != best_col && col[i] * SPANDSP_DETECT_RELATIVE_PEAK > col[best_col]) ||
+				(i != best_row && row[i] * SPANDSP_DETECT_RELATIVE_PEAK > row[best_row])) {
+				break;
+			}
+		}
+
+		if (i >= 4 && row[best_row] + col[best_col] > SPANDSP_DETECT_TO_TOTAL_ENERGY * e[8]) {
+			hit = spandsp_detect_positions[(best_row << 2) + best_col];
+		}
+	}
+
+	lane->duration += SPANDSP_DETECT_BLOCK;
+
+	/* two successive blocks have to agree before a digit starts, anything else ends it */
+	if (hit != lane->in_digit && lane->last_hit != lane->in_digit) {
+		hit = (hit && hit == lane->last_hit) ? hit : 0;
+
+		if (lane->in_digit || hit) {
+			int level = (lane->in_digit && !hit) ? -99 : (int) lrintf(log10f(e[8]) * 10.0f - SPANDSP_DETECT_POWER_OFFSET + SPANDSP_DETECT_MAX_POWER);
+
+			lane->report(lane->user_data, hit, level, lane->duration);
+			lane->duration = 0;
+		}
+
+		lane->in_digit = hit;
+	}
+
+	lane->last_hit = hit;
+}
+
+/**
+ * Run the detectors over the work buffers of a list of lanes
+ *
+ * @param lanes the lanes
+ * @param worker the worker owning the lanes, NULL when benchmarking
+ * @return the number of DTMF blocks processed
+ */
+static uint32_t spandsp_detect_run(spandsp_detect_lane_t *lanes, spandsp_detect_worker_t *worker)
+{
+	spandsp_detect_lane_t *lane, *batch[SPANDSP_DETECT_LANES];
+	const int16_t *x[SPANDSP_DETECT_LANES];
+	float e[SPANDSP_DETECT_LANES][9];
+	uint32_t blocks = 0;
+	int n, i, more;
+
+	/* one block of every lane per pass so sessions fill up the batches */
+	do {
+		more = 0;
+		n = 0;
+
+		for (lane = lanes; lane; lane = lane->next) {
+			if (lane->kind != SPANDSP_DETECT_DTMF || lane->work_len - lane->work_pos < SPANDSP_DETECT_BLOCK) {
+				continue;
+			}
+
+			batch[n] = lane;
+			x[n] = lane->work + lane->work_pos;
+			lane->work_pos += SPANDSP_DETECT_BLOCK;
+
+			if (++n == SPANDSP_DETECT_LANES) {
+				spandsp_detect_goertzel(x, n, e);
+				for (i = 0; i < n; i++) {
+					spandsp_detect_dtmf_decide(batch[i], e[i]);
+				}
+				blocks += n;
+				n = 0;
+				more = 1;
+			}
+		}
+
+		if (n) {
+			spandsp_detect_goertzel(x, n, e);
+			for (i = 0; i < n; i++) {
+				spandsp_detect_dtmf_decide(batch[i], e[i]);
+			}
+			blocks += n;
+			more = 1;
+		}
+	} while (more);
+
+	for (lane = lanes; lane; lane = lane->next) {
+		if (lane->kind == SPANDSP_DETECT_DTMF) {
+			lane->work_len -= lane->work_pos;
+			memmove(lane->work, lane->work + lane->work_pos, lane->work_len * sizeof(int16_t));
+			lane->work_pos = 0;
+		} else if (lane->work_len) {
+			int code = lane->process(lane->user_data, lane->work, lane->work_len);
+
+			lane->work_len = 0;
+
+			if (code > -1 && worker) {
+				switch_mutex_lock(worker->mutex);
+				lane->result = code;
+				switch_mutex_unlock(worker->mutex);
+			}
+		}
+	}
+
+	return blocks;
+}
+
+static void spandsp_detect_tick(spandsp_detect_worker_t *worker)
+{
+	spandsp_detect_lane_t *lane;
+	switch_time_t start = switch_time_ref();
+	uint32_t blocks, us;
+
+	switch_mutex_lock(worker->run_mutex);
+
+	switch_mutex_lock(worker->mutex);
+	for (lane = worker->lanes; lane; lane = lane->next) {
+		memcpy(lane->work + lane->work_len, lane->fifo, lane->fifo_len * sizeof(int16_t));
+		lane->work_len += lane->fifo_len;
+		lane->fifo_len = 0;
+	}
+	switch_mutex_unlock(worker->mutex);
+
+	blocks = spandsp_detect_run(worker->lanes, worker);
+
+	us = (uint32_t) (switch_time_ref() - start);
+	worker->ticks++;
+	worker->blocks += blocks;
+	worker->busy_us += us;
+	if (us > worker->max_us) {
+		worker->max_us = us;
+	}
+
+	switch_mutex_unlock(worker->run_mutex);
+}
+
+static void *SWITCH_THREAD_FUNC spandsp_detect_thread(switch_thread_t *thread, void *obj)
+{
+	spandsp_detect_worker_t *worker = (spandsp_detect_worker_t *) obj;
+	switch_time_t next = switch_time_ref(), now;
+
+	while (detect_globals.running) {
+		spandsp_detect_tick(worker);
+
+		next += detect_globals.tick_ms * 1000;
+		now = switch_time_ref();
+
+		if (next > now) {
+			switch_yield(next - now);
+		} else {
+			next = now;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Allocate a lane on the least loaded worker, NULL if the service is not running
+ *
+ * The caller sets up the kind specific fields and then calls spandsp_detect_lane_start()
+ */
+static spandsp_detect_lane_t *spandsp_detect_lane_create(switch_core_session_t *session, spandsp_detect_kind_t kind, void *user_data)
+{
+	spandsp_detect_lane_t *lane;
+	int i, best = 0;
+
+	if (!detect_globals.running) {
+		return NULL;
+	}
+
+	for (i = 1; i < detect_globals.workers_n; i++) {
+		if (detect_globals.workers[i].lane_count < detect_globals.workers[best].lane_count) {
+			best = i;
+		}
+	}
+
+	lane = switch_core_session_alloc(session, sizeof(*lane));
+	lane->kind = kind;
+	lane->user_data = user_data;
+	lane->worker = &detect_globals.workers[best];
+	lane->result = -1;
+
+	return lane;
+}
+
+static void spandsp_detect_lane_start(spandsp_detect_lane_t *lane)
+{
+	spandsp_detect_worker_t *worker = lane->worker;
+
+	switch_mutex_lock(worker->run_mutex);
+	switch_mutex_lock(worker->mutex);
+	lane->next = worker->lanes;
+	worker->lanes = lane;
+	worker->lane_count++;
+	switch_mutex_unlock(worker->mutex);
+	switch_mutex_unlock(worker->run_mutex);
+}
+
+/* unlink the lane, once this returns the worker no longer touches it */
+static void spandsp_detect_lane_stop(spandsp_detect_lane_t *lane)
+{
+	spandsp_detect_worker_t *worker = lane->worker;
+	spandsp_detect_lane_t **lp;
+
+	switch_mutex_lock(worker->run_mutex);
+	switch_mutex_lock(worker->mutex);
+	for (lp = &worker->lanes; *lp; lp = &(*lp)->next) {
+		if (*lp == lane) {
+			*lp = lane->next;
+			worker->lane_count--;
+			break;
+		}
+	}
+	switch_mutex_unlock(worker->mutex);
+	switch_mutex_unlock(worker->run_mutex);
+}
+
+static void spandsp_detect_feed(spandsp_detect_lane_t *lane, const int16_t *amp, int samples)
+{
+	spandsp_detect_worker_t *worker = lane->worker;
+
+	switch_mutex_lock(worker->mutex);
+	if (samples > 0 && lane->fifo_len + samples <= SPANDSP_DETECT_FIFO) {
+		memcpy(lane->fifo + lane->fifo_len, amp, samples * sizeof(int16_t));
+		lane->fifo_len += samples;
+	} else if (samples > 0) {
+		worker->dropped++;
+	}
+	switch_mutex_unlock(worker->mutex);
+}
+
+/* the last tone reported by the worker since the previous call, -1 if none */
+static int spandsp_detect_result(spandsp_detect_lane_t *lane)
+{
+	spandsp_detect_worker_t *worker = lane->worker;
+	int code;
+
+	switch_mutex_lock(worker->mutex);
+	code = lane->result;
+	lane->result = -1;
+	switch_mutex_unlock(worker->mutex);
+
+	return code;
+}
+
+static void spandsp_detect_dtmf_parms(spandsp_detect_lane_t *lane, int twist, int reverse_twist, int threshold)
+{
+	lane->threshold = SPANDSP_DETECT_THRESHOLD;
+	lane->normal_twist = SPANDSP_DETECT_NORMAL_TWIST;
+	lane->reverse_twist = SPANDSP_DETECT_REVERSE_TWIST;
+
+	if (twist >= 0) {
+		lane->normal_twist = powf(10.0f, twist / 10.0f);
+	}
+
+	if (reverse_twist >= 0) {
+		lane->reverse_twist = powf(10.0f, reverse_twist / 10.0f);
+	}
+
+	if (threshold > -99) {
+		float x = (SPANDSP_DETECT_BLOCK * 32768.0f / 1.4142f) * powf(10.0f, (threshold - SPANDSP_DETECT_MAX_SINE_POWER) / 20.0f);
+
+		lane->threshold = x * x;
+	}
+}
+
+void spandsp_detect_status(switch_stream_handle_t *stream)
+{
+	int i;
+
+	if (!detect_globals.running) {
+		stream->write_function(stream, "detection service disabled, detectors run in the media bugs\n");
+		return;
+	}
+
+	stream->write_function(stream, "%d workers, %dms tick, %d lanes per batch\n", detect_globals.workers_n, detect_globals.tick_ms, SPANDSP_DETECT_LANES);
+
+	for (i = 0; i < detect_globals.workers_n; i++) {
+		spandsp_detect_worker_t *worker = &detect_globals.workers[i];
+
+		stream->write_function(stream, "worker %d: lanes %u ticks %" SWITCH_UINT64_T_FMT " blocks %" SWITCH_UINT64_T_FMT " avg-tick %" SWITCH_UINT64_T_FMT "us max-tick %uus dropped %u\n",
+							   i, worker->lane_count, worker->ticks, worker->blocks, worker->ticks ? worker->busy_us / worker->ticks : 0,
+							   worker->max_us, worker->dropped);
+	}
+}
+
+static void spandsp_detect_bench_report(void *user_data, int code, int level, int delay)
+{
+	if (code) {
+		(*(uint32_t *) user_data)++;
+	}
+}
+
+typedef struct {
+	char *digits;
+	switch_size_t len;
+	switch_size_t used;
+} spandsp_detect_digits_t;
+
+static void spandsp_detect_compare_report(void *user_data, int code, int level, int delay)
+{
+	spandsp_detect_digits_t *d = (spandsp_detect_digits_t *) user_data;
+
+	if (code && d->used + 1 < d->len) {
+		d->digits[d->used++] = (char) code;
+		d->digits[d->used] = '\0';
+	}
+}
+
+/**
+ * Run dtmf_rx() and the batched detector over the same audio, 20ms at a time
+ *
+ * @param amp the 8kHz audio
+ * @param samples the number of samples
+ * @param twist, reverse_twist, threshold as for dtmf_rx_parms(), -1, -1 and -99 for the defaults
+ * @param scalar receives the digits dtmf_rx() reported
+ * @param batched receives the digits the batched detector reported
+ * @param len the size of both digit buffers
+ */
+void spandsp_detect_compare(const int16_t *amp, int samples, int twist, int reverse_twist, int threshold, char *scalar, char *batched, switch_size_t len)
+{
+	spandsp_detect_digits_t scalar_digits = { scalar, len, 0 }, batch_digits = { batched, len, 0 };
+	dtmf_rx_state_t *state;
+	spandsp_detect_lane_t *lane;
+	int i, n;
+
+	if (len < 1) {
+		return;
+	}
+
+	*scalar = *batched = '\0';
+	spandsp_detect_init_fac();
+
+	state = dtmf_rx_init(NULL, NULL, NULL);
+	dtmf_rx_parms(state, 0, twist, reverse_twist, threshold);
+	dtmf_rx_set_realtime_callback(state, spandsp_detect_compare_report, &scalar_digits);
+
+	switch_zmalloc(lane, sizeof(*lane));
+	lane->kind = SPANDSP_DETECT_DTMF;
+	lane->user_data = &batch_digits;
+	lane->report = spandsp_detect_compare_report;
+	spandsp_detect_dtmf_parms(lane, twist, reverse_twist, threshold);
+
+	for (i = 0; i < samples; i += n) {
+		n = samples - i < 160 ? samples - i : 160;
+
+		dtmf_rx(state, amp + i, n);
+
+		memcpy(lane->work + lane->work_len, amp + i, n * sizeof(int16_t));
+		lane->work_len += n;
+		spandsp_detect_run(lane, NULL);
+	}
+
+	dtmf_rx_free(state);
+	free(lane);
+}
+
+/**
+ * Compare one dtmf_rx() per session with the batched detector on the same audio
+ *
+ * Runs on the caller's thread so the sizes are kept small, the digit comparison lives in
+ * the module's unit test.
+ *
+ * @param detectors the number of concurrent detectors
+ * @param seconds the seconds of audio each detector gets
+ * @param stream where the results are written
+ */
+void spandsp_detect_bench(int detectors, int seconds, switch_stream_handle_t *stream)
+{
+	static const char digits[] = "159D";
+	int16_t *audio;
+	dtmf_rx_state_t **states;
+	spandsp_detect_lane_t *lanes, *list = NULL;
+	uint32_t scalar_digits = 0, batch_digits = 0;
+	switch_time_t start, scalar_us, batch_us;
+	int i, d, s, f, frames = seconds * 50;
+
+	if (detectors < 1 || detectors > SPANDSP_DETECT_MAX_BENCH || seconds < 1 || seconds > SPANDSP_DETECT_MAX_BENCH_SECONDS) {
+		stream->write_function(stream, "-ERR detectors must be 1-%d and seconds 1-%d\n", SPANDSP_DETECT_MAX_BENCH, SPANDSP_DETECT_MAX_BENCH_SECONDS);
+		return;
+	}
+
+	/* a second of 100ms digits at -10dBm0 per tone, each followed by 150ms of silence */
+	switch_zmalloc(audio, 8000 * sizeof(int16_t));
+	for (i = 0; i < (int) strlen(digits); i++) {
+		const char *p = strchr(spandsp_detect_positions, digits[i]);
+		int pos = (int) (p - spandsp_detect_positions);
+		float f1 = spandsp_detect_freqs[pos >> 2], f2 = spandsp_detect_freqs[4 + (pos & 3)];
+
+		for (s = 0; s < 800; s++) {
+			float t = (float) s / 8000.0f;
+
+			audio[i * 2000 + s] = (int16_t) (7200.0f * (sinf(2.0f * (float) M_PI * f1 * t) + sinf(2.0f * (float) M_PI * f2 * t)));
+		}
+	}
+
+	switch_zmalloc(states, detectors * sizeof(*states));
+	for (d = 0; d < detectors; d++) {
+		states[d] = dtmf_rx_init(NULL, NULL, NULL);
+		dtmf_rx_set_realtime_callback(states[d], spandsp_detect_bench_report, &scalar_digits);
+	}
+
+	start = switch_time_ref();
+	for (f = 0; f < frames; f++) {
+		for (d = 0; d < detectors; d++) {
+			dtmf_rx(states[d], audio + (f % 50) * 160, 160);
+		}
+	}
+	scalar_us = switch_time_ref() - start;
+
+	for (d = 0; d < detectors; d++) {
+		dtmf_rx_free(states[d]);
+	}
+	free(states);
+
+	switch_zmalloc(lanes, detectors * sizeof(*lanes));
+	for (d = 0; d < detectors; d++) {
+		lanes[d].kind = SPANDSP_DETECT_DTMF;
+		lanes[d].user_data = &batch_digits;
+		lanes[d].report = spandsp_detect_bench_report;
+		spandsp_detect_dtmf_parms(&lanes[d], -1, -1, -100);
+		lanes[d].next = list;
+		list = &lanes[d];
+	}
+
+	start = switch_time_ref();
+	for (f = 0; f < frames; f++) {
+		for (d = 0; d < detectors; d++) {
+			memcpy(lanes[d].work + lanes[d].work_len, audio + (f % 50) * 160, 160 * sizeof(int16_t));
+			lanes[d].work_len += 160;
+		}
+		spandsp_detect_run(list, NULL);
+	}
+	batch_us = switch_time_ref() - start;
+
+	free(lanes);
+	free(audio);
+
+	stream->write_function(stream, "%d detectors, %ds of audio each\n", detectors, seconds);
+	stream->write_function(stream, "dtmf_rx:  %" SWITCH_TIME_T_FMT "us, %u digits, %.0f detectors per core\n",
+						   scalar_us, scalar_digits, scalar_us ? (double) detectors * seconds * 1000000 / scalar_us : 0.0);
+	stream->write_function(stream, "batched:  %" SWITCH_TIME_T_FMT "us, %u digits, %.0f detectors per core (%s)\n",
+						   batch_us, batch_digits, batch_us ? (double) detectors * seconds * 1000000 / batch_us : 0.0,
+#if defined(__SSE2__)
+						   "sse2"
+#else
+						   "scalar"
+#endif
+		);
+}
+
 typedef struct {
 	switch_core_session_t *session;
 	dtmf_rx_state_t *dtmf_detect;
+	spandsp_detect_lane_t *lane;
 	int verbose;
 	char last_digit;
 	uint32_t samples;
@@ -405,6 +1078,14 @@ static switch_bool_t inband_dtmf_callback(switch_media_bug_t *bug, void *user_da
 
 	switch (type) {
 	case SWITCH_ABC_TYPE_INIT: {
+		/* the service has no dial tone filter and no spandsp logging, those stay on dtmf_rx() */
+		if (pvt->filter_dialtone != 1 && !pvt->verbose && (pvt->lane = spandsp_detect_lane_create(pvt->session, SPANDSP_DETECT_DTMF, pvt))) {
+			pvt->lane->report = spandsp_dtmf_rx_realtime_callback;
+			spandsp_detect_dtmf_parms(pvt->lane, pvt->twist, pvt->reverse_twist, pvt->threshold);
+			spandsp_detect_lane_start(pvt->lane);
+			break;
+		}
+
 		pvt->dtmf_detect = dtmf_rx_init(NULL, NULL, NULL);
 		{
 			mod_spandsp_log_data_t *log_data = switch_core_session_alloc(pvt->session, sizeof(*log_data));
@@ -420,6 +1101,11 @@ static switch_bool_t inband_dtmf_callback(switch_media_bug_t *bug, void *user_da
 		break;
 	}
 	case SWITCH_ABC_TYPE_CLOSE:
+		if (pvt->lane) {
+			spandsp_detect_lane_stop(pvt->lane);
+			pvt->lane = NULL;
+		}
+
 		if (pvt->dtmf_detect) {
 			dtmf_rx_free(pvt->dtmf_detect);
 		}
@@ -471,7 +1157,11 @@ static switch_bool_t inband_dtmf_callback(switch_media_bug_t *bug, void *user_da
 				samples = pvt->resampler->to_len;
 			}
 
-			dtmf_rx(pvt->dtmf_detect, dp, samples);
+			if (pvt->lane) {
+				spandsp_detect_feed(pvt->lane, dp, samples);
+			} else {
+				dtmf_rx(pvt->dtmf_detect, dp, samples);
+			}
 			switch_core_media_bug_set_read_replace_frame(bug, frame);
 		}
 		break;
@@ -611,6 +1301,9 @@ struct tone_detector {
 
 	/** The session that owns this detector */
 	switch_core_session_t *session;
+
+	/** The detection service lane, NULL when detecting in the media bug */
+	spandsp_detect_lane_t *lane;
 };
 typedef struct tone_detector tone_detector_t;
 
@@ -823,6 +1516,24 @@ static switch_bool_t tone_detector_process_buffer(tone_detector_t *detector, voi
 	return SWITCH_FALSE;
 }
 
+/**
+ * Process audio on a detection service worker
+ *
+ * @param user_data the tone_detector
+ * @param amp the audio
+ * @param samples the number of samples
+ * @return the detected tone or -1
+ */
+static int tone_detector_process_lane(void *user_data, const int16_t *amp, int samples)
+{
+	tone_detector_t *detector = (tone_detector_t *)user_data;
+
+	detector->detected_tone = -1;
+	super_tone_rx(detector->spandsp_detector, amp, samples);
+
+	return detector->detected_tone;
+}
+
 /**
  * Destroy the tone detector
  * @param detector the detector to destroy
@@ -830,6 +1541,10 @@ static switch_bool_t tone_detector_process_buffer(tone_detector_t *detector, voi
 static void tone_detector_destroy(tone_detector_t *detector)
 {
 	if (detector) {
+		if (detector->lane) {
+			spandsp_detect_lane_stop(detector->lane);
+			detector->lane = NULL;
+		}
 		if (detector->spandsp_detector) {
 			super_tone_rx_release(detector->spandsp_detector);
 			super_tone_rx_free(detector->spandsp_detector);
@@ -904,6 +1619,10 @@ static switch_bool_t callprogress_detector_process_buffer(switch_media_bug_t *bu
 	case SWITCH_ABC_TYPE_INIT:
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "initializing tone detector\n");
 		tone_detector_init(detector);
+		if ((detector->lane = spandsp_detect_lane_create(session, SPANDSP_DETECT_TONE, detector))) {
+			detector->lane->process = tone_detector_process_lane;
+			spandsp_detect_lane_start(detector->lane);
+		}
 		break;
 	case SWITCH_ABC_TYPE_READ_REPLACE:
 	{
@@ -917,7 +1636,17 @@ static switch_bool_t callprogress_detector_process_buffer(switch_media_bug_t *bu
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "error reading frame\n");
 			return SWITCH_FALSE;
 		}
-		tone_detector_process_buffer(detector, frame->data, frame->samples, &detected_tone);
+		if (detector->lane) {
+			int code;
+
+			/* a tone found by the worker is reported from here so execute_on and api_on run on the session */
+			spandsp_detect_feed(detector->lane, frame->data, frame->samples);
+			if ((code = spandsp_detect_result(detector->lane)) > -1 && code <= detector->descriptor->idx && code < MAX_TONES) {
+				detected_tone = detector->descriptor->tone_keys[code];
+			}
+		} else {
+			tone_detector_process_buffer(detector, frame->data, frame->samples, &detected_tone);
+		}
 		if (detected_tone) {
 			switch_event_t *event = NULL;
 			switch_channel_t *channel = switch_core_session_get_channel(session);
@@ -972,6 +1701,33 @@ switch_status_t callprogress_detector_stop(switch_core_session_t *session)
  */
 switch_status_t mod_spandsp_dsp_load(switch_loadable_module_interface_t **module_interface, switch_memory_pool_t *pool)
 {
+	int i;
+
+	spandsp_detect_init_fac();
+
+	detect_globals.tick_ms = spandsp_globals.detect_tick_ms > 0 ? spandsp_globals.detect_tick_ms : 10;
+
+	if (spandsp_globals.detect_threads > 0) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		detect_globals.workers_n = spandsp_globals.detect_threads;
+		detect_globals.workers = switch_core_alloc(pool, detect_globals.workers_n * sizeof(spandsp_detect_worker_t));
+		detect_globals.running = 1;
+
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+		for (i = 0; i < detect_globals.workers_n; i++) {
+			spandsp_detect_worker_t *worker = &detect_globals.workers[i];
+
+			switch_mutex_init(&worker->mutex, SWITCH_MUTEX_NESTED, pool);
+			switch_mutex_init(&worker->run_mutex, SWITCH_MUTEX_NESTED, pool);
+			switch_thread_create(&worker->thread, thd_attr, spandsp_detect_thread, worker, pool);
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Started %d detection workers with a %dms tick\n", detect_globals.workers_n, detect_globals.tick_ms);
+	}
+
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -981,7 +1737,19 @@ switch_status_t mod_spandsp_dsp_load(switch_loadable_module_interface_t **module
  */
 void mod_spandsp_dsp_shutdown(void)
 {
-	return;
+	int i;
+
+	if (detect_globals.running) {
+		switch_status_t st;
+
+		detect_globals.running = 0;
+
+		for (i = 0; i < detect_globals.workers_n; i++) {
+			switch_thread_join(&st, detect_globals.workers[i].thread);
+		}
+	}
+
+	memset(&detect_globals, 0, sizeof(detect_globals));
 }
 
 
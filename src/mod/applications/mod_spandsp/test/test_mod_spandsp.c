@@ -0,0 +1,200 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * test_mod_spandsp -- mod_spandsp tests
+ *
+ */
+
+
+#include <test/switch_test.h>
+#include "mod_spandsp.h"
+
+#define SPANDSP_TEST_MAX_SAMPLES (8000 * 10)
+
+static const char spandsp_test_positions[] = "123A" "456B" "789C" "*0#D";
+static const float spandsp_test_freqs[8] = { 697.0f, 770.0f, 852.0f, 941.0f, 1209.0f, 1336.0f, 1477.0f, 1633.0f };
+
+static int16_t spandsp_test_audio[SPANDSP_TEST_MAX_SAMPLES];
+static int spandsp_test_len;
+static uint32_t spandsp_test_seed;
+
+/* peak amplitude of a sine at the given level, a full scale sine is +3.14dBm0 */
+static float spandsp_test_amplitude(float dbm0)
+{
+	return 32767.0f * powf(10.0f, (dbm0 - 3.14f) / 20.0f);
+}
+
+/* small deterministic noise so the energy test has something to chew on */
+static float spandsp_test_noise(float dbm0)
+{
+	spandsp_test_seed = spandsp_test_seed * 1103515245 + 12345;
+
+	return spandsp_test_amplitude(dbm0) * (((float) ((spandsp_test_seed >> 16) & 0x7fff) / 16384.0f) - 1.0f);
+}
+
+static void spandsp_test_add(float sample)
+{
+	if (spandsp_test_len < SPANDSP_TEST_MAX_SAMPLES) {
+		if (sample > 32767.0f) {
+			sample = 32767.0f;
+		} else if (sample < -32768.0f) {
+			sample = -32768.0f;
+		}
+		spandsp_test_audio[spandsp_test_len++] = (int16_t) sample;
+	}
+}
+
+static void spandsp_test_reset(void)
+{
+	spandsp_test_len = 0;
+	spandsp_test_seed = 1;
+}
+
+/* a digit with its row and column tone at their own levels, then a gap, both over -60dBm0 noise */
+static void spandsp_test_digit(char digit, float row_dbm0, float col_dbm0, int ms, int gap_ms)
+{
+	int pos = (int) (strchr(spandsp_test_positions, digit) - spandsp_test_positions);
+	float f1 = spandsp_test_freqs[pos >> 2], f2 = spandsp_test_freqs[4 + (pos & 3)];
+	float a1 = spandsp_test_amplitude(row_dbm0), a2 = spandsp_test_amplitude(col_dbm0);
+	int s;
+
+	for (s = 0; s < ms * 8; s++) {
+		float t = (float) s / 8000.0f;
+
+		spandsp_test_add(a1 * sinf(2.0f * (float) M_PI * f1 * t) + a2 * sinf(2.0f * (float) M_PI * f2 * t) + spandsp_test_noise(-60.0f));
+	}
+
+	for (s = 0; s < gap_ms * 8; s++) {
+		spandsp_test_add(spandsp_test_noise(-60.0f));
+	}
+}
+
+/* voiced speech stand-in, harmonics of a gliding pitch shaped by two moving formants */
+static void spandsp_test_speech(float dbm0, int ms)
+{
+	float a = spandsp_test_amplitude(dbm0) / 4.0f, phase[40] = { 0 };
+	int s, h;
+
+	for (s = 0; s < ms * 8; s++) {
+		float t = (float) s / 8000.0f;
+		float pitch = 140.0f + 60.0f * sinf(2.0f * (float) M_PI * 1.3f * t);
+		float f1 = 700.0f + 300.0f * sinf(2.0f * (float) M_PI * 2.1f * t);
+		float f2 = 1300.0f + 500.0f * sinf(2.0f * (float) M_PI * 1.7f * t);
+		float sample = 0.0f;
+
+		for (h = 1; h < 40 && h * pitch < 3800.0f; h++) {
+			float f = h * pitch;
+			float g = 1.0f / (1.0f + powf((f - f1) / 150.0f, 2.0f)) + 0.7f / (1.0f + powf((f - f2) / 200.0f, 2.0f));
+
+			phase[h] += 2.0f * (float) M_PI * f / 8000.0f;
+			sample += a * g * sinf(phase[h]);
+		}
+
+		spandsp_test_add(sample + spandsp_test_noise(-50.0f));
+	}
+}
+
+FST_CORE_BEGIN("conf")
+{
+	FST_SUITE_BEGIN(test_mod_spandsp)
+	{
+		FST_SETUP_BEGIN()
+		{
+			spandsp_test_reset();
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(batched_dtmf_matches_dtmf_rx_near_threshold)
+		{
+			char scalar[64], batched[64];
+
+			/* the default threshold is -42dBm0 per tone, right at it the two only have to agree */
+			spandsp_test_digit('1', -30.0f, -30.0f, 100, 100);
+			spandsp_test_digit('2', -38.0f, -38.0f, 100, 100);
+			spandsp_test_digit('3', -40.0f, -40.0f, 100, 100);
+			spandsp_test_digit('4', -41.0f, -41.0f, 100, 100);
+			spandsp_test_digit('5', -42.0f, -42.0f, 100, 100);
+			spandsp_test_digit('6', -43.0f, -43.0f, 100, 100);
+			spandsp_test_digit('7', -46.0f, -46.0f, 100, 100);
+
+			spandsp_detect_compare(spandsp_test_audio, spandsp_test_len, -1, -1, -99, scalar, batched, sizeof(scalar));
+			fst_check_string_equals(batched, scalar);
+			fst_check(!strncmp(scalar, "1234", 4));
+			fst_check(strchr(scalar, '6') == NULL);
+			fst_check(strchr(scalar, '7') == NULL);
+
+			/* a custom threshold moves both the same way */
+			spandsp_detect_compare(spandsp_test_audio, spandsp_test_len, -1, -1, -35, scalar, batched, sizeof(scalar));
+			fst_check_string_equals(batched, scalar);
+			fst_check_string_equals(scalar, "1");
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(batched_dtmf_matches_dtmf_rx_with_twist)
+		{
+			char scalar[64], batched[64];
+
+			/* 6dB normal twist passes, 10dB doesn't, 2dB reverse twist passes, 6dB doesn't */
+			spandsp_test_digit('1', -20.0f, -26.0f, 100, 100);
+			spandsp_test_digit('5', -20.0f, -30.0f, 100, 100);
+			spandsp_test_digit('9', -22.0f, -20.0f, 100, 100);
+			spandsp_test_digit('D', -26.0f, -20.0f, 100, 100);
+			spandsp_test_digit('0', -35.0f, -41.0f, 100, 100);
+
+			spandsp_detect_compare(spandsp_test_audio, spandsp_test_len, -1, -1, -99, scalar, batched, sizeof(scalar));
+			fst_check_string_equals(batched, scalar);
+			fst_check_string_equals(scalar, "190");
+
+			/* wider twist limits let everything through */
+			spandsp_detect_compare(spandsp_test_audio, spandsp_test_len, 12, 8, -99, scalar, batched, sizeof(scalar));
+			fst_check_string_equals(batched, scalar);
+			fst_check_string_equals(scalar, "159D0");
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(batched_dtmf_matches_dtmf_rx_on_talk_off)
+		{
+			char scalar[64], batched[64];
+
+			spandsp_test_speech(-15.0f, 3000);
+			spandsp_test_digit('#', -20.0f, -20.0f, 60, 100);
+			spandsp_test_speech(-10.0f, 3000);
+
+			/* only the real digit gets through, and both detectors agree on it */
+			spandsp_detect_compare(spandsp_test_audio, spandsp_test_len, -1, -1, -99, scalar, batched, sizeof(scalar));
+			fst_check_string_equals(batched, scalar);
+			fst_check_string_equals(scalar, "#");
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
@@ -40,6 +40,10 @@
 
 #define SWITCH_OPUS_MIN_FEC_BITRATE 12400
 
+#define SWITCH_OPUS_MAX_COMPLEXITY 10
+#define SWITCH_OPUS_MIN_COMPLEXITY 2
+#define SWITCH_OPUS_CPU_TARGET 50
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load);
 SWITCH_MODULE_DEFINITION(mod_opus, mod_opus_load, NULL, NULL);
 
@@ -144,6 +148,22 @@ struct opus_context {
 	enc_stats_t encoder_stats;
 	codec_control_state_t control_state;
 	switch_bool_t recreate_decoder;
+
+	/* encoder cpu controller, see opus_load */
+	switch_codec_t *codec;
+	int complexity;
+	int complexity_cfg;
+	int fec_shed;
+	switch_time_t encode_last;
+	switch_time_t encode_avg;
+	switch_time_t encode_max;
+	switch_time_t encode_us;
+	uint64_t encode_frames;
+	switch_time_t load_check;
+	switch_time_t load_us;
+	switch_time_t load_share;
+	int loaded;
+	struct opus_context *next;
 };
 
 struct {
@@ -163,12 +183,25 @@ struct {
 	switch_bool_t use_jb_lookahead;
 	switch_mutex_t *mutex;
 	switch_bool_t mono;
+	int complexity_min;
+	uint32_t cpu_target;
 } opus_prefs;
 
 static struct {
 	int debug;
 } globals;
 
+/* encode time spent by all opus encoders, each one adds its last second and adjusts its complexity to the total */
+static struct {
+	switch_mutex_t *mutex;
+	switch_time_t load_us;
+	uint32_t load_pct;
+	uint32_t encoders_count;
+	uint64_t encode_frames;
+	switch_time_t encode_us;
+	struct opus_context *encoders;
+} opus_load;
+
 static switch_bool_t switch_opus_acceptable_rate(int rate)
 {
 	if (rate != 8000 && rate != 12000 && rate != 16000 && rate != 24000 && rate != 48000) {
@@ -519,6 +552,109 @@ static switch_status_t switch_opus_info(switch_core_session_t *session, void * e
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void switch_opus_load_add(struct opus_context *context)
+{
+	switch_mutex_lock(opus_load.mutex);
+	context->next = opus_load.encoders;
+	opus_load.encoders = context;
+	opus_load.encoders_count++;
+	context->loaded = 1;
+	switch_mutex_unlock(opus_load.mutex);
+}
+
+static void switch_opus_load_del(struct opus_context *context)
+{
+	struct opus_context *cp, *last = NULL;
+
+	if (!context->loaded) return;
+
+	switch_mutex_lock(opus_load.mutex);
+	for (cp = opus_load.encoders; cp; last = cp, cp = cp->next) {
+		if (cp == context) {
+			if (last) {
+				last->next = cp->next;
+			} else {
+				opus_load.encoders = cp->next;
+			}
+			opus_load.encoders_count--;
+			break;
+		}
+	}
+	opus_load.load_us -= context->load_share;
+	context->load_share = 0;
+	context->loaded = 0;
+	switch_mutex_unlock(opus_load.mutex);
+}
+
+/* once a second: publish this encoder's encode time and trade complexity for cpu while all encoders together
+   run over cpu-target percent of the cores. Inband FEC costs a second SILK pass, so it goes first on legs
+   that report no loss and comes back as soon as they do. */
+static void switch_opus_load_check(switch_codec_t *codec, switch_time_t now)
+{
+	struct opus_context *context = codec->private_info;
+	int complexity = context->complexity;
+	uint32_t pct, cpus = switch_core_cpu_count();
+
+	if (!context->load_check) {
+		context->load_check = now;
+		return;
+	}
+
+	if (now - context->load_check < 1000000) return;
+
+	switch_mutex_lock(opus_load.mutex);
+	opus_load.load_us += context->load_us - context->load_share;
+	context->load_share = context->load_us;
+	pct = (uint32_t)(opus_load.load_us * 100 / ((switch_time_t)(cpus ? cpus : 1) * (now - context->load_check)));
+	opus_load.load_pct = pct;
+	switch_mutex_unlock(opus_load.mutex);
+
+	context->load_check = now;
+	context->load_us = 0;
+
+	if (!opus_prefs.cpu_target) return;
+
+	if (pct > opus_prefs.cpu_target) {
+		if (!context->fec_shed && !context->old_plpct && context->codec_settings.useinbandfec) {
+			context->fec_shed = 1;
+			opus_encoder_ctl(context->encoder_object, OPUS_SET_INBAND_FEC(0));
+		} else if (complexity > opus_prefs.complexity_min) {
+			complexity--;
+		}
+	} else if (pct < opus_prefs.cpu_target * 3 / 4) {
+		if (complexity < context->complexity_cfg) {
+			complexity++;
+		} else if (context->fec_shed) {
+			context->fec_shed = 0;
+			opus_encoder_ctl(context->encoder_object, OPUS_SET_INBAND_FEC(1));
+		}
+	}
+
+	if (complexity != context->complexity) {
+		if (globals.debug || context->debug) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(codec->session), SWITCH_LOG_DEBUG,
+							  "Opus encoder: load %u%%, complexity %d -> %d\n", pct, context->complexity, complexity);
+		}
+		context->complexity = complexity;
+		opus_encoder_ctl(context->encoder_object, OPUS_SET_COMPLEXITY(complexity));
+	}
+}
+
+static void switch_opus_load_frame(switch_codec_t *codec, switch_time_t start)
+{
+	struct opus_context *context = codec->private_info;
+	switch_time_t now = switch_time_now();
+
+	context->encode_last = now - start;
+	context->encode_avg = context->encode_avg ? (context->encode_avg * 15 + context->encode_last) / 16 : context->encode_last;
+	if (context->encode_last > context->encode_max) context->encode_max = context->encode_last;
+	context->encode_frames++;
+	context->encode_us += context->encode_last;
+	context->load_us += context->encode_last;
+
+	switch_opus_load_check(codec, now);
+}
+
 static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag_t flags, const switch_codec_settings_t *codec_settings)
 {
 	struct opus_context *context = NULL;
@@ -652,6 +788,9 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_COMPLEXITY(complexity));
 		}
 
+		opus_encoder_ctl(context->encoder_object, OPUS_GET_COMPLEXITY(&context->complexity));
+		context->complexity_cfg = context->complexity;
+
 		if (plpct) {
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_PACKET_LOSS_PERC(plpct));
 		}
@@ -680,6 +819,9 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 		if (opus_prefs.adjust_bitrate) {
 			switch_set_flag(codec, SWITCH_CODEC_FLAG_HAS_ADJ_BITRATE);
 		}
+
+		context->codec = codec;
+		switch_opus_load_add(context);
 	}
 
 	if (decoding) {
@@ -710,6 +852,7 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot create decoder: %s\n", opus_strerror(err));
 
 			if (context->encoder_object) {
+				switch_opus_load_del(context);
 				opus_encoder_destroy(context->encoder_object);
 				context->encoder_object = NULL;
 			}
@@ -756,6 +899,13 @@ static switch_status_t switch_opus_destroy(switch_codec_t *codec)
 							"Opus encoder stats: FEC frames (only for debug mode) [%d]\n", context->encoder_stats.fec_counter);
 				}
 			}
+
+			switch_opus_load_del(context);
+			switch_mutex_lock(opus_load.mutex);
+			opus_load.encode_frames += context->encode_frames;
+			opus_load.encode_us += context->encode_us;
+			switch_mutex_unlock(opus_load.mutex);
+
 			opus_encoder_destroy(context->encoder_object);
 			context->encoder_object = NULL;
 		}
@@ -775,12 +925,15 @@ static switch_status_t switch_opus_encode(switch_codec_t *codec,
 	struct opus_context *context = codec->private_info;
 	int bytes = 0;
 	int len = (int) *encoded_data_len;
+	switch_time_t start;
 
 	if (!context) {
 		return SWITCH_STATUS_FALSE;
 	}
 
+	start = switch_time_now();
 	bytes = opus_encode(context->encoder_object, (void *) decoded_data, context->enc_frame_size, (unsigned char *) encoded_data, len);
+	switch_opus_load_frame(codec, start);
 
 	if (globals.debug || context->debug > 1) {
 		int samplerate = context->enc_frame_size * 1000 / (codec->implementation->microseconds_per_packet / 1000);
@@ -957,6 +1110,7 @@ static switch_status_t switch_opus_encode_repacketize(switch_codec_t *codec,
 	opus_int32 ret = 0;
 	opus_int32 total_len = 0;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_time_t start = switch_time_now();
 
 	if (!context) {
 		switch_goto_status(SWITCH_STATUS_FALSE, end);
@@ -1034,6 +1188,10 @@ end:
 		opus_repacketizer_destroy(rp);
 	}
 
+	if (context) {
+		switch_opus_load_frame(codec, start);
+	}
+
 	return status;
 }
 
@@ -1055,6 +1213,8 @@ static switch_status_t opus_load_config(switch_bool_t reload)
 	opus_prefs.plpct = 20;
 	opus_prefs.use_vbr = 0;
 	opus_prefs.fec_decode = 1;
+	opus_prefs.complexity_min = SWITCH_OPUS_MIN_COMPLEXITY;
+	opus_prefs.cpu_target = SWITCH_OPUS_CPU_TARGET;
 
 	if ((settings = switch_xml_child(cfg, "settings"))) {
 		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
@@ -1098,6 +1258,16 @@ static switch_status_t opus_load_config(switch_bool_t reload)
 				}
 			} else if (!strcasecmp(key, "mono")) {
 				opus_prefs.mono = switch_true(val);
+			} else if (!strcasecmp(key, "complexity-min")) {
+				opus_prefs.complexity_min = atoi(val);
+				if (opus_prefs.complexity_min < 0 || opus_prefs.complexity_min > SWITCH_OPUS_MAX_COMPLEXITY) {
+					opus_prefs.complexity_min = SWITCH_OPUS_MIN_COMPLEXITY;
+				}
+			} else if (!strcasecmp(key, "cpu-target")) { /* encoder, percent of all cores opus encoding may use before complexity is lowered, 0 disables */
+				int tmp = switch_false(val) ? 0 : atoi(val);
+				if (tmp >= 0 && tmp <= 100) {
+					opus_prefs.cpu_target = tmp;
+				}
 			}
 		}
 	}
@@ -1248,6 +1418,12 @@ static switch_status_t switch_opus_control(switch_codec_t *codec,
 				plpct = 100;
 			}
 
+			/* the peer loses packets, FEC is worth its cpu again */
+			if (plpct && context->fec_shed) {
+				context->fec_shed = 0;
+				opus_encoder_ctl(context->encoder_object, OPUS_SET_INBAND_FEC(1));
+			}
+
 			if (opus_prefs.keep_fec) {
 				opus_encoder_ctl(context->encoder_object, OPUS_SET_PACKET_LOSS_PERC(plpct));
 			} else {
@@ -1360,6 +1536,40 @@ static switch_status_t switch_opus_control(switch_codec_t *codec,
 
 	return SWITCH_STATUS_SUCCESS;
 }
+#define OPUS_STATUS_SYNTAX ""
+SWITCH_STANDARD_API(mod_opus_status)
+{
+	struct opus_context *cp;
+	uint64_t frames;
+	switch_time_t encode_us;
+
+	switch_mutex_lock(opus_load.mutex);
+	frames = opus_load.encode_frames;
+	encode_us = opus_load.encode_us;
+	for (cp = opus_load.encoders; cp; cp = cp->next) {
+		frames += cp->encode_frames;
+		encode_us += cp->encode_us;
+	}
+
+	stream->write_function(stream, "encoders %u load %u%% cpu-target %u%% complexity-min %d frames %" SWITCH_UINT64_T_FMT " avg %" SWITCH_TIME_T_FMT "us\n",
+						   opus_load.encoders_count, opus_load.load_pct, opus_prefs.cpu_target, opus_prefs.complexity_min,
+						   frames, frames ? encode_us / (switch_time_t)frames : 0);
+
+	for (cp = opus_load.encoders; cp; cp = cp->next) {
+		switch_core_session_t *esession = cp->codec->session;
+
+		stream->write_function(stream, "%s %dms complexity %d/%d fec %s loss %u%% last %" SWITCH_TIME_T_FMT "us avg %" SWITCH_TIME_T_FMT
+							   "us max %" SWITCH_TIME_T_FMT "us frames %" SWITCH_UINT64_T_FMT "\n",
+							   esession ? switch_core_session_get_uuid(esession) : "-",
+							   cp->codec->implementation->microseconds_per_packet / 1000, cp->complexity, cp->complexity_cfg,
+							   !cp->codec_settings.useinbandfec ? "off" : cp->fec_shed ? "shed" : "on", cp->old_plpct,
+							   cp->encode_last, cp->encode_avg, cp->encode_max, cp->encode_frames);
+	}
+	switch_mutex_unlock(opus_load.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 #define OPUS_DEBUG_SYNTAX "<on|off>"
 SWITCH_STANDARD_API(mod_opus_debug)
 {
@@ -1400,11 +1610,14 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 		return status;
 	}
 
+	switch_mutex_init(&opus_load.mutex, SWITCH_MUTEX_NESTED, pool);
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
 	SWITCH_ADD_CODEC(codec_interface, "OPUS (STANDARD)");
 	SWITCH_ADD_API(commands_api_interface, "opus_debug", "Set OPUS Debug", mod_opus_debug, OPUS_DEBUG_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "opus_status", "Show OPUS encoder load", mod_opus_status, OPUS_STATUS_SYNTAX);
 
 	switch_console_set_complete("add opus_debug on");
 	switch_console_set_complete("add opus_debug off");
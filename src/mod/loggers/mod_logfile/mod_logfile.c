@@ -31,6 +31,10 @@
  */
 
 #include <switch.h>
+#include <zlib.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_logfile_shutdown);
@@ -39,14 +43,30 @@ SWITCH_MODULE_DEFINITION(mod_logfile, mod_logfile_load, mod_logfile_shutdown, NU
 #define DEFAULT_LIMIT	 0xA00000	/* About 10 MB */
 #define WARM_FUZZY_OFFSET 256
 #define MAX_ROT 4096			/* why not */
+#define DEFAULT_FLUSH_INTERVAL 100	/* ms */
+#define LOGFILE_URING_DEPTH 64
+#define LOGFILE_API_SYNTAX "status | bench <profile> <lines> [<line_bytes>]"
 
 static switch_memory_pool_t *module_pool = NULL;
 static switch_hash_t *profile_hash = NULL;
 
+typedef struct logfile_profile logfile_profile_t;
+
 static struct {
 	int rotate;
 	switch_mutex_t *mutex;
 	switch_event_node_t *node;
+	uint32_t flush_interval;
+	switch_bool_t io_uring;
+	logfile_profile_t *buffered;
+	switch_thread_t *writer;
+	switch_mutex_t *writer_mutex;
+	switch_thread_cond_t *writer_cond;
+	int writer_running;
+#ifdef HAVE_LIBURING
+	struct io_uring ring;
+	int ring_ready;
+#endif
 } globals;
 
 struct logfile_profile {
@@ -60,10 +80,31 @@ struct logfile_profile {
 	uint32_t all_level;
 	uint32_t suffix;			/* suffix of the highest logfile name */
 	switch_bool_t log_uuid;
+	switch_bool_t compress;		/* gzip rotated files in the background */
+	switch_mutex_t *compress_mutex;
+	switch_thread_cond_t *compress_cond;
+	int compressing;			/* a rotated file is being compressed, the next rotation waits for it */
+	switch_size_t buffer_size;	/* 0 writes each line from the log thread */
+	switch_bool_t block_when_full;	/* wait for the writer thread instead of dropping lines */
+	char *fill_buf;				/* lines are appended here by the log thread */
+	switch_size_t fill_len;
+	char *flush_buf;			/* the writer thread writes this one out */
+	switch_size_t flush_len;
+	switch_size_t flush_done;
+	int flushing;
+	switch_mutex_t *buf_mutex;
+	logfile_profile_t *next_buffered;
+	uint64_t lines;
+	uint64_t bytes;
+	uint64_t flushes;
+	uint64_t dropped;
+	uint64_t dropped_pending;	/* drops not yet noted in the file */
+	uint64_t rotations;
+	uint64_t write_errors;
+	switch_time_t flush_time;
+	switch_time_t flush_time_max;
 };
 
-typedef struct logfile_profile logfile_profile_t;
-
 static switch_status_t load_profile(switch_xml_t xml);
 
 #if 0
@@ -85,6 +126,147 @@ static void add_mapping(logfile_profile_t *profile, char *var, char *val)
 
 static switch_status_t mod_logfile_rotate(logfile_profile_t *profile);
 
+typedef struct {
+	logfile_profile_t *profile;
+	char *filename;
+} logfile_compress_job_t;
+
+static void *SWITCH_THREAD_FUNC logfile_compress_thread(switch_thread_t *thread, void *obj)
+{
+	logfile_compress_job_t *job = (logfile_compress_job_t *) obj;
+	logfile_profile_t *profile = job->profile;
+	char *filename = job->filename;
+	char *gzname = switch_mprintf("%s.gz", filename);
+	char *buf = malloc(65536);
+	FILE *in = NULL;
+	gzFile out = NULL;
+	size_t bytes;
+	int ok = 0;
+
+	switch_assert(gzname && buf);
+
+	if (!(in = fopen(filename, "rb")) || !(out = gzopen(gzname, "wb6"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error compressing log %s [%s]\n", filename, strerror(errno));
+		goto end;
+	}
+
+	ok = 1;
+	while ((bytes = fread(buf, 1, 65536, in)) > 0) {
+		if (gzwrite(out, buf, (unsigned) bytes) != (int) bytes) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error writing %s\n", gzname);
+			ok = 0;
+			break;
+		}
+	}
+
+  end:
+
+	if (out && gzclose(out) != Z_OK) {
+		ok = 0;
+	}
+
+	if (in) {
+		fclose(in);
+	}
+
+	if (ok) {
+		remove(filename);
+	} else if (out) {
+		remove(gzname);
+	}
+
+	switch_safe_free(gzname);
+	free(buf);
+	free(filename);
+	free(job);
+
+	switch_mutex_lock(profile->compress_mutex);
+	profile->compressing = 0;
+	switch_thread_cond_broadcast(profile->compress_cond);
+	switch_mutex_unlock(profile->compress_mutex);
+
+	return NULL;
+}
+
+/* the next rotation renames the file being compressed and its .gz, let the gzip finish first */
+static void logfile_compress_wait(logfile_profile_t *profile)
+{
+	if (!profile->compress_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(profile->compress_mutex);
+	while (profile->compressing) {
+		switch_thread_cond_wait(profile->compress_cond, profile->compress_mutex);
+	}
+	switch_mutex_unlock(profile->compress_mutex);
+}
+
+/* the wait is done before globals.mutex so a long gzip never stalls the writers, a compression started
+   by another rotation in between is caught by the recheck under the lock */
+static void logfile_rotate_lock(logfile_profile_t *profile)
+{
+	for (;;) {
+		int compressing = 0;
+
+		logfile_compress_wait(profile);
+		switch_mutex_lock(globals.mutex);
+
+		if (profile->compress_mutex) {
+			switch_mutex_lock(profile->compress_mutex);
+			compressing = profile->compressing;
+			switch_mutex_unlock(profile->compress_mutex);
+		}
+
+		if (!compressing) {
+			break;
+		}
+
+		switch_mutex_unlock(globals.mutex);
+	}
+}
+
+/* true if rotated file number idx is there, compressed or not */
+static switch_bool_t logfile_rotated_exists(logfile_profile_t *profile, unsigned int idx, switch_memory_pool_t *pool)
+{
+	char *name = switch_mprintf("%s.%u", profile->logfile, idx);
+	char *gzname = switch_mprintf("%s.%u.gz", profile->logfile, idx);
+	switch_bool_t r;
+
+	r = (switch_file_exists(name, pool) == SWITCH_STATUS_SUCCESS || switch_file_exists(gzname, pool) == SWITCH_STATUS_SUCCESS) ? SWITCH_TRUE : SWITCH_FALSE;
+
+	switch_safe_free(name);
+	switch_safe_free(gzname);
+
+	return r;
+}
+
+/* hand a rotated file to the core thread pool so the gzip doesn't hold up logging */
+static void logfile_compress(logfile_profile_t *profile, const char *filename)
+{
+	switch_thread_data_t *td;
+	logfile_compress_job_t *job;
+
+	switch_zmalloc(job, sizeof(*job));
+	job->profile = profile;
+	job->filename = strdup(filename);
+
+	switch_zmalloc(td, sizeof(*td));
+	td->func = logfile_compress_thread;
+	td->obj = job;
+	td->alloc = 1;
+
+	switch_mutex_lock(profile->compress_mutex);
+	profile->compressing = 1;
+	switch_mutex_unlock(profile->compress_mutex);
+
+	if (switch_thread_pool_launch_thread(&td) != SWITCH_STATUS_SUCCESS) {
+		switch_mutex_lock(profile->compress_mutex);
+		profile->compressing = 0;
+		switch_mutex_unlock(profile->compress_mutex);
+	}
+}
+
 static switch_status_t mod_logfile_openlogfile(logfile_profile_t *profile, switch_bool_t check)
 {
 	unsigned int flags = 0;
@@ -126,8 +308,9 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 	char date[80] = "";
 	switch_size_t retsize;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	const char *ext = profile->compress ? ".gz" : "";
 
-	switch_mutex_lock(globals.mutex);
+	logfile_rotate_lock(profile);
 
 	switch_time_exp_lt(&tm, switch_micro_time_now());
 	switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d-%H-%M-%S", &tm);
@@ -152,8 +335,22 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 		to_filename = switch_core_alloc(pool, strlen(profile->logfile) + WARM_FUZZY_OFFSET);
 
 		for (i=profile->suffix; i>1; i--) {
-			sprintf((char *) to_filename, "%s.%i", profile->logfile, i);
-			sprintf((char *) from_filename, "%s.%i", profile->logfile, i-1);
+			if (*ext) {
+				/* a file whose compression failed, or from a run without compress, moves along too */
+				sprintf((char *) to_filename, "%s.%i", profile->logfile, i);
+				sprintf((char *) from_filename, "%s.%i", profile->logfile, i-1);
+
+				if (switch_file_exists(from_filename, pool) == SWITCH_STATUS_SUCCESS) {
+					switch_file_remove(to_filename, pool);
+					if (switch_file_rename(from_filename, to_filename, pool) != SWITCH_STATUS_SUCCESS) {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error renaming log from %s to %s [%s]\n",
+										  from_filename, to_filename, strerror(errno));
+					}
+				}
+			}
+
+			sprintf((char *) to_filename, "%s.%i%s", profile->logfile, i, ext);
+			sprintf((char *) from_filename, "%s.%i%s", profile->logfile, i-1, ext);
 
 			if (switch_file_exists(to_filename, pool) == SWITCH_STATUS_SUCCESS) {
 				if ((status = switch_file_remove(to_filename, pool)) != SWITCH_STATUS_SUCCESS) {
@@ -171,6 +368,12 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 			}
 		}
 
+		if (*ext) {
+			/* the gzip of the new .1 would silently replace an old .1.gz that could not be moved */
+			sprintf((char *) to_filename, "%s.%i%s", profile->logfile, i, ext);
+			switch_file_remove(to_filename, pool);
+		}
+
 		sprintf((char *) to_filename, "%s.%i", profile->logfile, i);
 
 		if (switch_file_exists(to_filename, pool) == SWITCH_STATUS_SUCCESS) {
@@ -193,6 +396,11 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 			profile->suffix++;
 		}
 
+		profile->rotations++;
+		if (profile->compress) {
+			logfile_compress(profile, to_filename);
+		}
+
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "New log started: %s\n", profile->logfile);
 
 		goto end;
@@ -211,6 +419,11 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error Rotating Log!\n");
 			goto end;
 		}
+
+		profile->rotations++;
+		if (profile->compress) {
+			logfile_compress(profile, filename);
+		}
 		break;
 	}
 
@@ -227,6 +440,124 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 	return status;
 }
 
+/* write all of data, reopening the file once if the write fails, globals.mutex held */
+static switch_status_t logfile_write_direct(logfile_profile_t *profile, const char *data, switch_size_t len)
+{
+	switch_size_t done = 0;
+	int reopened = 0;
+
+	while (done < len) {
+		switch_size_t bytes = len - done;
+
+		if (!profile->log_afd || switch_file_write(profile->log_afd, data + done, &bytes) != SWITCH_STATUS_SUCCESS || !bytes) {
+			if (reopened++) {
+				profile->write_errors++;
+				return SWITCH_STATUS_FALSE;
+			}
+			if (profile->log_afd) {
+				switch_file_close(profile->log_afd);
+				profile->log_afd = NULL;
+			}
+			if (mod_logfile_openlogfile(profile, SWITCH_FALSE) != SWITCH_STATUS_SUCCESS) {
+				profile->write_errors++;
+				return SWITCH_STATUS_FALSE;
+			}
+			continue;
+		}
+		done += bytes;
+	}
+
+	profile->log_size += len;
+	profile->bytes += len;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* a line that can never fit the buffer goes straight to the file once the buffered lines before it are out */
+static switch_status_t mod_logfile_oversized_write(logfile_profile_t *profile, const char *log_data, switch_size_t len)
+{
+	switch_status_t status;
+
+	switch_mutex_lock(profile->buf_mutex);
+
+	/* the writer owns flush_buf until it is done with it, and it can only pick up more under buf_mutex */
+	while (profile->flushing && globals.writer_running) {
+		switch_mutex_unlock(profile->buf_mutex);
+		switch_thread_cond_signal(globals.writer_cond);
+		switch_yield(1000);
+		switch_mutex_lock(profile->buf_mutex);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if (profile->fill_len) {
+		logfile_write_direct(profile, profile->fill_buf, profile->fill_len);
+		profile->fill_len = 0;
+	}
+	if ((status = logfile_write_direct(profile, log_data, len)) == SWITCH_STATUS_SUCCESS) {
+		profile->lines++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	switch_mutex_unlock(profile->buf_mutex);
+
+	if (profile->roll_size && profile->log_size >= profile->roll_size) {
+		mod_logfile_rotate(profile);
+	}
+
+	return status;
+}
+
+/* append to the profile buffer, the writer thread does the actual write */
+static switch_status_t mod_logfile_buffer_write(logfile_profile_t *profile, const char *log_data, switch_size_t len)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	char note[80] = "";
+	switch_size_t note_len = 0;
+	int wake;
+
+	if (len + sizeof(note) > profile->buffer_size) {
+		return mod_logfile_oversized_write(profile, log_data, len);
+	}
+
+	switch_mutex_lock(profile->buf_mutex);
+
+	while (profile->block_when_full && len <= profile->buffer_size && profile->fill_len + len > profile->buffer_size && globals.writer_running) {
+		switch_mutex_unlock(profile->buf_mutex);
+		switch_thread_cond_signal(globals.writer_cond);
+		switch_yield(1000);
+		switch_mutex_lock(profile->buf_mutex);
+	}
+
+	if (profile->dropped_pending) {
+		note_len = switch_snprintf(note, sizeof(note), "[%" SWITCH_UINT64_T_FMT " log lines dropped, buffer full]\n", profile->dropped_pending);
+	}
+
+	if (profile->fill_len + note_len + len > profile->buffer_size) {
+		/* by default never stall the log thread on a slow disk, the next line that fits notes the gap */
+		profile->dropped++;
+		profile->dropped_pending++;
+		status = SWITCH_STATUS_FALSE;
+		wake = 1;
+	} else {
+		if (note_len) {
+			memcpy(profile->fill_buf + profile->fill_len, note, note_len);
+			profile->fill_len += note_len;
+			profile->dropped_pending = 0;
+		}
+		memcpy(profile->fill_buf + profile->fill_len, log_data, len);
+		profile->fill_len += len;
+		profile->lines++;
+		wake = profile->fill_len >= profile->buffer_size / 2;
+	}
+	switch_mutex_unlock(profile->buf_mutex);
+
+	if (wake) {
+		switch_thread_cond_signal(globals.writer_cond);
+	}
+
+	return status;
+}
+
 /* write to the actual logfile */
 static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *log_data)
 {
@@ -238,6 +569,10 @@ static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *l
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (profile->buffer_size) {
+		return mod_logfile_buffer_write(profile, log_data, len);
+	}
+
 	switch_mutex_lock(globals.mutex);
 
 	if (switch_file_write(profile->log_afd, log_data, &len) != SWITCH_STATUS_SUCCESS) {
@@ -252,6 +587,8 @@ static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *l
 
 	if (status == SWITCH_STATUS_SUCCESS) {
 		profile->log_size += len;
+		profile->bytes += len;
+		profile->lines++;
 
 		if (profile->roll_size && profile->log_size >= profile->roll_size) {
 			mod_logfile_rotate(profile);
@@ -261,6 +598,264 @@ static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *l
 	return status;
 }
 
+/* write the rest of flush_buf, flush_done keeps the position across a failed write and reopen */
+static switch_status_t logfile_write_pending(logfile_profile_t *profile)
+{
+	while (profile->flush_done < profile->flush_len) {
+		switch_size_t bytes = profile->flush_len - profile->flush_done;
+
+		if (switch_file_write(profile->log_afd, profile->flush_buf + profile->flush_done, &bytes) != SWITCH_STATUS_SUCCESS || !bytes) {
+			return SWITCH_STATUS_FALSE;
+		}
+		profile->flush_done += bytes;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#ifdef HAVE_LIBURING
+/* one submission for every profile with pending data, whatever isn't written here goes through logfile_write_pending() */
+static void logfile_uring_exit(void)
+{
+	if (globals.ring_ready) {
+		globals.ring_ready = 0;
+		io_uring_queue_exit(&globals.ring);
+	}
+}
+
+static void logfile_uring_write(logfile_profile_t **profiles, int count)
+{
+	int i, ret, submitted = 0, disable = 0;
+
+	for (i = 0; i < count; i++) {
+		struct io_uring_sqe *sqe;
+		switch_os_file_t fd;
+
+		if (switch_os_file_get(&fd, profiles[i]->log_afd) != SWITCH_STATUS_SUCCESS || !(sqe = io_uring_get_sqe(&globals.ring))) {
+			continue;
+		}
+
+		/* offset -1 uses the file position, the file is O_APPEND anyway */
+		io_uring_prep_write(sqe, fd, profiles[i]->flush_buf, (unsigned) profiles[i]->flush_len, (uint64_t) -1);
+		io_uring_sqe_set_data(sqe, profiles[i]);
+		submitted++;
+	}
+
+	if (!submitted) {
+		return;
+	}
+
+	if ((ret = io_uring_submit(&globals.ring)) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io_uring submit failed, falling back to write()\n");
+		/* nothing is in flight, drop the prepared entries with the ring so no later submit picks them up */
+		logfile_uring_exit();
+		return;
+	}
+
+	if (ret < submitted) {
+		/* entries the kernel did not take would go out with a later submit, the ring goes once the rest is reaped */
+		disable = 1;
+	}
+
+	/* every write the kernel took has to be reaped before its flush_buf is touched again */
+	for (i = 0; i < ret; i++) {
+		struct io_uring_cqe *cqe;
+		logfile_profile_t *profile;
+		int wret;
+
+		while ((wret = io_uring_wait_cqe(&globals.ring, &cqe)) == -EINTR || wret == -EAGAIN);
+
+		if (wret < 0) {
+			/* the ring is unusable, leave it set up but unused rather than tear it down under pending writes */
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io_uring wait failed (%s), falling back to write()\n", strerror(-wret));
+			globals.ring_ready = 0;
+			return;
+		}
+
+		profile = (logfile_profile_t *) io_uring_cqe_get_data(cqe);
+
+		if (cqe->res > 0) {
+			profile->flush_done = (switch_size_t) cqe->res;
+		} else if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io_uring writes not supported here, falling back to write()\n");
+			disable = 1;
+		}
+
+		io_uring_cqe_seen(&globals.ring, cqe);
+	}
+
+	if (disable) {
+		/* everything submitted is reaped, the ring can go */
+		logfile_uring_exit();
+	}
+}
+#endif
+
+static void logfile_flush_profiles(logfile_profile_t **profiles, int count)
+{
+	switch_time_t start = switch_micro_time_now();
+	int i;
+
+	switch_mutex_lock(globals.mutex);
+
+#ifdef HAVE_LIBURING
+	if (globals.ring_ready) {
+		logfile_uring_write(profiles, count);
+	}
+#endif
+
+	for (i = 0; i < count; i++) {
+		logfile_profile_t *profile = profiles[i];
+
+		if (logfile_write_pending(profile) != SWITCH_STATUS_SUCCESS) {
+			switch_file_close(profile->log_afd);
+			profile->log_afd = NULL;
+			if (mod_logfile_openlogfile(profile, SWITCH_FALSE) != SWITCH_STATUS_SUCCESS || logfile_write_pending(profile) != SWITCH_STATUS_SUCCESS) {
+				profile->write_errors++;
+				continue;
+			}
+		}
+
+		profile->log_size += profile->flush_len;
+		profile->bytes += profile->flush_len;
+	}
+
+	switch_mutex_unlock(globals.mutex);
+
+	for (i = 0; i < count; i++) {
+		logfile_profile_t *profile = profiles[i];
+		switch_time_t took = switch_micro_time_now() - start;
+
+		profile->flushes++;
+		profile->flush_time += took;
+		if (took > profile->flush_time_max) {
+			profile->flush_time_max = took;
+		}
+
+		/* rotation happens here on the writer thread, off the logging path */
+		if (profile->roll_size && profile->log_size >= profile->roll_size) {
+			mod_logfile_rotate(profile);
+		}
+
+		switch_mutex_lock(profile->buf_mutex);
+		profile->flush_len = 0;
+		profile->flushing = 0;
+		switch_mutex_unlock(profile->buf_mutex);
+	}
+}
+
+static void logfile_flush_all(void)
+{
+	logfile_profile_t *profiles[LOGFILE_URING_DEPTH];
+	logfile_profile_t *profile;
+	int count = 0;
+
+	for (profile = globals.buffered; profile; profile = profile->next_buffered) {
+		char *buf;
+
+		switch_mutex_lock(profile->buf_mutex);
+		if (profile->fill_len) {
+			buf = profile->flush_buf;
+			profile->flush_buf = profile->fill_buf;
+			profile->flush_len = profile->fill_len;
+			profile->flush_done = 0;
+			profile->flushing = 1;
+			profile->fill_buf = buf;
+			profile->fill_len = 0;
+		}
+		switch_mutex_unlock(profile->buf_mutex);
+
+		if (profile->flushing) {
+			profiles[count++] = profile;
+		}
+
+		if (count == LOGFILE_URING_DEPTH) {
+			logfile_flush_profiles(profiles, count);
+			count = 0;
+		}
+	}
+
+	if (count) {
+		logfile_flush_profiles(profiles, count);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC logfile_writer_thread(switch_thread_t *thread, void *obj)
+{
+#ifdef HAVE_LIBURING
+	if (globals.io_uring) {
+		int ret;
+
+		if ((ret = io_uring_queue_init(LOGFILE_URING_DEPTH, &globals.ring, 0)) == 0) {
+			globals.ring_ready = 1;
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io_uring unavailable (%s), using write()\n", strerror(-ret));
+		}
+	}
+#endif
+
+	switch_mutex_lock(globals.writer_mutex);
+	while (globals.writer_running) {
+		switch_thread_cond_timedwait(globals.writer_cond, globals.writer_mutex, (switch_interval_time_t) globals.flush_interval * 1000);
+		switch_mutex_unlock(globals.writer_mutex);
+		logfile_flush_all();
+		switch_mutex_lock(globals.writer_mutex);
+	}
+	switch_mutex_unlock(globals.writer_mutex);
+
+	logfile_flush_all();
+
+#ifdef HAVE_LIBURING
+	logfile_uring_exit();
+#endif
+
+	return NULL;
+}
+
+static void logfile_writer_start(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	if (globals.writer || !globals.buffered) {
+		return;
+	}
+
+	globals.writer_running = 1;
+	switch_threadattr_create(&thd_attr, module_pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&globals.writer, thd_attr, logfile_writer_thread, NULL, module_pool);
+}
+
+static void logfile_writer_stop(void)
+{
+	switch_status_t st;
+
+	if (!globals.writer) {
+		return;
+	}
+
+	switch_mutex_lock(globals.writer_mutex);
+	globals.writer_running = 0;
+	switch_thread_cond_signal(globals.writer_cond);
+	switch_mutex_unlock(globals.writer_mutex);
+
+	switch_thread_join(&st, globals.writer);
+	globals.writer = NULL;
+}
+
+static const char *logfile_backend(logfile_profile_t *profile)
+{
+	if (!profile->buffer_size) {
+		return "sync";
+	}
+#ifdef HAVE_LIBURING
+	if (globals.ring_ready) {
+		return "io_uring";
+	}
+#endif
+	return "write";
+}
+
 static switch_status_t process_node(const switch_log_node_t *node, switch_log_level_t level)
 {
 	switch_hash_index_t *hi;
@@ -328,6 +923,7 @@ static void cleanup_profile(void *ptr)
 {
 	logfile_profile_t *profile = (logfile_profile_t *) ptr;
 
+	logfile_compress_wait(profile);
 	switch_core_hash_destroy(&profile->log_hash);
 	switch_file_close(profile->log_afd);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Closing %s\n", profile->logfile);
@@ -364,6 +960,12 @@ static switch_status_t load_profile(switch_xml_t xml)
 				}
 			} else if (!strcmp(var, "uuid")) {
 				new_profile->log_uuid = switch_true(val);
+			} else if (!strcmp(var, "buffer-size")) {
+				new_profile->buffer_size = switch_atoui(val);
+			} else if (!strcmp(var, "compress")) {
+				new_profile->compress = switch_true(val);
+			} else if (!strcmp(var, "buffer-full")) {
+				new_profile->block_when_full = !strcasecmp(val, "block");
 			}
 		}
 	}
@@ -383,10 +985,32 @@ static switch_status_t load_profile(switch_xml_t xml)
 		new_profile->logfile = strdup(logfile);
 	}
 
+	if (new_profile->compress) {
+		switch_mutex_init(&new_profile->compress_mutex, SWITCH_MUTEX_NESTED, module_pool);
+		switch_thread_cond_create(&new_profile->compress_cond, module_pool);
+	}
+
+	if (new_profile->max_rot) {
+		/* carry on from the rotated files a previous run left, .gz ones included */
+		while (new_profile->suffix < new_profile->max_rot && logfile_rotated_exists(new_profile, new_profile->suffix, module_pool)) {
+			new_profile->suffix++;
+		}
+	}
+
 	if (mod_logfile_openlogfile(new_profile, SWITCH_TRUE) != SWITCH_STATUS_SUCCESS) {
 		return SWITCH_STATUS_GENERR;
 	}
 
+	if (new_profile->buffer_size) {
+		/* whole pages, the writer thread writes a buffer at a time */
+		new_profile->buffer_size = (new_profile->buffer_size + 4095) & ~((switch_size_t) 4095);
+		new_profile->fill_buf = switch_core_alloc(module_pool, new_profile->buffer_size);
+		new_profile->flush_buf = switch_core_alloc(module_pool, new_profile->buffer_size);
+		switch_mutex_init(&new_profile->buf_mutex, SWITCH_MUTEX_NESTED, module_pool);
+		new_profile->next_buffered = globals.buffered;
+		globals.buffered = new_profile;
+	}
+
 	switch_core_hash_insert_destructor(profile_hash, new_profile->name, (void *) new_profile, cleanup_profile);
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -422,15 +1046,126 @@ static void event_handler(switch_event_t *event)
 	}
 }
 
+static void logfile_bench(logfile_profile_t *profile, int lines, int line_bytes, switch_stream_handle_t *stream)
+{
+	char *line = malloc(line_bytes + 1);
+	uint64_t dropped = profile->dropped, bytes = profile->bytes;
+	switch_time_t start, produced, done;
+	int i;
+
+	switch_assert(line);
+	memset(line, 'x', line_bytes);
+	line[line_bytes - 1] = '\n';
+	line[line_bytes] = '\0';
+
+	start = switch_micro_time_now();
+	for (i = 0; i < lines; i++) {
+		int n = switch_snprintf(line, line_bytes, "logfile bench %010d ", i);
+		line[n] = 'x';
+		mod_logfile_raw_write(profile, line);
+	}
+	produced = switch_micro_time_now() - start;
+
+	/* wait for the writer thread to catch up so the totals include the disk */
+	if (profile->buffer_size) {
+		for (i = 0; i < 30000; i++) {
+			switch_size_t pending;
+
+			switch_mutex_lock(profile->buf_mutex);
+			pending = profile->fill_len;
+			switch_mutex_unlock(profile->buf_mutex);
+
+			if (!pending && !profile->flushing) {
+				break;
+			}
+			switch_thread_cond_signal(globals.writer_cond);
+			switch_yield(1000);
+		}
+	}
+	done = switch_micro_time_now() - start;
+
+	if (!produced) produced = 1;
+	if (!done) done = 1;
+
+	stream->write_function(stream, "%d lines of %d bytes to %s (%s)\n", lines, line_bytes, profile->name, logfile_backend(profile));
+	stream->write_function(stream, "caller:  %" SWITCH_TIME_T_FMT "us, %0.0f lines/s\n", produced, (double) lines * 1000000 / produced);
+	stream->write_function(stream, "on disk: %" SWITCH_TIME_T_FMT "us, %0.2f MB/s, %" SWITCH_UINT64_T_FMT " dropped\n",
+						   done, (double) (profile->bytes - bytes) / done, profile->dropped - dropped);
+
+	free(line);
+}
+
+SWITCH_STANDARD_API(logfile_api_function)
+{
+	char *mydata = NULL, *argv[4] = { 0 };
+	int argc = 0;
+
+	if (!zstr(cmd)) {
+		mydata = strdup(cmd);
+		switch_assert(mydata);
+		argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (argc >= 1 && !strcasecmp(argv[0], "status")) {
+		switch_hash_index_t *hi;
+		void *val;
+
+		for (hi = switch_core_hash_first(profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+			logfile_profile_t *profile;
+
+			switch_core_hash_this(hi, NULL, NULL, &val);
+			profile = (logfile_profile_t *) val;
+
+			stream->write_function(stream, "%s: %s backend=%s buffer=%" SWITCH_SIZE_T_FMT " size=%" SWITCH_SIZE_T_FMT
+								   " lines=%" SWITCH_UINT64_T_FMT " bytes=%" SWITCH_UINT64_T_FMT " flushes=%" SWITCH_UINT64_T_FMT
+								   " avg_flush_us=%" SWITCH_UINT64_T_FMT " max_flush_us=%" SWITCH_TIME_T_FMT
+								   " dropped=%" SWITCH_UINT64_T_FMT " rotations=%" SWITCH_UINT64_T_FMT " write_errors=%" SWITCH_UINT64_T_FMT "\n",
+								   profile->name, profile->logfile, logfile_backend(profile), profile->buffer_size, profile->log_size,
+								   profile->lines, profile->bytes, profile->flushes,
+								   profile->flushes ? (uint64_t) profile->flush_time / profile->flushes : 0, profile->flush_time_max,
+								   profile->dropped, profile->rotations, profile->write_errors);
+		}
+	} else if (argc >= 3 && !strcasecmp(argv[0], "bench")) {
+		logfile_profile_t *profile = (logfile_profile_t *) switch_core_hash_find(profile_hash, argv[1]);
+		int lines = atoi(argv[2]);
+		int line_bytes = argc > 3 ? atoi(argv[3]) : 128;
+
+		if (line_bytes < 32) {
+			line_bytes = 32;
+		} else if (line_bytes > 4096) {
+			line_bytes = 4096;
+		}
+
+		if (!profile) {
+			stream->write_function(stream, "-ERR no such profile %s\n", argv[1]);
+		} else if (lines <= 0) {
+			stream->write_function(stream, "-ERR invalid line count\n");
+		} else {
+			logfile_bench(profile, lines, line_bytes, stream);
+		}
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", LOGFILE_API_SYNTAX);
+	}
+
+	switch_safe_free(mydata);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 {
 	char *cf = "logfile.conf";
 	switch_xml_t cfg, xml, settings, param, profiles, xprofile;
+	switch_api_interface_t *api_interface;
 
 	module_pool = pool;
 
 	memset(&globals, 0, sizeof(globals));
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, module_pool);
+	switch_mutex_init(&globals.writer_mutex, SWITCH_MUTEX_NESTED, module_pool);
+	switch_thread_cond_create(&globals.writer_cond, module_pool);
+	globals.flush_interval = DEFAULT_FLUSH_INTERVAL;
+	globals.io_uring = SWITCH_TRUE;
 
 	if (profile_hash) {
 		switch_core_hash_destroy(&profile_hash);
@@ -445,6 +1180,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
+	SWITCH_ADD_API(api_interface, "logfile", "File logging status and benchmark", logfile_api_function, LOGFILE_API_SYNTAX);
+	switch_console_set_complete("add logfile status");
+	switch_console_set_complete("add logfile bench");
+
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Open of %s failed\n", cf);
 	} else {
@@ -454,6 +1193,13 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 				char *val = (char *) switch_xml_attr_soft(param, "value");
 				if (!strcmp(var, "rotate-on-hup")) {
 					globals.rotate = switch_true(val);
+				} else if (!strcmp(var, "flush-interval")) {
+					int ms = atoi(val);
+					if (ms > 0) {
+						globals.flush_interval = (uint32_t) ms;
+					}
+				} else if (!strcmp(var, "io-uring")) {
+					globals.io_uring = switch_true(val);
 				}
 			}
 		}
@@ -469,6 +1215,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 		switch_xml_free(xml);
 	}
 
+	logfile_writer_start();
+
 	switch_log_bind_logger(mod_logfile_logger, SWITCH_LOG_DEBUG, SWITCH_FALSE);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -477,7 +1225,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_logfile_shutdown)
 {
 	switch_log_unbind_logger(mod_logfile_logger);
+	logfile_writer_stop();
 	switch_event_unbind(&globals.node);
+	switch_console_set_complete("del logfile");
 	switch_core_hash_destroy(&profile_hash);
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -40,6 +40,7 @@ SWITCH_MODULE_DEFINITION(mod_xml_curl, mod_xml_curl_load, mod_xml_curl_shutdown,
 
 
 struct xml_binding {
+	char *name;
 	char *method;
 	char *url;
 	char *bindings;
@@ -60,6 +61,34 @@ struct xml_binding {
 	long auth_scheme;
 	int timeout;
 	switch_size_t curl_max_bytes;
+	int use_http2;
+	int tcp_keepalive;
+	int single_flight;
+	uint32_t pool_size;
+	uint32_t cache_ttl;
+	uint32_t cache_max_entries;
+	switch_hash_t *cache_key_vars;
+
+	/* idle curl handles, their connections are kept open between fetches */
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_CURL **idle;
+	uint32_t idle_count;
+	/* requests currently on the wire, by request key */
+	switch_hash_t *inflight;
+	/* validated response bodies, by request key */
+	switch_hash_t *cache;
+	uint32_t cache_entries;
+
+	uint64_t fetches;
+	uint64_t requests;
+	uint64_t coalesced;
+	uint64_t cache_hits;
+	uint64_t handles_created;
+	uint64_t handles_reused;
+	uint64_t errors;
+
+	struct xml_binding *next;
 };
 
 static int keep_files_around = 0;
@@ -67,15 +96,33 @@ static int keep_files_around = 0;
 typedef struct xml_binding xml_binding_t;
 
 #define XML_CURL_MAX_BYTES 1024 * 1024
+#define XML_CURL_POOL_SIZE 4
+#define XML_CURL_MAX_POOL_SIZE 256
+#define XML_CURL_CACHE_MAX_ENTRIES 1000
 
 struct config_data {
-	char *name;
-	int fd;
+	char *buf;
+	switch_size_t len;
+	switch_size_t alloc;
 	switch_size_t bytes;
 	switch_size_t max_bytes;
 	int err;
 };
 
+/* one request on the wire, identical requests wait for its response */
+typedef struct xml_curl_flight {
+	int done;
+	int refs;
+	int err;
+	long http_res;
+	char *body;
+} xml_curl_flight_t;
+
+typedef struct xml_curl_cache_entry {
+	char *body;
+	switch_time_t expires;
+} xml_curl_cache_entry_t;
+
 typedef struct hash_node {
 	switch_hash_t *hash;
 	struct hash_node *next;
@@ -85,11 +132,100 @@ static struct {
 	switch_memory_pool_t *pool;
 	hash_node_t *hash_root;
 	hash_node_t *hash_tail;
+	xml_binding_t *bindings;
 } globals;
 
-#define XML_CURL_SYNTAX "[debug_on|debug_off]"
+struct cache_sweep {
+	switch_time_t now;
+	uint32_t deleted;
+};
+
+static switch_bool_t cache_delete_callback(const void *key, const void *val, void *pData)
+{
+	const xml_curl_cache_entry_t *entry = (const xml_curl_cache_entry_t *) val;
+	struct cache_sweep *sweep = (struct cache_sweep *) pData;
+
+	if (!sweep->now || entry->expires <= sweep->now) {
+		free(entry->body);
+		free((void *) entry);
+		sweep->deleted++;
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* drops the entries expired by now, or all of them when now is 0; call with the binding locked */
+static void cache_flush(xml_binding_t *binding, switch_time_t now)
+{
+	struct cache_sweep sweep = { 0 };
+
+	if (!binding->cache) {
+		return;
+	}
+
+	sweep.now = now;
+	switch_core_hash_delete_multi(binding->cache, cache_delete_callback, &sweep);
+	binding->cache_entries -= sweep.deleted;
+}
+
+static switch_xml_t cache_find(xml_binding_t *binding, const char *key)
+{
+	xml_curl_cache_entry_t *entry;
+	switch_xml_t xml = NULL;
+
+	switch_mutex_lock(binding->mutex);
+	if ((entry = switch_core_hash_find(binding->cache, key))) {
+		if (entry->expires > switch_micro_time_now()) {
+			/* the caller frees what it gets, hand out a fresh tree */
+			xml = switch_xml_parse_str_dup(entry->body);
+			binding->cache_hits++;
+		} else {
+			switch_core_hash_delete(binding->cache, key);
+			free(entry->body);
+			free(entry);
+			binding->cache_entries--;
+		}
+	}
+	switch_mutex_unlock(binding->mutex);
+
+	return xml;
+}
+
+static void cache_store(xml_binding_t *binding, const char *key, const char *body)
+{
+	xml_curl_cache_entry_t *entry, *old;
+	switch_time_t now = switch_micro_time_now();
+
+	switch_mutex_lock(binding->mutex);
+
+	if (!(old = switch_core_hash_find(binding->cache, key)) && binding->cache_entries >= binding->cache_max_entries) {
+		cache_flush(binding, now);
+	}
+
+	if (old || binding->cache_entries < binding->cache_max_entries) {
+		switch_zmalloc(entry, sizeof(*entry));
+		entry->body = strdup(body);
+		entry->expires = now + (switch_time_t) binding->cache_ttl * 1000000;
+
+		if (old) {
+			free(old->body);
+			free(old);
+		} else {
+			binding->cache_entries++;
+		}
+
+		switch_core_hash_insert(binding->cache, key, entry);
+	}
+
+	switch_mutex_unlock(binding->mutex);
+}
+
+#define XML_CURL_SYNTAX "[debug_on|debug_off|status|flush]"
 SWITCH_STANDARD_API(xml_curl_function)
 {
+	xml_binding_t *binding;
+
 	if (session) {
 		return SWITCH_STATUS_FALSE;
 	}
@@ -102,6 +238,24 @@ SWITCH_STANDARD_API(xml_curl_function)
 		keep_files_around = 1;
 	} else if (!strcasecmp(cmd, "debug_off")) {
 		keep_files_around = 0;
+	} else if (!strcasecmp(cmd, "status")) {
+		for (binding = globals.bindings; binding; binding = binding->next) {
+			switch_mutex_lock(binding->mutex);
+			stream->write_function(stream, "%s [%s]\n", zstr(binding->name) ? "N/A" : binding->name, binding->url);
+			stream->write_function(stream, "  fetches %" SWITCH_UINT64_T_FMT " requests %" SWITCH_UINT64_T_FMT " errors %" SWITCH_UINT64_T_FMT
+								   " coalesced %" SWITCH_UINT64_T_FMT " cache hits %" SWITCH_UINT64_T_FMT " cached %u\n",
+								   binding->fetches, binding->requests, binding->errors, binding->coalesced, binding->cache_hits, binding->cache_entries);
+			stream->write_function(stream, "  handles created %" SWITCH_UINT64_T_FMT " reused %" SWITCH_UINT64_T_FMT " idle %u/%u\n",
+								   binding->handles_created, binding->handles_reused, binding->idle_count, binding->pool_size);
+			switch_mutex_unlock(binding->mutex);
+		}
+		return SWITCH_STATUS_SUCCESS;
+	} else if (!strcasecmp(cmd, "flush")) {
+		for (binding = globals.bindings; binding; binding = binding->next) {
+			switch_mutex_lock(binding->mutex);
+			cache_flush(binding, 0);
+			switch_mutex_unlock(binding->mutex);
+		}
 	} else {
 		goto usage;
 	}
@@ -114,11 +268,10 @@ SWITCH_STANDARD_API(xml_curl_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-static size_t file_callback(void *ptr, size_t size, size_t nmemb, void *data)
+static size_t memory_callback(void *ptr, size_t size, size_t nmemb, void *data)
 {
-	register unsigned int realsize = (unsigned int) (size * nmemb);
+	size_t realsize = size * nmemb;
 	struct config_data *config_data = data;
-	int x;
 
 	config_data->bytes += realsize;
 
@@ -128,23 +281,216 @@ static size_t file_callback(void *ptr, size_t size, size_t nmemb, void *data)
 		return 0;
 	}
 
-	x = write(config_data->fd, ptr, realsize);
-	if (x != (int) realsize) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write! %d out of %d\n", x, realsize);
+	if (config_data->len + realsize + 1 > config_data->alloc) {
+		switch_size_t alloc = config_data->alloc ? config_data->alloc : 4096;
+		char *tmp;
+
+		while (alloc < config_data->len + realsize + 1) {
+			alloc <<= 1;
+		}
+
+		if (!(tmp = realloc(config_data->buf, alloc))) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Memory Error!\n");
+			config_data->err = 1;
+			return 0;
+		}
+
+		config_data->buf = tmp;
+		config_data->alloc = alloc;
 	}
-	return x;
+
+	memcpy(config_data->buf + config_data->len, ptr, realsize);
+	config_data->len += realsize;
+	config_data->buf[config_data->len] = '\0';
+
+	return realsize;
 }
 
+static switch_CURL *get_handle(xml_binding_t *binding)
+{
+	switch_CURL *curl_handle = NULL;
+
+	switch_mutex_lock(binding->mutex);
+	if (binding->idle_count) {
+		curl_handle = binding->idle[--binding->idle_count];
+		binding->handles_reused++;
+	} else {
+		binding->handles_created++;
+	}
+	switch_mutex_unlock(binding->mutex);
+
+	if (!curl_handle) {
+		curl_handle = switch_curl_easy_init();
+	}
+
+	return curl_handle;
+}
+
+static void put_handle(xml_binding_t *binding, switch_CURL *curl_handle, switch_bool_t reuse)
+{
+	if (reuse && binding->pool_size) {
+		/* drops the options of this fetch but keeps the connection open */
+		curl_easy_reset(curl_handle);
+
+		switch_mutex_lock(binding->mutex);
+		if (binding->idle_count < binding->pool_size) {
+			binding->idle[binding->idle_count++] = curl_handle;
+			curl_handle = NULL;
+		}
+		switch_mutex_unlock(binding->mutex);
+	}
+
+	if (curl_handle) {
+		switch_curl_easy_cleanup(curl_handle);
+	}
+}
+
+static void xml_curl_perform(xml_binding_t *binding, const char *url, const char *data, struct config_data *config_data, long *httpRes)
+{
+	switch_CURL *curl_handle = NULL;
+	switch_CURLcode cc;
+	switch_curl_slist_t *slist = NULL;
+	switch_curl_slist_t *headers = NULL;
+
+	config_data->max_bytes = binding->curl_max_bytes;
 
+	curl_handle = get_handle(binding);
+	headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
 
+	if (!strncasecmp(binding->url, "https", 5)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
+	}
+
+	if (!zstr(binding->cred)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, binding->auth_scheme);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_USERPWD, binding->cred);
+	}
+	switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+	if (binding->method != NULL)
+		switch_curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, binding->method);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_POST, !binding->use_get_style);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_MAXREDIRS, 10);
+	if (!binding->use_get_style)
+		switch_curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, memory_callback);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) config_data);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-xml/1.0");
+	switch_curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);
+
+	if (binding->tcp_keepalive) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	if (binding->use_http2) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_PIPEWAIT, 1L);
+	}
+#endif
+
+	if (binding->timeout) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, binding->timeout);
+	}
+
+	if (binding->disable100continue) {
+		slist = switch_curl_slist_append(slist, "Expect:");
+		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, slist);
+	}
+
+	if (binding->enable_cacert_check) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
+	}
+
+	if (binding->ssl_cert_file) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, binding->ssl_cert_file);
+	}
+
+	if (binding->ssl_key_file) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, binding->ssl_key_file);
+	}
+
+	if (binding->ssl_key_password) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, binding->ssl_key_password);
+	}
+
+	if (binding->ssl_version) {
+		if (!strcasecmp(binding->ssl_version, "SSLv3")) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
+		} else if (!strcasecmp(binding->ssl_version, "TLSv1")) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
+		}
+	}
+
+	if (binding->ssl_cacert_file) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_CAINFO, binding->ssl_cacert_file);
+	}
+
+	if (binding->enable_ssl_verifyhost) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
+	}
+
+	if (binding->cookie_file) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_COOKIEJAR, binding->cookie_file);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_COOKIEFILE, binding->cookie_file);
+	}
+
+	if (binding->bind_local) {
+		curl_easy_setopt(curl_handle, CURLOPT_INTERFACE, binding->bind_local);
+	}
+
+	cc = switch_curl_easy_perform(curl_handle);
+	if (cc && cc != CURLE_WRITE_ERROR) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "CURL returned error:[%d] %s\n", cc, switch_curl_easy_strerror(cc));
+	}
+
+	switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, httpRes);
+	/* a failed transfer may leave the connection in an unknown state */
+	put_handle(binding, curl_handle, cc == CURLE_OK ? SWITCH_TRUE : SWITCH_FALSE);
+	switch_curl_slist_free_all(headers);
+	switch_curl_slist_free_all(slist);
+
+	switch_mutex_lock(binding->mutex);
+	binding->requests++;
+	switch_mutex_unlock(binding->mutex);
+}
+
+/* identifies requests that get the same answer; ignores the event timestamps
+   and, like the post itself, any variable not enabled with enable-post-var.
+   cache-key-var narrows only the cache key, requests in flight are shared on the full parameter set */
+static char *xml_curl_request_key(xml_binding_t *binding, const char *url, const char *basic_data, switch_event_t *params, switch_bool_t cache)
+{
+	switch_stream_handle_t stream = { 0 };
+	switch_event_header_t *hp;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	stream.write_function(&stream, "%s %s?%s", binding->method ? binding->method : "POST", url, basic_data);
+
+	for (hp = params ? params->headers : NULL; hp; hp = hp->next) {
+		if (cache && binding->cache_key_vars) {
+			if (!switch_core_hash_find(binding->cache_key_vars, hp->name)) {
+				continue;
+			}
+		} else if (binding->vars_map && !switch_core_hash_find(binding->vars_map, hp->name)) {
+			continue;
+		} else if (!strncasecmp(hp->name, "Event-Date-", 11) || !strcasecmp(hp->name, "Event-Sequence")) {
+			continue;
+		}
+
+		stream.write_function(&stream, "&%s=%s", hp->name, switch_str_nil(hp->value));
+	}
+
+	return stream.data;
+}
 
 static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, const char *key_name, const char *key_value, switch_event_t *params,
 								  void *user_data)
 {
 	switch_event_t *my_params = NULL;
 	char filename[512] = "";
-	switch_CURL *curl_handle = NULL;
-	switch_CURLcode cc;
 	struct config_data config_data;
 	switch_xml_t xml = NULL;
 	char *data = NULL;
@@ -152,13 +498,15 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
 	xml_binding_t *binding = (xml_binding_t *) user_data;
 	char *file_url;
-	switch_curl_slist_t *slist = NULL;
 	long httpRes = 0;
-	switch_curl_slist_t *headers = NULL;
 	char hostname[256] = "";
 	char basic_data[512];
 	char *uri = NULL;
 	char *dynamic_url = NULL;
+	char *key = NULL, *cache_key = NULL;
+	xml_curl_flight_t *flight = NULL;
+	int leader = 1, err;
+	char *body;
 
     strncpy(hostname, switch_core_get_switchname(), sizeof(hostname) - 1);
 
@@ -206,114 +554,72 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 		sprintf(uri, "%s%c%s", dynamic_url, strchr(dynamic_url, '?') != NULL ? '&' : '?', data);
 	}
 
-	switch_uuid_get(&uuid);
-	switch_uuid_format(uuid_str, &uuid);
-
-	switch_snprintf(filename, sizeof(filename), "%s%s%s.tmp.xml", SWITCH_GLOBAL_dirs.temp_dir, SWITCH_PATH_SEPARATOR, uuid_str);
-
-	memset(&config_data, 0, sizeof(config_data));
-
-	config_data.name = filename;
-	config_data.max_bytes = binding->curl_max_bytes;
-
-	if ((config_data.fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
-		curl_handle = switch_curl_easy_init();
-		headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-
-		if (!strncasecmp(binding->url, "https", 5)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
-		}
-
-		if (!zstr(binding->cred)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, binding->auth_scheme);
-			switch_curl_easy_setopt(curl_handle, CURLOPT_USERPWD, binding->cred);
-		}
-		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-		if (binding->method != NULL)
-			switch_curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, binding->method);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_POST, !binding->use_get_style);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_MAXREDIRS, 10);
-		if (!binding->use_get_style)
-			switch_curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_URL, binding->use_get_style ? uri : dynamic_url);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, file_callback);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &config_data);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-xml/1.0");
-		switch_curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);
-
-		if (binding->timeout) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, binding->timeout);
-		}
+	switch_mutex_lock(binding->mutex);
+	binding->fetches++;
+	switch_mutex_unlock(binding->mutex);
 
-		if (binding->disable100continue) {
-			slist = switch_curl_slist_append(slist, "Expect:");
-			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, slist);
-		}
+	if (binding->single_flight || binding->cache_ttl) {
+		key = xml_curl_request_key(binding, dynamic_url, basic_data, params, SWITCH_FALSE);
+	}
 
-		if (binding->enable_cacert_check) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
-		}
+	if (binding->cache_ttl) {
+		cache_key = binding->cache_key_vars ? xml_curl_request_key(binding, dynamic_url, basic_data, params, SWITCH_TRUE) : key;
 
-		if (binding->ssl_cert_file) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, binding->ssl_cert_file);
+		if ((xml = cache_find(binding, cache_key))) {
+			goto end;
 		}
+	}
 
-		if (binding->ssl_key_file) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, binding->ssl_key_file);
-		}
+	memset(&config_data, 0, sizeof(config_data));
 
-		if (binding->ssl_key_password) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, binding->ssl_key_password);
-		}
+	if (key && binding->single_flight) {
+		switch_mutex_lock(binding->mutex);
+		if ((flight = switch_core_hash_find(binding->inflight, key))) {
+			flight->refs++;
+			binding->coalesced++;
+			leader = 0;
 
-		if (binding->ssl_version) {
-			if (!strcasecmp(binding->ssl_version, "SSLv3")) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
-			} else if (!strcasecmp(binding->ssl_version, "TLSv1")) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
+			while (!flight->done) {
+				switch_thread_cond_wait(binding->cond, binding->mutex);
 			}
+		} else {
+			switch_zmalloc(flight, sizeof(*flight));
+			flight->refs = 1;
+			switch_core_hash_insert(binding->inflight, key, flight);
 		}
+		switch_mutex_unlock(binding->mutex);
+	}
 
-		if (binding->ssl_cacert_file) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_CAINFO, binding->ssl_cacert_file);
-		}
-
-		if (binding->enable_ssl_verifyhost) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
-		}
-
-		if (binding->cookie_file) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_COOKIEJAR, binding->cookie_file);
-			switch_curl_easy_setopt(curl_handle, CURLOPT_COOKIEFILE, binding->cookie_file);
-		}
-
-		if (binding->bind_local) {
-			curl_easy_setopt(curl_handle, CURLOPT_INTERFACE, binding->bind_local);
-		}
-
-		cc = switch_curl_easy_perform(curl_handle);
-		if (cc && cc != CURLE_WRITE_ERROR) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "CURL returned error:[%d] %s\n", cc, switch_curl_easy_strerror(cc));
+	if (leader) {
+		xml_curl_perform(binding, binding->use_get_style ? uri : dynamic_url, data, &config_data, &httpRes);
+
+		if (flight) {
+			switch_mutex_lock(binding->mutex);
+			flight->body = config_data.buf;
+			flight->err = config_data.err;
+			flight->http_res = httpRes;
+			flight->done = 1;
+			config_data.buf = NULL;
+			switch_core_hash_delete(binding->inflight, key);
+			switch_thread_cond_broadcast(binding->cond);
+			switch_mutex_unlock(binding->mutex);
 		}
-
-		switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
-		switch_curl_easy_cleanup(curl_handle);
-		switch_curl_slist_free_all(headers);
-		switch_curl_slist_free_all(slist);
-		close(config_data.fd);
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening temp file!\n");
 	}
 
-	if (config_data.err) {
+	/* the flight is immutable once done, the body is shared read-only */
+	body = flight ? flight->body : config_data.buf;
+	err = flight ? flight->err : config_data.err;
+	httpRes = flight ? flight->http_res : httpRes;
+
+	if (err) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error encountered! [%s]\ndata: [%s]\n", binding->url, data);
 		xml = NULL;
 	} else {
 		if (httpRes == 200) {
-			if (!(xml = switch_xml_parse_file(filename))) {
+			if (!(xml = switch_xml_parse_str_dup(switch_str_nil(body)))) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Parsing Result! [%s]\ndata: [%s]\n", binding->url, data);
+			} else if (leader && cache_key) {
+				cache_store(binding, cache_key, body);
 			}
 		} else {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Received HTTP error %ld trying to fetch %s\ndata: [%s]\n", httpRes, binding->url,
@@ -322,15 +628,49 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 		}
 	}
 
-	/* Debug by leaving the file behind for review */
-	if (keep_files_around) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "XML response is in %s\n", filename);
-	} else {
-		if (unlink(filename) != 0) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "XML response file [%s] delete failed\n", filename);
+	if (!xml) {
+		switch_mutex_lock(binding->mutex);
+		binding->errors++;
+		switch_mutex_unlock(binding->mutex);
+	}
+
+	/* Debug by leaving the response behind for review */
+	if (keep_files_around && leader) {
+		int fd;
+
+		switch_uuid_get(&uuid);
+		switch_uuid_format(uuid_str, &uuid);
+
+		switch_snprintf(filename, sizeof(filename), "%s%s%s.tmp.xml", SWITCH_GLOBAL_dirs.temp_dir, SWITCH_PATH_SEPARATOR, uuid_str);
+
+		if ((fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
+			if (body && write(fd, body, strlen(body)) < 0) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write to %s\n", filename);
+			}
+			close(fd);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "XML response is in %s\n", filename);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening temp file!\n");
+		}
+	}
+
+	if (flight) {
+		switch_mutex_lock(binding->mutex);
+		if (!--flight->refs) {
+			switch_safe_free(flight->body);
+			free(flight);
 		}
+		switch_mutex_unlock(binding->mutex);
 	}
 
+	switch_safe_free(config_data.buf);
+
+  end:
+
+	if (cache_key != key) {
+		switch_safe_free(cache_key);
+	}
+	switch_safe_free(key);
 	switch_safe_free(data);
 	if (binding->use_get_style == 1)
 		switch_safe_free(uri);
@@ -384,6 +724,9 @@ static switch_status_t do_config(void)
 		char *cookie_file = NULL;
 		hash_node_t *hash_node;
 		long auth_scheme = CURLAUTH_BASIC;
+		int use_http2 = 0, tcp_keepalive = 1, single_flight = 1;
+		uint32_t pool_size = XML_CURL_POOL_SIZE, cache_ttl = 0, cache_max_entries = XML_CURL_CACHE_MAX_ENTRIES;
+		switch_hash_t *cache_key_vars = NULL;
 		need_vars_map = 0;
 		vars_map = NULL;
 
@@ -469,6 +812,38 @@ static switch_status_t do_config(void)
 				} else {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't set a negative maximum response bytes!\n");
 				}
+			} else if (!strcasecmp(var, "connection-pool-size")) {
+				int tmp = atoi(val);
+				if (tmp >= 0 && tmp <= XML_CURL_MAX_POOL_SIZE) {
+					pool_size = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "connection-pool-size must be between 0 and %d!\n", XML_CURL_MAX_POOL_SIZE);
+				}
+			} else if (!strcasecmp(var, "tcp-keepalive")) {
+				tcp_keepalive = switch_true(val);
+			} else if (!strcasecmp(var, "use-http2")) {
+				use_http2 = switch_true(val);
+			} else if (!strcasecmp(var, "single-flight")) {
+				single_flight = switch_true(val);
+			} else if (!strcasecmp(var, "cache-ttl")) {
+				int tmp = atoi(val);
+				if (tmp >= 0) {
+					cache_ttl = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't set a negative cache-ttl!\n");
+				}
+			} else if (!strcasecmp(var, "cache-max-entries")) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					cache_max_entries = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "cache-max-entries must be positive!\n");
+				}
+			} else if (!strcasecmp(var, "cache-key-var") && !zstr(val)) {
+				if (!cache_key_vars) {
+					switch_core_hash_init(&cache_key_vars);
+				}
+				switch_core_hash_insert(cache_key_vars, val, ENABLE_PARAM_VALUE);
 			}
 		}
 
@@ -476,16 +851,24 @@ static switch_status_t do_config(void)
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Binding has no url!\n");
 			if (vars_map)
 				switch_core_hash_destroy(&vars_map);
+			if (cache_key_vars)
+				switch_core_hash_destroy(&cache_key_vars);
 			continue;
 		}
 
 		if (!(binding = switch_core_alloc(globals.pool, sizeof(*binding)))) {
 			if (vars_map)
 				switch_core_hash_destroy(&vars_map);
+			if (cache_key_vars)
+				switch_core_hash_destroy(&cache_key_vars);
 			goto done;
 		}
 		memset(binding, 0, sizeof(*binding));
 
+		if (!zstr(bname)) {
+			binding->name = switch_core_strdup(globals.pool, bname);
+		}
+
 		binding->auth_scheme = auth_scheme;
 		binding->timeout = timeout;
 		binding->url = switch_core_strdup(globals.pool, url);
@@ -559,6 +942,33 @@ static switch_status_t do_config(void)
 
 		binding->curl_max_bytes = curl_max_bytes;
 
+		if (cookie_file && pool_size) {
+			/* the cookie jar is only written when the handle is cleaned up */
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Binding [%s] uses a cookie-file, not keeping connections open\n",
+							  zstr(bname) ? "N/A" : bname);
+			pool_size = 0;
+		}
+
+		binding->pool_size = pool_size;
+		binding->tcp_keepalive = tcp_keepalive;
+		binding->use_http2 = use_http2;
+		binding->single_flight = single_flight;
+		binding->cache_ttl = cache_ttl;
+		binding->cache_max_entries = cache_max_entries;
+		binding->cache_key_vars = cache_key_vars;
+
+		switch_mutex_init(&binding->mutex, SWITCH_MUTEX_NESTED, globals.pool);
+		switch_thread_cond_create(&binding->cond, globals.pool);
+		switch_core_hash_init(&binding->inflight);
+		switch_core_hash_init(&binding->cache);
+
+		if (pool_size) {
+			binding->idle = switch_core_alloc(globals.pool, sizeof(switch_CURL *) * pool_size);
+		}
+
+		binding->next = globals.bindings;
+		globals.bindings = binding;
+
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Binding [%s] XML Fetch Function [%s] [%s]\n",
 						  zstr(bname) ? "N/A" : bname, binding->url, binding->bindings ? binding->bindings : "all");
 		switch_xml_bind_search_function(xml_url_fetch, switch_xml_parse_section_string(binding->bindings), binding);
@@ -591,6 +1001,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_curl_load)
 	SWITCH_ADD_API(xml_curl_api_interface, "xml_curl", "XML Curl", xml_curl_function, XML_CURL_SYNTAX);
 	switch_console_set_complete("add xml_curl debug_on");
 	switch_console_set_complete("add xml_curl debug_off");
+	switch_console_set_complete("add xml_curl status");
+	switch_console_set_complete("add xml_curl flush");
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
@@ -599,6 +1011,25 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_curl_load)
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_curl_shutdown)
 {
 	hash_node_t *ptr = NULL;
+	xml_binding_t *binding;
+
+	switch_xml_unbind_search_function_ptr(xml_url_fetch);
+
+	for (binding = globals.bindings; binding; binding = binding->next) {
+		switch_mutex_lock(binding->mutex);
+		while (binding->idle_count) {
+			switch_curl_easy_cleanup(binding->idle[--binding->idle_count]);
+		}
+		cache_flush(binding, 0);
+		switch_mutex_unlock(binding->mutex);
+
+		switch_core_hash_destroy(&binding->cache);
+		switch_core_hash_destroy(&binding->inflight);
+		if (binding->cache_key_vars) {
+			switch_core_hash_destroy(&binding->cache_key_vars);
+		}
+	}
+	globals.bindings = NULL;
 
 	while (globals.hash_root) {
 		ptr = globals.hash_root;
@@ -607,8 +1038,6 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_curl_shutdown)
 		switch_safe_free(ptr);
 	}
 
-	switch_xml_unbind_search_function_ptr(xml_url_fetch);
-
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -488,6 +488,11 @@ SWITCH_DECLARE(switch_status_t) switch_file_mktemp(switch_file_t ** thefile, cha
 	return fspr_file_mktemp(thefile, templ, flags, pool);
 }
 
+SWITCH_DECLARE(switch_status_t) switch_os_file_get(switch_os_file_t *thefile, switch_file_t *file)
+{
+	return fspr_os_file_get(thefile, file);
+}
+
 SWITCH_DECLARE(switch_size_t) switch_file_get_size(switch_file_t *thefile)
 {
 	struct fspr_finfo_t finfo;
@@ -1440,6 +1445,20 @@ SWITCH_DECLARE(int) switch_atomic_dec(volatile switch_atomic_t *mem)
 #endif
 }
 
+SWITCH_DECLARE(void *) switch_atomic_casptr(volatile void **mem, void *with, const void *cmp)
+{
+	return fspr_atomic_casptr(mem, with, cmp);
+}
+
+SWITCH_DECLARE(uint32_t) switch_atomic_cas(volatile switch_atomic_t *mem, uint32_t with, uint32_t cmp)
+{
+#ifdef fspr_atomic_t
+	return fspr_atomic_cas((fspr_atomic_t *) mem, with, cmp);
+#else
+	return fspr_atomic_cas32((fspr_uint32_t *) mem, with, cmp);
+#endif
+}
+
 SWITCH_DECLARE(char *) switch_strerror(switch_status_t statcode, char *buf, switch_size_t bufsize)
 {
 	return fspr_strerror(statcode, buf, bufsize);
@@ -52,6 +52,12 @@ static struct {
 	switch_hash_t *device_hash;
 	switch_mutex_t *device_mutex;
 	switch_device_state_binding_t *device_bindings;
+	switch_hash_t *expand_hash;
+	switch_mutex_t *expand_mutex;
+	uint32_t expand_count;
+	uint32_t expand_max;
+	uint64_t expand_hits;
+	uint64_t expand_misses;
 } globals;
 
 static struct switch_cause_table CAUSE_CHART[] = {
@@ -191,6 +197,7 @@ struct switch_channel {
 	char *device_id;
 	switch_event_t *log_tags;
 	switch_post_dialplan_function_t post_dialplan_function;
+	switch_event_shared_t *var_snapshot;
 };
 
 static void process_device_hup(switch_channel_t *channel);
@@ -500,6 +507,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_alloc(switch_channel_t **channel,
 	}
 
 	switch_event_create_plain(&(*channel)->variables, SWITCH_EVENT_CHANNEL_DATA);
+	switch_event_index_headers((*channel)->variables);
 
 	switch_core_hash_init(&(*channel)->private_hash);
 	switch_queue_create(&(*channel)->dtmf_queue, SWITCH_DTMF_LOG_LEN, pool);
@@ -804,6 +812,7 @@ SWITCH_DECLARE(void) switch_channel_uninit(switch_channel_t *channel)
 	}
 
 	switch_mutex_lock(channel->profile_mutex);
+	switch_event_shared_release(&channel->var_snapshot);
 	switch_event_destroy(&channel->variables);
 	switch_event_destroy(&channel->api_list);
 	switch_event_destroy(&channel->var_list);
@@ -1140,6 +1149,39 @@ SWITCH_DECLARE(switch_event_header_t *) switch_channel_variable_first(switch_cha
 	return hi;
 }
 
+SWITCH_DECLARE(switch_event_shared_t *) switch_channel_var_snapshot_get(switch_channel_t *channel)
+{
+	switch_event_shared_t *snap;
+
+	switch_assert(channel != NULL);
+
+	switch_mutex_lock(channel->profile_mutex);
+	if (!channel->var_snapshot) {
+		switch_event_t *vars;
+		switch_event_header_t *hi;
+
+		/* named the way switch_channel_event_set_data always put them in events so those can link the set as is */
+		switch_event_create_plain(&vars, SWITCH_EVENT_CHANNEL_DATA);
+
+		if (channel->variables) {
+			for (hi = channel->variables->headers; hi; hi = hi->next) {
+				char buf[1024];
+
+				switch_snprintf(buf, sizeof(buf), "variable_%s", hi->name);
+				switch_event_add_header_string(vars, SWITCH_STACK_BOTTOM, buf, hi->value);
+			}
+		}
+
+		/* the reference held by the channel until the next change to its variables */
+		channel->var_snapshot = switch_event_share(&vars);
+	}
+
+	snap = switch_event_shared_ref(channel->var_snapshot);
+	switch_mutex_unlock(channel->profile_mutex);
+
+	return snap;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_channel_set_private(switch_channel_t *channel, const char *key, const void *private_info)
 {
 	switch_assert(channel != NULL);
@@ -1565,6 +1607,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_var_check(switch_cha
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		switch_event_shared_release(&channel->var_snapshot);
 		if (zstr(value)) {
 			switch_event_del_header(channel->variables, varname);
 		} else {
@@ -1596,6 +1639,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_strip_quotes_var_che
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		switch_event_shared_release(&channel->var_snapshot);
 		if (zstr(value)) {
 			switch_event_del_header(channel->variables, varname);
 		} else {
@@ -1640,6 +1684,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_add_variable_var_check(switch_cha
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		switch_event_shared_release(&channel->var_snapshot);
 		if (zstr(value)) {
 			switch_event_del_header(channel->variables, varname);
 		} else {
@@ -1676,6 +1721,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_printf(switch_channe
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		switch_event_shared_release(&channel->var_snapshot);
 		switch_event_del_header(channel->variables, varname);
 
 		va_start(ap, fmt);
@@ -2926,17 +2972,10 @@ SWITCH_DECLARE(void) switch_channel_event_set_extended_data(switch_channel_t *ch
 		}
 
 		if (channel->variables) {
-			for (hi = channel->variables->headers; hi; hi = hi->next) {
-				char buf[1024];
-				char *vvar = NULL, *vval = NULL;
-
-				vvar = (char *) hi->name;
-				vval = (char *) hi->value;
+			switch_event_shared_t *snap = switch_channel_var_snapshot_get(channel);
 
-				switch_assert(vvar && vval);
-				switch_snprintf(buf, sizeof(buf), "variable_%s", vvar);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, buf, vval);
-			}
+			switch_event_link_shared(event, snap);
+			switch_event_shared_release(&snap);
 		}
 	}
 
@@ -4465,6 +4504,578 @@ SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *c
 	return data;
 }
 
+typedef enum {
+	EXPAND_TOKEN_LITERAL,
+	EXPAND_TOKEN_VAR,
+	EXPAND_TOKEN_API
+} expand_token_type_t;
+
+typedef struct expand_token_s {
+	expand_token_type_t type;
+	/* literal text for EXPAND_TOKEN_LITERAL */
+	char *text;
+	switch_size_t len;
+	/* variable name or api command, api argument */
+	switch_expand_template_t *name;
+	switch_expand_template_t *arg;
+	/* ${var:offset:ooffset} and ${var[idx]} when the name is not itself expanded */
+	char *vname;
+	int offset;
+	int ooffset;
+	int idx;
+	struct expand_token_s *next;
+} expand_token_t;
+
+struct switch_expand_template_s {
+	char *in;
+	switch_bool_t constant;
+	uint32_t recur;
+	switch_size_t static_len;
+	expand_token_t *head;
+	expand_token_t *tail;
+	int refs;
+};
+
+static void expand_template_free(switch_expand_template_t *tpl)
+{
+	expand_token_t *tp, *next;
+
+	if (!tpl) {
+		return;
+	}
+
+	for (tp = tpl->head; tp; tp = next) {
+		next = tp->next;
+		expand_template_free(tp->name);
+		expand_template_free(tp->arg);
+		switch_safe_free(tp->text);
+		switch_safe_free(tp->vname);
+		free(tp);
+	}
+
+	switch_safe_free(tpl->in);
+	free(tpl);
+}
+
+static expand_token_t *expand_template_add_token(switch_expand_template_t *tpl, expand_token_type_t type)
+{
+	expand_token_t *tp;
+
+	switch_zmalloc(tp, sizeof(*tp));
+	tp->type = type;
+	tp->idx = -1;
+
+	if (tpl->tail) {
+		tpl->tail->next = tp;
+	} else {
+		tpl->head = tp;
+	}
+	tpl->tail = tp;
+
+	return tp;
+}
+
+static void expand_template_flush_literal(switch_expand_template_t *tpl, char *lit, char **c)
+{
+	expand_token_t *tp;
+	switch_size_t len = *c - lit;
+
+	if (!len) {
+		return;
+	}
+
+	tp = expand_template_add_token(tpl, EXPAND_TOKEN_LITERAL);
+	tp->text = malloc(len + 1);
+	switch_assert(tp->text);
+	memcpy(tp->text, lit, len);
+	tp->text[len] = '\0';
+	tp->len = len;
+	tpl->static_len += len;
+	*c = lit;
+}
+
+static void expand_var_parse_modifiers(char *vname, int *offset, int *ooffset, int *idx)
+{
+	char *ptr;
+
+	if ((ptr = strchr(vname, ':'))) {
+		*ptr++ = '\0';
+		*offset = atoi(ptr);
+		if ((ptr = strchr(ptr, ':'))) {
+			ptr++;
+			*ooffset = atoi(ptr);
+		}
+	}
+
+	if ((ptr = strchr(vname, '[')) && strchr(ptr, ']')) {
+		*ptr++ = '\0';
+		*idx = atoi(ptr);
+	}
+}
+
+/*
+ * Tokenize a string the same way switch_channel_expand_variables_check walks it so rendering
+ * the result produces byte for byte the same output without rescanning the source.
+ */
+static switch_expand_template_t *expand_template_compile(const char *in, uint32_t recur)
+{
+	switch_expand_template_t *tpl;
+	char *p, *c, *lit, *indup, *endof_indup;
+	size_t vtype = 0, br = 0;
+	char *sb = NULL;
+	int nv = 0;
+
+	switch_zmalloc(tpl, sizeof(*tpl));
+	tpl->in = strdup(in ? in : "");
+	switch_assert(tpl->in);
+	tpl->recur = recur;
+
+	if (recur > 100 || zstr(in) || !(switch_string_var_check_const(in) || switch_string_has_escaped_data(in))) {
+		tpl->constant = SWITCH_TRUE;
+		return tpl;
+	}
+
+	indup = strdup(in);
+	switch_assert(indup);
+	endof_indup = end_of_p(indup) + 1;
+
+	/* literal output can never be longer than the input */
+	lit = malloc(strlen(in) + 1);
+	switch_assert(lit);
+	c = lit;
+
+	for (p = indup; p && p < endof_indup && *p; p++) {
+		int global = 0;
+		vtype = 0;
+
+		if (*p == '\\') {
+			if (*(p + 1) == '$') {
+				nv = 1;
+				p++;
+				if (*(p + 1) == '$') {
+					p++;
+				}
+			} else if (*(p + 1) == '\'') {
+				p++;
+				continue;
+			} else if (*(p + 1) == '\\') {
+				*c++ = *p++;
+				continue;
+			}
+		}
+
+		if (*p == '$' && !nv) {
+			if (*(p + 1) == '$') {
+				p++;
+				global++;
+			}
+
+			if (*(p + 1)) {
+				if (*(p + 1) == '{') {
+					vtype = global ? 3 : 1;
+				} else {
+					nv = 1;
+				}
+			} else {
+				nv = 1;
+			}
+		}
+
+		if (nv) {
+			*c++ = *p;
+			nv = 0;
+			continue;
+		}
+
+		if (vtype) {
+			char *s = p, *e, *vname, *vval = NULL;
+			expand_token_t *tp;
+
+			s++;
+
+			if ((vtype == 1 || vtype == 3) && *s == '{') {
+				br = 1;
+				s++;
+			}
+
+			e = s;
+			vname = s;
+			while (*e) {
+				if (br == 1 && *e == '}') {
+					br = 0;
+					*e++ = '\0';
+					break;
+				}
+
+				if (br > 0) {
+					if (e != s && *e == '{') {
+						br++;
+					} else if (br > 1 && *e == '}') {
+						br--;
+					}
+				}
+
+				e++;
+			}
+			p = e > endof_indup ? endof_indup : e;
+
+			vval = NULL;
+			for (sb = vname; sb && *sb; sb++) {
+				if (*sb == ' ') {
+					vval = sb;
+					break;
+				} else if (*sb == '(') {
+					vval = sb;
+					br = 1;
+					break;
+				}
+			}
+
+			if (vval) {
+				e = vval - 1;
+				*vval++ = '\0';
+				while (*e == ' ') {
+					*e-- = '\0';
+				}
+				e = vval;
+
+				while (e && *e) {
+					if (*e == '(') {
+						br++;
+					} else if (br > 1 && *e == ')') {
+						br--;
+					} else if (br == 1 && *e == ')') {
+						*e = '\0';
+						break;
+					}
+					e++;
+				}
+
+				vtype = 2;
+			}
+
+			expand_template_flush_literal(tpl, lit, &c);
+
+			if (vtype == 1 || vtype == 3) {
+				tp = expand_template_add_token(tpl, EXPAND_TOKEN_VAR);
+				tp->name = expand_template_compile(vname, recur + 1);
+
+				if (tp->name->constant) {
+					tp->vname = strdup(vname);
+					switch_assert(tp->vname);
+					expand_var_parse_modifiers(tp->vname, &tp->offset, &tp->ooffset, &tp->idx);
+				}
+			} else {
+				tp = expand_template_add_token(tpl, EXPAND_TOKEN_API);
+				tp->name = expand_template_compile(vname, recur + 1);
+				tp->arg = expand_template_compile(vval, recur + 1);
+			}
+
+			br = 0;
+
+			/* an unterminated reference runs to the end of the string */
+			if (!*p) {
+				break;
+			}
+		}
+
+		if (*p == '$') {
+			p--;
+		} else {
+			*c++ = *p;
+		}
+	}
+
+	expand_template_flush_literal(tpl, lit, &c);
+
+	free(lit);
+	free(indup);
+
+	return tpl;
+}
+
+typedef struct {
+	char *data;
+	switch_size_t len;
+	switch_size_t olen;
+} expand_buf_t;
+
+static void expand_buf_append(expand_buf_t *buf, const char *str, switch_size_t len)
+{
+	if (buf->len + len + 1 > buf->olen) {
+		char *dp;
+
+		buf->olen = buf->len + len + 128;
+		dp = realloc(buf->data, buf->olen);
+		switch_assert(dp);
+		buf->data = dp;
+	}
+
+	memcpy(buf->data + buf->len, str, len);
+	buf->len += len;
+	buf->data[buf->len] = '\0';
+}
+
+static char *expand_template_render(switch_channel_t *channel, switch_expand_template_t *tpl, switch_event_t *var_list, switch_event_t *api_list)
+{
+	expand_buf_t buf = { 0 };
+	expand_token_t *tp;
+
+	if (tpl->constant) {
+		return tpl->in;
+	}
+
+	buf.olen = tpl->static_len + 128;
+	buf.data = malloc(buf.olen);
+	switch_assert(buf.data);
+	*buf.data = '\0';
+
+	for (tp = tpl->head; tp; tp = tp->next) {
+		char *sub_val = NULL, *expanded_sub_val = NULL, *cloned_sub_val = NULL, *func_val = NULL;
+
+		if (tp->type == EXPAND_TOKEN_LITERAL) {
+			expand_buf_append(&buf, tp->text, tp->len);
+			continue;
+		}
+
+		if (tp->type == EXPAND_TOKEN_VAR) {
+			char *vname = tp->vname, *expanded = NULL;
+			int offset = tp->offset, ooffset = tp->ooffset, idx = tp->idx;
+
+			if (!vname) {
+				if ((expanded = expand_template_render(channel, tp->name, var_list, api_list)) == tp->name->in) {
+					expanded = strdup(expanded);
+					switch_assert(expanded);
+				}
+				vname = expanded;
+				offset = ooffset = 0;
+				idx = -1;
+				expand_var_parse_modifiers(vname, &offset, &ooffset, &idx);
+			}
+
+			if ((sub_val = (char *) switch_channel_get_variable_dup(channel, vname, SWITCH_TRUE, idx))) {
+				char *ptr;
+
+				if (var_list && !switch_event_check_permission_list(var_list, vname)) {
+					sub_val = "<Variable Expansion Permission Denied>";
+				}
+
+				if ((expanded_sub_val = switch_channel_expand_variables_check(channel, sub_val, var_list, api_list, tpl->recur + 1)) == sub_val) {
+					expanded_sub_val = NULL;
+				} else {
+					sub_val = expanded_sub_val;
+				}
+
+				if (offset || ooffset) {
+					cloned_sub_val = strdup(sub_val);
+					switch_assert(cloned_sub_val);
+					sub_val = cloned_sub_val;
+				}
+
+				if (offset >= 0) {
+					if ((size_t) offset > strlen(sub_val)) {
+						*sub_val = '\0';
+					} else {
+						sub_val += offset;
+					}
+				} else if ((size_t) abs(offset) <= strlen(sub_val)) {
+					sub_val = cloned_sub_val + (strlen(cloned_sub_val) + offset);
+				}
+
+				if (ooffset > 0 && (size_t) ooffset < strlen(sub_val)) {
+					if ((ptr = (char *) sub_val + ooffset)) {
+						*ptr = '\0';
+					}
+				}
+			}
+
+			switch_safe_free(expanded);
+		} else {
+			switch_stream_handle_t stream = { 0 };
+			char *vname, *vval;
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_assert(stream.data);
+
+			vname = expand_template_render(channel, tp->name, var_list, api_list);
+			vval = expand_template_render(channel, tp->arg, var_list, api_list);
+
+			if (!switch_core_test_flag(SCF_API_EXPANSION) || (api_list && !switch_event_check_permission_list(api_list, vname))) {
+				sub_val = "<API Execute Permission Denied>";
+				free(stream.data);
+			} else {
+				if (switch_api_execute(vname, vval, channel->session, &stream) == SWITCH_STATUS_SUCCESS) {
+					func_val = stream.data;
+					sub_val = func_val;
+				} else {
+					free(stream.data);
+				}
+			}
+
+			if (vname != tp->name->in) {
+				free(vname);
+			}
+
+			if (vval != tp->arg->in) {
+				free(vval);
+			}
+		}
+
+		if (sub_val) {
+			expand_buf_append(&buf, sub_val, strlen(sub_val));
+		}
+
+		switch_safe_free(func_val);
+		switch_safe_free(cloned_sub_val);
+		switch_safe_free(expanded_sub_val);
+	}
+
+	return buf.data;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_channel_expand_template_compile(const char *in, switch_expand_template_t **tplP)
+{
+	switch_assert(tplP);
+
+	*tplP = expand_template_compile(in, 0);
+	(*tplP)->refs = 1;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_channel_expand_template_destroy(switch_expand_template_t **tplP)
+{
+	if (tplP && *tplP) {
+		expand_template_free(*tplP);
+		*tplP = NULL;
+	}
+}
+
+SWITCH_DECLARE(char *) switch_channel_expand_template_render(switch_channel_t *channel, switch_expand_template_t *tpl,
+															 switch_event_t *var_list, switch_event_t *api_list)
+{
+	char *r;
+
+	switch_assert(tpl);
+
+	if ((r = expand_template_render(channel, tpl, var_list, api_list)) == tpl->in) {
+		r = strdup(r);
+	}
+
+	return r;
+}
+
+static void expand_cache_release(switch_expand_template_t *tpl)
+{
+	switch_mutex_lock(globals.expand_mutex);
+	if (!--tpl->refs) {
+		expand_template_free(tpl);
+	}
+	switch_mutex_unlock(globals.expand_mutex);
+}
+
+static void expand_cache_flush(void)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+
+	for (hi = switch_core_hash_first(globals.expand_hash); hi; hi = switch_core_hash_next(&hi)) {
+		switch_expand_template_t *tpl;
+
+		switch_core_hash_this(hi, &var, NULL, &val);
+		tpl = (switch_expand_template_t *) val;
+
+		if (!--tpl->refs) {
+			expand_template_free(tpl);
+		}
+	}
+
+	switch_core_hash_destroy(&globals.expand_hash);
+	switch_core_hash_init(&globals.expand_hash);
+	globals.expand_count = 0;
+}
+
+static switch_expand_template_t *expand_cache_get(const char *in)
+{
+	switch_expand_template_t *tpl, *found;
+
+	switch_mutex_lock(globals.expand_mutex);
+	if ((tpl = switch_core_hash_find(globals.expand_hash, in))) {
+		tpl->refs++;
+		globals.expand_hits++;
+	}
+	switch_mutex_unlock(globals.expand_mutex);
+
+	if (tpl) {
+		return tpl;
+	}
+
+	tpl = expand_template_compile(in, 0);
+
+	switch_mutex_lock(globals.expand_mutex);
+	globals.expand_misses++;
+	if ((found = switch_core_hash_find(globals.expand_hash, in))) {
+		expand_template_free(tpl);
+		tpl = found;
+		tpl->refs++;
+	} else {
+		if (globals.expand_count >= globals.expand_max) {
+			expand_cache_flush();
+		}
+		/* one reference for the cache and one for the caller */
+		tpl->refs = 2;
+		switch_core_hash_insert(globals.expand_hash, tpl->in, tpl);
+		globals.expand_count++;
+	}
+	switch_mutex_unlock(globals.expand_mutex);
+
+	return tpl;
+}
+
+SWITCH_DECLARE(char *) switch_channel_expand_variables_cached_check(switch_channel_t *channel, const char *in, switch_event_t *var_list, switch_event_t *api_list)
+{
+	switch_expand_template_t *tpl;
+	char *r;
+
+	if (zstr(in) || !(switch_string_var_check_const(in) || switch_string_has_escaped_data(in))) {
+		return (char *) in;
+	}
+
+	if (!globals.expand_max) {
+		return switch_channel_expand_variables_check(channel, in, var_list, api_list, 0);
+	}
+
+	tpl = expand_cache_get(in);
+
+	if ((r = expand_template_render(channel, tpl, var_list, api_list)) == tpl->in) {
+		r = (char *) in;
+	}
+
+	expand_cache_release(tpl);
+
+	return r;
+}
+
+SWITCH_DECLARE(void) switch_channel_set_expand_template_cache_size(uint32_t size)
+{
+	switch_mutex_lock(globals.expand_mutex);
+	globals.expand_max = size;
+	if (globals.expand_count > globals.expand_max) {
+		expand_cache_flush();
+	}
+	switch_mutex_unlock(globals.expand_mutex);
+}
+
+SWITCH_DECLARE(void) switch_channel_expand_template_cache_stats(uint32_t *count, uint64_t *hits, uint64_t *misses)
+{
+	switch_mutex_lock(globals.expand_mutex);
+	if (count) *count = globals.expand_count;
+	if (hits) *hits = globals.expand_hits;
+	if (misses) *misses = globals.expand_misses;
+	switch_mutex_unlock(globals.expand_mutex);
+}
+
 SWITCH_DECLARE(char *) switch_channel_build_param_string(switch_channel_t *channel, switch_caller_profile_t *caller_profile, const char *prefix)
 {
 	switch_stream_handle_t stream = { 0 };
@@ -5253,11 +5864,20 @@ SWITCH_DECLARE(void) switch_channel_global_init(switch_memory_pool_t *pool)
 
 	switch_mutex_init(&globals.device_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_core_hash_init(&globals.device_hash);
+
+	switch_mutex_init(&globals.expand_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.expand_hash);
+	globals.expand_max = SWITCH_EXPAND_TEMPLATE_CACHE_SIZE;
 }
 
 SWITCH_DECLARE(void) switch_channel_global_uninit(void)
 {
 	switch_core_hash_destroy(&globals.device_hash);
+
+	switch_mutex_lock(globals.expand_mutex);
+	expand_cache_flush();
+	switch_core_hash_destroy(&globals.expand_hash);
+	switch_mutex_unlock(globals.expand_mutex);
 }
 
 
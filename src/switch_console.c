@@ -662,6 +662,23 @@ static int uuid_callback(void *pArg, int argc, char **argv, char **columnNames)
 
 }
 
+struct uuid_prefix_helper {
+	struct match_helper *h;
+	const char *prefix;
+	switch_size_t len;
+};
+
+static int uuid_prefix_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	struct uuid_prefix_helper *ph = (struct uuid_prefix_helper *) pArg;
+
+	if (argv[0] && (!ph->len || !strncasecmp(argv[0], ph->prefix, ph->len))) {
+		return uuid_callback(ph->h, argc, argv, columnNames);
+	}
+
+	return 0;
+}
+
 SWITCH_DECLARE_NONSTD(switch_status_t) switch_console_list_uuid(const char *line, const char *cursor, switch_console_callback_match_t **matches)
 {
 	char *sql;
@@ -670,6 +687,25 @@ SWITCH_DECLARE_NONSTD(switch_status_t) switch_console_list_uuid(const char *line
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	char *errmsg;
 
+	if (switch_core_memory_tables_enabled()) {
+		switch_core_table_query_t query = { 0 };
+		struct uuid_prefix_helper ph = { 0 };
+
+		ph.h = &h;
+		ph.prefix = cursor;
+		ph.len = zstr(cursor) ? 0 : strlen(cursor);
+		query.table = SWITCH_CORE_TABLE_CHANNELS;
+		query.column = "uuid";
+
+		switch_core_memory_table_query(&query, uuid_prefix_callback, &ph);
+
+		if (h.my_matches) {
+			*matches = h.my_matches;
+			status = SWITCH_STATUS_SUCCESS;
+		}
+
+		return status;
+	}
 
 	if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Database Error\n");
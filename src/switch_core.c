@@ -1913,6 +1913,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_thread_rwlock_create(&runtime.global_var_rwlock, runtime.memory_pool);
 	switch_core_set_globals();
 	switch_core_session_init(runtime.memory_pool);
+	switch_core_file_init(runtime.memory_pool);
+	switch_core_video_init(runtime.memory_pool);
 	switch_event_create_plain(&runtime.global_vars, SWITCH_EVENT_CHANNEL_DATA);
 	switch_core_hash_init_case(&runtime.mime_types, SWITCH_FALSE);
 	switch_core_hash_init_case(&runtime.mime_type_exts, SWITCH_FALSE);
@@ -2073,6 +2075,21 @@ void switch_enable_dump_cores(int enabled)
 	seteuid(uid);
 }
 
+static switch_size_t core_parse_bytes(const char *val)
+{
+	switch_size_t bytes = (switch_size_t) strtoull(val, NULL, 10);
+
+	if (strchr(val, 'g') || strchr(val, 'G')) {
+		bytes *= 1073741824;
+	} else if (strchr(val, 'm') || strchr(val, 'M')) {
+		bytes *= 1048576;
+	} else if (strchr(val, 'k') || strchr(val, 'K')) {
+		bytes *= 1024;
+	}
+
+	return bytes;
+}
+
 static void switch_load_core_config(const char *file)
 {
 	switch_xml_t xml = NULL, cfg = NULL;
@@ -2113,6 +2130,14 @@ static void switch_load_core_config(const char *file)
 		}
 
 		if ((settings = switch_xml_child(cfg, "settings"))) {
+			uint32_t log_rings = 0, log_ring_slots = 0, log_sink_threads = 1;
+			const char *log_binary_file = NULL;
+			switch_size_t prompt_cache_size = 0, prompt_cache_max_file_size = 0;
+			int prompt_cache_size_set = 0, prompt_cache_max_file_size_set = 0;
+			uint32_t record_writer_threads = 0, record_writer_queue_ms = 0, record_writer_flush_ms = 0;
+			switch_size_t record_writer_block_size = 0;
+			switch_record_backpressure_t record_writer_backpressure = SWITCH_RECORD_BACKPRESSURE_DROP;
+
 			for (param = switch_xml_child(settings, "param"); param; param = param->next) {
 				const char *var = switch_xml_attr_soft(param, "name");
 				const char *val = switch_xml_attr_soft(param, "value");
@@ -2172,6 +2197,10 @@ static void switch_load_core_config(const char *file)
 
 				} else if (!strcasecmp(var, "multiple-registrations")) {
 					runtime.multiple_registrations = switch_true(val);
+				} else if (!strcasecmp(var, "core-memory-tables")) {
+					runtime.core_memory_tables = switch_true(val);
+				} else if (!strcasecmp(var, "core-memory-tables-sql-mirror")) {
+					runtime.core_memory_tables_mirror = switch_true(val);
 				} else if (!strcasecmp(var, "auto-create-schemas")) {
 					if (switch_true(val)) {
 						switch_set_flag((&runtime), SCF_AUTO_SCHEMAS);
@@ -2184,6 +2213,25 @@ static void switch_load_core_config(const char *file)
 					} else {
 						switch_clear_flag((&runtime), SCF_SESSION_THREAD_POOL);
 					}
+				} else if (!strcasecmp(var, "session-thread-pool-work-stealing")) {
+					switch_core_session_thread_pool_config(switch_true(val), 0, 0);
+				} else if (!strcasecmp(var, "session-thread-pool-stack-size") && !zstr(val)) {
+					int kb = atoi(val);
+
+					if (kb >= SWITCH_THREAD_STACKSIZE / 1024) {
+						switch_core_session_thread_pool_config(session_manager.work_stealing, (switch_size_t) kb * 1024, 0);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Invalid session-thread-pool-stack-size %s, must be at least %d (KB)\n",
+										  val, SWITCH_THREAD_STACKSIZE / 1024);
+					}
+				} else if (!strcasecmp(var, "session-thread-pool-max-threads") && !zstr(val)) {
+					int max = atoi(val);
+
+					if (max > 0) {
+						switch_core_session_thread_pool_config(session_manager.work_stealing, 0, (uint32_t) max);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Invalid session-thread-pool-max-threads %s\n", val);
+					}
 				} else if (!strcasecmp(var, "auto-clear-sql")) {
 					if (switch_true(val)) {
 						switch_set_flag((&runtime), SCF_CLEAR_SQL);
@@ -2196,6 +2244,8 @@ static void switch_load_core_config(const char *file)
 					} else {
 						switch_clear_flag((&runtime), SCF_API_EXPANSION);
 					}
+				} else if (!strcasecmp(var, "expand-template-cache-size") && !zstr(val)) {
+					switch_channel_set_expand_template_cache_size(atoi(val));
 				} else if (!strcasecmp(var, "enable-early-hangup") && switch_true(val)) {
 					switch_set_flag((&runtime), SCF_EARLY_HANGUP);
 				} else if (!strcasecmp(var, "colorize-console") && switch_true(val)) {
@@ -2418,6 +2468,38 @@ static void switch_load_core_config(const char *file)
 				} else if (!strcasecmp(var, "log-truncate")) {
 					int truncate = atoi(val);
 					switch_core_session_ctl(SCSC_LOG_TRUNCATE, &truncate);
+				} else if (!strcasecmp(var, "log-rings") && !zstr(val)) {
+					log_rings = switch_atoui(val);
+				} else if (!strcasecmp(var, "log-ring-slots") && !zstr(val)) {
+					log_ring_slots = switch_atoui(val);
+				} else if (!strcasecmp(var, "log-sink-threads") && !zstr(val)) {
+					log_sink_threads = switch_atoui(val);
+				} else if (!strcasecmp(var, "log-binary-file")) {
+					log_binary_file = val;
+				} else if (!strcasecmp(var, "prompt-cache-size") && !zstr(val)) {
+					prompt_cache_size = core_parse_bytes(val);
+					prompt_cache_size_set = 1;
+				} else if (!strcasecmp(var, "prompt-cache-max-file-size") && !zstr(val)) {
+					prompt_cache_max_file_size = core_parse_bytes(val);
+					prompt_cache_max_file_size_set = 1;
+				} else if (!strcasecmp(var, "image-pool-size") && !zstr(val)) {
+					switch_img_pool_set_limits(core_parse_bytes(val));
+				} else if (!strcasecmp(var, "record-writer-threads") && !zstr(val)) {
+					record_writer_threads = switch_atoui(val);
+				} else if (!strcasecmp(var, "record-writer-queue-ms") && !zstr(val)) {
+					record_writer_queue_ms = switch_atoui(val);
+				} else if (!strcasecmp(var, "record-writer-block-size") && !zstr(val)) {
+					record_writer_block_size = core_parse_bytes(val);
+				} else if (!strcasecmp(var, "record-writer-flush-ms") && !zstr(val)) {
+					record_writer_flush_ms = switch_atoui(val);
+				} else if (!strcasecmp(var, "record-writer-backpressure") && !zstr(val)) {
+					if (!strcasecmp(val, "wait")) {
+						record_writer_backpressure = SWITCH_RECORD_BACKPRESSURE_WAIT;
+					} else if (!strcasecmp(val, "drop")) {
+						record_writer_backpressure = SWITCH_RECORD_BACKPRESSURE_DROP;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Invalid record-writer-backpressure %s, using drop\n", val);
+					}
 				} else if (!strcasecmp(var, "telnyx-rtp-poll-timeout-s") && !zstr(val)) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Setting RTP blocking mode poll timeout\n");
 					if (!switch_is_number(val)) {
@@ -2430,6 +2512,31 @@ static void switch_load_core_config(const char *file)
 					runtime.add_media_bug_last = switch_true(val);
 				} 
 			}
+
+			if (log_rings && switch_log_rings_start(log_rings, log_ring_slots, log_sink_threads) == SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Logging through %u rings, %u sink thread(s)\n", log_rings, log_sink_threads);
+			}
+
+			if (log_binary_file && switch_log_binary_open(log_binary_file) != SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open binary log %s\n", log_binary_file);
+			}
+
+			/* a reparse without the params keeps whatever was set before, e.g. from the API */
+			if (prompt_cache_size_set || prompt_cache_max_file_size_set) {
+				if (!prompt_cache_size_set) {
+					switch_prompt_cache_stats_t pcs;
+
+					switch_core_prompt_cache_get_stats(&pcs);
+					prompt_cache_size = pcs.max_bytes;
+				}
+				switch_core_prompt_cache_set_limits(prompt_cache_size, prompt_cache_max_file_size);
+			}
+
+			if (record_writer_threads &&
+				switch_ivr_record_writers_start(record_writer_threads, record_writer_queue_ms, record_writer_block_size,
+												record_writer_flush_ms, record_writer_backpressure) == SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Recordings written by %u writer thread(s)\n", record_writer_threads);
+			}
 		}
 
 		if (runtime.event_channel_key_separator == NULL) {
@@ -3140,7 +3247,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Finalizing Shutdown.\n");
 	switch_log_shutdown();
 
+	switch_ivr_record_writers_stop();
 	switch_core_session_uninit();
+	switch_core_file_uninit();
 	switch_core_unset_variables();
 	switch_core_memory_stop();
 
@@ -3186,6 +3295,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	}
 
 	switch_core_media_deinit();
+	switch_core_video_uninit();
 
 	if (runtime.memory_pool) {
 		fspr_pool_destroy(runtime.memory_pool);
@@ -62,6 +62,454 @@ static switch_status_t get_file_size(switch_file_handle_t *fh, const char **stri
 	return status;
 }
 
+/* Prompt cache: decoded (muxed and resampled) audio of read-only local files, keyed by (path, rate, channels).
+   A file is captured the first time a handle reads it to the end; later opens stream from the shared copy
+   without touching the format module.  Entries are refcounted so eviction never pulls audio from a reader. */
+
+struct switch_prompt_cache_entry {
+	char *key;
+	int16_t *data;
+	switch_size_t samples;
+	switch_size_t bytes;
+	uint32_t channels;
+	time_t mtime;
+	int64_t fsize;
+	uint32_t refs;
+	int linked;
+	struct switch_prompt_cache_entry *prev;
+	struct switch_prompt_cache_entry *next;
+};
+
+struct switch_prompt_cache_fill {
+	char *key;
+	time_t mtime;
+	int64_t fsize;
+	uint32_t channels;
+	uint32_t rate;
+	int16_t *data;
+	switch_size_t samples;
+	switch_size_t alloc;
+};
+
+/* handles that need anything but plain 16-bit PCM read front to back from the module */
+#define PROMPT_CACHE_SKIP_FLAGS (SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_NATIVE | SWITCH_FILE_NOMUX | SWITCH_FILE_FLAG_VIDEO | \
+								 SWITCH_FILE_DATA_INT | SWITCH_FILE_DATA_FLOAT | SWITCH_FILE_DATA_DOUBLE | SWITCH_FILE_DATA_RAW)
+
+typedef struct switch_prompt_cache_entry switch_prompt_cache_entry_t;
+typedef struct switch_prompt_cache_fill switch_prompt_cache_fill_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	/* most recently used first */
+	switch_prompt_cache_entry_t *head;
+	switch_prompt_cache_entry_t *tail;
+	switch_prompt_cache_stats_t stats;
+} prompt_cache;
+
+static void prompt_cache_entry_free(switch_prompt_cache_entry_t *entry)
+{
+	switch_safe_free(entry->data);
+	free(entry);
+}
+
+/* the list helpers below are called with prompt_cache.mutex held */
+static void prompt_cache_list_remove(switch_prompt_cache_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		prompt_cache.head = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		prompt_cache.tail = entry->prev;
+	}
+
+	entry->prev = entry->next = NULL;
+}
+
+static void prompt_cache_list_push(switch_prompt_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = prompt_cache.head;
+
+	if (prompt_cache.head) {
+		prompt_cache.head->prev = entry;
+	} else {
+		prompt_cache.tail = entry;
+	}
+
+	prompt_cache.head = entry;
+}
+
+static void prompt_cache_unlink(switch_prompt_cache_entry_t *entry)
+{
+	if (!entry->linked) {
+		return;
+	}
+
+	switch_core_hash_delete(prompt_cache.hash, entry->key);
+	prompt_cache_list_remove(entry);
+	entry->linked = 0;
+	prompt_cache.stats.bytes -= entry->bytes;
+	prompt_cache.stats.entries--;
+
+	if (!entry->refs) {
+		prompt_cache_entry_free(entry);
+	}
+}
+
+static void prompt_cache_trim(void)
+{
+	while (prompt_cache.tail && prompt_cache.stats.bytes > prompt_cache.stats.max_bytes) {
+		prompt_cache_unlink(prompt_cache.tail);
+		prompt_cache.stats.evictions++;
+	}
+}
+
+static void prompt_cache_release(switch_file_handle_t *fh)
+{
+	switch_prompt_cache_entry_t *entry = fh->prompt_entry;
+
+	if (!entry) {
+		return;
+	}
+
+	fh->prompt_entry = NULL;
+	fh->prompt_pos = 0;
+
+	if (!prompt_cache.mutex) {
+		/* released after shutdown, the cache no longer holds it */
+		if (!--entry->refs) {
+			prompt_cache_entry_free(entry);
+		}
+		return;
+	}
+
+	switch_mutex_lock(prompt_cache.mutex);
+	if (!--entry->refs && !entry->linked) {
+		prompt_cache_entry_free(entry);
+	}
+	switch_mutex_unlock(prompt_cache.mutex);
+}
+
+static void prompt_fill_destroy(switch_file_handle_t *fh, switch_bool_t aborted)
+{
+	switch_prompt_cache_fill_t *fill = fh->prompt_fill;
+
+	if (!fill) {
+		return;
+	}
+
+	fh->prompt_fill = NULL;
+
+	if (aborted && prompt_cache.mutex) {
+		switch_mutex_lock(prompt_cache.mutex);
+		prompt_cache.stats.aborts++;
+		switch_mutex_unlock(prompt_cache.mutex);
+	}
+
+	switch_safe_free(fill->data);
+	switch_safe_free(fill->key);
+	free(fill);
+}
+
+static void prompt_fill_commit(switch_file_handle_t *fh)
+{
+	switch_prompt_cache_fill_t *fill = fh->prompt_fill;
+	switch_prompt_cache_entry_t *entry, *old;
+	switch_size_t bytes = fill->samples * 2 * fill->channels;
+	switch_size_t keylen = strlen(fill->key) + 1;
+	void *mem;
+
+	if (!fill->samples || !(entry = calloc(1, sizeof(*entry) + keylen))) {
+		prompt_fill_destroy(fh, SWITCH_TRUE);
+		return;
+	}
+
+	/* the capture buffer becomes the entry, trimmed to size */
+	if ((mem = realloc(fill->data, bytes))) {
+		fill->data = mem;
+	}
+
+	entry->key = (char *) (entry + 1);
+	memcpy(entry->key, fill->key, keylen);
+	entry->data = fill->data;
+	entry->samples = fill->samples;
+	entry->bytes = bytes;
+	entry->channels = fill->channels;
+	entry->mtime = fill->mtime;
+	entry->fsize = fill->fsize;
+	fill->data = NULL;
+
+	prompt_fill_destroy(fh, SWITCH_FALSE);
+
+	switch_mutex_lock(prompt_cache.mutex);
+
+	if (bytes > prompt_cache.stats.max_entry_bytes || bytes > prompt_cache.stats.max_bytes) {
+		prompt_cache.stats.aborts++;
+		switch_mutex_unlock(prompt_cache.mutex);
+		prompt_cache_entry_free(entry);
+		return;
+	}
+
+	if ((old = switch_core_hash_find(prompt_cache.hash, entry->key))) {
+		if (old->mtime == entry->mtime && old->fsize == entry->fsize) {
+			/* another handle finished the same file first */
+			switch_mutex_unlock(prompt_cache.mutex);
+			prompt_cache_entry_free(entry);
+			return;
+		}
+
+		prompt_cache_unlink(old);
+		prompt_cache.stats.invalidations++;
+	}
+
+	switch_core_hash_insert(prompt_cache.hash, entry->key, entry);
+	prompt_cache_list_push(entry);
+	entry->linked = 1;
+	prompt_cache.stats.bytes += bytes;
+	prompt_cache.stats.entries++;
+	prompt_cache.stats.inserts++;
+	prompt_cache_trim();
+
+	switch_mutex_unlock(prompt_cache.mutex);
+}
+
+/* record what switch_core_file_read hands back so the next open can skip the decode */
+static void prompt_fill_feed(switch_file_handle_t *fh, switch_status_t status, void *data, switch_size_t len)
+{
+	switch_prompt_cache_fill_t *fill = fh->prompt_fill;
+
+	if (status == SWITCH_STATUS_BREAK) {
+		return;
+	}
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		if (status == SWITCH_STATUS_FALSE && !len && !fh->max_samples) {
+			prompt_fill_commit(fh);
+		} else {
+			prompt_fill_destroy(fh, SWITCH_TRUE);
+		}
+		return;
+	}
+
+	if (!len) {
+		return;
+	}
+
+	if (fill->samples + len > fill->alloc) {
+		switch_size_t limit = prompt_cache.stats.max_entry_bytes / 2 / fill->channels;
+		switch_size_t alloc = fill->alloc ? fill->alloc * 2 : fill->rate;
+		void *mem;
+
+		if (fill->samples + len > limit) {
+			prompt_fill_destroy(fh, SWITCH_TRUE);
+			return;
+		}
+
+		if (alloc < fill->samples + len) {
+			alloc = fill->samples + len;
+		}
+
+		if (alloc > limit) {
+			alloc = limit;
+		}
+
+		if (!(mem = realloc(fill->data, alloc * 2 * fill->channels))) {
+			prompt_fill_destroy(fh, SWITCH_TRUE);
+			return;
+		}
+
+		fill->data = mem;
+		fill->alloc = alloc;
+	}
+
+	memcpy(fill->data + fill->samples * fill->channels, data, len * 2 * fill->channels);
+	fill->samples += len;
+}
+
+/* serve the open from the cache, or arm a capture so the next one can be */
+static switch_status_t prompt_cache_open(switch_file_handle_t *fh, const char *path, uint32_t rate, uint32_t channels)
+{
+	switch_prompt_cache_entry_t *entry;
+	switch_prompt_cache_fill_t *fill;
+	struct stat st;
+	char *key;
+
+	if (!prompt_cache.mutex || !prompt_cache.stats.max_bytes || stat(path, &st) || (st.st_mode & S_IFMT) != S_IFREG) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	key = switch_mprintf("%s|%u|%u", path, rate, channels);
+
+	switch_mutex_lock(prompt_cache.mutex);
+
+	if ((entry = switch_core_hash_find(prompt_cache.hash, key))) {
+		if (entry->mtime == st.st_mtime && entry->fsize == (int64_t) st.st_size) {
+			entry->refs++;
+			prompt_cache_list_remove(entry);
+			prompt_cache_list_push(entry);
+			prompt_cache.stats.hits++;
+		} else {
+			prompt_cache_unlink(entry);
+			prompt_cache.stats.invalidations++;
+			entry = NULL;
+		}
+	}
+
+	if (!entry) {
+		prompt_cache.stats.misses++;
+	}
+
+	switch_mutex_unlock(prompt_cache.mutex);
+
+	if (entry) {
+		free(key);
+
+		fh->prompt_entry = entry;
+		fh->prompt_pos = 0;
+		fh->samplerate = fh->native_rate = rate;
+		fh->channels = fh->real_channels = fh->mm.channels = channels;
+		fh->samples = (unsigned int) entry->samples;
+		fh->seekable = 1;
+		fh->pre_buffer_datalen = 0;
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_zmalloc(fill, sizeof(*fill));
+	fill->key = key;
+	fill->mtime = st.st_mtime;
+	fill->fsize = (int64_t) st.st_size;
+	fill->rate = rate;
+	fill->channels = channels;
+	fh->prompt_fill = fill;
+
+	return SWITCH_STATUS_FALSE;
+}
+
+static switch_status_t prompt_cache_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
+{
+	switch_prompt_cache_entry_t *entry = fh->prompt_entry;
+	switch_size_t avail = entry->samples - fh->prompt_pos;
+
+	if (fh->max_samples > 0 && fh->samples_in >= (switch_size_t)fh->max_samples) {
+		avail = 0;
+	}
+
+	if (*len > avail) {
+		*len = avail;
+	}
+
+	if (!*len) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	memcpy(data, entry->data + fh->prompt_pos * entry->channels, *len * 2 * entry->channels);
+	fh->prompt_pos += *len;
+	fh->samples_in += *len;
+	fh->pos = fh->prompt_pos;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_seek(switch_file_handle_t *fh, unsigned int *cur_pos, int64_t samples, int whence)
+{
+	int64_t target;
+
+	switch (whence) {
+	case SWITCH_SEEK_CUR:
+		/* relative to the last seek, the same as the format modules see it */
+		target = (int64_t) fh->offset_pos + samples;
+		break;
+	case SWITCH_SEEK_END:
+		target = (int64_t) fh->prompt_entry->samples + samples;
+		break;
+	default:
+		target = samples;
+		break;
+	}
+
+	if (target < 0) {
+		target = 0;
+	} else if (target > (int64_t) fh->prompt_entry->samples) {
+		target = (int64_t) fh->prompt_entry->samples;
+	}
+
+	switch_set_flag_locked(fh, SWITCH_FILE_SEEK);
+	fh->prompt_pos = (switch_size_t) target;
+	fh->pos = target;
+	*cur_pos = (unsigned int) target;
+	fh->offset_pos = *cur_pos;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_core_prompt_cache_set_limits(switch_size_t max_bytes, switch_size_t max_entry_bytes)
+{
+	if (!prompt_cache.mutex) {
+		return;
+	}
+
+	if (!max_entry_bytes || max_entry_bytes > max_bytes) {
+		max_entry_bytes = max_entry_bytes ? max_bytes : max_bytes / 8;
+	}
+
+	switch_mutex_lock(prompt_cache.mutex);
+	prompt_cache.stats.max_bytes = max_bytes;
+	prompt_cache.stats.max_entry_bytes = max_entry_bytes;
+	prompt_cache_trim();
+	switch_mutex_unlock(prompt_cache.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_prompt_cache_get_stats(switch_prompt_cache_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if (!prompt_cache.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(prompt_cache.mutex);
+	*stats = prompt_cache.stats;
+	switch_mutex_unlock(prompt_cache.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_prompt_cache_flush(void)
+{
+	if (!prompt_cache.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(prompt_cache.mutex);
+	while (prompt_cache.head) {
+		prompt_cache_unlink(prompt_cache.head);
+	}
+	switch_mutex_unlock(prompt_cache.mutex);
+}
+
+void switch_core_file_init(switch_memory_pool_t *pool)
+{
+	memset(&prompt_cache, 0, sizeof(prompt_cache));
+	switch_mutex_init(&prompt_cache.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&prompt_cache.hash);
+}
+
+void switch_core_file_uninit(void)
+{
+	if (!prompt_cache.mutex) {
+		return;
+	}
+
+	switch_core_prompt_cache_flush();
+	switch_core_hash_destroy(&prompt_cache.hash);
+	prompt_cache.mutex = NULL;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file, const char *func, int line,
 															  switch_file_handle_t *fh,
 															  const char *file_path,
@@ -84,6 +532,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	}
 
 	fh->samples_in = 0;
+	fh->prompt_entry = NULL;
+	fh->prompt_fill = NULL;
+	fh->prompt_pos = 0;
 
 	if (!(flags & SWITCH_FILE_FLAG_WRITE)) {
 		fh->samplerate = 0;
@@ -393,6 +844,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 
 	file_path = fh->spool_path ? fh->spool_path : fh->file_path;
 
+	if (!is_stream && !fh->params && channels && rate && switch_test_flag(fh, SWITCH_FILE_FLAG_READ) &&
+		!(fh->flags & PROMPT_CACHE_SKIP_FLAGS) && prompt_cache_open(fh, file_path, rate, channels) == SWITCH_STATUS_SUCCESS) {
+		switch_set_flag_locked(fh, SWITCH_FILE_OPEN);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	if ((status = fh->file_interface->file_open(fh, file_path)) != SWITCH_STATUS_SUCCESS) {
 		if (fh->spool_path) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Spool dir is set.  Make sure [%s] is also a valid path\n", fh->spool_path);
@@ -469,6 +926,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
   fail:
 
 	switch_clear_flag_locked(fh, SWITCH_FILE_OPEN);
+	prompt_fill_destroy(fh, SWITCH_FALSE);
 
 	if (fh->params) {
 		switch_event_destroy(&fh->params);
@@ -484,7 +942,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	return status;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
+static switch_status_t core_file_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	switch_size_t want, orig_len = *len;
@@ -616,6 +1074,29 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh,
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
+{
+	switch_status_t status;
+
+	switch_assert(fh != NULL);
+
+	if (fh->prompt_entry) {
+		if (!switch_test_flag(fh, SWITCH_FILE_OPEN)) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		return prompt_cache_read(fh, data, len);
+	}
+
+	status = core_file_read(fh, data, len);
+
+	if (fh->prompt_fill) {
+		prompt_fill_feed(fh, status, data, *len);
+	}
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_bool_t) switch_core_file_has_video(switch_file_handle_t *fh, switch_bool_t check_open)
 {
 	return ((!check_open || switch_test_flag(fh, SWITCH_FILE_OPEN)) && switch_test_flag(fh, SWITCH_FILE_FLAG_VIDEO)) ? SWITCH_TRUE : SWITCH_FALSE;
@@ -783,6 +1264,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 
 	switch_assert(fh != NULL);
 
+	/* a capture only holds audio read straight through */
+	prompt_fill_destroy(fh, SWITCH_TRUE);
+
+	if (fh->prompt_entry && switch_test_flag(fh, SWITCH_FILE_OPEN)) {
+		return prompt_cache_seek(fh, cur_pos, samples, whence);
+	}
+
 	if (!switch_test_flag(fh, SWITCH_FILE_OPEN) || !fh->file_interface->file_seek) {
 		ok = 0;
 	} else if (switch_test_flag(fh, SWITCH_FILE_FLAG_WRITE)) {
@@ -836,7 +1324,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_set_string(switch_file_handle_t
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (!fh->file_interface->file_set_string) {
+	if (fh->prompt_entry || !fh->file_interface->file_set_string) {
 		return SWITCH_STATUS_FALSE;
 	}
 
@@ -854,7 +1342,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_get_string(switch_file_handle_t
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (!fh->file_interface->file_get_string) {
+	if (fh->prompt_entry || !fh->file_interface->file_get_string) {
 		if (col == SWITCH_AUDIO_COL_STR_FILE_SIZE) {
 			return get_file_size(fh, string);
 		}
@@ -924,7 +1412,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_command(switch_file_handle_t *f
 		break;
 	}
 
-	if (fh->file_interface->file_command) {
+	if (!fh->prompt_entry && fh->file_interface->file_command) {
 		switch_mutex_lock(fh->flag_mutex);
 		status = fh->file_interface->file_command(fh, command);
 		switch_mutex_unlock(fh->flag_mutex);
@@ -969,10 +1457,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_pre_close(switch_file_handle_t
 		switch_buffer_destroy(&fh->pre_buffer);
 	}
 
+	prompt_fill_destroy(fh, SWITCH_TRUE);
+
 	switch_clear_flag_locked(fh, SWITCH_FILE_OPEN);
 	switch_set_flag_locked(fh, SWITCH_FILE_PRE_CLOSED);
 
-	if (fh->file_interface->file_pre_close) {
+	if (!fh->prompt_entry && fh->file_interface->file_pre_close) {
 		status = fh->file_interface->file_pre_close(fh);
 	}
 
@@ -1036,6 +1526,19 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_handle_dup(switch_file_handle_t
 		}
 	}
 
+	/* the copy plays from the same cached audio but never captures */
+	fh->prompt_fill = NULL;
+	if (fh->prompt_entry) {
+		if (!prompt_cache.mutex) {
+			/* duplicated after shutdown, only the handles hold it now, see prompt_cache_release() */
+			fh->prompt_entry->refs++;
+		} else {
+			switch_mutex_lock(prompt_cache.mutex);
+			fh->prompt_entry->refs++;
+			switch_mutex_unlock(prompt_cache.mutex);
+		}
+	}
+
 	*newfh = fh;
 
 	return SWITCH_STATUS_SUCCESS;
@@ -1060,7 +1563,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_close(switch_file_handle_t *fh)
 
 	switch_clear_flag_locked(fh, SWITCH_FILE_PRE_CLOSED);
 
-	fh->file_interface->file_close(fh);
+	if (fh->prompt_entry) {
+		prompt_cache_release(fh);
+	} else {
+		fh->file_interface->file_close(fh);
+	}
 
 	if (fh->params) {
 		switch_event_destroy(&fh->params);
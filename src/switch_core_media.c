@@ -35,6 +35,7 @@
 #include <switch_stun.h>
 #include <switch_nat.h>
 #include "private/switch_core_pvt.h"
+#include <g711.h>
 #include <switch_curl.h>
 #include <errno.h>
 #include <sofia-sip/sdp.h>
@@ -17385,6 +17386,183 @@ SWITCH_DECLARE(switch_msrp_session_t *) switch_core_media_get_msrp_session(switc
 }
 
 
+static char xcode_kind(const switch_codec_implementation_t *impl)
+{
+	if (impl->actual_samples_per_second == 8000) {
+		if (!strcasecmp(impl->iananame, "PCMU")) {
+			return 'u';
+		}
+		if (!strcasecmp(impl->iananame, "PCMA")) {
+			return 'a';
+		}
+	} else if (impl->actual_samples_per_second == 16000) {
+		if (!strcasecmp(impl->iananame, "G722")) {
+			return 'g';
+		}
+		if (!strcasecmp(impl->iananame, "L16")) {
+			return 'l';
+		}
+	}
+
+	return 0;
+}
+
+#define XCODE_IS_G711(_k) ((_k) == 'u' || (_k) == 'a')
+
+SWITCH_DECLARE(switch_xcode_path_t) switch_core_media_xcode_select(switch_xcode_t *xc, const switch_codec_implementation_t *from, const switch_codec_implementation_t *to)
+{
+	memset(xc, 0, sizeof(*xc));
+	xc->from = from;
+	xc->to = to;
+
+	if (!from || !to || from->codec_type != SWITCH_CODEC_TYPE_AUDIO || to->codec_type != SWITCH_CODEC_TYPE_AUDIO ||
+		from->number_of_channels != 1 || to->number_of_channels != 1 || from->microseconds_per_packet != to->microseconds_per_packet) {
+		return xc->path;
+	}
+
+	xc->from_kind = xcode_kind(from);
+	xc->to_kind = xcode_kind(to);
+
+	if (xc->from_kind == 'u' && xc->to_kind == 'a') {
+		xc->path = SWITCH_XCODE_ULAW_ALAW;
+	} else if (xc->from_kind == 'a' && xc->to_kind == 'u') {
+		xc->path = SWITCH_XCODE_ALAW_ULAW;
+	} else if (XCODE_IS_G711(xc->from_kind) && (xc->to_kind == 'g' || xc->to_kind == 'l')) {
+		xc->path = SWITCH_XCODE_G711_WIDE;
+	} else if ((xc->from_kind == 'g' || xc->from_kind == 'l') && XCODE_IS_G711(xc->to_kind)) {
+		xc->path = SWITCH_XCODE_WIDE_G711;
+	}
+
+	return xc->path;
+}
+
+/*
+  Both directions use the same 11 tap half band filter, {3, 0, -25, 0, 150, 256, 150, 0, -25, 0, 3} / 512.
+  Going up every 8kHz sample is expanded and the odd 16kHz sample is interpolated from the 6 around it
+  in the same pass, going down the filter is only evaluated on the kept samples, each one companded
+  right away.  That replaces a speex resampler and two extra copies of the packet per frame.
+*/
+static void xcode_upsample(switch_xcode_t *xc, const uint8_t *in, uint32_t len, int16_t *out)
+{
+	int32_t s0 = xc->hist[0], s1 = xc->hist[1], s2 = xc->hist[2], s3 = xc->hist[3], s4 = xc->hist[4];
+	int ulaw = xc->from_kind == 'u';
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		int32_t x = ulaw ? ulaw_to_linear(in[i]) : alaw_to_linear(in[i]);
+		int32_t mid = (3 * (s0 + x) - 25 * (s1 + s4) + 150 * (s2 + s3) + 128) >> 8;
+
+		*out++ = (int16_t) s2;
+		*out++ = (int16_t) (mid > 32767 ? 32767 : mid < -32768 ? -32768 : mid);
+
+		s0 = s1;
+		s1 = s2;
+		s2 = s3;
+		s3 = s4;
+		s4 = x;
+	}
+
+	xc->hist[0] = (int16_t) s0;
+	xc->hist[1] = (int16_t) s1;
+	xc->hist[2] = (int16_t) s2;
+	xc->hist[3] = (int16_t) s3;
+	xc->hist[4] = (int16_t) s4;
+}
+
+static void xcode_downsample(switch_xcode_t *xc, const int16_t *in, uint32_t samples, uint8_t *out)
+{
+	int16_t work[SWITCH_XCODE_HIST + SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	const int16_t *w = work + SWITCH_XCODE_HIST - 4;
+	int ulaw = xc->to_kind == 'u';
+	uint32_t i;
+
+	memcpy(work, xc->hist, sizeof(xc->hist));
+	memcpy(work + SWITCH_XCODE_HIST, in, samples * sizeof(int16_t));
+
+	for (i = 0; i < samples / 2; i++, w += 2) {
+		int32_t y = (256 * w[0] + 150 * (w[-1] + w[1]) - 25 * (w[-3] + w[3]) + 3 * (w[-5] + w[5]) + 256) >> 9;
+
+		y = y > 32767 ? 32767 : y < -32768 ? -32768 : y;
+		*out++ = ulaw ? linear_to_ulaw(y) : linear_to_alaw(y);
+	}
+
+	memcpy(xc->hist, work + samples, sizeof(xc->hist));
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_media_xcode(switch_xcode_t *xc, switch_codec_t *from_codec, switch_codec_t *to_codec,
+														const void *in, uint32_t in_len, void *out, uint32_t *out_len)
+{
+	int16_t lin[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	const uint8_t *src = in;
+	uint8_t *dst = out;
+	uint32_t i, len, rate = 0, flag = 0;
+
+	switch (xc->path) {
+	case SWITCH_XCODE_ULAW_ALAW:
+	case SWITCH_XCODE_ALAW_ULAW:
+		if (in_len > *out_len) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		if (xc->path == SWITCH_XCODE_ULAW_ALAW) {
+			for (i = 0; i < in_len; i++) {
+				dst[i] = ulaw_to_alaw(src[i]);
+			}
+		} else {
+			for (i = 0; i < in_len; i++) {
+				dst[i] = alaw_to_ulaw(src[i]);
+			}
+		}
+
+		*out_len = in_len;
+		return SWITCH_STATUS_SUCCESS;
+	case SWITCH_XCODE_G711_WIDE:
+		len = in_len * 2 * sizeof(int16_t);
+
+		if (len > sizeof(lin)) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		if (xc->to_kind == 'l') {
+			if (len > *out_len) {
+				return SWITCH_STATUS_FALSE;
+			}
+			xcode_upsample(xc, src, in_len, (int16_t *) out);
+			*out_len = len;
+			return SWITCH_STATUS_SUCCESS;
+		}
+
+		xcode_upsample(xc, src, in_len, lin);
+		return switch_core_codec_encode(to_codec, from_codec, lin, len, 16000, out, out_len, &rate, &flag);
+	case SWITCH_XCODE_WIDE_G711:
+		{
+			const int16_t *wide = in;
+
+			if (xc->from_kind == 'l') {
+				len = in_len;
+			} else {
+				len = sizeof(lin);
+				if (switch_core_codec_decode(from_codec, to_codec, (void *) in, in_len, 16000, lin, &len, &rate, &flag) != SWITCH_STATUS_SUCCESS) {
+					return SWITCH_STATUS_FALSE;
+				}
+				wide = lin;
+			}
+
+			if (len > sizeof(lin) || (len & 3) || len / 4 > *out_len) {
+				return SWITCH_STATUS_FALSE;
+			}
+
+			xcode_downsample(xc, wide, len / sizeof(int16_t), dst);
+		}
+		*out_len = len / 4;
+		return SWITCH_STATUS_SUCCESS;
+	default:
+		break;
+	}
+
+	return SWITCH_STATUS_FALSE;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_session_t *session, switch_frame_t *frame, switch_io_flag_t flags,
 																int stream_id)
 {
@@ -17521,6 +17699,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 
 	if (switch_test_flag(session, SSF_WRITE_CODEC_RESET)) {
 		switch_core_codec_reset(session->write_codec);
+		session->write_xcode.from = NULL;
 		switch_clear_flag(session, SSF_WRITE_CODEC_RESET);
 	}
 
@@ -17538,6 +17717,40 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 		switch_set_flag(session, SSF_WARN_TRANSCODE);
 	}
 
+	/* G.711, G.722 and L16@16k between each other go straight from frame->data to enc_write_frame */
+	if (session->write_xcode.from != frame->codec->implementation || session->write_xcode.to != session->write_codec->implementation) {
+		if (switch_core_media_xcode_select(&session->write_xcode, frame->codec->implementation, session->write_codec->implementation) != SWITCH_XCODE_NONE) {
+			if (switch_channel_var_true(session->channel, "disable_direct_transcode")) {
+				session->write_xcode.path = SWITCH_XCODE_NONE;
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Direct transcoding %s@%uh -> %s@%uh\n",
+								  frame->codec->implementation->iananame, frame->codec->implementation->actual_samples_per_second,
+								  session->write_impl.iananame, session->write_impl.actual_samples_per_second);
+			}
+		}
+	}
+
+	if (session->write_xcode.path != SWITCH_XCODE_NONE && !session->bugs && !ptime_mismatch && !switch_test_flag(frame, SFF_PLC) &&
+		frame->datalen == frame->codec->implementation->encoded_bytes_per_packet) {
+		session->enc_write_frame.datalen = session->enc_write_frame.buflen;
+
+		if (switch_core_media_xcode(&session->write_xcode, frame->codec, session->write_codec, frame->data, frame->datalen,
+									session->enc_write_frame.data, &session->enc_write_frame.datalen) == SWITCH_STATUS_SUCCESS) {
+			session->enc_write_frame.codec = session->write_codec;
+			session->enc_write_frame.samples = session->write_impl.samples_per_packet;
+			session->enc_write_frame.channels = session->write_impl.number_of_channels;
+			session->enc_write_frame.rate = session->write_impl.actual_samples_per_second;
+			session->enc_write_frame.timestamp = frame->timestamp;
+			session->enc_write_frame.payload = session->write_impl.ianacode;
+			session->enc_write_frame.m = frame->m;
+			session->enc_write_frame.ssrc = frame->ssrc;
+			session->enc_write_frame.seq = frame->seq;
+			session->enc_write_frame.flags = 0;
+			status = perform_write(session, &session->enc_write_frame, flags, stream_id);
+			goto error;
+		}
+	}
+
 	if (frame->codec) {
 		session->raw_write_frame.datalen = session->raw_write_frame.buflen;
 		frame->codec->cur_frame = frame;
@@ -1616,7 +1616,22 @@ SWITCH_DECLARE(switch_mutex_t *) switch_core_session_get_mutex(switch_core_sessi
 SWITCH_DECLARE(switch_status_t) switch_core_session_wake_session_thread(switch_core_session_t *session)
 {
 	switch_status_t status;
-	int tries = 0;
+	int tries = 0, resume = 0;
+
+	switch_mutex_lock(session->task_mutex);
+	if (session->task_suspended) {
+		session->task_suspended = 0;
+		resume = 1;
+	} else {
+		session->task_wake_pending = 1;
+	}
+	switch_mutex_unlock(session->task_mutex);
+
+	if (resume) {
+		/* the state machine gave its worker back when it went to sleep, give it a new one */
+		switch_core_session_task_schedule(session);
+		return SWITCH_STATUS_SUCCESS;
+	}
 
 	/* If trylock fails the signal is already awake so we needn't bother ..... or do we????*/
 
@@ -1888,17 +1903,12 @@ SWITCH_DECLARE(switch_bool_t) switch_core_session_in_thread(switch_core_session_
 	return switch_thread_equal(switch_thread_self(), session->thread_id) ? SWITCH_TRUE : SWITCH_FALSE;
 }
 
-static void *SWITCH_THREAD_FUNC switch_core_session_thread(switch_thread_t *thread, void *obj)
+static void switch_core_session_thread_done(switch_core_session_t *session)
 {
-	switch_core_session_t *session = obj;
 	switch_event_t *event;
 	char *event_str = NULL;
 	const char *val;
 
-	session->thread = thread;
-	session->thread_id = switch_thread_self();
-
-	switch_core_session_run(session);
 	switch_core_media_bug_remove_all(session);
 
 	if (session->soft_lock) {
@@ -1938,13 +1948,160 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread(switch_thread_t *thre
 
 	switch_set_flag(session, SSF_DESTROYABLE);
 	switch_core_session_destroy(&session);
+}
+
+static void *SWITCH_THREAD_FUNC switch_core_session_thread(switch_thread_t *thread, void *obj)
+{
+	switch_core_session_t *session = obj;
+
+	session->thread = thread;
+	session->thread_id = switch_thread_self();
+
+	switch_core_session_run(session);
+	switch_core_session_thread_done(session);
+	return NULL;
+}
+
+static void *SWITCH_THREAD_FUNC switch_core_session_done_task(switch_thread_t *thread, void *obj)
+{
+	switch_core_session_thread_done((switch_core_session_t *) obj);
+	return NULL;
+}
+
+static void session_task_run(switch_thread_t *thread, switch_core_session_t *session, switch_session_run_mode_t mode)
+{
+	/* the task that gave the worker back cleared these under the same lock */
+	switch_mutex_lock(session->mutex);
+	session->thread = thread;
+	session->thread_id = switch_thread_self();
+	switch_mutex_unlock(session->mutex);
+
+	if (switch_core_session_run_task(session, mode) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	if (mode == SWITCH_SESSION_RUN_POOL) {
+		/* teardown waits for external entities to let go of the session, keep that off the bounded pool */
+		switch_thread_data_t *td;
+
+		switch_zmalloc(td, sizeof(*td));
+		td->alloc = 1;
+		td->obj = session;
+		td->func = switch_core_session_done_task;
+		switch_thread_pool_launch_thread(&td);
+	} else {
+		switch_core_session_thread_done(session);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC switch_core_session_pool_task(switch_thread_t *thread, void *obj)
+{
+	session_task_run(thread, (switch_core_session_t *) obj, SWITCH_SESSION_RUN_POOL);
+	return NULL;
+}
+
+static void *SWITCH_THREAD_FUNC switch_core_session_media_task(switch_thread_t *thread, void *obj)
+{
+	session_task_run(thread, (switch_core_session_t *) obj, SWITCH_SESSION_RUN_MEDIA);
+	return NULL;
+}
+
+/* runs a task that could not be queued on a thread of its own */
+static void *SWITCH_THREAD_FUNC switch_core_session_thread_pool_fallback(switch_thread_t *thread, void *obj)
+{
+	switch_thread_data_t *td = (switch_thread_data_t *) obj;
+
+	td->running = 1;
+	td->func(thread, td->obj);
+	free(td);
+
 	return NULL;
 }
 
 typedef struct switch_thread_pool_node_s {
 	switch_memory_pool_t *pool;
+	uint32_t home;
 } switch_thread_pool_node_t;
 
+#define SWITCH_THREAD_POOL_MAX_SHARDS 64
+
+/*
+ * In work stealing mode the session state machine runs as short tasks on a bounded pool with a deque
+ * of pending tasks per cpu.  Workers take the oldest task from their home deque and steal the oldest
+ * task from the other deques when their own is empty, so a woken session is not starved by newer ones.  Media states, and anything else that blocks,
+ * stay on the classic unbounded workers behind thread_queue where each job keeps its thread.
+ */
+struct switch_thread_pool_shard_s {
+	switch_mutex_t *mutex;
+	switch_thread_data_t **jobs;
+	uint32_t size;
+	uint32_t head;
+	uint32_t count;
+};
+
+static void thread_pool_shard_push(struct switch_thread_pool_shard_s *shard, switch_thread_data_t *td)
+{
+	switch_mutex_lock(shard->mutex);
+	if (shard->count == shard->size) {
+		uint32_t new_size = shard->size ? shard->size * 2 : 64, i;
+		switch_thread_data_t **jobs = malloc(sizeof(*jobs) * new_size);
+
+		switch_assert(jobs);
+		for (i = 0; i < shard->count; i++) {
+			jobs[i] = shard->jobs[(shard->head + i) % shard->size];
+		}
+		switch_safe_free(shard->jobs);
+		shard->jobs = jobs;
+		shard->size = new_size;
+		shard->head = 0;
+	}
+	shard->jobs[(shard->head + shard->count) % shard->size] = td;
+	shard->count++;
+	switch_mutex_unlock(shard->mutex);
+}
+
+static switch_thread_data_t *thread_pool_shard_pop(struct switch_thread_pool_shard_s *shard)
+{
+	switch_thread_data_t *td = NULL;
+
+	if (!shard->count) {
+		return NULL;
+	}
+
+	switch_mutex_lock(shard->mutex);
+	if (shard->count) {
+		td = shard->jobs[shard->head];
+		shard->head = (shard->head + 1) % shard->size;
+		shard->count--;
+	}
+	switch_mutex_unlock(shard->mutex);
+
+	return td;
+}
+
+static switch_thread_data_t *thread_pool_take(uint32_t home)
+{
+	switch_thread_data_t *td;
+	uint32_t i;
+
+	if ((td = thread_pool_shard_pop(&session_manager.shards[home]))) {
+		switch_atomic_dec(&session_manager.pending);
+		return td;
+	}
+
+	for (i = 1; i < session_manager.pool_shards; i++) {
+		if ((td = thread_pool_shard_pop(&session_manager.shards[(home + i) % session_manager.pool_shards]))) {
+			switch_atomic_dec(&session_manager.pending);
+			switch_mutex_lock(session_manager.idle_mutex);
+			session_manager.steals++;
+			switch_mutex_unlock(session_manager.idle_mutex);
+			return td;
+		}
+	}
+
+	return NULL;
+}
+
 static void *SWITCH_THREAD_FUNC switch_core_session_thread_pool_worker(switch_thread_t *thread, void *obj)
 {
 	switch_thread_pool_node_t *node = (switch_thread_pool_node_t *) obj;
@@ -1997,6 +2154,59 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread_pool_worker(switch_th
 	return NULL;
 }
 
+static void *SWITCH_THREAD_FUNC switch_core_session_thread_pool_task_worker(switch_thread_t *thread, void *obj)
+{
+	switch_thread_pool_node_t *node = (switch_thread_pool_node_t *) obj;
+	switch_memory_pool_t *pool = node->pool;
+
+	for (;;) {
+		switch_thread_data_t *td;
+
+		if (!(td = thread_pool_take(node->home))) {
+			switch_status_t status = SWITCH_STATUS_SUCCESS;
+			int done = 0;
+
+			switch_mutex_lock(session_manager.idle_mutex);
+			if (!session_manager.pool_shutdown && !switch_atomic_read(&session_manager.pending)) {
+				session_manager.pool_idle++;
+				status = switch_thread_cond_timedwait(session_manager.idle_cond, session_manager.idle_mutex, 5000000);
+				session_manager.pool_idle--;
+			}
+
+			/* tasks left in the deques after a mode change are drained before the worker retires */
+			if (session_manager.pool_shutdown || (switch_status_is_timeup(status) && !switch_atomic_read(&session_manager.pending))) {
+				session_manager.pool_running--;
+				switch_thread_cond_broadcast(session_manager.idle_cond);
+				done = 1;
+			}
+			switch_mutex_unlock(session_manager.idle_mutex);
+
+			if (done) {
+				break;
+			}
+
+			continue;
+		}
+
+		switch_atomic_inc(&session_manager.tasks);
+
+		td->running = 1;
+		td->func(thread, td->obj);
+		td->running = 0;
+
+		if (td->pool) {
+			switch_memory_pool_t *pool = td->pool;
+			td = NULL;
+			switch_core_destroy_memory_pool(&pool);
+		} else if (td->alloc) {
+			free(td);
+		}
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+	return NULL;
+}
+
 static void thread_launch_failure(void)
 {
 	uint32_t sess_count;
@@ -2063,6 +2273,128 @@ static switch_status_t check_queue(void)
 	return status;
 }
 
+static void thread_pool_task_worker_launch(void)
+{
+	switch_thread_t *thread;
+	switch_threadattr_t *thd_attr;
+	switch_memory_pool_t *pool;
+	switch_thread_pool_node_t *node;
+
+	switch_core_new_memory_pool(&pool);
+	node = switch_core_alloc(pool, sizeof(*node));
+	node->pool = pool;
+
+	switch_mutex_lock(session_manager.idle_mutex);
+	node->home = session_manager.next_home++ % session_manager.pool_shards;
+	switch_mutex_unlock(session_manager.idle_mutex);
+
+	switch_threadattr_create(&thd_attr, node->pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	switch_threadattr_stacksize_set(thd_attr, session_manager.pool_stack_size);
+	switch_threadattr_priority_set(thd_attr, SWITCH_PRI_LOW);
+
+	if (switch_thread_create(&thread, thd_attr, switch_core_session_thread_pool_task_worker, node, node->pool) != SWITCH_STATUS_SUCCESS) {
+		switch_mutex_lock(session_manager.idle_mutex);
+		session_manager.pool_running--;
+		switch_mutex_unlock(session_manager.idle_mutex);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Thread Failure!\n");
+		switch_core_destroy_memory_pool(&pool);
+		thread_launch_failure();
+	}
+}
+
+/* returns SWITCH_STATUS_FALSE when work stealing is off so the caller can fall back to thread_queue */
+static switch_status_t thread_pool_task_push(switch_thread_data_t *td)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	int launch = 0;
+
+	switch_mutex_lock(session_manager.idle_mutex);
+	if (session_manager.pool_shutdown) {
+		status = SWITCH_STATUS_TERM;
+	} else if (!session_manager.work_stealing) {
+		status = SWITCH_STATUS_FALSE;
+	} else {
+		switch_atomic_inc(&session_manager.pending);
+		thread_pool_shard_push(&session_manager.shards[session_manager.next_shard++ % session_manager.pool_shards], td);
+
+		if (session_manager.pool_idle) {
+			switch_thread_cond_signal(session_manager.idle_cond);
+		}
+
+		if (switch_atomic_read(&session_manager.pending) > session_manager.pool_idle &&
+			session_manager.pool_running < session_manager.pool_max_threads) {
+			session_manager.pool_running++;
+			launch = 1;
+		}
+	}
+	switch_mutex_unlock(session_manager.idle_mutex);
+
+	if (launch) {
+		thread_pool_task_worker_launch();
+	}
+
+	return status;
+}
+
+switch_session_run_mode_t switch_core_session_task_mode(switch_core_session_t *session)
+{
+	if (!session_manager.work_stealing || session_manager.pool_shutdown || switch_channel_test_flag(session->channel, CF_BLOCK_STATE)) {
+		return SWITCH_SESSION_RUN_MEDIA;
+	}
+
+	switch (switch_channel_get_state(session->channel)) {
+	case CS_NEW:
+	case CS_EXECUTE:
+	case CS_EXCHANGE_MEDIA:
+	case CS_SOFT_EXECUTE:
+	case CS_PARK:
+	case CS_CONSUME_MEDIA:
+		return SWITCH_SESSION_RUN_MEDIA;
+	default:
+		return SWITCH_SESSION_RUN_POOL;
+	}
+}
+
+void switch_core_session_task_schedule(switch_core_session_t *session)
+{
+	switch_thread_data_t *td;
+	switch_status_t status;
+
+	switch_zmalloc(td, sizeof(*td));
+	td->alloc = 1;
+	td->obj = session;
+
+	if (switch_core_session_task_mode(session) == SWITCH_SESSION_RUN_POOL) {
+		td->func = switch_core_session_pool_task;
+		if ((status = thread_pool_task_push(td)) != SWITCH_STATUS_FALSE) {
+			goto end;
+		}
+	}
+
+	td->func = switch_core_session_media_task;
+	if ((status = switch_queue_push(session_manager.thread_queue, td)) == SWITCH_STATUS_SUCCESS) {
+		check_queue();
+	}
+
+ end:
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		switch_thread_t *thread;
+		switch_threadattr_t *thd_attr;
+
+		/* the pools are shutting down, nothing would ever run the task again and the session would leak */
+		switch_threadattr_create(&thd_attr, session->pool);
+		switch_threadattr_detach_set(thd_attr, 1);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		td->func = switch_core_session_media_task;
+
+		if (switch_thread_create(&thread, thd_attr, switch_core_session_thread_pool_fallback, td, session->pool) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Cannot schedule session task!\n");
+			free(td);
+		}
+	}
+}
 
 SWITCH_DECLARE(switch_status_t) switch_thread_pool_launch_thread(switch_thread_data_t **tdp)
 {
@@ -2080,6 +2412,24 @@ SWITCH_DECLARE(switch_status_t) switch_thread_pool_launch_thread(switch_thread_d
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_thread_pool_launch_task(switch_thread_data_t **tdp)
+{
+	switch_status_t status;
+	switch_thread_data_t *td;
+
+	switch_assert(tdp);
+
+	td = *tdp;
+
+	if ((status = thread_pool_task_push(td)) == SWITCH_STATUS_FALSE) {
+		return switch_thread_pool_launch_thread(tdp);
+	}
+
+	*tdp = NULL;
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_thread_pool_wait(switch_thread_data_t *td, int ms)
 {
 	while(!td->running && --ms > 0) {
@@ -2102,11 +2452,17 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_thread_pool_launch(switch_co
 	} else {
 		switch_set_flag(session, SSF_THREAD_RUNNING);
 		switch_set_flag(session, SSF_THREAD_STARTED);
-		td = switch_core_session_alloc(session, sizeof(*td));
-		td->obj = session;
-		td->func = switch_core_session_thread;
-		status = switch_queue_push(session_manager.thread_queue, td);
-		check_queue();
+
+		if (session_manager.work_stealing) {
+			switch_core_session_task_schedule(session);
+			status = SWITCH_STATUS_SUCCESS;
+		} else {
+			td = switch_core_session_alloc(session, sizeof(*td));
+			td->obj = session;
+			td->func = switch_core_session_thread;
+			status = switch_queue_push(session_manager.thread_queue, td);
+			check_queue();
+		}
 	}
 	switch_mutex_unlock(session->mutex);
 
@@ -2662,6 +3018,7 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	session->fork_enc_read_frame.buflen = sizeof(session->fork_enc_read_buf);
 
 	switch_mutex_init(&session->mutex, SWITCH_MUTEX_NESTED, session->pool);
+	switch_mutex_init(&session->task_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	switch_mutex_init(&session->stack_count_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	switch_mutex_init(&session->resample_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	switch_mutex_init(&session->codec_init_mutex, SWITCH_MUTEX_NESTED, session->pool);
@@ -2815,6 +3172,8 @@ SWITCH_DECLARE(uint32_t) switch_core_sessions_per_second(uint32_t new_limit)
 
 void switch_core_session_init(switch_memory_pool_t *pool)
 {
+	uint32_t i;
+
 	memset(&session_manager, 0, sizeof(session_manager));
 	session_manager.session_limit = 1000;
 	session_manager.drop_udp_invites = SWITCH_FALSE;
@@ -2824,16 +3183,44 @@ void switch_core_session_init(switch_memory_pool_t *pool)
 	switch_mutex_init(&session_manager.mutex, SWITCH_MUTEX_DEFAULT, session_manager.memory_pool);
 	switch_thread_cond_create(&session_manager.cond, session_manager.memory_pool);
 	switch_queue_create(&session_manager.thread_queue, 100000, session_manager.memory_pool);
+
+	session_manager.pool_stack_size = SWITCH_THREAD_STACKSIZE;
+	session_manager.pool_shards = switch_core_cpu_count();
+	if (session_manager.pool_shards > SWITCH_THREAD_POOL_MAX_SHARDS) {
+		session_manager.pool_shards = SWITCH_THREAD_POOL_MAX_SHARDS;
+	}
+	session_manager.shards = switch_core_alloc(session_manager.memory_pool, sizeof(*session_manager.shards) * session_manager.pool_shards);
+	for (i = 0; i < session_manager.pool_shards; i++) {
+		switch_mutex_init(&session_manager.shards[i].mutex, SWITCH_MUTEX_NESTED, session_manager.memory_pool);
+	}
+	session_manager.pool_max_threads = session_manager.pool_shards * 2;
+	switch_mutex_init(&session_manager.idle_mutex, SWITCH_MUTEX_NESTED, session_manager.memory_pool);
+	switch_thread_cond_create(&session_manager.idle_cond, session_manager.memory_pool);
 }
 
 void switch_core_session_uninit(void)
 {
+	uint32_t i;
+
 	switch_queue_term(session_manager.thread_queue);
+
+	switch_mutex_lock(session_manager.idle_mutex);
+	session_manager.pool_shutdown = 1;
+	switch_thread_cond_broadcast(session_manager.idle_cond);
+	for (i = 0; session_manager.pool_running && i < 100; i++) {
+		switch_thread_cond_timedwait(session_manager.idle_cond, session_manager.idle_mutex, 100000);
+	}
+	switch_mutex_unlock(session_manager.idle_mutex);
+
 	switch_mutex_lock(session_manager.mutex);
 	if (session_manager.running)
 		switch_thread_cond_timedwait(session_manager.cond, session_manager.mutex, 10000000);
 	switch_mutex_unlock(session_manager.mutex);
 	switch_core_hash_destroy(&session_manager.session_table);
+
+	for (i = 0; i < session_manager.pool_shards; i++) {
+		switch_safe_free(session_manager.shards[i].jobs);
+	}
 }
 
 SWITCH_DECLARE(switch_app_log_t *) switch_core_session_get_app_log(switch_core_session_t *session)
@@ -3056,7 +3443,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_exec(switch_core_session_t *
 
 	if (arg) {
 		if (expand_variables) {
-			expanded = switch_channel_expand_variables(session->channel, arg);
+			expanded = switch_channel_expand_variables_cached(session->channel, arg);
 		} else {
 			expanded = (char *)arg;
 		}
@@ -3315,6 +3702,92 @@ SWITCH_DECLARE(void) switch_core_session_debug_pool(switch_stream_handle_t *stre
 {
 	stream->write_function(stream, "Thread pool: running:%d busy:%d popping:%d\n",
 		session_manager.running, session_manager.busy, session_manager.running - session_manager.busy);
+
+	if (session_manager.work_stealing || session_manager.pool_running) {
+		uint32_t i;
+
+		stream->write_function(stream, "Work stealing: %s workers:%u/%u idle:%u shards:%u queued:%u tasks:%u steals:%" SWITCH_UINT64_T_FMT " stack:%" SWITCH_SIZE_T_FMT "k\n",
+			session_manager.work_stealing ? "on" : "draining", session_manager.pool_running, session_manager.pool_max_threads,
+			session_manager.pool_idle, session_manager.pool_shards, switch_atomic_read(&session_manager.pending),
+			switch_atomic_read(&session_manager.tasks), session_manager.steals, session_manager.pool_stack_size / 1024);
+
+		for (i = 0; i < session_manager.pool_shards; i++) {
+			stream->write_function(stream, "  shard %u: queued:%u\n", i, session_manager.shards[i].count);
+		}
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_session_thread_pool_config(switch_bool_t work_stealing, switch_size_t stack_size, uint32_t max_threads)
+{
+	switch_thread_data_t *td;
+	uint32_t moved = 0, i, len;
+	void *pop;
+
+	if (stack_size && stack_size < SWITCH_THREAD_STACKSIZE) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Thread pool stack size %" SWITCH_SIZE_T_FMT " is below the %d byte minimum\n",
+						  stack_size, SWITCH_THREAD_STACKSIZE);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(session_manager.idle_mutex);
+	if (stack_size) {
+		session_manager.pool_stack_size = stack_size;
+	}
+
+	if (max_threads) {
+		session_manager.pool_max_threads = max_threads;
+	}
+
+	if (session_manager.work_stealing == work_stealing) {
+		switch_mutex_unlock(session_manager.idle_mutex);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	session_manager.work_stealing = work_stealing;
+
+	if (!work_stealing) {
+		/* nothing new lands in the deques from here on, hand what is queued to the classic workers */
+		while ((td = thread_pool_take(0))) {
+			switch_queue_push(session_manager.thread_queue, td);
+			moved++;
+		}
+	}
+	switch_mutex_unlock(session_manager.idle_mutex);
+
+	if (!work_stealing) {
+		for (i = 0; i < moved; i++) {
+			check_queue();
+		}
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	/* sessions waiting in thread_queue for a dedicated worker become state machine tasks instead */
+	len = switch_queue_size(session_manager.thread_queue);
+	for (i = 0; i < len && switch_queue_trypop(session_manager.thread_queue, &pop) == SWITCH_STATUS_SUCCESS; i++) {
+		td = (switch_thread_data_t *) pop;
+
+		if (td->func == switch_core_session_thread) {
+			switch_thread_data_t *task;
+
+			switch_zmalloc(task, sizeof(*task));
+			task->alloc = 1;
+			task->obj = td->obj;
+			task->func = switch_core_session_pool_task;
+
+			if (thread_pool_task_push(task) == SWITCH_STATUS_SUCCESS) {
+				switch_mutex_lock(session_manager.mutex);
+				session_manager.busy--;
+				switch_mutex_unlock(session_manager.mutex);
+				continue;
+			}
+
+			free(task);
+		}
+
+		switch_queue_push(session_manager.thread_queue, td);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_DECLARE(void) switch_core_session_raw_read(switch_core_session_t *session)
@@ -1546,10 +1546,28 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_db_thread(switch_thread_t *threa
 
 static void *SWITCH_THREAD_FUNC switch_user_sql_thread(switch_thread_t *thread, void *obj);
 
+#define SQL_QUEUE_MAX_STMTS 128
+
+typedef struct sql_queue_item_s {
+	char *sql;
+	char **params;
+	int argc;
+	struct sql_queue_item_s *next;
+} sql_queue_item_t;
+
+/* Producers push onto a lock-free LIFO inbox; the consumer detaches the whole inbox
+   in one swap and splices it onto its FIFO list in arrival order. */
+typedef struct sql_queue_s {
+	volatile void *inbox;
+	sql_queue_item_t *head;
+	sql_queue_item_t *tail;
+	switch_atomic_t depth;
+} sql_queue_t;
+
 struct switch_sql_queue_manager {
 	const char *name;
 	switch_cache_db_handle_t *event_db;
-	switch_queue_t **sql_queue;
+	sql_queue_t *sql_queue;
 	uint32_t *pre_written;
 	uint32_t *written;
 	uint32_t numq;
@@ -1570,8 +1588,226 @@ struct switch_sql_queue_manager {
 	uint32_t confirm;
 	uint8_t paused;
 	int skip_wait;
+	switch_hash_t *stmt_hash;
+	uint32_t stmt_count;
+	switch_sql_queue_manager_stats_t stats;
 };
 
+static void sql_queue_push(sql_queue_t *q, sql_queue_item_t *item)
+{
+	void *head;
+
+	switch_atomic_inc(&q->depth);
+
+	do {
+		head = (void *) q->inbox;
+		item->next = (sql_queue_item_t *) head;
+	} while (switch_atomic_casptr(&q->inbox, item, head) != head);
+}
+
+/* consumer side, call with qm->mutex held */
+static sql_queue_item_t *sql_queue_pop(sql_queue_t *q)
+{
+	sql_queue_item_t *item;
+
+	if (!q->head) {
+		sql_queue_item_t *list, *rev = NULL, *next;
+		void *head;
+
+		do {
+			head = (void *) q->inbox;
+		} while (head && switch_atomic_casptr(&q->inbox, NULL, head) != head);
+
+		if (!head) {
+			return NULL;
+		}
+
+		for (list = (sql_queue_item_t *) head; list; list = next) {
+			next = list->next;
+			list->next = rev;
+			rev = list;
+		}
+
+		q->head = rev;
+		q->tail = (sql_queue_item_t *) head;
+	}
+
+	item = q->head;
+	if (!(q->head = item->next)) {
+		q->tail = NULL;
+	}
+	item->next = NULL;
+
+	switch_atomic_dec(&q->depth);
+
+	return item;
+}
+
+static void sql_queue_item_free(sql_queue_item_t **itemp)
+{
+	sql_queue_item_t *item = *itemp;
+
+	if (item) {
+		/* parameterized items carry their strings in the same allocation */
+		if (!item->params) {
+			switch_safe_free(item->sql);
+		}
+		free(item);
+		*itemp = NULL;
+	}
+}
+
+static char *sql_queue_item_render(sql_queue_item_t *item)
+{
+	switch_stream_handle_t stream = { 0 };
+	const char *p, *s;
+	int i = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	for (s = p = item->sql; *p; p++) {
+		if (*p == '?') {
+			stream.raw_write_function(&stream, (uint8_t *) s, p - s);
+			if (i < item->argc && item->params[i]) {
+				stream.write_function(&stream, "'%q'", item->params[i]);
+			} else {
+				stream.write_function(&stream, "NULL");
+			}
+			i++;
+			s = p + 1;
+		}
+	}
+
+	stream.raw_write_function(&stream, (uint8_t *) s, p - s);
+
+	return (char *) stream.data;
+}
+
+static switch_core_db_stmt_t *qm_get_stmt(switch_sql_queue_manager_t *qm, switch_cache_db_handle_t *dbh, const char *sql, switch_bool_t *cached)
+{
+	switch_core_db_stmt_t *stmt = NULL;
+	switch_core_db_t *db = dbh->native_handle.core_db_dbh->handle;
+
+	*cached = SWITCH_FALSE;
+
+	if (dbh == qm->event_db && qm->stmt_hash && (stmt = switch_core_hash_find(qm->stmt_hash, sql))) {
+		switch_mutex_lock(qm->mutex);
+		qm->stats.prepared_hits++;
+		switch_mutex_unlock(qm->mutex);
+		*cached = SWITCH_TRUE;
+		return stmt;
+	}
+
+	switch_mutex_lock(qm->mutex);
+	qm->stats.prepared_misses++;
+	switch_mutex_unlock(qm->mutex);
+
+	if (switch_core_db_prepare(db, sql, -1, &stmt, NULL) != SWITCH_CORE_DB_OK) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s SQL PREPARE ERR: [%s] %s\n", qm->name, sql, switch_core_db_errmsg(db));
+		return NULL;
+	}
+
+	if (dbh == qm->event_db && qm->stmt_hash && qm->stmt_count < SQL_QUEUE_MAX_STMTS) {
+		switch_core_hash_insert(qm->stmt_hash, sql, stmt);
+		qm->stmt_count++;
+		*cached = SWITCH_TRUE;
+	}
+
+	return stmt;
+}
+
+static void qm_drop_stmt(switch_sql_queue_manager_t *qm, const char *sql, switch_core_db_stmt_t *stmt, switch_bool_t cached)
+{
+	if (cached) {
+		switch_core_hash_delete(qm->stmt_hash, sql);
+		qm->stmt_count--;
+	}
+	switch_core_db_finalize(stmt);
+}
+
+static void qm_flush_stmts(switch_sql_queue_manager_t *qm)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+
+	if (!qm->stmt_hash) return;
+
+	while ((hi = switch_core_hash_first(qm->stmt_hash))) {
+		switch_core_hash_this(hi, &var, NULL, &val);
+		switch_core_db_finalize((switch_core_db_stmt_t *) val);
+		switch_core_hash_delete(qm->stmt_hash, (const char *) var);
+		switch_safe_free(hi);
+	}
+
+	qm->stmt_count = 0;
+}
+
+static switch_status_t qm_exec_prepared(switch_sql_queue_manager_t *qm, switch_cache_db_handle_t *dbh, sql_queue_item_t *item)
+{
+	switch_core_db_stmt_t *stmt;
+	switch_bool_t cached;
+	int i, rc, rc2, tries = 0;
+
+ again:
+
+	if (!(stmt = qm_get_stmt(qm, dbh, item->sql, &cached))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* every placeholder starts out NULL, a NULL param or a short argv leaves it that way */
+	for (i = 0; i < item->argc; i++) {
+		if (item->params[i]) {
+			switch_core_db_bind_text(stmt, i + 1, item->params[i], -1, SWITCH_CORE_DB_STATIC);
+		}
+	}
+
+	rc = switch_core_db_step(stmt);
+	/* reset also reports SCHEMA if the table changed underneath a cached statement */
+	rc2 = switch_core_db_reset(stmt);
+
+	/* the bound text belongs to item, don't leave the cached statement pointing at it */
+	switch_core_db_clear_bindings(stmt);
+
+	if (rc2 == SWITCH_CORE_DB_SCHEMA && tries++ == 0) {
+		qm_drop_stmt(qm, item->sql, stmt, cached);
+		goto again;
+	}
+
+	if (rc != SWITCH_CORE_DB_DONE && rc != SWITCH_CORE_DB_ROW) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s SQL ERR: [%s] %s\n", qm->name, item->sql,
+						  switch_core_db_errmsg(dbh->native_handle.core_db_dbh->handle));
+		qm_drop_stmt(qm, item->sql, stmt, cached);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!cached) {
+		switch_core_db_finalize(stmt);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t qm_exec_item(switch_sql_queue_manager_t *qm, switch_cache_db_handle_t *dbh, sql_queue_item_t *item)
+{
+	switch_status_t status;
+	char *sql;
+
+	if (!item->params) {
+		return switch_cache_db_execute_sql(dbh, item->sql, NULL);
+	}
+
+	if (dbh->type == SCDB_TYPE_CORE_DB) {
+		return qm_exec_prepared(qm, dbh, item);
+	}
+
+	sql = sql_queue_item_render(item);
+	status = switch_cache_db_execute_sql(dbh, sql, NULL);
+	switch_safe_free(sql);
+
+	return status;
+}
+
 static int qm_wake(switch_sql_queue_manager_t *qm)
 {
 	switch_status_t status;
@@ -1606,7 +1842,7 @@ static uint32_t qm_ttl(switch_sql_queue_manager_t *qm)
 	uint32_t i;
 
 	for (i = 0; i < qm->numq; i++) {
-		ttl += switch_queue_size(qm->sql_queue[i]);
+		ttl += switch_atomic_read(&qm->sql_queue[i].depth);
 	}
 
 	return ttl;
@@ -1743,17 +1979,15 @@ SWITCH_DECLARE(void) switch_sql_queue_manager_execute_sql_event_callback_err(swi
 
 static void do_flush(switch_sql_queue_manager_t *qm, int i, switch_cache_db_handle_t *dbh)
 {
-	void *pop = NULL;
-	switch_queue_t *q = qm->sql_queue[i];
+	sql_queue_item_t *pop = NULL;
+	sql_queue_t *q = &qm->sql_queue[i];
 
 	switch_mutex_lock(qm->mutex);
-	while (switch_queue_trypop(q, &pop) == SWITCH_STATUS_SUCCESS) {
-		if (pop) {
-			if (dbh) {
-				switch_cache_db_execute_sql(dbh, (char *) pop, NULL);
-			}
-			switch_safe_free(pop);
+	while ((pop = sql_queue_pop(q))) {
+		if (dbh) {
+			qm_exec_item(qm, dbh, pop);
 		}
+		sql_queue_item_free(&pop);
 	}
 	switch_mutex_unlock(qm->mutex);
 
@@ -1790,28 +2024,31 @@ SWITCH_DECLARE(int) switch_sql_queue_manager_size(switch_sql_queue_manager_t *qm
 {
 	int size = 0;
 
-	switch_mutex_lock(qm->mutex);
 	if (index < qm->numq) {
-		size = switch_queue_size(qm->sql_queue[index]);
+		size = switch_atomic_read(&qm->sql_queue[index].depth);
 	}
-	switch_mutex_unlock(qm->mutex);
 
 	return size;
 }
 
+SWITCH_DECLARE(void) switch_sql_queue_manager_stats(switch_sql_queue_manager_t *qm, switch_sql_queue_manager_stats_t *stats)
+{
+	switch_mutex_lock(qm->mutex);
+	*stats = qm->stats;
+	switch_mutex_unlock(qm->mutex);
+
+	stats->depth = qm_ttl(qm);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_stop(switch_sql_queue_manager_t *qm)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
-	uint32_t i, sanity = 100;
+	uint32_t sanity = 100;
 
 	if (qm->thread_running == 1) {
 		qm->thread_running = -1;
 
 		while(--sanity && qm->thread_running == -1) {
-			for(i = 0; i < qm->numq; i++) {
-				switch_queue_push(qm->sql_queue[i], NULL);
-				switch_queue_interrupt_all(qm->sql_queue[i]);
-			}
 			qm_wake(qm);
 
 			if (qm->thread_running == -1) {
@@ -1881,18 +2118,103 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_destroy(switch_sql_queu
 		do_flush(qm, i, NULL);
 	}
 
+	if (qm->stmt_hash) {
+		switch_core_hash_destroy(&qm->stmt_hash);
+	}
+
 	pool = qm->pool;
 	switch_core_destroy_memory_pool(&pool);
 
 	return status;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup)
+static void qm_push_item(switch_sql_queue_manager_t *qm, sql_queue_item_t *item, uint32_t pos)
 {
-	char *sqlptr = NULL;
-	switch_status_t status;
 	int x = 0;
 
+	if (pos > qm->numq - 1) {
+		pos = 0;
+	}
+
+	while (switch_atomic_read(&qm->sql_queue[pos].depth) >= SWITCH_SQL_QUEUE_LEN) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "Delay %d sending sql\n", x);
+		qm_wake(qm);
+		if (x++) {
+			switch_yield(1000000 * x);
+		} else {
+			switch_cond_next();
+		}
+	}
+
+	sql_queue_push(&qm->sql_queue[pos], item);
+}
+
+static sql_queue_item_t *sql_queue_item_create(const char *sql, int argc, const char * const *argv)
+{
+	sql_queue_item_t *item;
+	switch_size_t len;
+	char *p;
+	int i;
+
+	if (argc < 0) argc = 0;
+
+	/* one allocation for the item, the parameter vector, the template and the parameter copies */
+	len = sizeof(*item) + sizeof(char *) * (argc + 1) + strlen(sql) + 1;
+	for (i = 0; i < argc; i++) {
+		if (argv[i]) len += strlen(argv[i]) + 1;
+	}
+
+	switch_zmalloc(item, len);
+	item->argc = argc;
+	item->params = (char **) (item + 1);
+	p = (char *) (item->params + argc + 1);
+
+	for (i = 0; i < argc; i++) {
+		if (argv[i]) {
+			len = strlen(argv[i]) + 1;
+			memcpy(p, argv[i], len);
+			item->params[i] = p;
+			p += len;
+		}
+	}
+
+	item->sql = p;
+	strcpy(p, sql);
+
+	return item;
+}
+
+static void qm_push_params_item(switch_sql_queue_manager_t *qm, sql_queue_item_t *item, uint32_t pos)
+{
+	if (sql_manager.paused || qm->thread_running != 1) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "DROP [%s]\n", item->sql);
+		sql_queue_item_free(&item);
+		qm_wake(qm);
+		return;
+	}
+
+	qm_push_item(qm, item, pos);
+	qm_wake(qm);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_params(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos,
+																	 int argc, const char * const *argv)
+{
+	if (sql_manager.paused || qm->thread_running != 1) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "DROP [%s]\n", sql);
+		qm_wake(qm);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	qm_push_params_item(qm, sql_queue_item_create(sql, argc, argv), pos);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup)
+{
+	sql_queue_item_t *item;
+
 	if (sql_manager.paused || qm->thread_running != 1) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "DROP [%s]\n", sql);
 		if (!dup) free((char *)sql);
@@ -1905,24 +2227,10 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_m
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (pos > qm->numq - 1) {
-		pos = 0;
-	}
-
-	sqlptr = dup ? strdup(sql) : (char *)sql;
-
-	do {
-		switch_mutex_lock(qm->mutex);
-		status = switch_queue_trypush(qm->sql_queue[pos], sqlptr);
-		switch_mutex_unlock(qm->mutex);
-		if (status != SWITCH_STATUS_SUCCESS) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "Delay %d sending sql\n", x);
-			if (x++) {
-				switch_yield(1000000 * x);
-			}
-		}
-	} while(status != SWITCH_STATUS_SUCCESS);
+	switch_zmalloc(item, sizeof(*item));
+	item->sql = dup ? strdup(sql) : (char *)sql;
 
+	qm_push_item(qm, item, pos);
 	qm_wake(qm);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -1953,6 +2261,7 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_confirm(switch_sql
 
 	int size, x = 0, sanity = 0;
 	uint32_t written, want;
+	sql_queue_item_t *item;
 
 	if (sql_manager.paused) {
 		if (!dup) free((char *)sql);
@@ -1969,9 +2278,12 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_confirm(switch_sql
 		pos = 0;
 	}
 
+	switch_zmalloc(item, sizeof(*item));
+	item->sql = dup ? strdup(sql) : (char *)sql;
+
 	switch_mutex_lock(qm->mutex);
 	qm->confirm++;
-	switch_queue_push(qm->sql_queue[pos], dup ? strdup(sql) : (char *)sql);
+	sql_queue_push(&qm->sql_queue[pos], item);
 	written = qm->pre_written[pos];
 	size = switch_sql_queue_manager_size(qm, pos);
 	want = written + size;
@@ -2031,13 +2343,11 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_init_name(const char *n
 	switch_mutex_init(&qm->mutex, SWITCH_MUTEX_NESTED, qm->pool);
 	switch_thread_cond_create(&qm->cond, qm->pool);
 
-	qm->sql_queue = switch_core_alloc(qm->pool, sizeof(switch_queue_t *) * numq);
+	qm->sql_queue = switch_core_alloc(qm->pool, sizeof(sql_queue_t) * numq);
 	qm->written = switch_core_alloc(qm->pool, sizeof(uint32_t) * numq);
 	qm->pre_written = switch_core_alloc(qm->pool, sizeof(uint32_t) * numq);
 
-	for (i = 0; i < qm->numq; i++) {
-		switch_queue_create(&qm->sql_queue[i], SWITCH_SQL_QUEUE_LEN, qm->pool);
-	}
+	switch_core_hash_init(&qm->stmt_hash);
 
 	if (pre_trans_execute) {
 		qm->pre_trans_execute = switch_core_strdup(qm->pool, pre_trans_execute);
@@ -2061,11 +2371,11 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_init_name(const char *n
 static uint32_t do_trans(switch_sql_queue_manager_t *qm)
 {
 	char *errmsg = NULL;
-	void *pop;
+	sql_queue_item_t *pop;
 	switch_status_t status;
 	uint32_t ttl = 0;
 	uint32_t i;
-	switch_status_t res;
+	switch_time_t start = switch_time_now(), took;
 
 	if (!zstr(qm->pre_trans_execute)) {
 		switch_cache_db_execute_sql_real(qm->event_db, qm->pre_trans_execute, &errmsg);
@@ -2127,22 +2437,26 @@ static uint32_t do_trans(switch_sql_queue_manager_t *qm)
 
 		for (i = 0; (qm->max_trans == 0 || ttl <= qm->max_trans) && (i < qm->numq); i++) {
 			switch_mutex_lock(qm->mutex);
-			res = switch_queue_trypop(qm->sql_queue[i], &pop);
-			(void)res;
+			pop = sql_queue_pop(&qm->sql_queue[i]);
 			switch_mutex_unlock(qm->mutex);
 			if (pop) break;
 		}
 
 		if (pop) {
-			if ((status = switch_cache_db_execute_sql(qm->event_db, (char *) pop, NULL)) == SWITCH_STATUS_SUCCESS) {
+			if ((status = qm_exec_item(qm, qm->event_db, pop)) == SWITCH_STATUS_SUCCESS) {
 				switch_mutex_lock(qm->mutex);
 				qm->pre_written[i]++;
 				switch_mutex_unlock(qm->mutex);
 				ttl++;
 			}
 
-			switch_safe_free(pop);
-			if (status != SWITCH_STATUS_SUCCESS) break;
+			sql_queue_item_free(&pop);
+			if (status != SWITCH_STATUS_SUCCESS) {
+				switch_mutex_lock(qm->mutex);
+				qm->stats.errors++;
+				switch_mutex_unlock(qm->mutex);
+				break;
+			}
 		} else {
 			break;
 		}
@@ -2192,11 +2506,23 @@ static uint32_t do_trans(switch_sql_queue_manager_t *qm)
 		}
 	}
 
+	took = switch_time_now() - start;
+
 	switch_mutex_lock(qm->mutex);
 	for (i = 0; i < qm->numq; i++) {
 		qm->written[i] = qm->pre_written[i];
 	}
 
+	if (ttl) {
+		qm->stats.batches++;
+		qm->stats.statements += ttl;
+		qm->stats.last_batch = ttl;
+		if (ttl > qm->stats.max_batch) qm->stats.max_batch = ttl;
+		qm->stats.last_flush_us = took;
+		if (took > qm->stats.max_flush_us) qm->stats.max_flush_us = took;
+		qm->stats.avg_flush_us = qm->stats.avg_flush_us ? (qm->stats.avg_flush_us * 7 + took) / 8 : took;
+	}
+
 	switch_mutex_unlock(qm->mutex);
 
 	return ttl;
@@ -2267,18 +2593,19 @@ static void *SWITCH_THREAD_FUNC switch_user_sql_thread(switch_thread_t *thread,
 		} while(written == qm->max_trans);
 
 		if (switch_test_flag((&runtime), SCF_DEBUG_SQL)) {
-			char line[128] = "";
+			char line[256] = "";
 			switch_size_t l;
 
 			switch_snprintf(line, sizeof(line), "%s RUN QUEUE [", qm->name);
 
 			for (i = 0; i < qm->numq; i++) {
 				l = strlen(line);
-				switch_snprintf(line + l, sizeof(line) - l, "%d%s", switch_queue_size(qm->sql_queue[i]), i == qm->numq - 1 ? "" : "|");
+				switch_snprintf(line + l, sizeof(line) - l, "%d%s", switch_atomic_read(&qm->sql_queue[i].depth), i == qm->numq - 1 ? "" : "|");
 			}
 
 			l = strlen(line);
-			switch_snprintf(line + l, sizeof(line) - l, "]--[%d]\n", iterations);
+			switch_snprintf(line + l, sizeof(line) - l, "]--[%d] batch %u/%u flush %" SWITCH_TIME_T_FMT "us avg %" SWITCH_TIME_T_FMT "us\n",
+							iterations, qm->stats.last_batch, qm->stats.max_batch, qm->stats.last_flush_us, qm->stats.avg_flush_us);
 
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "%s", line);
 
@@ -2312,6 +2639,8 @@ static void *SWITCH_THREAD_FUNC switch_user_sql_thread(switch_thread_t *thread,
 		do_flush(qm, i, qm->event_db);
 	}
 
+	qm_flush_stmts(qm);
+
 	switch_cache_db_release_db_handle(&qm->event_db);
 
 	qm->thread_running = 0;
@@ -2366,13 +2695,26 @@ static char *parse_presence_data_cols(switch_event_t *event)
 }
 
 
+static switch_bool_t memdb_channel_event_id(switch_event_types_t id);
+static switch_bool_t memdb_sql_skip_channels(void);
+
 #define MAX_SQL 5
 #define new_sql()   switch_assert(sql_idx+1 < MAX_SQL); if (exists) sql[sql_idx++]
 #define new_sql_a() switch_assert(sql_idx+1 < MAX_SQL); sql[sql_idx++]
 
+/* fixed statements go out as prepared templates, only ones with presence-data-cols still get printed.
+   Both kinds share one slot list so they are queued in the order the handler made them. */
+#define new_sql_params(_sql, ...) do {									\
+		const char *_argv[] = { __VA_ARGS__ };							\
+		switch_assert(sql_idx+1 < MAX_SQL);								\
+		if (exists) sql_params[sql_idx++] = sql_queue_item_create(_sql, sizeof(_argv) / sizeof(_argv[0]), _argv); \
+	} while (0)
+
 static void core_event_handler(switch_event_t *event)
 {
 	char *sql[MAX_SQL] = { 0 };
+	sql_queue_item_t *sql_params[MAX_SQL] = { 0 };
+	char epoch[32] = "";
 	int sql_idx = 0;
 	char *extra_cols;
 	int exists = 1;
@@ -2380,6 +2722,10 @@ static void core_event_handler(switch_event_t *event)
 
 	switch_assert(event);
 
+	if (memdb_channel_event_id(event->event_id) && memdb_sql_skip_channels()) {
+		return;
+	}
+
 	switch (event->event_id) {
 	case SWITCH_EVENT_CHANNEL_UUID:
 	case SWITCH_EVENT_CHANNEL_CREATE:
@@ -2451,75 +2797,66 @@ static void core_event_handler(switch_event_t *event)
 			const char *uuid = switch_event_get_header(event, "unique-id");
 
 			if (uuid) {
-				new_sql() = switch_mprintf("delete from channels where uuid='%q'",
-										   uuid);
-
-				new_sql() = switch_mprintf("delete from calls where (caller_uuid='%q' or callee_uuid='%q')",
-										   uuid, uuid);
-
+				new_sql_params("delete from channels where uuid=?", uuid);
+				new_sql_params("delete from calls where (caller_uuid=? or callee_uuid=?)", uuid, uuid);
 			}
 		}
 		break;
 	case SWITCH_EVENT_CHANNEL_UUID:
 		{
-			new_sql() = switch_mprintf("update channels set uuid='%q' where uuid='%q'",
-									   switch_event_get_header_nil(event, "unique-id"),
-									   switch_event_get_header_nil(event, "old-unique-id")
-									   );
+			new_sql_params("update channels set uuid=? where uuid=?",
+						   switch_event_get_header_nil(event, "unique-id"),
+						   switch_event_get_header_nil(event, "old-unique-id"));
 
-			new_sql() = switch_mprintf("update channels set call_uuid='%q' where call_uuid='%q'",
-									   switch_event_get_header_nil(event, "unique-id"),
-									   switch_event_get_header_nil(event, "old-unique-id")
-									   );
+			new_sql_params("update channels set call_uuid=? where call_uuid=?",
+						   switch_event_get_header_nil(event, "unique-id"),
+						   switch_event_get_header_nil(event, "old-unique-id"));
 			break;
 		}
 	case SWITCH_EVENT_CHANNEL_CREATE:
-		new_sql() = switch_mprintf("insert into channels (uuid,direction,created,created_epoch, name,state,callstate,dialplan,context,hostname,initial_cid_name,initial_cid_num,initial_ip_addr,initial_dest,initial_dialplan,initial_context) "
-								   "values('%q','%q','%q','%ld','%q','%q','%q','%q','%q','%q','%q','%q','%q','%q','%q','%q')",
-								   switch_event_get_header_nil(event, "unique-id"),
-								   switch_event_get_header_nil(event, "call-direction"),
-								   switch_event_get_header_nil(event, "event-date-local"),
-								   (long) switch_epoch_time_now(NULL),
-								   switch_event_get_header_nil(event, "channel-name"),
-								   switch_event_get_header_nil(event, "channel-state"),
-								   switch_event_get_header_nil(event, "channel-call-state"),
-								   switch_event_get_header_nil(event, "caller-dialplan"),
-								   switch_event_get_header_nil(event, "caller-context"), switch_core_get_switchname(),
-								   switch_event_get_header_nil(event, "caller-caller-id-name"),
-								   switch_event_get_header_nil(event, "caller-caller-id-number"),
-								   switch_event_get_header_nil(event, "caller-network-addr"),
-								   switch_event_get_header_nil(event, "caller-destination-number"),
-								   switch_event_get_header_nil(event, "caller-dialplan"),
-								   switch_event_get_header_nil(event, "caller-context")
-								   );
+		switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+		new_sql_params("insert into channels (uuid,direction,created,created_epoch, name,state,callstate,dialplan,context,hostname,initial_cid_name,initial_cid_num,initial_ip_addr,initial_dest,initial_dialplan,initial_context) "
+					   "values(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)",
+					   switch_event_get_header_nil(event, "unique-id"),
+					   switch_event_get_header_nil(event, "call-direction"),
+					   switch_event_get_header_nil(event, "event-date-local"),
+					   epoch,
+					   switch_event_get_header_nil(event, "channel-name"),
+					   switch_event_get_header_nil(event, "channel-state"),
+					   switch_event_get_header_nil(event, "channel-call-state"),
+					   switch_event_get_header_nil(event, "caller-dialplan"),
+					   switch_event_get_header_nil(event, "caller-context"), switch_core_get_switchname(),
+					   switch_event_get_header_nil(event, "caller-caller-id-name"),
+					   switch_event_get_header_nil(event, "caller-caller-id-number"),
+					   switch_event_get_header_nil(event, "caller-network-addr"),
+					   switch_event_get_header_nil(event, "caller-destination-number"),
+					   switch_event_get_header_nil(event, "caller-dialplan"),
+					   switch_event_get_header_nil(event, "caller-context"));
 		break;
 	case SWITCH_EVENT_CHANNEL_ANSWER:
 	case SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA:
 	case SWITCH_EVENT_CODEC:
-		new_sql() =
-			switch_mprintf
-			("update channels set read_codec='%q',read_rate='%q',read_bit_rate='%q',write_codec='%q',write_rate='%q',write_bit_rate='%q' where uuid='%q'",
-			 switch_event_get_header_nil(event, "channel-read-codec-name"),
-			 switch_event_get_header_nil(event, "channel-read-codec-rate"),
-			 switch_event_get_header_nil(event, "channel-read-codec-bit-rate"),
-			 switch_event_get_header_nil(event, "channel-write-codec-name"),
-			 switch_event_get_header_nil(event, "channel-write-codec-rate"),
-			 switch_event_get_header_nil(event, "channel-write-codec-bit-rate"),
-			 switch_event_get_header_nil(event, "unique-id"));
+		new_sql_params("update channels set read_codec=?,read_rate=?,read_bit_rate=?,write_codec=?,write_rate=?,write_bit_rate=? where uuid=?",
+					   switch_event_get_header_nil(event, "channel-read-codec-name"),
+					   switch_event_get_header_nil(event, "channel-read-codec-rate"),
+					   switch_event_get_header_nil(event, "channel-read-codec-bit-rate"),
+					   switch_event_get_header_nil(event, "channel-write-codec-name"),
+					   switch_event_get_header_nil(event, "channel-write-codec-rate"),
+					   switch_event_get_header_nil(event, "channel-write-codec-bit-rate"),
+					   switch_event_get_header_nil(event, "unique-id"));
 		break;
 	case SWITCH_EVENT_CHANNEL_HOLD:
 	case SWITCH_EVENT_CHANNEL_UNHOLD:
 	case SWITCH_EVENT_CHANNEL_EXECUTE: {
 
-		new_sql() = switch_mprintf("update channels set application='%q',application_data='%q',"
-								   "presence_id='%q',presence_data='%q',accountcode='%q' where uuid='%q'",
-								   switch_event_get_header_nil(event, "application"),
-								   switch_event_get_header_nil(event, "application-data"),
-								   switch_event_get_header_nil(event, "channel-presence-id"),
-								   switch_event_get_header_nil(event, "channel-presence-data"),
-								   switch_event_get_header_nil(event, "variable_accountcode"),
-								   switch_event_get_header_nil(event, "unique-id")
-								   );
+		new_sql_params("update channels set application=?,application_data=?,"
+					   "presence_id=?,presence_data=?,accountcode=? where uuid=?",
+					   switch_event_get_header_nil(event, "application"),
+					   switch_event_get_header_nil(event, "application-data"),
+					   switch_event_get_header_nil(event, "channel-presence-id"),
+					   switch_event_get_header_nil(event, "channel-presence-data"),
+					   switch_event_get_header_nil(event, "variable_accountcode"),
+					   switch_event_get_header_nil(event, "unique-id"));
 
 	}
 		break;
@@ -2537,13 +2874,12 @@ static void core_event_handler(switch_event_t *event)
 										   switch_event_get_header_nil(event, "unique-id"));
 				free(extra_cols);
 			} else {
-				new_sql() = switch_mprintf("update channels set "
-										   "presence_id='%q',presence_data='%q',accountcode='%q',call_uuid='%q' where uuid='%q'",
-										   switch_event_get_header_nil(event, "channel-presence-id"),
-										   switch_event_get_header_nil(event, "channel-presence-data"),
-										   switch_event_get_header_nil(event, "variable_accountcode"),
-										   switch_event_get_header_nil(event, "channel-call-uuid"),
-										   switch_event_get_header_nil(event, "unique-id"));
+				new_sql_params("update channels set presence_id=?,presence_data=?,accountcode=?,call_uuid=? where uuid=?",
+							   switch_event_get_header_nil(event, "channel-presence-id"),
+							   switch_event_get_header_nil(event, "channel-presence-data"),
+							   switch_event_get_header_nil(event, "variable_accountcode"),
+							   switch_event_get_header_nil(event, "channel-call-uuid"),
+							   switch_event_get_header_nil(event, "unique-id"));
 			}
 
 		}
@@ -2551,17 +2887,16 @@ static void core_event_handler(switch_event_t *event)
 		break;
 	case SWITCH_EVENT_CALL_UPDATE:
 		{
-			new_sql() = switch_mprintf("update channels set callee_name='%q',callee_num='%q',sent_callee_name='%q',sent_callee_num='%q',callee_direction='%q',"
-									   "cid_name='%q',cid_num='%q' where uuid='%q'",
-									   switch_event_get_header_nil(event, "caller-callee-id-name"),
-									   switch_event_get_header_nil(event, "caller-callee-id-number"),
-									   switch_event_get_header_nil(event, "sent-callee-id-name"),
-									   switch_event_get_header_nil(event, "sent-callee-id-number"),
-									   switch_event_get_header_nil(event, "direction"),
-									   switch_event_get_header_nil(event, "caller-caller-id-name"),
-									   switch_event_get_header_nil(event, "caller-caller-id-number"),
-									   switch_event_get_header_nil(event, "unique-id")
-									   );
+			new_sql_params("update channels set callee_name=?,callee_num=?,sent_callee_name=?,sent_callee_num=?,callee_direction=?,"
+						   "cid_name=?,cid_num=? where uuid=?",
+						   switch_event_get_header_nil(event, "caller-callee-id-name"),
+						   switch_event_get_header_nil(event, "caller-callee-id-number"),
+						   switch_event_get_header_nil(event, "sent-callee-id-name"),
+						   switch_event_get_header_nil(event, "sent-callee-id-number"),
+						   switch_event_get_header_nil(event, "direction"),
+						   switch_event_get_header_nil(event, "caller-caller-id-name"),
+						   switch_event_get_header_nil(event, "caller-caller-id-number"),
+						   switch_event_get_header_nil(event, "unique-id"));
 		}
 		break;
 	case SWITCH_EVENT_CHANNEL_CALLSTATE:
@@ -2581,9 +2916,9 @@ static void core_event_handler(switch_event_t *event)
 											   switch_event_get_header_nil(event, "unique-id"));
 					free(extra_cols);
 				} else {
-					new_sql() = switch_mprintf("update channels set callstate='%q' where uuid='%q'",
-											   switch_event_get_header_nil(event, "channel-call-state"),
-											   switch_event_get_header_nil(event, "unique-id"));
+					new_sql_params("update channels set callstate=? where uuid=?",
+								   switch_event_get_header_nil(event, "channel-call-state"),
+								   switch_event_get_header_nil(event, "unique-id"));
 				}
 			}
 
@@ -2623,9 +2958,9 @@ static void core_event_handler(switch_event_t *event)
 					free(extra_cols);
 
 				} else {
-					new_sql() = switch_mprintf("update channels set state='%q' where uuid='%q'",
-											   switch_event_get_header_nil(event, "channel-state"),
-											   switch_event_get_header_nil(event, "unique-id"));
+					new_sql_params("update channels set state=? where uuid=?",
+								   switch_event_get_header_nil(event, "channel-state"),
+								   switch_event_get_header_nil(event, "unique-id"));
 				}
 				break;
 			case CS_ROUTING:
@@ -2652,31 +2987,31 @@ static void core_event_handler(switch_event_t *event)
 											   switch_event_get_header_nil(event, "unique-id"));
 					free(extra_cols);
 				} else {
-					new_sql() = switch_mprintf("update channels set state='%q',cid_name='%q',cid_num='%q',callee_name='%q',callee_num='%q',"
-											   "sent_callee_name='%q',sent_callee_num='%q',"
-											   "ip_addr='%q',dest='%q',dialplan='%q',context='%q',presence_id='%q',presence_data='%q',accountcode='%q' "
-											   "where uuid='%q'",
-											   switch_event_get_header_nil(event, "channel-state"),
-											   switch_event_get_header_nil(event, "caller-caller-id-name"),
-											   switch_event_get_header_nil(event, "caller-caller-id-number"),
-											   switch_event_get_header_nil(event, "caller-callee-id-name"),
-											   switch_event_get_header_nil(event, "caller-callee-id-number"),
-											   switch_event_get_header_nil(event, "sent-callee-id-name"),
-											   switch_event_get_header_nil(event, "sent-callee-id-number"),
-											   switch_event_get_header_nil(event, "caller-network-addr"),
-											   switch_event_get_header_nil(event, "caller-destination-number"),
-											   switch_event_get_header_nil(event, "caller-dialplan"),
-											   switch_event_get_header_nil(event, "caller-context"),
-											   switch_event_get_header_nil(event, "channel-presence-id"),
-											   switch_event_get_header_nil(event, "channel-presence-data"),
-											   switch_event_get_header_nil(event, "variable_accountcode"),
-											   switch_event_get_header_nil(event, "unique-id"));
+					new_sql_params("update channels set state=?,cid_name=?,cid_num=?,callee_name=?,callee_num=?,"
+								   "sent_callee_name=?,sent_callee_num=?,"
+								   "ip_addr=?,dest=?,dialplan=?,context=?,presence_id=?,presence_data=?,accountcode=? "
+								   "where uuid=?",
+								   switch_event_get_header_nil(event, "channel-state"),
+								   switch_event_get_header_nil(event, "caller-caller-id-name"),
+								   switch_event_get_header_nil(event, "caller-caller-id-number"),
+								   switch_event_get_header_nil(event, "caller-callee-id-name"),
+								   switch_event_get_header_nil(event, "caller-callee-id-number"),
+								   switch_event_get_header_nil(event, "sent-callee-id-name"),
+								   switch_event_get_header_nil(event, "sent-callee-id-number"),
+								   switch_event_get_header_nil(event, "caller-network-addr"),
+								   switch_event_get_header_nil(event, "caller-destination-number"),
+								   switch_event_get_header_nil(event, "caller-dialplan"),
+								   switch_event_get_header_nil(event, "caller-context"),
+								   switch_event_get_header_nil(event, "channel-presence-id"),
+								   switch_event_get_header_nil(event, "channel-presence-data"),
+								   switch_event_get_header_nil(event, "variable_accountcode"),
+								   switch_event_get_header_nil(event, "unique-id"));
 				}
 				break;
 			default:
-				new_sql() = switch_mprintf("update channels set state='%q' where uuid='%q'",
-										   switch_event_get_header_nil(event, "channel-state"),
-										   switch_event_get_header_nil(event, "unique-id"));
+				new_sql_params("update channels set state=? where uuid=?",
+							   switch_event_get_header_nil(event, "channel-state"),
+							   switch_event_get_header_nil(event, "unique-id"));
 				break;
 			}
 
@@ -2702,20 +3037,19 @@ static void core_event_handler(switch_event_t *event)
 				switch_safe_free(extra_cols);
 			}
 
-			new_sql() = switch_mprintf("update channels set call_uuid='%q' where uuid='%q' or uuid='%q'",
-									   switch_event_get_header_nil(event, "channel-call-uuid"), a_uuid, b_uuid);
+			new_sql_params("update channels set call_uuid=? where uuid=? or uuid=?",
+						   switch_event_get_header_nil(event, "channel-call-uuid"), a_uuid, b_uuid);
 
-
-			new_sql() = switch_mprintf("insert into calls (call_uuid,call_created,call_created_epoch,"
-									   "caller_uuid,callee_uuid,hostname) "
-									   "values ('%q','%q','%ld','%q','%q','%q')",
-									   switch_event_get_header_nil(event, "channel-call-uuid"),
-									   switch_event_get_header_nil(event, "event-date-local"),
-									   (long) switch_epoch_time_now(NULL),
-									   a_uuid,
-									   b_uuid,
-									   switch_core_get_switchname()
-									   );
+			switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+			new_sql_params("insert into calls (call_uuid,call_created,call_created_epoch,"
+						   "caller_uuid,callee_uuid,hostname) "
+						   "values (?,?,?,?,?,?)",
+						   switch_event_get_header_nil(event, "channel-call-uuid"),
+						   switch_event_get_header_nil(event, "event-date-local"),
+						   epoch,
+						   a_uuid,
+						   b_uuid,
+						   switch_core_get_switchname());
 		}
 		break;
 	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
@@ -2728,11 +3062,10 @@ static void core_event_handler(switch_event_t *event)
 				switch_safe_free(extra_cols);
 			}
 
-			new_sql() = switch_mprintf("update channels set call_uuid=uuid where call_uuid='%q'",
-									   switch_event_get_header_nil(event, "channel-call-uuid"));
+			new_sql_params("update channels set call_uuid=uuid where call_uuid=?",
+						   switch_event_get_header_nil(event, "channel-call-uuid"));
 
-			new_sql() = switch_mprintf("delete from calls where (caller_uuid='%q' or callee_uuid='%q')",
-									   cuuid, cuuid);
+			new_sql_params("delete from calls where (caller_uuid=? or callee_uuid=?)", cuuid, cuuid);
 			break;
 		}
 	case SWITCH_EVENT_SHUTDOWN:
@@ -2815,12 +3148,16 @@ static void core_event_handler(switch_event_t *event)
 
 
 		for (i = 0; i < sql_idx; i++) {
-			if (switch_stristr("update channels", sql[i]) || switch_stristr("delete from channels", sql[i])) {
-				switch_sql_queue_manager_push(sql_manager.qm, sql[i], 1, SWITCH_FALSE);
+			const char *stmt = sql_params[i] ? sql_params[i]->sql : sql[i];
+			uint32_t pos = (switch_stristr("update channels", stmt) || switch_stristr("delete from channels", stmt)) ? 1 : 0;
+
+			if (sql_params[i]) {
+				qm_push_params_item(sql_manager.qm, sql_params[i], pos);
 			} else {
-				switch_sql_queue_manager_push(sql_manager.qm, sql[i], 0, SWITCH_FALSE);
+				switch_sql_queue_manager_push(sql_manager.qm, sql[i], pos, SWITCH_FALSE);
 			}
 			sql[i] = NULL;
+			sql_params[i] = NULL;
 		}
 	}
 }
@@ -3447,12 +3784,980 @@ SWITCH_DECLARE(void) switch_core_recovery_track(switch_core_session_t *session)
 
 
 
+/* In-memory core tables.  When core-memory-tables is enabled the channels, calls and registrations
+   tables are kept here instead of (or, with core-memory-tables-sql-mirror, in addition to) the core db. */
+
+typedef enum {
+	MC_UUID,
+	MC_DIRECTION,
+	MC_CREATED,
+	MC_CREATED_EPOCH,
+	MC_NAME,
+	MC_STATE,
+	MC_CID_NAME,
+	MC_CID_NUM,
+	MC_IP_ADDR,
+	MC_DEST,
+	MC_APPLICATION,
+	MC_APPLICATION_DATA,
+	MC_DIALPLAN,
+	MC_CONTEXT,
+	MC_READ_CODEC,
+	MC_READ_RATE,
+	MC_READ_BIT_RATE,
+	MC_WRITE_CODEC,
+	MC_WRITE_RATE,
+	MC_WRITE_BIT_RATE,
+	MC_SECURE,
+	MC_HOSTNAME,
+	MC_PRESENCE_ID,
+	MC_PRESENCE_DATA,
+	MC_ACCOUNTCODE,
+	MC_CALLSTATE,
+	MC_CALLEE_NAME,
+	MC_CALLEE_NUM,
+	MC_CALLEE_DIRECTION,
+	MC_CALL_UUID,
+	MC_SENT_CALLEE_NAME,
+	MC_SENT_CALLEE_NUM,
+	MC_INITIAL_CID_NAME,
+	MC_INITIAL_CID_NUM,
+	MC_INITIAL_IP_ADDR,
+	MC_INITIAL_DEST,
+	MC_INITIAL_DIALPLAN,
+	MC_INITIAL_CONTEXT,
+	MC_MAX
+} memdb_channel_col_t;
+
+static char *memdb_channel_cols[MC_MAX] = {
+	"uuid", "direction", "created", "created_epoch", "name", "state", "cid_name", "cid_num", "ip_addr", "dest",
+	"application", "application_data", "dialplan", "context", "read_codec", "read_rate", "read_bit_rate",
+	"write_codec", "write_rate", "write_bit_rate", "secure", "hostname", "presence_id", "presence_data",
+	"accountcode", "callstate", "callee_name", "callee_num", "callee_direction", "call_uuid",
+	"sent_callee_name", "sent_callee_num", "initial_cid_name", "initial_cid_num", "initial_ip_addr",
+	"initial_dest", "initial_dialplan", "initial_context"
+};
+
+/* the a and b leg columns of the basic_calls view, the detailed_calls view uses uuid through sent_callee_num */
+static memdb_channel_col_t memdb_basic_a_cols[] = {
+	MC_UUID, MC_DIRECTION, MC_CREATED, MC_CREATED_EPOCH, MC_NAME, MC_STATE, MC_CID_NAME, MC_CID_NUM, MC_IP_ADDR, MC_DEST,
+	MC_PRESENCE_ID, MC_PRESENCE_DATA, MC_ACCOUNTCODE, MC_CALLSTATE, MC_CALLEE_NAME, MC_CALLEE_NUM, MC_CALLEE_DIRECTION,
+	MC_CALL_UUID, MC_HOSTNAME, MC_SENT_CALLEE_NAME, MC_SENT_CALLEE_NUM
+};
+
+static memdb_channel_col_t memdb_basic_b_cols[] = {
+	MC_UUID, MC_DIRECTION, MC_CREATED, MC_CREATED_EPOCH, MC_NAME, MC_STATE, MC_CID_NAME, MC_CID_NUM, MC_IP_ADDR, MC_DEST,
+	MC_PRESENCE_ID, MC_PRESENCE_DATA, MC_ACCOUNTCODE, MC_CALLSTATE, MC_CALLEE_NAME, MC_CALLEE_NUM, MC_CALLEE_DIRECTION,
+	MC_SENT_CALLEE_NAME, MC_SENT_CALLEE_NUM
+};
+
+#define MEMDB_DETAILED_COLS (MC_SENT_CALLEE_NUM + 1)
+#define MEMDB_BASIC_A_COLS (sizeof(memdb_basic_a_cols) / sizeof(memdb_basic_a_cols[0]))
+#define MEMDB_BASIC_B_COLS (sizeof(memdb_basic_b_cols) / sizeof(memdb_basic_b_cols[0]))
+#define MEMDB_MAX_ROW (MEMDB_DETAILED_COLS * 2 + 1)
+
+typedef enum {
+	MR_REG_USER,
+	MR_REALM,
+	MR_TOKEN,
+	MR_URL,
+	MR_EXPIRES,
+	MR_NETWORK_IP,
+	MR_NETWORK_PORT,
+	MR_NETWORK_PROTO,
+	MR_HOSTNAME,
+	MR_METADATA,
+	MR_MAX
+} memdb_registration_col_t;
+
+static char *memdb_registration_cols[MR_MAX] = {
+	"reg_user", "realm", "token", "url", "expires", "network_ip", "network_port", "network_proto", "hostname", "metadata"
+};
+
+typedef struct memdb_channel_s {
+	char *col[MC_MAX];
+	struct memdb_call_s *call;
+	struct memdb_channel_s *prev;
+	struct memdb_channel_s *next;
+} memdb_channel_t;
+
+typedef struct memdb_call_s {
+	char *call_uuid;
+	char *call_created_epoch;
+	char *caller_uuid;
+	char *callee_uuid;
+	struct memdb_call_s *prev;
+	struct memdb_call_s *next;
+} memdb_call_t;
+
+typedef struct memdb_registration_s {
+	char *col[MR_MAX];
+	char *user_key;
+	time_t expires;
+	struct memdb_registration_s *user_next;
+	struct memdb_registration_s *prev;
+	struct memdb_registration_s *next;
+} memdb_registration_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_thread_rwlock_t *rwlock;
+	int running;
+	switch_hash_t *channels;
+	memdb_channel_t *channel_head;
+	memdb_channel_t *channel_tail;
+	uint32_t channel_count;
+	/* caller_uuid and callee_uuid -> call */
+	switch_hash_t *calls;
+	memdb_call_t *call_head;
+	memdb_call_t *call_tail;
+	/* "user@realm" -> chain, url -> registration, token -> registration */
+	switch_hash_t *reg_users;
+	switch_hash_t *reg_urls;
+	switch_hash_t *reg_tokens;
+	memdb_registration_t *reg_head;
+	memdb_registration_t *reg_tail;
+	uint32_t reg_count;
+	char *detailed_names[MEMDB_MAX_ROW];
+	char *basic_names[MEMDB_MAX_ROW];
+} memdb;
+
+#define MEMDB_LINK(_head, _tail, _node) do {	\
+		(_node)->prev = (_tail);				\
+		(_node)->next = NULL;					\
+		if (_tail) (_tail)->next = (_node);		\
+		else (_head) = (_node);					\
+		(_tail) = (_node);						\
+	} while(0)
+
+#define MEMDB_UNLINK(_head, _tail, _node) do {			\
+		if ((_node)->prev) (_node)->prev->next = (_node)->next;	\
+		else (_head) = (_node)->next;					\
+		if ((_node)->next) (_node)->next->prev = (_node)->prev;	\
+		else (_tail) = (_node)->prev;					\
+	} while(0)
+
+static void memdb_set(char **slot, const char *val)
+{
+	char *old = *slot;
+
+	*slot = val ? strdup(val) : NULL;
+	switch_safe_free(old);
+}
+
+#define memdb_set_header(_ch, _col, _header) memdb_set(&(_ch)->col[_col], switch_event_get_header_nil(event, _header))
+
+static memdb_channel_t *memdb_channel(const char *uuid)
+{
+	return zstr(uuid) ? NULL : (memdb_channel_t *) switch_core_hash_find(memdb.channels, uuid);
+}
+
+static void memdb_free_call(memdb_call_t *call)
+{
+	memdb_channel_t *ch;
+
+	MEMDB_UNLINK(memdb.call_head, memdb.call_tail, call);
+
+	if (switch_core_hash_find(memdb.calls, call->caller_uuid) == call) {
+		switch_core_hash_delete(memdb.calls, call->caller_uuid);
+	}
+	if (switch_core_hash_find(memdb.calls, call->callee_uuid) == call) {
+		switch_core_hash_delete(memdb.calls, call->callee_uuid);
+	}
+
+	if ((ch = memdb_channel(call->caller_uuid)) && ch->call == call) ch->call = NULL;
+	if ((ch = memdb_channel(call->callee_uuid)) && ch->call == call) ch->call = NULL;
+
+	switch_safe_free(call->call_uuid);
+	switch_safe_free(call->call_created_epoch);
+	switch_safe_free(call->caller_uuid);
+	switch_safe_free(call->callee_uuid);
+	free(call);
+}
+
+static void memdb_del_calls(const char *uuid)
+{
+	memdb_call_t *call;
+
+	while (!zstr(uuid) && (call = switch_core_hash_find(memdb.calls, uuid))) {
+		memdb_free_call(call);
+	}
+}
+
+static void memdb_free_channel(memdb_channel_t *ch)
+{
+	int i;
+
+	MEMDB_UNLINK(memdb.channel_head, memdb.channel_tail, ch);
+	memdb.channel_count--;
+
+	for (i = 0; i < MC_MAX; i++) {
+		switch_safe_free(ch->col[i]);
+	}
+
+	free(ch);
+}
+
+static void memdb_call_uuid_reset(memdb_channel_t *ch, const char *call_uuid)
+{
+	if (ch && !zstr(call_uuid) && ch->col[MC_CALL_UUID] && !strcmp(ch->col[MC_CALL_UUID], call_uuid)) {
+		memdb_set(&ch->col[MC_CALL_UUID], ch->col[MC_UUID]);
+	}
+}
+
+static void memdb_call_uuid_rename(memdb_channel_t *ch, const char *new_uuid, const char *old_uuid)
+{
+	if (ch && ch->col[MC_CALL_UUID] && !strcmp(ch->col[MC_CALL_UUID], old_uuid)) {
+		memdb_set(&ch->col[MC_CALL_UUID], new_uuid);
+	}
+}
+
+static void memdb_channel_event(switch_event_t *event)
+{
+	memdb_channel_t *ch = NULL;
+	const char *uuid = switch_event_get_header(event, "unique-id");
+	int exists = 1;
+
+	switch (event->event_id) {
+	case SWITCH_EVENT_CHANNEL_DESTROY:
+	case SWITCH_EVENT_CODEC:
+		break;
+	default:
+		if (uuid) {
+			exists = switch_ivr_uuid_exists(uuid);
+		}
+		break;
+	}
+
+	if (!exists) {
+		return;
+	}
+
+	switch_thread_rwlock_wrlock(memdb.rwlock);
+
+	switch (event->event_id) {
+	case SWITCH_EVENT_CHANNEL_DESTROY:
+		if ((ch = memdb_channel(uuid))) {
+			memdb_del_calls(uuid);
+			switch_core_hash_delete(memdb.channels, uuid);
+			memdb_free_channel(ch);
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_UUID:
+		{
+			const char *old_uuid = switch_event_get_header_nil(event, "old-unique-id");
+			memdb_call_t *call;
+
+			if (zstr(uuid) || !(ch = memdb_channel(old_uuid))) {
+				break;
+			}
+
+			switch_core_hash_delete(memdb.channels, old_uuid);
+			memdb_set(&ch->col[MC_UUID], uuid);
+			memdb_call_uuid_rename(ch, uuid, old_uuid);
+			switch_core_hash_insert(memdb.channels, uuid, ch);
+
+			if ((call = switch_core_hash_find(memdb.calls, old_uuid))) {
+				switch_core_hash_delete(memdb.calls, old_uuid);
+				if (!strcmp(call->caller_uuid, old_uuid)) {
+					memdb_set(&call->caller_uuid, uuid);
+					memdb_call_uuid_rename(memdb_channel(call->callee_uuid), uuid, old_uuid);
+				} else {
+					memdb_set(&call->callee_uuid, uuid);
+					memdb_call_uuid_rename(memdb_channel(call->caller_uuid), uuid, old_uuid);
+				}
+				switch_core_hash_insert(memdb.calls, uuid, call);
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_CREATE:
+		{
+			char epoch[32];
+
+			if (zstr(uuid)) {
+				break;
+			}
+
+			if ((ch = memdb_channel(uuid))) {
+				memdb_del_calls(uuid);
+				switch_core_hash_delete(memdb.channels, uuid);
+				memdb_free_channel(ch);
+			}
+
+			switch_zmalloc(ch, sizeof(*ch));
+			switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+
+			memdb_set(&ch->col[MC_UUID], uuid);
+			memdb_set_header(ch, MC_DIRECTION, "call-direction");
+			memdb_set_header(ch, MC_CREATED, "event-date-local");
+			memdb_set(&ch->col[MC_CREATED_EPOCH], epoch);
+			memdb_set_header(ch, MC_NAME, "channel-name");
+			memdb_set_header(ch, MC_STATE, "channel-state");
+			memdb_set_header(ch, MC_CALLSTATE, "channel-call-state");
+			memdb_set_header(ch, MC_DIALPLAN, "caller-dialplan");
+			memdb_set_header(ch, MC_CONTEXT, "caller-context");
+			memdb_set(&ch->col[MC_HOSTNAME], switch_core_get_switchname());
+			memdb_set_header(ch, MC_INITIAL_CID_NAME, "caller-caller-id-name");
+			memdb_set_header(ch, MC_INITIAL_CID_NUM, "caller-caller-id-number");
+			memdb_set_header(ch, MC_INITIAL_IP_ADDR, "caller-network-addr");
+			memdb_set_header(ch, MC_INITIAL_DEST, "caller-destination-number");
+			memdb_set_header(ch, MC_INITIAL_DIALPLAN, "caller-dialplan");
+			memdb_set_header(ch, MC_INITIAL_CONTEXT, "caller-context");
+
+			switch_core_hash_insert(memdb.channels, uuid, ch);
+			MEMDB_LINK(memdb.channel_head, memdb.channel_tail, ch);
+			memdb.channel_count++;
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_ANSWER:
+	case SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA:
+	case SWITCH_EVENT_CODEC:
+		if ((ch = memdb_channel(uuid))) {
+			memdb_set_header(ch, MC_READ_CODEC, "channel-read-codec-name");
+			memdb_set_header(ch, MC_READ_RATE, "channel-read-codec-rate");
+			memdb_set_header(ch, MC_READ_BIT_RATE, "channel-read-codec-bit-rate");
+			memdb_set_header(ch, MC_WRITE_CODEC, "channel-write-codec-name");
+			memdb_set_header(ch, MC_WRITE_RATE, "channel-write-codec-rate");
+			memdb_set_header(ch, MC_WRITE_BIT_RATE, "channel-write-codec-bit-rate");
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_HOLD:
+	case SWITCH_EVENT_CHANNEL_UNHOLD:
+	case SWITCH_EVENT_CHANNEL_EXECUTE:
+		if ((ch = memdb_channel(uuid))) {
+			memdb_set_header(ch, MC_APPLICATION, "application");
+			memdb_set_header(ch, MC_APPLICATION_DATA, "application-data");
+			memdb_set_header(ch, MC_PRESENCE_ID, "channel-presence-id");
+			memdb_set_header(ch, MC_PRESENCE_DATA, "channel-presence-data");
+			memdb_set_header(ch, MC_ACCOUNTCODE, "variable_accountcode");
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_ORIGINATE:
+		if ((ch = memdb_channel(uuid))) {
+			memdb_set_header(ch, MC_PRESENCE_ID, "channel-presence-id");
+			memdb_set_header(ch, MC_PRESENCE_DATA, "channel-presence-data");
+			memdb_set_header(ch, MC_ACCOUNTCODE, "variable_accountcode");
+			memdb_set_header(ch, MC_CALL_UUID, "channel-call-uuid");
+		}
+		break;
+	case SWITCH_EVENT_CALL_UPDATE:
+		if ((ch = memdb_channel(uuid))) {
+			memdb_set_header(ch, MC_CALLEE_NAME, "caller-callee-id-name");
+			memdb_set_header(ch, MC_CALLEE_NUM, "caller-callee-id-number");
+			memdb_set_header(ch, MC_SENT_CALLEE_NAME, "sent-callee-id-name");
+			memdb_set_header(ch, MC_SENT_CALLEE_NUM, "sent-callee-id-number");
+			memdb_set_header(ch, MC_CALLEE_DIRECTION, "direction");
+			memdb_set_header(ch, MC_CID_NAME, "caller-caller-id-name");
+			memdb_set_header(ch, MC_CID_NUM, "caller-caller-id-number");
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_CALLSTATE:
+		{
+			char *num = switch_event_get_header_nil(event, "channel-call-state-number");
+			switch_channel_callstate_t callstate = CCS_DOWN;
+
+			if (num) {
+				callstate = atoi(num);
+			}
+
+			if (callstate != CCS_DOWN && callstate != CCS_HANGUP && (ch = memdb_channel(uuid))) {
+				memdb_set_header(ch, MC_CALLSTATE, "channel-call-state");
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_STATE:
+		{
+			char *state = switch_event_get_header_nil(event, "channel-state-number");
+			switch_channel_state_t state_i = CS_DESTROY;
+
+			if (!zstr(state)) {
+				state_i = atoi(state);
+			}
+
+			if (!(ch = memdb_channel(uuid))) {
+				break;
+			}
+
+			switch (state_i) {
+			case CS_NEW:
+			case CS_DESTROY:
+			case CS_REPORTING:
+#ifndef SWITCH_DEPRECATED_CORE_DB
+			case CS_HANGUP:
+#endif
+			case CS_INIT:
+				break;
+			case CS_ROUTING:
+				memdb_set_header(ch, MC_STATE, "channel-state");
+				memdb_set_header(ch, MC_CID_NAME, "caller-caller-id-name");
+				memdb_set_header(ch, MC_CID_NUM, "caller-caller-id-number");
+				memdb_set_header(ch, MC_CALLEE_NAME, "caller-callee-id-name");
+				memdb_set_header(ch, MC_CALLEE_NUM, "caller-callee-id-number");
+				memdb_set_header(ch, MC_SENT_CALLEE_NAME, "sent-callee-id-name");
+				memdb_set_header(ch, MC_SENT_CALLEE_NUM, "sent-callee-id-number");
+				memdb_set_header(ch, MC_IP_ADDR, "caller-network-addr");
+				memdb_set_header(ch, MC_DEST, "caller-destination-number");
+				memdb_set_header(ch, MC_DIALPLAN, "caller-dialplan");
+				memdb_set_header(ch, MC_CONTEXT, "caller-context");
+				memdb_set_header(ch, MC_PRESENCE_ID, "channel-presence-id");
+				memdb_set_header(ch, MC_PRESENCE_DATA, "channel-presence-data");
+				memdb_set_header(ch, MC_ACCOUNTCODE, "variable_accountcode");
+				break;
+			default:
+				memdb_set_header(ch, MC_STATE, "channel-state");
+				break;
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_BRIDGE:
+		{
+			const char *a_uuid, *b_uuid, *call_uuid = switch_event_get_header_nil(event, "channel-call-uuid");
+			memdb_call_t *call;
+			char epoch[32];
+
+			a_uuid = switch_event_get_header(event, "Bridge-A-Unique-ID");
+			b_uuid = switch_event_get_header(event, "Bridge-B-Unique-ID");
+
+			if (zstr(a_uuid) || zstr(b_uuid)) {
+				a_uuid = switch_event_get_header_nil(event, "caller-unique-id");
+				b_uuid = switch_event_get_header_nil(event, "other-leg-unique-id");
+			}
+
+			if ((ch = memdb_channel(a_uuid))) memdb_set(&ch->col[MC_CALL_UUID], call_uuid);
+			if ((ch = memdb_channel(b_uuid))) memdb_set(&ch->col[MC_CALL_UUID], call_uuid);
+
+			memdb_del_calls(a_uuid);
+			memdb_del_calls(b_uuid);
+
+			switch_zmalloc(call, sizeof(*call));
+			switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+			call->call_uuid = strdup(call_uuid);
+			call->call_created_epoch = strdup(epoch);
+			call->caller_uuid = strdup(a_uuid);
+			call->callee_uuid = strdup(b_uuid);
+
+			MEMDB_LINK(memdb.call_head, memdb.call_tail, call);
+			switch_core_hash_insert(memdb.calls, a_uuid, call);
+			switch_core_hash_insert(memdb.calls, b_uuid, call);
+			if ((ch = memdb_channel(a_uuid))) ch->call = call;
+			if ((ch = memdb_channel(b_uuid))) ch->call = call;
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
+		{
+			const char *cuuid = switch_event_get_header_nil(event, "caller-unique-id");
+			const char *call_uuid = switch_event_get_header_nil(event, "channel-call-uuid");
+			memdb_call_t *call;
+
+			memdb_call_uuid_reset(memdb_channel(uuid), call_uuid);
+
+			if ((call = switch_core_hash_find(memdb.calls, cuuid))) {
+				memdb_call_uuid_reset(memdb_channel(call->caller_uuid), call_uuid);
+				memdb_call_uuid_reset(memdb_channel(call->callee_uuid), call_uuid);
+				memdb_free_call(call);
+			}
+		}
+		break;
+	case SWITCH_EVENT_CALL_SECURE:
+		{
+			const char *type = switch_event_get_header_nil(event, "secure_type");
+
+			if (!zstr(type) && (ch = memdb_channel(switch_event_get_header_nil(event, "caller-unique-id")))) {
+				memdb_set(&ch->col[MC_SECURE], type);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	switch_thread_rwlock_unlock(memdb.rwlock);
+}
+
+static switch_bool_t memdb_channel_event_id(switch_event_types_t id)
+{
+	switch (id) {
+	case SWITCH_EVENT_CHANNEL_DESTROY:
+	case SWITCH_EVENT_CHANNEL_UUID:
+	case SWITCH_EVENT_CHANNEL_CREATE:
+	case SWITCH_EVENT_CHANNEL_ANSWER:
+	case SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA:
+	case SWITCH_EVENT_CODEC:
+	case SWITCH_EVENT_CHANNEL_HOLD:
+	case SWITCH_EVENT_CHANNEL_UNHOLD:
+	case SWITCH_EVENT_CHANNEL_EXECUTE:
+	case SWITCH_EVENT_CHANNEL_ORIGINATE:
+	case SWITCH_EVENT_CALL_UPDATE:
+	case SWITCH_EVENT_CHANNEL_CALLSTATE:
+	case SWITCH_EVENT_CHANNEL_STATE:
+	case SWITCH_EVENT_CHANNEL_BRIDGE:
+	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
+	case SWITCH_EVENT_CALL_SECURE:
+		return SWITCH_TRUE;
+	default:
+		return SWITCH_FALSE;
+	}
+}
+
+static void memdb_event_handler(switch_event_t *event)
+{
+	if (memdb_channel_event_id(event->event_id)) {
+		memdb_channel_event(event);
+	}
+}
+
+static void memdb_free_registration(memdb_registration_t *reg)
+{
+	memdb_registration_t *head, *rp, *last = NULL;
+	int i;
+
+	if ((head = switch_core_hash_find(memdb.reg_users, reg->user_key))) {
+		for (rp = head; rp && rp != reg; rp = rp->user_next) {
+			last = rp;
+		}
+		if (rp) {
+			if (last) {
+				last->user_next = rp->user_next;
+			} else if (rp->user_next) {
+				switch_core_hash_insert(memdb.reg_users, reg->user_key, rp->user_next);
+			} else {
+				switch_core_hash_delete(memdb.reg_users, reg->user_key);
+			}
+		}
+	}
+
+	if (!zstr(reg->col[MR_URL]) && switch_core_hash_find(memdb.reg_urls, reg->col[MR_URL]) == reg) {
+		switch_core_hash_delete(memdb.reg_urls, reg->col[MR_URL]);
+	}
+
+	if (!zstr(reg->col[MR_TOKEN]) && switch_core_hash_find(memdb.reg_tokens, reg->col[MR_TOKEN]) == reg) {
+		switch_core_hash_delete(memdb.reg_tokens, reg->col[MR_TOKEN]);
+	}
+
+	MEMDB_UNLINK(memdb.reg_head, memdb.reg_tail, reg);
+	memdb.reg_count--;
+
+	for (i = 0; i < MR_MAX; i++) {
+		switch_safe_free(reg->col[i]);
+	}
+	switch_safe_free(reg->user_key);
+	free(reg);
+}
+
+static void memdb_del_registration(const char *user, const char *realm, const char *token)
+{
+	memdb_registration_t *reg, *next;
+	char *key = switch_mprintf("%s@%s", switch_str_nil(user), switch_str_nil(realm));
+
+	for (reg = switch_core_hash_find(memdb.reg_users, key); reg; reg = next) {
+		next = reg->user_next;
+		if (zstr(token) || !runtime.multiple_registrations || !strcmp(switch_str_nil(reg->col[MR_TOKEN]), token)) {
+			memdb_free_registration(reg);
+		}
+	}
+
+	switch_safe_free(key);
+}
+
+static void memdb_add_registration(const char *user, const char *realm, const char *token, const char *url, uint32_t expires,
+								   const char *network_ip, const char *network_port, const char *network_proto,
+								   const char *metadata)
+{
+	memdb_registration_t *reg;
+	char buf[32];
+
+	switch_thread_rwlock_wrlock(memdb.rwlock);
+
+	if (runtime.multiple_registrations) {
+		if (!zstr(url) && (reg = switch_core_hash_find(memdb.reg_urls, url))) {
+			memdb_free_registration(reg);
+		}
+		if (!zstr(token) && (reg = switch_core_hash_find(memdb.reg_tokens, token))) {
+			memdb_free_registration(reg);
+		}
+	} else {
+		memdb_del_registration(user, realm, NULL);
+	}
+
+	switch_zmalloc(reg, sizeof(*reg));
+	switch_snprintf(buf, sizeof(buf), "%ld", (long) expires);
+
+	memdb_set(&reg->col[MR_REG_USER], switch_str_nil(user));
+	memdb_set(&reg->col[MR_REALM], switch_str_nil(realm));
+	memdb_set(&reg->col[MR_TOKEN], switch_str_nil(token));
+	memdb_set(&reg->col[MR_URL], switch_str_nil(url));
+	memdb_set(&reg->col[MR_EXPIRES], buf);
+	memdb_set(&reg->col[MR_NETWORK_IP], switch_str_nil(network_ip));
+	memdb_set(&reg->col[MR_NETWORK_PORT], switch_str_nil(network_port));
+	memdb_set(&reg->col[MR_NETWORK_PROTO], switch_str_nil(network_proto));
+	memdb_set(&reg->col[MR_HOSTNAME], switch_core_get_switchname());
+	if (!zstr(metadata)) {
+		memdb_set(&reg->col[MR_METADATA], metadata);
+	}
+	reg->expires = expires;
+	reg->user_key = switch_mprintf("%s@%s", switch_str_nil(user), switch_str_nil(realm));
+
+	reg->user_next = switch_core_hash_find(memdb.reg_users, reg->user_key);
+	switch_core_hash_insert(memdb.reg_users, reg->user_key, reg);
+	if (!zstr(url)) switch_core_hash_insert(memdb.reg_urls, url, reg);
+	if (!zstr(token)) switch_core_hash_insert(memdb.reg_tokens, token, reg);
+
+	MEMDB_LINK(memdb.reg_head, memdb.reg_tail, reg);
+	memdb.reg_count++;
+
+	switch_thread_rwlock_unlock(memdb.rwlock);
+}
+
+static void memdb_expire_registrations(int force)
+{
+	memdb_registration_t *reg, *next;
+	time_t now = switch_epoch_time_now(NULL);
+
+	switch_thread_rwlock_wrlock(memdb.rwlock);
+	for (reg = memdb.reg_head; reg; reg = next) {
+		next = reg->next;
+		if (force || (reg->expires > 0 && reg->expires <= now)) {
+			memdb_free_registration(reg);
+		}
+	}
+	switch_thread_rwlock_unlock(memdb.rwlock);
+}
+
+/* SQL LIKE: % matches any run, _ any one character, ASCII case-insensitive */
+static switch_bool_t memdb_like(const char *str, const char *pattern)
+{
+	const char *s = str, *p = pattern, *star = NULL, *mark = NULL;
+
+	if (!str) {
+		return SWITCH_FALSE;
+	}
+
+	while (*s) {
+		if (*p == '%') {
+			star = ++p;
+			mark = s;
+		} else if (*p && (*p == '_' || switch_tolower(*p) == switch_tolower(*s))) {
+			p++;
+			s++;
+		} else if (star) {
+			p = star;
+			s = ++mark;
+		} else {
+			return SWITCH_FALSE;
+		}
+	}
+
+	while (*p == '%') {
+		p++;
+	}
+
+	return *p == '\0' ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static switch_bool_t memdb_hostname_match(const char *col, const char *hostname)
+{
+	return (zstr(hostname) || !strcasecmp(switch_str_nil(col), hostname)) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static switch_bool_t memdb_channel_match(memdb_channel_t *ch, const char *like)
+{
+	return (!like ||
+			memdb_like(ch->col[MC_UUID], like) ||
+			memdb_like(ch->col[MC_NAME], like) ||
+			memdb_like(ch->col[MC_CID_NAME], like) ||
+			memdb_like(ch->col[MC_CID_NUM], like) ||
+			memdb_like(ch->col[MC_PRESENCE_DATA], like) ||
+			memdb_like(ch->col[MC_ACCOUNTCODE], like)) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+typedef struct {
+	switch_core_table_query_t *query;
+	switch_core_db_callback_func_t callback;
+	void *pdata;
+	uint32_t count;
+	int column;
+	int abort;
+} memdb_cursor_t;
+
+static void memdb_emit(memdb_cursor_t *cur, int argc, char **argv, char **names)
+{
+	if (cur->abort) {
+		return;
+	}
+
+	cur->count++;
+
+	if (cur->query->count) {
+		return;
+	}
+
+	if (cur->column > -1) {
+		if (cur->column < argc && cur->callback(cur->pdata, 1, &argv[cur->column], &names[cur->column])) {
+			cur->abort = 1;
+		}
+	} else if (cur->callback(cur->pdata, argc, argv, names)) {
+		cur->abort = 1;
+	}
+}
+
+static int memdb_column_index(char **names, int argc, const char *column)
+{
+	int i;
+
+	if (zstr(column)) {
+		return -1;
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (!strcasecmp(names[i], column)) {
+			return i;
+		}
+	}
+
+	return argc;
+}
+
+static void memdb_emit_call(memdb_cursor_t *cur, switch_bool_t detailed, memdb_channel_t *a, memdb_channel_t *b, memdb_call_t *call)
+{
+	char *argv[MEMDB_MAX_ROW] = { 0 };
+	int argc = 0;
+	size_t i;
+
+	if (detailed) {
+		for (i = 0; i < MEMDB_DETAILED_COLS; i++) {
+			argv[argc++] = a->col[i];
+		}
+		for (i = 0; i < MEMDB_DETAILED_COLS; i++) {
+			argv[argc++] = b ? b->col[i] : NULL;
+		}
+	} else {
+		for (i = 0; i < MEMDB_BASIC_A_COLS; i++) {
+			argv[argc++] = a->col[memdb_basic_a_cols[i]];
+		}
+		for (i = 0; i < MEMDB_BASIC_B_COLS; i++) {
+			argv[argc++] = b ? b->col[memdb_basic_b_cols[i]] : NULL;
+		}
+	}
+
+	argv[argc++] = call ? call->call_created_epoch : NULL;
+
+	memdb_emit(cur, argc, argv, detailed ? memdb.detailed_names : memdb.basic_names);
+}
+
+static void memdb_query_calls(memdb_cursor_t *cur, switch_bool_t detailed)
+{
+	memdb_channel_t *ch, *b;
+	memdb_call_t *call;
+	char **names = detailed ? memdb.detailed_names : memdb.basic_names;
+	int argc = detailed ? MEMDB_DETAILED_COLS * 2 + 1 : (int) (MEMDB_BASIC_A_COLS + MEMDB_BASIC_B_COLS + 1);
+
+	cur->column = memdb_column_index(names, argc, cur->query->column);
+
+	if (!detailed && !cur->query->bridged) {
+		/* "order by call_created_epoch" puts the unbridged channels (NULL epoch) first */
+		for (ch = memdb.channel_head; ch && !cur->abort; ch = ch->next) {
+			if (!ch->call && memdb_hostname_match(ch->col[MC_HOSTNAME], cur->query->hostname)) {
+				memdb_emit_call(cur, detailed, ch, NULL, NULL);
+			}
+		}
+		for (call = memdb.call_head; call && !cur->abort; call = call->next) {
+			if ((ch = memdb_channel(call->caller_uuid)) && memdb_hostname_match(ch->col[MC_HOSTNAME], cur->query->hostname)) {
+				memdb_emit_call(cur, detailed, ch, memdb_channel(call->callee_uuid), call);
+			}
+		}
+		return;
+	}
+
+	for (ch = memdb.channel_head; ch && !cur->abort; ch = ch->next) {
+		call = ch->call;
+
+		if (call && strcmp(call->caller_uuid, ch->col[MC_UUID])) {
+			/* b legs are reported on their a leg's row */
+			continue;
+		}
+
+		if (!memdb_hostname_match(ch->col[MC_HOSTNAME], cur->query->hostname)) {
+			continue;
+		}
+
+		b = call ? memdb_channel(call->callee_uuid) : NULL;
+
+		if (cur->query->bridged && !b) {
+			continue;
+		}
+
+		memdb_emit_call(cur, detailed, ch, b, call);
+	}
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_core_memory_tables_enabled(void)
+{
+	return memdb.running ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_memory_table_query(switch_core_table_query_t *query, switch_core_db_callback_func_t callback, void *pdata)
+{
+	memdb_cursor_t cur = { 0 };
+
+	if (!memdb.running) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	cur.query = query;
+	cur.callback = callback;
+	cur.pdata = pdata;
+	cur.column = -1;
+
+	switch_thread_rwlock_rdlock(memdb.rwlock);
+
+	switch (query->table) {
+	case SWITCH_CORE_TABLE_CHANNELS:
+		{
+			memdb_channel_t *ch;
+
+			cur.column = memdb_column_index(memdb_channel_cols, MC_MAX, query->column);
+
+			for (ch = memdb.channel_head; ch && !cur.abort; ch = ch->next) {
+				if (memdb_hostname_match(ch->col[MC_HOSTNAME], query->hostname) && memdb_channel_match(ch, query->like)) {
+					memdb_emit(&cur, MC_MAX, ch->col, memdb_channel_cols);
+				}
+			}
+		}
+		break;
+	case SWITCH_CORE_TABLE_CALLS:
+	case SWITCH_CORE_TABLE_DETAILED_CALLS:
+		memdb_query_calls(&cur, query->table == SWITCH_CORE_TABLE_DETAILED_CALLS);
+		break;
+	case SWITCH_CORE_TABLE_REGISTRATIONS:
+		{
+			memdb_registration_t *reg;
+
+			cur.column = memdb_column_index(memdb_registration_cols, MR_MAX, query->column);
+
+			if (!zstr(query->reg_user) && !zstr(query->realm)) {
+				char *key = switch_mprintf("%s@%s", query->reg_user, query->realm);
+
+				for (reg = switch_core_hash_find(memdb.reg_users, key); reg && !cur.abort; reg = reg->user_next) {
+					if (memdb_hostname_match(reg->col[MR_HOSTNAME], query->hostname)) {
+						memdb_emit(&cur, MR_MAX, reg->col, memdb_registration_cols);
+					}
+				}
+
+				switch_safe_free(key);
+			} else {
+				for (reg = memdb.reg_head; reg && !cur.abort; reg = reg->next) {
+					if ((zstr(query->reg_user) || !strcmp(reg->col[MR_REG_USER], query->reg_user)) &&
+						(zstr(query->realm) || !strcmp(reg->col[MR_REALM], query->realm)) &&
+						memdb_hostname_match(reg->col[MR_HOSTNAME], query->hostname)) {
+						memdb_emit(&cur, MR_MAX, reg->col, memdb_registration_cols);
+					}
+				}
+			}
+		}
+		break;
+	}
+
+	switch_thread_rwlock_unlock(memdb.rwlock);
+
+	if (query->count) {
+		char buf[32] = "";
+		char *argv[1] = { buf };
+		char *names[1] = { "count" };
+
+		switch_snprintf(buf, sizeof(buf), "%u", cur.count);
+		callback(pdata, 1, argv, names);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void memdb_start(switch_memory_pool_t *pool)
+{
+	int i, x = 0, y = 0;
+
+	memdb.pool = pool;
+	switch_thread_rwlock_create(&memdb.rwlock, memdb.pool);
+	switch_core_hash_init(&memdb.channels);
+	switch_core_hash_init(&memdb.calls);
+	switch_core_hash_init(&memdb.reg_users);
+	switch_core_hash_init(&memdb.reg_urls);
+	switch_core_hash_init(&memdb.reg_tokens);
+
+	for (i = 0; i < MEMDB_DETAILED_COLS; i++) {
+		memdb.detailed_names[x++] = memdb_channel_cols[i];
+	}
+	for (i = 0; i < MEMDB_DETAILED_COLS; i++) {
+		memdb.detailed_names[x++] = switch_core_sprintf(memdb.pool, "b_%s", memdb_channel_cols[i]);
+	}
+	memdb.detailed_names[x++] = "call_created_epoch";
+
+	for (i = 0; i < (int) MEMDB_BASIC_A_COLS; i++) {
+		memdb.basic_names[y++] = memdb_channel_cols[memdb_basic_a_cols[i]];
+	}
+	for (i = 0; i < (int) MEMDB_BASIC_B_COLS; i++) {
+		memdb.basic_names[y++] = switch_core_sprintf(memdb.pool, "b_%s", memdb_channel_cols[memdb_basic_b_cols[i]]);
+	}
+	memdb.basic_names[y++] = "call_created_epoch";
+
+	memdb.running = 1;
+
+	switch_event_bind("core_memdb", SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, memdb_event_handler, NULL);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "In-memory core tables enabled%s\n",
+					  runtime.core_memory_tables_mirror ? ", mirroring to SQL" : "");
+}
+
+static void memdb_stop(void)
+{
+	if (!memdb.running) {
+		return;
+	}
+
+	switch_event_unbind_callback(memdb_event_handler);
+
+	switch_thread_rwlock_wrlock(memdb.rwlock);
+	memdb.running = 0;
+
+	while (memdb.call_head) {
+		memdb_free_call(memdb.call_head);
+	}
+	while (memdb.channel_head) {
+		memdb_free_channel(memdb.channel_head);
+	}
+	while (memdb.reg_head) {
+		memdb_free_registration(memdb.reg_head);
+	}
+
+	switch_core_hash_destroy(&memdb.channels);
+	switch_core_hash_destroy(&memdb.calls);
+	switch_core_hash_destroy(&memdb.reg_users);
+	switch_core_hash_destroy(&memdb.reg_urls);
+	switch_core_hash_destroy(&memdb.reg_tokens);
+	switch_thread_rwlock_unlock(memdb.rwlock);
+}
+
+/* channel and registration rows go to SQL only when the in-memory tables are off or mirroring is on */
+#define memdb_sql_skip() (memdb.running && !runtime.core_memory_tables_mirror)
+
+static switch_bool_t memdb_sql_skip_channels(void)
+{
+	return memdb_sql_skip() ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_add_registration(const char *user, const char *realm, const char *token, const char *url, uint32_t expires,
 															 const char *network_ip, const char *network_port, const char *network_proto,
 															 const char *metadata)
 {
 	char *sql;
 
+	if (memdb.running) {
+		memdb_add_registration(user, realm, token, url, expires, network_ip, network_port, network_proto, metadata);
+
+		if (memdb_sql_skip()) {
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
 	if (!switch_test_flag((&runtime), SCF_USE_SQL)) {
 		return SWITCH_STATUS_FALSE;
 	}
@@ -3507,6 +4812,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_del_registration(const char *user, c
 
 	char *sql;
 
+	if (memdb.running) {
+		switch_thread_rwlock_wrlock(memdb.rwlock);
+		memdb_del_registration(user, realm, token);
+		switch_thread_rwlock_unlock(memdb.rwlock);
+
+		if (memdb_sql_skip()) {
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
 	if (!switch_test_flag((&runtime), SCF_USE_SQL)) {
 		return SWITCH_STATUS_FALSE;
 	}
@@ -3529,6 +4844,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_expire_registration(int force)
 	char *sql;
 	time_t now;
 
+	if (memdb.running) {
+		memdb_expire_registrations(force);
+
+		if (memdb_sql_skip()) {
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
 	if (!switch_test_flag((&runtime), SCF_USE_SQL)) {
 		return SWITCH_STATUS_FALSE;
 	}
@@ -3557,6 +4880,10 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 	switch_mutex_init(&sql_manager.dbh_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 	switch_mutex_init(&sql_manager.ctl_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 
+	if (runtime.core_memory_tables) {
+		memdb_start(sql_manager.memory_pool);
+	}
+
 	if (!sql_manager.manage) goto skip;
 
  top:
@@ -3905,6 +5232,7 @@ void switch_core_sqldb_stop(void)
 	switch_status_t st;
 
 	switch_event_unbind_callback(core_event_handler);
+	memdb_stop();
 
 	if (sql_manager.db_thread && sql_manager.db_thread_running) {
 		sql_manager.db_thread_running = -1;
@@ -3989,6 +5317,18 @@ SWITCH_DECLARE(void) switch_cache_db_status(switch_stream_handle_t *stream)
 	stream->write_function(stream, "%d total. %d in use.\n", count, used);
 
 	switch_mutex_unlock(sql_manager.dbh_mutex);
+
+	if (sql_manager.qm) {
+		switch_sql_queue_manager_stats_t stats;
+
+		switch_sql_queue_manager_stats(sql_manager.qm, &stats);
+		stream->write_function(stream, "\nCore SQL queue\n\tDepth: %u\n\tBatches: %" SWITCH_UINT64_T_FMT " (last %u, max %u)\n"
+							   "\tStatements: %" SWITCH_UINT64_T_FMT " (%" SWITCH_UINT64_T_FMT " errors)\n"
+							   "\tPrepared: %" SWITCH_UINT64_T_FMT " hits, %" SWITCH_UINT64_T_FMT " misses\n"
+							   "\tFlush: last %" SWITCH_TIME_T_FMT "us, avg %" SWITCH_TIME_T_FMT "us, max %" SWITCH_TIME_T_FMT "us\n",
+							   stats.depth, stats.batches, stats.last_batch, stats.max_batch, stats.statements, stats.errors,
+							   stats.prepared_hits, stats.prepared_misses, stats.last_flush_us, stats.avg_flush_us, stats.max_flush_us);
+	}
 }
 
 SWITCH_DECLARE(char*)switch_sql_concat(void)
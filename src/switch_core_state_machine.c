@@ -564,6 +564,17 @@ static void check_presence(switch_core_session_t *session)
 
 
 SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
+{
+	switch_core_session_run_task(session, SWITCH_SESSION_RUN_THREAD);
+}
+
+/*
+  In SWITCH_SESSION_RUN_POOL and SWITCH_SESSION_RUN_MEDIA mode the state machine runs as a task: rather than
+  sleeping on session->cond it hands its thread back and switch_core_session_wake_session_thread() schedules
+  it again, and when the next state wants the other kind of worker it reschedules itself there.
+  SWITCH_STATUS_BREAK means another task owns the session now and it must not be touched.
+*/
+switch_status_t switch_core_session_run_task(switch_core_session_t *session, switch_session_run_mode_t mode)
 {
 	switch_channel_state_t state = CS_NEW, midstate = CS_DESTROY, endstate;
 	const switch_endpoint_interface_t *endpoint_interface;
@@ -598,8 +609,17 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 
 	switch_mutex_lock(session->mutex);
 
+	if (mode != SWITCH_SESSION_RUN_THREAD && switch_channel_test_flag(session->channel, CF_THREAD_SLEEPING)) {
+		switch_channel_clear_flag(session->channel, CF_THREAD_SLEEPING);
+		switch_ivr_parse_all_events(session);
+	}
+
 	while ((state = switch_channel_get_state(session->channel)) != CS_DESTROY) {
 
+		if (mode != SWITCH_SESSION_RUN_THREAD && switch_core_session_task_mode(session) != mode) {
+			goto move;
+		}
+
 		if (switch_channel_test_flag(session->channel, CF_BLOCK_STATE)) {
 			switch_channel_wait_for_flag(session->channel, CF_BLOCK_STATE, SWITCH_FALSE, 0, NULL);
 			if ((state = switch_channel_get_state(session->channel)) == CS_DESTROY) {
@@ -733,6 +753,36 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 					switch_channel_clear_flag(session->channel, CF_STATE_REPEAT);
 				} else if (switch_channel_get_state(session->channel) == switch_channel_get_running_state(session->channel)) {
 					switch_channel_set_flag(session->channel, CF_THREAD_SLEEPING);
+
+					if (mode != SWITCH_SESSION_RUN_THREAD) {
+						int suspend;
+
+						/* a wake that came in since the last pass is taken here instead of rescheduling the task */
+						switch_mutex_lock(session->task_mutex);
+						if ((suspend = !session->task_wake_pending)) {
+							session->task_suspended = 1;
+						}
+						session->task_wake_pending = 0;
+						switch_mutex_unlock(session->task_mutex);
+
+						if (suspend) {
+							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG1, "%s session task yield state: %s!\n",
+											  switch_channel_get_name(session->channel),
+											  switch_channel_state_name(switch_channel_get_running_state(session->channel)));
+							/* the worker is not ours anymore, switch_core_session_in_thread() must not match it */
+							session->thread = NULL;
+							session->thread_id = 0;
+							switch_mutex_unlock(session->mutex);
+							switch_channel_state_thread_unlock(session->channel);
+							return SWITCH_STATUS_BREAK;
+						}
+
+						switch_channel_clear_flag(session->channel, CF_THREAD_SLEEPING);
+						switch_channel_state_thread_unlock(session->channel);
+						switch_ivr_parse_all_events(session);
+						continue;
+					}
+
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG1, "%s session thread sleep state: %s!\n",
 									  switch_channel_get_name(session->channel),
 									  switch_channel_state_name(switch_channel_get_running_state(session->channel)));
@@ -753,6 +803,19 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 	switch_mutex_unlock(session->mutex);
 
 	switch_clear_flag(session, SSF_THREAD_RUNNING);
+
+	return SWITCH_STATUS_SUCCESS;
+
+  move:
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG1, "%s session task moving to %s worker in state: %s\n",
+					  switch_channel_get_name(session->channel), mode == SWITCH_SESSION_RUN_POOL ? "media" : "pool",
+					  switch_channel_state_name(state));
+	session->thread = NULL;
+	session->thread_id = 0;
+	switch_core_session_task_schedule(session);
+	switch_mutex_unlock(session->mutex);
+
+	return SWITCH_STATUS_BREAK;
 }
 
 SWITCH_DECLARE(void) switch_core_session_destroy_state(switch_core_session_t *session)
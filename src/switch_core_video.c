@@ -38,6 +38,7 @@
 
 #include <switch.h>
 #include <switch_utf8.h>
+#include "private/switch_core_pvt.h"
 
 #ifdef SWITCH_HAVE_YUV
 #include <libyuv.h>
@@ -189,6 +190,304 @@ SWITCH_DECLARE(switch_bool_t) switch_core_has_video(void)
 #endif
 }
 
+#ifdef SWITCH_HAVE_VPX
+#define IMG_POOL_BUCKETS 64
+#define IMG_POOL_BUCKET_MAX 16
+
+/* images from switch_img_alloc, fb_priv points back at the image so copies of the descriptor are never taken for one */
+typedef struct switch_pooled_img_s {
+	switch_image_t img;
+	switch_atomic_t refs;
+	switch_img_fmt_t fmt;
+	unsigned int w;
+	unsigned int h;
+	unsigned int align;
+	switch_size_t bytes;
+	struct switch_pooled_img_s *next;
+} switch_pooled_img_t;
+
+typedef struct {
+	switch_img_fmt_t fmt;
+	unsigned int w;
+	unsigned int h;
+	unsigned int align;
+	uint32_t count;
+	switch_time_t last_used;
+	switch_pooled_img_t *head;
+} img_pool_bucket_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	/* set by switch_core_video_uninit(), nothing goes back into the pool after that */
+	int closed;
+	img_pool_bucket_t buckets[IMG_POOL_BUCKETS];
+	switch_img_pool_stats_t stats;
+} img_pool;
+
+static inline switch_pooled_img_t *pooled_img(switch_image_t *img)
+{
+	if (img && img->fb_priv == (void *)img) {
+		return (switch_pooled_img_t *)img;
+	}
+
+	return NULL;
+}
+
+static void pooled_img_destroy(switch_pooled_img_t *p)
+{
+	vpx_img_free((vpx_image_t *)&p->img);
+	free(p);
+}
+
+/* the storage size vpx_img_alloc() rounds d_w x d_h up to for the chroma subsampling, the pool is keyed on it */
+static void img_pool_storage_size(switch_img_fmt_t fmt, unsigned int d_w, unsigned int d_h, unsigned int *w, unsigned int *h)
+{
+	unsigned int xcs = 0, ycs = 0;
+
+	switch (fmt) {
+	case SWITCH_IMG_FMT_I420:
+	case SWITCH_IMG_FMT_YV12:
+	case SWITCH_IMG_FMT_VPXI420:
+	case SWITCH_IMG_FMT_VPXYV12:
+	case SWITCH_IMG_FMT_I42016:
+		xcs = ycs = 1;
+		break;
+	case SWITCH_IMG_FMT_I422:
+	case SWITCH_IMG_FMT_I42216:
+		xcs = 1;
+		break;
+	case SWITCH_IMG_FMT_I440:
+	case SWITCH_IMG_FMT_I44016:
+		ycs = 1;
+		break;
+	default:
+		break;
+	}
+
+	*w = (d_w + (1 << xcs) - 1) & ~((1 << xcs) - 1);
+	*h = (d_h + (1 << ycs) - 1) & ~((1 << ycs) - 1);
+}
+
+static img_pool_bucket_t *img_pool_find(switch_img_fmt_t fmt, unsigned int w, unsigned int h, unsigned int align)
+{
+	int i;
+
+	for (i = 0; i < IMG_POOL_BUCKETS; i++) {
+		img_pool_bucket_t *b = &img_pool.buckets[i];
+
+		if (b->w == w && b->h == h && b->fmt == fmt && b->align == align) {
+			return b;
+		}
+	}
+
+	return NULL;
+}
+
+/* take the oldest image of the least recently used bucket off the pool, call with the mutex held */
+static switch_pooled_img_t *img_pool_evict(void)
+{
+	img_pool_bucket_t *lru = NULL;
+	switch_pooled_img_t *p;
+	int i;
+
+	for (i = 0; i < IMG_POOL_BUCKETS; i++) {
+		img_pool_bucket_t *b = &img_pool.buckets[i];
+
+		if (b->head && (!lru || b->last_used < lru->last_used)) {
+			lru = b;
+		}
+	}
+
+	if (!lru) return NULL;
+
+	p = lru->head;
+	lru->head = p->next;
+	lru->count--;
+	img_pool.stats.bytes -= p->bytes;
+	img_pool.stats.images--;
+	img_pool.stats.evictions++;
+	p->next = NULL;
+
+	return p;
+}
+
+static switch_pooled_img_t *img_pool_get(switch_img_fmt_t fmt, unsigned int d_w, unsigned int d_h, unsigned int align)
+{
+	switch_pooled_img_t *p = NULL;
+	img_pool_bucket_t *b;
+	unsigned int w, h;
+
+	if (!img_pool.mutex) return NULL;
+
+	img_pool_storage_size(fmt, d_w, d_h, &w, &h);
+
+	switch_mutex_lock(img_pool.mutex);
+	if (img_pool.stats.max_bytes && !img_pool.closed) {
+		if ((b = img_pool_find(fmt, w, h, align)) && b->head) {
+			p = b->head;
+			b->head = p->next;
+			b->count--;
+			b->last_used = switch_micro_time_now();
+			img_pool.stats.bytes -= p->bytes;
+			img_pool.stats.images--;
+			img_pool.stats.hits++;
+			p->next = NULL;
+		} else {
+			img_pool.stats.misses++;
+		}
+	}
+	switch_mutex_unlock(img_pool.mutex);
+
+	/* put left the viewport at the full storage size */
+	if (p && vpx_img_set_rect((vpx_image_t *)&p->img, 0, 0, d_w, d_h)) {
+		pooled_img_destroy(p);
+		p = NULL;
+	}
+
+	return p;
+}
+
+static void img_pool_put(switch_pooled_img_t *p)
+{
+	switch_pooled_img_t *evicted = NULL, *e;
+	img_pool_bucket_t *b = NULL;
+	int i;
+
+	/* the descriptor was turned into something else (GD) or cropped beyond repair */
+	if (!img_pool.mutex || p->img.fmt != p->fmt || p->img.w != p->w || p->img.h != p->h ||
+		vpx_img_set_rect((vpx_image_t *)&p->img, 0, 0, p->w, p->h)) {
+		pooled_img_destroy(p);
+		return;
+	}
+
+	switch_mutex_lock(img_pool.mutex);
+
+	if (!img_pool.stats.max_bytes || img_pool.closed || p->bytes > img_pool.stats.max_bytes) {
+		switch_mutex_unlock(img_pool.mutex);
+		pooled_img_destroy(p);
+		return;
+	}
+
+	if (!(b = img_pool_find(p->fmt, p->w, p->h, p->align))) {
+		img_pool_bucket_t *lru = NULL;
+
+		for (i = 0; i < IMG_POOL_BUCKETS; i++) {
+			if (!img_pool.buckets[i].head && (!lru || img_pool.buckets[i].last_used < lru->last_used)) {
+				lru = &img_pool.buckets[i];
+			}
+		}
+
+		if ((b = lru)) {
+			b->fmt = p->fmt;
+			b->w = p->w;
+			b->h = p->h;
+			b->align = p->align;
+			b->count = 0;
+		}
+	}
+
+	if (!b || b->count >= IMG_POOL_BUCKET_MAX) {
+		switch_mutex_unlock(img_pool.mutex);
+		pooled_img_destroy(p);
+		return;
+	}
+
+	while (img_pool.stats.bytes + p->bytes > img_pool.stats.max_bytes && (e = img_pool_evict())) {
+		e->next = evicted;
+		evicted = e;
+	}
+
+	p->next = b->head;
+	b->head = p;
+	b->count++;
+	b->last_used = switch_micro_time_now();
+	img_pool.stats.bytes += p->bytes;
+	img_pool.stats.images++;
+
+	switch_mutex_unlock(img_pool.mutex);
+
+	while ((e = evicted)) {
+		evicted = e->next;
+		pooled_img_destroy(e);
+	}
+}
+#endif
+
+SWITCH_DECLARE(void) switch_img_pool_set_limits(switch_size_t max_bytes)
+{
+#ifdef SWITCH_HAVE_VPX
+	switch_pooled_img_t *evicted = NULL, *e;
+
+	if (!img_pool.mutex) return;
+
+	switch_mutex_lock(img_pool.mutex);
+	img_pool.stats.max_bytes = img_pool.closed ? 0 : max_bytes;
+	while (img_pool.stats.bytes > max_bytes && (e = img_pool_evict())) {
+		e->next = evicted;
+		evicted = e;
+	}
+	switch_mutex_unlock(img_pool.mutex);
+
+	while ((e = evicted)) {
+		evicted = e->next;
+		pooled_img_destroy(e);
+	}
+#endif
+}
+
+SWITCH_DECLARE(void) switch_img_pool_get_stats(switch_img_pool_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+#ifdef SWITCH_HAVE_VPX
+	if (!img_pool.mutex) return;
+
+	switch_mutex_lock(img_pool.mutex);
+	*stats = img_pool.stats;
+	switch_mutex_unlock(img_pool.mutex);
+#endif
+}
+
+SWITCH_DECLARE(void) switch_img_pool_flush(void)
+{
+#ifdef SWITCH_HAVE_VPX
+	switch_size_t max_bytes;
+
+	if (!img_pool.mutex) return;
+
+	switch_mutex_lock(img_pool.mutex);
+	max_bytes = img_pool.stats.max_bytes;
+	switch_mutex_unlock(img_pool.mutex);
+
+	switch_img_pool_set_limits(0);
+	switch_img_pool_set_limits(max_bytes);
+#endif
+}
+
+void switch_core_video_init(switch_memory_pool_t *pool)
+{
+#ifdef SWITCH_HAVE_VPX
+	memset(&img_pool, 0, sizeof(img_pool));
+	/* about a dozen 1080p frames, image-pool-size in switch.conf overrides it */
+	img_pool.stats.max_bytes = 32 * 1024 * 1024;
+	switch_mutex_init(&img_pool.mutex, SWITCH_MUTEX_NESTED, pool);
+#endif
+}
+
+void switch_core_video_uninit(void)
+{
+#ifdef SWITCH_HAVE_VPX
+	/* the mutex stays, images freed by threads still winding down must not find it gone */
+	if (img_pool.mutex) {
+		switch_mutex_lock(img_pool.mutex);
+		img_pool.closed = 1;
+		switch_mutex_unlock(img_pool.mutex);
+	}
+
+	switch_img_pool_set_limits(0);
+#endif
+}
+
 SWITCH_DECLARE(switch_image_t *)switch_img_alloc(switch_image_t  *img,
 						 switch_img_fmt_t fmt,
 						 unsigned int d_w,
@@ -197,6 +496,7 @@ SWITCH_DECLARE(switch_image_t *)switch_img_alloc(switch_image_t  *img,
 {
 #ifdef SWITCH_HAVE_VPX
 	switch_image_t *r = NULL;
+	switch_pooled_img_t *p;
 #ifdef HAVE_LIBGD
 	if (fmt == SWITCH_IMG_FMT_GD) {
 		gdImagePtr gd = gdImageCreateTrueColor(d_w, d_h);
@@ -221,17 +521,58 @@ SWITCH_DECLARE(switch_image_t *)switch_img_alloc(switch_image_t  *img,
 
 	switch_assert(d_w > 0);
 	switch_assert(d_h > 0);
-	r = (switch_image_t *)vpx_img_alloc((vpx_image_t *)img, (vpx_img_fmt_t)fmt, d_w, d_h, align);
+
+	if (img) {
+		r = (switch_image_t *)vpx_img_alloc((vpx_image_t *)img, (vpx_img_fmt_t)fmt, d_w, d_h, align);
+		switch_assert(r);
+		switch_assert(r->d_w == d_w);
+		switch_assert(r->d_h == d_h);
+		return r;
+	}
+
+	if ((p = img_pool_get(fmt, d_w, d_h, align))) {
+		switch_atomic_set(&p->refs, 1);
+		return &p->img;
+	}
+
+	switch_zmalloc(p, sizeof(*p));
+	r = (switch_image_t *)vpx_img_alloc((vpx_image_t *)&p->img, (vpx_img_fmt_t)fmt, d_w, d_h, align);
 	switch_assert(r);
 	switch_assert(r->d_w == d_w);
 	switch_assert(r->d_h == d_h);
 
+	r->fb_priv = r;
+	p->fmt = fmt;
+	p->w = r->w;
+	p->h = r->h;
+	p->align = align;
+	p->bytes = (fmt & SWITCH_IMG_FMT_PLANAR) ? (switch_size_t)r->stride[0] * r->h * r->bps / 8 : (switch_size_t)r->stride[0] * r->h;
+	switch_atomic_set(&p->refs, 1);
+
 	return r;
 #else
 	return NULL;
 #endif
 }
 
+SWITCH_DECLARE(switch_image_t *) switch_img_ref(switch_image_t *img)
+{
+#ifdef SWITCH_HAVE_VPX
+	switch_pooled_img_t *p;
+	switch_image_t *copy = NULL;
+
+	if ((p = pooled_img(img))) {
+		switch_atomic_inc(&p->refs);
+		return img;
+	}
+
+	switch_img_copy(img, &copy);
+	return copy;
+#else
+	return NULL;
+#endif
+}
+
 SWITCH_DECLARE(switch_image_t *)switch_img_wrap(switch_image_t  *img,
 						switch_img_fmt_t fmt,
 						unsigned int d_w,
@@ -295,7 +636,15 @@ SWITCH_DECLARE(void) switch_img_rotate(switch_image_t **img, switch_image_rotati
 SWITCH_DECLARE(void) switch_img_free(switch_image_t **img)
 {
 #ifdef SWITCH_HAVE_VPX
+	switch_pooled_img_t *p;
+
 	if (img && *img) {
+		/* other references keep the image */
+		if ((p = pooled_img(*img)) && switch_atomic_dec(&p->refs)) {
+			*img = NULL;
+			return;
+		}
+
 		if ((*img)->fmt == SWITCH_IMG_FMT_GD) {
 #ifdef HAVE_LIBGD
 			gdImageDestroy((gdImagePtr)(*img)->user_priv);
@@ -308,7 +657,13 @@ SWITCH_DECLARE(void) switch_img_free(switch_image_t **img)
 		switch_assert((*img)->fmt <= SWITCH_IMG_FMT_I44016);
 		switch_assert((*img)->d_w <= 7860 && (*img)->d_w > 0);
 		switch_assert((*img)->d_h <= 4320 && (*img)->d_h > 0);
-		vpx_img_free((vpx_image_t *)*img);
+
+		if (p) {
+			p->img.user_priv = NULL;
+			img_pool_put(p);
+		} else {
+			vpx_img_free((vpx_image_t *)*img);
+		}
 		*img = NULL;
 	}
 #endif
@@ -438,6 +793,68 @@ SWITCH_DECLARE(void) switch_img_patch_rgb(switch_image_t *IMG, switch_image_t *i
 #endif
 }
 
+#ifdef SWITCH_HAVE_YUV
+/* blend the w x h area at xoff, yoff of the ARGB img onto the I420 IMG at x, y (both even) with libyuv,
+ * alpha < 0 keeps the alpha of img, otherwise every visible pixel of img is blended with that alpha */
+/* scratch I420 for img_blend_argb(), rounded up so blends of nearby sizes share a pool bucket */
+static switch_image_t *img_blend_scratch(int w, int h)
+{
+	return switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, (w + 63) & ~63, (h + 63) & ~63, 1);
+}
+
+static switch_bool_t img_blend_argb(switch_image_t *IMG, switch_image_t *img, int x, int y, int xoff, int yoff, int w, int h, int alpha)
+{
+	switch_image_t *fg, *a;
+	const uint8_t *src;
+	int src_stride;
+
+	if (((x | y) & 1) || w <= 0 || h <= 0) return SWITCH_FALSE;
+
+	fg = img_blend_scratch(w, h);
+	a = img_blend_scratch(w, h);
+	src_stride = img->stride[SWITCH_PLANE_PACKED];
+	src = img->planes[SWITCH_PLANE_PACKED] + yoff * src_stride + xoff * 4;
+
+	ARGBToI420(src, src_stride,
+			   fg->planes[SWITCH_PLANE_Y], fg->stride[SWITCH_PLANE_Y],
+			   fg->planes[SWITCH_PLANE_U], fg->stride[SWITCH_PLANE_U],
+			   fg->planes[SWITCH_PLANE_V], fg->stride[SWITCH_PLANE_V],
+			   w, h);
+
+	/* the Y plane of a is the alpha plane */
+	ARGBExtractAlpha(src, src_stride, a->planes[SWITCH_PLANE_Y], a->stride[SWITCH_PLANE_Y], w, h);
+
+	if (alpha >= 0) {
+		int i, j;
+
+		for (i = 0; i < h; i++) {
+			uint8_t *row = a->planes[SWITCH_PLANE_Y] + i * a->stride[SWITCH_PLANE_Y];
+
+			for (j = 0; j < w; j++) {
+				row[j] = row[j] ? (uint8_t)alpha : 0;
+			}
+		}
+	}
+
+	I420Blend(fg->planes[SWITCH_PLANE_Y], fg->stride[SWITCH_PLANE_Y],
+			  fg->planes[SWITCH_PLANE_U], fg->stride[SWITCH_PLANE_U],
+			  fg->planes[SWITCH_PLANE_V], fg->stride[SWITCH_PLANE_V],
+			  IMG->planes[SWITCH_PLANE_Y] + y * IMG->stride[SWITCH_PLANE_Y] + x, IMG->stride[SWITCH_PLANE_Y],
+			  IMG->planes[SWITCH_PLANE_U] + (y / 2) * IMG->stride[SWITCH_PLANE_U] + x / 2, IMG->stride[SWITCH_PLANE_U],
+			  IMG->planes[SWITCH_PLANE_V] + (y / 2) * IMG->stride[SWITCH_PLANE_V] + x / 2, IMG->stride[SWITCH_PLANE_V],
+			  a->planes[SWITCH_PLANE_Y], a->stride[SWITCH_PLANE_Y],
+			  IMG->planes[SWITCH_PLANE_Y] + y * IMG->stride[SWITCH_PLANE_Y] + x, IMG->stride[SWITCH_PLANE_Y],
+			  IMG->planes[SWITCH_PLANE_U] + (y / 2) * IMG->stride[SWITCH_PLANE_U] + x / 2, IMG->stride[SWITCH_PLANE_U],
+			  IMG->planes[SWITCH_PLANE_V] + (y / 2) * IMG->stride[SWITCH_PLANE_V] + x / 2, IMG->stride[SWITCH_PLANE_V],
+			  w, h);
+
+	switch_img_free(&fg);
+	switch_img_free(&a);
+
+	return SWITCH_TRUE;
+}
+#endif
+
 SWITCH_DECLARE(void) switch_img_patch(switch_image_t *IMG, switch_image_t *img, int x, int y)
 {
 	int i, len, max_h;
@@ -457,6 +874,17 @@ SWITCH_DECLARE(void) switch_img_patch(switch_image_t *IMG, switch_image_t *img,
 		uint8_t alpha;
 		switch_rgb_color_t *rgb;
 
+#ifdef SWITCH_HAVE_YUV
+		xoff = x < 0 ? -x : 0;
+		yoff = y < 0 ? -y : 0;
+
+		if (img_blend_argb(IMG, img, x + xoff, y + yoff, xoff, yoff,
+						   MIN((int)img->d_w - xoff, (int)IMG->d_w - (x + xoff)), MIN((int)img->d_h - yoff, (int)IMG->d_h - (y + yoff)), -1)) {
+			return;
+		}
+		/* odd positions are blended a pixel at a time */
+#endif
+
 		for (i = 0; i < max_h; i++) {
 			for (j = 0; j < max_w; j++) {
 				rgb = (switch_rgb_color_t *)(img->planes[SWITCH_PLANE_PACKED] + i * img->stride[SWITCH_PLANE_PACKED] + j * 4);
@@ -1576,7 +2004,7 @@ SWITCH_DECLARE(void) switch_img_gray(switch_image_t *img, int x, int y, int w, i
 SWITCH_DECLARE(void) switch_img_fill(switch_image_t *img, int x, int y, int w, int h, switch_rgb_color_t *color)
 {
 #ifdef SWITCH_HAVE_YUV
-	int len, i, max_h;
+	int len, max_h;
 	switch_yuv_color_t yuv_color;
 
 	if (x < 0 || y < 0 || x >= img->d_w || y >= img->d_h) return;
@@ -1589,29 +2017,22 @@ SWITCH_DECLARE(void) switch_img_fill(switch_image_t *img, int x, int y, int w, i
 
 		if (x & 1) { x++; len--; }
 		if (y & 1) y++;
-		if (len <= 0) return;
-
-		for (i = y; i < max_h; i++) {
-			memset(img->planes[SWITCH_PLANE_Y] + img->stride[SWITCH_PLANE_Y] * i + x, yuv_color.y, len);
-		}
-
-		if ((len & 1) && (x + len) < img->d_w - 1) len++;
+		if (len <= 0 || max_h <= y) return;
 
-		len /= 2;
-
-		for (i = y; i < max_h; i += 2) {
-			memset(img->planes[SWITCH_PLANE_U] + img->stride[SWITCH_PLANE_U] * (i / 2) + x / 2, yuv_color.u, len);
-			memset(img->planes[SWITCH_PLANE_V] + img->stride[SWITCH_PLANE_V] * (i / 2) + x / 2, yuv_color.v, len);
-		}
+		I420Rect(img->planes[SWITCH_PLANE_Y], img->stride[SWITCH_PLANE_Y],
+				 img->planes[SWITCH_PLANE_U], img->stride[SWITCH_PLANE_U],
+				 img->planes[SWITCH_PLANE_V], img->stride[SWITCH_PLANE_V],
+				 x, y, len, max_h - y, yuv_color.y, yuv_color.u, yuv_color.v);
 	} else if (img->fmt == SWITCH_IMG_FMT_ARGB) {
-		for (i = 0; i < img->d_w; i++) {
-			*((switch_rgb_color_t *)img->planes[SWITCH_PLANE_PACKED] + i) = *color;
-		}
+		uint32_t value;
 
-		for (i = 1; i < img->d_h; i++) {
-			memcpy( img->planes[SWITCH_PLANE_PACKED] + i * img->d_w * 4,
-					img->planes[SWITCH_PLANE_PACKED], img->d_w * 4);
-		}
+		max_h = MIN(y + h, img->d_h);
+		len = MIN(w, img->d_w - x);
+		if (len <= 0 || max_h <= y) return;
+
+		/* same bytes as the color struct, whatever the byte order */
+		memcpy(&value, color, sizeof(value));
+		ARGBRect(img->planes[SWITCH_PLANE_PACKED], img->stride[SWITCH_PLANE_PACKED], x, y, len, max_h - y, value);
 	}
 #endif
 }
@@ -1671,6 +2092,26 @@ SWITCH_DECLARE(void) switch_img_overlay(switch_image_t *IMG, switch_image_t *img
 	if (y & 1) y++;
 	if (len <= 0) return;
 
+#ifdef SWITCH_HAVE_YUV
+	if (img->fmt == SWITCH_IMG_FMT_ARGB && img_blend_argb(IMG, img, x, y, xoff, yoff, len, max_h - y, alpha)) {
+		return;
+	}
+
+	if (img->fmt == SWITCH_IMG_FMT_I420 && !((xoff | yoff) & 1) && max_h > y) {
+		I420Interpolate(IMG->planes[SWITCH_PLANE_Y] + y * IMG->stride[SWITCH_PLANE_Y] + x, IMG->stride[SWITCH_PLANE_Y],
+						IMG->planes[SWITCH_PLANE_U] + (y / 2) * IMG->stride[SWITCH_PLANE_U] + x / 2, IMG->stride[SWITCH_PLANE_U],
+						IMG->planes[SWITCH_PLANE_V] + (y / 2) * IMG->stride[SWITCH_PLANE_V] + x / 2, IMG->stride[SWITCH_PLANE_V],
+						img->planes[SWITCH_PLANE_Y] + yoff * img->stride[SWITCH_PLANE_Y] + xoff, img->stride[SWITCH_PLANE_Y],
+						img->planes[SWITCH_PLANE_U] + (yoff / 2) * img->stride[SWITCH_PLANE_U] + xoff / 2, img->stride[SWITCH_PLANE_U],
+						img->planes[SWITCH_PLANE_V] + (yoff / 2) * img->stride[SWITCH_PLANE_V] + xoff / 2, img->stride[SWITCH_PLANE_V],
+						IMG->planes[SWITCH_PLANE_Y] + y * IMG->stride[SWITCH_PLANE_Y] + x, IMG->stride[SWITCH_PLANE_Y],
+						IMG->planes[SWITCH_PLANE_U] + (y / 2) * IMG->stride[SWITCH_PLANE_U] + x / 2, IMG->stride[SWITCH_PLANE_U],
+						IMG->planes[SWITCH_PLANE_V] + (y / 2) * IMG->stride[SWITCH_PLANE_V] + x / 2, IMG->stride[SWITCH_PLANE_V],
+						len, max_h - y, alpha);
+		return;
+	}
+#endif
+
 	for (i = y; i < max_h; i++) {
 		for (j = 0; j < len; j++) {
 			switch_img_get_rgb_pixel(IMG, &RGB, x + j, i);
@@ -59,6 +59,41 @@ struct switch_event_node {
 	struct switch_event_node *next;
 };
 
+/*! \brief An immutable set of headers linked into several events */
+struct switch_event_shared_s {
+	switch_event_t *event;
+	switch_atomic_t refs;
+};
+
+#define SHARED_HEAD(_e) ((_e)->shared ? (_e)->shared->event->headers : NULL)
+
+/* the header after hp (the first one for NULL) in the order the headers were added. The shared set is chained
+   at the end of event->headers but belongs after shared_after, private headers added since then follow it. */
+static switch_event_header_t *event_walk_next(switch_event_t *event, switch_event_header_t *hp)
+{
+	switch_event_header_t *shared_head = SHARED_HEAD(event), *suffix;
+
+	if (!shared_head) {
+		return hp ? hp->next : event->headers;
+	}
+
+	if (!hp) {
+		return event->shared_after ? event->headers : shared_head;
+	}
+
+	if (hp == event->shared_after) {
+		return shared_head;
+	}
+
+	if (!hp->next) {
+		/* end of the shared set, on to the private headers added after it */
+		suffix = event->shared_after ? event->shared_after->next : event->headers;
+		return suffix == shared_head ? NULL : suffix;
+	}
+
+	return hp->next == shared_head ? NULL : hp->next;
+}
+
 /*! \brief A registered custom event subclass  */
 struct switch_event_subclass {
 	/*! the owner of the subclass */
@@ -796,6 +831,196 @@ SWITCH_DECLARE(switch_status_t) switch_event_set_priority(switch_event_t *event,
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void event_index_rebuild(switch_event_t *event)
+{
+	switch_event_header_t *hp, *shared_head = SHARED_HEAD(event);
+
+	switch_core_hash_destroy(&event->header_index);
+	switch_core_hash_init_nocase(&event->header_index);
+
+	/* shared headers are looked up in the index of their own set */
+	for (hp = event->headers; hp && hp != shared_head; hp = hp->next) {
+		if (!switch_core_hash_find(event->header_index, hp->name)) {
+			switch_core_hash_insert(event->header_index, hp->name, hp);
+		}
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_index_headers(switch_event_t *event)
+{
+	switch_assert(event);
+
+	if (!event->header_index) {
+		switch_core_hash_init_nocase(&event->header_index);
+		event_index_rebuild(event);
+	}
+
+	return event->header_index ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+}
+
+SWITCH_DECLARE(switch_event_shared_t *) switch_event_share(switch_event_t **event)
+{
+	switch_event_shared_t *shared;
+
+	switch_assert(event && *event);
+
+	switch_event_unshare(*event);
+	switch_event_index_headers(*event);
+
+	switch_zmalloc(shared, sizeof(*shared));
+	shared->event = *event;
+	switch_atomic_set(&shared->refs, 1);
+	*event = NULL;
+
+	return shared;
+}
+
+SWITCH_DECLARE(switch_event_shared_t *) switch_event_shared_ref(switch_event_shared_t *shared)
+{
+	switch_assert(shared);
+	switch_atomic_inc(&shared->refs);
+	return shared;
+}
+
+SWITCH_DECLARE(void) switch_event_shared_release(switch_event_shared_t **sharedP)
+{
+	switch_event_shared_t *shared;
+
+	if (!sharedP || !(shared = *sharedP)) {
+		return;
+	}
+
+	*sharedP = NULL;
+
+	if (!switch_atomic_dec(&shared->refs)) {
+		switch_event_destroy(&shared->event);
+		free(shared);
+	}
+}
+
+SWITCH_DECLARE(switch_event_header_t *) switch_event_shared_headers(switch_event_shared_t *shared)
+{
+	return shared ? shared->event->headers : NULL;
+}
+
+SWITCH_DECLARE(const char *) switch_event_shared_get_header(switch_event_shared_t *shared, const char *header_name)
+{
+	return shared ? switch_event_get_header(shared->event, header_name) : NULL;
+}
+
+SWITCH_DECLARE(void) switch_event_link_shared(switch_event_t *event, switch_event_shared_t *shared)
+{
+	switch_assert(event && shared);
+
+	if (event->shared) {
+		switch_event_unshare(event);
+	}
+
+	if (switch_test_flag(event, EF_UNIQ_HEADERS)) {
+		switch_event_header_t *hp, *lp = NULL, *next;
+
+		/* the shared value wins like it would have when added with switch_event_add_header */
+		for (hp = event->headers; hp; hp = next) {
+			next = hp->next;
+
+			if (switch_event_get_header_ptr(shared->event, hp->name)) {
+				if (lp) {
+					lp->next = next;
+				} else {
+					event->headers = next;
+				}
+				if (hp == event->last_header) {
+					event->last_header = lp;
+				}
+				if (event->header_index) {
+					switch_core_hash_delete(event->header_index, hp->name);
+				}
+				free_header(&hp);
+				continue;
+			}
+
+			lp = hp;
+		}
+	}
+
+	event->shared = switch_event_shared_ref(shared);
+	event->shared_after = event->last_header;
+
+	if (event->last_header) {
+		event->last_header->next = shared->event->headers;
+	} else {
+		event->headers = shared->event->headers;
+	}
+}
+
+SWITCH_DECLARE(void) switch_event_unshare(switch_event_t *event)
+{
+	switch_event_shared_t *shared;
+	switch_event_header_t *hp, *suffix, *suffix_last = NULL;
+
+	if (!(shared = event->shared)) {
+		return;
+	}
+
+	event->shared = NULL;
+
+	/* set the private headers added after the link aside so the copies land where the set was */
+	suffix = event->shared_after ? event->shared_after->next : event->headers;
+	if (suffix == shared->event->headers) {
+		suffix = NULL;
+	} else {
+		suffix_last = event->last_header;
+		suffix_last->next = NULL;
+	}
+
+	if ((event->last_header = event->shared_after)) {
+		event->last_header->next = NULL;
+	} else {
+		event->headers = NULL;
+	}
+	event->shared_after = NULL;
+
+	if (suffix && event->header_index) {
+		event_index_rebuild(event);
+	}
+
+	for (hp = shared->event->headers; hp; hp = hp->next) {
+		if (hp->idx) {
+			int i;
+
+			for (i = 0; i < hp->idx; i++) {
+				switch_event_add_header_string(event, SWITCH_STACK_PUSH, hp->name, hp->array[i]);
+			}
+		} else {
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, hp->name, hp->value);
+		}
+	}
+
+	if (suffix) {
+		if (event->last_header) {
+			event->last_header->next = suffix;
+		} else {
+			event->headers = suffix;
+		}
+		event->last_header = suffix_last;
+
+		if (event->header_index) {
+			event_index_rebuild(event);
+		}
+	}
+
+	switch_event_shared_release(&event->shared_held);
+	event->shared_held = shared;
+}
+
+/* a change to a header that lives in the shared set needs private copies first */
+static void event_unshare_header(switch_event_t *event, const char *header_name)
+{
+	if (event->shared && switch_event_get_header_ptr(event->shared->event, header_name)) {
+		switch_event_unshare(event);
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_event_rename_header(switch_event_t *event, const char *header_name, const char *new_header_name)
 {
 	switch_event_header_t *hp;
@@ -809,9 +1034,11 @@ SWITCH_DECLARE(switch_status_t) switch_event_rename_header(switch_event_t *event
 		return SWITCH_STATUS_FALSE;
 	}
 
+	event_unshare_header(event, header_name);
+
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
 
-	for (hp = event->headers; hp; hp = hp->next) {
+	for (hp = event_walk_next(event, NULL); hp; hp = event_walk_next(event, hp)) {
 		if ((!hp->hash || hash == hp->hash) && !strcasecmp(hp->name, header_name)) {
 			FREE(hp->name);
 			hp->name = DUP(new_header_name);
@@ -821,6 +1048,10 @@ SWITCH_DECLARE(switch_status_t) switch_event_rename_header(switch_event_t *event
 		}
 	}
 
+	if (x && event->header_index) {
+		event_index_rebuild(event);
+	}
+
 	return x ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
 }
 
@@ -836,9 +1067,17 @@ SWITCH_DECLARE(switch_event_header_t *) switch_event_get_header_ptr(switch_event
 	if (!header_name)
 		return NULL;
 
+	if (event->header_index) {
+		if ((hp = (switch_event_header_t *) switch_core_hash_find(event->header_index, header_name))) {
+			return hp;
+		}
+
+		return event->shared ? switch_event_get_header_ptr(event->shared->event, header_name) : NULL;
+	}
+
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
 
-	for (hp = event->headers; hp; hp = hp->next) {
+	for (hp = event_walk_next(event, NULL); hp; hp = event_walk_next(event, hp)) {
 		if ((!hp->hash || hash == hp->hash) && !strcasecmp(hp->name, header_name)) {
 			return hp;
 		}
@@ -874,34 +1113,58 @@ SWITCH_DECLARE(char *) switch_event_get_body(switch_event_t *event)
 
 SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *event, const char *header_name, const char *val)
 {
-	switch_event_header_t *hp, *lp = NULL, *tp;
+	switch_event_header_t *hp, *lp = NULL, *tp, *first = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	int x = 0;
 	switch_ssize_t hlen = -1;
 	unsigned long hash = 0;
 
+	event_unshare_header(event, header_name);
+
+	if (event->header_index && !switch_core_hash_find(event->header_index, header_name)) {
+		return status;
+	}
+
 	tp = event->headers;
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
-	while (tp) {
+	while (tp && tp != SHARED_HEAD(event)) {
 		hp = tp;
 		tp = tp->next;
 
 		x++;
 		switch_assert(x < 1000000);
 
-		if ((!hp->hash || hash == hp->hash) && !strcasecmp(header_name, hp->name) && (zstr(val) || !strcmp(hp->value, val))) {
-			if (lp) {
-				lp->next = hp->next;
-			} else {
-				event->headers = hp->next;
+		if ((!hp->hash || hash == hp->hash) && !strcasecmp(header_name, hp->name)) {
+			if (zstr(val) || !strcmp(hp->value, val)) {
+				if (lp) {
+					lp->next = hp->next;
+				} else {
+					event->headers = hp->next;
+				}
+				if (hp == event->last_header || !hp->next) {
+					event->last_header = lp;
+				}
+				if (hp == event->shared_after) {
+					event->shared_after = lp;
+				}
+				free_header(&hp);
+				status = SWITCH_STATUS_SUCCESS;
+				continue;
 			}
-			if (hp == event->last_header || !hp->next) {
-				event->last_header = lp;
+
+			if (!first) {
+				first = hp;
 			}
-			free_header(&hp);
-			status = SWITCH_STATUS_SUCCESS;
+		}
+
+		lp = hp;
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS && event->header_index) {
+		if (first) {
+			switch_core_hash_insert(event->header_index, header_name, first);
 		} else {
-			lp = hp;
+			switch_core_hash_delete(event->header_index, header_name);
 		}
 	}
 
@@ -1045,6 +1308,11 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 
 		if (header || (header = switch_event_get_header_ptr(event, header_name))) {
 
+			if (!fly && event->shared && header == switch_event_get_header_ptr(event->shared->event, header_name)) {
+				switch_event_unshare(event);
+				header = switch_event_get_header_ptr(event, header_name);
+			}
+
 			if (index_ptr) {
 				if (index > -1 && index <= 4000) {
 					if (index < header->idx) {
@@ -1192,15 +1460,22 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 			if (!event->last_header) {
 				event->last_header = header;
 			}
+			if (event->shared && !event->shared_after) {
+				event->shared_after = header;
+			}
 		} else {
+			header->next = SHARED_HEAD(event);
 			if (event->last_header) {
 				event->last_header->next = header;
 			} else {
 				event->headers = header;
-				header->next = NULL;
 			}
 			event->last_header = header;
 		}
+
+		if (event->header_index && ((stack & SWITCH_STACK_TOP) || !switch_core_hash_find(event->header_index, header->name))) {
+			switch_core_hash_insert(event->header_index, header->name, header);
+		}
 	}
 
  end:
@@ -1295,11 +1570,17 @@ SWITCH_DECLARE(void) switch_event_destroy(switch_event_t **event)
 	switch_event_header_t *hp, *this;
 
 	if (ep) {
-		for (hp = ep->headers; hp;) {
+		if (ep->header_index) {
+			switch_core_hash_destroy(&ep->header_index);
+		}
+
+		for (hp = ep->headers; hp && hp != SHARED_HEAD(ep);) {
 			this = hp;
 			hp = hp->next;
 			free_header(&this);
 		}
+		switch_event_shared_release(&ep->shared);
+		switch_event_shared_release(&ep->shared_held);
 		FREE(ep->body);
 		FREE(ep->subclass_name);
 #ifdef SWITCH_EVENT_RECYCLE
@@ -1321,7 +1602,7 @@ SWITCH_DECLARE(void) switch_event_merge(switch_event_t *event, switch_event_t *t
 
 	switch_assert(tomerge && event);
 
-	for (hp = tomerge->headers; hp; hp = hp->next) {
+	for (hp = event_walk_next(tomerge, NULL); hp; hp = event_walk_next(tomerge, hp)) {
 		if (hp->idx) {
 			int i;
 
@@ -1346,18 +1627,26 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup(switch_event_t **event, switch_
 	(*event)->event_user_data = todup->event_user_data;
 	(*event)->bind_user_data = todup->bind_user_data;
 	(*event)->flags = todup->flags;
-	for (hp = todup->headers; hp; hp = hp->next) {
-		if (todup->subclass_name && !strcmp(hp->name, "Event-Subclass")) {
-			continue;
-		}
 
-		if (hp->idx) {
-			int i;
-			for (i = 0; i < hp->idx; i++) {
-				switch_event_add_header_string(*event, SWITCH_STACK_PUSH, hp->name, hp->array[i]);
+	/* link the shared set at the point it sits in todup so the copy serializes in the same order */
+	if (todup->shared && !todup->shared_after) {
+		switch_event_link_shared(*event, todup->shared);
+	}
+
+	for (hp = todup->headers; hp && hp != SHARED_HEAD(todup); hp = hp->next) {
+		if (!(todup->subclass_name && !strcmp(hp->name, "Event-Subclass"))) {
+			if (hp->idx) {
+				int i;
+				for (i = 0; i < hp->idx; i++) {
+					switch_event_add_header_string(*event, SWITCH_STACK_PUSH, hp->name, hp->array[i]);
+				}
+			} else {
+				switch_event_add_header_string(*event, SWITCH_STACK_BOTTOM, hp->name, hp->value);
 			}
-		} else {
-			switch_event_add_header_string(*event, SWITCH_STACK_BOTTOM, hp->name, hp->value);
+		}
+
+		if (hp == todup->shared_after) {
+			switch_event_link_shared(*event, todup->shared);
 		}
 	}
 
@@ -1386,7 +1675,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup_reply(switch_event_t **event, s
 	(*event)->bind_user_data = todup->bind_user_data;
 	(*event)->flags = todup->flags;
 
-	for (hp = todup->headers; hp; hp = hp->next) {
+	for (hp = event_walk_next(todup, NULL); hp; hp = event_walk_next(todup, hp)) {
 		char *name = hp->name, *value = hp->value;
 
 		if (todup->subclass_name && !strcmp(hp->name, "Event-Subclass")) {
@@ -1503,7 +1792,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_binary_serialize(switch_event_t *ev
 
 	tpl_pack(tn, 0);
 
-	for (eh = event->headers; eh; eh = eh->next) {
+	for (eh = event_walk_next(event, NULL); eh; eh = event_walk_next(event, eh)) {
 		if (eh->idx) continue;  // no arrays yet
 
 		sh.name = eh->name;
@@ -1549,7 +1838,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_serialize(switch_event_t *event, ch
 	}
 
 	/* switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "hit serialized!.\n"); */
-	for (hp = event->headers; hp; hp = hp->next) {
+	for (hp = event_walk_next(event, NULL); hp; hp = event_walk_next(event, hp)) {
 		/*
 		 * grab enough memory to store 3x the string (url encode takes one char and turns it into %XX)
 		 * so we could end up with a string that is 3 times the originals length, unlikely but rather
@@ -1825,7 +2114,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_serialize_json_obj(switch_event_t *
 
 	cj = cJSON_CreateObject();
 
-	for (hp = event->headers; hp; hp = hp->next) {
+	for (hp = event_walk_next(event, NULL); hp; hp = event_walk_next(event, hp)) {
 		if (hp->idx) {
 			cJSON *a = cJSON_CreateArray();
 			int i;
@@ -1932,7 +2221,7 @@ SWITCH_DECLARE(switch_xml_t) switch_event_xmlize(switch_event_t *event, const ch
 
 	if ((xheaders = switch_xml_add_child_d(xml, "headers", off++))) {
 		int hoff = 0;
-		for (hp = event->headers; hp; hp = hp->next) {
+		for (hp = event_walk_next(event, NULL); hp; hp = event_walk_next(event, hp)) {
 
 			if (hp->idx) {
 				int i;
@@ -2858,26 +2858,29 @@ static int switch_ivr_set_xml_chan_var(switch_xml_t xml, const char *var, const
 }
 
 
+#define CHAN_VAR_PREFIX_LEN (sizeof("variable_") - 1)
+
 SWITCH_DECLARE(int) switch_ivr_set_xml_chan_vars(switch_xml_t xml, switch_channel_t *channel, int off)
 {
 
-	switch_event_header_t *hi = switch_channel_variable_first(channel);
+	switch_event_shared_t *snap = switch_channel_var_snapshot_get(channel);
+	switch_event_header_t *hi;
 
-	if (!hi)
-		return off;
+	/* the snapshot names are variable_ prefixed */
+	for (hi = switch_event_shared_headers(snap); hi; hi = hi->next) {
+		const char *name = hi->name + CHAN_VAR_PREFIX_LEN;
 
-	for (; hi; hi = hi->next) {
 		if (hi->idx) {
 			int i;
 
 			for (i = 0; i < hi->idx; i++) {
-				off = switch_ivr_set_xml_chan_var(xml, hi->name, hi->array[i], off);
+				off = switch_ivr_set_xml_chan_var(xml, name, hi->array[i], off);
 			}
 		} else {
-			off = switch_ivr_set_xml_chan_var(xml, hi->name, hi->value, off);
+			off = switch_ivr_set_xml_chan_var(xml, name, hi->value, off);
 		}
 	}
-	switch_channel_variable_last(channel);
+	switch_event_shared_release(&snap);
 
 	return off;
 }
@@ -3344,13 +3347,13 @@ SWITCH_DECLARE(void) switch_ivr_set_json_call_stats(cJSON *json, switch_core_ses
 
 static void switch_ivr_set_json_chan_vars(cJSON *json, switch_channel_t *channel, switch_bool_t urlencode)
 {
-	switch_event_header_t *hi = switch_channel_variable_first(channel);
+	switch_event_shared_t *snap = switch_channel_var_snapshot_get(channel);
+	switch_event_header_t *hi;
 
-	if (!hi)
-		return;
+	for (hi = switch_event_shared_headers(snap); hi; hi = hi->next) {
+		const char *name = hi->name + CHAN_VAR_PREFIX_LEN;
 
-	for (; hi; hi = hi->next) {
-		if (!zstr(hi->name) && !zstr(hi->value)) {
+		if (!zstr(name) && !zstr(hi->value)) {
 			char *data = hi->value;
 			if (urlencode) {
 				switch_size_t dlen = strlen(hi->value) * 3;
@@ -3361,14 +3364,14 @@ static void switch_ivr_set_json_chan_vars(cJSON *json, switch_channel_t *channel
 				}
 			}
 
-			cJSON_AddItemToObject(json, hi->name, cJSON_CreateString(data));
+			cJSON_AddItemToObject(json, name, cJSON_CreateString(data));
 
 			if (data != hi->value) {
 				switch_safe_free(data);
 			}
 		}
 	}
-	switch_channel_variable_last(channel);
+	switch_event_shared_release(&snap);
 }
 
 
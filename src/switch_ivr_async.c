@@ -1182,6 +1182,18 @@ struct record_helper {
 	switch_event_t *variables;
 	switch_mutex_t *cond_mutex;
 	switch_thread_cond_t *cond;
+	/* shared writer pool state, see record_writer_push() */
+	int pooled;
+	int queued;
+	int busy;
+	int closing;
+	int write_failed;
+	switch_size_t queue_bytes;
+	uint32_t frame_bytes;
+	uint32_t bytes_per_ms;
+	switch_time_t pending_since;
+	switch_time_t enqueued_at;
+	struct record_helper *next_ready;
 };
 
 static switch_status_t record_helper_destroy(struct record_helper **rh, switch_core_session_t *session);
@@ -1331,6 +1343,386 @@ static void send_record_error_event(switch_channel_t *channel, const char* file,
 	}
 }
 
+#define RECORD_WRITERS_MAX 64
+
+/* Shared recording writer pool: the media thread appends to a bounded per-recording queue and hands the
+   recording to the pool once a block is ready (or its oldest audio is flush_ms old).  Writers call into the
+   format module, so encoding happens on them too, and never touch the session. */
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_thread_cond_t *idle_cond;
+	switch_thread_t *threads[RECORD_WRITERS_MAX];
+	struct record_helper *ready_head;
+	struct record_helper *ready_tail;
+	uint32_t nthreads;
+	int running;
+	uint32_t queue_ms;
+	switch_size_t block_bytes;
+	uint32_t flush_ms;
+	switch_record_backpressure_t policy;
+	switch_record_writer_stats_t stats;
+} record_writers;
+
+/* call with record_writers.mutex held */
+static void record_writer_ready(struct record_helper *rh)
+{
+	if (rh->queued || rh->busy || !record_writers.running) {
+		return;
+	}
+
+	rh->queued = 1;
+	rh->next_ready = NULL;
+	rh->enqueued_at = switch_micro_time_now();
+
+	if (record_writers.ready_tail) {
+		record_writers.ready_tail->next_ready = rh;
+	} else {
+		record_writers.ready_head = rh;
+	}
+
+	record_writers.ready_tail = rh;
+	record_writers.stats.ready++;
+	switch_thread_cond_signal(record_writers.cond);
+}
+
+/* write everything queued for rh, in blocks */
+static void record_writer_drain(struct record_helper *rh, uint8_t *block, switch_size_t block_len)
+{
+	switch_size_t want = block_len - (block_len % rh->frame_bytes), got, samples;
+	uint64_t blocks = 0, bytes = 0, errors = 0;
+	uint32_t backlog_ms = 0;
+
+	switch_mutex_lock(rh->buffer_mutex);
+	if (rh->bytes_per_ms) {
+		backlog_ms = (uint32_t) (switch_buffer_inuse(rh->thread_buffer) / rh->bytes_per_ms);
+	}
+	switch_mutex_unlock(rh->buffer_mutex);
+
+	for (;;) {
+		switch_mutex_lock(rh->buffer_mutex);
+		if (!(got = switch_buffer_read(rh->thread_buffer, block, want))) {
+			rh->pending_since = 0;
+		}
+		switch_mutex_unlock(rh->buffer_mutex);
+
+		if (!got) {
+			break;
+		}
+
+		samples = got / rh->frame_bytes;
+
+		if (rh->write_failed) {
+			/* keep draining so the media thread never waits on a dead file */
+			continue;
+		}
+
+		if (switch_core_file_write(rh->fh, block, &samples) != SWITCH_STATUS_SUCCESS) {
+			rh->write_failed = 1;
+			errors++;
+			continue;
+		}
+
+		blocks++;
+		bytes += got;
+	}
+
+	switch_mutex_lock(record_writers.mutex);
+	record_writers.stats.blocks += blocks;
+	record_writers.stats.bytes += bytes;
+	record_writers.stats.write_errors += errors;
+	if (backlog_ms > record_writers.stats.max_backlog_ms) {
+		record_writers.stats.max_backlog_ms = backlog_ms;
+	}
+	switch_mutex_unlock(record_writers.mutex);
+}
+
+static void *SWITCH_THREAD_FUNC record_writer_thread(switch_thread_t *thread, void *obj)
+{
+	switch_size_t block_len = record_writers.block_bytes;
+	uint8_t *block = malloc(block_len);
+
+	switch_assert(block);
+
+	switch_mutex_lock(record_writers.mutex);
+
+	while (record_writers.running || record_writers.ready_head) {
+		struct record_helper *rh;
+		uint32_t lag_ms;
+
+		if (!(rh = record_writers.ready_head)) {
+			switch_thread_cond_wait(record_writers.cond, record_writers.mutex);
+			continue;
+		}
+
+		if (!(record_writers.ready_head = rh->next_ready)) {
+			record_writers.ready_tail = NULL;
+		}
+
+		rh->next_ready = NULL;
+		rh->queued = 0;
+		rh->busy = 1;
+		record_writers.stats.ready--;
+
+		lag_ms = (uint32_t) ((switch_micro_time_now() - rh->enqueued_at) / 1000);
+		record_writers.stats.lag_ms = lag_ms;
+		if (lag_ms > record_writers.stats.max_lag_ms) {
+			record_writers.stats.max_lag_ms = lag_ms;
+		}
+
+		if (block_len < record_writers.block_bytes) {
+			void *mem = realloc(block, record_writers.block_bytes);
+			switch_assert(mem);
+			block = mem;
+			block_len = record_writers.block_bytes;
+		}
+
+		switch_mutex_unlock(record_writers.mutex);
+
+		record_writer_drain(rh, block, block_len);
+
+		switch_mutex_lock(record_writers.mutex);
+		rh->busy = 0;
+		if (rh->closing) {
+			switch_thread_cond_broadcast(record_writers.idle_cond);
+		}
+	}
+
+	switch_mutex_unlock(record_writers.mutex);
+
+	free(block);
+
+	return NULL;
+}
+
+/* hook a recording up to the pool, called from SWITCH_ABC_TYPE_INIT */
+static switch_bool_t record_writer_attach(struct record_helper *rh, uint32_t channels)
+{
+	switch_mutex_lock(record_writers.mutex);
+
+	if (!record_writers.running) {
+		switch_mutex_unlock(record_writers.mutex);
+		return SWITCH_FALSE;
+	}
+
+	rh->frame_bytes = 2 * channels;
+	rh->bytes_per_ms = rh->frame_bytes * (rh->read_impl.actual_samples_per_second / 1000);
+	rh->queue_bytes = (switch_size_t) record_writers.queue_ms * rh->bytes_per_ms;
+
+	if (rh->queue_bytes < record_writers.block_bytes) {
+		/* always room for a full block plus what arrives while it is written */
+		rh->queue_bytes = record_writers.block_bytes * 2;
+	}
+
+	rh->pooled = 1;
+	record_writers.stats.recordings++;
+	switch_mutex_unlock(record_writers.mutex);
+
+	switch_mutex_init(&rh->buffer_mutex, SWITCH_MUTEX_NESTED, rh->helper_pool);
+	switch_buffer_create_dynamic(&rh->thread_buffer, SWITCH_RECOMMENDED_BUFFER_SIZE * 8, SWITCH_RECOMMENDED_BUFFER_SIZE * 8, 0);
+
+	return SWITCH_TRUE;
+}
+
+/* queue audio from the media thread, applying the backpressure policy when the queue is full */
+static void record_writer_push(struct record_helper *rh, const void *data, switch_size_t datalen)
+{
+	switch_time_t now = switch_micro_time_now();
+	switch_size_t inuse;
+	int ready, waited = 0;
+
+	switch_mutex_lock(rh->buffer_mutex);
+
+	while ((inuse = switch_buffer_inuse(rh->thread_buffer)) + datalen > rh->queue_bytes) {
+		if (record_writers.policy != SWITCH_RECORD_BACKPRESSURE_WAIT || waited >= (int) (rh->read_impl.microseconds_per_packet / 1000)) {
+			switch_mutex_unlock(rh->buffer_mutex);
+
+			switch_mutex_lock(record_writers.mutex);
+			record_writers.stats.drops++;
+			record_writers.stats.dropped_bytes += datalen;
+			record_writer_ready(rh);
+			switch_mutex_unlock(record_writers.mutex);
+			return;
+		}
+
+		switch_mutex_unlock(rh->buffer_mutex);
+		switch_yield(1000);
+		waited++;
+		switch_mutex_lock(rh->buffer_mutex);
+	}
+
+	switch_buffer_write(rh->thread_buffer, data, datalen);
+	inuse += datalen;
+
+	if (!rh->pending_since) {
+		rh->pending_since = now;
+	}
+
+	ready = inuse >= record_writers.block_bytes || (now - rh->pending_since) >= (switch_time_t) record_writers.flush_ms * 1000;
+
+	switch_mutex_unlock(rh->buffer_mutex);
+
+	if (ready) {
+		switch_mutex_lock(record_writers.mutex);
+		record_writer_ready(rh);
+		switch_mutex_unlock(record_writers.mutex);
+	}
+}
+
+/* flush and unhook a recording, called from SWITCH_ABC_TYPE_CLOSE before the file is closed */
+static void record_writer_detach(struct record_helper *rh)
+{
+	switch_size_t inuse;
+
+	switch_mutex_lock(record_writers.mutex);
+
+	rh->closing = 1;
+
+	if (switch_buffer_inuse(rh->thread_buffer)) {
+		record_writer_ready(rh);
+	}
+
+	while (rh->queued || rh->busy) {
+		switch_thread_cond_timedwait(record_writers.idle_cond, record_writers.mutex, 100000);
+	}
+
+	record_writers.stats.recordings--;
+	switch_mutex_unlock(record_writers.mutex);
+
+	switch_mutex_lock(rh->buffer_mutex);
+	inuse = switch_buffer_inuse(rh->thread_buffer);
+	switch_mutex_unlock(rh->buffer_mutex);
+
+	if (inuse) {
+		/* the pool is stopping, write what it did not get to from here */
+		uint8_t *block = malloc(inuse);
+
+		switch_assert(block);
+		record_writer_drain(rh, block, inuse);
+		free(block);
+	}
+
+	rh->pooled = 0;
+	switch_buffer_destroy(&rh->thread_buffer);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_ivr_record_writers_start(uint32_t threads, uint32_t queue_ms, switch_size_t block_bytes, uint32_t flush_ms,
+																 switch_record_backpressure_t policy)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i;
+
+	if (!block_bytes) {
+		block_bytes = 1048576;
+	}
+
+	if (!queue_ms) {
+		queue_ms = 30000;
+	}
+
+	if (!flush_ms) {
+		flush_ms = 2000;
+	}
+
+	if (record_writers.running) {
+		switch_mutex_lock(record_writers.mutex);
+		record_writers.queue_ms = queue_ms;
+		record_writers.block_bytes = block_bytes;
+		record_writers.flush_ms = flush_ms;
+		record_writers.policy = policy;
+		switch_mutex_unlock(record_writers.mutex);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!threads) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (threads > RECORD_WRITERS_MAX) {
+		threads = RECORD_WRITERS_MAX;
+	}
+
+	if (!record_writers.pool) {
+		switch_core_new_memory_pool(&record_writers.pool);
+		switch_mutex_init(&record_writers.mutex, SWITCH_MUTEX_NESTED, record_writers.pool);
+		switch_thread_cond_create(&record_writers.cond, record_writers.pool);
+		switch_thread_cond_create(&record_writers.idle_cond, record_writers.pool);
+	}
+
+	switch_mutex_lock(record_writers.mutex);
+	record_writers.queue_ms = queue_ms;
+	record_writers.block_bytes = block_bytes;
+	record_writers.flush_ms = flush_ms;
+	record_writers.policy = policy;
+	memset(&record_writers.stats, 0, sizeof(record_writers.stats));
+	record_writers.running = 1;
+	switch_mutex_unlock(record_writers.mutex);
+
+	switch_threadattr_create(&thd_attr, record_writers.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_threadattr_priority_set(thd_attr, SWITCH_PRI_LOW);
+
+	for (i = 0; i < threads; i++) {
+		if (switch_thread_create(&record_writers.threads[i], thd_attr, record_writer_thread, NULL, record_writers.pool) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+	}
+
+	switch_mutex_lock(record_writers.mutex);
+	record_writers.nthreads = record_writers.stats.threads = i;
+	switch_mutex_unlock(record_writers.mutex);
+
+	if (!i) {
+		record_writers.running = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_ivr_record_writers_stop(void)
+{
+	switch_status_t st;
+	uint32_t i, nthreads;
+
+	if (!record_writers.running) {
+		return;
+	}
+
+	switch_mutex_lock(record_writers.mutex);
+	record_writers.running = 0;
+	nthreads = record_writers.nthreads;
+	switch_thread_cond_broadcast(record_writers.cond);
+	switch_mutex_unlock(record_writers.mutex);
+
+	for (i = 0; i < nthreads; i++) {
+		switch_thread_join(&st, record_writers.threads[i]);
+		record_writers.threads[i] = NULL;
+	}
+
+	switch_mutex_lock(record_writers.mutex);
+	record_writers.nthreads = record_writers.stats.threads = 0;
+	/* recordings still attached drain themselves on close */
+	switch_thread_cond_broadcast(record_writers.idle_cond);
+	switch_mutex_unlock(record_writers.mutex);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_ivr_record_writer_stats(switch_record_writer_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if (!record_writers.running) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(record_writers.mutex);
+	*stats = record_writers.stats;
+	switch_mutex_unlock(record_writers.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static void *SWITCH_THREAD_FUNC recording_thread(switch_thread_t *thread, void *obj)
 {
 	switch_media_bug_t *bug = (switch_media_bug_t *) obj;
@@ -1535,7 +1927,10 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 			/* Required for potential record_transfer */
 			rh->bug = bug;
 			
-			if (!rh->native && rh->fh && (zstr(var) || switch_true(var))) {
+			if (!rh->native && rh->fh && (zstr(var) || switch_true(var)) &&
+				record_writer_attach(rh, switch_core_media_bug_test_flag(bug, SMBF_STEREO) ? 2 : rh->read_impl.number_of_channels)) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Recording %s through the writer pool\n", rh->file);
+			} else if (!rh->native && rh->fh && (zstr(var) || switch_true(var))) {
 				switch_threadattr_t *thd_attr = NULL;
 				int sanity = 200;
 
@@ -1684,6 +2079,10 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 				const char *file_size = NULL;
 				const char *file_trimmed = NULL;
 
+				if (rh->pooled) {
+					record_writer_detach(rh);
+				}
+
 				if (rh->thread_ready) {
 					switch_status_t st;
 
@@ -1781,6 +2180,20 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 			}
 		}
 		
+		if (rh->pooled && rh->write_failed == 1) {
+			/* reported by a pool writer, handled here where the session is ours */
+			rh->write_failed = 2;
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error writing %s\n", rh->file);
+			set_completion_cause(rh, "uri-failure");
+			if (rh->hangup_on_error) {
+				switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
+				switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
+			}
+			if (rh->stop_write_on_error) {
+				return SWITCH_FALSE;
+			}
+		}
+
 		if (rh->fh) {
 			switch_size_t len;
 			uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE];
@@ -1799,7 +2212,9 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 				} else {
 					len = (switch_size_t) frame.datalen / 2 / frame.channels;
 
-					if (rh->thread_buffer) {
+					if (rh->pooled) {
+						record_writer_push(rh, mask ? null_data : data, frame.datalen);
+					} else if (rh->thread_buffer) {
 						switch_mutex_lock(rh->buffer_mutex);
 						switch_buffer_write(rh->thread_buffer, mask ? null_data : data, frame.datalen);
 						switch_mutex_unlock(rh->buffer_mutex);
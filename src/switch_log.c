@@ -488,6 +488,64 @@ SWITCH_DECLARE(switch_status_t) switch_log_bind_logger(switch_log_function_t fun
 
 static switch_thread_t *thread;
 
+static void log_console_write(FILE *handle, switch_log_level_t level, const char *data)
+{
+	int aok = 1;
+#ifndef WIN32
+
+	fd_set can_write;
+	int fd;
+	struct timeval to;
+
+	fd = fileno(handle);
+	memset(&to, 0, sizeof(to));
+	FD_ZERO(&can_write);
+	FD_SET(fd, &can_write);
+	to.tv_sec = 0;
+	to.tv_usec = 100000;
+	if (select(fd + 1, NULL, &can_write, NULL, &to) > 0) {
+		aok = FD_ISSET(fd, &can_write);
+	} else {
+		aok = 0;
+	}
+#endif
+	if (aok) {
+		if (COLORIZE) {
+
+#ifdef WIN32
+			SetConsoleTextAttribute(hStdout, COLORS[level]);
+			WriteFile(hStdout, data, (DWORD) strlen(data), NULL, NULL);
+			SetConsoleTextAttribute(hStdout, wOldColorAttrs);
+#else
+			fprintf(handle, "%s%s%s", COLORS[level], data, SWITCH_SEQ_DEFAULT_COLOR);
+#endif
+		} else {
+			fprintf(handle, "%s", data);
+		}
+	}
+}
+
+static void log_dispatch(switch_log_node_t *node)
+{
+	switch_log_binding_t *binding;
+
+	switch_mutex_lock(BINDLOCK);
+	node->sequence = ++log_sequence;
+	for (binding = BINDINGS; binding; binding = binding->next) {
+
+		if (binding->level >= node->level) {
+
+			// If module graylog is loaded, then do not output to console
+			if (mod_graylog_loaded && binding->is_console) {
+				continue;
+			}
+
+			binding->function(node, node->level);
+		}
+	}
+	switch_mutex_unlock(BINDLOCK);
+}
+
 static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 {
 
@@ -499,7 +557,6 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 	while (THREAD_RUNNING == 1) {
 		void *pop = NULL;
 		switch_log_node_t *node = NULL;
-		switch_log_binding_t *binding;
 
 		if (switch_queue_pop(LOG_QUEUE, &pop) != SWITCH_STATUS_SUCCESS) {
 			break;
@@ -511,31 +568,1241 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 		}
 
 		node = (switch_log_node_t *) pop;
-		switch_mutex_lock(BINDLOCK);
-		node->sequence = ++log_sequence;
-		for (binding = BINDINGS; binding; binding = binding->next) {
+		log_dispatch(node);
+		switch_log_node_free(&node);
+
+	}
+
+	THREAD_RUNNING = 0;
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Logger Ended.\n");
+	return NULL;
+}
+
+/*
+ * Deferred-format log rings.
+ *
+ * Producers capture the format string and a compact copy of its arguments into a record and
+ * push it onto a bounded ring picked by thread id.  Sink threads own a subset of the rings, do
+ * the expensive formatting and call the bindings.  A full ring drops the record, producers never
+ * block.  The same record layout is what gets written to the binary log.
+ */
+
+#define LOG_RING_MAX_SPEC 64
+#define LOG_RING_BATCH 64
+#define LOG_RING_DEFAULT_SLOTS 4096
+#define LOG_BINARY_MAGIC "FSBLOG\001"
+#define LOG_BINARY_VERSION 1
+#define LOG_BINARY_BYTE_ORDER 0x01020304
+#define LOG_BINARY_MAX_RECORD (16 * 1024 * 1024)
+
+typedef enum {
+	LOG_ARG_INT = 'I',
+	LOG_ARG_UINT = 'U',
+	LOG_ARG_DOUBLE = 'D',
+	LOG_ARG_STR = 'S',
+	LOG_ARG_PTR = 'P'
+} log_arg_type_t;
+
+typedef enum {
+	LOG_MOD_NONE,
+	LOG_MOD_HH,
+	LOG_MOD_H,
+	LOG_MOD_L,
+	LOG_MOD_LL,
+	LOG_MOD_Z,
+	LOG_MOD_J,
+	LOG_MOD_T
+} log_arg_mod_t;
+
+typedef struct {
+	switch_size_t len;
+	char conv;
+	log_arg_mod_t mod;
+	int star_width;
+	int star_prec;
+	int prec;
+} log_spec_t;
+
+typedef struct {
+	switch_text_channel_t channel;
+	switch_log_level_t level;
+	switch_log_level_t slevel;
+	int line;
+	switch_time_t timestamp;
+	uint64_t timestamp_nano;
+	double idle_cpu;
+	int64_t sequence;
+	const char *file;
+	const char *func;
+	const char *userdata;
+	const char *fmt;
+	const uint8_t *args;
+	switch_size_t args_len;
+	switch_event_t *tags;
+	cJSON *meta;
+} log_record_t;
+
+typedef struct {
+	volatile switch_atomic_t seq;
+	volatile void *rec;
+} log_ring_slot_t;
+
+typedef struct {
+	volatile switch_atomic_t head;
+	uint32_t tail;
+	uint32_t mask;
+	log_ring_slot_t *slots;
+	switch_atomic_t queued;
+	switch_atomic_t dropped;
+} log_ring_t;
+
+/* on-disk layout, host byte order: a log_binary_header_t then log_binary_record_t's each followed by
+   file, func, uuid and fmt (NUL terminated, a zero length means absent) and the argument blob */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t record_size;
+	uint32_t reserved;
+} log_binary_header_t;
+
+typedef struct {
+	uint32_t size;
+	uint32_t line;
+	int64_t timestamp;
+	int64_t sequence;
+	uint32_t fmt_len;
+	uint32_t args_len;
+	uint16_t file_len;
+	uint16_t func_len;
+	uint16_t uuid_len;
+	uint16_t idle_cpu;
+	uint8_t level;
+	uint8_t channel;
+	uint16_t reserved;
+	uint32_t reserved2;
+} log_binary_record_t;
+
+typedef struct {
+	uint8_t *data;
+	switch_size_t len;
+	switch_size_t size;
+	uint8_t stack[512];
+} log_blob_t;
+
+typedef struct {
+	char *data;
+	switch_size_t len;
+	switch_size_t size;
+} log_text_t;
+
+static struct {
+	log_ring_t *rings;
+	uint32_t nrings;
+	uint32_t slots;
+	uint32_t nsinks;
+	switch_thread_t **sinks;
+	switch_atomic_t running;
+	volatile int8_t sinks_running;
+	switch_atomic_t writers;
+	switch_atomic_t deferred;
+	switch_atomic_t preformatted;
+	switch_atomic_t binary_records;
+	switch_atomic_t binary_errors;
+	switch_mutex_t *binary_mutex;
+	FILE *binary;
+	int binary_dirty;
+} LOG_RINGS;
+
+/* Parse the conversion spec at p (pointing at '%'), returns 0 for anything the deferred path can't
+   carry: positional arguments, %n, wide characters and long double */
+static int log_spec_parse(const char *p, log_spec_t *spec)
+{
+	const char *s = p + 1;
+
+	memset(spec, 0, sizeof(*spec));
+	spec->prec = -1;
+
+	while (*s && strchr("-+ #0'", *s)) {
+		s++;
+	}
+
+	if (*s == '*') {
+		spec->star_width = 1;
+		s++;
+	} else {
+		while (*s >= '0' && *s <= '9') {
+			s++;
+		}
+	}
+
+	if (*s == '$') {
+		return 0;
+	}
+
+	if (*s == '.') {
+		s++;
+		if (*s == '*') {
+			spec->star_prec = 1;
+			s++;
+		} else {
+			spec->prec = 0;
+			while (*s >= '0' && *s <= '9') {
+				spec->prec = (spec->prec * 10) + (*s - '0');
+				s++;
+			}
+		}
+	}
 
-			if (binding->level >= node->level) {
+	switch (*s) {
+	case 'h':
+		if (*++s == 'h') {
+			spec->mod = LOG_MOD_HH;
+			s++;
+		} else {
+			spec->mod = LOG_MOD_H;
+		}
+		break;
+	case 'l':
+		if (*++s == 'l') {
+			spec->mod = LOG_MOD_LL;
+			s++;
+		} else {
+			spec->mod = LOG_MOD_L;
+		}
+		break;
+	case 'z':
+		spec->mod = LOG_MOD_Z;
+		s++;
+		break;
+	case 'j':
+		spec->mod = LOG_MOD_J;
+		s++;
+		break;
+	case 't':
+		spec->mod = LOG_MOD_T;
+		s++;
+		break;
+	default:
+		break;
+	}
+
+	switch (*s) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if (spec->mod != LOG_MOD_NONE && spec->mod != LOG_MOD_L) {
+			return 0;
+		}
+		break;
+	case 'c':
+	case 's':
+	case 'p':
+	case '%':
+		if (spec->mod != LOG_MOD_NONE) {
+			return 0;
+		}
+		break;
+	default:
+		return 0;
+	}
+
+	spec->conv = *s;
+	spec->len = (switch_size_t) (s + 1 - p);
+
+	return spec->len < LOG_RING_MAX_SPEC;
+}
+
+static void log_blob_grow(log_blob_t *blob, switch_size_t need)
+{
+	if (!blob->data) {
+		blob->data = blob->stack;
+		blob->size = sizeof(blob->stack);
+	}
+
+	if (blob->len + need > blob->size) {
+		switch_size_t size = blob->size;
+
+		while (blob->len + need > size) {
+			size *= 2;
+		}
+
+		if (blob->data == blob->stack) {
+			blob->data = malloc(size);
+			switch_assert(blob->data);
+			memcpy(blob->data, blob->stack, blob->len);
+		} else {
+			blob->data = realloc(blob->data, size);
+			switch_assert(blob->data);
+		}
+		blob->size = size;
+	}
+}
+
+static void log_blob_put(log_blob_t *blob, log_arg_type_t type, const void *val)
+{
+	log_blob_grow(blob, 9);
+	blob->data[blob->len++] = (uint8_t) type;
+	memcpy(blob->data + blob->len, val, 8);
+	blob->len += 8;
+}
+
+static void log_blob_put_str(log_blob_t *blob, const char *str, uint32_t len)
+{
+	log_blob_grow(blob, len + 6);
+	blob->data[blob->len++] = (uint8_t) LOG_ARG_STR;
+	memcpy(blob->data + blob->len, &len, 4);
+	blob->len += 4;
+	memcpy(blob->data + blob->len, str, len);
+	blob->len += len;
+	blob->data[blob->len++] = '\0';
+}
+
+static void log_blob_destroy(log_blob_t *blob)
+{
+	if (blob->data && blob->data != blob->stack) {
+		free(blob->data);
+	}
+	blob->data = NULL;
+}
+
+static int log_args_capture(const char *fmt, va_list ap, log_blob_t *blob)
+{
+	const char *p;
+	log_spec_t spec;
+
+	for (p = fmt; (p = strchr(p, '%')); p += spec.len) {
+		int prec;
+		int64_t i;
+		uint64_t u;
+		double d;
+
+		if (!log_spec_parse(p, &spec)) {
+			return 0;
+		}
+
+		if (spec.star_width) {
+			i = va_arg(ap, int);
+			log_blob_put(blob, LOG_ARG_INT, &i);
+		}
+
+		prec = spec.prec;
+		if (spec.star_prec) {
+			prec = va_arg(ap, int);
+			i = prec;
+			log_blob_put(blob, LOG_ARG_INT, &i);
+		}
+
+		switch (spec.conv) {
+		case 'd':
+		case 'i':
+		case 'c':
+			switch (spec.mod) {
+			case LOG_MOD_L:
+				i = va_arg(ap, long);
+				break;
+			case LOG_MOD_LL:
+				i = va_arg(ap, long long);
+				break;
+			case LOG_MOD_Z:
+				i = (int64_t) va_arg(ap, size_t);
+				break;
+			case LOG_MOD_J:
+				i = va_arg(ap, intmax_t);
+				break;
+			case LOG_MOD_T:
+				i = va_arg(ap, ptrdiff_t);
+				break;
+			default:
+				i = va_arg(ap, int);
+				break;
+			}
+			log_blob_put(blob, LOG_ARG_INT, &i);
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			switch (spec.mod) {
+			case LOG_MOD_L:
+				u = va_arg(ap, unsigned long);
+				break;
+			case LOG_MOD_LL:
+				u = va_arg(ap, unsigned long long);
+				break;
+			case LOG_MOD_Z:
+				u = va_arg(ap, size_t);
+				break;
+			case LOG_MOD_J:
+				u = va_arg(ap, uintmax_t);
+				break;
+			case LOG_MOD_T:
+				u = (uint64_t) va_arg(ap, ptrdiff_t);
+				break;
+			default:
+				u = va_arg(ap, unsigned int);
+				break;
+			}
+			log_blob_put(blob, LOG_ARG_UINT, &u);
+			break;
+		case 's':
+			{
+				const char *str = va_arg(ap, const char *);
+				uint32_t len = 0;
 
-				// If module graylog is loaded, then do not output to console
-				if (mod_graylog_loaded && binding->is_console) {
-					continue;
+				if (!str) {
+					str = "(null)";
 				}
 
-				binding->function(node, node->level);
+				if (prec >= 0) {
+					while (len < (uint32_t) prec && str[len]) {
+						len++;
+					}
+				} else {
+					len = (uint32_t) strlen(str);
+				}
+				log_blob_put_str(blob, str, len);
 			}
+			break;
+		case 'p':
+			u = (uint64_t) (uintptr_t) va_arg(ap, void *);
+			log_blob_put(blob, LOG_ARG_PTR, &u);
+			break;
+		case '%':
+			break;
+		default:
+			d = va_arg(ap, double);
+			log_blob_put(blob, LOG_ARG_DOUBLE, &d);
+			break;
 		}
-		switch_mutex_unlock(BINDLOCK);
+	}
 
-		switch_log_node_free(&node);
+	return 1;
+}
 
+static void log_text_grow(log_text_t *text, switch_size_t need)
+{
+	if (text->len + need + 1 > text->size) {
+		switch_size_t size = text->size ? text->size : 256;
+
+		while (text->len + need + 1 > size) {
+			size *= 2;
+		}
+		text->data = realloc(text->data, size);
+		switch_assert(text->data);
+		text->size = size;
+	}
+}
+
+static void log_text_append(log_text_t *text, const char *str, switch_size_t len)
+{
+	log_text_grow(text, len);
+	memcpy(text->data + text->len, str, len);
+	text->len += len;
+	text->data[text->len] = '\0';
+}
+
+static void log_text_printf(log_text_t *text, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	log_text_grow(text, 64);
+
+	va_start(ap, fmt);
+	ret = vsnprintf(text->data + text->len, text->size - text->len, fmt, ap);
+	va_end(ap);
+
+	if (ret < 0) {
+		return;
+	}
+
+	if ((switch_size_t) ret >= text->size - text->len) {
+		log_text_grow(text, ret);
+		va_start(ap, fmt);
+		ret = vsnprintf(text->data + text->len, text->size - text->len, fmt, ap);
+		va_end(ap);
+	}
+
+	text->len += ret;
+}
+
+static int log_blob_get(const uint8_t *args, switch_size_t args_len, switch_size_t *pos, log_arg_type_t type, void *val)
+{
+	if (*pos + 9 > args_len || args[*pos] != (uint8_t) type) {
+		return 0;
+	}
+
+	memcpy(val, args + *pos + 1, 8);
+	*pos += 9;
+
+	return 1;
+}
+
+static const char *log_blob_get_str(const uint8_t *args, switch_size_t args_len, switch_size_t *pos)
+{
+	uint32_t len;
+	const char *str;
+
+	if (*pos + 5 > args_len || args[*pos] != (uint8_t) LOG_ARG_STR) {
+		return NULL;
+	}
+
+	memcpy(&len, args + *pos + 1, 4);
+	if (len > args_len || *pos + 6 + len > args_len || args[*pos + 5 + len] != '\0') {
+		return NULL;
+	}
+
+	str = (const char *) args + *pos + 5;
+	*pos += 6 + len;
+
+	return str;
+}
+
+#define log_render_arg(_val)											\
+	if (spec.star_width && spec.star_prec) {							\
+		log_text_printf(text, sf, (int) width, (int) prec, _val);		\
+	} else if (spec.star_width) {										\
+		log_text_printf(text, sf, (int) width, _val);					\
+	} else if (spec.star_prec) {										\
+		log_text_printf(text, sf, (int) prec, _val);					\
+	} else {															\
+		log_text_printf(text, sf, _val);								\
+	}
+
+static int log_args_render(const char *fmt, const uint8_t *args, switch_size_t args_len, log_text_t *text)
+{
+	const char *p = fmt, *pct;
+	switch_size_t pos = 0;
+	log_spec_t spec;
+
+	while ((pct = strchr(p, '%'))) {
+		char sf[LOG_RING_MAX_SPEC];
+		int64_t width = 0, prec = 0, i;
+		uint64_t u;
+		double d;
+		const char *str;
+
+		log_text_append(text, p, pct - p);
+
+		if (!log_spec_parse(pct, &spec)) {
+			return 0;
+		}
+
+		memcpy(sf, pct, spec.len);
+		sf[spec.len] = '\0';
+		p = pct + spec.len;
+
+		if (spec.star_width && !log_blob_get(args, args_len, &pos, LOG_ARG_INT, &width)) {
+			return 0;
+		}
+
+		if (spec.star_prec && !log_blob_get(args, args_len, &pos, LOG_ARG_INT, &prec)) {
+			return 0;
+		}
+
+		switch (spec.conv) {
+		case 'd':
+		case 'i':
+		case 'c':
+			if (!log_blob_get(args, args_len, &pos, LOG_ARG_INT, &i)) {
+				return 0;
+			}
+			switch (spec.mod) {
+			case LOG_MOD_L:
+				log_render_arg((long) i);
+				break;
+			case LOG_MOD_LL:
+				log_render_arg((long long) i);
+				break;
+			case LOG_MOD_Z:
+				log_render_arg((size_t) i);
+				break;
+			case LOG_MOD_J:
+				log_render_arg((intmax_t) i);
+				break;
+			case LOG_MOD_T:
+				log_render_arg((ptrdiff_t) i);
+				break;
+			default:
+				log_render_arg((int) i);
+				break;
+			}
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			if (!log_blob_get(args, args_len, &pos, LOG_ARG_UINT, &u)) {
+				return 0;
+			}
+			switch (spec.mod) {
+			case LOG_MOD_L:
+				log_render_arg((unsigned long) u);
+				break;
+			case LOG_MOD_LL:
+				log_render_arg((unsigned long long) u);
+				break;
+			case LOG_MOD_Z:
+				log_render_arg((size_t) u);
+				break;
+			case LOG_MOD_J:
+				log_render_arg((uintmax_t) u);
+				break;
+			case LOG_MOD_T:
+				log_render_arg((ptrdiff_t) u);
+				break;
+			default:
+				log_render_arg((unsigned int) u);
+				break;
+			}
+			break;
+		case 's':
+			if (!(str = log_blob_get_str(args, args_len, &pos))) {
+				return 0;
+			}
+			log_render_arg(str);
+			break;
+		case 'p':
+			if (!log_blob_get(args, args_len, &pos, LOG_ARG_PTR, &u)) {
+				return 0;
+			}
+			log_render_arg((void *) (uintptr_t) u);
+			break;
+		case '%':
+			log_text_append(text, "%", 1);
+			break;
+		default:
+			if (!log_blob_get(args, args_len, &pos, LOG_ARG_DOUBLE, &d)) {
+				return 0;
+			}
+			log_render_arg(d);
+			break;
+		}
+	}
+
+	log_text_append(text, p, strlen(p));
+
+	return 1;
+}
+
+/* Format a record the same way switch_log_meta_vprintf() does; *content_off is where the message
+   starts (the space after the prefix, as in node->content) */
+static char *log_record_render(const log_record_t *rec, switch_size_t *content_off)
+{
+	log_text_t text = { 0 };
+
+	log_text_grow(&text, 0);
+	text.data[0] = '\0';
+
+	if (rec->channel != SWITCH_CHANNEL_ID_LOG_CLEAN) {
+		switch_time_exp_t tm;
+
+		switch_time_exp_lt(&tm, rec->timestamp);
+#ifdef SWITCH_FUNC_IN_LOG
+		log_text_printf(&text, "%0.4d-%0.2d-%0.2d %0.2d:%0.2d:%0.2d.%0.6d %0.2f%% [%s] %s:%d %s()",
+						tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_usec, rec->idle_cpu,
+						switch_log_level2str(rec->level), rec->file, rec->line, rec->func);
+#else
+		log_text_printf(&text, "%0.4d-%0.2d-%0.2d %0.2d:%0.2d:%0.2d.%0.6d %0.2f%% [%s] %s:%d",
+						tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_usec, rec->idle_cpu,
+						switch_log_level2str(rec->level), rec->file, rec->line);
+#endif
+		*content_off = text.len;
+		log_text_append(&text, " ", 1);
+	} else {
+		*content_off = 0;
+	}
+
+	if (!log_args_render(rec->fmt, rec->args, rec->args_len, &text)) {
+		log_text_append(&text, " [undecodable log arguments]\n", 29);
+	}
+
+	return text.data;
+}
+
+static void log_binary_write(const log_record_t *rec)
+{
+	log_binary_record_t hdr = { 0 };
+	uint32_t file_len = rec->file ? (uint32_t) strlen(rec->file) + 1 : 0;
+	uint32_t func_len = rec->func ? (uint32_t) strlen(rec->func) + 1 : 0;
+	uint32_t uuid_len = rec->userdata ? (uint32_t) strlen(rec->userdata) + 1 : 0;
+	int ok = 1;
+
+	if (file_len > 0xFFFF || func_len > 0xFFFF || uuid_len > 0xFFFF) {
+		switch_atomic_inc(&LOG_RINGS.binary_errors);
+		return;
+	}
+
+	hdr.fmt_len = (uint32_t) strlen(rec->fmt) + 1;
+	hdr.args_len = (uint32_t) rec->args_len;
+	hdr.file_len = (uint16_t) file_len;
+	hdr.func_len = (uint16_t) func_len;
+	hdr.uuid_len = (uint16_t) uuid_len;
+	hdr.size = (uint32_t) sizeof(hdr) + hdr.fmt_len + hdr.args_len + file_len + func_len + uuid_len;
+	hdr.line = (uint32_t) rec->line;
+	hdr.timestamp = rec->timestamp;
+	hdr.sequence = rec->sequence;
+	hdr.idle_cpu = (uint16_t) (rec->idle_cpu * 100);
+	hdr.level = (uint8_t) rec->level;
+	hdr.channel = (uint8_t) rec->channel;
+
+	switch_mutex_lock(LOG_RINGS.binary_mutex);
+	if (LOG_RINGS.binary) {
+		ok = fwrite(&hdr, sizeof(hdr), 1, LOG_RINGS.binary) == 1 &&
+			(!file_len || fwrite(rec->file, file_len, 1, LOG_RINGS.binary) == 1) &&
+			(!func_len || fwrite(rec->func, func_len, 1, LOG_RINGS.binary) == 1) &&
+			(!uuid_len || fwrite(rec->userdata, uuid_len, 1, LOG_RINGS.binary) == 1) &&
+			fwrite(rec->fmt, hdr.fmt_len, 1, LOG_RINGS.binary) == 1 &&
+			(!hdr.args_len || fwrite(rec->args, hdr.args_len, 1, LOG_RINGS.binary) == 1);
+		LOG_RINGS.binary_dirty = 1;
+		switch_atomic_inc(ok ? &LOG_RINGS.binary_records : &LOG_RINGS.binary_errors);
+	}
+	switch_mutex_unlock(LOG_RINGS.binary_mutex);
+}
+
+static void log_binary_flush(void)
+{
+	if (!LOG_RINGS.binary_dirty) {
+		return;
+	}
+
+	switch_mutex_lock(LOG_RINGS.binary_mutex);
+	if (LOG_RINGS.binary) {
+		fflush(LOG_RINGS.binary);
+	}
+	LOG_RINGS.binary_dirty = 0;
+	switch_mutex_unlock(LOG_RINGS.binary_mutex);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_log_binary_open(const char *path)
+{
+	FILE *fp = NULL;
+
+	if (!LOG_RINGS.binary_mutex) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!zstr(path)) {
+		log_binary_header_t hdr = { { 0 } };
+
+		if (!(fp = fopen(path, "ab"))) {
+			return SWITCH_STATUS_GENERR;
+		}
+
+		setvbuf(fp, NULL, _IOFBF, 64 * 1024);
+
+		if (ftell(fp) == 0) {
+			memcpy(hdr.magic, LOG_BINARY_MAGIC, sizeof(LOG_BINARY_MAGIC));
+			hdr.version = LOG_BINARY_VERSION;
+			hdr.byte_order = LOG_BINARY_BYTE_ORDER;
+			hdr.record_size = sizeof(log_binary_record_t);
+			if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+				fclose(fp);
+				return SWITCH_STATUS_GENERR;
+			}
+		}
+	}
+
+	switch_mutex_lock(LOG_RINGS.binary_mutex);
+	if (LOG_RINGS.binary) {
+		fclose(LOG_RINGS.binary);
+	}
+	LOG_RINGS.binary = fp;
+	LOG_RINGS.binary_dirty = 0;
+	switch_mutex_unlock(LOG_RINGS.binary_mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_log_binary_decode(FILE *in, FILE *out, switch_log_level_t level, const char *uuid)
+{
+	log_binary_header_t fhdr;
+	log_binary_record_t hdr;
+	uint8_t *buf = NULL;
+	switch_size_t buflen = 0;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (fread(&fhdr, sizeof(fhdr), 1, in) != 1 || memcmp(fhdr.magic, LOG_BINARY_MAGIC, sizeof(LOG_BINARY_MAGIC)) ||
+		fhdr.version != LOG_BINARY_VERSION || fhdr.byte_order != LOG_BINARY_BYTE_ORDER || fhdr.record_size != sizeof(hdr)) {
+		return SWITCH_STATUS_NOT_INITALIZED;
+	}
+
+	while (fread(&hdr, sizeof(hdr), 1, in) == 1) {
+		log_record_t rec = { 0 };
+		switch_size_t body, off;
+		uint8_t *p;
+		char *data;
+
+		if (hdr.size < sizeof(hdr) || hdr.size > LOG_BINARY_MAX_RECORD || !hdr.fmt_len ||
+			hdr.size != sizeof(hdr) + (switch_size_t) hdr.fmt_len + hdr.args_len + hdr.file_len + hdr.func_len + hdr.uuid_len) {
+			status = SWITCH_STATUS_FALSE;
+			break;
+		}
+
+		body = hdr.size - sizeof(hdr);
+		if (body > buflen) {
+			buf = realloc(buf, body);
+			switch_assert(buf);
+			buflen = body;
+		}
+
+		if (fread(buf, body, 1, in) != 1) {
+			status = SWITCH_STATUS_FALSE;
+			break;
+		}
+
+		p = buf;
+		if (hdr.file_len) {
+			rec.file = (const char *) p;
+			p += hdr.file_len;
+		}
+		if (hdr.func_len) {
+			rec.func = (const char *) p;
+			p += hdr.func_len;
+		}
+		if (hdr.uuid_len) {
+			rec.userdata = (const char *) p;
+			p += hdr.uuid_len;
+		}
+		rec.fmt = (const char *) p;
+		p += hdr.fmt_len;
+
+		if ((hdr.file_len && rec.file[hdr.file_len - 1]) || (hdr.func_len && rec.func[hdr.func_len - 1]) ||
+			(hdr.uuid_len && rec.userdata[hdr.uuid_len - 1]) || rec.fmt[hdr.fmt_len - 1]) {
+			status = SWITCH_STATUS_FALSE;
+			break;
+		}
+
+		rec.args = p;
+		rec.args_len = hdr.args_len;
+
+		if (hdr.level > level || (uuid && (!rec.userdata || strcmp(uuid, rec.userdata)))) {
+			continue;
+		}
+
+		rec.channel = (switch_text_channel_t) hdr.channel;
+		rec.level = (switch_log_level_t) hdr.level;
+		rec.line = (int) hdr.line;
+		rec.timestamp = hdr.timestamp;
+		rec.sequence = hdr.sequence;
+		rec.idle_cpu = hdr.idle_cpu / 100.0;
+		if (!rec.file) rec.file = "";
+		if (!rec.func) rec.func = "";
+
+		data = log_record_render(&rec, &off);
+		fputs(data, out);
+		free(data);
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS && !feof(in)) {
+		status = SWITCH_STATUS_FALSE;
+	}
+
+	switch_safe_free(buf);
+
+	return status;
+}
+
+static void log_record_free(log_record_t **prec)
+{
+	log_record_t *rec = *prec;
+
+	if (rec->tags) {
+		switch_event_destroy(&rec->tags);
+	}
+	cJSON_Delete(rec->meta);
+	free(rec);
+	*prec = NULL;
+}
+
+static void log_record_process(log_record_t *rec)
+{
+	switch_log_node_t *node = switch_log_node_alloc();
+	switch_size_t off = 0;
+	char *data = log_record_render(rec, &off);
+	switch_size_t len = strlen(data);
+
+	if (runtime.log_truncate > 0 && len > (switch_size_t) runtime.log_truncate) {
+		char *new_data = switch_mprintf("%.*s...%s", runtime.log_truncate, data, data[len - 1] == '\n' ? "\n" : "");
+
+		if (new_data) {
+			free(data);
+			data = new_data;
+			if (off >= (switch_size_t) runtime.log_truncate) {
+				off = 0;
+			}
+		}
+	}
+
+	node->data = data;
+	node->content = data + off;
+	switch_set_string(node->file, rec->file);
+	switch_set_string(node->func, rec->func);
+	node->line = rec->line;
+	node->level = rec->level;
+	node->slevel = rec->slevel;
+	node->timestamp = rec->timestamp;
+	node->timestamp_nano = rec->timestamp_nano;
+	node->channel = rec->channel;
+	node->userdata = rec->userdata ? strdup(rec->userdata) : NULL;
+	node->tags = rec->tags;
+	node->meta = rec->meta;
+	rec->tags = NULL;
+	rec->meta = NULL;
+
+	switch_mutex_lock(COUNTERLOCK);
+	node->counter = counter;
+	counter += 1;
+	switch_mutex_unlock(COUNTERLOCK);
+
+	if (console_mods_loaded == 0) {
+		FILE *handle = switch_core_data_channel(rec->channel);
+
+		if (handle) {
+			log_console_write(handle, rec->level, data);
+		}
+	}
+
+	log_dispatch(node);
+
+	if (LOG_RINGS.binary) {
+		rec->sequence = node->sequence;
+		log_binary_write(rec);
+	}
+
+	switch_log_node_free(&node);
+	switch_atomic_inc(&LOG_RINGS.deferred);
+}
+
+static switch_bool_t log_ring_push(log_ring_t *ring, log_record_t *rec)
+{
+	uint32_t pos = switch_atomic_read(&ring->head);
+	log_ring_slot_t *slot;
+
+	for (;;) {
+		int32_t diff;
+
+		slot = &ring->slots[pos & ring->mask];
+		diff = (int32_t) (switch_atomic_read(&slot->seq) - pos);
+
+		if (diff == 0) {
+			uint32_t cur = switch_atomic_cas(&ring->head, pos + 1, pos);
+
+			if (cur == pos) {
+				break;
+			}
+			pos = cur;
+		} else if (diff < 0) {
+			return SWITCH_FALSE;
+		} else {
+			pos = switch_atomic_read(&ring->head);
+		}
+	}
+
+	slot->rec = rec;
+	/* a full barrier, publishes rec before the slot is marked ready */
+	switch_atomic_cas(&slot->seq, pos + 1, pos);
+
+	return SWITCH_TRUE;
+}
+
+static log_record_t *log_ring_pop(log_ring_t *ring)
+{
+	log_ring_slot_t *slot = &ring->slots[ring->tail & ring->mask];
+	uint32_t seq = switch_atomic_read(&slot->seq);
+	log_record_t *rec;
+
+	if (seq != ring->tail + 1) {
+		return NULL;
+	}
+
+	/* the cas doubles as an acquire load of the record */
+	rec = (log_record_t *) switch_atomic_casptr(&slot->rec, NULL, NULL);
+	slot->rec = NULL;
+	switch_atomic_cas(&slot->seq, ring->tail + ring->mask + 1, seq);
+	ring->tail++;
+
+	return rec;
+}
+
+static void *SWITCH_THREAD_FUNC log_sink_thread(switch_thread_t *t, void *obj)
+{
+	uint32_t id = *(uint32_t *) obj;
+
+	for (;;) {
+		int stopping = !LOG_RINGS.sinks_running;
+		uint32_t i, got = 0;
+
+		for (i = id; i < LOG_RINGS.nrings; i += LOG_RINGS.nsinks) {
+			log_record_t *rec;
+			int n = 0;
+
+			while (n < LOG_RING_BATCH && (rec = log_ring_pop(&LOG_RINGS.rings[i]))) {
+				log_record_process(rec);
+				log_record_free(&rec);
+				n++;
+			}
+			got += n;
+		}
+
+		if (!got) {
+			if (stopping) {
+				break;
+			}
+			log_binary_flush();
+			switch_yield(1000);
+		}
 	}
 
-	THREAD_RUNNING = 0;
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Logger Ended.\n");
 	return NULL;
 }
 
+static uint32_t log_ring_index(void)
+{
+	uint32_t h = (uint32_t) (uintptr_t) switch_thread_self();
+
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+
+	return h % LOG_RINGS.nrings;
+}
+
+/* Capture a log line into the caller's ring, returns SWITCH_FALSE if the rings are not running */
+static switch_bool_t log_ring_enqueue(switch_text_channel_t channel, const char *filep, const char *funcp, int line,
+									  const char *userdata, switch_log_level_t level, switch_log_level_t special_level,
+									  switch_time_t now, cJSON **log_meta, const char *fmt, va_list ap)
+{
+	log_blob_t blob = { 0 };
+	log_ring_t *ring;
+	log_record_t *rec;
+	struct timespec tv = { 0 };
+	const char *uuid = NULL;
+	switch_event_t *tags = NULL;
+	switch_size_t file_len, func_len, uuid_len = 0, fmt_len, size;
+	char *p;
+	va_list ap2;
+	int ok;
+
+	switch_atomic_inc(&LOG_RINGS.writers);
+
+	if (!switch_atomic_read(&LOG_RINGS.running)) {
+		switch_atomic_dec(&LOG_RINGS.writers);
+		return SWITCH_FALSE;
+	}
+
+	va_copy(ap2, ap);
+	ok = log_args_capture(fmt, ap2, &blob);
+	va_end(ap2);
+
+	if (!ok) {
+		char *body = NULL;
+		int ret;
+
+		log_blob_destroy(&blob);
+		memset(&blob, 0, sizeof(blob));
+
+		if ((ret = switch_vasprintf(&body, fmt, ap)) == -1) {
+			switch_atomic_dec(&LOG_RINGS.writers);
+			return SWITCH_TRUE;
+		}
+		log_blob_put_str(&blob, body, (uint32_t) ret);
+		free(body);
+		fmt = "%s";
+		switch_atomic_inc(&LOG_RINGS.preformatted);
+	}
+
+	if (channel == SWITCH_CHANNEL_ID_SESSION) {
+		switch_core_session_t *session = (switch_core_session_t *) userdata;
+
+		if (session) {
+			uuid = switch_core_session_get_uuid(session);
+			switch_channel_get_log_tags(switch_core_session_get_channel(session), &tags);
+		}
+	} else if (!zstr(userdata)) {
+		uuid = userdata;
+	}
+
+	file_len = strlen(filep) + 1;
+	func_len = strlen(funcp) + 1;
+	fmt_len = strlen(fmt) + 1;
+	if (uuid) {
+		uuid_len = strlen(uuid) + 1;
+	}
+
+	size = sizeof(*rec) + file_len + func_len + uuid_len + fmt_len + blob.len;
+	rec = malloc(size);
+	switch_assert(rec);
+	memset(rec, 0, sizeof(*rec));
+
+	p = (char *) (rec + 1);
+	memcpy(p, blob.data, blob.len);
+	rec->args = (const uint8_t *) p;
+	rec->args_len = blob.len;
+	p += blob.len;
+	memcpy(p, filep, file_len);
+	rec->file = p;
+	p += file_len;
+	memcpy(p, funcp, func_len);
+	rec->func = p;
+	p += func_len;
+	memcpy(p, fmt, fmt_len);
+	rec->fmt = p;
+	p += fmt_len;
+	if (uuid) {
+		memcpy(p, uuid, uuid_len);
+		rec->userdata = p;
+	}
+	log_blob_destroy(&blob);
+
+	rec->channel = channel;
+	rec->level = level;
+	rec->slevel = special_level;
+	rec->line = line;
+	rec->timestamp = now;
+	rec->idle_cpu = switch_core_idle_cpu();
+	if (!clock_gettime(CLOCK_REALTIME, &tv)) {
+		rec->timestamp_nano = tv.tv_sec * 1000000000 + tv.tv_nsec;
+	}
+	rec->tags = tags;
+	rec->meta = *log_meta;
+	*log_meta = NULL;
+
+	ring = &LOG_RINGS.rings[log_ring_index()];
+
+	if (log_ring_push(ring, rec)) {
+		switch_atomic_inc(&ring->queued);
+	} else {
+		switch_atomic_inc(&ring->dropped);
+		log_record_free(&rec);
+	}
+
+	switch_atomic_dec(&LOG_RINGS.writers);
+
+	return SWITCH_TRUE;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_log_rings_start(uint32_t rings, uint32_t slots, uint32_t sinks)
+{
+	switch_threadattr_t *thd_attr;
+	uint32_t i, size = 2;
+
+	if (!LOG_POOL || LOG_RINGS.rings || !rings || !sinks) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!slots) {
+		slots = LOG_RING_DEFAULT_SLOTS;
+	}
+
+	while (size < slots && size < (1U << 24)) {
+		size <<= 1;
+	}
+
+	if (sinks > rings) {
+		sinks = rings;
+	}
+
+	LOG_RINGS.rings = switch_core_alloc(LOG_POOL, sizeof(log_ring_t) * rings);
+	for (i = 0; i < rings; i++) {
+		log_ring_t *ring = &LOG_RINGS.rings[i];
+		uint32_t x;
+
+		ring->mask = size - 1;
+		ring->slots = switch_core_alloc(LOG_POOL, sizeof(log_ring_slot_t) * size);
+		for (x = 0; x < size; x++) {
+			switch_atomic_set(&ring->slots[x].seq, x);
+		}
+	}
+
+	LOG_RINGS.nrings = rings;
+	LOG_RINGS.slots = size;
+	LOG_RINGS.nsinks = sinks;
+	LOG_RINGS.sinks = switch_core_alloc(LOG_POOL, sizeof(switch_thread_t *) * sinks);
+	LOG_RINGS.sinks_running = 1;
+
+	switch_threadattr_create(&thd_attr, LOG_POOL);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	for (i = 0; i < sinks; i++) {
+		uint32_t *id = switch_core_alloc(LOG_POOL, sizeof(*id));
+
+		*id = i;
+		switch_thread_create(&LOG_RINGS.sinks[i], thd_attr, log_sink_thread, id, LOG_POOL);
+	}
+
+	switch_atomic_set(&LOG_RINGS.running, 1);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void log_rings_stop(void)
+{
+	switch_status_t st;
+	uint32_t i;
+
+	if (!LOG_RINGS.rings) {
+		return;
+	}
+
+	switch_atomic_cas(&LOG_RINGS.running, 0, 1);
+
+	while (switch_atomic_read(&LOG_RINGS.writers)) {
+		switch_cond_next();
+	}
+
+	LOG_RINGS.sinks_running = 0;
+
+	for (i = 0; i < LOG_RINGS.nsinks; i++) {
+		switch_thread_join(&st, LOG_RINGS.sinks[i]);
+	}
+
+	switch_log_binary_open(NULL);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_log_ring_stats(switch_log_ring_stats_t *stats)
+{
+	uint32_t i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!switch_atomic_read(&LOG_RINGS.running)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	stats->rings = LOG_RINGS.nrings;
+	stats->slots = LOG_RINGS.slots;
+	stats->sinks = LOG_RINGS.nsinks;
+
+	for (i = 0; i < LOG_RINGS.nrings; i++) {
+		log_ring_t *ring = &LOG_RINGS.rings[i];
+
+		stats->depth += switch_atomic_read(&ring->head) - ring->tail;
+		stats->queued += switch_atomic_read(&ring->queued);
+		stats->dropped += switch_atomic_read(&ring->dropped);
+	}
+
+	stats->deferred = switch_atomic_read(&LOG_RINGS.deferred);
+	stats->preformatted = switch_atomic_read(&LOG_RINGS.preformatted);
+	stats->binary_records = switch_atomic_read(&LOG_RINGS.binary_records);
+	stats->binary_errors = switch_atomic_read(&LOG_RINGS.binary_errors);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_DECLARE(void) switch_log_meta_printf(switch_text_channel_t channel, const char *file, const char *func, int line,
 									   const char *userdata, switch_log_level_t level, cJSON **meta, const char *fmt, ...)
 {
@@ -613,6 +1880,11 @@ SWITCH_DECLARE(void) switch_log_meta_vprintf(switch_text_channel_t channel, cons
 
 	switch_assert(level < SWITCH_LOG_INVALID);
 
+	if (channel != SWITCH_CHANNEL_ID_EVENT && do_mods && level <= MAX_LEVEL &&
+		log_ring_enqueue(channel, filep, funcp, line, userdata, level, special_level, now, &log_meta, fmt, ap)) {
+		goto end;
+	}
+
 	handle = switch_core_data_channel(channel);
 
 	if (channel != SWITCH_CHANNEL_ID_LOG_CLEAN) {
@@ -689,39 +1961,7 @@ SWITCH_DECLARE(void) switch_log_meta_vprintf(switch_text_channel_t channel, cons
 
 	if (console_mods_loaded == 0 || !do_mods) {
 		if (handle) {
-			int aok = 1;
-#ifndef WIN32
-
-			fd_set can_write;
-			int fd;
-			struct timeval to;
-
-			fd = fileno(handle);
-			memset(&to, 0, sizeof(to));
-			FD_ZERO(&can_write);
-			FD_SET(fd, &can_write);
-			to.tv_sec = 0;
-			to.tv_usec = 100000;
-			if (select(fd + 1, NULL, &can_write, NULL, &to) > 0) {
-				aok = FD_ISSET(fd, &can_write);
-			} else {
-				aok = 0;
-			}
-#endif
-			if (aok) {
-				if (COLORIZE) {
-
-#ifdef WIN32
-					SetConsoleTextAttribute(hStdout, COLORS[level]);
-					WriteFile(hStdout, data, (DWORD) strlen(data), NULL, NULL);
-					SetConsoleTextAttribute(hStdout, wOldColorAttrs);
-#else
-					fprintf(handle, "%s%s%s", COLORS[level], data, SWITCH_SEQ_DEFAULT_COLOR);
-#endif
-				} else {
-					fprintf(handle, "%s", data);
-				}
-			}
+			log_console_write(handle, level, data);
 		}
 	}
 
@@ -794,6 +2034,7 @@ SWITCH_DECLARE(switch_status_t) switch_log_init(switch_memory_pool_t *pool, swit
 #endif
 	switch_mutex_init(&BINDLOCK, SWITCH_MUTEX_NESTED, LOG_POOL);
 	switch_mutex_init(&COUNTERLOCK, SWITCH_MUTEX_NESTED, LOG_POOL);
+	switch_mutex_init(&LOG_RINGS.binary_mutex, SWITCH_MUTEX_NESTED, LOG_POOL);
 	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
 	switch_thread_create(&thread, thd_attr, log_thread, NULL, LOG_POOL);
 
@@ -837,6 +2078,7 @@ SWITCH_DECLARE(switch_status_t) switch_log_shutdown(void)
 {
 	switch_status_t st;
 
+	log_rings_stop();
 
 	switch_queue_push(LOG_QUEUE, NULL);
 	while (THREAD_RUNNING) {
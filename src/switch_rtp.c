@@ -7596,7 +7596,40 @@ static switch_status_t process_rtcp_report(switch_rtp_t *rtp_session, rtcp_msg_t
 
 			//switch_core_media_gen_key_frame(rtp_session->session);
 		}
-		
+
+		/* TMMBR: one entry per media sender, only the one naming our ssrc limits what we send */
+		if (msg->header.type == _RTCP_PT_RTPFB && extp->header.fmt == _RTCP_RTPFB_TMMBR) {
+			rtcp_tmmbx_t *tmmbx = (rtcp_tmmbx_t *) extp->body;
+			switch_size_t entries = bytes > sizeof(switch_rtcp_ext_hdr_t) ? (bytes - sizeof(switch_rtcp_ext_hdr_t)) / sizeof(rtcp_tmmbx_t) : 0;
+
+			for (; entries > 0; entries--, tmmbx++) {
+				uint32_t mantissa;
+				uint64_t bps;
+
+				if (ntohl(tmmbx->ssrc) != rtp_session->ssrc) {
+					continue;
+				}
+
+				mantissa = ((tmmbx->parts[0] & 0x03) << 15) | (tmmbx->parts[1] << 7) | (tmmbx->parts[2] >> 1);
+				bps = (uint64_t) mantissa << (tmmbx->parts[0] >> 2);
+
+				rtp_session->stats.rtcp.peer_max_bitrate = bps > UINT32_MAX ? UINT32_MAX : (uint32_t) bps;
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG2, "%s Got TMMBR %u\n",
+								  switch_core_session_get_name(rtp_session->session), rtp_session->stats.rtcp.peer_max_bitrate);
+				break;
+			}
+		}
+
+		/* REMB: "REMB", ssrc count, 6 bit exponent and 18 bit mantissa */
+		if (msg->header.type == _RTCP_PT_PSFB && extp->header.fmt == _RTCP_PSFB_AFB &&
+			bytes >= sizeof(switch_rtcp_ext_hdr_t) + 8 && !memcmp(extp->body, "REMB", 4)) {
+			uint8_t *fci = (uint8_t *) extp->body;
+			uint32_t mantissa = ((fci[5] & 0x03) << 16) | (fci[6] << 8) | fci[7];
+			uint64_t bps = (uint64_t) mantissa << (fci[5] >> 2);
+
+			rtp_session->stats.rtcp.peer_max_bitrate = bps > UINT32_MAX ? UINT32_MAX : (uint32_t) bps;
+		}
+
 	} else {
 		if (msg->header.type == _RTCP_PT_SR || msg->header.type == _RTCP_PT_RR || msg->header.type == _RTCP_PT_XR) {
 			struct switch_rtcp_report_block *report = NULL;
@@ -37,6 +37,37 @@
 #include <fvad.h>
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VAD_HAVE_AVX2 1
+#endif
+
+/* per frame statistics, the difference energy uses halved samples so it fits the 16 bit kernels */
+typedef struct {
+	uint32_t abs_sum;
+	uint64_t energy;
+	uint64_t diff_energy;
+	uint32_t crossings;
+} vad_stats_t;
+
+typedef struct {
+	const char *name;
+	uint32_t (*abs_sum)(const int16_t *data, unsigned int samples);
+	void (*stats)(const int16_t *data, unsigned int samples, vad_stats_t *stats);
+} vad_kernel_t;
+
+#define VAD_GMM_MINIMA 8
+
+typedef struct {
+	float mean[2];
+	float var[2];
+	float weight[2];
+} vad_gaussian_t;
+
 struct switch_vad_s {
 	// configs
 	int channels;
@@ -51,11 +82,379 @@ struct switch_vad_s {
 	int voice_samples;
 	int silence_samples;
 	switch_vad_state_t vad_state;
+
+	// GMM mode, -1 when off
+	int gmm;
+	float noise_floor;
+	float window_min;
+	int window_samples;
+	float minima[VAD_GMM_MINIMA];
+	int minima_pos;
 #ifdef SWITCH_HAVE_FVAD
 	Fvad *fvad;
 #endif
 };
 
+static uint32_t vad_abs_sum_scalar(const int16_t *data, unsigned int samples)
+{
+	uint32_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		sum += abs(data[i]);
+	}
+
+	return sum;
+}
+
+static void vad_stats_scalar(const int16_t *data, unsigned int samples, vad_stats_t *stats)
+{
+	unsigned int i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < samples; i++) {
+		stats->abs_sum += abs(data[i]);
+		stats->energy += (uint32_t) ((int32_t) data[i] * data[i]);
+
+		if (i) {
+			int32_t d = (data[i] >> 1) - (data[i - 1] >> 1);
+
+			stats->diff_energy += (uint32_t) (d * d);
+			stats->crossings += (data[i] ^ data[i - 1]) < 0;
+		}
+	}
+}
+
+#if defined(__SSE2__)
+/* |x| of the signed samples as unsigned 16 bit values, so -32768 comes out as 32768 */
+#define VAD_SSE2_ABS(x) _mm_sub_epi16(_mm_xor_si128((x), _mm_srai_epi16((x), 15)), _mm_srai_epi16((x), 15))
+
+static uint32_t vad_abs_sum_sse2(const int16_t *data, unsigned int samples)
+{
+	__m128i zero = _mm_setzero_si128(), acc = _mm_setzero_si128();
+	uint32_t out[4], sum;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i a = VAD_SSE2_ABS(x);
+
+		acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(a, zero), _mm_unpackhi_epi16(a, zero)));
+	}
+
+	_mm_storeu_si128((__m128i *) out, acc);
+	sum = out[0] + out[1] + out[2] + out[3];
+
+	return sum + vad_abs_sum_scalar(data + i, samples - i);
+}
+
+static void vad_stats_sse2(const int16_t *data, unsigned int samples, vad_stats_t *stats)
+{
+	__m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+	__m128i abs_acc = zero, e_acc = zero, d_acc = zero, z_acc = zero;
+	uint32_t a[4], z[4];
+	uint64_t e[2], d[2];
+	unsigned int i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (samples < 9) {
+		vad_stats_scalar(data, samples, stats);
+		return;
+	}
+
+	/* sample 0 has no predecessor, the vector loop covers 1..n */
+	stats->abs_sum = abs(data[0]);
+	stats->energy = (uint32_t) ((int32_t) data[0] * data[0]);
+
+	for (i = 1; i + 8 <= samples; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i p = _mm_loadu_si128((const __m128i *) (data + i - 1));
+		__m128i ax = VAD_SSE2_ABS(x);
+		__m128i sq = _mm_madd_epi16(x, x);
+		__m128i dx = _mm_sub_epi16(_mm_srai_epi16(x, 1), _mm_srai_epi16(p, 1));
+		__m128i dq = _mm_madd_epi16(dx, dx);
+
+		abs_acc = _mm_add_epi32(abs_acc, _mm_add_epi32(_mm_unpacklo_epi16(ax, zero), _mm_unpackhi_epi16(ax, zero)));
+		e_acc = _mm_add_epi64(e_acc, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+		d_acc = _mm_add_epi64(d_acc, _mm_add_epi64(_mm_unpacklo_epi32(dq, zero), _mm_unpackhi_epi32(dq, zero)));
+		z_acc = _mm_sub_epi32(z_acc, _mm_madd_epi16(_mm_srai_epi16(_mm_xor_si128(x, p), 15), ones));
+	}
+
+	_mm_storeu_si128((__m128i *) a, abs_acc);
+	_mm_storeu_si128((__m128i *) e, e_acc);
+	_mm_storeu_si128((__m128i *) d, d_acc);
+	_mm_storeu_si128((__m128i *) z, z_acc);
+
+	stats->abs_sum += a[0] + a[1] + a[2] + a[3];
+	stats->energy += e[0] + e[1];
+	stats->diff_energy += d[0] + d[1];
+	stats->crossings += z[0] + z[1] + z[2] + z[3];
+
+	for (; i < samples; i++) {
+		int32_t dd = (data[i] >> 1) - (data[i - 1] >> 1);
+
+		stats->abs_sum += abs(data[i]);
+		stats->energy += (uint32_t) ((int32_t) data[i] * data[i]);
+		stats->diff_energy += (uint32_t) (dd * dd);
+		stats->crossings += (data[i] ^ data[i - 1]) < 0;
+	}
+}
+#endif
+
+#ifdef VAD_HAVE_AVX2
+#define VAD_AVX2_ABS(x) _mm256_sub_epi16(_mm256_xor_si256((x), _mm256_srai_epi16((x), 15)), _mm256_srai_epi16((x), 15))
+
+__attribute__((target("avx2"))) static uint32_t vad_abs_sum_avx2(const int16_t *data, unsigned int samples)
+{
+	__m256i zero = _mm256_setzero_si256(), acc = _mm256_setzero_si256();
+	uint32_t out[8], sum = 0;
+	unsigned int i;
+	int j;
+
+	for (i = 0; i + 16 <= samples; i += 16) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (data + i));
+		__m256i a = VAD_AVX2_ABS(x);
+
+		acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_unpacklo_epi16(a, zero), _mm256_unpackhi_epi16(a, zero)));
+	}
+
+	_mm256_storeu_si256((__m256i *) out, acc);
+	for (j = 0; j < 8; j++) {
+		sum += out[j];
+	}
+
+	return sum + vad_abs_sum_scalar(data + i, samples - i);
+}
+
+__attribute__((target("avx2"))) static void vad_stats_avx2(const int16_t *data, unsigned int samples, vad_stats_t *stats)
+{
+	__m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi16(1);
+	__m256i abs_acc = zero, e_acc = zero, d_acc = zero, z_acc = zero;
+	uint32_t a[8], z[8];
+	uint64_t e[4], d[4];
+	unsigned int i;
+	int j;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (samples < 17) {
+		vad_stats_scalar(data, samples, stats);
+		return;
+	}
+
+	stats->abs_sum = abs(data[0]);
+	stats->energy = (uint32_t) ((int32_t) data[0] * data[0]);
+
+	for (i = 1; i + 16 <= samples; i += 16) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (data + i));
+		__m256i p = _mm256_loadu_si256((const __m256i *) (data + i - 1));
+		__m256i ax = VAD_AVX2_ABS(x);
+		__m256i sq = _mm256_madd_epi16(x, x);
+		__m256i dx = _mm256_sub_epi16(_mm256_srai_epi16(x, 1), _mm256_srai_epi16(p, 1));
+		__m256i dq = _mm256_madd_epi16(dx, dx);
+
+		abs_acc = _mm256_add_epi32(abs_acc, _mm256_add_epi32(_mm256_unpacklo_epi16(ax, zero), _mm256_unpackhi_epi16(ax, zero)));
+		e_acc = _mm256_add_epi64(e_acc, _mm256_add_epi64(_mm256_unpacklo_epi32(sq, zero), _mm256_unpackhi_epi32(sq, zero)));
+		d_acc = _mm256_add_epi64(d_acc, _mm256_add_epi64(_mm256_unpacklo_epi32(dq, zero), _mm256_unpackhi_epi32(dq, zero)));
+		z_acc = _mm256_sub_epi32(z_acc, _mm256_madd_epi16(_mm256_srai_epi16(_mm256_xor_si256(x, p), 15), ones));
+	}
+
+	_mm256_storeu_si256((__m256i *) a, abs_acc);
+	_mm256_storeu_si256((__m256i *) e, e_acc);
+	_mm256_storeu_si256((__m256i *) d, d_acc);
+	_mm256_storeu_si256((__m256i *) z, z_acc);
+
+	for (j = 0; j < 8; j++) {
+		stats->abs_sum += a[j];
+		stats->crossings += z[j];
+	}
+
+	for (j = 0; j < 4; j++) {
+		stats->energy += e[j];
+		stats->diff_energy += d[j];
+	}
+
+	for (; i < samples; i++) {
+		int32_t dd = (data[i] >> 1) - (data[i - 1] >> 1);
+
+		stats->abs_sum += abs(data[i]);
+		stats->energy += (uint32_t) ((int32_t) data[i] * data[i]);
+		stats->diff_energy += (uint32_t) (dd * dd);
+		stats->crossings += (data[i] ^ data[i - 1]) < 0;
+	}
+}
+#endif
+
+static const vad_kernel_t vad_kernels[] = {
+#ifdef VAD_HAVE_AVX2
+	{ "avx2", vad_abs_sum_avx2, vad_stats_avx2 },
+#endif
+#if defined(__SSE2__)
+	{ "sse2", vad_abs_sum_sse2, vad_stats_sse2 },
+#endif
+	{ "scalar", vad_abs_sum_scalar, vad_stats_scalar }
+};
+
+static const vad_kernel_t *vad_kernel = NULL;
+
+static switch_bool_t vad_kernel_supported(const vad_kernel_t *kernel)
+{
+#ifdef VAD_HAVE_AVX2
+	if (!strcmp(kernel->name, "avx2")) {
+		return __builtin_cpu_supports("avx2") ? SWITCH_TRUE : SWITCH_FALSE;
+	}
+#endif
+	return SWITCH_TRUE;
+}
+
+static const vad_kernel_t *vad_get_kernel(void)
+{
+	if (!vad_kernel) {
+		size_t i;
+
+		for (i = 0; i < sizeof(vad_kernels) / sizeof(vad_kernels[0]); i++) {
+			if (vad_kernel_supported(&vad_kernels[i])) {
+				vad_kernel = &vad_kernels[i];
+				break;
+			}
+		}
+	}
+
+	return vad_kernel;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_vad_set_kernel(const char *name)
+{
+	size_t i;
+
+	if (zstr(name) || !strcasecmp(name, "auto")) {
+		vad_kernel = NULL;
+		vad_get_kernel();
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	for (i = 0; i < sizeof(vad_kernels) / sizeof(vad_kernels[0]); i++) {
+		if (!strcasecmp(vad_kernels[i].name, name) && vad_kernel_supported(&vad_kernels[i])) {
+			vad_kernel = &vad_kernels[i];
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+	return SWITCH_STATUS_FALSE;
+}
+
+SWITCH_DECLARE(const char *) switch_vad_get_kernel(void)
+{
+	return vad_get_kernel()->name;
+}
+
+/*
+ * GMM mode, after the WebRTC VAD: each frame is scored by the log likelihood ratio of a two
+ * component speech and noise mixture per feature.  The features are the frame level above
+ * the noise floor, the high band tilt (difference energy over energy) and the zero crossing
+ * rate.  The noise floor follows the minimum frame level over the last couple of seconds.
+ */
+
+/* level above the noise floor in dB */
+static const vad_gaussian_t vad_gmm_snr[2] = {
+	{ { 9.0f, 25.0f }, { 16.0f, 70.0f }, { 0.5f, 0.5f } },		/* speech */
+	{ { 0.7f, 2.5f }, { 1.0f, 4.0f }, { 0.7f, 0.3f } }			/* noise */
+};
+
+/* difference energy over energy in dB, voiced speech is low pass, fricatives are not */
+static const vad_gaussian_t vad_gmm_tilt[2] = {
+	{ { -12.0f, 0.0f }, { 30.0f, 20.0f }, { 0.7f, 0.3f } },
+	{ { 3.0f, -6.0f }, { 6.0f, 40.0f }, { 0.6f, 0.4f } }
+};
+
+/* zero crossings per sample */
+static const vad_gaussian_t vad_gmm_zcr[2] = {
+	{ { 0.1f, 0.4f }, { 0.004f, 0.02f }, { 0.7f, 0.3f } },
+	{ { 0.5f, 0.2f }, { 0.006f, 0.03f }, { 0.6f, 0.4f } }
+};
+
+/* log likelihood ratio a frame needs per aggressiveness */
+static const float vad_gmm_thresh[4] = { 0.0f, 2.0f, 4.0f, 6.0f };
+
+static float vad_gmm_log_likelihood(const vad_gaussian_t *g, float x)
+{
+	float p = 0.0f;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		float d = x - g->mean[i];
+
+		p += g->weight[i] / sqrtf(2.0f * (float) M_PI * g->var[i]) * expf(-d * d / (2.0f * g->var[i]));
+	}
+
+	return logf(p + 1e-30f);
+}
+
+static void vad_gmm_reset(switch_vad_t *vad)
+{
+	int i;
+
+	vad->noise_floor = -1.0f;
+	vad->window_min = 1000.0f;
+	vad->window_samples = 0;
+	vad->minima_pos = 0;
+
+	for (i = 0; i < VAD_GMM_MINIMA; i++) {
+		vad->minima[i] = 1000.0f;
+	}
+}
+
+static int vad_gmm_score(switch_vad_t *vad, const vad_stats_t *stats, unsigned int samples)
+{
+	float level, tilt, zcr, snr, llr, floor_level;
+	int i;
+
+	if (samples < 2) {
+		return 0;
+	}
+
+	level = 10.0f * log10f((float) stats->energy / samples + 1.0f);
+	tilt = 10.0f * log10f(4.0f * (float) stats->diff_energy / (samples - 1) + 1.0f) - level;
+	zcr = (float) stats->crossings / (samples - 1);
+
+	/* minimum statistics over VAD_GMM_MINIMA windows of a third of a second */
+	if (level < vad->window_min) {
+		vad->window_min = level;
+	}
+
+	vad->window_samples += samples;
+
+	if (vad->window_samples >= vad->sample_rate / 3) {
+		vad->minima[vad->minima_pos++ % VAD_GMM_MINIMA] = vad->window_min;
+		vad->window_min = 1000.0f;
+		vad->window_samples = 0;
+	}
+
+	floor_level = vad->window_min;
+	for (i = 0; i < VAD_GMM_MINIMA; i++) {
+		if (vad->minima[i] < floor_level) {
+			floor_level = vad->minima[i];
+		}
+	}
+
+	vad->noise_floor = floor_level;
+	snr = level - floor_level;
+
+	llr = vad_gmm_log_likelihood(&vad_gmm_snr[0], snr) - vad_gmm_log_likelihood(&vad_gmm_snr[1], snr) +
+		vad_gmm_log_likelihood(&vad_gmm_tilt[0], tilt) - vad_gmm_log_likelihood(&vad_gmm_tilt[1], tilt) +
+		vad_gmm_log_likelihood(&vad_gmm_zcr[0], zcr) - vad_gmm_log_likelihood(&vad_gmm_zcr[1], zcr);
+
+	if (vad->debug > 9) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "gmm level: %.1f floor: %.1f tilt: %.1f zcr: %.2f llr: %.1f\n",
+						  level, floor_level, tilt, zcr, llr);
+	}
+
+	/* a frame barely above the floor is never speech, whatever its shape */
+	return (snr > 3.0f && llr > vad_gmm_thresh[vad->gmm]) ? vad->thresh + 100 : 0;
+}
+
 SWITCH_DECLARE(const char *) switch_vad_state2str(switch_vad_state_t state)
 {
 	switch(state) {
@@ -88,6 +487,8 @@ SWITCH_DECLARE(switch_vad_t *) switch_vad_init(int sample_rate, int channels)
 	if (vad->divisor <= 0) {
 		vad->divisor = 1;
 	}
+	vad->gmm = -1;
+	vad_gmm_reset(vad);
 	switch_vad_reset(vad);
 
 	return vad;
@@ -145,6 +546,10 @@ SWITCH_DECLARE(void) switch_vad_set_param(switch_vad_t *vad, const char *key, in
 		}
 	} else if (!strcmp(key, "thresh")) {
 		vad->thresh = val;
+	} else if (!strcmp(key, "gmm")) {
+		/* -1 turns GMM mode off, 0-3 is the aggressiveness */
+		vad->gmm = val < 0 ? -1 : val > 3 ? 3 : val;
+		vad_gmm_reset(vad);
 	} else if (!strcmp(key, "debug")) {
 		vad->debug = val;
 	} else if (!strcmp(key, "voice_ms")) {
@@ -178,7 +583,7 @@ SWITCH_DECLARE(void) switch_vad_reset(switch_vad_t *vad)
 	if (vad->debug) switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "reset vad state\n");
 }
 
-SWITCH_DECLARE(switch_vad_state_t) switch_vad_process(switch_vad_t *vad, int16_t *data, unsigned int samples)
+static switch_vad_state_t vad_process(switch_vad_t *vad, const vad_kernel_t *kernel, int16_t *data, unsigned int samples)
 {
 	int score = 0;
 
@@ -201,13 +606,25 @@ SWITCH_DECLARE(switch_vad_state_t) switch_vad_process(switch_vad_t *vad, int16_t
 	} else {
 #endif
 		int energy = 0, j = 0, count = 0;
-		for (energy = 0, j = 0, count = 0; count < samples; count++) {
-			energy += abs(data[j]);
-			j += vad->channels;
-		}
 
-		if (samples && vad->divisor && samples >= vad->divisor) {
-			score = (uint32_t)(energy / (samples / vad->divisor));
+		if (vad->channels == 1 && vad->gmm >= 0) {
+			vad_stats_t stats;
+
+			kernel->stats(data, samples, &stats);
+			score = vad_gmm_score(vad, &stats, samples);
+		} else {
+			if (vad->channels == 1) {
+				energy = (int) kernel->abs_sum(data, samples);
+			} else {
+				for (energy = 0, j = 0, count = 0; count < samples; count++) {
+					energy += abs(data[j]);
+					j += vad->channels;
+				}
+			}
+
+			if (samples && vad->divisor && samples >= vad->divisor) {
+				score = (uint32_t)(energy / (samples / vad->divisor));
+			}
 		}
 #ifdef SWITCH_HAVE_FVAD
 	}
@@ -247,6 +664,27 @@ SWITCH_DECLARE(switch_vad_state_t) switch_vad_process(switch_vad_t *vad, int16_t
 	return vad->vad_state;
 }
 
+SWITCH_DECLARE(switch_vad_state_t) switch_vad_process(switch_vad_t *vad, int16_t *data, unsigned int samples)
+{
+	return vad_process(vad, vad_get_kernel(), data, samples);
+}
+
+SWITCH_DECLARE(void) switch_vad_process_batch(switch_vad_t **vads, int16_t **data, const unsigned int *samples, switch_vad_state_t *states, int count)
+{
+	const vad_kernel_t *kernel = vad_get_kernel();
+	int i;
+
+	for (i = 0; i < count; i++) {
+#if defined(__GNUC__)
+		if (i + 1 < count) {
+			__builtin_prefetch(data[i + 1]);
+			__builtin_prefetch(vads[i + 1]);
+		}
+#endif
+		states[i] = vad_process(vads[i], kernel, data[i], samples[i]);
+	}
+}
+
 SWITCH_DECLARE(switch_vad_state_t) switch_vad_get_state(switch_vad_t *vad) 
 {
 
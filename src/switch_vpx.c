@@ -50,6 +50,9 @@
 
 #define SLICE_SIZE SWITCH_DEFAULT_VIDEO_SIZE
 #define KEY_FRAME_MIN_FREQ 250000
+#define ENC_LOAD_THRESHOLD 80
+#define ENC_THREADS_MAX 8
+#define ENC_THREAD_CHANGE_MIN_FREQ 10000000
 
 #define CODEC_TYPE_ANY 0
 #define CODEC_TYPE_VP8 8
@@ -419,6 +422,23 @@ struct vpx_context {
 	switch_time_t start_time;
 	switch_image_t *patch_img;
 	int16_t picture_id;
+
+	/* encoder cpu budget, see vpx_budget */
+	int enc_threads;
+	int enc_thread_cut;
+	switch_time_t enc_thread_changed;
+	int cpuused;
+	int cpuused_cfg;
+	switch_time_t encode_last;
+	switch_time_t encode_avg;
+	switch_time_t encode_max;
+	uint64_t encode_frames;
+	uint64_t drop_frames;
+	switch_time_t load_check;
+	switch_time_t load_us;
+	switch_time_t load_share;
+	int budgeted;
+	struct vpx_context *next;
 };
 typedef struct vpx_context vpx_context_t;
 
@@ -432,12 +452,23 @@ struct vpx_globals {
 
 	uint32_t dec_threads;
 	uint32_t enc_threads;
+	uint32_t cpu_budget;
+	uint32_t enc_load_threshold;
 
 	my_vpx_cfg_t *profiles[MAX_PROFILES];
 };
 
 struct vpx_globals vpx_globals = { 0 };
 
+/* encoder threads handed out and encode time spent by all streams, survives "vpx reload" unlike vpx_globals */
+static struct {
+	switch_mutex_t *mutex;
+	uint32_t threads_used;
+	switch_time_t load_us;
+	uint32_t load_pct;
+	vpx_context_t *encoders;
+} vpx_budget;
+
 static my_vpx_cfg_t *find_cfg_profile(const char *name, switch_bool_t reconfig);
 static void parse_profile(my_vpx_cfg_t *my_cfg, switch_xml_t profile, int codec_type);
 
@@ -539,6 +570,127 @@ static void parse_codec_specific_profile(my_vpx_cfg_t *my_cfg, const char *codec
 	if (xml) switch_xml_free(xml);
 }
 
+static int vpx_size_threads(int width, int height)
+{
+	int pixels = width * height;
+
+	if (pixels >= 1920 * 1080) return ENC_THREADS_MAX;
+	if (pixels >= 1280 * 720) return 4;
+	if (pixels >= 640 * 360) return 2;
+
+	return 1;
+}
+
+/* trade the threads this encoder holds for the ones its frame size asks for, as far as the budget goes */
+static int vpx_budget_threads(vpx_context_t *context, int width, int height)
+{
+	int wanted = vpx_size_threads(width, height) >> context->enc_thread_cut;
+	int avail;
+
+	if (wanted < 1) wanted = 1;
+
+	switch_mutex_lock(vpx_budget.mutex);
+	vpx_budget.threads_used -= context->enc_threads;
+	avail = (int)vpx_globals.cpu_budget - (int)vpx_budget.threads_used;
+	context->enc_threads = wanted < avail ? wanted : avail;
+	if (context->enc_threads < 1) context->enc_threads = 1;
+	vpx_budget.threads_used += context->enc_threads;
+	switch_mutex_unlock(vpx_budget.mutex);
+
+	return context->enc_threads;
+}
+
+static void vpx_budget_add(vpx_context_t *context)
+{
+	if (context->budgeted) return;
+
+	switch_mutex_lock(vpx_budget.mutex);
+	context->next = vpx_budget.encoders;
+	vpx_budget.encoders = context;
+	context->budgeted = 1;
+	switch_mutex_unlock(vpx_budget.mutex);
+}
+
+static void vpx_budget_del(vpx_context_t *context)
+{
+	vpx_context_t *cp, *last = NULL;
+
+	if (!context->budgeted && !context->enc_threads) return;
+
+	switch_mutex_lock(vpx_budget.mutex);
+	for (cp = context->budgeted ? vpx_budget.encoders : NULL; cp; last = cp, cp = cp->next) {
+		if (cp == context) {
+			if (last) {
+				last->next = cp->next;
+			} else {
+				vpx_budget.encoders = cp->next;
+			}
+			break;
+		}
+	}
+	vpx_budget.threads_used -= context->enc_threads;
+	vpx_budget.load_us -= context->load_share;
+	context->enc_threads = 0;
+	context->load_share = 0;
+	context->budgeted = 0;
+	switch_mutex_unlock(vpx_budget.mutex);
+}
+
+/* once a second: publish this stream's encode time and trade speed for cpu while all encoders together run over the threshold */
+static void vpx_budget_check(switch_codec_t *codec, switch_time_t now)
+{
+	vpx_context_t *context = (vpx_context_t *)codec->private_info;
+	int max_speed = context->is_vp9 ? 9 : 16;
+	int sign = context->cpuused_cfg < 0 ? -1 : 1;
+	int speed = abs(context->cpuused);
+	uint32_t pct;
+
+	if (!context->load_check) {
+		context->load_check = now;
+		return;
+	}
+
+	if (now - context->load_check < 1000000) return;
+
+	switch_mutex_lock(vpx_budget.mutex);
+	vpx_budget.load_us += context->load_us - context->load_share;
+	context->load_share = context->load_us;
+	pct = vpx_globals.cpu_budget ? (uint32_t)(vpx_budget.load_us * 100 / ((switch_time_t)vpx_globals.cpu_budget * (now - context->load_check))) : 0;
+	vpx_budget.load_pct = pct;
+	switch_mutex_unlock(vpx_budget.mutex);
+
+	context->load_check = now;
+	context->load_us = 0;
+
+	if (!vpx_globals.cpu_budget) return;
+
+	if (pct > vpx_globals.enc_load_threshold) {
+		if (speed < max_speed) {
+			speed++;
+		} else if (context->enc_threads > 1 && now - context->enc_thread_changed > ENC_THREAD_CHANGE_MIN_FREQ) {
+			/* already as fast as it goes, stop oversubscribing the cores */
+			context->enc_thread_cut++;
+			context->enc_thread_changed = now;
+			context->need_encoder_reset = 1;
+		}
+	} else if (pct < vpx_globals.enc_load_threshold * 3 / 4) {
+		if (context->enc_thread_cut && now - context->enc_thread_changed > ENC_THREAD_CHANGE_MIN_FREQ) {
+			context->enc_thread_cut--;
+			context->enc_thread_changed = now;
+			context->need_encoder_reset = 1;
+		} else if (speed > abs(context->cpuused_cfg)) {
+			speed--;
+		}
+	}
+
+	if (speed * sign != context->cpuused) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(codec->session), VPX_SWITCH_LOG_LEVEL,
+						  "VPX encoder load %u%%, cpu-used %d -> %d\n", pct, context->cpuused, speed * sign);
+		context->cpuused = speed * sign;
+		vpx_codec_control(&context->encoder, VP8E_SET_CPUUSED, context->cpuused);
+	}
+}
+
 static switch_status_t init_encoder(switch_codec_t *codec)
 {
 	vpx_context_t *context = (vpx_context_t *)codec->private_info;
@@ -610,6 +762,18 @@ static switch_status_t init_encoder(switch_codec_t *codec)
 	config->g_h = context->codec_settings.video.height;
 	config->rc_target_bitrate = context->bandwidth;
 
+	/* no enc-threads in the profile: the cpu budget decides, libvpx can't change threads without a new encoder */
+	if (!config->g_threads && vpx_globals.cpu_budget) {
+		if (!context->encoder_init) {
+			vpx_budget_threads(context, config->g_w, config->g_h);
+		}
+		config->g_threads = context->enc_threads;
+	}
+
+	if (!config->g_threads) {
+		config->g_threads = 1;
+	}
+
 	if (context->is_vp9) {
 		if (my_cfg->lossless) {
 			config->rc_min_quantizer = 0;
@@ -640,9 +804,15 @@ static switch_status_t init_encoder(switch_codec_t *codec)
 		}
 
 		context->encoder_init = 1;
+		vpx_budget_add(context);
+
+		/* a reset keeps the speed the load check got to */
+		if (!context->cpuused || context->cpuused_cfg != my_cfg->cpuused) {
+			context->cpuused = context->cpuused_cfg = my_cfg->cpuused;
+		}
 
 		vpx_codec_control(&context->encoder, VP8E_SET_TOKEN_PARTITIONS, my_cfg->token_parts);
-		vpx_codec_control(&context->encoder, VP8E_SET_CPUUSED, my_cfg->cpuused);
+		vpx_codec_control(&context->encoder, VP8E_SET_CPUUSED, context->cpuused);
 		vpx_codec_control(&context->encoder, VP8E_SET_STATIC_THRESHOLD, my_cfg->static_thresh);
 
 		if (context->is_vp9) {
@@ -650,6 +820,18 @@ static switch_status_t init_encoder(switch_codec_t *codec)
 				vpx_codec_control(&context->encoder, VP9E_SET_LOSSLESS, 1);
 			}
 
+			if (config->g_threads > 1) {
+				int tiles = 0;
+
+				/* tiles are at least 256 pixels wide */
+				while ((2 << tiles) <= (int)config->g_threads && (256 << (tiles + 1)) <= (int)config->g_w) {
+					tiles++;
+				}
+
+				vpx_codec_control(&context->encoder, VP9E_SET_TILE_COLUMNS, tiles);
+				vpx_codec_control(&context->encoder, VP9E_SET_ROW_MT, 1);
+			}
+
 			vpx_codec_control(&context->encoder, VP9E_SET_TUNE_CONTENT, my_cfg->tune_content);
 		} else {
 			vpx_codec_control(&context->encoder, VP8E_SET_NOISE_SENSITIVITY, my_cfg->noise_sensitivity);
@@ -676,6 +858,7 @@ static switch_status_t switch_vpx_init(switch_codec_t *codec, switch_codec_flag_
 	}
 
 	memset(context, 0, sizeof(*context));
+	context->codec = codec;
 	context->flags = flags;
 	codec->private_info = context;
 	context->pool = codec->memory_pool;
@@ -889,6 +1072,7 @@ static switch_status_t reset_codec_encoder(switch_codec_t *codec)
 	if (context->encoder_init) {
 		vpx_codec_destroy(&context->encoder);
 	}
+	vpx_budget_del(context);
 	context->last_ts = 0;
 	context->last_ms = 0;
 	context->framecount = 0;
@@ -907,6 +1091,7 @@ static switch_status_t switch_vpx_encode(switch_codec_t *codec, switch_frame_t *
 	vpx_enc_frame_flags_t vpx_flags = 0;
 	switch_time_t now;
 	vpx_codec_err_t err;
+	switch_status_t status;
 
 	if (frame->flags & SFF_SAME_IMAGE) {
 		return consume_partition(context, frame);
@@ -969,14 +1154,25 @@ static switch_status_t switch_vpx_encode(switch_codec_t *codec, switch_frame_t *
 
 	dur = context->last_ms ? (now - context->last_ms) / 1000 : pts;
 
-	if ((err = vpx_codec_encode(&context->encoder,
+	err = vpx_codec_encode(&context->encoder,
 						 (vpx_image_t *) frame->img,
 						 pts,
 						 dur,
 						 vpx_flags,
-						 VPX_DL_REALTIME)) != VPX_CODEC_OK) {
+						 VPX_DL_REALTIME);
+
+	context->encode_last = switch_time_now() - now;
+	context->encode_avg = context->encode_avg ? (context->encode_avg * 15 + context->encode_last) / 16 : context->encode_last;
+	if (context->encode_last > context->encode_max) context->encode_max = context->encode_last;
+	context->encode_frames++;
+	context->load_us += context->encode_last;
+
+	vpx_budget_check(codec, now);
+
+	if (err != VPX_CODEC_OK) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(codec->session), SWITCH_LOG_ERROR, "VPX encode error [%d:%s:%s]\n",
 			err, vpx_codec_error(&context->encoder), vpx_codec_error_detail(&context->encoder));
+		context->drop_frames++;
 		frame->datalen = 0;
 		return SWITCH_STATUS_FALSE;
 	}
@@ -985,7 +1181,14 @@ static switch_status_t switch_vpx_encode(switch_codec_t *codec, switch_frame_t *
 	context->last_ts = frame->timestamp;
 	context->last_ms = now;
 
-	return consume_partition(context, frame);
+	status = consume_partition(context, frame);
+
+	/* the rate control skipped the frame */
+	if (!frame->datalen) {
+		context->drop_frames++;
+	}
+
+	return status;
 }
 
 static switch_status_t buffer_vp8_packets(vpx_context_t *context, switch_frame_t *frame)
@@ -1494,6 +1697,7 @@ static switch_status_t switch_vpx_destroy(switch_codec_t *codec)
 		switch_img_free(&context->patch_img);
 
 		if ((codec->flags & SWITCH_CODEC_FLAG_ENCODE)) {
+			vpx_budget_del(context);
 			vpx_codec_destroy(&context->encoder);
 		}
 
@@ -1863,6 +2067,8 @@ static void load_config(void)
 	vpx_globals.max_bitrate = switch_calc_bitrate(1920, 1080, 5, 60);
 	vpx_globals.rtp_slice_size = SLICE_SIZE;
 	vpx_globals.key_frame_min_freq = KEY_FRAME_MIN_FREQ;
+	vpx_globals.cpu_budget = switch_core_cpu_count();
+	vpx_globals.enc_load_threshold = ENC_LOAD_THRESHOLD;
 
 	xml = switch_xml_open_cfg("vpx.conf", &cfg, NULL);
 
@@ -1894,6 +2100,14 @@ static void load_config(void)
 				} else if (!strcmp(name, "enc-threads")) {
 					int val = switch_parse_cpu_string(value);
 					_VPX_CHECK_MIN(vpx_globals.enc_threads, val, 1);
+				} else if (!strcmp(name, "cpu-budget")) {
+					if (switch_false(value)) {
+						vpx_globals.cpu_budget = 0;
+					} else {
+						_VPX_CHECK_MIN(vpx_globals.cpu_budget, switch_parse_cpu_string(value), 1);
+					}
+				} else if (!strcmp(name, "enc-load-threshold")) {
+					_VPX_CHECK_MIN_MAX(vpx_globals.enc_load_threshold, atoi(value), 10, 100);
 				}
 			}
 		}
@@ -1935,19 +2149,19 @@ static void load_config(void)
 	my_cfg = find_cfg_profile("vp8", SWITCH_FALSE);
 
 	if (my_cfg) {
-		if (!my_cfg->enc_cfg.g_threads) my_cfg->enc_cfg.g_threads = 1;
+		if (!my_cfg->enc_cfg.g_threads && !vpx_globals.cpu_budget) my_cfg->enc_cfg.g_threads = 1;
 		if (!my_cfg->dec_cfg.threads) my_cfg->dec_cfg.threads = switch_parse_cpu_string("cpu/2/4");
 	}
 
 	my_cfg = find_cfg_profile("vp9", SWITCH_FALSE);
 
 	if (my_cfg) {
-		if (!my_cfg->enc_cfg.g_threads) my_cfg->enc_cfg.g_threads = 1;
+		if (!my_cfg->enc_cfg.g_threads && !vpx_globals.cpu_budget) my_cfg->enc_cfg.g_threads = 1;
 		if (!my_cfg->dec_cfg.threads) my_cfg->dec_cfg.threads = switch_parse_cpu_string("cpu/2/4");
 	}
 }
 
-#define VPX_API_SYNTAX "<reload|debug <on|off>>"
+#define VPX_API_SYNTAX "<reload|status|debug <on|off>>"
 SWITCH_STANDARD_API(vpx_api_function)
 {
 	if (session) {
@@ -1988,6 +2202,23 @@ SWITCH_STANDARD_API(vpx_api_function)
 		}
 
 		stream->write_function(stream, "+OK\n");
+	} else if (!strcasecmp(cmd, "status")) {
+		vpx_context_t *cp;
+
+		switch_mutex_lock(vpx_budget.mutex);
+		stream->write_function(stream, "cpu-budget: %u threads, %u used, encode load %u%% (threshold %u%%)\n",
+							   vpx_globals.cpu_budget, vpx_budget.threads_used, vpx_budget.load_pct, vpx_globals.enc_load_threshold);
+
+		for (cp = vpx_budget.encoders; cp; cp = cp->next) {
+			switch_core_session_t *session = cp->codec ? cp->codec->session : NULL;
+
+			stream->write_function(stream, "%s %s %dx%d threads %d cpu-used %d encode avg %" SWITCH_TIME_T_FMT "us max %" SWITCH_TIME_T_FMT
+								   "us frames %" SWITCH_UINT64_T_FMT " dropped %" SWITCH_UINT64_T_FMT "\n",
+								   session ? switch_core_session_get_uuid(session) : "-", cp->is_vp9 ? "VP9" : "VP8",
+								   cp->config.g_w, cp->config.g_h, cp->enc_threads ? cp->enc_threads : (int)cp->config.g_threads, cp->cpuused,
+								   cp->encode_avg, cp->encode_max, cp->encode_frames, cp->drop_frames);
+		}
+		switch_mutex_unlock(vpx_budget.mutex);
 	} else if (!strcasecmp(cmd, "debug")) {
 		stream->write_function(stream, "+OK debug %s\n", vpx_globals.debug ? "on" : "off");
 	} else if (!strcasecmp(cmd, "debug on")) {
@@ -2011,6 +2242,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_vpx_load)
 	switch_api_interface_t *vpx_api_interface;
 
 	memset(&vpx_globals, 0, sizeof(struct vpx_globals));
+	memset(&vpx_budget, 0, sizeof(vpx_budget));
+	switch_mutex_init(&vpx_budget.mutex, SWITCH_MUTEX_NESTED, pool);
 	load_config();
 
 	/* connect my internal structure to the blank pointer passed to me */
@@ -2027,6 +2260,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_vpx_load)
 				   "VPX API", vpx_api_function, VPX_API_SYNTAX);
 
 	switch_console_set_complete("add vpx reload");
+	switch_console_set_complete("add vpx status");
 	switch_console_set_complete("add vpx debug");
 	switch_console_set_complete("add vpx debug on");
 	switch_console_set_complete("add vpx debug off");
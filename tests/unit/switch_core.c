@@ -38,6 +38,62 @@
 
 #define ENABLE_SNPRINTFV_TESTS 0 /* Do not turn on for CI as this requires a lot of RAM */
 
+static switch_atomic_t pool_jobs_done;
+
+static void *SWITCH_THREAD_FUNC pool_job(switch_thread_t *thread, void *obj)
+{
+	switch_atomic_inc(&pool_jobs_done);
+	return NULL;
+}
+
+static switch_mutex_t *pool_task_mutex;
+static int pool_tasks_running, pool_tasks_peak;
+
+static void *SWITCH_THREAD_FUNC pool_task(switch_thread_t *thread, void *obj)
+{
+	switch_mutex_lock(pool_task_mutex);
+	if (++pool_tasks_running > pool_tasks_peak) {
+		pool_tasks_peak = pool_tasks_running;
+	}
+	switch_mutex_unlock(pool_task_mutex);
+
+	if (obj) {
+		switch_yield(*(int *) obj);
+	}
+
+	switch_mutex_lock(pool_task_mutex);
+	pool_tasks_running--;
+	switch_mutex_unlock(pool_task_mutex);
+
+	switch_atomic_inc(&pool_jobs_done);
+	return NULL;
+}
+
+static uint32_t pool_tasks_run(void)
+{
+	switch_stream_handle_t stream = { 0 };
+	const char *p;
+	uint32_t tasks = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_core_session_debug_pool(&stream);
+	if ((p = strstr((char *) stream.data, "tasks:"))) {
+		tasks = atoi(p + 6);
+	}
+	switch_safe_free(stream.data);
+
+	return tasks;
+}
+
+static void pool_wait_jobs(int jobs)
+{
+	int loops = 0;
+
+	while (switch_atomic_read(&pool_jobs_done) < (uint32_t) jobs && ++loops < 500) {
+		switch_yield(10000);
+	}
+}
+
 FST_CORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_core)
@@ -53,6 +109,115 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEARDOWN_END()
 
+		FST_TEST_BEGIN(test_thread_pool_launch_thread)
+		{
+			int i, jobs = 1000, loops = 0;
+
+			switch_atomic_set(&pool_jobs_done, 0);
+
+			for (i = 0; i < jobs; i++) {
+				switch_thread_data_t *td;
+
+				switch_zmalloc(td, sizeof(*td));
+				td->func = pool_job;
+				td->alloc = 1;
+				fst_check(switch_thread_pool_launch_thread(&td) == SWITCH_STATUS_SUCCESS);
+				fst_check(td == NULL);
+			}
+
+			while (switch_atomic_read(&pool_jobs_done) < (uint32_t) jobs && ++loops < 500) {
+				switch_yield(10000);
+			}
+
+			fst_check(switch_atomic_read(&pool_jobs_done) == (uint32_t) jobs);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_thread_pool_work_stealing)
+		{
+			int i, jobs = 1000;
+			uint32_t tasks = pool_tasks_run();
+
+			switch_mutex_init(&pool_task_mutex, SWITCH_MUTEX_NESTED, fst_pool);
+			pool_tasks_running = pool_tasks_peak = 0;
+			switch_atomic_set(&pool_jobs_done, 0);
+
+			fst_check(switch_core_session_thread_pool_config(SWITCH_TRUE, 64 * 1024, 0) == SWITCH_STATUS_FALSE);
+			fst_requires(switch_core_session_thread_pool_config(SWITCH_TRUE, 0, 2) == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < jobs; i++) {
+				switch_thread_data_t *td;
+
+				switch_zmalloc(td, sizeof(*td));
+				td->func = pool_task;
+				td->alloc = 1;
+				fst_check(switch_thread_pool_launch_task(&td) == SWITCH_STATUS_SUCCESS);
+				fst_check(td == NULL);
+			}
+
+			pool_wait_jobs(jobs);
+
+			fst_check(switch_atomic_read(&pool_jobs_done) == (uint32_t) jobs);
+			fst_check(pool_tasks_peak <= 2);
+			fst_check(pool_tasks_run() >= tasks + jobs);
+
+			fst_requires(switch_core_session_thread_pool_config(SWITCH_FALSE, 0, 0) == SWITCH_STATUS_SUCCESS);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_thread_pool_mode_change_migrates_jobs)
+		{
+			int i, jobs = 50, delay = 10000;
+
+			switch_atomic_set(&pool_jobs_done, 0);
+			fst_requires(switch_core_session_thread_pool_config(SWITCH_TRUE, 0, 1) == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < jobs; i++) {
+				switch_thread_data_t *td;
+
+				switch_zmalloc(td, sizeof(*td));
+				td->func = pool_task;
+				td->obj = &delay;
+				td->alloc = 1;
+				fst_check(switch_thread_pool_launch_task(&td) == SWITCH_STATUS_SUCCESS);
+			}
+
+			/* one worker at 10ms a job leaves most of them queued in the deques */
+			fst_requires(switch_core_session_thread_pool_config(SWITCH_FALSE, 0, 0) == SWITCH_STATUS_SUCCESS);
+
+			pool_wait_jobs(jobs);
+			fst_check(switch_atomic_read(&pool_jobs_done) == (uint32_t) jobs);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_thread_pool_work_stealing_session)
+		{
+			switch_core_session_t *session = NULL;
+			switch_call_cause_t cause;
+			uint32_t tasks = pool_tasks_run(), sessions = switch_core_session_count();
+			int loops = 0;
+
+			fst_requires(switch_core_session_thread_pool_config(SWITCH_TRUE, 0, 2) == SWITCH_STATUS_SUCCESS);
+
+			fst_requires(switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL) == SWITCH_STATUS_SUCCESS);
+			fst_requires(session);
+			fst_check(switch_channel_up(switch_core_session_get_channel(session)));
+
+			switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+			switch_core_session_rwunlock(session);
+
+			while (switch_core_session_count() > sessions && ++loops < 500) {
+				switch_yield(10000);
+			}
+
+			/* init, routing, hangup and reporting ran as state machine tasks on the pool */
+			fst_check(switch_core_session_count() == sessions);
+			fst_check(pool_tasks_run() > tasks);
+
+			fst_requires(switch_core_session_thread_pool_config(SWITCH_FALSE, 0, 0) == SWITCH_STATUS_SUCCESS);
+		}
+		FST_TEST_END()
+
 		FST_TEST_BEGIN(test_switch_rand)
 		{
 			int i, c = 0;
@@ -34,6 +34,44 @@
 
 #include <test/switch_test.h>
 
+// #define BENCHMARK 1
+
+static switch_status_t xcode_codec(switch_codec_t *codec, const char *name, uint32_t rate, switch_memory_pool_t *pool)
+{
+	return switch_core_codec_init(codec, name, NULL, NULL, rate, 20, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL, pool);
+}
+
+/* decoded 20ms of a 1kHz tone at 8kHz, encoded with codec */
+static uint32_t xcode_tone(switch_codec_t *codec, int frame, uint8_t *out)
+{
+	int16_t lin[160];
+	uint32_t len = SWITCH_RECOMMENDED_BUFFER_SIZE, rate = 8000, flags = 0;
+	int i;
+
+	for (i = 0; i < 160; i++) {
+		lin[i] = (int16_t) (10000 * sin(2 * M_PI * 1000 * (frame * 160 + i) / 8000.0));
+	}
+
+	switch_core_codec_encode(codec, NULL, lin, sizeof(lin), 8000, out, &len, &rate, &flags);
+
+	return len;
+}
+
+static double xcode_energy(switch_codec_t *codec, uint8_t *in, uint32_t in_len)
+{
+	int16_t lin[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	uint32_t len = sizeof(lin), rate = 0, flags = 0, i;
+	double energy = 0;
+
+	switch_core_codec_decode(codec, NULL, in, in_len, 8000, lin, &len, &rate, &flags);
+
+	for (i = 0; i < len / 2; i++) {
+		energy += (double) lin[i] * lin[i];
+	}
+
+	return energy / (len / 2);
+}
+
 FST_CORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_core_codec)
@@ -153,6 +191,152 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(test_mod_opus_status)
+		{
+			int16_t inbuf[960] = { 0 };
+			unsigned char outbuf[SWITCH_RECOMMENDED_BUFFER_SIZE] = { 0 };
+			uint32_t encoded_len, encoded_rate = 48000;
+			unsigned int flags = 0;
+			switch_codec_t codec = { 0 };
+			switch_status_t status;
+			switch_codec_settings_t codec_settings = { { 0 } };
+			switch_stream_handle_t stream = { 0 };
+			int i;
+
+			status = switch_core_codec_init(&codec,
+											"OPUS",
+											"mod_opus",
+											NULL,
+											48000,
+											20,
+											1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE,
+											&codec_settings, fst_pool);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < 10; i++) {
+				encoded_len = sizeof(outbuf);
+				status = switch_core_codec_encode(&codec, NULL, inbuf, sizeof(inbuf), 48000, outbuf, &encoded_len, &encoded_rate, &flags);
+				fst_check(status == SWITCH_STATUS_SUCCESS);
+			}
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("opus_status", NULL, NULL, &stream);
+			fst_check(strstr((char *)stream.data, "encoders 1 ") != NULL);
+			fst_check(strstr((char *)stream.data, "20ms complexity") != NULL);
+			fst_check(strstr((char *)stream.data, "frames 10\n") != NULL);
+			switch_safe_free(stream.data);
+
+			switch_core_codec_destroy(&codec);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_direct_transcode)
+		{
+			switch_codec_t pcmu = { 0 }, pcma = { 0 }, g722 = { 0 }, g722_back = { 0 }, pcmu_back = { 0 };
+			switch_xcode_t xc_ua = { 0 }, xc_ug = { 0 }, xc_gu = { 0 }, xc_none = { 0 };
+			switch_audio_resampler_t *resampler = NULL;
+			uint8_t in[SWITCH_RECOMMENDED_BUFFER_SIZE], mid[SWITCH_RECOMMENDED_BUFFER_SIZE], out[SWITCH_RECOMMENDED_BUFFER_SIZE];
+			int16_t lin[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+			uint32_t in_len, mid_len, out_len, len, rate, flags = 0;
+			double in_energy, out_energy;
+			switch_time_t start;
+			int i, loops;
+
+#ifdef BENCHMARK
+			loops = 100000;
+#else
+			loops = 10;
+#endif
+
+			fst_requires(xcode_codec(&pcmu, "PCMU", 8000, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(xcode_codec(&pcmu_back, "PCMU", 8000, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(xcode_codec(&pcma, "PCMA", 8000, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(xcode_codec(&g722, "G722", 8000, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(xcode_codec(&g722_back, "G722", 8000, fst_pool) == SWITCH_STATUS_SUCCESS);
+
+			fst_check(switch_core_media_xcode_select(&xc_ua, pcmu.implementation, pcma.implementation) == SWITCH_XCODE_ULAW_ALAW);
+			fst_check(switch_core_media_xcode_select(&xc_ug, pcmu.implementation, g722.implementation) == SWITCH_XCODE_G711_WIDE);
+			fst_check(switch_core_media_xcode_select(&xc_gu, g722.implementation, pcmu.implementation) == SWITCH_XCODE_WIDE_G711);
+			fst_check(switch_core_media_xcode_select(&xc_none, pcmu.implementation, pcmu.implementation) == SWITCH_XCODE_NONE);
+
+			in_len = xcode_tone(&pcmu, 0, in);
+			fst_requires(in_len == 160);
+			in_energy = xcode_energy(&pcmu, in, in_len);
+
+			out_len = sizeof(out);
+			fst_check(switch_core_media_xcode(&xc_ua, &pcmu, &pcma, in, in_len, out, &out_len) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(out_len, 160);
+			out_energy = xcode_energy(&pcma, out, out_len);
+			fst_check(out_energy > in_energy * 0.9 && out_energy < in_energy * 1.1);
+
+			/* PCMU -> G722 -> PCMU, both legs direct */
+			for (i = 0; i < 10; i++) {
+				in_len = xcode_tone(&pcmu, i, in);
+				mid_len = sizeof(mid);
+				fst_check(switch_core_media_xcode(&xc_ug, &pcmu, &g722, in, in_len, mid, &mid_len) == SWITCH_STATUS_SUCCESS);
+				fst_check_int_equals(mid_len, 160);
+				out_len = sizeof(out);
+				fst_check(switch_core_media_xcode(&xc_gu, &g722_back, &pcmu_back, mid, mid_len, out, &out_len) == SWITCH_STATUS_SUCCESS);
+				fst_check_int_equals(out_len, 160);
+			}
+
+			out_energy = xcode_energy(&pcmu_back, out, out_len);
+			fst_check(out_energy > in_energy * 0.5 && out_energy < in_energy * 2);
+
+			/* direct matrix against the generic decode, resample, encode chain */
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				out_len = sizeof(out);
+				switch_core_media_xcode(&xc_ua, &pcmu, &pcma, in, in_len, out, &out_len);
+			}
+#ifdef BENCHMARK
+			printf("direct PCMU->PCMA: %.3f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				len = sizeof(lin);
+				switch_core_codec_decode(&pcmu, &pcma, in, in_len, 8000, lin, &len, &rate, &flags);
+				out_len = sizeof(out);
+				switch_core_codec_encode(&pcma, &pcmu, lin, len, 8000, out, &out_len, &rate, &flags);
+			}
+#ifdef BENCHMARK
+			printf("generic PCMU->PCMA: %.3f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				mid_len = sizeof(mid);
+				switch_core_media_xcode(&xc_ug, &pcmu, &g722, in, in_len, mid, &mid_len);
+			}
+#ifdef BENCHMARK
+			printf("direct PCMU->G722: %.3f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			fst_requires(switch_resample_create(&resampler, 8000, 16000, 640, SWITCH_RESAMPLE_QUALITY, 1) == SWITCH_STATUS_SUCCESS);
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				len = sizeof(lin);
+				switch_core_codec_decode(&pcmu, &g722, in, in_len, 8000, lin, &len, &rate, &flags);
+				switch_resample_process(resampler, lin, len / 2);
+				memcpy(lin, resampler->to, resampler->to_len * 2);
+				mid_len = sizeof(mid);
+				switch_core_codec_encode(&g722, &pcmu, lin, resampler->to_len * 2, 16000, mid, &mid_len, &rate, &flags);
+			}
+#ifdef BENCHMARK
+			printf("generic PCMU->G722: %.3f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+			fst_check_int_equals(mid_len, 160);
+			switch_resample_destroy(&resampler);
+
+			switch_core_codec_destroy(&pcmu);
+			switch_core_codec_destroy(&pcmu_back);
+			switch_core_codec_destroy(&pcma);
+			switch_core_codec_destroy(&g722);
+			switch_core_codec_destroy(&g722_back);
+		}
+		FST_TEST_END()
+
 	}
 	FST_SUITE_END()
 }
@@ -34,6 +34,8 @@
 
 #include <test/switch_test.h>
 
+// #define BENCHMARK 1
+
 int max_rows = 150;
 
 int status = 0;
@@ -46,6 +48,72 @@ int table_count_func(void *pArg, int argc, char **argv, char **columnNames){
 	return -1;
 }
 
+typedef struct {
+	char *ddl[32];
+	int count;
+} schema_t;
+
+static int schema_func(void *pArg, int argc, char **argv, char **columnNames)
+{
+	schema_t *schema = (schema_t *) pArg;
+
+	if (argc > 0 && argv[0] && schema->count < 32) {
+		schema->ddl[schema->count++] = strdup(argv[0]);
+	}
+
+	return 0;
+}
+
+static switch_time_t core_channel_load(switch_sql_queue_manager_t *qm, const char *prefix, int calls, switch_bool_t params)
+{
+	switch_time_t start = switch_time_now();
+	char uuid[64], other[64], name[64], epoch[32];
+	int i;
+
+	switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+
+	/* the statements core_event_handler queues over a call's life: create, execute, state change, bridge */
+	for (i = 0; i < calls; i++) {
+		switch_snprintf(uuid, sizeof(uuid), "%s-a-%d", prefix, i);
+		switch_snprintf(other, sizeof(other), "%s-b-%d", prefix, i);
+		switch_snprintf(name, sizeof(name), "sofia/internal/%d@test", i);
+
+		if (params) {
+			const char *create[] = { uuid, "inbound", "2024-01-01 00:00:00", epoch, name, "CS_INIT", "DOWN", "XML", "default", "bench",
+									 "Bench", "1000", "127.0.0.1", "2000", "XML", "default" };
+			const char *execute[] = { "park", "", "1000@test", "", "", uuid };
+			const char *state[] = { "CS_EXECUTE", uuid };
+			const char *call[] = { uuid, "2024-01-01 00:00:00", epoch, uuid, other, "bench" };
+
+			switch_sql_queue_manager_push_params(qm, "insert into channels (uuid,direction,created,created_epoch, name,state,callstate,dialplan,context,hostname,"
+												 "initial_cid_name,initial_cid_num,initial_ip_addr,initial_dest,initial_dialplan,initial_context) "
+												 "values(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)", 0, 16, create);
+			switch_sql_queue_manager_push_params(qm, "update channels set application=?,application_data=?,"
+												 "presence_id=?,presence_data=?,accountcode=? where uuid=?", 0, 6, execute);
+			switch_sql_queue_manager_push_params(qm, "update channels set state=? where uuid=?", 0, 2, state);
+			switch_sql_queue_manager_push_params(qm, "insert into calls (call_uuid,call_created,call_created_epoch,"
+												 "caller_uuid,callee_uuid,hostname) values (?,?,?,?,?,?)", 0, 6, call);
+		} else {
+			switch_sql_queue_manager_push(qm, switch_mprintf("insert into channels (uuid,direction,created,created_epoch, name,state,callstate,dialplan,context,hostname,"
+															 "initial_cid_name,initial_cid_num,initial_ip_addr,initial_dest,initial_dialplan,initial_context) "
+															 "values('%q','inbound','2024-01-01 00:00:00','%q','%q','CS_INIT','DOWN','XML','default','bench',"
+															 "'Bench','1000','127.0.0.1','2000','XML','default')", uuid, epoch, name), 0, SWITCH_FALSE);
+			switch_sql_queue_manager_push(qm, switch_mprintf("update channels set application='park',application_data='',"
+															 "presence_id='1000@test',presence_data='',accountcode='' where uuid='%q'", uuid), 0, SWITCH_FALSE);
+			switch_sql_queue_manager_push(qm, switch_mprintf("update channels set state='CS_EXECUTE' where uuid='%q'", uuid), 0, SWITCH_FALSE);
+			switch_sql_queue_manager_push(qm, switch_mprintf("insert into calls (call_uuid,call_created,call_created_epoch,"
+															 "caller_uuid,callee_uuid,hostname) values ('%q','2024-01-01 00:00:00','%q','%q','%q','bench')",
+															 uuid, epoch, uuid, other), 0, SWITCH_FALSE);
+		}
+	}
+
+	while (switch_sql_queue_manager_size(qm, 0)) {
+		switch_yield(1000);
+	}
+
+	return switch_time_now() - start;
+}
+
 FST_CORE_DB_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_core_db)
@@ -118,6 +186,160 @@ FST_CORE_DB_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(test_switch_cache_db_queue_manager_params)
+		{
+			switch_sql_queue_manager_t *qm = NULL;
+			switch_sql_queue_manager_stats_t stats = { 0 };
+			const char *argv[3];
+			char uuid[64], state[32];
+			switch_time_t start, raw_took, params_took;
+			int i, calls = 1000;
+
+			switch_sql_queue_manager_init_name("TEST",
+				&qm,
+				2,
+				"test_switch_cache_db_queue_manager_params",
+				SWITCH_MAX_TRANS,
+				NULL, NULL, NULL, NULL);
+
+			switch_sql_queue_manager_start(qm);
+
+			switch_sql_queue_manager_push_confirm(qm, "DROP TABLE IF EXISTS ch;", 0, SWITCH_TRUE);
+			switch_sql_queue_manager_push_confirm(qm, "CREATE TABLE ch (uuid VARCHAR(255), state VARCHAR(64), name VARCHAR(1024));", 0, SWITCH_TRUE);
+
+			/* the same channel create/update/hangup load, first as formatted text, then as parameterized statements */
+			start = switch_time_now();
+			for (i = 0; i < calls; i++) {
+				switch_snprintf(uuid, sizeof(uuid), "raw-%d", i);
+				switch_sql_queue_manager_push(qm, switch_mprintf("INSERT INTO ch (uuid, state, name) VALUES ('%q', 'CS_NEW', 'sofia/internal/%d@test');", uuid, i), 0, SWITCH_FALSE);
+				switch_sql_queue_manager_push(qm, switch_mprintf("UPDATE ch SET state='CS_EXECUTE' WHERE uuid='%q';", uuid), 0, SWITCH_FALSE);
+			}
+			while (switch_sql_queue_manager_size(qm, 0)) {
+				switch_yield(1000);
+			}
+			raw_took = switch_time_now() - start;
+
+			start = switch_time_now();
+			for (i = 0; i < calls; i++) {
+				switch_snprintf(uuid, sizeof(uuid), "params-%d", i);
+				switch_snprintf(state, sizeof(state), "sofia/internal/%d@test", i);
+				argv[0] = uuid;
+				argv[1] = "CS_NEW";
+				argv[2] = state;
+				switch_sql_queue_manager_push_params(qm, "INSERT INTO ch (uuid, state, name) VALUES (?, ?, ?);", 1, 3, argv);
+				argv[0] = "CS_EXECUTE";
+				argv[1] = uuid;
+				switch_sql_queue_manager_push_params(qm, "UPDATE ch SET state=? WHERE uuid=?;", 1, 2, argv);
+			}
+			while (switch_sql_queue_manager_size(qm, 1)) {
+				switch_yield(1000);
+			}
+			params_took = switch_time_now() - start;
+
+			switch_sleep(500 * 1000);
+
+			switch_sql_queue_manager_execute_sql_callback(qm, "SELECT COUNT(*) FROM ch WHERE state='CS_EXECUTE';", table_count_func, NULL);
+			fst_check_int_equals(status, calls * 2);
+
+			/* NULL parameters and quotes survive the round trip */
+			argv[0] = "it's";
+			argv[1] = NULL;
+			switch_sql_queue_manager_push_params(qm, "INSERT INTO ch (uuid, state) VALUES (?, ?);", 1, 2, argv);
+			while (switch_sql_queue_manager_size(qm, 1)) {
+				switch_yield(1000);
+			}
+			switch_sleep(200 * 1000);
+			switch_sql_queue_manager_execute_sql_callback(qm, "SELECT COUNT(*) FROM ch WHERE uuid='it''s' AND state IS NULL;", table_count_func, NULL);
+			fst_check_int_equals(status, 1);
+
+			/* a short argv on a cached statement leaves the rest NULL instead of the previous call's values */
+			argv[0] = "short";
+			argv[1] = "CS_NEW";
+			switch_sql_queue_manager_push_params(qm, "INSERT INTO ch (uuid, state, name) VALUES (?, ?, ?);", 1, 2, argv);
+			while (switch_sql_queue_manager_size(qm, 1)) {
+				switch_yield(1000);
+			}
+			switch_sleep(200 * 1000);
+			switch_sql_queue_manager_execute_sql_callback(qm, "SELECT COUNT(*) FROM ch WHERE uuid='short' AND name IS NULL;", table_count_func, NULL);
+			fst_check_int_equals(status, 1);
+
+			switch_sql_queue_manager_stats(qm, &stats);
+			fst_check(stats.statements >= (uint64_t)calls * 4);
+			fst_check(stats.prepared_hits > 0);
+			fst_check(stats.depth == 0);
+
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "%d calls: text %" SWITCH_TIME_T_FMT "ms, prepared %" SWITCH_TIME_T_FMT "ms, "
+							  "%" SWITCH_UINT64_T_FMT " batches, max batch %u, avg flush %" SWITCH_TIME_T_FMT "us, prepared %" SWITCH_UINT64_T_FMT "/%" SWITCH_UINT64_T_FMT "\n",
+							  calls, raw_took / 1000, params_took / 1000, stats.batches, stats.max_batch, stats.avg_flush_us,
+							  stats.prepared_hits, stats.prepared_misses);
+
+			switch_sql_queue_manager_stop(qm);
+			switch_sql_queue_manager_destroy(&qm);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_switch_cache_db_queue_manager_params_core_tables)
+		{
+			switch_sql_queue_manager_t *qm = NULL;
+			switch_cache_db_handle_t *dbh = NULL;
+			switch_sql_queue_manager_stats_t stats = { 0 };
+			schema_t schema = { { 0 } };
+			switch_time_t raw_took, params_took;
+			char *err = NULL;
+			int i, calls = 1000;
+
+			/* the real channels and calls tables, indexes included, copied from the core db */
+			fst_requires(switch_core_db_handle(&dbh) == SWITCH_STATUS_SUCCESS);
+			switch_cache_db_execute_sql_callback(dbh, "select sql from sqlite_master where tbl_name in ('channels','calls') "
+												 "and type in ('table','index') and sql is not null order by type desc", schema_func, &schema, &err);
+			switch_safe_free(err);
+			switch_cache_db_release_db_handle(&dbh);
+			fst_requires(schema.count >= 2);
+
+			switch_sql_queue_manager_init_name("TEST",
+				&qm,
+				1,
+				"test_switch_cache_db_queue_manager_params_core_tables",
+				SWITCH_MAX_TRANS,
+				NULL, NULL, NULL, NULL);
+
+			switch_sql_queue_manager_start(qm);
+
+			switch_sql_queue_manager_push_confirm(qm, "DROP TABLE IF EXISTS channels;", 0, SWITCH_TRUE);
+			switch_sql_queue_manager_push_confirm(qm, "DROP TABLE IF EXISTS calls;", 0, SWITCH_TRUE);
+			for (i = 0; i < schema.count; i++) {
+				switch_sql_queue_manager_push_confirm(qm, schema.ddl[i], 0, SWITCH_TRUE);
+				free(schema.ddl[i]);
+			}
+
+			raw_took = core_channel_load(qm, "raw", calls, SWITCH_FALSE);
+			params_took = core_channel_load(qm, "params", calls, SWITCH_TRUE);
+
+			switch_sleep(500 * 1000);
+
+			switch_sql_queue_manager_execute_sql_callback(qm, "select count(*) from channels where state='CS_EXECUTE' and application='park' and hostname='bench';",
+														  table_count_func, NULL);
+			fst_check_int_equals(status, calls * 2);
+			switch_sql_queue_manager_execute_sql_callback(qm, "select count(*) from channels c, calls k where k.caller_uuid=c.uuid;", table_count_func, NULL);
+			fst_check_int_equals(status, calls * 2);
+
+			switch_sql_queue_manager_stats(qm, &stats);
+			fst_check(stats.prepared_hits >= (uint64_t) calls * 4 - 4);
+			fst_check(stats.errors == 0);
+
+#ifdef BENCHMARK
+			printf("channels/calls lifecycle x %d: text %" SWITCH_TIME_T_FMT "ms, prepared %" SWITCH_TIME_T_FMT "ms, max batch %u, avg flush %" SWITCH_TIME_T_FMT "us\n",
+				   calls, raw_took / 1000, params_took / 1000, stats.max_batch, stats.avg_flush_us);
+#else
+			(void) raw_took;
+			(void) params_took;
+#endif
+
+			switch_sql_queue_manager_stop(qm);
+			switch_sql_queue_manager_destroy(&qm);
+		}
+		FST_TEST_END()
+
 
 	}
 	FST_SUITE_END()
@@ -224,6 +224,89 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(test_switch_core_file_prompt_cache)
+		{
+			switch_status_t status = SWITCH_STATUS_FALSE;
+			switch_file_handle_t fh = { 0 };
+			switch_prompt_cache_stats_t stats;
+			static char filename[] = "/tmp/fs_prompt_cache_unit_test.wav";
+			int16_t buf[1600], out[160];
+			switch_size_t len, total;
+			unsigned int pos = 0;
+			int i, nr_samples = 1600, bad;
+
+			for (i = 0; i < nr_samples; i++) {
+				buf[i] = (int16_t) i;
+			}
+
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			len = nr_samples;
+			switch_core_file_write(&fh, buf, &len);
+			switch_core_file_close(&fh);
+
+			switch_core_prompt_cache_set_limits(1048576, 0);
+
+			/* first read decodes the file and fills the cache */
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(fh.prompt_entry == NULL);
+			for (total = 0, len = 160; switch_core_file_read(&fh, out, &len) == SWITCH_STATUS_SUCCESS; len = 160) {
+				total += len;
+			}
+			fst_check(total == (switch_size_t) nr_samples);
+			switch_core_file_close(&fh);
+
+			switch_core_prompt_cache_get_stats(&stats);
+			fst_check(stats.misses == 1);
+			fst_check(stats.inserts == 1);
+			fst_check(stats.entries == 1);
+			fst_check(stats.bytes == (switch_size_t) nr_samples * 2);
+
+			/* second open streams from the cache */
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(fh.prompt_entry != NULL);
+			for (bad = 0, total = 0, len = 160; switch_core_file_read(&fh, out, &len) == SWITCH_STATUS_SUCCESS; len = 160) {
+				for (i = 0; i < (int) len; i++) {
+					bad += out[i] != buf[total + i];
+				}
+				total += len;
+			}
+			fst_check(total == (switch_size_t) nr_samples);
+			fst_check(bad == 0);
+
+			switch_core_file_seek(&fh, &pos, 800, SEEK_SET);
+			fst_check(pos == 800);
+			len = 160;
+			fst_check(switch_core_file_read(&fh, out, &len) == SWITCH_STATUS_SUCCESS);
+			fst_check(len == 160 && out[0] == 800);
+			switch_core_file_close(&fh);
+
+			switch_core_prompt_cache_get_stats(&stats);
+			fst_check(stats.hits == 1);
+
+			/* rewriting the file drops the stale copy */
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			len = nr_samples / 2;
+			switch_core_file_write(&fh, buf, &len);
+			switch_core_file_close(&fh);
+
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(fh.prompt_entry == NULL);
+			switch_core_file_close(&fh);
+
+			switch_core_prompt_cache_get_stats(&stats);
+			fst_check(stats.invalidations == 1);
+			fst_check(stats.entries == 0);
+
+			switch_core_prompt_cache_set_limits(0, 0);
+			unlink(filename);
+		}
+		FST_TEST_END()
+
 	}
 	FST_SUITE_END()
 }
@@ -0,0 +1,164 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2020, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_core_memory_tables.c -- tests the in-memory core channels, calls and registrations tables
+ *
+ */
+#include <switch.h>
+#include <test/switch_test.h>
+
+struct memory_table_result {
+	const char *match;
+	int rows;
+	int found;
+	int count;
+};
+
+static int memory_table_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	struct memory_table_result *res = (struct memory_table_result *) pArg;
+
+	if (argc == 1 && !strcmp(columnNames[0], "count")) {
+		res->count = atoi(argv[0]);
+		return 0;
+	}
+
+	res->rows++;
+
+	if (argv[0] && res->match && !strcmp(argv[0], res->match)) {
+		res->found++;
+	}
+
+	return 0;
+}
+
+FST_CORE_BEGIN("./conf_memory_tables")
+{
+	FST_SUITE_BEGIN(switch_core_memory_tables)
+	{
+		FST_SETUP_BEGIN()
+		{
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_SESSION_BEGIN(memory_tables)
+		{
+			switch_core_table_query_t query = { 0 };
+			struct memory_table_result res = { 0 };
+			const char *uuid = switch_core_session_get_uuid(fst_session);
+			char like[64];
+			int sanity = 100;
+
+			fst_requires(switch_core_memory_tables_enabled());
+
+			res.match = uuid;
+			query.table = SWITCH_CORE_TABLE_CHANNELS;
+			query.column = "uuid";
+
+			/* the row is filled from the channel events, which are delivered asynchronously */
+			while (--sanity) {
+				res.rows = res.found = 0;
+				switch_core_memory_table_query(&query, memory_table_callback, &res);
+				if (res.found) break;
+				switch_yield(20000);
+			}
+			fst_check(res.found == 1);
+
+			/* show filters on the switchname like its SQL does */
+			query.hostname = switch_core_get_switchname();
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.found == 1);
+
+			query.hostname = "no-such-host";
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.rows == 0);
+			query.hostname = NULL;
+
+			switch_snprintf(like, sizeof(like), "%%%.8s%%", uuid);
+			query.like = like;
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.found == 1);
+
+			query.like = "no-such-channel";
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.rows == 0);
+
+			query.like = NULL;
+			query.count = SWITCH_TRUE;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.count >= 1);
+			query.count = SWITCH_FALSE;
+
+			/* an unbridged channel shows up in calls but not in bridged_calls */
+			query.table = SWITCH_CORE_TABLE_CALLS;
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.found == 1);
+
+			query.bridged = SWITCH_TRUE;
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.found == 0);
+
+			switch_core_add_registration("1000", "test.local", "token-1000", "sofia/internal/sip:1000@192.0.2.1:5060", 0,
+										 "192.0.2.1", "5060", "udp", NULL);
+			memset(&query, 0, sizeof(query));
+			query.table = SWITCH_CORE_TABLE_REGISTRATIONS;
+			query.reg_user = "1000";
+			query.realm = "test.local";
+			query.column = "url";
+			res.match = "sofia/internal/sip:1000@192.0.2.1:5060";
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.rows == 1 && res.found == 1);
+
+			query.hostname = "no-such-host";
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.rows == 0);
+			query.hostname = NULL;
+
+			switch_core_del_registration("1000", "test.local", NULL);
+			res.rows = res.found = 0;
+			switch_core_memory_table_query(&query, memory_table_callback, &res);
+			fst_check(res.rows == 0);
+
+			switch_channel_hangup(fst_channel, SWITCH_CAUSE_NORMAL_CLEARING);
+		}
+		FST_SESSION_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
@@ -31,7 +31,6 @@
 #include <switch.h>
 #include <test/switch_test.h>
 
-
 FST_CORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_core_session)
@@ -71,6 +70,147 @@ FST_CORE_BEGIN("./conf")
 			fst_check(session == NULL);
 		}
 		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(var_snapshot)
+		{
+			switch_event_shared_t *snap1, *snap2, *snap3;
+			switch_event_t *event1 = NULL, *event2 = NULL, *dup = NULL;
+			char *str = NULL;
+
+			switch_channel_set_variable(fst_channel, "snapshot_test", "one");
+			snap1 = switch_channel_var_snapshot_get(fst_channel);
+			snap2 = switch_channel_var_snapshot_get(fst_channel);
+			fst_requires(snap1 && snap2);
+			fst_check(snap1 == snap2);
+			fst_check_string_equals(switch_event_shared_get_header(snap1, "variable_snapshot_test"), "one");
+
+			/* events link the same snapshot instead of copying the variables */
+			switch_event_create(&event1, SWITCH_EVENT_CHANNEL_DATA);
+			switch_event_create(&event2, SWITCH_EVENT_CHANNEL_ANSWER);
+			switch_channel_event_set_data(fst_channel, event1);
+			switch_channel_event_set_data(fst_channel, event2);
+			fst_check(event1->shared == snap1);
+			fst_check(event2->shared == snap1);
+			fst_check_string_equals(switch_event_get_header(event1, "variable_snapshot_test"), "one");
+			switch_event_serialize(event2, &str, SWITCH_FALSE);
+			fst_check(strstr(str, "variable_snapshot_test: one") != NULL);
+			switch_safe_free(str);
+
+			switch_event_dup(&dup, event2);
+			fst_check(dup->shared == snap1);
+			fst_check_string_equals(switch_event_get_header(dup, "variable_snapshot_test"), "one");
+
+			/* changing a shared header gives the event its own copies and leaves the snapshot alone */
+			switch_event_add_header_string(event1, SWITCH_STACK_BOTTOM, "variable_snapshot_test", "local");
+			fst_check(event1->shared == NULL);
+			fst_check_string_equals(switch_event_get_header(event1, "variable_snapshot_test"), "local");
+			switch_event_del_header(dup, "variable_snapshot_test");
+			fst_check(switch_event_get_header(dup, "variable_snapshot_test") == NULL);
+			fst_check_string_equals(switch_event_shared_get_header(snap1, "variable_snapshot_test"), "one");
+			fst_check_string_equals(switch_event_get_header(event2, "variable_snapshot_test"), "one");
+
+			switch_channel_set_variable(fst_channel, "snapshot_test", "two");
+			snap3 = switch_channel_var_snapshot_get(fst_channel);
+			fst_check(snap3 != snap1);
+			fst_check_string_equals(switch_event_shared_get_header(snap1, "variable_snapshot_test"), "one");
+			fst_check_string_equals(switch_event_shared_get_header(snap3, "variable_snapshot_test"), "two");
+			fst_check_string_equals(switch_channel_get_variable(fst_channel, "SNAPSHOT_TEST"), "two");
+
+			switch_event_destroy(&event1);
+			switch_event_destroy(&event2);
+			switch_event_destroy(&dup);
+			switch_event_shared_release(&snap1);
+			switch_event_shared_release(&snap2);
+			switch_event_shared_release(&snap3);
+			fst_check(snap1 == NULL);
+
+			switch_channel_hangup(fst_channel, SWITCH_CAUSE_NORMAL_CLEARING);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(expand_template)
+		{
+			const char *templates[] = {
+				"no variables here",
+				"${caller_id_number}",
+				"{origination_caller_id_number=${caller_id_number},ignore_early_media=true}sofia/gateway/${gw}/${destination_number}",
+				"${dest:1}|${dest:-4}|${dest:2:3}|${missing}|\\${escaped}|$${global}",
+				"${cond(${gw} == carrier1 ? yes : no)}",
+				"pre${var_${gw}}post",
+				"unterminated ${caller_id_number",
+				NULL
+			};
+			int i;
+
+			switch_channel_set_variable(fst_channel, "caller_id_number", "15551234567");
+			switch_channel_set_variable(fst_channel, "destination_number", "18005550100");
+			switch_channel_set_variable(fst_channel, "gw", "carrier1");
+			switch_channel_set_variable(fst_channel, "dest", "+18005550100");
+			switch_channel_set_variable(fst_channel, "var_carrier1", "nested");
+
+			for (i = 0; templates[i]; i++) {
+				switch_expand_template_t *tpl = NULL;
+				char *expected = switch_channel_expand_variables(fst_channel, templates[i]);
+				char *cached = switch_channel_expand_variables_cached(fst_channel, templates[i]);
+				char *rendered;
+
+				fst_requires(switch_channel_expand_template_compile(templates[i], &tpl) == SWITCH_STATUS_SUCCESS);
+				rendered = switch_channel_expand_template_render(fst_channel, tpl, NULL, NULL);
+				fst_check_string_equals(rendered, expected);
+				fst_check_string_equals(cached, expected);
+				fst_check((cached == templates[i]) == (expected == templates[i]));
+
+				switch_safe_free(rendered);
+				if (cached != templates[i]) free(cached);
+				if (expected != templates[i]) free(expected);
+				switch_channel_expand_template_destroy(&tpl);
+				fst_check(tpl == NULL);
+			}
+
+			switch_channel_hangup(fst_channel, SWITCH_CAUSE_NORMAL_CLEARING);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(expand_template_benchmark)
+		{
+			const char *dialplan_string = "{origination_caller_id_number=${caller_id_number},sip_h_X-Account=${account:0:6},"
+				"absolute_codec_string=${codecs}}sofia/gateway/${gw}/${destination_number}";
+			switch_time_t start_ts;
+			uint64_t parse_us, cached_us;
+			uint32_t count = 0;
+			uint64_t hits = 0, misses = 0;
+			int loops = 10000, x;
+
+			switch_channel_set_variable(fst_channel, "caller_id_number", "15551234567");
+			switch_channel_set_variable(fst_channel, "destination_number", "18005550100");
+			switch_channel_set_variable(fst_channel, "account", "acct-1234567890");
+			switch_channel_set_variable(fst_channel, "codecs", "PCMU,PCMA,G722");
+			switch_channel_set_variable(fst_channel, "gw", "carrier1");
+
+			start_ts = switch_time_now();
+			for (x = 0; x < loops; x++) {
+				char *expanded = switch_channel_expand_variables(fst_channel, dialplan_string);
+				if (expanded != dialplan_string) free(expanded);
+			}
+			parse_us = switch_time_now() - start_ts;
+
+			start_ts = switch_time_now();
+			for (x = 0; x < loops; x++) {
+				char *expanded = switch_channel_expand_variables_cached(fst_channel, dialplan_string);
+				if (expanded != dialplan_string) free(expanded);
+			}
+			cached_us = switch_time_now() - start_ts;
+
+			switch_channel_expand_template_cache_stats(&count, &hits, &misses);
+			fst_check(count > 0);
+			fst_check(hits >= (uint64_t) loops - 1);
+
+			printf("expand_variables: parse %" SWITCH_UINT64_T_FMT "us, cached template %" SWITCH_UINT64_T_FMT "us for %d loops (%.2fx)\n",
+				   parse_us, cached_us, loops, cached_us ? (double) parse_us / cached_us : 0.0);
+
+			switch_channel_hangup(fst_channel, SWITCH_CAUSE_NORMAL_CLEARING);
+		}
+		FST_SESSION_END()
 	}
 	FST_SUITE_END()
 }
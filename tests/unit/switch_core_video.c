@@ -34,6 +34,8 @@
 
 #include <test/switch_test.h>
 
+// #define BENCHMARK 1
+
 FST_CORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_core_video)
@@ -267,6 +269,218 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(img_pool)
+		{
+			switch_img_pool_stats_t stats;
+			switch_image_t *img, *ref, *again, *first;
+
+			switch_img_pool_set_limits(8 * 1024 * 1024);
+			switch_img_pool_flush();
+
+			img = first = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 320, 240, 1);
+			fst_requires(img);
+			ref = switch_img_ref(img);
+			fst_check(ref == img);
+
+			switch_img_free(&img);
+			switch_img_pool_get_stats(&stats);
+			fst_check_int_equals(stats.images, 0);
+
+			switch_img_free(&ref);
+			switch_img_pool_get_stats(&stats);
+			fst_check_int_equals(stats.images, 1);
+
+			again = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 320, 240, 1);
+			fst_requires(again);
+			fst_check(again == first);
+			fst_check_int_equals(again->d_w, 320);
+			fst_check_int_equals(again->d_h, 240);
+			switch_img_pool_get_stats(&stats);
+			fst_check_int_equals(stats.images, 0);
+			fst_check(stats.hits >= 1);
+
+			/* a different size is not served from the pool */
+			img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 640, 480, 1);
+			fst_requires(img);
+			fst_check_int_equals(img->d_w, 640);
+
+			switch_img_free(&img);
+			switch_img_free(&again);
+			switch_img_pool_get_stats(&stats);
+			fst_check_int_equals(stats.images, 2);
+
+			switch_img_pool_set_limits(0);
+			switch_img_pool_get_stats(&stats);
+			fst_check_int_equals(stats.images, 0);
+			fst_check(stats.bytes == 0);
+
+			/* odd sizes are stored rounded up for the chroma planes and still come back from the pool */
+			switch_img_pool_set_limits(8 * 1024 * 1024);
+			img = first = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 321, 241, 1);
+			fst_requires(img);
+			switch_img_free(&img);
+
+			img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 321, 241, 1);
+			fst_requires(img);
+			fst_check(img == first);
+			fst_check_int_equals(img->d_w, 321);
+			fst_check_int_equals(img->d_h, 241);
+			switch_img_free(&img);
+
+			/* the same storage serves the even size next to it */
+			img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 322, 242, 1);
+			fst_requires(img);
+			fst_check(img == first);
+			fst_check_int_equals(img->d_w, 322);
+			fst_check_int_equals(img->d_h, 242);
+			switch_img_free(&img);
+
+			switch_img_pool_set_limits(32 * 1024 * 1024);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(img_fill_rect)
+		{
+			switch_image_t *img = switch_img_alloc(NULL, SWITCH_IMG_FMT_ARGB, 64, 64, 1);
+			switch_rgb_color_t black = { 0 }, red = { 0 };
+			switch_rgb_color_t *px;
+
+			fst_requires(img);
+			black.a = 255;
+			red.a = 255;
+			red.r = 255;
+
+			switch_img_fill(img, 0, 0, img->d_w, img->d_h, &black);
+			switch_img_fill(img, 8, 8, 16, 16, &red);
+
+			px = (switch_rgb_color_t *)(img->planes[SWITCH_PLANE_PACKED] + 10 * img->stride[SWITCH_PLANE_PACKED] + 10 * 4);
+			fst_check_int_equals(px->r, 255);
+			px = (switch_rgb_color_t *)(img->planes[SWITCH_PLANE_PACKED] + 30 * img->stride[SWITCH_PLANE_PACKED] + 30 * 4);
+			fst_check_int_equals(px->r, 0);
+			fst_check_int_equals(px->a, 255);
+
+			switch_img_free(&img);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(img_patch_argb_blend)
+		{
+			switch_image_t *IMG = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 64, 64, 1);
+			switch_image_t *img = switch_img_alloc(NULL, SWITCH_IMG_FMT_ARGB, 32, 32, 1);
+			switch_rgb_color_t black = { 0 }, white = { 0 };
+			uint8_t y_before;
+
+			fst_requires(IMG);
+			fst_requires(img);
+			black.a = 255;
+			white.a = 255;
+			white.r = white.g = white.b = 255;
+
+			switch_img_fill(IMG, 0, 0, IMG->d_w, IMG->d_h, &black);
+			y_before = IMG->planes[SWITCH_PLANE_Y][0];
+
+			/* the left half of the patch is transparent, the right half opaque white */
+			memset(img->planes[SWITCH_PLANE_PACKED], 0, img->stride[SWITCH_PLANE_PACKED] * img->d_h);
+			switch_img_fill(img, 16, 0, 16, 32, &white);
+
+			switch_img_patch(IMG, img, 8, 8);
+			fst_check_int_equals(IMG->planes[SWITCH_PLANE_Y][12 * IMG->stride[SWITCH_PLANE_Y] + 12], y_before);
+			fst_check(IMG->planes[SWITCH_PLANE_Y][12 * IMG->stride[SWITCH_PLANE_Y] + 30] > 200);
+
+			/* half way */
+			switch_img_fill(IMG, 0, 0, IMG->d_w, IMG->d_h, &black);
+			switch_img_overlay(IMG, img, 8, 8, 50);
+			fst_check_int_equals(IMG->planes[SWITCH_PLANE_Y][12 * IMG->stride[SWITCH_PLANE_Y] + 12], y_before);
+			fst_check(IMG->planes[SWITCH_PLANE_Y][12 * IMG->stride[SWITCH_PLANE_Y] + 30] > y_before + 40);
+			fst_check(IMG->planes[SWITCH_PLANE_Y][12 * IMG->stride[SWITCH_PLANE_Y] + 30] < 200);
+
+			switch_img_free(&IMG);
+			switch_img_free(&img);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(benchmark)
+		{
+			switch_image_t *canvas = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 1280, 720, 1);
+			switch_image_t *layer = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 640, 360, 1);
+			switch_image_t *logo = switch_img_alloc(NULL, SWITCH_IMG_FMT_ARGB, 320, 180, 1);
+			switch_rgb_color_t color = { 0 };
+			switch_time_t start;
+			int i, loops;
+
+#ifdef BENCHMARK
+			loops = 1000;
+#else
+			loops = 10;
+#endif
+
+			fst_requires(canvas);
+			fst_requires(layer);
+			fst_requires(logo);
+			color.a = 128;
+			color.g = 200;
+			switch_img_fill(layer, 0, 0, layer->d_w, layer->d_h, &color);
+			switch_img_fill(logo, 0, 0, logo->d_w, logo->d_h, &color);
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				switch_image_t *img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 1280, 720, 1);
+				switch_img_free(&img);
+			}
+#ifdef BENCHMARK
+			printf("switch_img_alloc/free 1280x720: %.2f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				switch_img_fill(canvas, 0, 0, canvas->d_w, canvas->d_h, &color);
+			}
+#ifdef BENCHMARK
+			printf("switch_img_fill 1280x720: %.2f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				switch_img_patch(canvas, layer, 320, 180);
+			}
+#ifdef BENCHMARK
+			printf("switch_img_patch I420 640x360: %.2f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				switch_img_patch(canvas, logo, 40, 40);
+			}
+#ifdef BENCHMARK
+			printf("switch_img_patch ARGB alpha 320x180: %.2f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				switch_img_overlay(canvas, layer, 320, 180, 50);
+			}
+#ifdef BENCHMARK
+			printf("switch_img_overlay I420 640x360: %.2f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			start = switch_time_now();
+			for (i = 0; i < loops; i++) {
+				switch_image_t *copy = NULL;
+
+				switch_img_copy(canvas, &copy);
+				switch_img_free(&copy);
+			}
+#ifdef BENCHMARK
+			printf("switch_img_copy 1280x720: %.2f us\n", (switch_time_now() - start) / (double)loops);
+#endif
+
+			fst_check(canvas->d_w == 1280);
+			switch_img_free(&canvas);
+			switch_img_free(&layer);
+			switch_img_free(&logo);
+		}
+		FST_TEST_END()
+
 		FST_TEST_BEGIN(read_from_file)
 		{
 			switch_image_t *img;
@@ -104,6 +104,93 @@ FST_TEST_BEGIN(benchmark)
 }
 FST_TEST_END()
 
+FST_TEST_BEGIN(header_index)
+{
+  switch_event_t *event = NULL;
+  switch_event_t *dup = NULL;
+
+  fst_requires(switch_event_create_plain(&event, SWITCH_EVENT_CHANNEL_DATA) == SWITCH_STATUS_SUCCESS);
+  switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "before_index", "1");
+  fst_check(switch_event_index_headers(event) == SWITCH_STATUS_SUCCESS);
+  fst_check_string_equals(switch_event_get_header(event, "BEFORE_INDEX"), "1");
+
+  switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "foo", "bar");
+  fst_check_string_equals(switch_event_get_header(event, "Foo"), "bar");
+
+  /* unique headers replace the indexed entry */
+  switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "foo", "baz");
+  fst_check_string_equals(switch_event_get_header(event, "foo"), "baz");
+
+  switch_event_add_header_string(event, SWITCH_STACK_PUSH, "list", "a");
+  switch_event_add_header_string(event, SWITCH_STACK_PUSH, "list", "b");
+  fst_check_string_equals(switch_event_get_header_idx(event, "list", 1), "b");
+
+  fst_check(switch_event_del_header(event, "missing") == SWITCH_STATUS_FALSE);
+  fst_check(switch_event_del_header(event, "foo") == SWITCH_STATUS_SUCCESS);
+  fst_check(switch_event_get_header(event, "foo") == NULL);
+
+  fst_check(switch_event_rename_header(event, "before_index", "renamed") == SWITCH_STATUS_SUCCESS);
+  fst_check(switch_event_get_header(event, "before_index") == NULL);
+  fst_check_string_equals(switch_event_get_header(event, "renamed"), "1");
+
+  fst_check(switch_event_dup(&dup, event) == SWITCH_STATUS_SUCCESS);
+  fst_check(dup->header_index == NULL);
+  fst_check_string_equals(switch_event_get_header(dup, "renamed"), "1");
+
+  switch_event_destroy(&dup);
+  switch_event_destroy(&event);
+}
+FST_TEST_END()
+
+FST_TEST_BEGIN(shared_header_order)
+{
+  switch_event_t *event = NULL, *copied = NULL, *snap = NULL, *dup = NULL;
+  switch_event_shared_t *shared = NULL;
+  char *linked_str = NULL, *copied_str = NULL, *dup_str = NULL, *unshared_str = NULL;
+
+  fst_requires(switch_event_create_plain(&snap, SWITCH_EVENT_CHANNEL_DATA) == SWITCH_STATUS_SUCCESS);
+  switch_event_add_header_string(snap, SWITCH_STACK_BOTTOM, "variable_one", "1");
+  switch_event_add_header_string(snap, SWITCH_STACK_BOTTOM, "variable_two", "2");
+  shared = switch_event_share(&snap);
+
+  /* the same headers copied in, the order a linked event has to serialize in */
+  fst_requires(switch_event_create_plain(&copied, SWITCH_EVENT_CHANNEL_DATA) == SWITCH_STATUS_SUCCESS);
+  switch_event_add_header_string(copied, SWITCH_STACK_BOTTOM, "Before", "b");
+  switch_event_add_header_string(copied, SWITCH_STACK_BOTTOM, "variable_one", "1");
+  switch_event_add_header_string(copied, SWITCH_STACK_BOTTOM, "variable_two", "2");
+  switch_event_add_header_string(copied, SWITCH_STACK_BOTTOM, "After", "a");
+  switch_event_add_header_string(copied, SWITCH_STACK_TOP, "Top", "t");
+
+  fst_requires(switch_event_create_plain(&event, SWITCH_EVENT_CHANNEL_DATA) == SWITCH_STATUS_SUCCESS);
+  switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Before", "b");
+  switch_event_link_shared(event, shared);
+  switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "After", "a");
+  switch_event_add_header_string(event, SWITCH_STACK_TOP, "Top", "t");
+
+  switch_event_serialize(copied, &copied_str, SWITCH_FALSE);
+  switch_event_serialize(event, &linked_str, SWITCH_FALSE);
+  fst_check_string_equals(linked_str, copied_str);
+
+  fst_check(switch_event_dup(&dup, event) == SWITCH_STATUS_SUCCESS);
+  switch_event_serialize(dup, &dup_str, SWITCH_FALSE);
+  fst_check_string_equals(dup_str, copied_str);
+
+  /* private copies stay where the shared set was */
+  switch_event_unshare(event);
+  switch_event_serialize(event, &unshared_str, SWITCH_FALSE);
+  fst_check_string_equals(unshared_str, copied_str);
+
+  switch_safe_free(linked_str);
+  switch_safe_free(copied_str);
+  switch_safe_free(dup_str);
+  switch_safe_free(unshared_str);
+  switch_event_destroy(&dup);
+  switch_event_destroy(&event);
+  switch_event_destroy(&copied);
+  switch_event_shared_release(&shared);
+}
+FST_TEST_END()
+
 FST_SUITE_END()
 
 FST_MINCORE_END()
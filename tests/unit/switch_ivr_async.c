@@ -123,6 +123,40 @@ FST_CORE_BEGIN("./conf_async")
 		}
 		FST_SESSION_END()
 
+		FST_SESSION_BEGIN(session_record_writer_pool)
+		{
+			const char *record_filename = switch_core_session_sprintf(fst_session, "%s%s%s-pool.wav", SWITCH_GLOBAL_dirs.temp_dir, SWITCH_PATH_SEPARATOR, switch_core_session_get_uuid(fst_session));
+			switch_record_writer_stats_t stats = { 0 };
+			switch_status_t status;
+
+			status = switch_ivr_record_writers_start(2, 1000, 65536, 100, SWITCH_RECORD_BACKPRESSURE_DROP);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			status = switch_ivr_record_session_event(fst_session, record_filename, 0, NULL, NULL);
+			fst_xcheck(status == SWITCH_STATUS_SUCCESS, "Expect switch_ivr_record_session() to return SWITCH_STATUS_SUCCESS");
+
+			switch_ivr_record_writer_stats(&stats);
+			fst_xcheck(stats.recordings == 1, "Expect the recording to use the writer pool");
+
+			status = switch_ivr_play_file(fst_session, NULL, "tone_stream://%(400,200,400,450);%(400,200,400,450)", NULL);
+			fst_xcheck(status == SWITCH_STATUS_SUCCESS, "Expect switch_ivr_play_file() to return SWITCH_STATUS_SUCCESS");
+
+			status = switch_ivr_stop_record_session(fst_session, record_filename);
+			fst_xcheck(status == SWITCH_STATUS_SUCCESS, "Expect switch_ivr_stop_record_session() to return SWITCH_STATUS_SUCCESS");
+
+			switch_ivr_play_file(fst_session, NULL, "silence_stream://100,0", NULL);
+
+			switch_ivr_record_writer_stats(&stats);
+			fst_xcheck(stats.recordings == 0, "Expect the recording to be detached from the writer pool");
+			fst_xcheck(stats.blocks > 0 && stats.bytes > 0, "Expect the writer pool to have written the recording");
+			fst_xcheck(stats.drops == 0, "Expect no dropped frames");
+			fst_xcheck(switch_file_exists(record_filename, fst_pool) == SWITCH_STATUS_SUCCESS, "Expect recording file to exist");
+
+			switch_ivr_record_writers_stop();
+			unlink(record_filename);
+		}
+		FST_SESSION_END()
+
 		FST_SESSION_BEGIN(session_record_event_vars)
 		{
 			const char *record_filename = switch_core_session_sprintf(fst_session, "%s%s%s.wav", SWITCH_GLOBAL_dirs.temp_dir, SWITCH_PATH_SEPARATOR, switch_core_session_get_uuid(fst_session));
@@ -189,6 +189,66 @@ FST_CORE_BEGIN("./conf")
 			switch_log_unbind_logger(test_logger);
 		}
 		FST_SESSION_END()
+
+		FST_TEST_BEGIN(switch_log_rings)
+		{
+			switch_log_ring_stats_t stats = { 0 };
+			char path[1024];
+			char text[4096] = "";
+			char *log = NULL;
+			FILE *in, *out;
+			size_t len;
+			int i;
+
+			switch_snprintf(path, sizeof(path), "%s%sswitch_log_rings_%d.blog", SWITCH_GLOBAL_dirs.temp_dir, SWITCH_PATH_SEPARATOR, (int) getpid());
+			remove(path);
+
+			fst_requires(switch_log_rings_start(4, 64, 2) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_log_binary_open(path) == SWITCH_STATUS_SUCCESS);
+			switch_log_bind_logger(test_logger, SWITCH_LOG_ALERT, SWITCH_FALSE);
+
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ALERT, "switch_log test: ring %d %s %.*s %5.2f %lld %zu %x %c %%\n",
+							  -1, "str", 3, "abcdef", 3.14159, (long long) 42, (size_t) 7, 255, 'z');
+			log = wait_for_log(1000);
+			fst_check_string_equals(log, "{\"level\":1,\"message\":\"switch_log test: ring -1 str abc  3.14 42 7 ff z %\\n\"}");
+			switch_safe_free(log);
+
+			/* positional arguments can't be deferred, the caller formats them */
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ALERT, "switch_log test: positional %1$s\n", "arg");
+			log = wait_for_log(1000);
+			fst_check_string_equals(log, "{\"level\":1,\"message\":\"switch_log test: positional arg\\n\"}");
+			switch_safe_free(log);
+
+			switch_log_unbind_logger(test_logger);
+
+			for (i = 0; i < 100 && switch_log_ring_stats(&stats) == SWITCH_STATUS_SUCCESS && stats.binary_records < 2; i++) {
+				switch_yield(10000);
+			}
+
+			fst_check_int_equals(stats.rings, 4);
+			fst_check_int_equals(stats.slots, 64);
+			fst_check(stats.queued >= 2);
+			fst_check(stats.preformatted >= 1);
+			fst_check(stats.binary_records >= 2);
+			fst_check_int_equals(stats.binary_errors, 0);
+
+			switch_log_binary_open(NULL);
+
+			fst_requires((in = fopen(path, "rb")));
+			fst_requires((out = tmpfile()));
+			fst_check(switch_log_binary_decode(in, out, SWITCH_LOG_ALERT, NULL) == SWITCH_STATUS_SUCCESS);
+			rewind(out);
+			len = fread(text, 1, sizeof(text) - 1, out);
+			text[len] = '\0';
+			fclose(in);
+			fclose(out);
+			remove(path);
+
+			fst_check(strstr(text, "[ALERT] switch_log.c:") != NULL);
+			fst_check(strstr(text, "switch_log test: ring -1 str abc  3.14 42 7 ff z %\n") != NULL);
+			fst_check(strstr(text, "switch_log test: positional arg\n") != NULL);
+		}
+		FST_TEST_END()
 	}
 	FST_SUITE_END()
 
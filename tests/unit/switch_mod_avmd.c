@@ -0,0 +1,152 @@
+#include <switch.h>
+#include <stdlib.h>
+
+#include <test/switch_test.h>
+
+/* the batched estimator is checked against the per-sample one it replaces */
+#include "../../src/mod/applications/mod_avmd/avmd_desa2_tweaked.c"
+
+#define DESA2_N 161
+
+/* frames run by the pool workers and by the media threads, from "avmd get workers" */
+static int pool_frames(uint64_t *workers, uint64_t *inline_n)
+{
+	switch_stream_handle_t stream = { 0 };
+	const char *p;
+	int ok = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute("avmd", "get workers", NULL, &stream);
+
+	if (stream.data && (p = strstr((char *)stream.data, "frames run by media threads"))) {
+		ok = sscanf(p + strlen("frames run by media threads"), " %"SCNu64, inline_n) == 1;
+	}
+	if (ok && (p = strstr((char *)stream.data, "frame cost"))) {
+		ok = sscanf(p + strlen("frame cost"), " frames %"SCNu64, workers) == 1;
+	} else {
+		ok = 0;
+	}
+
+	switch_safe_free(stream.data);
+	return ok;
+}
+
+static int same_double(double a, double b)
+{
+	return (isnan(a) && isnan(b)) || a == b;
+}
+
+FST_CORE_BEGIN("./conf_avmd")
+{
+	FST_SUITE_BEGIN(switch_mod_avmd)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_loopback");
+			fst_requires_module("mod_avmd");
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(desa2_block_matches_scalar)
+		{
+			double x[DESA2_N + 4], omega[DESA2_N], amplitude[DESA2_N];
+			double buf[256] = { 0 };
+			circ_buffer_t b = { 0 };
+			size_t i;
+
+			b.buf = buf;
+			b.buf_len = 256;
+			b.mask = 255;
+
+			/* odd length so the scalar tail runs after the vector pairs */
+			for (i = 0; i < DESA2_N + 4; i++) {
+				x[i] = buf[i] = (double)((rand() % 65536) - 32768);
+			}
+
+			avmd_desa2_tweaked_block(x, DESA2_N, omega, amplitude);
+
+			for (i = 0; i < DESA2_N; i++) {
+				double a, o = avmd_desa2_tweaked(&b, i, &a);
+
+				fst_check(same_double(omega[i], o));
+				fst_check(same_double(amplitude[i], a));
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(desa2_block_tone)
+		{
+			double x[DESA2_N + 4], omega[DESA2_N], amplitude[DESA2_N];
+			double w = 2.0 * M_PI * 1400.0 / 8000.0;
+			size_t i;
+
+			for (i = 0; i < DESA2_N + 4; i++) {
+				x[i] = 8000.0 * sin(w * i + 0.3);
+			}
+
+			avmd_desa2_tweaked_block(x, DESA2_N, omega, amplitude);
+
+			/* a pure tone gives cos(2w) and sqrt(2) times its amplitude at every position */
+			for (i = 0; i < DESA2_N; i++) {
+				fst_check(fabs(omega[i] - cos(2.0 * w)) < 1e-6);
+				fst_check(fabs(amplitude[i] - 8000.0 * M_SQRT2) < 1e-3);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(pool_runs_frames_and_reports_cost)
+		{
+			switch_core_session_t *session = NULL;
+			switch_channel_t *channel;
+			switch_call_cause_t cause;
+			uint64_t workers = 0, inline_n = 0, workers_after = 0, inline_after = 0;
+			const char *avg, *max;
+			int i;
+
+			fst_requires(pool_frames(&workers, &inline_n));
+
+			switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+			fst_requires(session);
+			channel = switch_core_session_get_channel(session);
+
+			/* the originated null channel is outbound, avmd listens on its read side */
+			switch_core_session_execute_application(session, "avmd_start", NULL);
+			fst_requires(switch_channel_get_private(channel, "_avmd_"));
+
+			for (i = 0; i < 25; i++) {
+				switch_frame_t *frame = NULL;
+
+				fst_requires(switch_core_session_read_frame(session, &frame, SWITCH_IO_FLAG_NONE, 0) == SWITCH_STATUS_SUCCESS);
+			}
+
+			switch_core_session_execute_application(session, "avmd_stop", NULL);
+			fst_check(!switch_channel_get_private(channel, "_avmd_"));
+
+			/* every frame went through the pool or, with the queue full, the media thread */
+			fst_requires(pool_frames(&workers_after, &inline_after));
+			fst_check(workers_after + inline_after - workers - inline_n >= 24);
+
+			avg = switch_channel_get_variable(channel, "avmd_frame_cost_avg");
+			max = switch_channel_get_variable(channel, "avmd_frame_cost_max");
+			fst_requires(avg);
+			fst_requires(max);
+			fst_check(switch_is_number(avg));
+			fst_check(switch_is_number(max));
+			fst_check(atoi(avg) <= atoi(max));
+
+			/* silence is not a beep */
+			fst_check(!switch_true(switch_channel_get_variable(channel, "avmd_detect")));
+
+			switch_channel_hangup(channel, SWITCH_CAUSE_NORMAL_CLEARING);
+			switch_core_session_rwunlock(session);
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
@@ -0,0 +1,329 @@
+#include <switch.h>
+#include <stdlib.h>
+
+#include <test/switch_test.h>
+
+/* mod_hash syncs limit usage with peer1, which this test plays on 127.0.0.1:18030 (see conf_hash/hash.conf) */
+
+#define SYNC_MAGIC 0x46534c48
+#define SYNC_DELTA 1
+#define SYNC_FULL 2
+#define SYNC_FULL_END 3
+#define SYNC_RESYNC 4
+
+/* big enough that an unpaced snapshot (about 2200 datagrams at once) overflows the receive buffer */
+#define SNAPSHOT_KEYS 100000
+
+// #define BENCHMARK 1
+
+typedef struct {
+	uint8_t data[1500];
+	switch_size_t len;
+} packet_t;
+
+typedef struct {
+	uint8_t type;
+	char node[256];
+	uint32_t seq;
+	uint16_t count;
+	char key[256];
+	uint32_t total;
+	uint32_t keys;
+} header_t;
+
+static void put16(packet_t *p, uint16_t v)
+{
+	p->data[p->len++] = (uint8_t)(v >> 8);
+	p->data[p->len++] = (uint8_t)v;
+}
+
+static void put32(packet_t *p, uint32_t v)
+{
+	put16(p, (uint16_t)(v >> 16));
+	put16(p, (uint16_t)v);
+}
+
+static uint32_t get32(const uint8_t *d)
+{
+	return ((uint32_t)d[0] << 24) | ((uint32_t)d[1] << 16) | ((uint32_t)d[2] << 8) | d[3];
+}
+
+static void packet_begin(packet_t *p, uint8_t type, uint32_t boot, uint32_t seq, uint16_t count)
+{
+	p->len = 0;
+	put32(p, SYNC_MAGIC);
+	p->data[p->len++] = 1;
+	p->data[p->len++] = type;
+	p->data[p->len++] = 5;
+	memcpy(p->data + p->len, "peer1", 5);
+	p->len += 5;
+	put32(p, boot);
+	put32(p, seq);
+	put32(p, 1);
+	put16(p, count);
+}
+
+static void packet_add(packet_t *p, const char *key, uint32_t total)
+{
+	put16(p, (uint16_t)strlen(key));
+	memcpy(p->data + p->len, key, strlen(key));
+	p->len += strlen(key);
+	put32(p, total);
+	put32(p, 0);
+	put32(p, 0);
+	put32(p, 0);
+}
+
+static void packet_send(switch_socket_t *sock, switch_sockaddr_t *to, packet_t *p)
+{
+	switch_size_t len = p->len;
+	switch_socket_sendto(sock, to, 0, (const char *) p->data, &len);
+}
+
+/* wait up to a second for any packet, the header and its first entry (or the key count of a FULL_END) are returned in h */
+static switch_bool_t packet_next(switch_socket_t *sock, switch_sockaddr_t *from, header_t *h)
+{
+	switch_time_t end = switch_micro_time_now() + 1000000;
+
+	while (switch_micro_time_now() < end) {
+		uint8_t buf[1500];
+		switch_size_t len = sizeof(buf);
+		const uint8_t *p;
+
+		if (switch_socket_recvfrom(from, sock, 0, (char *) buf, &len) != SWITCH_STATUS_SUCCESS || len < 21 || get32(buf) != SYNC_MAGIC) {
+			continue;
+		}
+
+		memset(h, 0, sizeof(*h));
+		h->type = buf[5];
+		memcpy(h->node, buf + 7, buf[6]);
+		p = buf + 7 + buf[6];
+		h->seq = get32(p + 4);
+		h->count = (uint16_t)((p[12] << 8) | p[13]);
+		p += 14;
+
+		if (h->count && (switch_size_t)(p - buf) + 2 <= len) {
+			uint16_t key_len = (uint16_t)((p[0] << 8) | p[1]);
+
+			if (key_len < sizeof(h->key) && (switch_size_t)(p - buf) + 2 + key_len + 4 <= len) {
+				memcpy(h->key, p + 2, key_len);
+				h->total = get32(p + 2 + key_len);
+			}
+		}
+
+		if (h->type == SYNC_FULL_END && (switch_size_t)(p - buf) + 4 <= len) {
+			h->keys = get32(p);
+		}
+
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* wait up to a second for a packet of the given type */
+static switch_bool_t packet_wait(switch_socket_t *sock, switch_sockaddr_t *from, uint8_t type, header_t *h)
+{
+	switch_time_t end = switch_micro_time_now() + 1000000;
+
+	while (switch_micro_time_now() < end) {
+		if (packet_next(sock, from, h) && h->type == type) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
+static int usage_wait(const char *realm, const char *resource, int expected)
+{
+	uint32_t rcount = 0;
+	int usage = 0, i;
+
+	for (i = 0; i < 100; i++) {
+		if ((usage = switch_limit_usage("hash", realm, resource, &rcount)) == expected) {
+			break;
+		}
+		switch_yield(10000);
+	}
+
+	return usage;
+}
+
+FST_CORE_BEGIN("./conf_hash")
+{
+	FST_SUITE_BEGIN(switch_mod_hash)
+	{
+		switch_socket_t *sock = NULL;
+		switch_sockaddr_t *local = NULL, *node = NULL, *from = NULL;
+
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_loopback");
+			fst_requires_module("mod_hash");
+
+			fst_requires(switch_sockaddr_info_get(&local, "127.0.0.1", SWITCH_INET, 18030, 0, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_sockaddr_info_get(&node, "127.0.0.1", SWITCH_INET, 18029, 0, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_sockaddr_create(&from, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_socket_create(&sock, AF_INET, SOCK_DGRAM, 0, fst_pool) == SWITCH_STATUS_SUCCESS);
+			switch_socket_opt_set(sock, SWITCH_SO_REUSEADDR, 1);
+			fst_requires(switch_socket_bind(sock, local) == SWITCH_STATUS_SUCCESS);
+			switch_socket_timeout_set(sock, 100000);
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+			if (sock) {
+				switch_socket_close(sock);
+				sock = NULL;
+			}
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(peer_delta_counts_towards_usage)
+		{
+			packet_t p;
+
+			packet_begin(&p, SYNC_DELTA, 1234, 1, 1);
+			packet_add(&p, "trunk_gw1", 3);
+			packet_send(sock, node, &p);
+			fst_check_int_equals(usage_wait("trunk", "gw1", 3), 3);
+
+			packet_begin(&p, SYNC_DELTA, 1234, 2, 1);
+			packet_add(&p, "trunk_gw1", 0);
+			packet_send(sock, node, &p);
+			fst_check_int_equals(usage_wait("trunk", "gw1", 0), 0);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(local_usage_is_pushed)
+		{
+			switch_core_session_t *session = NULL;
+			switch_call_cause_t cause;
+			header_t h;
+			switch_bool_t found = SWITCH_FALSE;
+			int i;
+
+			switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+			fst_requires(session);
+
+			fst_check(switch_limit_incr("hash", session, "trunk", "gw2", 10, 0) == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < 20 && !found; i++) {
+				if (packet_wait(sock, from, SYNC_DELTA, &h) && h.count && !strcmp(h.key, "trunk_gw2")) {
+					fst_check_string_equals(h.node, "node0");
+					fst_check_int_equals(h.total, 1);
+					found = SWITCH_TRUE;
+				}
+			}
+			fst_check(found);
+
+			switch_limit_release("hash", session, "trunk", "gw2");
+
+			for (found = SWITCH_FALSE, i = 0; i < 20 && !found; i++) {
+				if (packet_wait(sock, from, SYNC_DELTA, &h) && h.count && !strcmp(h.key, "trunk_gw2")) {
+					fst_check_int_equals(h.total, 0);
+					found = SWITCH_TRUE;
+				}
+			}
+			fst_check(found);
+
+			switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+			switch_core_session_rwunlock(session);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(resync_gets_snapshot)
+		{
+			switch_core_session_t *session = NULL;
+			switch_call_cause_t cause;
+			packet_t p;
+			header_t h;
+			int i;
+
+			switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+			fst_requires(session);
+			fst_check(switch_limit_incr("hash", session, "trunk", "gw3", 10, 0) == SWITCH_STATUS_SUCCESS);
+
+			packet_begin(&p, SYNC_RESYNC, 1234, 2, 0);
+			packet_send(sock, node, &p);
+
+			fst_check(packet_wait(sock, from, SYNC_FULL, &h));
+			fst_check_int_equals(h.count, 1);
+			fst_check_string_equals(h.key, "trunk_gw3");
+			fst_check_int_equals(h.total, 1);
+
+			for (i = 0; i < 5 && !packet_wait(sock, from, SYNC_FULL_END, &h); i++);
+			fst_check_int_equals(h.type, SYNC_FULL_END);
+
+			switch_limit_release("hash", session, "trunk", "gw3");
+			switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+			switch_core_session_rwunlock(session);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(snapshot_of_100k_keys_is_paced)
+		{
+			switch_core_session_t *session = NULL;
+			switch_call_cause_t cause;
+			switch_time_t first = 0, last = 0;
+			uint32_t keys = 0, packets = 0;
+			char resource[32];
+			packet_t p;
+			header_t h;
+			int i;
+
+			switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+			fst_requires(session);
+
+			for (i = 0; i < SNAPSHOT_KEYS; i++) {
+				switch_snprintf(resource, sizeof(resource), "k%06d", i);
+				if (switch_limit_incr("hash", session, "bulk", resource, 10, 0) != SWITCH_STATUS_SUCCESS) {
+					break;
+				}
+			}
+			fst_check_int_equals(i, SNAPSHOT_KEYS);
+
+			/* the deltas of all those keys go out first, a heartbeat means they are done */
+			for (i = 0; i < 30; i++) {
+				if (packet_next(sock, from, &h) && h.type == SYNC_DELTA && !h.count) {
+					break;
+				}
+			}
+			fst_check(i < 30);
+
+			packet_begin(&p, SYNC_RESYNC, 1234, 2, 0);
+			packet_send(sock, node, &p);
+
+			while (packet_next(sock, from, &h) && h.type != SYNC_FULL_END) {
+				if (h.type == SYNC_FULL) {
+					last = switch_micro_time_now();
+					if (!first) {
+						first = last;
+					}
+					keys += h.count;
+					packets++;
+				}
+			}
+
+			/* nothing lost on the way */
+			fst_check_int_equals(h.type, SYNC_FULL_END);
+			fst_check_int_equals(h.keys, SNAPSHOT_KEYS);
+			fst_check_int_equals(keys, SNAPSHOT_KEYS);
+
+			/* tick-packets is 32 and interval 10ms, half that pace leaves room for whole shards and timer slack */
+			fst_check(last - first >= (switch_time_t)(packets / 64) * 10000);
+
+#ifdef BENCHMARK
+			printf("snapshot of %u keys: %u datagrams over %" SWITCH_TIME_T_FMT "ms\n", keys, packets, (last - first) / 1000);
+#endif
+
+			switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+			switch_core_session_rwunlock(session);
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
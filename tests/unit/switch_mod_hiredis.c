@@ -0,0 +1,441 @@
+#include <switch.h>
+#include <stdlib.h>
+
+#include <test/switch_test.h>
+
+/* mod_hiredis talks to a redis stand-in on 127.0.0.1:16379 that knows just enough commands for the limit backend */
+
+#define FAKE_REDIS_PORT 16379
+#define FAKE_REDIS_KEYS 64
+
+static struct {
+	switch_mutex_t *mutex;
+	char keys[FAKE_REDIS_KEYS][128];
+	long long values[FAKE_REDIS_KEYS];
+	int commands;
+	int leases;
+	int returns;
+	int wanted;
+	int fail_returns;
+} fake_redis;
+
+static long long *fake_redis_value(const char *key, switch_bool_t create)
+{
+	int i, free_slot = -1;
+
+	for (i = 0; i < FAKE_REDIS_KEYS; i++) {
+		if (!strcmp(fake_redis.keys[i], key)) {
+			return &fake_redis.values[i];
+		}
+		if (free_slot < 0 && !*fake_redis.keys[i]) {
+			free_slot = i;
+		}
+	}
+
+	if (!create || free_slot < 0) {
+		return NULL;
+	}
+
+	switch_copy_string(fake_redis.keys[free_slot], key, sizeof(fake_redis.keys[free_slot]));
+	fake_redis.values[free_slot] = 0;
+	return &fake_redis.values[free_slot];
+}
+
+static void fake_redis_del(const char *key)
+{
+	long long *v = fake_redis_value(key, SWITCH_FALSE);
+
+	if (v) {
+		fake_redis.keys[v - fake_redis.values][0] = '\0';
+	}
+}
+
+static long long fake_redis_get(const char *key)
+{
+	long long *v, r = 0;
+
+	switch_mutex_lock(fake_redis.mutex);
+	if ((v = fake_redis_value(key, SWITCH_FALSE))) {
+		r = *v;
+	}
+	switch_mutex_unlock(fake_redis.mutex);
+
+	return r;
+}
+
+/* run one command, the limit scripts are recognised by the redis calls they make */
+static void fake_redis_execute(int argc, char **argv, char *out, size_t outlen)
+{
+	long long *v;
+
+	switch_mutex_lock(fake_redis.mutex);
+	fake_redis.commands++;
+
+	if (argc == 2 && !strcasecmp(argv[0], "get")) {
+		if ((v = fake_redis_value(argv[1], SWITCH_FALSE))) {
+			char num[32];
+			switch_snprintf(num, sizeof(num), "%lld", *v);
+			switch_snprintf(out, outlen, "$%d\r\n%s\r\n", (int)strlen(num), num);
+		} else {
+			switch_snprintf(out, outlen, "$-1\r\n");
+		}
+	} else if (argc == 2 && (!strcasecmp(argv[0], "incr") || !strcasecmp(argv[0], "decr"))) {
+		v = fake_redis_value(argv[1], SWITCH_TRUE);
+		*v += !strcasecmp(argv[0], "incr") ? 1 : -1;
+		switch_snprintf(out, outlen, ":%lld\r\n", *v);
+	} else if (argc == 2 && !strcasecmp(argv[0], "exists")) {
+		switch_snprintf(out, outlen, ":%d\r\n", fake_redis_value(argv[1], SWITCH_FALSE) ? 1 : 0);
+	} else if (argc >= 2 && (!strcasecmp(argv[0], "expire") || !strcasecmp(argv[0], "del"))) {
+		if (!strcasecmp(argv[0], "del")) {
+			fake_redis_del(argv[1]);
+		}
+		switch_snprintf(out, outlen, ":1\r\n");
+	} else if (argc >= 4 && !strcasecmp(argv[0], "eval")) {
+		const char *script = argv[1];
+		int num_keys = atoi(argv[2]);
+		char **keys = argv + 3, **args = argv + 3 + num_keys;
+		int num_args = argc - 3 - num_keys;
+		long long r;
+
+		v = fake_redis_value(keys[0], SWITCH_TRUE);
+		if (strstr(script, "\"incrby\"")) {
+			/* lease: max, wanted, delete when zero, held by the caller, wanted TTL */
+			long long max = num_args > 0 ? atoll(args[0]) : 0, n = num_args > 1 ? atoll(args[1]) : 0;
+			long long held = num_args > 3 ? atoll(args[3]) : 0;
+			if (*v + n > max) {
+				n = max > *v ? max - *v : 0;
+			}
+			*v += n;
+			r = n;
+			if (!n && *v - held > 0) {
+				*fake_redis_value(keys[1], SWITCH_TRUE) = 1;
+				fake_redis.wanted++;
+				r = -1;
+			}
+			fake_redis.leases++;
+		} else if (strstr(script, "\"decrby\"")) {
+			/* return: units, spare units if wanted, delete when zero */
+			if (fake_redis.fail_returns > 0) {
+				fake_redis.fail_returns--;
+				switch_snprintf(out, outlen, "-ERR injected failure\r\n");
+				switch_mutex_unlock(fake_redis.mutex);
+				return;
+			}
+			r = num_args > 0 ? atoll(args[0]) : 0;
+			if (num_args > 1 && atoll(args[1]) > 0 && fake_redis_value(keys[1], SWITCH_FALSE)) {
+				r += atoll(args[1]);
+				fake_redis_del(keys[1]);
+			}
+			*v -= r;
+			fake_redis.returns++;
+		} else if (strstr(script, "\"incr\"")) {
+			/* incr: max, interval, delete when zero */
+			long long max = num_args > 0 ? atoll(args[0]) : 0, interval = num_args > 1 ? atoll(args[1]) : 0;
+			r = ++*v;
+			if (max > 0 && r > max && !interval) {
+				--*v;
+			}
+		} else {
+			r = --*v;
+		}
+		if (*v <= 0) {
+			fake_redis_del(keys[0]);
+		}
+		switch_snprintf(out, outlen, ":%lld\r\n", r);
+	} else {
+		switch_snprintf(out, outlen, "-ERR unknown command\r\n");
+	}
+
+	switch_mutex_unlock(fake_redis.mutex);
+}
+
+/* parse one RESP array from buf, returns the bytes used or 0 when it is not complete yet */
+static size_t fake_redis_parse(char *buf, size_t len, int *argc, char **argv, int max_args)
+{
+	char *p = buf, *end = buf + len, *nl;
+	int n, i;
+
+	if (len < 4 || *p != '*' || !(nl = memchr(p, '\n', len))) {
+		return 0;
+	}
+	n = atoi(p + 1);
+	p = nl + 1;
+
+	for (i = 0; i < n; i++) {
+		int arg_len;
+
+		if (p >= end || *p != '$' || !(nl = memchr(p, '\n', end - p))) {
+			return 0;
+		}
+		arg_len = atoi(p + 1);
+		p = nl + 1;
+		if (p + arg_len + 2 > end) {
+			return 0;
+		}
+		if (i < max_args) {
+			argv[i] = p;
+		}
+		p[arg_len] = '\0';
+		p += arg_len + 2;
+	}
+
+	*argc = n < max_args ? n : max_args;
+	return p - buf;
+}
+
+static void *SWITCH_THREAD_FUNC fake_redis_connection(switch_thread_t *thread, void *obj)
+{
+	switch_socket_t *sock = (switch_socket_t *)obj;
+	char buf[65536];
+	size_t used = 0;
+
+	for (;;) {
+		switch_size_t len = sizeof(buf) - used - 1;
+		size_t consumed;
+		int argc;
+		char *argv[32];
+
+		if (switch_socket_recv(sock, buf + used, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+		used += len;
+
+		while ((consumed = fake_redis_parse(buf, used, &argc, argv, 32))) {
+			char out[256];
+			switch_size_t out_len;
+
+			fake_redis_execute(argc, argv, out, sizeof(out));
+			out_len = strlen(out);
+			switch_socket_send(sock, out, &out_len);
+			memmove(buf, buf + consumed, used - consumed);
+			used -= consumed;
+		}
+	}
+
+	switch_socket_close(sock);
+	return NULL;
+}
+
+static void *SWITCH_THREAD_FUNC fake_redis_listener(switch_thread_t *thread, void *obj)
+{
+	switch_socket_t *listener = (switch_socket_t *)obj;
+	switch_memory_pool_t *pool = NULL;
+
+	switch_core_new_memory_pool(&pool);
+
+	for (;;) {
+		switch_socket_t *sock = NULL;
+		switch_threadattr_t *thd_attr = NULL;
+		switch_thread_t *conn_thread;
+
+		if (switch_socket_accept(&sock, listener, pool) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_detach_set(thd_attr, 1);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&conn_thread, thd_attr, fake_redis_connection, sock, pool);
+	}
+
+	return NULL;
+}
+
+static switch_status_t fake_redis_start(void)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_socket_t *listener = NULL;
+	switch_sockaddr_t *sa = NULL;
+	switch_threadattr_t *thd_attr = NULL;
+	switch_thread_t *thread;
+
+	switch_core_new_memory_pool(&pool);
+	switch_mutex_init(&fake_redis.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if (switch_sockaddr_info_get(&sa, "127.0.0.1", SWITCH_INET, FAKE_REDIS_PORT, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&listener, AF_INET, SOCK_STREAM, SWITCH_PROTO_TCP, pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_socket_opt_set(listener, SWITCH_SO_REUSEADDR, 1);
+
+	if (switch_socket_bind(listener, sa) != SWITCH_STATUS_SUCCESS || switch_socket_listen(listener, 10) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	return switch_thread_create(&thread, thd_attr, fake_redis_listener, listener, pool);
+}
+
+static switch_core_session_t *new_session(void)
+{
+	switch_core_session_t *session = NULL;
+	switch_call_cause_t cause;
+
+	switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+	return session;
+}
+
+static void end_session(switch_core_session_t *session)
+{
+	switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+	switch_core_session_rwunlock(session);
+}
+
+FST_CORE_BEGIN("./conf_hiredis")
+{
+	FST_SUITE_BEGIN(switch_mod_hiredis)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_loopback");
+			fst_requires_module("mod_hiredis");
+
+			if (!fake_redis.mutex) {
+				fst_requires(fake_redis_start() == SWITCH_STATUS_SUCCESS);
+			}
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(limit_incr_one_round_trip)
+		{
+			switch_core_session_t *sessions[3];
+			uint32_t rcount = 0;
+			int commands, i;
+
+			for (i = 0; i < 3; i++) {
+				sessions[i] = new_session();
+				fst_requires(sessions[i]);
+			}
+
+			commands = fake_redis.commands;
+			fst_check(switch_limit_incr("hiredis", sessions[0], "pipelined", "trunk1", 2, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_limit_incr("hiredis", sessions[1], "pipelined", "trunk1", 2, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(fake_redis.commands - commands, 2);
+			fst_check(switch_limit_incr("hiredis", sessions[2], "pipelined", "trunk1", 2, 0) != SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(fake_redis_get("trunk1"), 2);
+
+			switch_limit_release("hiredis", sessions[0], "pipelined", "trunk1");
+			fst_check_int_equals(fake_redis_get("trunk1"), 1);
+			fst_check_int_equals(switch_limit_usage("hiredis", "pipelined", "trunk1", &rcount), 1);
+
+			switch_limit_release("hiredis", sessions[1], "pipelined", "trunk1");
+			fst_check_int_equals(fake_redis_get("trunk1"), 0);
+
+			for (i = 0; i < 3; i++) {
+				end_session(sessions[i]);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(limit_lease_stays_local)
+		{
+			switch_core_session_t *sessions[7];
+			uint32_t rcount = 0;
+			int i;
+
+			for (i = 0; i < 7; i++) {
+				sessions[i] = new_session();
+				fst_requires(sessions[i]);
+			}
+
+			/* the first call leases a block of 4, the next three never reach redis */
+			for (i = 0; i < 4; i++) {
+				fst_check(switch_limit_incr("hiredis", sessions[i], "leased", "trunk2", 6, 0) == SWITCH_STATUS_SUCCESS);
+			}
+			fst_check_int_equals(fake_redis.leases, 1);
+			fst_check_int_equals(fake_redis_get("trunk2"), 4);
+			fst_check_int_equals(switch_limit_usage("hiredis", "leased", "trunk2", &rcount), 4);
+
+			/* the next lease is cut down to what is left under the max */
+			fst_check(switch_limit_incr("hiredis", sessions[4], "leased", "trunk2", 6, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_limit_incr("hiredis", sessions[5], "leased", "trunk2", 6, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(fake_redis.leases, 2);
+			fst_check_int_equals(fake_redis_get("trunk2"), 6);
+			fst_check(switch_limit_incr("hiredis", sessions[6], "leased", "trunk2", 6, 0) != SWITCH_STATUS_SUCCESS);
+
+			/* once the key is idle the whole lease goes back */
+			for (i = 0; i < 6; i++) {
+				switch_limit_release("hiredis", sessions[i], "leased", "trunk2");
+			}
+			for (i = 0; i < 100 && fake_redis_get("trunk2"); i++) {
+				switch_yield(10000);
+			}
+			fst_check_int_equals(fake_redis_get("trunk2"), 0);
+			fst_check(fake_redis.returns >= 1);
+
+			for (i = 0; i < 7; i++) {
+				end_session(sessions[i]);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(limit_lease_borrow)
+		{
+			switch_core_session_t *sessions[3];
+			uint32_t rcount = 0;
+			int i;
+
+			for (i = 0; i < 3; i++) {
+				sessions[i] = new_session();
+				fst_requires(sessions[i]);
+			}
+
+			/* two profiles on the same redis act as two nodes sharing a max of 5 */
+			fst_check(switch_limit_incr("hiredis", sessions[0], "leased", "trunk3", 5, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_limit_incr("hiredis", sessions[1], "leased_peer", "trunk3", 5, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(fake_redis_get("trunk3"), 5);
+
+			/* everything is leased but only two units are in use, the first node hands its spare units over */
+			fst_check(switch_limit_incr("hiredis", sessions[2], "leased_peer", "trunk3", 5, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check(fake_redis.wanted >= 1);
+			fst_check_int_equals(fake_redis_get("trunk3"), 5);
+			fst_check_int_equals(switch_limit_usage("hiredis", "leased_peer", "trunk3", &rcount), 3);
+
+			for (i = 0; i < 3; i++) {
+				switch_limit_release("hiredis", sessions[i], i ? "leased_peer" : "leased", "trunk3");
+			}
+			for (i = 0; i < 100 && fake_redis_get("trunk3"); i++) {
+				switch_yield(10000);
+			}
+			fst_check_int_equals(fake_redis_get("trunk3"), 0);
+
+			for (i = 0; i < 3; i++) {
+				end_session(sessions[i]);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(limit_lease_return_retry)
+		{
+			switch_core_session_t *session = new_session();
+			int i;
+
+			fst_requires(session);
+
+			fst_check(switch_limit_incr("hiredis", session, "leased_peer", "trunk4", 5, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(fake_redis_get("trunk4"), 4);
+
+			/* the return on release fails, the lease thread hands the units back later */
+			fake_redis.fail_returns = 1;
+			switch_limit_release("hiredis", session, "leased_peer", "trunk4");
+			fst_check_int_equals(fake_redis.fail_returns, 0);
+			for (i = 0; i < 100 && fake_redis_get("trunk4"); i++) {
+				switch_yield(10000);
+			}
+			fst_check_int_equals(fake_redis_get("trunk4"), 0);
+
+			end_session(session);
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
@@ -0,0 +1,237 @@
+#include <switch.h>
+#include <stdlib.h>
+
+#include <test/switch_test.h>
+
+/* mod_httapi fetches its documents from a minimal keep-alive HTTP server on 127.0.0.1:18080 */
+
+#define FAKE_HTTP_PORT 18080
+
+#define FAKE_HTTP_DOCUMENT "<document type=\"text/freeswitch-httapi\"><variables><httapi_test>ok</httapi_test></variables>" \
+	"<work><hangup/></work></document>"
+
+static struct {
+	switch_mutex_t *mutex;
+	int connections;
+	int requests;
+} fake_http;
+
+/* answer every complete request in buf, returns the bytes used */
+static size_t fake_http_serve(switch_socket_t *sock, char *buf, size_t len, int *continued)
+{
+	char *end;
+	const char *cl;
+	size_t header_len, body_len = 0;
+	char out[512];
+	switch_size_t out_len;
+
+	buf[len] = '\0';
+	if (!(end = strstr(buf, "\r\n\r\n"))) {
+		return 0;
+	}
+	header_len = end + 4 - buf;
+
+	if ((cl = switch_stristr("content-length:", buf)) && cl < end) {
+		body_len = atoi(cl + 15);
+	}
+
+	if (header_len + body_len > len) {
+		if (!*continued && switch_stristr("expect: 100-continue", buf)) {
+			out_len = strlen("HTTP/1.1 100 Continue\r\n\r\n");
+			switch_socket_send(sock, "HTTP/1.1 100 Continue\r\n\r\n", &out_len);
+			*continued = 1;
+		}
+		return 0;
+	}
+
+	switch_mutex_lock(fake_http.mutex);
+	fake_http.requests++;
+	switch_mutex_unlock(fake_http.mutex);
+
+	switch_snprintf(out, sizeof(out), "HTTP/1.1 200 OK\r\nContent-Type: text/xml\r\nContent-Length: %d\r\n\r\n%s",
+					(int)strlen(FAKE_HTTP_DOCUMENT), FAKE_HTTP_DOCUMENT);
+	out_len = strlen(out);
+	switch_socket_send(sock, out, &out_len);
+	*continued = 0;
+
+	return header_len + body_len;
+}
+
+static void *SWITCH_THREAD_FUNC fake_http_connection(switch_thread_t *thread, void *obj)
+{
+	switch_socket_t *sock = (switch_socket_t *)obj;
+	char buf[65536];
+	size_t used = 0;
+	int continued = 0;
+
+	switch_mutex_lock(fake_http.mutex);
+	fake_http.connections++;
+	switch_mutex_unlock(fake_http.mutex);
+
+	for (;;) {
+		switch_size_t len = sizeof(buf) - used - 1;
+		size_t consumed;
+
+		if (!len || switch_socket_recv(sock, buf + used, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+		used += len;
+
+		while ((consumed = fake_http_serve(sock, buf, used, &continued))) {
+			memmove(buf, buf + consumed, used - consumed);
+			used -= consumed;
+		}
+	}
+
+	switch_socket_close(sock);
+	return NULL;
+}
+
+static void *SWITCH_THREAD_FUNC fake_http_listener(switch_thread_t *thread, void *obj)
+{
+	switch_socket_t *listener = (switch_socket_t *)obj;
+	switch_memory_pool_t *pool = NULL;
+
+	switch_core_new_memory_pool(&pool);
+
+	for (;;) {
+		switch_socket_t *sock = NULL;
+		switch_threadattr_t *thd_attr = NULL;
+		switch_thread_t *conn_thread;
+
+		if (switch_socket_accept(&sock, listener, pool) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_detach_set(thd_attr, 1);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&conn_thread, thd_attr, fake_http_connection, sock, pool);
+	}
+
+	return NULL;
+}
+
+static switch_status_t fake_http_start(void)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_socket_t *listener = NULL;
+	switch_sockaddr_t *sa = NULL;
+	switch_threadattr_t *thd_attr = NULL;
+	switch_thread_t *thread;
+
+	switch_core_new_memory_pool(&pool);
+	switch_mutex_init(&fake_http.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if (switch_sockaddr_info_get(&sa, "127.0.0.1", SWITCH_INET, FAKE_HTTP_PORT, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&listener, AF_INET, SOCK_STREAM, SWITCH_PROTO_TCP, pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_socket_opt_set(listener, SWITCH_SO_REUSEADDR, 1);
+
+	if (switch_socket_bind(listener, sa) != SWITCH_STATUS_SUCCESS || switch_socket_listen(listener, 10) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	return switch_thread_create(&thread, thd_attr, fake_http_listener, listener, pool);
+}
+
+/* run the httapi application on a new channel, returns the variable the document sets */
+static char *run_httapi(const char *profile)
+{
+	switch_core_session_t *session = NULL;
+	switch_call_cause_t cause;
+	char *data, *result = NULL;
+	const char *val;
+
+	switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+	if (!session) {
+		return NULL;
+	}
+
+	data = switch_core_session_sprintf(session, "{httapi_profile=%s}", profile);
+	switch_core_session_execute_application(session, "httapi", data);
+
+	if ((val = switch_channel_get_variable(switch_core_session_get_channel(session), "httapi_test"))) {
+		result = strdup(val);
+	}
+
+	switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+	switch_core_session_rwunlock(session);
+
+	return result;
+}
+
+FST_CORE_BEGIN("./conf_httapi")
+{
+	FST_SUITE_BEGIN(switch_mod_httapi)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_loopback");
+			fst_requires_module("mod_httapi");
+
+			if (!fake_http.mutex) {
+				fst_requires(fake_http_start() == SWITCH_STATUS_SUCCESS);
+			}
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(engine_reuses_connection)
+		{
+			switch_stream_handle_t stream = { 0 };
+			int connections = fake_http.connections, requests = fake_http.requests, i;
+
+			for (i = 0; i < 3; i++) {
+				char *result = run_httapi("engine");
+
+				fst_requires(result);
+				fst_check_string_equals(result, "ok");
+				free(result);
+			}
+
+			/* the engine keeps the connection to the server open between requests */
+			fst_check_int_equals(fake_http.requests - requests, 3);
+			fst_check_int_equals(fake_http.connections - connections, 1);
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("httapi", "stats engine", NULL, &stream);
+			fst_requires(stream.data);
+			fst_check(strstr((char *)stream.data, "Profile engine (engine, max-connections 4)"));
+			fst_check(strstr((char *)stream.data, "requests 3 errors 0 new connections 1 in flight 0"));
+			free(stream.data);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(blocking_perform)
+		{
+			switch_stream_handle_t stream = { 0 };
+			int requests = fake_http.requests;
+			char *result = run_httapi("blocking");
+
+			fst_requires(result);
+			fst_check_string_equals(result, "ok");
+			free(result);
+			fst_check_int_equals(fake_http.requests - requests, 1);
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("httapi", "stats blocking", NULL, &stream);
+			fst_requires(stream.data);
+			fst_check(strstr((char *)stream.data, "Profile blocking (blocking,"));
+			fst_check(strstr((char *)stream.data, "requests 1 errors 0"));
+			free(stream.data);
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
@@ -42,6 +42,24 @@ static void send_rtcp_event_handler(switch_event_t *event)
 	show_event(event);
 }
 
+/* send one muxed RTCP packet to the video session and read until it went through process_rtcp_report */
+static uint32_t feedback_bitrate(switch_rtp_t *session, int sockfd, struct sockaddr_in *to, const unsigned char *packet, size_t len)
+{
+	switch_frame_t frame = { 0 };
+	int x;
+
+	if (sendto(sockfd, (const char *) packet, len, MSG_CONFIRM, (const struct sockaddr *) to, sizeof(*to)) < 0) {
+		return 0;
+	}
+
+	for (x = 0; x < 10; x++) {
+		switch_yield(10000);
+		switch_rtp_zerocopy_read_frame(session, &frame, SWITCH_IO_FLAG_NOBLOCK);
+	}
+
+	return switch_rtp_get_stats(session, NULL)->rtcp.peer_max_bitrate;
+}
+
 FST_CORE_BEGIN("./conf")
 {
 FST_SUITE_BEGIN(switch_rtp)
@@ -123,6 +141,60 @@ FST_TEARDOWN_END()
 		switch_core_destroy_memory_pool(&pool);
 	}
 	FST_TEST_END()
+	FST_TEST_BEGIN(test_rtcp_bitrate_feedback)
+	{
+		switch_core_session_t *session = NULL;
+		switch_call_cause_t cause;
+		switch_rtp_flag_t video_flags[SWITCH_RTP_FLAG_INVALID] = {0};
+		static switch_port_t video_rx_port = 1250;
+		struct sockaddr_in to;
+		int sockfd;
+		/* TMMBR, 100 kbps for ssrc 0x1234 and 500 kbps for our ssrc 0xabcd */
+		const unsigned char tmmbr_other[] = {
+			0x83, 0xcd, 0x00, 0x04, 0x11, 0x11, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00,
+			0x00, 0x00, 0x12, 0x34, 0x03, 0x0d, 0x40, 0x28 };
+		const unsigned char tmmbr[] = {
+			0x83, 0xcd, 0x00, 0x06, 0x11, 0x11, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00,
+			0x00, 0x00, 0x12, 0x34, 0x03, 0x0d, 0x40, 0x28,
+			0x00, 0x00, 0xab, 0xcd, 0x10, 0xf4, 0x24, 0x28 };
+		/* REMB, 1.2 mbps for one ssrc */
+		const unsigned char remb[] = {
+			0x8f, 0xce, 0x00, 0x05, 0x11, 0x11, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00,
+			'R', 'E', 'M', 'B', 0x01, 0x0e, 0x49, 0xf0, 0x00, 0x00, 0xab, 0xcd };
+
+		switch_core_new_memory_pool(&pool);
+
+		switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+		fst_requires(session);
+		switch_core_memory_pool_set_data(pool, "__session", session);
+
+		video_flags[SWITCH_RTP_FLAG_VIDEO] = 1;
+		rtp_session = switch_rtp_new(rx_host, video_rx_port, tx_host, tx_port, 96, 1, 90000, video_flags, NULL, &err, pool);
+		fst_requires(rtp_session);
+		fst_requires(switch_rtp_activate_rtcp(rtp_session, 5, tx_port, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS);
+		switch_rtp_set_ssrc(rtp_session, 0xabcd);
+		fst_check(switch_rtp_get_stats(rtp_session, NULL)->rtcp.peer_max_bitrate == 0);
+
+		sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+		fst_requires(sockfd >= 0);
+		memset(&to, 0, sizeof(to));
+		to.sin_family = AF_INET;
+		to.sin_port = htons(video_rx_port);
+		to.sin_addr.s_addr = inet_addr(rx_host);
+
+		/* a TMMBR for another media sender does not limit ours */
+		fst_check(feedback_bitrate(rtp_session, sockfd, &to, tmmbr_other, sizeof(tmmbr_other)) == 0);
+		fst_check(feedback_bitrate(rtp_session, sockfd, &to, tmmbr, sizeof(tmmbr)) == 500000);
+		fst_check(feedback_bitrate(rtp_session, sockfd, &to, remb, sizeof(remb)) == 1200000);
+
+		close(sockfd);
+		switch_rtp_destroy(&rtp_session);
+		switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+		switch_core_session_rwunlock(session);
+		switch_core_destroy_memory_pool(&pool);
+	}
+	FST_TEST_END()
+
 	FST_TEST_BEGIN(test_send_rtcp_event_audio)
 	{
 		switch_core_session_t *session = NULL;
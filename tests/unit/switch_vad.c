@@ -33,6 +33,7 @@
 
 #include <test/switch_test.h>
 
+// #define BENCHMARK 1
 
 static float next_tone_frame(int16_t *buf, unsigned int samples, float pos)
 {
@@ -54,6 +55,75 @@ static void next_silence_frame(int16_t *buf, unsigned int samples)
 	}
 }
 
+static uint32_t labeled_seed = 1;
+
+static float labeled_noise(void)
+{
+	labeled_seed = labeled_seed * 1103515245 + 12345;
+	return ((float)((labeled_seed >> 16) & 0x7fff) / 16384.0f) - 1.0f;
+}
+
+// 8kHz audio alternating 1s of background noise and 1s of a voiced, syllable modulated vowel over the same noise,
+// labels[i] is 1 when frame i (160 samples) has speech
+static void labeled_audio(int16_t *buf, int *labels, int frames, float noise_amp)
+{
+	float y1 = 0, y2 = 0, z1 = 0, z2 = 0;
+	int f, i;
+
+	labeled_seed = 1;
+
+	for (f = 0; f < frames; f++) {
+		int speech = (f / 50) % 2;
+
+		labels[f] = speech;
+
+		for (i = 0; i < 160; i++) {
+			int n = f * 160 + i;
+			float x = 0, out;
+
+			if (speech) {
+				// glottal pulses at 125Hz through formants at 700Hz and 1200Hz, 4Hz syllable rate
+				float env = 0.35f + 0.65f * fabsf(sinf(2.0f * M_PI * 4.0f * n / 8000.0f));
+				float e = (n % 64) == 0 ? 6000.0f * env : 0.0f;
+				float y = e + 2.0f * 0.95f * cosf(2.0f * M_PI * 700.0f / 8000.0f) * y1 - 0.9025f * y2;
+				float z;
+
+				y2 = y1; y1 = y;
+				z = y + 2.0f * 0.93f * cosf(2.0f * M_PI * 1200.0f / 8000.0f) * z1 - 0.8649f * z2;
+				z2 = z1; z1 = z;
+				x = z * 0.2f;
+			} else {
+				y1 = y2 = z1 = z2 = 0;
+			}
+
+			out = x + noise_amp * labeled_noise();
+			if (out > 32767) out = 32767;
+			if (out < -32768) out = -32768;
+			buf[n] = (int16_t)out;
+		}
+	}
+}
+
+// share of frames where the vad agrees with the labels, skipping the 200ms after each label change
+static float labeled_accuracy(switch_vad_t *vad, int16_t *buf, int *labels, int frames)
+{
+	int f, right = 0, total = 0;
+
+	for (f = 0; f < frames; f++) {
+		switch_vad_state_t state = switch_vad_process(vad, buf + f * 160, 160);
+		int talking = state == SWITCH_VAD_STATE_START_TALKING || state == SWITCH_VAD_STATE_TALKING;
+
+		if (f % 50 < 10) continue;
+		total++;
+		right += talking == labels[f];
+	}
+
+	return (float)right / total;
+}
+
+// every kernel the CPU supports, the first one is picked by "auto"
+static const char *kernels[] = { "avx2", "sse2", "scalar" };
+
 FST_CORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_vad)
@@ -223,8 +293,214 @@ FST_CORE_BEGIN("./conf")
 			fst_check(vad == NULL);
 		}
 		FST_TEST_END()
+
+		FST_TEST_BEGIN(kernels_agree)
+		{
+			int16_t buf[321];
+			unsigned int lens[] = { 0, 1, 7, 8, 9, 16, 17, 80, 159, 160, 161, 320 };
+			switch_vad_state_t expected[2][sizeof(lens) / sizeof(lens[0]) * 20];
+			int k, g, i, l, f;
+
+			// noise with full scale peaks, the -32768 samples check the absolute value in the vector kernels
+			labeled_seed = 7;
+			for (i = 0; i < 321; i++) {
+				buf[i] = (int16_t)(labeled_noise() * 32767.0f);
+			}
+			buf[5] = buf[100] = -32768;
+			buf[6] = buf[101] = 32767;
+
+			for (k = 2; k >= 0; k--) {
+				if (switch_vad_set_kernel(kernels[k]) != SWITCH_STATUS_SUCCESS) {
+					continue;
+				}
+
+				for (g = 0; g < 2; g++) {
+					switch_vad_t *vad = switch_vad_init(8000, 1);
+					fst_requires(vad);
+					switch_vad_set_param(vad, "gmm", g ? 1 : -1);
+					switch_vad_set_param(vad, "thresh", 16000);
+					switch_vad_set_param(vad, "voice_ms", 20);
+					switch_vad_set_param(vad, "silence_ms", 20);
+
+					for (f = 0, i = 0; i < 20; i++) {
+						for (l = 0; l < (int)(sizeof(lens) / sizeof(lens[0])); l++, f++) {
+							switch_vad_state_t state = switch_vad_process(vad, buf + (i % 2), lens[l]);
+
+							if (k == 2) {
+								expected[g][f] = state;
+							} else {
+								fst_check_int_equals(state, expected[g][f]);
+							}
+						}
+					}
+
+					switch_vad_destroy(&vad);
+				}
+			}
+
+			fst_check(switch_vad_set_kernel("auto") == SWITCH_STATUS_SUCCESS);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "vad kernel: %s\n", switch_vad_get_kernel());
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(batch)
+		{
+			int frames = 200, streams = 8, f, i;
+			int16_t *buf = malloc(sizeof(int16_t) * 160 * frames);
+			int *labels = malloc(sizeof(int) * frames);
+			switch_vad_t *single[8], *batched[8];
+			int16_t *data[8];
+			unsigned int samples[8];
+			switch_vad_state_t states[8];
+
+			labeled_audio(buf, labels, frames, 400.0f);
+
+			for (i = 0; i < streams; i++) {
+				single[i] = switch_vad_init(8000, 1);
+				batched[i] = switch_vad_init(8000, 1);
+				switch_vad_set_param(single[i], "gmm", i % 2 ? i % 4 : -1);
+				switch_vad_set_param(batched[i], "gmm", i % 2 ? i % 4 : -1);
+				samples[i] = 160;
+			}
+
+			for (f = 0; f < frames; f++) {
+				// the streams are offset so each one sees different audio
+				for (i = 0; i < streams; i++) {
+					data[i] = buf + ((f + i * 10) % frames) * 160;
+				}
+
+				switch_vad_process_batch(batched, data, samples, states, streams);
+
+				for (i = 0; i < streams; i++) {
+					fst_check_int_equals(states[i], switch_vad_process(single[i], data[i], samples[i]));
+				}
+			}
+
+			for (i = 0; i < streams; i++) {
+				switch_vad_destroy(&single[i]);
+				switch_vad_destroy(&batched[i]);
+			}
+
+			free(buf);
+			free(labels);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(gmm_accuracy)
+		{
+			int frames = 500;
+			int16_t *buf = malloc(sizeof(int16_t) * 160 * frames);
+			int *labels = malloc(sizeof(int) * frames);
+			float noise[] = { 0.0f, 400.0f };
+			float energy_acc[2], gmm_acc[2];
+			int n;
+
+			for (n = 0; n < 2; n++) {
+				switch_vad_t *vad;
+
+				labeled_audio(buf, labels, frames, noise[n]);
+
+				vad = switch_vad_init(8000, 1);
+				fst_requires(vad);
+				switch_vad_set_param(vad, "voice_ms", 60);
+				switch_vad_set_param(vad, "silence_ms", 200);
+				energy_acc[n] = labeled_accuracy(vad, buf, labels, frames);
+				switch_vad_destroy(&vad);
+
+				vad = switch_vad_init(8000, 1);
+				fst_requires(vad);
+				switch_vad_set_param(vad, "voice_ms", 60);
+				switch_vad_set_param(vad, "silence_ms", 200);
+				switch_vad_set_param(vad, "gmm", 1);
+				gmm_acc[n] = labeled_accuracy(vad, buf, labels, frames);
+				switch_vad_destroy(&vad);
+
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "noise %.0f: energy accuracy %.3f, gmm accuracy %.3f\n", noise[n], energy_acc[n], gmm_acc[n]);
+			}
+
+			// both get clean audio right, only the gmm copes with a noise floor above the energy threshold
+			fst_check(energy_acc[0] >= 0.95f);
+			fst_check(gmm_acc[0] >= 0.95f);
+			fst_check(gmm_acc[1] >= 0.9f);
+			fst_check(gmm_acc[1] > energy_acc[1]);
+
+			free(buf);
+			free(labels);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(benchmark)
+		{
+			int frames = 500, streams = 64, loops, f, i, k, g;
+			int16_t *buf = malloc(sizeof(int16_t) * 160 * frames);
+			int *labels = malloc(sizeof(int) * frames);
+			switch_vad_t *vads[64];
+			int16_t *data[64];
+			unsigned int samples[64];
+			switch_vad_state_t states[64];
+
+#ifdef BENCHMARK
+			loops = 100;
+#else
+			loops = 1;
+#endif
+
+			labeled_audio(buf, labels, frames, 400.0f);
+
+			for (k = 0; k < 3; k++) {
+				if (switch_vad_set_kernel(kernels[k]) != SWITCH_STATUS_SUCCESS) {
+					continue;
+				}
+
+				for (g = 0; g < 2; g++) {
+					switch_time_t start, single_us, batch_us;
+					int l;
+
+					for (i = 0; i < streams; i++) {
+						vads[i] = switch_vad_init(8000, 1);
+						switch_vad_set_param(vads[i], "gmm", g ? 1 : -1);
+						samples[i] = 160;
+					}
+
+					start = switch_time_now();
+					for (l = 0; l < loops; l++) {
+						for (f = 0; f < frames; f++) {
+							for (i = 0; i < streams; i++) {
+								switch_vad_process(vads[i], buf + ((f + i) % frames) * 160, 160);
+							}
+						}
+					}
+					single_us = switch_time_now() - start;
+
+					start = switch_time_now();
+					for (l = 0; l < loops; l++) {
+						for (f = 0; f < frames; f++) {
+							for (i = 0; i < streams; i++) {
+								data[i] = buf + ((f + i) % frames) * 160;
+							}
+							switch_vad_process_batch(vads, data, samples, states, streams);
+						}
+					}
+					batch_us = switch_time_now() - start;
+
+					for (i = 0; i < streams; i++) {
+						switch_vad_destroy(&vads[i]);
+					}
+
+#ifdef BENCHMARK
+					printf("switch_vad %s %s: %.1f ns per frame, batched %.1f ns per frame\n", kernels[k], g ? "gmm" : "energy",
+						   single_us * 1000.0 / ((double)loops * frames * streams), batch_us * 1000.0 / ((double)loops * frames * streams));
+#endif
+				}
+			}
+
+			fst_check(switch_vad_set_kernel("auto") == SWITCH_STATUS_SUCCESS);
+
+			free(buf);
+			free(labels);
+		}
+		FST_TEST_END()
 	}
 	FST_SUITE_END()
 }
 FST_CORE_END()
-
@@ -86,6 +86,58 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(vp9_budget_status)
+		{
+			switch_image_t *img;
+			uint8_t buf[SWITCH_DEFAULT_VIDEO_SIZE + 12];
+			switch_status_t status;
+			switch_codec_t codec = { 0 };
+			switch_frame_t frame = { 0 };
+			switch_codec_settings_t codec_settings = {{ 0 }};
+			switch_stream_handle_t stream = { 0 };
+			int i;
+
+			codec_settings.video.width = 1280;
+			codec_settings.video.height = 720;
+
+			status = switch_core_codec_init(&codec, "VP9", NULL, NULL, 0, 0, 1, SWITCH_CODEC_FLAG_ENCODE, &codec_settings, fst_pool);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 1280, 720, 1);
+			fst_requires(img);
+
+			frame.packet = buf;
+			frame.packetlen = SWITCH_DEFAULT_VIDEO_SIZE + 12;
+			frame.data = buf + 12;
+			frame.payload = 96;
+			frame.img = img;
+
+			for (i = 0; i < 5; i++) {
+				do {
+					frame.datalen = SWITCH_DEFAULT_VIDEO_SIZE;
+					status = switch_core_codec_encode_video(&codec, &frame);
+				} while (status == SWITCH_STATUS_MORE_DATA);
+				frame.flags = 0;
+			}
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("vpx", "status", NULL, &stream);
+			fst_requires(stream.data);
+			fst_check(strstr((char *)stream.data, "cpu-budget:") != NULL);
+			fst_check(strstr((char *)stream.data, "VP9 1280x720 threads") != NULL);
+			fst_check(strstr((char *)stream.data, "frames 5") != NULL);
+			switch_safe_free(stream.data);
+
+			switch_img_free(&img);
+			switch_core_codec_destroy(&codec);
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("vpx", "status", NULL, &stream);
+			fst_check(strstr((char *)stream.data, "VP9 1280x720") == NULL);
+			switch_safe_free(stream.data);
+		}
+		FST_TEST_END()
+
 		FST_TEARDOWN_BEGIN()
 		{
 			switch_sleep(1000000);